@@ -24,6 +24,12 @@
  *   create a NEW NSFetchedResultsController and set this class's 
  *   fetchedResultsController again.
  *
+ * Changes reported by the fetchedResultsController are collected until it
+ *   finishes a batch, then applied to the table view as one update holding
+ *   the fewest row and section changes that will do. Batches of more than
+ *   kRTCTableMaxAnimatedChanges changes, or made while the table view is off
+ *   screen, reload the table instead.
+ *
  *  @warning This class is intended to be subclassed. You should not use it directly.
  */
 @interface CoreDataTableViewController : UITableViewController <NSFetchedResultsControllerDelegate>
@@ -0,0 +1,403 @@
+//
+//  CoreDataTableViewController.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 5/10/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "CoreDataTableViewController.h"
+#include <unordered_set>
+#include "RTCTableDiff.h"
+
+@interface CoreDataTableViewController () {
+    // what the table view is showing, as of the last batch of changes applied.
+    //   Rows are keyed by number, not object, so it never reads the fetch.
+    rtc::TableSnapshot _shownSnapshot;
+    rtc::TableSnapshot::Key _nextRowKey;
+
+    // the batch of changes being collected, as reported
+    rtc::TableChanges _reportedChanges;
+
+    // keys of rows changed in the batch of changes being collected
+    std::unordered_set<rtc::TableSnapshot::Key> _updatedRows;
+}
+
+// are we collecting a batch of changes to apply to the table view?
+@property (nonatomic) BOOL beganUpdates;
+
+// number of changes the fetchedResultsController has reported in this batch
+@property (nonatomic) NSUInteger numReportedChanges;
+
+// did a change in this batch name a row _shownSnapshot doesn't have?
+@property (nonatomic) BOOL reportedChangesInvalid;
+
+// section keys by section name
+@property (strong, nonatomic) NSMutableDictionary *sectionKeys;
+
+@end
+
+@implementation CoreDataTableViewController
+
+#pragma mark - Fetching
+// perform fetch on fetchedResultsController @property and reload table view.
+- (void)performFetch
+{
+    if (self.fetchedResultsController) {
+        if (self.fetchedResultsController.fetchRequest.predicate) {
+            if (self.debug) NSLog(@"[%@ %@] fetching %@ with predicate: %@", NSStringFromClass([self class]), NSStringFromSelector(_cmd), self.fetchedResultsController.fetchRequest.entityName, self.fetchedResultsController.fetchRequest.predicate);
+        } else {
+             if (self.debug) NSLog(@"[%@ %@] fetching all %@ (i.e., no predicate)", NSStringFromClass([self class]), NSStringFromSelector(_cmd), self.fetchedResultsController.fetchRequest.entityName);
+        }
+        NSError *error;
+        [self.fetchedResultsController performFetch:&error];
+        if (error) NSLog(@"[%@ %@] %@ (%@)", NSStringFromClass([self class]), NSStringFromSelector(_cmd), [error localizedDescription], [error localizedFailureReason]);
+    } else {
+        if (self.debug) NSLog(@"[%@ %@] no NSFetchedResultsController (yet?)", NSStringFromClass([self class]), NSStringFromSelector(_cmd));
+    }
+    [self.tableView reloadData];
+    [self snapshotSections:&_shownSnapshot];
+}
+
+// setup new fetchResultsController property
+//   set delegate (as self)
+//   set view controller's title if appropriate
+//   call performFetch if we got a new fetchResultsController
+//      or clear Table (by reloading Data) if this was removed
+- (void)setFetchedResultsController:(NSFetchedResultsController *)newfrc
+{
+    // only bother changing the fetchedResultsController if receiving a new one.
+    NSFetchedResultsController *oldfrc = _fetchedResultsController;
+    if (newfrc != oldfrc) {
+        _fetchedResultsController = newfrc;
+        newfrc.delegate = self;
+        self.sectionKeys = nil;
+        
+        // set title if view controller doesn't have one
+        if ((!self.title || [self.title isEqualToString:oldfrc.fetchRequest.entity.name]) &&
+            (!self.navigationController || !self.navigationItem.title)) {
+            self.title = newfrc.fetchRequest.entity.name;
+        }
+        
+        // either fetch new data or clear out table view.
+        if (newfrc) {
+            if (self.debug) NSLog(@"[%@ %@] %@", NSStringFromClass([self class]), NSStringFromSelector(_cmd), oldfrc ? @"updated" : @"set");
+            [self performFetch];
+        } else {
+            if (self.debug) NSLog(@"[%@ %@] reset to nil", NSStringFromClass([self class]), NSStringFromSelector(_cmd));
+            [self.tableView reloadData];
+            [self snapshotSections:&_shownSnapshot];
+        }
+    }
+}
+
+
+#pragma mark - UITableViewDataSource
+
+- (NSInteger)numberOfSectionsInTableView:(UITableView *)tableView
+{
+    return [[self.fetchedResultsController sections] count];
+}
+
+- (NSInteger)tableView:(UITableView *)tableView numberOfRowsInSection:(NSInteger)section
+{
+    if ([[self.fetchedResultsController sections] count] > 0 ) {
+        return [[[self.fetchedResultsController sections] objectAtIndex:section] numberOfObjects];
+    } else {
+        return 0;
+    }
+}
+
+- (UITableViewCell *)tableView:(UITableView *)tableView cellForRowAtIndexPath:(NSIndexPath *)indexPath
+{
+    static NSString *cellIdentifier = @"Cell"; // get the cell
+    UITableViewCell *cell = [tableView dequeueReusableCellWithIdentifier:cellIdentifier forIndexPath:indexPath];
+    // NSManagedObject *managedObject = [self.fetchedResultsController objectAtIndexPath:indexPath];
+    //   configure the cell with data from the managed object
+    
+    // Configure the cell...
+    
+    return cell;
+}
+
+- (NSString *)tableView:(UITableView *)tableView titleForHeaderInSection:(NSInteger)section
+{
+     if ([[self.fetchedResultsController sections] count] > 0 ) {
+         return [[[self.fetchedResultsController sections] objectAtIndex:section] name];
+     } else {
+         return nil;
+     }
+}
+
+- (NSArray *)sectionIndexTitlesForTableView:(UITableView *)tableView
+{
+    return [self.fetchedResultsController sectionIndexTitles];
+}
+
+
+/*
+// Override to support conditional editing of the table view.
+- (BOOL)tableView:(UITableView *)tableView canEditRowAtIndexPath:(NSIndexPath *)indexPath
+{
+    // Return NO if you do not want the specified item to be editable.
+    return YES;
+}
+*/
+
+/*
+// Override to support editing the table view.
+- (void)tableView:(UITableView *)tableView commitEditingStyle:(UITableViewCellEditingStyle)editingStyle forRowAtIndexPath:(NSIndexPath *)indexPath
+{
+    if (editingStyle == UITableViewCellEditingStyleDelete) {
+        // Delete the row from the data source
+        [tableView deleteRowsAtIndexPaths:@[indexPath] withRowAnimation:UITableViewRowAnimationFade];
+    }   
+    else if (editingStyle == UITableViewCellEditingStyleInsert) {
+        // Create a new instance of the appropriate class, insert it into the array, and add a new row to the table view
+    }   
+}
+*/
+
+/*
+// Override to support rearranging the table view.
+- (void)tableView:(UITableView *)tableView moveRowAtIndexPath:(NSIndexPath *)fromIndexPath toIndexPath:(NSIndexPath *)toIndexPath
+{
+}
+*/
+
+/*
+// Override to support conditional rearranging of the table view.
+- (BOOL)tableView:(UITableView *)tableView canMoveRowAtIndexPath:(NSIndexPath *)indexPath
+{
+    // Return NO if you do not want the item to be re-orderable.
+    return YES;
+}
+*/
+
+
+#pragma mark - Change Coalescing
+static NSIndexSet *indexSetFromSections(const std::vector<size_t> &sections)
+{
+    NSMutableIndexSet *indexSet = [NSMutableIndexSet indexSet];
+    for (size_t i = 0; i < sections.size(); ++i) [indexSet addIndex:sections[i]];
+    return indexSet;
+}
+
+static NSArray *indexPathsFromTablePaths(const std::vector<rtc::TablePath> &paths)
+{
+    NSMutableArray *indexPaths = [NSMutableArray arrayWithCapacity:paths.size()];
+    for (size_t i = 0; i < paths.size(); ++i) {
+        [indexPaths addObject:[NSIndexPath indexPathForRow:paths[i].row inSection:paths[i].section]];
+    }
+    return indexPaths;
+}
+
+static rtc::TablePath tablePathFromIndexPath(NSIndexPath *indexPath)
+{
+    return rtc::TablePath((size_t)indexPath.section, (size_t)indexPath.row);
+}
+
+/**
+ * Key for a section name, the same one every time within a
+ *   fetchedResultsController
+ */
+- (rtc::TableSnapshot::Key)keyForSectionName:(NSString *)name
+{
+    if (!self.sectionKeys) self.sectionKeys = [[NSMutableDictionary alloc] init];
+    if (!name) name = @"";
+    NSNumber *key = self.sectionKeys[name];
+    if (!key) {
+        key = @([self.sectionKeys count] + 1);
+        self.sectionKeys[name] = key;
+    }
+    return [key unsignedLongLongValue];
+}
+
+/**
+ * Snapshot the sections the fetchedResultsController has now, with new keys
+ *   for their rows. Only the section counts are read, so no objects are
+ *   faulted in.
+ */
+- (void)snapshotSections:(rtc::TableSnapshot *)snapshot
+{
+    snapshot->clear();
+    for (id<NSFetchedResultsSectionInfo> sectionInfo in [self.fetchedResultsController sections]) {
+        snapshot->appendSection([self keyForSectionName:[sectionInfo name]]);
+        for (NSUInteger row = 0; row < [sectionInfo numberOfObjects]; ++row) snapshot->appendRow(++_nextRowKey);
+    }
+}
+
+/**
+ * Does snapshot have as many sections, and rows in each, as the
+ *   fetchedResultsController has now?
+ */
+- (BOOL)snapshotMatchesSections:(const rtc::TableSnapshot &)snapshot
+{
+    NSArray *sections = [self.fetchedResultsController sections];
+    if (snapshot.numSections() != [sections count]) return NO;
+    for (NSUInteger section = 0; section < [sections count]; ++section) {
+        if (snapshot.numRowsInSection(section) != [sections[section] numberOfObjects]) return NO;
+    }
+    return YES;
+}
+
+/**
+ * Key of the row shown at indexPath, noting the batch can't be trusted if
+ *   there is no such row
+ */
+- (BOOL)shownRowKey:(rtc::TableSnapshot::Key *)key atIndexPath:(NSIndexPath *)indexPath
+{
+    rtc::TablePath path = tablePathFromIndexPath(indexPath);
+    if ((path.section >= _shownSnapshot.numSections()) || (path.row >= _shownSnapshot.numRowsInSection(path.section))) {
+        self.reportedChangesInvalid = YES;
+        return NO;
+    }
+    *key = _shownSnapshot.rowKey(path.section, path.row);
+    return YES;
+}
+
+/**
+ * Apply a batch of changes to the table view as one animated update, or as a
+ *   single reload if there are too many to animate.
+ */
+- (void)applyTableDiff:(const rtc::TableDiff &)diff
+{
+    if (diff.reloadAll) {
+        [self.tableView reloadData];
+        return;
+    }
+    if (diff.empty()) return;
+
+    [self.tableView beginUpdates];
+    if (!diff.deletedSections.empty()) {
+        [self.tableView deleteSections:indexSetFromSections(diff.deletedSections)
+                      withRowAnimation:UITableViewRowAnimationFade];
+    }
+    if (!diff.insertedSections.empty()) {
+        [self.tableView insertSections:indexSetFromSections(diff.insertedSections)
+                      withRowAnimation:UITableViewRowAnimationFade];
+    }
+    if (!diff.deletedRows.empty()) {
+        [self.tableView deleteRowsAtIndexPaths:indexPathsFromTablePaths(diff.deletedRows)
+                              withRowAnimation:UITableViewRowAnimationFade];
+    }
+    if (!diff.insertedRows.empty()) {
+        [self.tableView insertRowsAtIndexPaths:indexPathsFromTablePaths(diff.insertedRows)
+                              withRowAnimation:UITableViewRowAnimationFade];
+    }
+    if (!diff.reloadedRows.empty()) {
+        [self.tableView reloadRowsAtIndexPaths:indexPathsFromTablePaths(diff.reloadedRows)
+                              withRowAnimation:UITableViewRowAnimationFade];
+    }
+    for (size_t i = 0; i < diff.movedRows.size(); ++i) {
+        const rtc::TablePath &from = diff.movedRows[i].first, &to = diff.movedRows[i].second;
+        [self.tableView moveRowAtIndexPath:[NSIndexPath indexPathForRow:from.row inSection:from.section]
+                               toIndexPath:[NSIndexPath indexPathForRow:to.row inSection:to.section]];
+    }
+    [self.tableView endUpdates];
+}
+
+
+#pragma mark - NSFetchedResultsControllerDelegate
+// Changes are collected over a batch and applied together once it ends, as
+//   the smallest set of table view updates that gets from the rows shown to
+//   the rows fetched (see rtc::diffTables). A bulk import or delete then costs
+//   one table view update (or reload) rather than one per object. The rows
+//   fetched are worked out from the rows shown and the changes reported (see
+//   rtc::applyTableChanges), since reading them from the fetch would fault in
+//   every object.
+- (void)controllerWillChangeContent:(NSFetchedResultsController *)controller
+{
+    self.beganUpdates = !self.suspendAutomaticTrackingOfChangesInManagedObjectContext;
+    self.numReportedChanges = 0;
+    self.reportedChangesInvalid = NO;
+    _reportedChanges.clear();
+    _updatedRows.clear();
+}
+
+- (void)controller:(NSFetchedResultsController *)controller didChangeSection:(id<NSFetchedResultsSectionInfo>)sectionInfo atIndex:(NSUInteger)sectionIndex forChangeType:(NSFetchedResultsChangeType)type
+{
+    // the snapshot follows changes the user made in the table view too
+    self.numReportedChanges++;
+
+    if (type == NSFetchedResultsChangeInsert) {
+        _reportedChanges.insertedSections.push_back(std::make_pair((size_t)sectionIndex, [self keyForSectionName:[sectionInfo name]]));
+    } else if (type == NSFetchedResultsChangeDelete) {
+        _reportedChanges.deletedSections.push_back(sectionIndex);
+    }
+}
+
+- (void)controller:(NSFetchedResultsController *)controller didChangeObject:(id)anObject atIndexPath:(NSIndexPath *)indexPath forChangeType:(NSFetchedResultsChangeType)type newIndexPath:(NSIndexPath *)newIndexPath
+{
+    self.numReportedChanges++;
+
+    rtc::TableSnapshot::Key key;
+    switch (type) {
+        case NSFetchedResultsChangeInsert:
+            _reportedChanges.insertedRows.push_back(std::make_pair(tablePathFromIndexPath(newIndexPath), ++_nextRowKey));
+            break;
+
+        case NSFetchedResultsChangeDelete:
+            _reportedChanges.deletedRows.push_back(tablePathFromIndexPath(indexPath));
+            break;
+
+        case NSFetchedResultsChangeMove:
+            // objects only move when they change, so a moved row needs
+            //   redrawing too
+            if (![self shownRowKey:&key atIndexPath:indexPath]) break;
+            _reportedChanges.deletedRows.push_back(tablePathFromIndexPath(indexPath));
+            _reportedChanges.insertedRows.push_back(std::make_pair(tablePathFromIndexPath(newIndexPath), key));
+            _updatedRows.insert(key);
+            break;
+
+        case NSFetchedResultsChangeUpdate:
+            if ([self shownRowKey:&key atIndexPath:indexPath]) _updatedRows.insert(key);
+            break;
+    }
+}
+
+- (void)controllerDidChangeContent:(NSFetchedResultsController *)controller
+{
+    // a batch that doesn't add up to what was fetched is shown afresh
+    rtc::TableSnapshot fetchedSnapshot;
+    BOOL applied = !self.reportedChangesInvalid &&
+                   rtc::applyTableChanges(_shownSnapshot, _reportedChanges, &fetchedSnapshot) &&
+                   [self snapshotMatchesSections:fetchedSnapshot];
+    if (!applied) [self snapshotSections:&fetchedSnapshot];
+
+    // changes the user made in the table view are already showing
+    if (self.beganUpdates) {
+        rtc::TableDiff diff;
+        if (!applied || !self.tableView.window || (self.numReportedChanges > kRTCTableMaxAnimatedChanges)) {
+            // off screen nobody sees animations, and a batch this big won't
+            //   diff down to an animated one. One that didn't add up has
+            //   nothing to diff against.
+            diff.reloadAll = true;
+        } else {
+            diff = rtc::diffTables(_shownSnapshot, fetchedSnapshot, _updatedRows, kRTCTableMaxAnimatedChanges);
+        }
+        if (self.debug) NSLog(@"[%@ %@] %lu changes reported, %@", NSStringFromClass([self class]), NSStringFromSelector(_cmd), (unsigned long)self.numReportedChanges, diff.reloadAll ? @"reloading" : [NSString stringWithFormat:@"%zu table view updates", diff.numChanges()]);
+        [self applyTableDiff:diff];
+    }
+
+    _shownSnapshot.swap(fetchedSnapshot);
+    _reportedChanges.clear();
+    _updatedRows.clear();
+    self.beganUpdates = NO;
+}
+
+- (void)endSuspensionOfUpdatesDueToContextChanges
+{
+    _suspendAutomaticTrackingOfChangesInManagedObjectContext = NO;
+}
+
+- (void)setSuspendAutomaticTrackingOfChangesInManagedObjectContext:(BOOL)suspend
+{
+    if (suspend) {
+        _suspendAutomaticTrackingOfChangesInManagedObjectContext = YES;
+    } else {
+        [self performSelector:@selector(endSuspensionOfUpdatesDueToContextChanges) withObject:nil afterDelay:0];
+    }
+}
+
+@end
@@ -0,0 +1,88 @@
+//
+//  RTCDirectionsManager.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/14/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+#import "RTCRoute.h"
+
+typedef void (^RTCDirectionsCompletion)(RTCRoute *route, NSError *error);
+
+/**
+ * RTCDirectionsManager is a singleton class that hands out walking routes,
+ * asking MapKit only when it has to.
+ *
+ * Routes are remembered in a cache (see rtc::RouteCache) keyed by where they
+ * start and end, persisted in the app's caches directory. A request that hits
+ * the cache, or lies along a cached route to the same destination, is answered
+ * straight away. A cached route past kRTCRouteCacheMaxAge is still answered
+ * with, then refreshed from MapKit in the background.
+ *
+ * When MapKit can't give a route (no signal in a parking garage, say) and an
+ * OpenStreetMap extract has been imported, the route is found offline over
+ * that walking graph instead (see rtc::WalkRouter). The graph file is memory
+ * mapped, so only the parts of it a route touches are ever read in.
+ */
+@interface RTCDirectionsManager : NSObject
+
+#pragma mark - Properties
+/**
+ * Has a walking graph been imported for offline routing?
+ */
+@property (nonatomic, readonly) BOOL hasWalkingGraph;
+
+
+#pragma mark - Class Methods
+/**
+ * Single instance manager.
+ * It creates the instance if this hasn't been done or simply returns it.
+ *
+ * @return An initialized RTCDirectionsManager object.
+ */
++ (instancetype)sharedManager;
+
+/**
+ * File the offline walking graph is kept in
+ */
++ (NSURL *)walkingGraphURL;
+
+
+#pragma mark - Instance Methods
+/**
+ * Get a walking route.
+ *
+ * @param source        where the route starts
+ * @param destination   where the route ends
+ * @param completion    block called on the main queue with the route, or nil
+ *                      and an error. With a cached route it is called before
+ *                      this method returns, and called again if the route is
+ *                      refreshed. If MapKit fails it is called with an offline
+ *                      route when there is one.
+ */
+- (void)walkingRouteFromCoordinate:(CLLocationCoordinate2D)source
+                         toMapItem:(MKMapItem *)destination
+                        completion:(RTCDirectionsCompletion)completion;
+
+/**
+ * Build the offline walking graph from an OpenStreetMap XML extract (.osm),
+ * replacing any previous one. Runs in the background.
+ *
+ * @param url           the extract
+ * @param completion    block called on the main queue when done
+ */
+- (void)importWalkingGraphFromOSMFileAtURL:(NSURL *)url
+                                completion:(void (^)(BOOL success))completion;
+
+/**
+ * Write the route cache to its file if it has changed since it was last
+ * written.
+ *
+ * @return NO if the write failed.
+ */
+- (BOOL)saveCache;
+
+@end
@@ -0,0 +1,360 @@
+//
+//  RTCDirectionsManager.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/14/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCDirectionsManager.h"
+#include <fstream>
+#include <memory>
+#include "RTCRouteCache.h"
+#include "RTCTrace.h"
+#include "RTCWalkRouter.h"
+
+#pragma mark - Constants
+// Relative address of the route cache in the caches directory
+static NSString *const kRouteCachePath = @"Routes.cache";
+// Relative address of the offline walking graph in the documents directory
+static NSString *const kWalkingGraphPath = @"WalkingGraph.graph";
+
+
+@interface RTCDirectionsManager () {
+    std::unique_ptr<rtc::RouteCache> _routeCache;
+
+    // offline routing. Only touched on routingQueue.
+    std::unique_ptr<rtc::WalkGraph> _walkGraph;
+    std::unique_ptr<rtc::WalkRouter> _walkRouter;
+}
+
+@property (strong, nonatomic) NSURL *cacheURL;
+
+// offline routing and graph imports run here, off the main queue
+@property (strong, nonatomic) dispatch_queue_t routingQueue;
+
+// memory mapped walking graph file backing _walkGraph
+@property (strong, nonatomic) NSData *walkGraphData;
+@property (nonatomic, readwrite) BOOL hasWalkingGraph;
+
+// has the cache changed since it was last saved?
+@property (nonatomic) BOOL dirty;
+
+@end
+
+
+@implementation RTCDirectionsManager
+
+#pragma mark - Class methods
+#pragma mark Public
+// Declare a static variable, which is an instance of this class
+// It is initialized once and only once in a thread-safe manner by using
+//   Grand Central Dispatch (GCD)
++ (instancetype)sharedManager
+{
+    static RTCDirectionsManager *sharedInstance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [[self alloc] initPrivate];
+    });
+    return sharedInstance;
+}
+
++ (NSURL *)walkingGraphURL
+{
+    NSURL *docURL = [[[NSFileManager defaultManager] URLsForDirectory:NSDocumentDirectory inDomains:NSUserDomainMask] lastObject];
+    return [docURL URLByAppendingPathComponent:kWalkingGraphPath];
+}
+
+
+#pragma mark - Initialization
+// if a programmer calls [RTCDirectionsManager alloc] init], let them know the
+//   error of their ways.
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"Singleton"
+                                   reason:@"Use + [RTCDirectionsManager sharedManager]"
+                                 userInfo:nil];
+    return nil;
+}
+
+// here is the real (secret) initializer
+- (instancetype)initPrivate
+{
+    self = [super init];
+    if (self) {
+        _routeCache.reset(new rtc::RouteCache(rtc::SystemClock::sharedClock(),
+                                              [RTCDirectionsManager routeCachePolicy]));
+
+        NSURL *cachesURL = [[[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask] lastObject];
+        _cacheURL = [cachesURL URLByAppendingPathComponent:kRouteCachePath];
+
+        // a missing or unreadable cache just means starting empty
+        std::ifstream input([[_cacheURL path] fileSystemRepresentation], std::ios::binary);
+        if (input && !_routeCache->read(input)) _routeCache->clear();
+
+        _routingQueue = dispatch_queue_create("com.retracapp.routing", DISPATCH_QUEUE_SERIAL);
+        _hasWalkingGraph = [[RTCDirectionsManager walkingGraphURL] checkResourceIsReachableAndReturnError:NULL];
+    }
+    return self;
+}
+
+
+#pragma mark - Class Methods
+#pragma mark Private
+/**
+ * Route cache policy built from the app's directions settings
+ */
++ (rtc::RouteCachePolicy)routeCachePolicy
+{
+    rtc::RouteCachePolicy policy;
+    policy.originCellSize = kRTCRouteCacheOriginCellSize;
+    policy.destinationCellSize = kRTCRouteCacheDestinationCellSize;
+    policy.maxAge = kRTCRouteCacheMaxAge;
+    policy.reuseDistance = kRTCRouteCacheReuseDistance;
+    policy.maxEntries = (unsigned)kRTCRouteCacheMaxEntries;
+    return policy;
+}
+
+/**
+ * Offline routing policy built from the app's directions settings
+ */
++ (rtc::WalkRoutePolicy)walkRoutePolicy
+{
+    rtc::WalkRoutePolicy policy;
+    policy.walkingSpeed = kRTCOfflineRouteWalkingSpeed;
+    policy.maxSnapDistance = kRTCOfflineRouteMaxSnapDistance;
+    return policy;
+}
+
++ (rtc::GeoPoint)geoPointFromCoordinate:(CLLocationCoordinate2D)coordinate
+{
+    return rtc::GeoPoint(coordinate.latitude, coordinate.longitude);
+}
+
+/**
+ * Convert an MKRoute to the cache's representation, joining the steps'
+ * polylines into one.
+ */
++ (rtc::Route)routeFromMKRoute:(MKRoute *)mkRoute
+{
+    rtc::Route route;
+    route.distance = mkRoute.distance;
+    route.expectedTravelTime = mkRoute.expectedTravelTime;
+
+    for (MKRouteStep *mkStep in mkRoute.steps) {
+        MKPolyline *polyline = mkStep.polyline;
+        MKMapPoint *points = polyline.points;
+
+        // consecutive steps share their end points
+        NSUInteger first = route.polyline.empty() ? 0 : 1;
+        uint32_t firstPoint = (uint32_t)(route.polyline.empty() ? 0 : route.polyline.size() - 1);
+
+        for (NSUInteger i = first; i < polyline.pointCount; ++i) {
+            CLLocationCoordinate2D coordinate = MKCoordinateForMapPoint(points[i]);
+            route.polyline.push_back([self geoPointFromCoordinate:coordinate]);
+        }
+
+        const char *instructions = [mkStep.instructions UTF8String];
+        route.steps.push_back(rtc::RouteStep(instructions ? instructions : "", mkStep.distance, firstPoint));
+    }
+    return route;
+}
+
+/**
+ * Convert a cached route to an RTCRoute
+ */
++ (RTCRoute *)routeFromRoute:(const rtc::Route &)route source:(RTCRouteSource)source
+{
+    std::vector<CLLocationCoordinate2D> coordinates;
+    coordinates.reserve(route.polyline.size());
+    for (size_t i = 0; i < route.polyline.size(); ++i) {
+        coordinates.push_back(CLLocationCoordinate2DMake(route.polyline[i].latitude, route.polyline[i].longitude));
+    }
+    MKPolyline *polyline = [MKPolyline polylineWithCoordinates:coordinates.data() count:coordinates.size()];
+
+    NSMutableArray *steps = [[NSMutableArray alloc] initWithCapacity:route.steps.size()];
+    for (size_t i = 0; i < route.steps.size(); ++i) {
+        NSString *instructions = [NSString stringWithUTF8String:route.steps[i].instructions.c_str()];
+        [steps addObject:[[RTCRouteStep alloc] initWithInstructions:instructions
+                                                            distance:route.steps[i].distance
+                                                     firstPointIndex:route.steps[i].firstPoint]];
+    }
+
+    return [[RTCRoute alloc] initWithPolyline:polyline
+                                        steps:steps
+                                     distance:route.distance
+                           expectedTravelTime:route.expectedTravelTime
+                                       source:source];
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Private
+/**
+ * Map the walking graph file in if it isn't already. Call on routingQueue.
+ *
+ * @return NO if there is no usable graph.
+ */
+- (BOOL)loadWalkingGraph
+{
+    if (_walkRouter) return YES;
+
+    NSData *data = [NSData dataWithContentsOfURL:[RTCDirectionsManager walkingGraphURL]
+                                         options:NSDataReadingMappedAlways
+                                           error:NULL];
+    std::unique_ptr<rtc::WalkGraph> graph(new rtc::WalkGraph());
+    if (!data || !graph->attach([data bytes], [data length])) return NO;
+
+    self.walkGraphData = data;
+    _walkGraph.swap(graph);
+    _walkRouter.reset(new rtc::WalkRouter(*_walkGraph, [RTCDirectionsManager walkRoutePolicy]));
+    return YES;
+}
+
+/**
+ * Drop the mapped walking graph. Call on routingQueue.
+ */
+- (void)unloadWalkingGraph
+{
+    _walkRouter.reset();
+    _walkGraph.reset();
+    self.walkGraphData = nil;
+}
+
+/**
+ * Find a walking route over the offline walking graph.
+ *
+ * @param completion    block called on the main queue with the route, or nil
+ *                      if there is no graph or no route.
+ */
+- (void)offlineWalkingRouteFromCoordinate:(CLLocationCoordinate2D)source
+                             toCoordinate:(CLLocationCoordinate2D)destination
+                               completion:(void (^)(RTCRoute *route))completion
+{
+    if (!self.hasWalkingGraph) {
+        if (completion) completion(nil);
+        return;
+    }
+
+    dispatch_async(self.routingQueue, ^{
+        rtc::TraceScope scope(rtc::Tracer::sharedTracer(), "directions.offline");
+        rtc::Route route;
+        BOOL found = [self loadWalkingGraph] &&
+                     _walkRouter->route([RTCDirectionsManager geoPointFromCoordinate:source],
+                                        [RTCDirectionsManager geoPointFromCoordinate:destination],
+                                        route);
+        RTCRoute *offlineRoute = found ? [RTCDirectionsManager routeFromRoute:route source:RTCRouteSourceOffline] : nil;
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completion) completion(offlineRoute);
+        });
+    });
+}
+
+/**
+ * Ask MapKit for a walking route and cache it.
+ */
+- (void)fetchWalkingRouteFromCoordinate:(CLLocationCoordinate2D)source
+                              toMapItem:(MKMapItem *)destination
+                             completion:(RTCDirectionsCompletion)completion
+{
+    MKDirectionsRequest *request = [[MKDirectionsRequest alloc] init];
+    request.transportType = MKDirectionsTransportTypeWalking;
+    MKPlacemark *sourcePlacemark = [[MKPlacemark alloc] initWithCoordinate:source addressDictionary:nil];
+    request.source = [[MKMapItem alloc] initWithPlacemark:sourcePlacemark];
+    request.destination = destination;
+
+    MKDirections *directions = [[MKDirections alloc] initWithRequest:request];
+    rtc::Tracer::SpanID span = rtc::Tracer::sharedTracer().beginSpan("directions.mapkit");
+    [directions calculateDirectionsWithCompletionHandler:^(MKDirectionsResponse *response, NSError *error) {
+        rtc::Tracer::sharedTracer().endSpan(span);
+        // The code doesn't request alternate routes, so use the single calculated route
+        MKRoute *mkRoute = [response.routes firstObject];
+        if (!mkRoute) {
+            // no network is exactly when an offline route is wanted
+            [self offlineWalkingRouteFromCoordinate:source toCoordinate:destination.placemark.coordinate completion:^(RTCRoute *route) {
+                if (completion) completion(route, route ? nil : error);
+            }];
+            return;
+        }
+
+        rtc::Route route = [RTCDirectionsManager routeFromMKRoute:mkRoute];
+        _routeCache->store([RTCDirectionsManager geoPointFromCoordinate:source],
+                           [RTCDirectionsManager geoPointFromCoordinate:destination.placemark.coordinate],
+                           route);
+        self.dirty = YES;
+
+        if (completion) completion([RTCDirectionsManager routeFromRoute:route source:RTCRouteSourceMapKit], nil);
+    }];
+}
+
+
+#pragma mark Public
+- (void)walkingRouteFromCoordinate:(CLLocationCoordinate2D)source
+                         toMapItem:(MKMapItem *)destination
+                        completion:(RTCDirectionsCompletion)completion
+{
+    rtc::RouteCache::Match match = _routeCache->lookup([RTCDirectionsManager geoPointFromCoordinate:source],
+                                                       [RTCDirectionsManager geoPointFromCoordinate:destination.placemark.coordinate]);
+
+    if (match.kind != rtc::RouteCache::MatchNone) {
+        if (completion) completion([RTCDirectionsManager routeFromRoute:match.route source:RTCRouteSourceCache], nil);
+        if (!match.stale) return;
+
+        // keep showing the old route if the refresh fails
+        [self fetchWalkingRouteFromCoordinate:source toMapItem:destination completion:^(RTCRoute *route, NSError *error) {
+            if (route && completion) completion(route, nil);
+        }];
+        return;
+    }
+
+    [self fetchWalkingRouteFromCoordinate:source toMapItem:destination completion:completion];
+}
+
+- (void)importWalkingGraphFromOSMFileAtURL:(NSURL *)url
+                                completion:(void (^)(BOOL success))completion
+{
+    dispatch_async(self.routingQueue, ^{
+        rtc::WalkGraphBuilder builder;
+        std::ifstream osm([[url path] fileSystemRepresentation], std::ios::binary);
+        BOOL success = osm && rtc::importOSM(osm, builder);
+
+        // write next to the old graph and swap it in, so a failure keeps it
+        NSURL *graphURL = [RTCDirectionsManager walkingGraphURL];
+        NSURL *temporaryURL = [graphURL URLByAppendingPathExtension:@"new"];
+        if (success) {
+            std::ofstream output([[temporaryURL path] fileSystemRepresentation], std::ios::binary | std::ios::trunc);
+            success = builder.write(output);
+            output.close();
+            success = success && output;
+        }
+        if (success) {
+            [self unloadWalkingGraph];
+            [[NSFileManager defaultManager] removeItemAtURL:graphURL error:NULL];
+            success = [[NSFileManager defaultManager] moveItemAtURL:temporaryURL toURL:graphURL error:NULL];
+        }
+        [[NSFileManager defaultManager] removeItemAtURL:temporaryURL error:NULL];
+        BOOL hasWalkingGraph = [graphURL checkResourceIsReachableAndReturnError:NULL];
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            self.hasWalkingGraph = hasWalkingGraph;
+            if (completion) completion(success);
+        });
+    });
+}
+
+- (BOOL)saveCache
+{
+    if (!self.dirty) return YES;
+
+    std::ofstream output([[self.cacheURL path] fileSystemRepresentation], std::ios::binary | std::ios::trunc);
+    _routeCache->write(output);
+    output.close();
+    if (!output) return NO;
+
+    self.dirty = NO;
+    return YES;
+}
+
+@end
@@ -0,0 +1,82 @@
+//
+//  RTCGeocodingManager.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/16/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreData/CoreData.h>
+#import <CoreLocation/CoreLocation.h>
+#import "RTCBackgroundWriter.h"
+
+typedef void (^RTCGeocodeCompletion)(CLPlacemark *placemark, NSError *error);
+
+/**
+ * RTCGeocodingManager is a singleton class that hands out reverse-geocoded
+ * placemarks, asking CLGeocoder only when it has to.
+ *
+ * Placemarks are remembered in a cache (see rtc::GeocodeCache) keyed by
+ * location to within kRTCGeocodeCacheCellSize, persisted in the app's caches
+ * directory. Requests for a location already being looked up wait on that
+ * lookup instead of starting another, and lookups go to the geocoder one at a
+ * time, at least kRTCGeocodeMinLookupInterval apart, so we stay clear of its
+ * throttling. Lookups for a screen go ahead of those filling in placemarks
+ * for places saved without a network.
+ */
+@interface RTCGeocodingManager : NSObject
+
+#pragma mark - Properties
+/**
+ * Fraction of requests answered from the cache since launch
+ */
+@property (nonatomic, readonly) double hitRate;
+
+/**
+ * Mean time (in seconds) requests waited for a placemark since launch.
+ * Background requests aren't counted.
+ */
+@property (nonatomic, readonly) NSTimeInterval meanLatency;
+
+
+#pragma mark - Class Methods
+/**
+ * Single instance manager.
+ * It creates the instance if this hasn't been done or simply returns it.
+ *
+ * @return An initialized RTCGeocodingManager object.
+ */
++ (instancetype)sharedManager;
+
+
+#pragma mark - Instance Methods
+/**
+ * Get the placemark of a location.
+ *
+ * @param location      location to reverse geocode
+ * @param completion    block called on the main queue with the placemark, or
+ *                      nil and an error. With a cached placemark it is called
+ *                      before this method returns.
+ */
+- (void)reverseGeocodeLocation:(CLLocation *)location completion:(RTCGeocodeCompletion)completion;
+
+/**
+ * Queue background lookups for every place that has no placemark yet, and set
+ * each place's placemark as it comes in. Places close together share a
+ * lookup.
+ *
+ * @param writer    writer for the database; the places are found and updated
+ *                  through it, off the main queue
+ */
+- (void)geocodePlacesMissingPlacemarksWithWriter:(RTCBackgroundWriter *)writer;
+
+/**
+ * Write the placemark cache to its file if it has changed since it was last
+ * written.
+ *
+ * @return NO if the write failed.
+ */
+- (BOOL)saveCache;
+
+@end
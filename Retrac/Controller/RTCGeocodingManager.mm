@@ -0,0 +1,261 @@
+//
+//  RTCGeocodingManager.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/16/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCGeocodingManager.h"
+#import "RTCPlace.h"
+#import "RTCWorkScheduler.h"
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include "RTCGeocodeCache.h"
+#include "RTCTrace.h"
+
+#pragma mark - Constants
+// Relative address of the placemark cache in the caches directory
+static NSString *const kGeocodeCachePath = @"Placemarks.cache";
+
+
+@interface RTCGeocodingManager () {
+    std::unique_ptr<rtc::GeocodeCache> _geocodeCache;
+    rtc::GeocodeCache::RequestID _lastRequestID;
+}
+
+@property (strong, nonatomic) NSURL *cacheURL;
+
+// the geocoder only handles one request at a time, so one is all we need
+@property (strong, nonatomic) CLGeocoder *geocoder;
+
+// completion blocks of requests waiting on a lookup, by request ID
+@property (strong, nonatomic) NSMutableDictionary *completions;
+
+// pending call to pumpLookups, if one is scheduled
+@property (strong, nonatomic) RTCTimer *pumpTimer;
+
+// has the cache changed since it was last saved?
+@property (nonatomic) BOOL dirty;
+
+@end
+
+
+@implementation RTCGeocodingManager
+
+#pragma mark - Properties
+- (double)hitRate
+{
+    return _geocodeCache->stats().hitRate();
+}
+
+- (NSTimeInterval)meanLatency
+{
+    return _geocodeCache->stats().meanUserLatency();
+}
+
+
+#pragma mark - Class methods
+#pragma mark Public
+// Declare a static variable, which is an instance of this class
+// It is initialized once and only once in a thread-safe manner by using
+//   Grand Central Dispatch (GCD)
++ (instancetype)sharedManager
+{
+    static RTCGeocodingManager *sharedInstance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [[self alloc] initPrivate];
+    });
+    return sharedInstance;
+}
+
+
+#pragma mark - Initialization
+// if a programmer calls [RTCGeocodingManager alloc] init], let them know the
+//   error of their ways.
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"Singleton"
+                                   reason:@"Use + [RTCGeocodingManager sharedManager]"
+                                 userInfo:nil];
+    return nil;
+}
+
+// here is the real (secret) initializer
+- (instancetype)initPrivate
+{
+    self = [super init];
+    if (self) {
+        _geocodeCache.reset(new rtc::GeocodeCache(rtc::SystemClock::sharedClock(),
+                                                  [RTCGeocodingManager geocodePolicy]));
+        _lastRequestID = 0;
+        _geocoder = [[CLGeocoder alloc] init];
+        _completions = [[NSMutableDictionary alloc] init];
+
+        NSURL *cachesURL = [[[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask] lastObject];
+        _cacheURL = [cachesURL URLByAppendingPathComponent:kGeocodeCachePath];
+
+        // a missing or unreadable cache just means starting empty
+        std::ifstream input([[_cacheURL path] fileSystemRepresentation], std::ios::binary);
+        if (input && !_geocodeCache->read(input)) _geocodeCache->clear();
+    }
+    return self;
+}
+
+
+#pragma mark - Class Methods
+#pragma mark Private
+/**
+ * Geocode cache policy built from the app's geocoding settings
+ */
++ (rtc::GeocodePolicy)geocodePolicy
+{
+    rtc::GeocodePolicy policy;
+    policy.cellSize = kRTCGeocodeCacheCellSize;
+    policy.maxAge = kRTCGeocodeCacheMaxAge;
+    policy.maxEntries = (unsigned)kRTCGeocodeCacheMaxEntries;
+    policy.minLookupInterval = kRTCGeocodeMinLookupInterval;
+    policy.failureBackoff = kRTCGeocodeFailureBackoff;
+    return policy;
+}
+
++ (std::string)bytesFromPlacemark:(CLPlacemark *)placemark
+{
+    NSData *data = [NSKeyedArchiver archivedDataWithRootObject:placemark];
+    return std::string((const char *)[data bytes], [data length]);
+}
+
++ (CLPlacemark *)placemarkFromBytes:(const std::string &)bytes
+{
+    NSData *data = [NSData dataWithBytes:bytes.data() length:bytes.size()];
+    id placemark = nil;
+    @try {
+        placemark = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+    } @catch (NSException *exception) {
+        placemark = nil;
+    }
+    return [placemark isKindOfClass:[CLPlacemark class]] ? placemark : nil;
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Private
+/**
+ * Get the placemark of a location, waiting behind user requests if this is a
+ * background one.
+ */
+- (void)reverseGeocodeLocation:(CLLocation *)location
+                      priority:(rtc::GeocodeCache::Priority)priority
+                    completion:(RTCGeocodeCompletion)completion
+{
+    rtc::GeoPoint point(location.coordinate.latitude, location.coordinate.longitude);
+    rtc::GeocodeCache::RequestID requestID = ++_lastRequestID;
+    std::string bytes;
+
+    if (_geocodeCache->request(point, requestID, priority, &bytes) == rtc::GeocodeCache::RequestCached) {
+        rtc::Tracer::sharedTracer().addCounter("geocode.cacheHits");
+        if (completion) completion([RTCGeocodingManager placemarkFromBytes:bytes], nil);
+        return;
+    }
+
+    if (completion) self.completions[@(requestID)] = [completion copy];
+    [self pumpLookups];
+}
+
+/**
+ * Start the next lookup if one may start now, else come back when one may.
+ */
+- (void)pumpLookups
+{
+    double next = _geocodeCache->nextLookupTime();
+    if (std::isinf(next)) return;
+
+    double delay = next - rtc::SystemClock::sharedClock().now();
+    if (delay > 0) {
+        if (self.pumpTimer) return;
+        __weak RTCGeocodingManager *weakSelf = self;
+        self.pumpTimer = [[RTCWorkScheduler sharedScheduler] performBlock:^{
+            weakSelf.pumpTimer = nil;
+            [weakSelf pumpLookups];
+        } onQueue:[RTCWorkQueue mainQueue] afterDelay:delay];
+        return;
+    }
+
+    rtc::GeoPoint point;
+    if (!_geocodeCache->startLookup(&point)) return;
+
+    CLLocation *location = [[CLLocation alloc] initWithLatitude:point.latitude longitude:point.longitude];
+    rtc::Tracer::SpanID span = rtc::Tracer::sharedTracer().beginSpan("geocode.lookup");
+    [self.geocoder reverseGeocodeLocation:location completionHandler:^(NSArray *placemarks, NSError *error) {
+        rtc::Tracer::sharedTracer().endSpan(span);
+        CLPlacemark *placemark = [placemarks lastObject];
+        std::string bytes = placemark ? [RTCGeocodingManager bytesFromPlacemark:placemark] : std::string();
+        std::vector<rtc::GeocodeCache::RequestID> answered = _geocodeCache->finishLookup(placemark != nil, bytes);
+        if (placemark) self.dirty = YES;
+
+        for (size_t i = 0; i < answered.size(); ++i) {
+            RTCGeocodeCompletion completion = self.completions[@(answered[i])];
+            [self.completions removeObjectForKey:@(answered[i])];
+            if (completion) completion(placemark, placemark ? nil : error);
+        }
+
+        [self pumpLookups];
+    }];
+}
+
+
+#pragma mark Public
+- (void)reverseGeocodeLocation:(CLLocation *)location completion:(RTCGeocodeCompletion)completion
+{
+    [self reverseGeocodeLocation:location priority:rtc::GeocodeCache::PriorityUser completion:completion];
+}
+
+- (void)geocodePlacesMissingPlacemarksWithWriter:(RTCBackgroundWriter *)writer
+{
+    [writer performWrite:^(NSManagedObjectContext *context) {
+        NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+        request.predicate = [NSPredicate predicateWithFormat:@"placemarkRecord == nil AND latitude != nil AND longitude != nil"];
+        NSArray *places = [context executeFetchRequest:request error:NULL];
+
+        // the places may be gone by the time their placemarks come in, so
+        //   hold on to their IDs rather than the places
+        NSMutableArray *placeIDs = [[NSMutableArray alloc] initWithCapacity:[places count]];
+        NSMutableArray *locations = [[NSMutableArray alloc] initWithCapacity:[places count]];
+        for (RTCPlace *place in places) {
+            [placeIDs addObject:place.objectID];
+            [locations addObject:place.location];
+        }
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            for (NSUInteger i = 0; i < [placeIDs count]; ++i) {
+                NSManagedObjectID *placeID = placeIDs[i];
+                [self reverseGeocodeLocation:locations[i]
+                                    priority:rtc::GeocodeCache::PriorityBackground
+                                  completion:^(CLPlacemark *placemark, NSError *error) {
+                                      if (!placemark) return;
+                                      [writer performWrite:^(NSManagedObjectContext *context) {
+                                          RTCPlace *place = (RTCPlace *)[context existingObjectWithID:placeID error:NULL];
+                                          if (place && !place.placemark) place.placemark = placemark;
+                                      }];
+                                  }];
+            }
+        });
+    }];
+}
+
+- (BOOL)saveCache
+{
+    if (!self.dirty) return YES;
+
+    std::ofstream output([[self.cacheURL path] fileSystemRepresentation], std::ios::binary | std::ios::trunc);
+    _geocodeCache->write(output);
+    output.close();
+    if (!output) return NO;
+
+    self.dirty = NO;
+    return YES;
+}
+
+@end
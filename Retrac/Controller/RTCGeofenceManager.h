@@ -0,0 +1,63 @@
+//
+//  RTCGeofenceManager.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/23/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * RTCGeofenceManager is a singleton class that watches the saved places in
+ * the background. It posts kRTCPlaceArrivalNotification and
+ * kRTCPlaceDepartureNotification as the user comes and goes, and
+ * kRTCPlaceOverdueNotification when they haven't made it back to a place
+ * within its timeout. Departing a place with a timeout also schedules a local
+ * notification for when it runs out, cancelled on arrival, so the user hears
+ * about it even if the app isn't running.
+ *
+ * Deciding what counts as an arrival or departure is left to
+ * rtc::GeofenceEngine; this class just owns CoreLocation and Core Data. Only
+ * the places nearest the user are registered for region monitoring, to stay
+ * within the OS's limit, along with a region around the user whose exit means
+ * picking them again. Location updates are only turned on for a short while to
+ * confirm a crossing those regions wake us up for.
+ *
+ * It has its own CLLocationManager rather than sharing RTCLocationManager's:
+ * region and significant-change events go to the delegate of the manager that
+ * started them, and mustn't be taken for one-off location updates.
+ */
+@interface RTCGeofenceManager : NSObject
+
+#pragma mark - Properties
+/**
+ * Are places being monitored?
+ */
+@property (nonatomic, readonly) BOOL monitoring;
+
+
+#pragma mark - Class Methods
+/**
+ * Single instance manager.
+ * It creates the instance if this hasn't been done or simply returns it.
+ *
+ * @return An initialized RTCGeofenceManager object.
+ */
++ (instancetype)sharedManager;
+
+
+#pragma mark - Instance Methods
+/**
+ * Start watching the places in RTCModelManager's managedObjectContext, and any
+ * added later. Does nothing if the device can't monitor regions or location
+ * services are disabled for the app.
+ */
+- (void)startMonitoringPlaces;
+
+/**
+ * Stop watching places and give up all monitored regions.
+ */
+- (void)stopMonitoringPlaces;
+
+@end
@@ -0,0 +1,589 @@
+//
+//  RTCGeofenceManager.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/23/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCGeofenceManager.h"
+#import <CoreLocation/CoreLocation.h>
+#import "RTCModelManager.h"
+#import "RTCPlace.h"
+#import "RTCWorkScheduler.h"
+#include <cmath>
+#include <memory>
+#include <unordered_map>
+#include "RTCGeofenceEngine.h"
+
+#pragma mark - Constants
+// identifier of the region whose exit means picking the monitored places again.
+//   Places' regions are identified by their object URI.
+static NSString *const kRefreshRegionIdentifier = @"RTCGeofenceRefreshRegion";
+
+// local notification userInfo key for the object URI of the overdue place
+static NSString *const kOverduePlaceKey = @"overduePlace";
+
+
+@interface RTCGeofenceManager () <CLLocationManagerDelegate> {
+    // arrival/departure/overdue decisions. We just own CoreLocation, the
+    // timers and the mapping to Core Data.
+    std::unique_ptr<rtc::GeofenceEngine> _engine;
+
+    // every place being watched, as the engine wants them
+    std::unordered_map<rtc::GeofenceEngine::PlaceID, rtc::GeofenceEngine::Place> _places;
+    rtc::GeofenceEngine::PlaceID _nextPlaceID;
+}
+
+@property (strong, nonatomic) CLLocationManager *locationManager;
+@property (strong, nonatomic) NSManagedObjectContext *managedObjectContext;
+@property (nonatomic, readwrite) BOOL monitoring;
+
+// the engine knows places by integer ID; these map them to Core Data objects
+@property (strong, nonatomic) NSMutableDictionary *objectIDsByPlaceID;  // NSNumber -> NSManagedObjectID
+@property (strong, nonatomic) NSMutableDictionary *placeIDsByObjectID;  // NSManagedObjectID -> NSNumber
+
+// is a call to assignPlaces already scheduled?
+@property (nonatomic) BOOL assignScheduled;
+
+// are location updates on to confirm a crossing?
+@property (nonatomic) BOOL confirming;
+
+@property (strong, nonatomic) RTCTimer *confirmingTimeout;  // turns confirming off
+@property (strong, nonatomic) RTCTimer *overdueTimeout;     // engine's pending timeout
+
+@end
+
+
+@implementation RTCGeofenceManager
+
+#pragma mark - Properties
+@synthesize locationManager = _locationManager;
+
+- (CLLocationManager *)locationManager
+{
+    // lazy instantiation
+    if (!_locationManager) {
+        _locationManager = [[CLLocationManager alloc] init];
+        _locationManager.delegate = self;
+    }
+    return _locationManager;
+}
+
+- (void)setManagedObjectContext:(NSManagedObjectContext *)managedObjectContext
+{
+    if (_managedObjectContext == managedObjectContext) return;
+
+    [[NSNotificationCenter defaultCenter] removeObserver:self
+                                                    name:NSManagedObjectContextObjectsDidChangeNotification
+                                                  object:_managedObjectContext];
+    _managedObjectContext = managedObjectContext;
+    if (managedObjectContext) {
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(contextObjectsDidChange:)
+                                                     name:NSManagedObjectContextObjectsDidChangeNotification
+                                                   object:managedObjectContext];
+    }
+}
+
+
+#pragma mark - Class methods
+#pragma mark Public
+// Declare a static variable, which is an instance of this class
+// It is initialized once and only once in a thread-safe manner by using
+//   Grand Central Dispatch (GCD)
++ (instancetype)sharedManager
+{
+    static RTCGeofenceManager *sharedInstance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [[self alloc] initPrivate];
+    });
+    return sharedInstance;
+}
+
+
+#pragma mark - Initialization
+// if a programmer calls [RTCGeofenceManager alloc] init], let them know the
+//   error of their ways.
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"Singleton"
+                                   reason:@"Use + [RTCGeofenceManager sharedManager]"
+                                 userInfo:nil];
+    return nil;
+}
+
+// here is the real (secret) initializer
+// this is the official designated initializer so it will call the designated
+//   initializer of the superclass
+- (instancetype)initPrivate
+{
+    self = [super init];
+    if (self) {
+        // custom initialization here...
+        _engine.reset(new rtc::GeofenceEngine(rtc::SystemClock::sharedClock(),
+                                              [RTCGeofenceManager geofencePolicy]));
+        _nextPlaceID = 1;
+        _objectIDsByPlaceID = [[NSMutableDictionary alloc] init];
+        _placeIDsByObjectID = [[NSMutableDictionary alloc] init];
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(managedObjectContextReady:)
+                                                     name:kRTCMOCAvailableNotification
+                                                   object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(managedObjectContextDeleted:)
+                                                     name:kRTCMOCDeletedNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+#pragma mark - Deallocation
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self.confirmingTimeout cancel];
+    [self.overdueTimeout cancel];
+}
+
+
+#pragma mark - Class Methods
+#pragma mark Private
+/**
+ * Geofence engine policy built from the app's geofence settings
+ */
++ (rtc::GeofencePolicy)geofencePolicy
+{
+    rtc::GeofencePolicy policy;
+    policy.maxRegions = (unsigned)kRTCGeofenceMaxRegions;
+    policy.radius = kRTCGeofenceRadius;
+    policy.exitHysteresis = kRTCGeofenceExitHysteresis;
+    policy.maxAccuracy = kRTCGeofenceMaxAccuracy;
+    policy.dwellTime = kRTCGeofenceDwellTime;
+    policy.minRefreshRadius = kRTCGeofenceMinRefreshRadius;
+    policy.maxRefreshRadius = kRTCGeofenceMaxRefreshRadius;
+    return policy;
+}
+
+/**
+ * Convert a CLLocation to the engine's representation
+ */
++ (rtc::LocationFix)fixFromLocation:(CLLocation *)location
+{
+    return rtc::LocationFix([location.timestamp timeIntervalSince1970],
+                            location.coordinate.latitude,
+                            location.coordinate.longitude,
+                            location.horizontalAccuracy);
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Public
+- (void)startMonitoringPlaces
+{
+    if (self.monitoring) return;
+
+    CLAuthorizationStatus authStatus = [CLLocationManager authorizationStatus];
+    if (![CLLocationManager isMonitoringAvailableForClass:[CLCircularRegion class]] ||
+        ![CLLocationManager significantLocationChangeMonitoringAvailable] ||
+        (authStatus == kCLAuthorizationStatusDenied) ||
+        (authStatus == kCLAuthorizationStatusRestricted)) {
+        return;
+    }
+
+    self.monitoring = YES;
+    if (!self.managedObjectContext) {
+        self.managedObjectContext = [RTCModelManager sharedManager].managedObjectContext;
+        if (self.managedObjectContext) [self loadPlaces];
+    }
+
+    // the first significant-change update comes right away and sets up the
+    //   regions
+    [self.locationManager startMonitoringSignificantLocationChanges];
+    if (_engine->hasPosition()) [self updateMonitoredRegions];
+}
+
+- (void)stopMonitoringPlaces
+{
+    if (!self.monitoring) return;
+    self.monitoring = NO;
+
+    [self.locationManager stopMonitoringSignificantLocationChanges];
+    [self stopConfirming];
+    [self.overdueTimeout cancel];
+    self.overdueTimeout = nil;
+
+    // monitored regions outlive the app, so don't leave any behind
+    for (CLRegion *region in self.locationManager.monitoredRegions) {
+        [self.locationManager stopMonitoringForRegion:region];
+    }
+}
+
+
+#pragma mark Private
+/**
+ * Load every place's object ID, coordinate and timeout with a single fetch;
+ * no RTCPlace objects are materialized.
+ */
+- (void)loadPlaces
+{
+    _places.clear();
+
+    NSExpressionDescription *objectIDDescription = [[NSExpressionDescription alloc] init];
+    objectIDDescription.name = @"objectID";
+    objectIDDescription.expression = [NSExpression expressionForEvaluatedObject];
+    objectIDDescription.expressionResultType = NSObjectIDAttributeType;
+
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    request.predicate = [NSPredicate predicateWithFormat:@"latitude != nil AND longitude != nil"];
+    request.resultType = NSDictionaryResultType;
+    request.propertiesToFetch = @[objectIDDescription, @"latitude", @"longitude", @"timeout"];
+    NSArray *rows = [self.managedObjectContext executeFetchRequest:request error:NULL];
+
+    for (NSDictionary *row in rows) {
+        rtc::GeofenceEngine::PlaceID placeID = [self assignPlaceIDToObjectID:row[@"objectID"]];
+        rtc::GeoPoint coordinate([row[@"latitude"] doubleValue], [row[@"longitude"] doubleValue]);
+        _places[placeID] = rtc::GeofenceEngine::Place(placeID, coordinate, [row[@"timeout"] doubleValue]);
+    }
+    [self scheduleAssignPlaces];
+}
+
+- (rtc::GeofenceEngine::PlaceID)assignPlaceIDToObjectID:(NSManagedObjectID *)objectID
+{
+    NSNumber *placeID = self.placeIDsByObjectID[objectID];
+    if (!placeID) {
+        placeID = @(_nextPlaceID++);
+        self.placeIDsByObjectID[objectID] = placeID;
+        self.objectIDsByPlaceID[placeID] = objectID;
+    }
+    return [placeID unsignedLongLongValue];
+}
+
+- (void)forgetObjectID:(NSManagedObjectID *)objectID
+{
+    NSNumber *placeID = self.placeIDsByObjectID[objectID];
+    if (!placeID) return;
+
+    _places.erase([placeID unsignedLongLongValue]);
+    [self.placeIDsByObjectID removeObjectForKey:objectID];
+    [self.objectIDsByPlaceID removeObjectForKey:placeID];
+}
+
+/**
+ * Hand the places to the engine once the current run loop pass is done, so a
+ * burst of changes is only assigned once.
+ */
+- (void)scheduleAssignPlaces
+{
+    if (self.assignScheduled) return;
+    self.assignScheduled = YES;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        self.assignScheduled = NO;
+        [self assignPlaces];
+    });
+}
+
+- (void)assignPlaces
+{
+    std::vector<rtc::GeofenceEngine::Place> places;
+    places.reserve(_places.size());
+    for (std::unordered_map<rtc::GeofenceEngine::PlaceID, rtc::GeofenceEngine::Place>::const_iterator it = _places.begin();
+         it != _places.end(); ++it) {
+        places.push_back(it->second);
+    }
+
+    if (_engine->assignPlaces(places)) {
+        std::vector<rtc::GeofenceEngine::Event> events;
+        [self engineRegionsChanged:YES events:events];
+    }
+}
+
+/**
+ * Act on what the engine made of a fix: sync the monitored regions if they
+ * changed, post the events, and see whether it needs more fixes or a timer.
+ */
+- (void)engineRegionsChanged:(BOOL)regionsChanged events:(const std::vector<rtc::GeofenceEngine::Event> &)events
+{
+    if (!self.monitoring) return;
+
+    if (regionsChanged) [self updateMonitoredRegions];
+    [self postEvents:events];
+
+    if (_engine->awaitingConfirmation()) {
+        [self startConfirming];
+    } else {
+        [self stopConfirming];
+    }
+    [self performOverdueTimeoutAtDeadline];
+}
+
+/**
+ * Have the OS monitor exactly the engine's regions, leaving alone those that
+ * are already right.
+ */
+- (void)updateMonitoredRegions
+{
+    CLLocationDistance maxRadius = self.locationManager.maximumRegionMonitoringDistance;
+
+    NSMutableDictionary *wanted = [[NSMutableDictionary alloc] init];  // identifier -> CLCircularRegion
+    std::vector<rtc::GeofenceEngine::Region> regions = _engine->regions();
+    for (size_t i = 0; i < regions.size(); ++i) {
+        NSManagedObjectID *objectID = self.objectIDsByPlaceID[@(regions[i].placeID)];
+        if (!objectID) continue;
+        NSString *identifier = [[objectID URIRepresentation] absoluteString];
+        CLLocationCoordinate2D center = CLLocationCoordinate2DMake(regions[i].center.latitude, regions[i].center.longitude);
+        wanted[identifier] = [[CLCircularRegion alloc] initWithCenter:center
+                                                               radius:MIN(regions[i].radius, maxRadius)
+                                                           identifier:identifier];
+    }
+
+    const rtc::GeofenceEngine::Region &refresh = _engine->refreshRegion();
+    CLCircularRegion *refreshRegion = [[CLCircularRegion alloc] initWithCenter:CLLocationCoordinate2DMake(refresh.center.latitude, refresh.center.longitude)
+                                                                        radius:MIN(refresh.radius, maxRadius)
+                                                                    identifier:kRefreshRegionIdentifier];
+    refreshRegion.notifyOnEntry = NO;
+    wanted[kRefreshRegionIdentifier] = refreshRegion;
+
+    for (CLRegion *region in self.locationManager.monitoredRegions) {
+        CLCircularRegion *want = wanted[region.identifier];
+        if (want && [region isKindOfClass:[CLCircularRegion class]] &&
+            (want.notifyOnEntry == region.notifyOnEntry) &&
+            (want.radius == ((CLCircularRegion *)region).radius) &&
+            (want.center.latitude == ((CLCircularRegion *)region).center.latitude) &&
+            (want.center.longitude == ((CLCircularRegion *)region).center.longitude)) {
+            [wanted removeObjectForKey:region.identifier];
+        } else if (!want) {
+            [self.locationManager stopMonitoringForRegion:region];
+        }
+    }
+    // a region with the same identifier replaces the old one
+    for (CLCircularRegion *region in [wanted allValues]) {
+        [self.locationManager startMonitoringForRegion:region];
+    }
+}
+
+/**
+ * Post a notification for each event, and schedule or cancel the place's
+ * local overdue notification.
+ */
+- (void)postEvents:(const std::vector<rtc::GeofenceEngine::Event> &)events
+{
+    for (size_t i = 0; i < events.size(); ++i) {
+        const rtc::GeofenceEngine::Event &event = events[i];
+        NSManagedObjectID *objectID = self.objectIDsByPlaceID[@(event.placeID)];
+        RTCPlace *place = objectID ? (RTCPlace *)[self.managedObjectContext existingObjectWithID:objectID error:NULL] : nil;
+        if (!place) continue;
+
+        NSString *name = nil;
+        switch (event.type) {
+            case rtc::GeofenceEngine::Event::TypeArrival:
+                name = kRTCPlaceArrivalNotification;
+                [self cancelOverdueNotificationForPlace:place];
+                break;
+
+            case rtc::GeofenceEngine::Event::TypeDeparture:
+                name = kRTCPlaceDepartureNotification;
+                if ([place.timeout doubleValue] > 0) {
+                    [self scheduleOverdueNotificationForPlace:place
+                                                       atDate:[NSDate dateWithTimeIntervalSince1970:event.time + [place.timeout doubleValue]]];
+                }
+                break;
+
+            case rtc::GeofenceEngine::Event::TypeOverdue:
+                name = kRTCPlaceOverdueNotification;
+                break;
+        }
+        [[NSNotificationCenter defaultCenter] postNotificationName:name object:place];
+    }
+}
+
+- (void)scheduleOverdueNotificationForPlace:(RTCPlace *)place atDate:(NSDate *)fireDate
+{
+    [self cancelOverdueNotificationForPlace:place];
+
+    UILocalNotification *notification = [[UILocalNotification alloc] init];
+    notification.fireDate = fireDate;
+    notification.alertBody = [NSString stringWithFormat:@"You haven't made it back to %@ yet.", place.name];
+    notification.soundName = UILocalNotificationDefaultSoundName;
+    notification.userInfo = @{kOverduePlaceKey : [[place.objectID URIRepresentation] absoluteString]};
+    [[UIApplication sharedApplication] scheduleLocalNotification:notification];
+}
+
+- (void)cancelOverdueNotificationForPlace:(RTCPlace *)place
+{
+    NSString *uri = [[place.objectID URIRepresentation] absoluteString];
+    for (UILocalNotification *notification in [[UIApplication sharedApplication] scheduledLocalNotifications]) {
+        if ([notification.userInfo[kOverduePlaceKey] isEqualToString:uri]) {
+            [[UIApplication sharedApplication] cancelLocalNotification:notification];
+        }
+    }
+}
+
+/**
+ * Turn on location updates till the engine has seen enough fixes to settle,
+ * or kRTCGeofenceMaxConfirmationTime passes.
+ */
+- (void)startConfirming
+{
+    if (self.confirming) return;
+    self.confirming = YES;
+
+    self.locationManager.desiredAccuracy = kCLLocationAccuracyNearestTenMeters;
+    self.locationManager.distanceFilter = kCLDistanceFilterNone;
+    [self.locationManager startUpdatingLocation];
+    __weak RTCGeofenceManager *weakSelf = self;
+    self.confirmingTimeout = [[RTCWorkScheduler sharedScheduler] performBlock:^{ [weakSelf stopConfirming]; }
+                                                                      onQueue:[RTCWorkQueue mainQueue]
+                                                                   afterDelay:kRTCGeofenceMaxConfirmationTime];
+}
+
+- (void)stopConfirming
+{
+    [self.confirmingTimeout cancel];
+    self.confirmingTimeout = nil;
+    if (!self.confirming) return;
+    self.confirming = NO;
+
+    [self.locationManager stopUpdatingLocation];
+}
+
+/**
+ * (Re)schedule the overdue timer at the engine's current deadline.
+ */
+- (void)performOverdueTimeoutAtDeadline
+{
+    [self.overdueTimeout cancel];
+    self.overdueTimeout = nil;
+    if (std::isinf(_engine->deadline())) return;
+    __weak RTCGeofenceManager *weakSelf = self;
+    self.overdueTimeout = [[RTCWorkScheduler sharedScheduler] performBlock:^{ [weakSelf overdueTimedOut]; }
+                                                                   onQueue:[RTCWorkQueue mainQueue]
+                                                                afterDelay:_engine->timeoutDelay()];
+}
+
+- (void)overdueTimedOut
+{
+    self.overdueTimeout = nil;
+    std::vector<rtc::GeofenceEngine::Event> events;
+    _engine->handleTimeout(events);
+    [self engineRegionsChanged:NO events:events];
+}
+
+
+#pragma mark - Notification Observer Methods
+- (void)managedObjectContextReady:(NSNotification *)notification
+{
+    // a new document, or places imported past our context: start over
+    self.managedObjectContext = [RTCModelManager sharedManager].managedObjectContext;
+    [self loadPlaces];
+}
+
+- (void)managedObjectContextDeleted:(NSNotification *)notification
+{
+    // the engine keeps watching the places it has till the next document
+    self.managedObjectContext = nil;
+}
+
+/**
+ * Keep the places in step with inserts, deletes, moves and timeout changes in
+ * our context
+ */
+- (void)contextObjectsDidChange:(NSNotification *)notification
+{
+    NSDictionary *userInfo = [notification userInfo];
+
+    // the context was reset under us, so start over
+    if (userInfo[NSInvalidatedAllObjectsKey]) {
+        [self loadPlaces];
+        return;
+    }
+
+    for (NSManagedObject *object in userInfo[NSDeletedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) [self forgetObjectID:object.objectID];
+    }
+
+    NSMutableArray *insertedPlaces = [[NSMutableArray alloc] init];
+    for (NSManagedObject *object in userInfo[NSInsertedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) [insertedPlaces addObject:object];
+    }
+    // track by permanent ID so places keep their region across the next save
+    if ([insertedPlaces count]) {
+        [self.managedObjectContext obtainPermanentIDsForObjects:insertedPlaces error:NULL];
+    }
+
+    NSArray *updatedPlaces = [[userInfo[NSUpdatedObjectsKey] allObjects]
+                              arrayByAddingObjectsFromArray:[userInfo[NSRefreshedObjectsKey] allObjects]];
+    for (RTCPlace *place in [insertedPlaces arrayByAddingObjectsFromArray:updatedPlaces]) {
+        if (![place isKindOfClass:[RTCPlace class]] || [place isDeleted]) continue;
+
+        if (place.latitude && place.longitude) {
+            rtc::GeofenceEngine::PlaceID placeID = [self assignPlaceIDToObjectID:place.objectID];
+            rtc::GeoPoint coordinate([place.latitude doubleValue], [place.longitude doubleValue]);
+            _places[placeID] = rtc::GeofenceEngine::Place(placeID, coordinate, [place.timeout doubleValue]);
+        } else {
+            [self forgetObjectID:place.objectID];
+        }
+    }
+    [self scheduleAssignPlaces];
+}
+
+
+#pragma mark - CLLocationManagerDelegate
+#pragma mark Responding to Location Events
+/**
+ * Significant-change updates and the updates turned on to confirm a crossing
+ * both land here. See rtc::GeofenceEngine for what is made of them.
+ */
+- (void)locationManager:(CLLocationManager *)manager didUpdateLocations:(NSArray *)locations
+{
+    bool regionsChanged = false;
+    std::vector<rtc::GeofenceEngine::Event> events;
+    for (CLLocation *location in locations) {
+        if (_engine->processFix([RTCGeofenceManager fixFromLocation:location], events)) regionsChanged = true;
+    }
+    [self engineRegionsChanged:regionsChanged events:events];
+}
+
+- (void)locationManager:(CLLocationManager *)manager didFailWithError:(NSError *)error
+{
+    if ([error code] == kCLErrorDenied) [self stopMonitoringPlaces];
+
+    // Note we ignore the location "unknown" error: the manager just can't get
+    // a location right now, and stopConfirming is already scheduled.
+}
+
+#pragma mark Responding to Region Events
+- (void)locationManager:(CLLocationManager *)manager didEnterRegion:(CLRegion *)region
+{
+    [self processRegionCrossing:region exited:NO];
+}
+
+- (void)locationManager:(CLLocationManager *)manager didExitRegion:(CLRegion *)region
+{
+    [self processRegionCrossing:region exited:YES];
+}
+
+- (void)locationManager:(CLLocationManager *)manager monitoringDidFailForRegion:(CLRegion *)region withError:(NSError *)error
+{
+    NSLog(@"[%@ %@] %@ (%@)", NSStringFromClass([self class]), NSStringFromSelector(_cmd), [error localizedDescription], region.identifier);
+}
+
+/**
+ * A region crossing is only a hint; the engine decides from the fix the OS
+ * woke us up with, and asks for more if that isn't enough.
+ */
+- (void)processRegionCrossing:(CLRegion *)region exited:(BOOL)exited
+{
+    CLLocation *location = self.locationManager.location;
+    if (!location) return;
+
+    rtc::LocationFix fix = [RTCGeofenceManager fixFromLocation:location];
+    std::vector<rtc::GeofenceEngine::Event> events;
+    bool regionsChanged = (exited && [region.identifier isEqualToString:kRefreshRegionIdentifier]) ?
+        _engine->processRefreshRegionExit(fix, events) : _engine->processFix(fix, events);
+    [self engineRegionsChanged:regionsChanged events:events];
+}
+
+@end
@@ -7,8 +7,9 @@
 //
 
 #import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
 
-@class CLLocation;
+@class RTCPlace;
 
 typedef void (^RTCLocationManagerCompletion)(CLLocation *location, NSError *error);
 
@@ -18,9 +19,16 @@ typedef void (^RTCLocationManagerCompletion)(CLLocation *location, NSError *erro
  * This way we ensure we only have one location manager working and don't have to
  * duplicate code everywhere.
  *
- * Attempts to acquire a location measurement with a predetermined level of 
- * accuracy. A timeout is used to avoid wasting power in the case where a 
- * sufficiently accurate measurement cannot be acquired.
+ * Attempts to acquire a location measurement with the level of accuracy each
+ * caller asks for. A recent enough location is handed straight back; otherwise
+ * location updates start at a cheap desired accuracy and only move up to a
+ * more power hungry one while that keeps improving the location. Concurrent
+ * requests share the one acquisition. A timeout is used to avoid wasting power
+ * in the case where a sufficiently accurate measurement cannot be acquired.
+ *
+ * It can also record a breadcrumb trail from a place: updates keep streaming
+ * into the place's trail file, simplified as they arrive, until the recording
+ * is stopped. A one-off location request can run alongside a recording.
  *
  * @ref https://developer.apple.com/library/ios/samplecode/locateme/Introduction/Intro.html
  */
@@ -29,9 +37,15 @@ typedef void (^RTCLocationManagerCompletion)(CLLocation *location, NSError *erro
 #pragma mark - Properties
 /**
  * location is set to last retrieved value from `updateCurrentLocation:`
+ * and friends
  */
 @property (nonatomic, strong, readonly) CLLocation *location;
 
+/**
+ * Place whose trail is being recorded, nil if not recording
+ */
+@property (nonatomic, strong, readonly) RTCPlace *recordingPlace;
+
 
 #pragma mark - Class Methods
 /**
@@ -60,4 +74,35 @@ typedef void (^RTCLocationManagerCompletion)(CLLocation *location, NSError *erro
  */
 - (void)updateCurrentLocation:(RTCLocationManagerCompletion)completion failure:(void (^)())failure;
 
+/**
+ * Get current location to a given accuracy. Calls made while another is still
+ * getting a location don't cancel it; each gets its own completion.
+ *
+ * @param accuracy      meters of accuracy wanted. The completion may get a
+ *                      worse location if that is the best there is.
+ * @param maximumAge    seconds old the last location may be and still do
+ * @param completion    block to be called when we are done getting a location,
+ *                      as in `updateCurrentLocation:failure:`
+ * @param failure       block to be called when location services are disabled.
+ */
+- (void)updateCurrentLocationWithAccuracy:(CLLocationAccuracy)accuracy
+                               maximumAge:(NSTimeInterval)maximumAge
+                               completion:(RTCLocationManagerCompletion)completion
+                                  failure:(void (^)())failure;
+
+/**
+ * Start recording a breadcrumb trail from a place, appending to any trail it
+ * already has. Stops any other recording first.
+ *
+ * @param place         place to record the trail of
+ * @param failure       block to be called when location services are disabled
+ *                      or the trail file can't be opened.
+ */
+- (void)startRecordingTrailForPlace:(RTCPlace *)place failure:(void (^)())failure;
+
+/**
+ * Stop recording, keeping the last location update in the trail.
+ */
+- (void)stopRecordingTrail;
+
 @end
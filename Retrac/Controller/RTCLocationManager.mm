@@ -0,0 +1,571 @@
+//
+//  RTCLocationManager.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/3/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCLocationManager.h"
+#import <CoreLocation/CoreLocation.h>
+#import "RTCPlace+Trail.h"
+#import "RTCWorkScheduler.h"
+#include <fstream>
+#include <map>
+#include <memory>
+#include "RTCAccuracyScheduler.h"
+#include "RTCTrace.h"
+#include "RTCTrail.h"
+
+@interface RTCLocationManager () <CLLocationManagerDelegate> {
+    // decides how accurate CoreLocation should be asked to be and when each
+    // request is done; we just own the timers and CoreLocation.
+    std::unique_ptr<rtc::AccuracyScheduler> _scheduler;
+    
+    // trace span of each request still waiting on a location
+    std::map<rtc::AccuracyScheduler::RequestID, rtc::Tracer::SpanID> _requestSpans;
+
+    // trail recording: fixes go through the simplifier and whatever it
+    // commits is appended to the recording place's trail file.
+    std::unique_ptr<rtc::TrailSimplifier> _trailSimplifier;
+    std::unique_ptr<std::ofstream> _trailFile;
+    double _trailStartTime;         // trail file's time origin
+    double _recordingStartTime;     // when this recording started
+}
+
+@property (nonatomic, strong) NSMutableDictionary *completionBlocks;   // by request ID
+
+@property (strong, nonatomic) CLLocationManager *locationManager;
+@property (strong, nonatomic) RTCTimer *locationTimeout;            // scheduler's pending timeout
+@property (strong, nonatomic) CLLocation *bestLocation;             // best location so far
+@property (strong, nonatomic) CLLocation *latestLocation;           // scheduler's cached fix
+@property (strong, nonatomic, readwrite) CLLocation *location;      // cached location
+@property (strong, nonatomic, readwrite) RTCPlace *recordingPlace;
+
+@end
+
+
+@implementation RTCLocationManager
+
+#pragma mark - Properties
+@synthesize locationManager = _locationManager;
+
+- (CLLocationManager *)locationManager
+{
+    // lazy instantiation
+    if (!_locationManager) {
+        _locationManager = [[CLLocationManager alloc] init];
+        _locationManager.delegate = self;
+    }
+    return _locationManager;
+}
+
+- (void)setLocationManager:(CLLocationManager *)locationManager
+{
+    // cleanup first
+    [_locationManager stopUpdatingLocation];
+    // now update instance variable
+    _locationManager = locationManager;
+}
+
+#pragma mark - Class methods
+#pragma mark Public
+// Declare a static variable, which is an instance of this class
+// It is initialized once and only once in a thread-safe manner by using
+//   Grand Central Dispatch (GCD)
++ (instancetype)sharedManager
+{
+    static RTCLocationManager *sharedInstance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [[self alloc] initPrivate];
+    });
+    return sharedInstance;
+}
+
+/**
+ * Show error message indicating location is disabled for app
+ */
++ (void)showLocationDisabledErrorAlert
+{
+    UIAlertView *alertView = [[UIAlertView alloc] initWithTitle:@"Oops. That didn't work!" message:kRTCErrorMsgLocationDisabled delegate:nil cancelButtonTitle:@"OK" otherButtonTitles:nil];
+    [alertView show];
+}
+
+
+#pragma mark - Initialization
+// ideally we would make the designated initializer of the superclass call
+//   the new designated initializer, but that doesn't make sense in this case.
+// if a programmer calls [RTCLocationManager alloc] init], let them know the error
+//   of their ways.
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"Singleton"
+                                   reason:@"Use + [RTCLocationManager sharedManager]"
+                                 userInfo:nil];
+    return nil;
+}
+
+// here is the real (secret) initializer
+// this is the official designated initializer so it will call the designated
+//   initializer of the superclass
+- (instancetype)initPrivate
+{
+    self = [super init];
+    if (self) {
+        // custom initialization here...
+        _scheduler.reset(new rtc::AccuracyScheduler(rtc::SystemClock::sharedClock(),
+                                                    [RTCLocationManager accuracyPolicy]));
+        _completionBlocks = [NSMutableDictionary dictionary];
+        _trailSimplifier.reset(new rtc::TrailSimplifier([RTCLocationManager trailPolicy]));
+    }
+    return self;
+}
+
+#pragma mark - Deallocation
+- (void)dealloc
+{
+    [self stopRecordingTrail];
+    
+    // stop and clear location manager
+    self.locationManager = nil;
+    
+    [self cancelLocationTimeout];
+}
+
+
+#pragma mark - Class Methods
+#pragma mark Private
+/**
+ * Location fix engine policy built from the app's location settings
+ */
++ (rtc::LocationFixPolicy)fixPolicy
+{
+    rtc::LocationFixPolicy policy;
+    policy.expiryTime = kRTCLocationUpdateExpiryTime;
+    policy.accuracyThreshold = kRTCLocationAccuracyThreshold;
+    policy.significantChange = kRTCLocationAccuracySignificantChange;
+    policy.attemptsMax = (unsigned)kRTCLocationAttemptsMax;
+    policy.maxWaitForBetter = kRTCLocationMaxWaitTimeForBetter;
+    policy.maxWaitForFirst = kRTCLocationMaxWaitTimeForFirst;
+    return policy;
+}
+
+/**
+ * Accuracy scheduler policy built from the app's location settings
+ */
++ (rtc::AccuracySchedulerPolicy)accuracyPolicy
+{
+    rtc::AccuracySchedulerPolicy policy;
+    policy.fix = [RTCLocationManager fixPolicy];
+    policy.levelWaitTime = kRTCLocationMaxWaitTimeAtLevel;
+    policy.maxCacheAge = kRTCLocationCacheMaxAge;
+    return policy;
+}
+
+/**
+ * Trail simplifier policy built from the app's trail settings
+ */
++ (rtc::TrailPolicy)trailPolicy
+{
+    rtc::TrailPolicy policy;
+    policy.maxAccuracy = kRTCTrailMaxAccuracy;
+    policy.minSpacing = kRTCTrailMinSpacing;
+    policy.tolerance = kRTCTrailTolerance;
+    policy.maxWindow = (unsigned)kRTCTrailMaxWindow;
+    return policy;
+}
+
+/**
+ * Convert a CLLocation to the fix engine's representation
+ */
++ (rtc::LocationFix)fixFromLocation:(CLLocation *)location
+{
+    return rtc::LocationFix([location.timestamp timeIntervalSince1970],
+                            location.coordinate.latitude,
+                            location.coordinate.longitude,
+                            location.horizontalAccuracy);
+}
+
+/**
+ * CoreLocation accuracy matching a scheduler level
+ */
++ (CLLocationAccuracy)desiredAccuracyForLevel:(rtc::AccuracyLevel)level
+{
+    switch (level) {
+        case rtc::AccuracyLevelThreeKilometers: return kCLLocationAccuracyThreeKilometers;
+        case rtc::AccuracyLevelKilometer:       return kCLLocationAccuracyKilometer;
+        case rtc::AccuracyLevelHundredMeters:   return kCLLocationAccuracyHundredMeters;
+        case rtc::AccuracyLevelNearestTenMeters:return kCLLocationAccuracyNearestTenMeters;
+        default:                                return kCLLocationAccuracyBest;
+    }
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Private
+/**
+ * Configure location manager for as much accuracy as is being asked of it: a
+ * trail recording always wants the best, a location request what the
+ * scheduler's current level is.
+ */
+- (void)configureLocationManager
+{
+    // If appropriate, configure the manager according to what kind of location
+    // updating you want.
+    self.locationManager.desiredAccuracy = (self.recordingPlace || !_scheduler->acquiring()) ?
+        kCLLocationAccuracyBest : [RTCLocationManager desiredAccuracyForLevel:_scheduler->level()];
+    
+    // Set a movement threshold for new events
+    self.locationManager.distanceFilter = kCLDistanceFilterNone; // tracks all movements
+    
+    // a trail recording is a walk, and shouldn't be paused by the system when
+    // the user stops for a moment
+    self.locationManager.activityType = CLActivityTypeFitness;
+    self.locationManager.pausesLocationUpdatesAutomatically = (self.recordingPlace == nil);
+    
+    // Then start the manager monitoring for location changes
+    [self.locationManager startUpdatingLocation];
+}
+
+/**
+ * Check if the hardware you are on/user supports location updating. We aren't
+ * able to use location services if:
+ * - The user disables location services in the Settings app or System Preferences.
+ * - The user denies location services for a specific app.
+ * - The device is in Airplane mode and unable to power up the necessary hardware.
+ *
+ * Location not guaranteed to be authorized yet even if it is available.
+ */
+- (BOOL)locationServicesAvailable
+{
+    CLAuthorizationStatus authStatus = [CLLocationManager authorizationStatus];
+    return ((authStatus != kCLAuthorizationStatusDenied) &&
+            (authStatus != kCLAuthorizationStatusRestricted) &&
+            [CLLocationManager locationServicesEnabled]);
+}
+
+/**
+ * Setup location manager if we are authorized to or show an error message
+ *
+ * @param failure       block to be called when location services are disabled and
+ *      after showing an error message.
+ */
+- (void)setupLocationServices:(void (^)())failure
+{
+    if (![self locationServicesAvailable]) {
+        [RTCLocationManager showLocationDisabledErrorAlert];
+        if (failure) failure();
+        
+    } else {
+        // If able to use location services, create location manager, and set
+        // the delegate to receive location updates.
+        // Location not guaranteed to be authorized yet (authStatus==kCLAuthorizationStatusAuthorized)
+        // but we will try our luck and wait for the appropriate delegate callback.
+        [self configureLocationManager];
+    }
+}
+
+/**
+ * Hand each finished request its location, and bring CoreLocation and the
+ * timeout in line with what the scheduler now wants.
+ *
+ * @param completed     scheduler completions to deliver
+ */
+- (void)deliverCompletions:(const std::vector<rtc::AccuracyScheduler::Completion> &)completed
+{
+    if (_scheduler->acquiring()) {
+        // a recording keeps its own accuracy; otherwise follow the level
+        if (!self.recordingPlace) {
+            self.locationManager.desiredAccuracy = [RTCLocationManager desiredAccuracyForLevel:_scheduler->level()];
+        }
+        [self performLocationTimeoutAtDeadline];
+    } else {
+        // since this is happening now, cancel timeout events
+        [self cancelLocationTimeout];
+        // a trail recording still needs the updates
+        if (!self.recordingPlace) [self.locationManager stopUpdatingLocation];
+    }
+    
+    for (size_t i = 0; i < completed.size(); ++i) {
+        const rtc::AccuracyScheduler::Completion &completion = completed[i];
+        NSNumber *requestID = @(completion.requestID);
+        RTCLocationManagerCompletion completionBlock = self.completionBlocks[requestID];
+        [self.completionBlocks removeObjectForKey:requestID]; // prevent this block from being called again.
+        
+        [self traceCompletion:completion];
+        
+        CLLocation *location = completion.hasFix ? [self locationForFix:completion.fix] : nil;
+        if (location) self.location = location;
+        if (completionBlock) completionBlock(location, nil);
+    }
+}
+
+/**
+ * End a request's trace span and record how it went
+ */
+- (void)traceCompletion:(const rtc::AccuracyScheduler::Completion &)completion
+{
+    rtc::Tracer &tracer = rtc::Tracer::sharedTracer();
+    std::map<rtc::AccuracyScheduler::RequestID, rtc::Tracer::SpanID>::iterator it = _requestSpans.find(completion.requestID);
+    if (it != _requestSpans.end()) {
+        tracer.endSpan(it->second);
+        _requestSpans.erase(it);
+    }
+    if (completion.fromCache) tracer.addCounter("location.cacheHits");
+    if (completion.hasFix) tracer.recordValue("location.accuracy", completion.fix.horizontalAccuracy);
+}
+
+/**
+ * The CLLocation a scheduler fix was made from, so callers get altitude,
+ * speed and all.
+ */
+- (CLLocation *)locationForFix:(const rtc::LocationFix &)fix
+{
+    if ([self.bestLocation.timestamp timeIntervalSince1970] == fix.timestamp) return self.bestLocation;
+    if ([self.latestLocation.timestamp timeIntervalSince1970] == fix.timestamp) return self.latestLocation;
+    
+    // shouldn't happen, but a bare location is better than none
+    return [[CLLocation alloc] initWithCoordinate:CLLocationCoordinate2DMake(fix.latitude, fix.longitude)
+                                         altitude:0
+                               horizontalAccuracy:fix.horizontalAccuracy
+                                 verticalAccuracy:-1
+                                        timestamp:[NSDate dateWithTimeIntervalSince1970:fix.timestamp]];
+}
+
+/**
+ * Cancel time-delayed call to the scheduler's timeout
+ */
+- (void)cancelLocationTimeout
+{
+    [self.locationTimeout cancel];
+    self.locationTimeout = nil;
+}
+
+/**
+ * (Re)schedule the timeout at the scheduler's current deadline.
+ */
+- (void)performLocationTimeoutAtDeadline
+{
+    [self cancelLocationTimeout];
+    __weak RTCLocationManager *weakSelf = self;
+    self.locationTimeout = [[RTCWorkScheduler sharedScheduler] performBlock:^{ [weakSelf locationTimedOut]; }
+                                                                    onQueue:[RTCWorkQueue mainQueue]
+                                                                 afterDelay:_scheduler->timeoutDelay()];
+}
+
+/**
+ * Time-delayed call fired: time to try a more accurate level, or to settle for
+ * the best result so far.
+ */
+- (void)locationTimedOut
+{
+    self.locationTimeout = nil;
+    std::vector<rtc::AccuracyScheduler::Completion> completed;
+    _scheduler->handleTimeout(completed);
+    [self deliverCompletions:completed];
+}
+
+/**
+ * Open a trail file for appending, writing a header if it is new or unreadable.
+ *
+ * @return NO if the file can't be opened.
+ */
+- (BOOL)openTrailFileAtURL:(NSURL *)url
+{
+    const char *path = [[url path] fileSystemRepresentation];
+    
+    // carry on an existing trail from where it left off
+    rtc::Trail existing;
+    std::ifstream input(path, std::ios::binary);
+    BOOL appending = (input && rtc::readTrail(input, existing, &_trailStartTime));
+    input.close();
+    
+    // drop a partial record left by an interrupted append so new ones line up
+    if (appending) {
+        NSFileHandle *handle = [NSFileHandle fileHandleForWritingToURL:url error:NULL];
+        [handle truncateFileAtOffset:rtc::kTrailFileHeaderSize + existing.size() * rtc::kTrailFileRecordSize];
+        [handle closeFile];
+    }
+    
+    std::ios::openmode mode = std::ios::binary | (appending ? std::ios::app : std::ios::trunc);
+    _trailFile.reset(new std::ofstream(path, mode));
+    if (!*_trailFile) {
+        _trailFile.reset();
+        return NO;
+    }
+    
+    if (!appending) {
+        _trailStartTime = [[NSDate date] timeIntervalSince1970];
+        rtc::writeTrailHeader(*_trailFile, _trailStartTime);
+        _trailFile->flush();
+    }
+    return YES;
+}
+
+/**
+ * Append committed trail points and flush, so a crash loses at most the fixes
+ * still pending in the simplifier.
+ */
+- (void)appendToTrailFile:(const rtc::Trail &)points
+{
+    if (!_trailFile || points.empty()) return;
+    rtc::appendTrailPoints(*_trailFile, _trailStartTime, points);
+    _trailFile->flush();
+}
+
+
+#pragma mark Public
+- (void)updateCurrentLocation:(RTCLocationManagerCompletion)completion failure:(void (^)())failure
+{
+    [self updateCurrentLocationWithAccuracy:kRTCLocationAccuracyThreshold
+                                 maximumAge:kRTCLocationUpdateExpiryTime
+                                 completion:completion
+                                    failure:failure];
+}
+
+- (void)updateCurrentLocationWithAccuracy:(CLLocationAccuracy)accuracy
+                               maximumAge:(NSTimeInterval)maximumAge
+                               completion:(RTCLocationManagerCompletion)completion
+                                  failure:(void (^)())failure
+{
+    if (![self locationServicesAvailable]) {
+        [RTCLocationManager showLocationDisabledErrorAlert];
+        if (failure) failure();
+        return;
+    }
+    
+    BOOL wasAcquiring = _scheduler->acquiring();
+    rtc::Tracer::SpanID span = rtc::Tracer::sharedTracer().beginSpan("location.request");
+    std::vector<rtc::AccuracyScheduler::Completion> completed;
+    rtc::AccuracyScheduler::RequestID requestID = _scheduler->addRequest(rtc::AccuracyScheduler::Request(accuracy, maximumAge), completed);
+    if (completion) self.completionBlocks[@(requestID)] = [completion copy];
+    if (span != rtc::Tracer::kNoSpan) _requestSpans[requestID] = span;
+    
+    // a new acquisition starts from scratch
+    if (_scheduler->acquiring() && !wasAcquiring) {
+        self.bestLocation = nil;
+        rtc::Tracer::sharedTracer().addCounter("location.acquisitions");
+        [self configureLocationManager];
+    }
+    [self deliverCompletions:completed];
+}
+
+- (void)startRecordingTrailForPlace:(RTCPlace *)place failure:(void (^)())failure
+{
+    [self stopRecordingTrail];
+    
+    if (![self openTrailFileAtURL:[place trailURLForRecording]]) {
+        if (failure) failure();
+        return;
+    }
+    _trailSimplifier->reset();
+    _recordingStartTime = [[NSDate date] timeIntervalSince1970];
+    self.recordingPlace = place;
+    
+    [self setupLocationServices:^{
+        [self stopRecordingTrail];
+        if (failure) failure();
+    }];
+}
+
+- (void)stopRecordingTrail
+{
+    if (!self.recordingPlace) return;
+    
+    // the last fix is still pending in the simplifier
+    rtc::Trail committed;
+    _trailSimplifier->finish(committed);
+    [self appendToTrailFile:committed];
+    
+    _trailFile.reset();
+    self.recordingPlace = nil;
+    
+    // leave updates running if a one-off location request still needs them
+    if (!_scheduler->acquiring()) {
+        [self.locationManager stopUpdatingLocation];
+    } else {
+        self.locationManager.desiredAccuracy = [RTCLocationManager desiredAccuracyForLevel:_scheduler->level()];
+    }
+    self.locationManager.pausesLocationUpdatesAutomatically = YES;
+}
+
+
+#pragma mark - CLLocationManagerDelegate
+#pragma mark Responding to Location Events
+/**
+ * When the app first initializes you can be off in accuracy by 1000+ meters,
+ * thus one location update is not going to cut it. 3+ updates should get you
+ * within 100 meters accuracy. 
+ * However there's a catch - each successive attempt is going to take longer and
+ * longer to improve your accuracy, thus it gets expensive quickly.
+ *
+ * So here's what we do (see rtc::AccuracyScheduler and rtc::LocationFixEngine
+ * for the details):
+ * - Answer from the last location if it is recent and accurate enough
+ * - Otherwise start at a cheap desired accuracy and only move up to a more
+ *   power hungry one while that keeps improving the location
+ * - Only process locations that are recent with valid accuracy
+ * - A request is done once we get a location with the accuracy it asked for
+ * - Cache a new location if it has significantly better accuracy or is first update.
+ *   Significant change requires a change of kRTCLocationAccuracySignificantChange.
+ * - Be sure to not go past max number of attempts defined in kRTCLocationAttemptsMax
+ * - If we don't get any update after kRTCLocationMaxWaitTimeForFirst then end this.
+ */
+- (void)locationManager:(CLLocationManager *)manager didUpdateLocations:(NSArray *)locations
+{
+    // a recording wants every update, including any deferred ones
+    if (self.recordingPlace) {
+        rtc::Trail committed;
+        for (CLLocation *location in locations) {
+            // cached fixes from before we started aren't part of this walk
+            if ([location.timestamp timeIntervalSince1970] < _recordingStartTime) continue;
+            _trailSimplifier->addFix([RTCLocationManager fixFromLocation:location], committed);
+        }
+        [self appendToTrailFile:committed];
+    }
+    
+    CLLocation *newLocation = [locations lastObject];
+    
+    // every update, recording ones included, refreshes the scheduler's cache
+    std::vector<rtc::AccuracyScheduler::Completion> completed;
+    _scheduler->processFix([RTCLocationManager fixFromLocation:newLocation], completed);
+    
+    // the scheduler only reports fixes, so hold on to the actual CLLocations
+    if ((newLocation.horizontalAccuracy >= 0) && (_scheduler->cachedFix().timestamp == [newLocation.timestamp timeIntervalSince1970])) {
+        self.latestLocation = newLocation;
+    }
+    if (_scheduler->hasBestFix() && (_scheduler->bestFix().timestamp == [newLocation.timestamp timeIntervalSince1970])) {
+        self.bestLocation = newLocation;
+    }
+    
+    [self deliverCompletions:completed];
+}
+
+- (void)locationManager:(CLLocationManager *)manager didFailWithError:(NSError *)error
+{
+    if ([error code] == kCLErrorDenied) {
+        [RTCLocationManager showLocationDisabledErrorAlert];
+        
+        // stop updating location
+        [self stopRecordingTrail];
+        std::vector<rtc::AccuracyScheduler::Completion> completed;
+        _scheduler->finish(completed);
+        [self deliverCompletions:completed];
+    }
+    
+    // Note we ignored the location "unknown" error simply means the manager is
+    // currently unable to get the location.
+    // We can ignore this error for this scenario of getting a single location
+    // fix, because we already have a timeout that will stop the location manager
+    // to save power.
+}
+
+#pragma mark Responding to Authorization Changes
+// Would implement methods for responding to authorization changes but
+// `locationManager:didChangeAuthorizationStatus:` keeps getting called multiple
+// times. Simply inefficient.
+
+
+
+@end
@@ -10,12 +10,16 @@
 #import <MapKit/MapKit.h>
 #import <CoreLocation/CoreLocation.h>
 #import "RTCPlace+Location.h"
+#import "RTCPlace+MKAnnotation.h"
+#import "RTCPlaceCluster.h"
 #import "RTCModelManager.h"
 #import "RTCLocationManager.h"
+#import "RTCGeocodingManager.h"
+#import "RTCTilePackManager.h"
 #import "SVPulsingAnnotationView.h"
 #import "MKMapView+Location.h"
 
-@interface RTCLocationViewController () <MKMapViewDelegate>
+@interface RTCLocationViewController () <MKMapViewDelegate, UIAlertViewDelegate>
 
 @property (weak, nonatomic) IBOutlet UIActivityIndicatorView *spinner;
 @property (weak, nonatomic) IBOutlet UITextField *nameTextField;
@@ -31,6 +35,7 @@
 @property (strong, nonatomic, readwrite) CLLocation *location;   // cached location
 @property (strong, nonatomic) CLPlacemark *placemark; // reverse-geocoded placemark
 @property (strong, nonatomic) MKPointAnnotation *locationAnnotation; // annotation to be placed on mapview
+@property (strong, nonatomic) NSManagedObjectID *duplicateID; // differently named place at this spot, while the user decides
 
 /**
  * internal handle to the database
@@ -82,14 +87,18 @@
         [self disableLocationInputs];
     }
     
-    // update current user location annotation on mapview using following steps
-    // 1: first remove current annotation on map.
-    // 2: update annotation's coordinates
-    // 2: add annotation object to map
-    [self.locationMapView removeAnnotation:self.locationAnnotation];
+    // update current user location annotation on mapview. It's moved in place
+    // (its view follows the coordinate) and only added the first time.
     self.locationAnnotation.coordinate = location.coordinate;
-    [self.locationMapView addAnnotation:self.locationAnnotation];
-    [self.locationMapView zoomToAnnotations];
+    [self updateMapAnnotations];
+    
+    // the map also shows saved places, so zoom to the location itself, or to
+    // all the places while there's no location
+    if (location) {
+        [self.locationMapView zoomToRegion:MKCoordinateRegionMake(location.coordinate, MKCoordinateSpanMake(0, 0))];
+    } else {
+        [self zoomToPlaces];
+    }
 }
 
 /**
@@ -133,11 +142,40 @@
     
     // set mapView delegate
     self.locationMapView.delegate = self;
+    [self.locationMapView addOverlay:[RTCTilePackManager sharedManager].tileOverlay level:MKOverlayLevelAboveRoads];
     
     // configure buttons to have rounded borders
     [RTCLocationViewController addRoundedBorder:self.refreshButton];
 }
 
+/**
+ * Save the current location, as the place with duplicateID or as a new place
+ * if that's nil.
+ */
+- (void)saveLocationOverPlaceWithObjectID:(NSManagedObjectID *)duplicateID
+{
+    RTCBackgroundWriter *writer = [RTCModelManager sharedManager].backgroundWriter;
+    if (!self.location || !writer) return;
+
+    // nothing here needs the place itself, so it can be saved off the main
+    //   queue and show up in the places list when it's merged
+    NSString *name = self.nameTextField.text;
+    CLLocation *location = self.location;
+    CLPlacemark *placemark = self.placemark;
+    [writer performWrite:^(NSManagedObjectContext *context) {
+        RTCPlace *duplicate = duplicateID ? (RTCPlace *)[context existingObjectWithID:duplicateID error:NULL] : nil;
+        if (duplicate && ![duplicate isDeleted]) {
+            [duplicate resaveWithName:name location:location placemark:placemark];
+        } else {
+            [RTCPlace placeWithName:name location:location placemark:placemark inManagedObjectContext:context];
+        }
+    }];
+    // keep the map around the place for finding the way back without signal
+    [[RTCTilePackManager sharedManager] prefetchTilesAroundCoordinate:location.coordinate route:nil];
+    // disable further saving until we get a new location
+    [self disableSaveButton:YES];
+}
+
 - (void)viewWillAppear:(BOOL)animated
 {
     [super viewWillAppear:animated];
@@ -197,6 +235,35 @@
 
 
 #pragma mark Private
+/**
+ * Show the saved places (clustered) in the map's visible region, along with
+ * the current location annotation if there's a location. Only the annotations
+ * that changed are added or removed.
+ */
+- (void)updateMapAnnotations
+{
+    RTCPlaceIndex *placeIndex = [RTCModelManager sharedManager].placeIndex;
+    NSMutableArray *annotations = [[NSMutableArray alloc] init];
+    if (placeIndex) {
+        [annotations addObjectsFromArray:[placeIndex annotationsInRegion:self.locationMapView.region
+                                                               zoomLevel:[self.locationMapView zoomLevel]]];
+    }
+    if (self.location) [annotations addObject:self.locationAnnotation];
+    [self.locationMapView updateAnnotations:annotations];
+}
+
+/**
+ * Zoom the map to all the saved places. The bounding box comes from the place
+ * index, so it doesn't need every place on the map.
+ */
+- (void)zoomToPlaces
+{
+    MKCoordinateRegion region;
+    if ([[RTCModelManager sharedManager].placeIndex getRegionContainingPlaces:&region]) {
+        [self.locationMapView zoomToRegion:region];
+    }
+}
+
 /**
  * Setup Location services by configuring location manager if allowed or showing
  * an error alert.
@@ -216,9 +283,9 @@
             // cache location and get placemark
             self.location = location;
             
-            [[[CLGeocoder alloc] init] reverseGeocodeLocation:self.location completionHandler:^(NSArray *placemarks, NSError *error) {
+            [[RTCGeocodingManager sharedManager] reverseGeocodeLocation:self.location completion:^(CLPlacemark *placemark, NSError *error) {
                 // cache location placemark
-                self.placemark = [placemarks lastObject];
+                self.placemark = placemark;
             }];
             
             // now that we have a new location we can enable save if there's a context
@@ -239,7 +306,7 @@
  * This expects the managedObjectContext and location to be ready else it won't 
  * create a place.
  *
- * @see shouldPerformSegueWithIdentifier:sender: and saveLocation:
+ * @see shouldPerformSegueWithIdentifier:sender:
  */
 - (RTCPlace *)createPlace
 {
@@ -287,6 +354,10 @@
 - (void)managedObjectContextReady:(NSNotification *)aNotification
 {
     self.managedObjectContext = [RTCModelManager sharedManager].managedObjectContext;
+    
+    // the place index comes with the document
+    [self updateMapAnnotations];
+    if (!self.location) [self zoomToPlaces];
 }
 
 
@@ -299,10 +370,20 @@
 
 - (IBAction)saveLocation:(id)sender
 {
-    if (self.managedObjectContext && self.location) {
-        [self createPlace];
-        // disable further saving until we get a new location
-        [self disableSaveButton:YES];
+    RTCBackgroundWriter *writer = [RTCModelManager sharedManager].backgroundWriter;
+    if (self.managedObjectContext && self.location && writer) {
+        // saving the same spot again updates the place already there, unless
+        //   it's named differently, when it may be another place altogether
+        NSManagedObjectID *duplicateID = [[RTCModelManager sharedManager].placeDeduplicator objectIDOfPlaceDuplicatingLocation:self.location];
+        RTCPlace *duplicate = duplicateID ? (RTCPlace *)[self.managedObjectContext existingObjectWithID:duplicateID error:NULL] : nil;
+        if (duplicate && ![RTCPlace isName:self.nameTextField.text mergeableWithName:duplicate.name]) {
+            self.duplicateID = duplicateID;
+            NSString *message = [NSString stringWithFormat:@"\"%@\" was saved at this spot. Update it, or save a new place?", duplicate.name];
+            UIAlertView *alertView = [[UIAlertView alloc] initWithTitle:@"Already Saved Here" message:message delegate:self cancelButtonTitle:@"Cancel" otherButtonTitles:@"Update", @"Save New", nil];
+            [alertView show];
+            return;
+        }
+        [self saveLocationOverPlaceWithObjectID:duplicateID];
     }
 }
 
@@ -341,6 +422,22 @@
 }
 
 
+#pragma mark - UIAlertViewDelegate
+/**
+ * The user decided whether a save at the spot of a differently named place
+ * updates that place or adds a new one
+ */
+- (void)alertView:(UIAlertView *)alertView clickedButtonAtIndex:(NSInteger)buttonIndex
+{
+    NSManagedObjectID *duplicateID = self.duplicateID;
+    self.duplicateID = nil;
+    if (buttonIndex == alertView.cancelButtonIndex) return;
+
+    BOOL update = (buttonIndex == alertView.firstOtherButtonIndex);
+    [self saveLocationOverPlaceWithObjectID:(update ? duplicateID : nil)];
+}
+
+
 #pragma mark - MKMapViewDelegate
 /**
  * The mapView calls this to get the MKAnnotationView for a given id <MKAnnotation>
@@ -371,6 +468,68 @@
             pulsingView.annotation = annotation;
         }
         return pulsingView;
+        
+    } else if ([annotation isKindOfClass:[RTCPlace class]]) {
+        // This is a saved place on its own
+        static NSString *kPlaceIdentifier = @"PlaceAnnotation";
+        
+        MKPinAnnotationView *pinView = (MKPinAnnotationView *)[mapView dequeueReusableAnnotationViewWithIdentifier:kPlaceIdentifier];
+        
+        if (!pinView) {
+            pinView = [[MKPinAnnotationView alloc] initWithAnnotation:annotation
+                                                      reuseIdentifier:kPlaceIdentifier];
+            pinView.pinColor = MKPinAnnotationColorRed;
+            pinView.canShowCallout = YES;
+        } else {
+            pinView.annotation = annotation;
+        }
+        return pinView;
+        
+    } else if ([annotation isKindOfClass:[RTCPlaceCluster class]]) {
+        // This is several saved places too close together to show apart
+        static NSString *kPlaceClusterIdentifier = @"PlaceClusterAnnotation";
+        
+        MKPinAnnotationView *pinView = (MKPinAnnotationView *)[mapView dequeueReusableAnnotationViewWithIdentifier:kPlaceClusterIdentifier];
+        
+        if (!pinView) {
+            pinView = [[MKPinAnnotationView alloc] initWithAnnotation:annotation
+                                                      reuseIdentifier:kPlaceClusterIdentifier];
+            pinView.pinColor = MKPinAnnotationColorPurple;
+            pinView.canShowCallout = NO;
+        } else {
+            pinView.annotation = annotation;
+        }
+        return pinView;
+    }
+    
+    return nil;
+}
+
+/**
+ * Tapping a cluster zooms in until its places show apart
+ */
+- (void)mapView:(MKMapView *)mapView didSelectAnnotationView:(MKAnnotationView *)view
+{
+    if ([view.annotation isKindOfClass:[RTCPlaceCluster class]]) {
+        RTCPlaceCluster *cluster = (RTCPlaceCluster *)view.annotation;
+        [mapView deselectAnnotation:cluster animated:NO];
+        [mapView zoomToRegion:cluster.region];
+    }
+}
+
+/**
+ * Only the places in the visible region, clustered for its zoom level, are on
+ * the map, so they're updated whenever it moves
+ */
+- (void)mapView:(MKMapView *)mapView regionDidChangeAnimated:(BOOL)animated
+{
+    [self updateMapAnnotations];
+}
+
+- (MKOverlayRenderer *)mapView:(MKMapView *)mapView rendererForOverlay:(id<MKOverlay>)overlay
+{
+    if ([overlay isKindOfClass:[MKTileOverlay class]]) {
+        return [[MKTileOverlayRenderer alloc] initWithTileOverlay:(MKTileOverlay *)overlay];
     }
     
     return nil;
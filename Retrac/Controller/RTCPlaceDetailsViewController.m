@@ -8,8 +8,15 @@
 
 #import "RTCPlaceDetailsViewController.h"
 #import "RTCPlace+Location.h"
+#import "RTCLocationManager.h"
+#import "RTCGeocodingManager.h"
 #import <CoreLocation/CoreLocation.h>
 
+// Constants
+// titles of the trail recording button
+static NSString *const kRecordTrailTitle    = @"Record Trail";
+static NSString *const kStopTrailTitle      = @"Stop Trail";
+
 @interface RTCPlaceDetailsViewController () <UITextFieldDelegate>
 
 @property (weak, nonatomic) IBOutlet UITextField *nameTextField;
@@ -45,11 +52,17 @@
     // start save button out disabled
     [self disableSaveButton];
     
+    // trail recording is toggled from the navigation bar
+    self.navigationItem.rightBarButtonItem = [[UIBarButtonItem alloc] initWithTitle:kRecordTrailTitle
+                                                                              style:UIBarButtonItemStylePlain
+                                                                             target:self
+                                                                             action:@selector(toggleTrailRecording:)];
+    [self updateTrailRecordingButton];
+    
     // ensure we have placemark required for displaying place address
     if (!self.place.placemark) {
-        [[[CLGeocoder alloc] init] reverseGeocodeLocation:self.place.location completionHandler:^(NSArray *placemarks, NSError *error) {
+        [[RTCGeocodingManager sharedManager] reverseGeocodeLocation:self.place.location completion:^(CLPlacemark *placemark, NSError *error) {
             // cache location placemark
-            CLPlacemark *placemark = [placemarks lastObject];
             if (placemark) {
                 self.place.placemark = placemark;
                 [self updatePlaceDetailsView];
@@ -71,6 +84,15 @@
     
 }
 
+/**
+ * Show whether this place's trail is being recorded
+ */
+- (void)updateTrailRecordingButton
+{
+    BOOL recording = ([RTCLocationManager sharedManager].recordingPlace == self.place);
+    self.navigationItem.rightBarButtonItem.title = recording ? kStopTrailTitle : kRecordTrailTitle;
+}
+
 /**
  * Configure button to have a visible border with rounded corners.
  */
@@ -100,6 +122,19 @@
     [self disableSaveButton];
 }
 
+- (void)toggleTrailRecording:(id)sender
+{
+    RTCLocationManager *locationManager = [RTCLocationManager sharedManager];
+    if (locationManager.recordingPlace == self.place) {
+        [locationManager stopRecordingTrail];
+    } else {
+        [locationManager startRecordingTrailForPlace:self.place failure:^{
+            [self updateTrailRecordingButton];
+        }];
+    }
+    [self updateTrailRecordingButton];
+}
+
 - (IBAction)textFieldChanged:(id)sender
 {
     self.saveButton.enabled = ![self.place.name isEqualToString:self.nameTextField.text];
@@ -12,20 +12,26 @@
 #import "RTCRouteStepTableViewCell.h"
 #import "RTCPlace+MKAnnotation.h"
 #import "RTCPlace+Location.h"
+#import "RTCPlace+Trail.h"
 #import "RTCLocationManager.h"
+#import "RTCDirectionsManager.h"
+#import "RTCTraceManager.h"
+#import "RTCGeocodingManager.h"
 #import "RTCPlaceDetailsViewController.h"
 #import "MKMapView+Location.h"
+#import "RTCLabelFormatter.h"
+#import "RTCPositionSmoother.h"
+#import "RTCRouteTracker.h"
+#import "RTCTilePackManager.h"
 
 // Constants
-static const CLLocationDistance kMetersInFoot   = 0.3048;
-static const CLLocationDistance kMetersInMile   = 1609.34;
-// set the minimum mileage, below which distances are reported in feet.
-static const CLLocationDistance kMinimumMiles    = 0.1;
-
 static const CGFloat kRouteLineWidth  = 5.0;
+static const CGFloat kTrailLineWidth  = 3.0;
 
 // messages to show when directions available or not.
 static NSString *const kPlaceDirectionsMsg  = @"Walking Directions";
+// shown in table view header when MapKit failed and we routed offline
+static NSString *const kOfflineDirectionsMsg = @"Offline Walking Directions";
 // shown in table view header
 static NSString *const kNoDirectionsMsg     = @"Walking Directions Not Available";
 // shown in navigation item titleView
@@ -35,14 +41,6 @@ static NSString *const kNoDirectionsMsgCondensed = @"No Directions Available";
 static NSString *const kNavigationItemTitle = @"Place Directions";
 static const CGFloat kNavigationItemTitleFontSize = 14.0;
 
-// seconds in minute, hour, day per the Gregorian Calendar.
-static const NSInteger kSecondsInMinute     = 60;
-static const NSInteger kSecondsInHour       = 3600;
-static NSString *const kMinuteUnit          = @"minute";
-static NSString *const kMinutesUnit         = @"minutes";
-static NSString *const kHourUnit            = @"hour";
-static NSString *const kHoursUnit           = @"hours";
-
 @interface RTCPlaceDirectionsViewController () <UITableViewDataSource,
                                                 UITabBarControllerDelegate,
                                                 MKMapViewDelegate>
@@ -57,32 +55,64 @@ static NSString *const kHoursUnit           = @"hours";
 /**
  * Walking route between current location and destination
  */
-@property (strong, nonatomic) MKRoute *walkingRoute;
+@property (strong, nonatomic) RTCRoute *walkingRoute;
 
-// Cache source and destination mapItems used to make walkingRoute
-@property (strong, nonatomic) MKMapItem *walkingRouteSource;
+// Cache destination mapItem used to make walkingRoute
 @property (strong, nonatomic) MKMapItem *walkingRouteDestination;
 
+/**
+ * Breadcrumb trail recorded from the destination, drawn under the route
+ */
+@property (strong, nonatomic) MKPolyline *trailPolyline;
+
 /**
  * Properties used for getting user's current location and corresponding annotation
  */
 @property (strong, nonatomic) CLLocation *location;
 @property (strong, nonatomic) MKPointAnnotation *locationAnnotation;
 
+/**
+ * Smooths location updates into location, and says when the user has moved
+ * far enough from routeOrigin to need a new route
+ */
+@property (strong, nonatomic) RTCPositionSmoother *positionSmoother;
+
+// location the map was last zoomed to and the route requested from, nil to
+//   do both on the next location
+@property (strong, nonatomic) CLLocation *routeOrigin;
+
+/**
+ * Follows the smoothed location along walkingRoute for what is left of it,
+ * and says when the user has left it and needs a new one
+ */
+@property (strong, nonatomic) RTCRouteTracker *routeTracker;
+
 @end
 
 @implementation RTCPlaceDirectionsViewController
 
 #pragma mark - Properties
 
-- (void)setWalkingRoute:(MKRoute *)walkingRoute
+- (void)setWalkingRoute:(RTCRoute *)walkingRoute
 {
     _walkingRoute = walkingRoute;
     
+    // follow the user along the new route from where they are now
+    self.routeTracker.route = walkingRoute;
+    [self.routeTracker addLocation:self.location];
+    
     // set new overlay on mapView
     [self.directionsMapView removeOverlays:self.directionsMapView.overlays];
+    [self.directionsMapView addOverlay:[RTCTilePackManager sharedManager].tileOverlay level:MKOverlayLevelAboveRoads];
+    if (self.trailPolyline) {
+        [self.directionsMapView addOverlay:self.trailPolyline level:MKOverlayLevelAboveRoads];
+    }
     if (walkingRoute) {
         [self.directionsMapView addOverlay:walkingRoute.polyline level:MKOverlayLevelAboveRoads];
+        
+        // keep the map along the route for when there's no signal on the way
+        [[RTCTilePackManager sharedManager] prefetchTilesAroundCoordinate:self.destinationPlace.location.coordinate
+                                                                    route:walkingRoute];
     }
     
     // update navigation item titleView
@@ -90,6 +120,7 @@ static NSString *const kHoursUnit           = @"hours";
     
     // reload directions table
     [self.tableView reloadData];
+    [self updateCurrentRouteStep];
     
     // enable/disable maps button
     [self updateOpenMapsButton:(walkingRoute != nil)];
@@ -98,6 +129,8 @@ static NSString *const kHoursUnit           = @"hours";
 - (void)setDestinationPlace:(RTCPlace *)destinationPlace
 {
     _destinationPlace = destinationPlace;
+    self.trailPolyline = [destinationPlace trailPolyline];
+    self.routeOrigin = nil;
     [self updateLocationViews];
 }
 
@@ -117,6 +150,20 @@ static NSString *const kHoursUnit           = @"hours";
     return _locationAnnotation;
 }
 
+- (RTCPositionSmoother *)positionSmoother
+{
+    // lazy instantiation
+    if (!_positionSmoother) _positionSmoother = [[RTCPositionSmoother alloc] init];
+    return _positionSmoother;
+}
+
+- (RTCRouteTracker *)routeTracker
+{
+    // lazy instantiation
+    if (!_routeTracker) _routeTracker = [[RTCRouteTracker alloc] init];
+    return _routeTracker;
+}
+
 
 #pragma mark - View Lifecycle
 - (void)viewDidLoad
@@ -139,15 +186,15 @@ static NSString *const kHoursUnit           = @"hours";
     
     // setup mapView
     self.directionsMapView.delegate = self;
+    [self.directionsMapView addOverlay:[RTCTilePackManager sharedManager].tileOverlay level:MKOverlayLevelAboveRoads];
     
     // disable maps button on startup. It will be enabled when appropriate
     [self updateOpenMapsButton:NO];
     
     // ensure we have destination placemark which is required for routing
     if (!self.destinationPlace.placemark) {
-        [[[CLGeocoder alloc] init] reverseGeocodeLocation:self.destinationPlace.location completionHandler:^(NSArray *placemarks, NSError *error) {
+        [[RTCGeocodingManager sharedManager] reverseGeocodeLocation:self.destinationPlace.location completion:^(CLPlacemark *placemark, NSError *error) {
             // cache location placemark
-            CLPlacemark *placemark = [placemarks lastObject];
             if (placemark) {
                 self.destinationPlace.placemark = placemark;
                 [self updateMapViewRoute];
@@ -165,6 +212,7 @@ static NSString *const kHoursUnit           = @"hours";
     
     // each time view re-appears re-route the user based on current location by
     // simply updating current location
+    self.routeOrigin = nil;
     [self updateCurrentLocation];
     
     // clear any selection in the tableview before it is displayed
@@ -192,20 +240,12 @@ static NSString *const kHoursUnit           = @"hours";
 #pragma mark - Instance Methods
 #pragma mark Private
 /**
- * convert meters to a string representation in feet (if < kMinimumMiles miles) or miles
- * (if >= kMinimumMiles miles)
+ * convert meters to a string representation in feet (if < 0.1 miles) or miles
+ * (if >= 0.1 miles)
  */
 - (NSString *)metersToImperial:(CLLocationDistance)distanceMeters
 {
-    NSString *distanceImperial = nil;
-    
-    if (distanceMeters >= kMetersInMile * kMinimumMiles) {
-        distanceImperial = [NSString stringWithFormat:@"%.1f mi",(distanceMeters/kMetersInMile)];
-    } else if (distanceMeters >= 0) {
-        distanceImperial = [NSString stringWithFormat:@"%d ft", (int)(distanceMeters/kMetersInFoot)];
-    }
-    
-    return distanceImperial;
+    return [RTCLabelFormatter labelForDistance:distanceMeters];
 }
 
 /**
@@ -216,25 +256,7 @@ static NSString *const kHoursUnit           = @"hours";
  */
 - (NSString *)timeIntervalToString:(NSTimeInterval)timeSeconds
 {
-    NSString *formattedTime = nil;
-    // ensure timeSeconds is >= 0
-    int numSeconds = abs(timeSeconds);
-    
-    int hours = numSeconds / kSecondsInHour;
-    int minutes = (numSeconds % kSecondsInHour) / kSecondsInMinute;
-    
-    NSString *hoursUnits = (hours == 1) ? kHourUnit : kHoursUnit;
-    NSString *minutsUnits = (minutes == 1) ? kMinuteUnit : kMinutesUnit;
-    
-    if (hours == 0) {
-        formattedTime = [NSString stringWithFormat:@"%d %@", minutes, minutsUnits];
-    } else if ((minutes == 0) && (hours > 0)) {
-        formattedTime = [NSString stringWithFormat:@"%d %@", hours, hoursUnits];
-    } else {
-        formattedTime = [NSString stringWithFormat:@"%d %@ %d %@", hours, hoursUnits, minutes, minutsUnits];
-    }
-    
-    return formattedTime;
+    return [RTCLabelFormatter labelForDuration:timeSeconds];
 }
 
 /**
@@ -246,13 +268,11 @@ static NSString *const kHoursUnit           = @"hours";
     [self.spinner startAnimating];
     [self updateOpenMapsButton:NO];
     
-    [[RTCLocationManager sharedManager] updateCurrentLocation:^(CLLocation *location, NSError *error) {
+    // a route's start needn't be exact, so don't pay for the GPS if we can help it
+    [[RTCLocationManager sharedManager] updateCurrentLocationWithAccuracy:kRTCDirectionsLocationAccuracy maximumAge:kRTCDirectionsLocationMaxAge completion:^(CLLocation *location, NSError *error) {
         [self.spinner stopAnimating];
         
-        if (location) {
-            // set new location and the setter will do a lot for us.
-            self.location = location;
-        }
+        if (location) [self updateWithLocation:location];
         
     } failure:^{
         [self.spinner stopAnimating];
@@ -260,6 +280,25 @@ static NSString *const kHoursUnit           = @"hours";
 }
 
 
+/**
+ * Smooth in a location update, from the one-off request or the map's user
+ * location, and show the result
+ */
+- (void)updateWithLocation:(CLLocation *)location
+{
+    if ([self.positionSmoother addLocation:location]) {
+        // a wrong turn needs a new route from here
+        RTCRouteTrackerEvent event = [self.routeTracker addLocation:self.positionSmoother.location];
+        if (event == RTCRouteTrackerEventOffRoute) self.routeOrigin = nil;
+        
+        // set new location and the setter will do a lot for us.
+        self.location = self.positionSmoother.location;
+    } else if (!self.location) {
+        // better a rough start than none
+        self.location = location;
+    }
+}
+
 /**
  * Update mapView and tableView using the current location and the 
  * destinationPlace property
@@ -271,9 +310,19 @@ static NSString *const kHoursUnit           = @"hours";
     
     // Setup annotations on map
     [self updateMapViewAnnotations];
-   
-    // Setup directions route on map
-    [self updateMapViewRoute];
+    [self updateCurrentRouteStep];
+    
+    // the location moves with every update, but only leaving the route (see
+    //   updateWithLocation:), or with no route a real move away from where it
+    //   was asked from, is worth a new route and a new map region
+    if (!self.routeOrigin || !self.location ||
+        (!self.walkingRoute && [self.positionSmoother hasMovedSignificantlyFromLocation:self.routeOrigin])) {
+        self.routeOrigin = self.location;
+        [self.directionsMapView zoomToAnnotations];
+        
+        // Setup directions route on map
+        [self updateMapViewRoute];
+    }
 }
 
 /**
@@ -286,8 +335,9 @@ static NSString *const kHoursUnit           = @"hours";
     
     NSString *secondLine;
     if (self.walkingRoute) {
-        NSString *time = [self timeIntervalToString:self.walkingRoute.expectedTravelTime];
-        NSString *distance = [self metersToImperial:self.walkingRoute.distance];
+        // what is left of the route, all of it until the user is on it
+        NSString *time = [self timeIntervalToString:self.routeTracker.timeRemaining];
+        NSString *distance = [self metersToImperial:self.routeTracker.distanceRemaining];
         secondLine = [NSString stringWithFormat:@"%@ - %@", time, distance];
     } else {
         secondLine = kNoDirectionsMsgCondensed;
@@ -308,24 +358,35 @@ static NSString *const kHoursUnit           = @"hours";
 
 }
 
+/**
+ * Select the directions row of the step the user is on
+ */
+- (void)updateCurrentRouteStep
+{
+    if (!self.walkingRoute || !self.routeTracker.hasProgress) return;
+    
+    NSUInteger stepIndex = self.routeTracker.stepIndex;
+    if (stepIndex >= [self.walkingRoute.steps count]) return;
+    NSIndexPath *indexPath = [NSIndexPath indexPathForRow:stepIndex inSection:0];
+    if ([indexPath isEqual:[self.tableView indexPathForSelectedRow]]) return;
+    [self.tableView selectRowAtIndexPath:indexPath animated:YES scrollPosition:UITableViewScrollPositionMiddle];
+}
+
 /**
  * Update mapview annotations
  */
 - (void)updateMapViewAnnotations
 {
-    // update destination place annotation on mapview
-    [self.directionsMapView removeAnnotation:self.destinationPlace];
-    [self.directionsMapView addAnnotation:self.destinationPlace];
-    
-    // update current location annotation on mapview
+    // show the destination place and current location, adding only what
+    // isn't already on the mapview. The location annotation is moved in place
+    // (its view follows the coordinate) rather than removed and re-added.
+    NSMutableArray *annotations = [[NSMutableArray alloc] init];
+    if (self.destinationPlace) [annotations addObject:self.destinationPlace];
     if (self.location) {
-        [self.directionsMapView removeAnnotation:self.locationAnnotation];
         self.locationAnnotation.coordinate = self.location.coordinate;
-        [self.directionsMapView addAnnotation:self.locationAnnotation];
+        [annotations addObject:self.locationAnnotation];
     }
-    
-    // zoom in to these annotations
-    [self.directionsMapView zoomToAnnotations];
+    [self.directionsMapView updateAnnotations:annotations];
 }
 
 /**
@@ -335,29 +396,21 @@ static NSString *const kHoursUnit           = @"hours";
 {
     // always have a destination, but location is not guaranteed
     if (self.location && self.destinationPlace.placemark) {
-        // Create walking directions request
-        MKDirectionsRequest *walkingRouteRequest = [[MKDirectionsRequest alloc] init];
-        walkingRouteRequest.transportType = MKDirectionsTransportTypeWalking;
-        
-        // Get necessary placemarks and map items
-        self.walkingRouteSource = [MKMapItem mapItemForCurrentLocation];
-        [walkingRouteRequest setSource:self.walkingRouteSource];
-        
-        
         MKPlacemark *destinationPlaceMark = [[MKPlacemark alloc] initWithPlacemark:self.destinationPlace.placemark];
         self.walkingRouteDestination = [[MKMapItem alloc] initWithPlacemark:destinationPlaceMark];
-        [walkingRouteRequest setDestination:self.walkingRouteDestination];
-        
-        // get walking directions
-        MKDirections *walkingRouteDirections = [[MKDirections alloc] initWithRequest:walkingRouteRequest];
         
-        [walkingRouteDirections calculateDirectionsWithCompletionHandler:^(MKDirectionsResponse * walkingRouteResponse, NSError *walkingRouteError) {
-            if (walkingRouteError) {
-                [self handleDirectionsError:walkingRouteError];
+        // a cached route shows up right away, a fresh one when MapKit answers.
+        // The span is how long the user waited for the first.
+        __block RTCTraceSpan span = [[RTCTraceManager sharedManager] beginSpan:"directions.route"];
+        [[RTCDirectionsManager sharedManager] walkingRouteFromCoordinate:self.location.coordinate
+                                                               toMapItem:self.walkingRouteDestination
+                                                              completion:^(RTCRoute *route, NSError *error) {
+            [[RTCTraceManager sharedManager] endSpan:span];
+            span = 0;
+            if (error) {
+                [self handleDirectionsError:error];
             } else {
-                // The code doesn't request alternate routes, so add the single calculated route to
-                // a previously declared MKRoute property called walkingRoute.
-                self.walkingRoute = [walkingRouteResponse.routes firstObject];
+                self.walkingRoute = route;
             }
         }];
     }
@@ -434,7 +487,7 @@ static NSString *const kHoursUnit           = @"hours";
     RTCRouteStepTableViewCell *cell = [tableView dequeueReusableCellWithIdentifier:cellIdentifier forIndexPath:indexPath];
     
     // get corresponding route step
-    MKRouteStep *routeStep = [self.walkingRoute.steps objectAtIndex:indexPath.row];
+    RTCRouteStep *routeStep = [self.walkingRoute.steps objectAtIndex:indexPath.row];
     
     // configure the cell with data from the route step
     cell.instructionsLabel.text = routeStep.instructions;
@@ -445,7 +498,8 @@ static NSString *const kHoursUnit           = @"hours";
 
 - (NSString *)tableView:(UITableView *)tableView titleForHeaderInSection:(NSInteger)section
 {
-    return self.walkingRoute ? kPlaceDirectionsMsg : kNoDirectionsMsg;
+    if (!self.walkingRoute) return kNoDirectionsMsg;
+    return (self.walkingRoute.source == RTCRouteSourceOffline) ? kOfflineDirectionsMsg : kPlaceDirectionsMsg;
 }
 
 - (BOOL)tableView:(UITableView *)tableView canEditRowAtIndexPath:(NSIndexPath *)indexPath
@@ -455,6 +509,15 @@ static NSString *const kHoursUnit           = @"hours";
 
 
 #pragma mark - MKMapViewDelegate
+/**
+ * The mapView shows the user location while on screen anyway, so smooth its
+ * updates into ours rather than asking for more
+ */
+- (void)mapView:(MKMapView *)mapView didUpdateUserLocation:(MKUserLocation *)userLocation
+{
+    if (userLocation.location) [self updateWithLocation:userLocation.location];
+}
+
 /**
  * The mapView calls this to get the MKAnnotationView for a given id <MKAnnotation>
  * this implementation returns a standard MKPinAnnotationView
@@ -526,9 +589,19 @@ static NSString *const kHoursUnit           = @"hours";
         aRenderer.strokeColor = kRTCLocationColor;
         aRenderer.lineWidth = kRouteLineWidth;
         
+        // the recorded trail is dashed so it doesn't read as the route
+        if (overlay == self.trailPolyline) {
+            aRenderer.lineWidth = kTrailLineWidth;
+            aRenderer.lineDashPattern = @[@(2.0 * kTrailLineWidth), @(2.0 * kTrailLineWidth)];
+        }
+        
         return aRenderer;
     }
     
+    if ([overlay isKindOfClass:[MKTileOverlay class]]) {
+        return [[MKTileOverlayRenderer alloc] initWithTileOverlay:(MKTileOverlay *)overlay];
+    }
+    
     return nil;
 }
 
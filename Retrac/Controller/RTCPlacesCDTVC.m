@@ -14,12 +14,23 @@
 #import "RTCPlace+MKAnnotation.h"
 #import "RTCModelManager.h"
 #import "RTCPlaceTableViewCell.h"
+#import "RTCLabelFormatter.h"
+#import "RTCWorkScheduler.h"
 
-@interface RTCPlacesCDTVC ()
+@interface RTCPlacesCDTVC () <UISearchBarDelegate>
 
 // need this property to get a handle to the database
 @property (nonatomic, strong) NSManagedObjectContext *managedObjectContext;
 
+// when the visible creation date labels were last brought up to date, and
+//   when they are next, 0 if they aren't being kept up to date
+@property (nonatomic) NSTimeInterval ageLabelsRefreshTime;
+@property (nonatomic) NSTimeInterval ageLabelsRefreshDeadline;
+@property (nonatomic, strong) RTCTimer *ageLabelsRefreshTimer;
+
+// what the list is narrowed to, nil to show every place
+@property (nonatomic, copy) NSString *searchText;
+
 @end
 
 @implementation RTCPlacesCDTVC
@@ -41,6 +52,13 @@
     [super viewDidLoad];
 
     self.navigationItem.leftBarButtonItem = self.editButtonItem;
+
+    UISearchBar *searchBar = [[UISearchBar alloc] init];
+    searchBar.placeholder = @"Search names and addresses";
+    searchBar.autocapitalizationType = UITextAutocapitalizationTypeNone;
+    searchBar.delegate = self;
+    [searchBar sizeToFit];
+    self.tableView.tableHeaderView = searchBar;
 }
 
 - (void)viewWillAppear:(BOOL)animated
@@ -57,6 +75,15 @@
                                                object:nil];
 }
 
+- (void)viewDidAppear:(BOOL)animated
+{
+    [super viewDidAppear:animated];
+    
+    // cells were just configured, so labels are current as of now
+    self.ageLabelsRefreshTime = [NSDate timeIntervalSinceReferenceDate];
+    [self scheduleAgeLabelsRefresh];
+}
+
 - (void)viewDidDisappear:(BOOL)animated
 {
     [super viewDidDisappear:animated];
@@ -67,7 +94,11 @@
     
     // end editing as view is going away
     [self setEditing:NO];
-
+    
+    // stop keeping labels current while off screen
+    [self.ageLabelsRefreshTimer cancel];
+    self.ageLabelsRefreshTimer = nil;
+    self.ageLabelsRefreshDeadline = 0;
 }
 
 
@@ -88,7 +119,13 @@
     if (self.managedObjectContext) {
         NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
         
-        // fetch all places so no predicate
+        // fetch all places unless searching, and then just the search index's
+        //   matches rather than string predicates over every place
+        if ([self.searchText length]) {
+            NSArray *objectIDs = [[RTCModelManager sharedManager].placeSearchIndex objectIDsOfPlacesMatchingText:self.searchText
+                                                                                                     maxResults:kRTCPlaceSearchMaxResults];
+            request.predicate = [NSPredicate predicateWithFormat:@"SELF IN %@", objectIDs];
+        }
         
         NSSortDescriptor *creationDateSort = [NSSortDescriptor sortDescriptorWithKey:@"creationDate"
                                                                            ascending:NO];
@@ -106,6 +143,95 @@
 }
 
 
+/**
+ * Snapshot of the list to show while there are no fetched results yet, i.e.
+ * at launch while the places document is opening. Its rows are read-only.
+ */
+- (RTCPlaceSnapshot *)launchSnapshot
+{
+    if (self.fetchedResultsController) return nil;
+    return [RTCModelManager sharedManager].placeSnapshot;
+}
+
+
+/**
+ * Creation date of the place, or snapshot row, at indexPath
+ */
+- (NSDate *)creationDateAtIndexPath:(NSIndexPath *)indexPath
+{
+    RTCPlaceSnapshot *snapshot = [self launchSnapshot];
+    if (snapshot) return [snapshot creationDateAtIndex:indexPath.row];
+    RTCPlace *place = [self.fetchedResultsController objectAtIndexPath:indexPath];
+    return place.creationDate;
+}
+
+/**
+ * Refresh the creation date labels when the soonest visible one changes.
+ */
+- (void)scheduleAgeLabelsRefresh
+{
+    NSTimeInterval delay = DBL_MAX;
+    for (NSIndexPath *indexPath in [self.tableView indexPathsForVisibleRows]) {
+        NSTimeInterval age = -1 * [[self creationDateAtIndexPath:indexPath] timeIntervalSinceNow];
+        delay = MIN(delay, [RTCLabelFormatter expiryOfLabelForAge:age]);
+    }
+    [self scheduleAgeLabelsRefreshAfterDelay:delay];
+}
+
+- (void)scheduleAgeLabelsRefreshAfterDelay:(NSTimeInterval)delay
+{
+    [self.ageLabelsRefreshTimer cancel];
+    self.ageLabelsRefreshTimer = nil;
+    if (delay == DBL_MAX) {
+        // nothing showing; the next cell shown schedules it
+        self.ageLabelsRefreshDeadline = DBL_MAX;
+        return;
+    }
+    
+    // a moment late rather than early, so the label has changed by then
+    delay = MAX(delay, 0) + 0.1;
+    self.ageLabelsRefreshDeadline = [NSDate timeIntervalSinceReferenceDate] + delay;
+    __weak RTCPlacesCDTVC *weakSelf = self;
+    self.ageLabelsRefreshTimer = [[RTCWorkScheduler sharedScheduler] performBlock:^{ [weakSelf refreshAgeLabels]; }
+                                                                          onQueue:[RTCWorkQueue mainQueue]
+                                                                       afterDelay:delay];
+}
+
+/**
+ * A cell scrolled in with a label that changes before the next refresh, so
+ * bring the refresh forward.
+ */
+- (void)ageLabelShownWithExpiry:(NSTimeInterval)expiry
+{
+    if (!self.ageLabelsRefreshDeadline) return;
+    if ([NSDate timeIntervalSinceReferenceDate] + expiry + 0.1 >= self.ageLabelsRefreshDeadline) return;
+    [self scheduleAgeLabelsRefreshAfterDelay:expiry];
+}
+
+/**
+ * Update the creation date label of just the visible rows whose label has
+ * changed since the last refresh. Labels only go up with time, so a cell
+ * configured since then is stale exactly when those are.
+ */
+- (void)refreshAgeLabels
+{
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    NSTimeInterval elapsed = now - self.ageLabelsRefreshTime;
+    
+    for (NSIndexPath *indexPath in [self.tableView indexPathsForVisibleRows]) {
+        NSDate *creationDate = [self creationDateAtIndexPath:indexPath];
+        NSTimeInterval age = now - [creationDate timeIntervalSinceReferenceDate];
+        if (![RTCLabelFormatter labelForAge:age - elapsed changesAfter:elapsed]) continue;
+        
+        RTCPlaceTableViewCell *cell = (RTCPlaceTableViewCell *)[self.tableView cellForRowAtIndexPath:indexPath];
+        cell.creationDateLabel.text = [RTCLabelFormatter labelForAge:age];
+    }
+    
+    self.ageLabelsRefreshTime = now;
+    [self scheduleAgeLabelsRefresh];
+}
+
+
 #pragma mark Notification Observer Methods
 
 /**
@@ -118,14 +244,42 @@
 
 
 #pragma mark - UITableViewDataSource
+// until the fetched results are in, the launch snapshot stands in for them.
+//   setting the fetchedResultsController reloads the table over it.
+- (NSInteger)numberOfSectionsInTableView:(UITableView *)tableView
+{
+    if ([self launchSnapshot]) return 1;
+    return [super numberOfSectionsInTableView:tableView];
+}
+
+- (NSInteger)tableView:(UITableView *)tableView numberOfRowsInSection:(NSInteger)section
+{
+    RTCPlaceSnapshot *snapshot = [self launchSnapshot];
+    if (snapshot) return snapshot.count;
+    return [super tableView:tableView numberOfRowsInSection:section];
+}
+
 - (UITableViewCell *)tableView:(UITableView *)tableView cellForRowAtIndexPath:(NSIndexPath *)indexPath {
     static NSString *cellIdentifier = @"Place Cell"; // get the cell
     RTCPlaceTableViewCell *cell = [tableView dequeueReusableCellWithIdentifier:cellIdentifier forIndexPath:indexPath];
-    RTCPlace *place = [self.fetchedResultsController objectAtIndexPath:indexPath];
     
-    // Configure the cell with data from the managed object
-    cell.nameLabel.text = place.title;
-    cell.creationDateLabel.text = [place timeSinceCreation];
+    NSDate *creationDate = nil;
+    RTCPlaceSnapshot *snapshot = [self launchSnapshot];
+    if (snapshot) {
+        // same labels as the place would get, from the saved title and date
+        cell.nameLabel.text = [snapshot titleAtIndex:indexPath.row];
+        creationDate = [snapshot creationDateAtIndex:indexPath.row];
+    } else {
+        // Configure the cell with data from the managed object
+        RTCPlace *place = [self.fetchedResultsController objectAtIndexPath:indexPath];
+        cell.nameLabel.text = place.title;
+        creationDate = place.creationDate;
+    }
+    
+    // a shared string per label, kept current by refreshAgeLabels
+    NSTimeInterval age = -1 * [creationDate timeIntervalSinceNow];
+    cell.creationDateLabel.text = [RTCLabelFormatter labelForAge:age];
+    [self ageLabelShownWithExpiry:[RTCLabelFormatter expiryOfLabelForAge:age]];
     
     return cell;
 }
@@ -143,7 +297,13 @@
 #pragma mark - UITableViewDelegate
 - (BOOL)tableView:(UITableView *)tableView canEditRowAtIndexPath:(NSIndexPath *)indexPath
 {
-    return YES;
+    // there's no place behind a snapshot row to delete
+    return ([self launchSnapshot] == nil);
+}
+
+- (NSIndexPath *)tableView:(UITableView *)tableView willSelectRowAtIndexPath:(NSIndexPath *)indexPath
+{
+    return [self launchSnapshot] ? nil : indexPath;
 }
 
 
@@ -180,6 +340,13 @@
     
 }
 
+- (BOOL)shouldPerformSegueWithIdentifier:(NSString *)identifier sender:(id)sender
+{
+    // a snapshot row has no place to show directions or details for
+    if ([sender isKindOfClass:[UITableViewCell class]] && [self launchSnapshot]) return NO;
+    return YES;
+}
+
 - (void)prepareForSegue:(UIStoryboardSegue *)segue sender:(id)sender
 {
     NSIndexPath *indexPath = nil;
@@ -211,6 +378,18 @@
 }
 
 
+#pragma mark - UISearchBarDelegate
+- (void)searchBar:(UISearchBar *)searchBar textDidChange:(NSString *)searchText
+{
+    self.searchText = searchText;
+    [self setupFetchedResultsController];
+}
+
+- (void)searchBarSearchButtonClicked:(UISearchBar *)searchBar
+{
+    [searchBar resignFirstResponder];
+}
+
 
 #pragma mark Modal Unwinding
 - (IBAction)addedPlace:(UIStoryboardSegue *)segue
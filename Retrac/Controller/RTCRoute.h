@@ -0,0 +1,70 @@
+//
+//  RTCRoute.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/14/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+
+/**
+ * RTCRouteStep is one instruction of an RTCRoute. Mirrors MKRouteStep.
+ */
+@interface RTCRouteStep : NSObject
+
+@property (nonatomic, copy, readonly) NSString *instructions;
+@property (nonatomic, readonly) CLLocationDistance distance;
+
+/**
+ * Index of the route polyline's point where this step starts
+ */
+@property (nonatomic, readonly) NSUInteger firstPointIndex;
+
+- (instancetype)initWithInstructions:(NSString *)instructions
+                            distance:(CLLocationDistance)distance
+                     firstPointIndex:(NSUInteger)firstPointIndex;
+
+@end
+
+
+/**
+ * Where an RTCRoute came from
+ */
+typedef NS_ENUM(NSInteger, RTCRouteSource) {
+    RTCRouteSourceMapKit,       // fresh from MKDirections
+    RTCRouteSourceCache,        // from the route cache
+    RTCRouteSourceOffline       // from the offline walking graph
+};
+
+
+/**
+ * RTCRoute is a walking route as served by RTCDirectionsManager. Unlike
+ * MKRoute it can be built from a cached or offline route, so it mirrors just
+ * the parts of MKRoute this app shows.
+ */
+@interface RTCRoute : NSObject
+
+#pragma mark - Properties
+@property (nonatomic, strong, readonly) MKPolyline *polyline;
+
+/**
+ * RTCRouteStep objects, in walking order
+ */
+@property (nonatomic, copy, readonly) NSArray *steps;
+
+@property (nonatomic, readonly) CLLocationDistance distance;
+@property (nonatomic, readonly) NSTimeInterval expectedTravelTime;
+
+@property (nonatomic, readonly) RTCRouteSource source;
+
+
+#pragma mark - Initialization
+- (instancetype)initWithPolyline:(MKPolyline *)polyline
+                           steps:(NSArray *)steps
+                        distance:(CLLocationDistance)distance
+              expectedTravelTime:(NSTimeInterval)expectedTravelTime
+                          source:(RTCRouteSource)source;
+
+@end
@@ -0,0 +1,65 @@
+//
+//  RTCRoute.m
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/14/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCRoute.h"
+
+@implementation RTCRouteStep
+
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"RTCRouteStep"
+                                   reason:@"Use - [RTCRouteStep initWithInstructions:distance:firstPointIndex:]"
+                                 userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithInstructions:(NSString *)instructions
+                            distance:(CLLocationDistance)distance
+                     firstPointIndex:(NSUInteger)firstPointIndex
+{
+    self = [super init];
+    if (self) {
+        _instructions = [instructions copy];
+        _distance = distance;
+        _firstPointIndex = firstPointIndex;
+    }
+    return self;
+}
+
+@end
+
+
+@implementation RTCRoute
+
+#pragma mark - Initialization
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"RTCRoute"
+                                   reason:@"Use - [RTCRoute initWithPolyline:steps:distance:expectedTravelTime:source:]"
+                                 userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithPolyline:(MKPolyline *)polyline
+                           steps:(NSArray *)steps
+                        distance:(CLLocationDistance)distance
+              expectedTravelTime:(NSTimeInterval)expectedTravelTime
+                          source:(RTCRouteSource)source
+{
+    self = [super init];
+    if (self) {
+        _polyline = polyline;
+        _steps = [steps copy];
+        _distance = distance;
+        _expectedTravelTime = expectedTravelTime;
+        _source = source;
+    }
+    return self;
+}
+
+@end
@@ -0,0 +1,69 @@
+//
+//  RTCTilePackManager.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/30/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+#import "RTCRoute.h"
+
+/**
+ * RTCTilePackManager is a singleton class that keeps map tiles of the saved
+ * places' neighbourhoods, and the routes to them, for when there is no signal
+ * to load the map (in a parking garage, say).
+ *
+ * Tiles are downloaded from kRTCTileServerURLTemplate in the background and
+ * kept in one memory mapped file in the app's caches directory (see
+ * rtc::TilePack). The least recently used neighbourhoods are dropped to stay
+ * within kRTCTilePackMaxBytes.
+ *
+ * Map views show the kept tiles by adding tileOverlay. It only draws tiles
+ * in the pack, so elsewhere the map is as it always was.
+ */
+@interface RTCTilePackManager : NSObject
+
+#pragma mark - Properties
+/**
+ * Overlay drawing the kept tiles, shared by all map views. Add it under any
+ * other overlays.
+ */
+@property (nonatomic, strong, readonly) MKTileOverlay *tileOverlay;
+
+
+#pragma mark - Class Methods
+/**
+ * Single instance manager.
+ * It creates the instance if this hasn't been done or simply returns it.
+ *
+ * @return An initialized RTCTilePackManager object.
+ */
++ (instancetype)sharedManager;
+
+/**
+ * File the tiles are kept in
+ */
++ (NSURL *)tilePackURL;
+
+
+#pragma mark - Instance Methods
+/**
+ * Keep the map around a place, and along route to it if it isn't nil,
+ * downloading what isn't kept already. Also marks the place as just used.
+ * Does nothing if kRTCTileServerURLTemplate is empty.
+ *
+ * @param coordinate    the place
+ * @param route         route to the place, or nil
+ */
+- (void)prefetchTilesAroundCoordinate:(CLLocationCoordinate2D)coordinate route:(RTCRoute *)route;
+
+/**
+ * Contents of a kept tile, safe to call from any thread.
+ *
+ * @return nil if the tile isn't kept.
+ */
+- (NSData *)tileDataAtPath:(MKTileOverlayPath)path;
+
+@end
@@ -0,0 +1,333 @@
+//
+//  RTCTilePackManager.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/30/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCTilePackManager.h"
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "RTCTilePack.h"
+#include "RTCTrace.h"
+
+#pragma mark - Constants
+// Relative address of the tile pack in the caches directory
+static NSString *const kTilePackPath = @"Tiles.pack";
+
+
+#pragma mark - RTCTilePackOverlay
+/**
+ * RTCTilePackOverlay draws the tiles kept by the tile pack manager, and
+ * nothing where there are none so the map underneath shows through.
+ * It never goes to the network itself.
+ */
+@interface RTCTilePackOverlay : MKTileOverlay
+@end
+
+@implementation RTCTilePackOverlay
+
+- (void)loadTileAtPath:(MKTileOverlayPath)path result:(void (^)(NSData *, NSError *))result
+{
+    if (result) result([[RTCTilePackManager sharedManager] tileDataAtPath:path], nil);
+}
+
+@end
+
+
+#pragma mark - RTCTilePackManager
+/**
+ * A neighbourhood waiting to be put in the pack
+ */
+struct PendingRegion {
+    std::string name;
+    std::vector<rtc::TileID> tiles;
+    double lastUsed;
+};
+
+@interface RTCTilePackManager () {
+    // the pack tiles are served from. Only touched on packQueue, and only
+    // swapped out from prefetchQueue.
+    std::unique_ptr<rtc::TilePack> _pack;
+
+    // Only touched on prefetchQueue.
+    std::vector<PendingRegion> _pendingRegions;
+    std::map<std::string, PendingRegion> _touchedRegions;  // newly used, but nothing new to fetch
+    std::unique_ptr<rtc::TilePackBuilder> _builder;
+}
+
+@property (nonatomic, strong, readwrite) MKTileOverlay *tileOverlay;
+
+// tile lookups and pack swaps run here
+@property (strong, nonatomic) dispatch_queue_t packQueue;
+// building and writing the pack runs here, off the main queue
+@property (strong, nonatomic) dispatch_queue_t prefetchQueue;
+
+// memory mapped pack file backing _pack
+@property (strong, nonatomic) NSData *packData;
+
+// tile downloads, their completion handlers run one at a time
+@property (strong, nonatomic) NSURLSession *session;
+
+// is the pack being updated? Only touched on prefetchQueue.
+@property (nonatomic) BOOL updating;
+
+@end
+
+
+@implementation RTCTilePackManager
+
+#pragma mark - Class methods
+#pragma mark Public
+// Declare a static variable, which is an instance of this class
+// It is initialized once and only once in a thread-safe manner by using
+//   Grand Central Dispatch (GCD)
++ (instancetype)sharedManager
+{
+    static RTCTilePackManager *sharedInstance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [[self alloc] initPrivate];
+    });
+    return sharedInstance;
+}
+
++ (NSURL *)tilePackURL
+{
+    NSURL *cachesURL = [[[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask] lastObject];
+    return [cachesURL URLByAppendingPathComponent:kTilePackPath];
+}
+
+
+#pragma mark - Initialization
+// if a programmer calls [RTCTilePackManager alloc] init], let them know the
+//   error of their ways.
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"Singleton"
+                                   reason:@"Use + [RTCTilePackManager sharedManager]"
+                                 userInfo:nil];
+    return nil;
+}
+
+// here is the real (secret) initializer
+- (instancetype)initPrivate
+{
+    self = [super init];
+    if (self) {
+        _pack.reset(new rtc::TilePack());
+
+        // a missing or unreadable pack just means starting empty
+        NSData *data = [NSData dataWithContentsOfURL:[RTCTilePackManager tilePackURL]
+                                             options:NSDataReadingMappedAlways
+                                               error:NULL];
+        if (data && _pack->attach([data bytes], [data length])) _packData = data;
+        else _pack.reset(new rtc::TilePack());
+
+        NSString *URLTemplate = [kRTCTileServerURLTemplate length] ? kRTCTileServerURLTemplate : nil;
+        _tileOverlay = [[RTCTilePackOverlay alloc] initWithURLTemplate:URLTemplate];
+        _tileOverlay.canReplaceMapContent = NO;
+
+        _packQueue = dispatch_queue_create("com.retracapp.tiles", DISPATCH_QUEUE_SERIAL);
+        _prefetchQueue = dispatch_queue_create("com.retracapp.tiles.prefetch", DISPATCH_QUEUE_SERIAL);
+
+        NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+        configuration.HTTPMaximumConnectionsPerHost = kRTCTilePackMaxConnections;
+        NSOperationQueue *delegateQueue = [[NSOperationQueue alloc] init];
+        delegateQueue.maxConcurrentOperationCount = 1;
+        _session = [NSURLSession sessionWithConfiguration:configuration delegate:nil delegateQueue:delegateQueue];
+    }
+    return self;
+}
+
+
+#pragma mark - Class Methods
+#pragma mark Private
+/**
+ * Tile pack policy built from the app's offline map settings
+ */
++ (rtc::TilePackPolicy)tilePackPolicy
+{
+    rtc::TilePackPolicy policy;
+    policy.minZoom = (unsigned)kRTCTilePackMinZoom;
+    policy.maxZoom = (unsigned)kRTCTilePackMaxZoom;
+    policy.placeRadius = kRTCTilePackPlaceRadius;
+    policy.routeCorridor = kRTCTilePackRouteCorridor;
+    policy.maxBytes = kRTCTilePackMaxBytes;
+    return policy;
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Private
+/**
+ * Put the pending neighbourhoods in the pack, downloading their missing
+ * tiles. Neighbourhoods that come in meanwhile wait for the next round, so
+ * a burst of them costs one pack rewrite. Call on prefetchQueue.
+ */
+- (void)updatePack
+{
+    if (self.updating || _pendingRegions.empty()) return;
+    self.updating = YES;
+
+    // the old pack isn't swapped out until the builder is done with it
+    _builder.reset(new rtc::TilePackBuilder(*_pack));
+    BOOL hasNewRegion = NO;
+    for (std::map<std::string, PendingRegion>::const_iterator it = _touchedRegions.begin(); it != _touchedRegions.end(); ++it) {
+        const PendingRegion &region = it->second;
+        if (_builder->hasRegion(region.name)) _builder->setRegion(region.name, region.tiles, region.lastUsed);
+    }
+    for (size_t i = 0; i < _pendingRegions.size(); ++i) {
+        const PendingRegion &region = _pendingRegions[i];
+        hasNewRegion = hasNewRegion || !_builder->hasRegion(region.name);
+        _builder->setRegion(region.name, region.tiles, region.lastUsed);
+    }
+
+    std::vector<rtc::TileID> missing = _builder->missingTiles();
+    if (missing.empty() && !hasNewRegion) {
+        [self skipUpdate];
+        return;
+    }
+    std::vector<PendingRegion> regions;
+    regions.swap(_pendingRegions);
+
+    NSMutableDictionary *fetched = [[NSMutableDictionary alloc] init];
+    dispatch_group_t group = dispatch_group_create();
+    for (size_t i = 0; i < missing.size(); ++i) {
+        rtc::TileID tile = missing[i];
+        MKTileOverlayPath path;
+        path.x = rtc::tileX(tile);
+        path.y = rtc::tileY(tile);
+        path.z = rtc::tileZoom(tile);
+        path.contentScaleFactor = 1.0;
+        NSURL *url = [self.tileOverlay URLForTilePath:path];
+        if (!url) continue;
+
+        dispatch_group_enter(group);
+        NSURLSessionDataTask *task = [self.session dataTaskWithURL:url completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+            // handlers run one at a time on the session's queue
+            NSInteger statusCode = [response isKindOfClass:[NSHTTPURLResponse class]] ? [(NSHTTPURLResponse *)response statusCode] : 0;
+            if (data && statusCode == 200) fetched[@(tile)] = data;
+            dispatch_group_leave(group);
+        }];
+        [task resume];
+    }
+
+    dispatch_group_notify(group, self.prefetchQueue, ^{
+        if (![fetched count] && !hasNewRegion) {
+            // offline, most likely: try again the next time one is used
+            for (size_t i = 0; i < regions.size(); ++i) _touchedRegions[regions[i].name] = regions[i];
+            _builder.reset();
+            self.updating = NO;
+            [self updatePack];
+            return;
+        }
+        _touchedRegions.clear();
+        for (NSNumber *tile in fetched) {
+            NSData *data = fetched[tile];
+            _builder->addTile([tile unsignedLongLongValue], [data bytes], [data length]);
+        }
+        [self writePack];
+        self.updating = NO;
+        [self updatePack];
+    });
+}
+
+/**
+ * Keep the pending neighbourhoods' last used times for the next rewrite, as
+ * they aren't worth one on their own. Call on prefetchQueue.
+ */
+- (void)skipUpdate
+{
+    for (size_t i = 0; i < _pendingRegions.size(); ++i) {
+        _touchedRegions[_pendingRegions[i].name] = _pendingRegions[i];
+    }
+    _pendingRegions.clear();
+    _builder.reset();
+    self.updating = NO;
+}
+
+/**
+ * Write the builder's pack next to the old one and swap it in, so a failure
+ * keeps the old one. Call on prefetchQueue.
+ */
+- (void)writePack
+{
+    rtc::TraceScope scope(rtc::Tracer::sharedTracer(), "tiles.write");
+    _builder->evict([RTCTilePackManager tilePackPolicy].maxBytes);
+
+    NSURL *packURL = [RTCTilePackManager tilePackURL];
+    NSURL *temporaryURL = [packURL URLByAppendingPathExtension:@"new"];
+    std::ofstream output([[temporaryURL path] fileSystemRepresentation], std::ios::binary | std::ios::trunc);
+    BOOL success = _builder->write(output);
+    output.close();
+    success = success && output;
+    _builder.reset();
+
+    // the old mapping stays valid after its file is removed, so lookups
+    // carry on until the swap
+    NSData *data = nil;
+    std::unique_ptr<rtc::TilePack> pack(new rtc::TilePack());
+    if (success) {
+        [[NSFileManager defaultManager] removeItemAtURL:packURL error:NULL];
+        success = [[NSFileManager defaultManager] moveItemAtURL:temporaryURL toURL:packURL error:NULL];
+    }
+    if (success) {
+        data = [NSData dataWithContentsOfURL:packURL options:NSDataReadingMappedAlways error:NULL];
+        success = data && pack->attach([data bytes], [data length]);
+    }
+    [[NSFileManager defaultManager] removeItemAtURL:temporaryURL error:NULL];
+    if (!success) return;
+
+    dispatch_sync(self.packQueue, ^{
+        _pack.swap(pack);
+        self.packData = data;
+    });
+}
+
+
+#pragma mark Public
+- (void)prefetchTilesAroundCoordinate:(CLLocationCoordinate2D)coordinate route:(RTCRoute *)route
+{
+    if (![kRTCTileServerURLTemplate length]) return;
+
+    PendingRegion region;
+    region.name = [[NSString stringWithFormat:@"%.6f,%.6f", coordinate.latitude, coordinate.longitude] UTF8String];
+    region.lastUsed = [[NSDate date] timeIntervalSince1970];
+
+    std::vector<rtc::GeoPoint> polyline;
+    MKMapPoint *points = route.polyline.points;
+    polyline.reserve(route.polyline.pointCount);
+    for (NSUInteger i = 0; i < route.polyline.pointCount; ++i) {
+        CLLocationCoordinate2D routeCoordinate = MKCoordinateForMapPoint(points[i]);
+        polyline.push_back(rtc::GeoPoint(routeCoordinate.latitude, routeCoordinate.longitude));
+    }
+
+    dispatch_async(self.prefetchQueue, ^{
+        PendingRegion pending = region;
+        pending.tiles = rtc::neighbourhoodTiles(rtc::GeoPoint(coordinate.latitude, coordinate.longitude),
+                                                polyline, [RTCTilePackManager tilePackPolicy]);
+        _pendingRegions.push_back(pending);
+        [self updatePack];
+    });
+}
+
+- (NSData *)tileDataAtPath:(MKTileOverlayPath)path
+{
+    if (path.z < 0 || path.z > (NSInteger)rtc::kMaxTileZoom || path.x < 0 || path.y < 0) return nil;
+    rtc::TileID tile = rtc::tileID((unsigned)path.z, (uint32_t)path.x, (uint32_t)path.y);
+
+    __block NSData *data = nil;
+    dispatch_sync(self.packQueue, ^{
+        rtc::TilePack::Tile contents;
+        // copied, as the mapping may be swapped out once this returns
+        if (_pack->tile(tile, &contents)) data = [NSData dataWithBytes:contents.data length:contents.size];
+    });
+    return data;
+}
+
+@end
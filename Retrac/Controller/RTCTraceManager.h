@@ -0,0 +1,73 @@
+//
+//  RTCTraceManager.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/25/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+typedef unsigned long long RTCTraceSpan;
+
+/**
+ * RTCTraceManager is a singleton class that lets Objective-C code trace to
+ * the shared rtc::Tracer, and writes what it recorded out. C++ code can use
+ * rtc::Tracer::sharedTracer() directly.
+ *
+ * Tracing is off unless kRTCTraceEnabled is set, and costs next to nothing
+ * while off. Names must be C string literals, e.g. "document.open".
+ */
+@interface RTCTraceManager : NSObject
+
+#pragma mark - Properties
+/**
+ * Is tracing on? Starts out as kRTCTraceEnabled.
+ */
+@property (nonatomic, getter=isEnabled) BOOL enabled;
+
+
+#pragma mark - Class Methods
+/**
+ * Single instance manager.
+ * It creates the instance if this hasn't been done or simply returns it.
+ *
+ * @return An initialized RTCTraceManager object.
+ */
++ (instancetype)sharedManager;
+
+
+#pragma mark - Instance Methods
+/**
+ * Start a span, which may end in a completion handler.
+ *
+ * @return span to pass to `endSpan:`, 0 if tracing is off.
+ */
+- (RTCTraceSpan)beginSpan:(const char *)name;
+
+- (void)endSpan:(RTCTraceSpan)span;
+
+/**
+ * Add one to a counter
+ */
+- (void)incrementCounter:(const char *)name;
+
+/**
+ * Record a value in a histogram
+ */
+- (void)recordValue:(double)value forHistogram:(const char *)name;
+
+/**
+ * Percentiles of everything recorded so far, as a table
+ */
+- (NSString *)summary;
+
+/**
+ * If tracing is on, write the Chrome trace (Trace.json) and summary
+ * (Trace.txt) to the caches directory and log the summary.
+ *
+ * @return NO if the files couldn't be written.
+ */
+- (BOOL)saveTrace;
+
+@end
@@ -0,0 +1,124 @@
+//
+//  RTCTraceManager.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/25/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCTraceManager.h"
+#include <fstream>
+#include <sstream>
+#include "RTCTrace.h"
+
+#pragma mark - Constants
+// Relative addresses of the trace files in the caches directory
+static NSString *const kTraceJSONPath = @"Trace.json";
+static NSString *const kTraceSummaryPath = @"Trace.txt";
+
+
+@implementation RTCTraceManager
+
+#pragma mark - Properties
+- (BOOL)isEnabled
+{
+    return rtc::Tracer::sharedTracer().enabled();
+}
+
+- (void)setEnabled:(BOOL)enabled
+{
+    rtc::Tracer::sharedTracer().setEnabled(enabled);
+}
+
+
+#pragma mark - Class methods
+#pragma mark Public
+// Declare a static variable, which is an instance of this class
+// It is initialized once and only once in a thread-safe manner by using
+//   Grand Central Dispatch (GCD)
++ (instancetype)sharedManager
+{
+    static RTCTraceManager *sharedInstance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [[self alloc] initPrivate];
+    });
+    return sharedInstance;
+}
+
+
+#pragma mark - Initialization
+// if a programmer calls [RTCTraceManager alloc] init], let them know the
+//   error of their ways.
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"Singleton"
+                                   reason:@"Use + [RTCTraceManager sharedManager]"
+                                 userInfo:nil];
+    return nil;
+}
+
+// here is the real (secret) initializer
+- (instancetype)initPrivate
+{
+    self = [super init];
+    if (self) {
+        self.enabled = kRTCTraceEnabled;
+    }
+    return self;
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Public
+- (RTCTraceSpan)beginSpan:(const char *)name
+{
+    return rtc::Tracer::sharedTracer().beginSpan(name);
+}
+
+- (void)endSpan:(RTCTraceSpan)span
+{
+    rtc::Tracer::sharedTracer().endSpan(span);
+}
+
+- (void)incrementCounter:(const char *)name
+{
+    rtc::Tracer::sharedTracer().addCounter(name);
+}
+
+- (void)recordValue:(double)value forHistogram:(const char *)name
+{
+    rtc::Tracer::sharedTracer().recordValue(name, value);
+}
+
+- (NSString *)summary
+{
+    std::ostringstream out;
+    rtc::Tracer::sharedTracer().writeSummary(out);
+    return [NSString stringWithUTF8String:out.str().c_str()];
+}
+
+- (BOOL)saveTrace
+{
+    if (!self.enabled) return YES;
+    
+    NSURL *cachesURL = [[[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask] lastObject];
+    NSURL *jsonURL = [cachesURL URLByAppendingPathComponent:kTraceJSONPath];
+    NSURL *summaryURL = [cachesURL URLByAppendingPathComponent:kTraceSummaryPath];
+    
+    std::ofstream output([[jsonURL path] fileSystemRepresentation], std::ios::trunc);
+    rtc::Tracer::sharedTracer().writeChromeTrace(output);
+    output.close();
+    
+    NSString *summary = [self summary];
+    NSError *error = nil;
+    BOOL saved = !output.fail() && [summary writeToURL:summaryURL atomically:YES encoding:NSUTF8StringEncoding error:&error];
+    if (saved) {
+        NSLog(@"[%@ %@] %@\n%@", NSStringFromClass([self class]), NSStringFromSelector(_cmd), [jsonURL path], summary);
+    } else {
+        NSLog(@"[%@ %@] %@ (%@)", NSStringFromClass([self class]), NSStringFromSelector(_cmd), [error localizedDescription], [cachesURL path]);
+    }
+    return saved;
+}
+
+@end
@@ -0,0 +1,92 @@
+//
+//  RTCBackgroundWriter.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/19/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreData/CoreData.h>
+
+typedef void (^RTCWriteBlock)(NSManagedObjectContext *context);
+
+/**
+ * RTCBackgroundWriter makes inserts and updates on a private queue context so
+ * the main queue never waits on them.
+ *
+ * The writer context is a sibling of the main queue context: it shares the
+ * main context's parent (UIManagedDocument's private queue context) or, for a
+ * context with no parent, its persistent store coordinator. Writes are run in
+ * the order they were queued and saved together, kRTCWriteBatchSize at a time
+ * or kRTCWriteBatchDelay after the first unsaved one, whichever comes first.
+ * Each save is then merged into the main context asynchronously, which is when
+ * fetched results controllers and the place index see it.
+ *
+ * Save latency (queueing a write to it showing up in the main context) and
+ * the main queue time spent merging are recorded for tuning.
+ */
+@interface RTCBackgroundWriter : NSObject
+
+#pragma mark - Properties
+/**
+ * The main queue context saved writes are merged into
+ */
+@property (strong, nonatomic, readonly) NSManagedObjectContext *managedObjectContext;
+
+/**
+ * Called on the main queue after each save has been merged. With a
+ * UIManagedDocument, use it to tell the document it has changes to autosave,
+ * since the writes bypassed its context.
+ */
+@property (copy, nonatomic) void (^writesMerged)(void);
+
+/**
+ * Number of writes saved and merged
+ */
+@property (nonatomic, readonly) NSUInteger numWrites;
+
+/**
+ * Number of saves they took
+ */
+@property (nonatomic, readonly) NSUInteger numSaves;
+
+/**
+ * Total time (in seconds) the main queue spent merging saves
+ */
+@property (nonatomic, readonly) NSTimeInterval mainQueueTime;
+
+
+#pragma mark - Initialization
+/**
+ * @param context   main queue context to merge writes into
+ */
+- (instancetype)initWithManagedObjectContext:(NSManagedObjectContext *)context;
+
+
+#pragma mark - Instance Methods
+/**
+ * Queue a write. block is run on the writer's private queue with the writer
+ * context and must only touch objects from that context; pass object IDs in,
+ * not objects.
+ */
+- (void)performWrite:(RTCWriteBlock)block;
+
+/**
+ * Save and merge queued writes now rather than waiting for the batch to fill.
+ *
+ * @param writesSaved   block called on the main queue once every write queued
+ *                      before this call is in the main context
+ */
+- (void)flushWrites:(void (^)(void))writesSaved;
+
+/**
+ * Save latency (in seconds) at a percentile of the most recent writes
+ *
+ * @param percentile    between 0 and 1, e.g. 0.99
+ *
+ * @return 0 if nothing has been written yet.
+ */
+- (NSTimeInterval)saveLatencyAtPercentile:(double)percentile;
+
+@end
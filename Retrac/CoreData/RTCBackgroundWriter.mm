@@ -0,0 +1,187 @@
+//
+//  RTCBackgroundWriter.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/19/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCBackgroundWriter.h"
+#import "RTCWorkScheduler.h"
+#include <algorithm>
+#include <vector>
+#include "RTCClock.h"
+#include "RTCTrace.h"
+
+#pragma mark - Constants
+// number of most recent save latencies kept for percentiles
+static const size_t kMaxLatencySamples = 1000;
+
+
+@interface RTCBackgroundWriter () {
+    // times writes run but not yet saved were queued. Writer queue only.
+    std::vector<double> _unsavedWriteTimes;
+
+    // save latencies of the most recent writes. Main queue only.
+    std::vector<double> _latencies;
+}
+
+// want all properties to be readwrite internally
+@property (strong, nonatomic, readwrite) NSManagedObjectContext *managedObjectContext;
+@property (nonatomic, readwrite) NSUInteger numWrites;
+@property (nonatomic, readwrite) NSUInteger numSaves;
+@property (nonatomic, readwrite) NSTimeInterval mainQueueTime;
+
+// private queue context the writes are made in
+@property (strong, nonatomic) NSManagedObjectContext *writerContext;
+
+// notification of the writer context's last save, to be merged. Writer queue
+//   only.
+@property (strong, nonatomic) NSNotification *unmergedSave;
+
+// is a save of the unsaved writes already scheduled? Writer queue only.
+@property (nonatomic) BOOL saveScheduled;
+
+// where the scheduled save waits out kRTCWriteBatchDelay; the writer context's
+//   own queue isn't ours to hand to RTCWorkScheduler
+@property (strong, nonatomic) RTCWorkQueue *saveQueue;
+
+@end
+
+
+@implementation RTCBackgroundWriter
+
+#pragma mark - Initialization
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"RTCBackgroundWriter"
+                                   reason:@"Use - [RTCBackgroundWriter initWithManagedObjectContext:]"
+                                 userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithManagedObjectContext:(NSManagedObjectContext *)context
+{
+    self = [super init];
+    if (self) {
+        _managedObjectContext = context;
+
+        // a sibling of context, so saving doesn't go through the main queue
+        _writerContext = [[NSManagedObjectContext alloc] initWithConcurrencyType:NSPrivateQueueConcurrencyType];
+        if (context.parentContext) {
+            _writerContext.parentContext = context.parentContext;
+        } else {
+            _writerContext.persistentStoreCoordinator = context.persistentStoreCoordinator;
+        }
+        // background writes fill in data; they win over stale copies
+        _writerContext.mergePolicy = NSMergeByPropertyObjectTrumpMergePolicy;
+        _saveQueue = [[RTCWorkQueue alloc] initWithLabel:@"com.retracapp.writer"];
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(writerContextDidSave:)
+                                                     name:NSManagedObjectContextDidSaveNotification
+                                                   object:_writerContext];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Public
+- (void)performWrite:(RTCWriteBlock)block
+{
+    double queued = rtc::SystemClock::sharedClock().now();
+    NSManagedObjectContext *writerContext = self.writerContext;
+
+    [writerContext performBlock:^{
+        if (block) block(writerContext);
+        _unsavedWriteTimes.push_back(queued);
+
+        if (_unsavedWriteTimes.size() >= kRTCWriteBatchSize) {
+            [self saveWrites:nil];
+        } else if (!self.saveScheduled) {
+            self.saveScheduled = YES;
+            [[RTCWorkScheduler sharedScheduler] performBlock:^{
+                [writerContext performBlock:^{
+                    self.saveScheduled = NO;
+                    [self saveWrites:nil];
+                }];
+            } onQueue:self.saveQueue afterDelay:kRTCWriteBatchDelay];
+        }
+    }];
+}
+
+- (void)flushWrites:(void (^)(void))writesSaved
+{
+    [self.writerContext performBlock:^{
+        [self saveWrites:writesSaved];
+    }];
+}
+
+- (NSTimeInterval)saveLatencyAtPercentile:(double)percentile
+{
+    std::vector<double> sorted(_latencies);
+    std::sort(sorted.begin(), sorted.end());
+    return rtc::percentile(sorted, percentile);
+}
+
+
+#pragma mark Private
+/**
+ * Save the unsaved writes, then merge them into the main context on the main
+ *   queue. Called on the writer queue.
+ *
+ * @param writesSaved   block called on the main queue after the merge
+ */
+- (void)saveWrites:(void (^)(void))writesSaved
+{
+    std::vector<double> writeTimes;
+    writeTimes.swap(_unsavedWriteTimes);
+
+    NSManagedObjectContext *writerContext = self.writerContext;
+    if ([writerContext hasChanges]) {
+        // the main context has to see the same IDs the store will
+        NSError *error = nil;
+        [writerContext obtainPermanentIDsForObjects:[[writerContext insertedObjects] allObjects] error:&error];
+        if (!error) [writerContext save:&error];
+        if (error) {
+            NSLog(@"[%@ %@] %@ (%@)", NSStringFromClass([self class]), NSStringFromSelector(_cmd), [error localizedDescription], [error localizedFailureReason]);
+            [writerContext rollback];
+        }
+    }
+
+    NSNotification *save = self.unmergedSave;
+    self.unmergedSave = nil;
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+        double start = rtc::SystemClock::sharedClock().now();
+        if (save) [self.managedObjectContext mergeChangesFromContextDidSaveNotification:save];
+        double merged = rtc::SystemClock::sharedClock().now();
+
+        self.mainQueueTime += merged - start;
+        if (save) self.numSaves++;
+        self.numWrites += writeTimes.size();
+        for (size_t i = 0; i < writeTimes.size(); ++i) _latencies.push_back(merged - writeTimes[i]);
+        if (_latencies.size() > kMaxLatencySamples) {
+            _latencies.erase(_latencies.begin(), _latencies.end() - kMaxLatencySamples);
+        }
+
+        if (save && self.writesMerged) self.writesMerged();
+        if (writesSaved) writesSaved();
+    });
+}
+
+
+#pragma mark - Notification Observer Methods
+// posted on the writer queue, during the save
+- (void)writerContextDidSave:(NSNotification *)notification
+{
+    self.unmergedSave = notification;
+}
+
+@end
@@ -7,6 +7,13 @@
 //
 
 #import <Foundation/Foundation.h>
+#import "RTCPlaceIndex.h"
+#import "RTCPlaceSearchIndex.h"
+#import "RTCPlaceSyncLog.h"
+#import "RTCBackgroundWriter.h"
+#import "RTCPlaceArchiver.h"
+#import "RTCPlaceSnapshot.h"
+#import "RTCPlaceDeduplicator.h"
 
 /**
  * RTCModelManager is a singleton class that ensures we have just one instance
@@ -23,6 +30,43 @@
  */
 @property (strong, nonatomic, readonly) NSManagedObjectContext *managedObjectContext;
 
+/**
+ * Spatial index over the places in managedObjectContext. Available whenever
+ * managedObjectContext is.
+ */
+@property (strong, nonatomic, readonly) RTCPlaceIndex *placeIndex;
+
+/**
+ * Name and address search over the places in managedObjectContext. Available
+ * whenever managedObjectContext is.
+ */
+@property (strong, nonatomic, readonly) RTCPlaceSearchIndex *placeSearchIndex;
+
+/**
+ * Log of changes to the places in managedObjectContext, for syncing them with
+ * the user's other devices. Available whenever managedObjectContext is.
+ */
+@property (strong, nonatomic, readonly) RTCPlaceSyncLog *placeSyncLog;
+
+/**
+ * Writes places off the main queue and merges them into managedObjectContext.
+ * Available whenever managedObjectContext is.
+ */
+@property (strong, nonatomic, readonly) RTCBackgroundWriter *backgroundWriter;
+
+/**
+ * Finds the saved place a new fix is the same spot as, and merges duplicates
+ * in the store. Available whenever managedObjectContext is.
+ */
+@property (strong, nonatomic, readonly) RTCPlaceDeduplicator *placeDeduplicator;
+
+/**
+ * The places list as last saved, for showing before managedObjectContext is
+ * available. Loaded as soon as the document is set up; nil if it was never
+ * saved.
+ */
+@property (strong, nonatomic, readonly) RTCPlaceSnapshot *placeSnapshot;
+
 
 #pragma mark - Class Methods
 /**
@@ -49,7 +93,8 @@
 
 
 /**
- * Asynchronously save and close UIManagedDocument.
+ * Asynchronously save and close UIManagedDocument, after any queued
+ * background writes.
  *
  * @param documentIsClosed
  *      block to be called when document is closed successfully.
@@ -58,11 +103,44 @@
 
 
 /**
- * Force an asynchronous manual save of the usually auto-saved UIManagedDocument.
+ * Force an asynchronous manual save of the usually auto-saved UIManagedDocument,
+ * including any queued background writes, then sync places with the user's
+ * other devices.
  *
  * @param documentIsSaved
  *      block to be called when document is saved.
  */
 - (void)savePlacesDocument:(void (^)())documentIsSaved;
 
+
+/**
+ * Save the first places of the list as placeSnapshot for the next launch.
+ *
+ * @return NO if there is no managedObjectContext or the snapshot couldn't be
+ *      written.
+ */
+- (BOOL)savePlaceSnapshot;
+
+
+/**
+ * Save the document, then export its places to a file in the background.
+ *
+ * @param completion
+ *      block called on the main queue with the number of places exported
+ */
+- (void)exportPlacesToURL:(NSURL *)fileURL
+                   format:(RTCPlaceArchiveFormat)format
+               completion:(void (^)(BOOL success, NSUInteger numPlaces))completion;
+
+/**
+ * Import places from a file in the background. Once they're in, the place
+ * index is rebuilt and kRTCMOCAvailableNotification posted again so listeners
+ * refetch.
+ *
+ * @param completion
+ *      block called on the main queue with the number of places imported
+ */
+- (void)importPlacesFromURL:(NSURL *)fileURL
+                 completion:(void (^)(BOOL success, NSUInteger numPlaces))completion;
+
 @end
@@ -8,15 +8,35 @@
 
 #import "RTCModelManager.h"
 #import <CoreData/CoreData.h>
+#import "RTCPlace.h"
+#import "RTCGeocodingManager.h"
+#import "RTCTraceManager.h"
 
 // Constants
 // Relative address of UIManagedDocument
 static NSString *const kPlacesDocumentPath = @"PlacesDocument";
+// Relative address of the places spatial index, kept next to the document
+static NSString *const kPlacesIndexPath = @"PlacesIndex";
+// Relative address of the places search index, also next to the document
+static NSString *const kPlacesSearchIndexPath = @"PlacesSearchIndex";
+// Relative address of the places sync log, also next to the document
+static NSString *const kPlacesSyncLogPath = @"PlacesSyncLog";
+// Relative address of the launch snapshot of the places list, also next to it
+static NSString *const kPlacesSnapshotPath = @"PlacesSnapshot";
 
 @interface RTCModelManager ()
 
 // want all properties to be readwrite internally
 @property (strong, nonatomic, readwrite) NSManagedObjectContext *managedObjectContext;
+@property (strong, nonatomic, readwrite) RTCPlaceIndex *placeIndex;
+@property (strong, nonatomic, readwrite) RTCPlaceSearchIndex *placeSearchIndex;
+@property (strong, nonatomic, readwrite) RTCPlaceSyncLog *placeSyncLog;
+@property (strong, nonatomic, readwrite) RTCBackgroundWriter *backgroundWriter;
+@property (strong, nonatomic, readwrite) RTCPlaceDeduplicator *placeDeduplicator;
+@property (strong, nonatomic, readwrite) RTCPlaceSnapshot *placeSnapshot;
+
+// bulk import and export, on the document's store
+@property (strong, nonatomic) RTCPlaceArchiver *placeArchiver;
 
 /**
  * This app does not have user authentication, so we will have just one document
@@ -35,6 +55,73 @@ static NSString *const kPlacesDocumentPath = @"PlacesDocument";
     self.managedObjectContext = nil;
 }
 
+- (void)setManagedObjectContext:(NSManagedObjectContext *)managedObjectContext
+{
+    if (managedObjectContext == _managedObjectContext) return;
+    [[NSNotificationCenter defaultCenter] removeObserver:self
+                                                    name:NSManagedObjectContextDidSaveNotification
+                                                  object:nil];
+    _managedObjectContext = managedObjectContext;
+
+    // the place index always follows the context it indexes
+    if (managedObjectContext) {
+        // its share of document.open
+        RTCTraceSpan span = [[RTCTraceManager sharedManager] beginSpan:"document.setup"];
+
+        // bring v1 places across first so the index sees their coordinates
+        [RTCPlace migrateLegacyPlacesInManagedObjectContext:managedObjectContext];
+        // and name places from before sync so the log can refer to them
+        [RTCPlace assignSyncIDsInManagedObjectContext:managedObjectContext];
+
+        NSURL *indexURL = [[self.placesDocument.fileURL URLByDeletingLastPathComponent] URLByAppendingPathComponent:kPlacesIndexPath];
+        self.placeIndex = [[RTCPlaceIndex alloc] initWithManagedObjectContext:managedObjectContext
+                                                                      fileURL:indexURL];
+        NSURL *searchIndexURL = [[self.placesDocument.fileURL URLByDeletingLastPathComponent] URLByAppendingPathComponent:kPlacesSearchIndexPath];
+        self.placeSearchIndex = [[RTCPlaceSearchIndex alloc] initWithManagedObjectContext:managedObjectContext
+                                                                                  fileURL:searchIndexURL];
+        NSURL *syncLogURL = [[self.placesDocument.fileURL URLByDeletingLastPathComponent] URLByAppendingPathComponent:kPlacesSyncLogPath];
+        self.placeSyncLog = [[RTCPlaceSyncLog alloc] initWithManagedObjectContext:managedObjectContext
+                                                                          fileURL:syncLogURL];
+
+        // background writes skip the document's context, so tell the document
+        //   it has changes to autosave once they are merged
+        UIManagedDocument *document = self.placesDocument;
+        self.backgroundWriter = [[RTCBackgroundWriter alloc] initWithManagedObjectContext:managedObjectContext];
+        self.backgroundWriter.writesMerged = ^{
+            [document updateChangeCount:UIDocumentChangeDone];
+        };
+
+        self.placeDeduplicator = [[RTCPlaceDeduplicator alloc] initWithManagedObjectContext:managedObjectContext
+                                                                                     writer:self.backgroundWriter];
+
+        self.placeArchiver = [[RTCPlaceArchiver alloc] initWithPersistentStoreCoordinator:managedObjectContext.persistentStoreCoordinator];
+
+        // fill in addresses of places saved without a network
+        [[RTCGeocodingManager sharedManager] geocodePlacesMissingPlacemarksWithWriter:self.backgroundWriter];
+
+        // pick up what other devices changed while this one was closed
+        [self.placeSyncLog syncWithCompletion:nil];
+        // and pass on this one's changes whenever the document autosaves
+        //   them, which its parent context saving to the store marks
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(placesDocumentDidSave:)
+                                                     name:NSManagedObjectContextDidSaveNotification
+                                                   object:(managedObjectContext.parentContext ?: managedObjectContext)];
+
+        // and merge duplicates that got in every so often
+        [self.placeDeduplicator compactPlacesIfDue];
+
+        [[RTCTraceManager sharedManager] endSpan:span];
+    } else {
+        self.placeIndex = nil;
+        self.placeSearchIndex = nil;
+        self.placeSyncLog = nil;
+        self.placeDeduplicator = nil;
+        self.backgroundWriter = nil;
+        self.placeArchiver = nil;
+    }
+}
+
 #pragma mark - Class methods
 #pragma mark Public
 // Declare a static variable, which is an instance of this class
@@ -93,47 +180,143 @@ static NSString *const kPlacesDocumentPath = @"PlacesDocument";
 
 
 /**
- * Asynchronously save and close UIManagedDocument.
+ * Asynchronously save and close UIManagedDocument, after any queued
+ * background writes.
  *
  * @param documentIsClosed
  *      block to be called when document is closed successfully.
  */
 - (void)closePlacesDocument:(void (^)())documentIsClosed
 {
-    [self.placesDocument closeWithCompletionHandler:^(BOOL success) {
-        // it would be ideal to check for success first, but if this fails
-        // it's game over anyways.
-        // we indicate document closure by clearing out placesDocument
-        self.placesDocument = nil;
-        
-        // notify all listeners that this managedObjectContext is no longer valid
-        [[NSNotificationCenter defaultCenter] postNotificationName:kRTCMOCDeletedNotification
-                                                            object:self];
-        if (documentIsClosed) documentIsClosed();
-    }];
+    // get queued writes into the document before it goes
+    if (self.backgroundWriter) {
+        [self.backgroundWriter flushWrites:^{
+            [self closeFlushedPlacesDocument:documentIsClosed];
+        }];
+    } else {
+        [self closeFlushedPlacesDocument:documentIsClosed];
+    }
 }
 
-
 /**
- * Force an asynchronous manual save of the usually auto-saved UIManagedDocument.
+ * Force an asynchronous manual save of the usually auto-saved UIManagedDocument,
+ * including any queued background writes, then sync places with the user's
+ * other devices.
  *
  * @param documentIsSaved
  *      block to be called when document is saved.
  */
 - (void)savePlacesDocument:(void (^)())documentIsSaved
 {
-    [self.placesDocument saveToURL:self.placesDocument.fileURL
-                forSaveOperation:UIDocumentSaveForOverwriting
-               completionHandler:^(BOOL success) {
-                   if (success) {
-                       if (documentIsSaved) documentIsSaved();
+    void (^save)(void) = ^{
+        [self.placesDocument saveToURL:self.placesDocument.fileURL
+                    forSaveOperation:UIDocumentSaveForOverwriting
+                   completionHandler:^(BOOL success) {
+                       if (success) {
+                           [self.placeIndex saveIndex];
+                           [self.placeSearchIndex saveIndex];
+                           [self.placeSyncLog saveLog];
+                           [self.placeSyncLog syncWithCompletion:nil];
+                           if (documentIsSaved) documentIsSaved();
+                       }
                    }
-               }
-     ];
+         ];
+    };
+
+    if (self.backgroundWriter) {
+        [self.backgroundWriter flushWrites:save];
+    } else {
+        save();
+    }
+}
+
+- (BOOL)savePlaceSnapshot
+{
+    if (!self.managedObjectContext) return NO;
+    return [RTCPlaceSnapshot writeSnapshotOfPlacesInManagedObjectContext:self.managedObjectContext
+                                                                   toURL:[self placeSnapshotURL]];
+}
+
+- (void)exportPlacesToURL:(NSURL *)fileURL
+                   format:(RTCPlaceArchiveFormat)format
+               completion:(void (^)(BOOL success, NSUInteger numPlaces))completion
+{
+    RTCPlaceArchiver *archiver = self.placeArchiver;
+    if (!archiver) {
+        if (completion) completion(NO, 0);
+        return;
+    }
+
+    // the export reads the store, so get everything into it first
+    [self savePlacesDocument:^{
+        [archiver exportPlacesToURL:fileURL format:format completion:completion];
+    }];
+}
+
+- (void)importPlacesFromURL:(NSURL *)fileURL
+                 completion:(void (^)(BOOL success, NSUInteger numPlaces))completion
+{
+    RTCPlaceArchiver *archiver = self.placeArchiver;
+    if (!archiver) {
+        if (completion) completion(NO, 0);
+        return;
+    }
+
+    [archiver importPlacesFromURL:fileURL completion:^(BOOL success, NSUInteger numPlaces) {
+        // the places went straight to the store, past every context, so
+        //   reindex and have listeners refetch
+        if (numPlaces && (archiver == self.placeArchiver)) {
+            [self.placeIndex rebuildIndex];
+            [self.placeSearchIndex rebuildIndex];
+            [self.placeDeduplicator rebuildIndex];
+            [self.placeSyncLog logChangesInStore];
+            [[NSNotificationCenter defaultCenter] postNotificationName:kRTCMOCAvailableNotification
+                                                                object:self];
+        }
+        if (completion) completion(success, numPlaces);
+    }];
 }
 
 
 #pragma mark - Private
+/**
+ * Location of the launch snapshot, next to the places document
+ */
+- (NSURL *)placeSnapshotURL
+{
+    NSURL *docURL = [[[NSFileManager defaultManager] URLsForDirectory:NSDocumentDirectory inDomains:NSUserDomainMask] lastObject];
+    return [docURL URLByAppendingPathComponent:kPlacesSnapshotPath];
+}
+
+/**
+ * Asynchronously save and close UIManagedDocument without waiting on
+ * background writes.
+ *
+ * @param documentIsClosed
+ *      block to be called when document is closed successfully.
+ */
+- (void)closeFlushedPlacesDocument:(void (^)())documentIsClosed
+{
+    [self.placesDocument closeWithCompletionHandler:^(BOOL success) {
+        // places now have permanent IDs so the index can be saved with them
+        [self.placeIndex saveIndex];
+        [self.placeSearchIndex saveIndex];
+        [self.placeSyncLog saveLog];
+        [self savePlaceSnapshot];
+        
+        // it would be ideal to check for success first, but if this fails
+        // it's game over anyways.
+        // we indicate document closure by clearing out placesDocument
+        self.placesDocument = nil;
+        
+        // notify all listeners that this managedObjectContext is no longer valid
+        [[NSNotificationCenter defaultCenter] postNotificationName:kRTCMOCDeletedNotification
+                                                            object:self];
+        if (documentIsClosed) documentIsClosed();
+    }];
+}
+
+
 /**
  * Setup new places document . This sets up the internal UIManagedDocument and 
  * its associated managedObjectContext
@@ -161,6 +344,10 @@ static NSString *const kPlacesDocumentPath = @"PlacesDocument";
                               NSInferMappingModelAutomaticallyOption        : @(YES)};
     self.placesDocument.persistentStoreOptions = options;
     
+    // opening the document can take a while with a big store, so have the
+    //   last saved list ready to show in the meantime. it's mapped, not read.
+    self.placeSnapshot = [RTCPlaceSnapshot snapshotWithContentsOfURL:[self placeSnapshotURL]];
+    
     // use placesDocument to setup managedObjectContext @property
     [self usePlacesDocument:^{
         // notify all listeners that this managedObjectContext is now setup
@@ -186,14 +373,18 @@ static NSString *const kPlacesDocumentPath = @"PlacesDocument";
     // access the shared instance of the document
     NSURL *url = self.placesDocument.fileURL;
     UIManagedDocument *document = self.placesDocument;
+    // the span runs until the context is set up, indexes and sync log and
+    //   all, since every open waits on that too
+    RTCTraceSpan span = [[RTCTraceManager sharedManager] beginSpan:"document.open"];
     
     // must first open/create the document to use it so check to see if it
     // exists
     if (![[NSFileManager defaultManager] fileExistsAtPath:[url path]]) {
         // if document doesn't exist create it
         [document saveToURL:url forSaveOperation:UIDocumentSaveForCreating completionHandler:^(BOOL success) {
+            if (success) self.managedObjectContext = document.managedObjectContext;
+            [[RTCTraceManager sharedManager] endSpan:span];
             if (success) {
-                self.managedObjectContext = document.managedObjectContext;
                 // just created this document so this would be a good time to call
                 // methods to populate the data. However there is no need for
                 // that in this case.
@@ -204,8 +395,9 @@ static NSString *const kPlacesDocumentPath = @"PlacesDocument";
     } else if (document.documentState == UIDocumentStateClosed) {
         // if document exists but is closed, open it
         [document openWithCompletionHandler:^(BOOL success) {
+            if (success) self.managedObjectContext = document.managedObjectContext;
+            [[RTCTraceManager sharedManager] endSpan:span];
             if (success) {
-                self.managedObjectContext = document.managedObjectContext;
                 // if already open, no need to attempt populating the data.
                 if (documentIsReady) documentIsReady();
             }
@@ -214,10 +406,24 @@ static NSString *const kPlacesDocumentPath = @"PlacesDocument";
     } else {
         // if document is already open try to use it
         self.managedObjectContext = document.managedObjectContext;
+        [[RTCTraceManager sharedManager] endSpan:span];
         // again already open, so no need to attempt populating the data.
         if (documentIsReady) documentIsReady();
     }
 }
 
 
+#pragma mark - Notification Observer Methods
+/**
+ * The document saved to its store, on its own or when asked to: sync places
+ * with the user's other devices. Posted on the saving context's queue.
+ */
+- (void)placesDocumentDidSave:(NSNotification *)notification
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self.placeSyncLog saveLog];
+        [self.placeSyncLog syncWithCompletion:nil];
+    });
+}
+
 @end
@@ -11,10 +11,22 @@
  *
  *  Property            Purpose
  *  creationDate        Date/Time when place was saved
- *  location            CLLocation associated with place (contains long./lat.)
- *  placemark           Reverse-geocoded CLPlacemark based on location
+ *  latitude            Latitude of place's location (degrees)
+ *  longitude           Longitude of place's location (degrees)
+ *  horizontalAccuracy  Accuracy of place's location (meters)
+ *  locationTimestamp   Date/Time when place's location was fixed
+ *  placemarkRecord     RTCPlacemark holding the reverse-geocoded CLPlacemark
+ *  legacyLocation      (Migration only) archived CLLocation from model v1
+ *  legacyPlacemark     (Migration only) archived CLPlacemark from model v1
  *  name                Friendly name for this place.
- *  timeout (Unused)    Number of seconds till a return to this place is required
+ *  syncID              UUID string naming this place on every device it syncs
+ *                      to (see RTCPlaceSyncLog.h)
+ *  timeout             Number of seconds till a return to this place is required,
+ *                      0 for never (see RTCGeofenceManager.h)
+ *  trailName           Name of the file holding the breadcrumb trail recorded
+ *                      from this place (see RTCPlace+Trail.h)
+ *
+ *  The location and placemark properties wrap the columns above.
  */
 
 #import "RTCPlace.h"
@@ -55,6 +67,17 @@
  */
 + (NSString *)timeLabelForPlaceDate:(NSTimeInterval)placeTime;
 
+/**
+ * Can places at the same spot with these names be merged without asking the
+ * user? Only if either has no name or they're the same but for case and
+ * surrounding spaces: two names may well be two places, e.g. shops in one
+ * building.
+ *
+ * @param name          one place's friendly name
+ * @param otherName     the other's
+ */
++ (BOOL)isName:(NSString *)name mergeableWithName:(NSString *)otherName;
+
 /**
  * Create place with provided attributes.
  *
@@ -78,4 +101,27 @@
  */
 - (NSString *)timeSinceCreation;
 
+/**
+ * Save this place again from a new fix of the same spot: it reads as just
+ * saved, takes name if there is one, and takes location and placemark if the
+ * fix is at least as accurate as the one it has. Check the names are
+ * mergeable (+isName:mergeableWithName:) or ask the user first.
+ *
+ * @param name          place's friendly name
+ * @param location      new fix of the place
+ * @param placemark     location's reverse-geocoded placemark
+ */
+- (void)resaveWithName:(NSString *)name
+              location:(CLLocation *)location
+             placemark:(CLPlacemark *)placemark;
+
+/**
+ * Fold a place saved at the same spot into this one, then delete it. This
+ * place keeps its own name, location, placemark and timeout, filling in any
+ * it lacks from duplicate, and takes duplicate's location if that's more
+ * accurate. Only for places whose names are mergeable
+ * (+isName:mergeableWithName:).
+ */
+- (void)mergeDuplicatePlace:(RTCPlace *)duplicate;
+
 @end
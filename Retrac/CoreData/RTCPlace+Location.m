@@ -7,16 +7,11 @@
 //
 
 #import "RTCPlace+Location.h"
+#import "RTCLabelFormatter.h"
 
 // pull this in so we can use ABCreateStringWithAddressDictionary()
 //#import <AddressBookUI/AddressBookUI.h>
 
-#pragma mark - Constants
-// seconds in minute, hour, day per the Gregorian Calendar.
-static const NSInteger kSecondsInMinute    = 60;
-static const NSInteger kSecondsInHour      = 3600;
-static const NSInteger kSecondsInDay       = 86400;
-
 @implementation RTCPlace (Location)
 
 #pragma mark - Class Methods
@@ -97,17 +92,17 @@ static const NSInteger kSecondsInDay       = 86400;
 
 + (NSString *)timeLabelForPlaceDate:(NSTimeInterval)placeTime
 {
-    NSString *timeLabel = nil;
-    
-    if (placeTime >= kSecondsInDay) {
-        timeLabel = [NSString stringWithFormat:@"%dd",(int)(placeTime/kSecondsInDay)];
-    } else if (placeTime >= kSecondsInHour) {
-        timeLabel = [NSString stringWithFormat:@"%dh",(int)(placeTime/kSecondsInHour)];
-    } else if (placeTime >= 0) {
-        timeLabel = [NSString stringWithFormat:@"%dm",(int)(placeTime/kSecondsInMinute)];
-    }
-    
-    return timeLabel;
+    // shared label strings, so list cells don't format one per row
+    return [RTCLabelFormatter labelForAge:placeTime];
+}
+
++ (BOOL)isName:(NSString *)name mergeableWithName:(NSString *)otherName
+{
+    NSCharacterSet *whitespace = [NSCharacterSet whitespaceAndNewlineCharacterSet];
+    NSString *trimmedName = [name stringByTrimmingCharactersInSet:whitespace];
+    NSString *trimmedOtherName = [otherName stringByTrimmingCharactersInSet:whitespace];
+    if (![trimmedName length] || ![trimmedOtherName length]) return YES;
+    return [trimmedName caseInsensitiveCompare:trimmedOtherName] == NSOrderedSame;
 }
 
 + (instancetype)placeWithName:(NSString *)name
@@ -133,4 +128,48 @@ static const NSInteger kSecondsInDay       = 86400;
     return [RTCPlace timeLabelForPlaceDate:intervalSinceCreation];
 }
 
+- (void)resaveWithName:(NSString *)name
+              location:(CLLocation *)location
+             placemark:(CLPlacemark *)placemark
+{
+    self.creationDate = [NSDate date];
+    if ([name length]) self.name = name;
+    if (location && ![self isMoreAccurateThanLocation:location]) {
+        self.location = location;
+        if (placemark) self.placemark = placemark;
+    } else if (placemark && !self.placemarkRecord) {
+        self.placemark = placemark;
+    }
+}
+
+- (void)mergeDuplicatePlace:(RTCPlace *)duplicate
+{
+    if (![self.name length] && [duplicate.name length]) self.name = duplicate.name;
+    if (![self.timeout intValue] && [duplicate.timeout intValue]) self.timeout = duplicate.timeout;
+
+    if ([duplicate isMoreAccurateThanLocation:self.location]) {
+        self.location = duplicate.location;
+        if (duplicate.placemarkRecord) self.placemark = duplicate.placemark;
+    } else if (!self.placemarkRecord && duplicate.placemarkRecord) {
+        self.placemark = duplicate.placemark;
+    }
+
+    [self.managedObjectContext deleteObject:duplicate];
+}
+
+
+#pragma mark Private
+/**
+ * Is this place's location known more accurately than location? Unknown
+ * accuracies lose.
+ */
+- (BOOL)isMoreAccurateThanLocation:(CLLocation *)location
+{
+    if (!self.latitude || !self.longitude || !self.horizontalAccuracy) return NO;
+
+    double accuracy = [self.horizontalAccuracy doubleValue];
+    if (accuracy < 0) return NO;
+    return !location || (location.horizontalAccuracy < 0) || (accuracy < location.horizontalAccuracy);
+}
+
 @end
@@ -12,7 +12,8 @@
 
 - (CLLocationCoordinate2D)coordinate
 {
-    return self.location.coordinate;
+    // straight from the columns; no need to build a CLLocation per pin
+    return CLLocationCoordinate2DMake([self.latitude doubleValue], [self.longitude doubleValue]);
 }
 
 - (NSString *)title
@@ -0,0 +1,49 @@
+//
+//  RTCPlace+Trail.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/13/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCPlace.h"
+#import <MapKit/MapKit.h>
+
+/**
+ * The Trail category covers the breadcrumb trail recorded from a place.
+ *
+ * Trails are kept out of the store in append-only files (see rtc::TrailSimplifier
+ * and the trail file functions in RTCTrail.h), one per place, so a recording
+ * can add points as it goes without saving the document.
+ */
+@interface RTCPlace (Trail)
+
+#pragma mark - Class Methods
+/**
+ * Directory holding every place's trail file. Created if it doesn't exist.
+ */
++ (NSURL *)trailsDirectoryURL;
+
+
+#pragma mark - Instance Methods
+/**
+ * File holding this place's trail, or nil if nothing was ever recorded.
+ */
+- (NSURL *)trailURL;
+
+/**
+ * File to record this place's trail into. Names one if the place has none yet.
+ */
+- (NSURL *)trailURLForRecording;
+
+/**
+ * Recorded trail as CLLocations, oldest first. Empty if there is no trail.
+ */
+- (NSArray *)trailLocations;
+
+/**
+ * Recorded trail as a map overlay, or nil if there are fewer than 2 points.
+ */
+- (MKPolyline *)trailPolyline;
+
+@end
@@ -0,0 +1,97 @@
+//
+//  RTCPlace+Trail.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/13/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCPlace+Trail.h"
+#include <fstream>
+#include <vector>
+#include "RTCTrail.h"
+
+#pragma mark - Constants
+// Relative address of the trails directory, kept next to the places document
+static NSString *const kTrailsDirectoryPath = @"Trails";
+static NSString *const kTrailFileExtension  = @"trail";
+
+@implementation RTCPlace (Trail)
+
+#pragma mark - Class Methods
+#pragma mark Public
++ (NSURL *)trailsDirectoryURL
+{
+    NSURL *docURL = [[[NSFileManager defaultManager] URLsForDirectory:NSDocumentDirectory inDomains:NSUserDomainMask] lastObject];
+    NSURL *trailsURL = [docURL URLByAppendingPathComponent:kTrailsDirectoryPath isDirectory:YES];
+    [[NSFileManager defaultManager] createDirectoryAtURL:trailsURL
+                             withIntermediateDirectories:YES
+                                              attributes:nil
+                                                   error:NULL];
+    return trailsURL;
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Public
+- (NSURL *)trailURL
+{
+    if (!self.trailName) return nil;
+    return [[[RTCPlace trailsDirectoryURL] URLByAppendingPathComponent:self.trailName]
+            URLByAppendingPathExtension:kTrailFileExtension];
+}
+
+- (NSURL *)trailURLForRecording
+{
+    if (!self.trailName) self.trailName = [[NSUUID UUID] UUIDString];
+    return [self trailURL];
+}
+
+- (NSArray *)trailLocations
+{
+    std::vector<rtc::TrailPoint> trail;
+    [self readTrail:trail];
+
+    NSMutableArray *locations = [[NSMutableArray alloc] initWithCapacity:trail.size()];
+    for (size_t i = 0; i < trail.size(); ++i) {
+        const rtc::TrailPoint &point = trail[i];
+        CLLocationCoordinate2D coordinate = CLLocationCoordinate2DMake(point.coordinate.latitude,
+                                                                       point.coordinate.longitude);
+        [locations addObject:[[CLLocation alloc] initWithCoordinate:coordinate
+                                                           altitude:0
+                                                 horizontalAccuracy:point.horizontalAccuracy
+                                                   verticalAccuracy:-1
+                                                          timestamp:[NSDate dateWithTimeIntervalSince1970:point.timestamp]]];
+    }
+    return locations;
+}
+
+- (MKPolyline *)trailPolyline
+{
+    std::vector<rtc::TrailPoint> trail;
+    [self readTrail:trail];
+    if (trail.size() < 2) return nil;
+
+    std::vector<CLLocationCoordinate2D> coordinates(trail.size());
+    for (size_t i = 0; i < trail.size(); ++i) {
+        coordinates[i] = CLLocationCoordinate2DMake(trail[i].coordinate.latitude, trail[i].coordinate.longitude);
+    }
+    return [MKPolyline polylineWithCoordinates:&coordinates[0] count:coordinates.size()];
+}
+
+
+#pragma mark Private
+/**
+ * Load the trail file, leaving trail empty if there is none or it's unreadable
+ */
+- (void)readTrail:(std::vector<rtc::TrailPoint> &)trail
+{
+    trail.clear();
+    NSURL *url = [self trailURL];
+    if (!url) return;
+
+    std::ifstream input([[url path] fileSystemRepresentation], std::ios::binary);
+    if (!input || !rtc::readTrail(input, trail)) trail.clear();
+}
+
+@end
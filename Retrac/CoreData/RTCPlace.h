@@ -10,13 +10,55 @@
 #import <CoreData/CoreData.h>
 #import <CoreLocation/CoreLocation.h>
 
+@class RTCPlacemark;
 
 @interface RTCPlace : NSManagedObject
 
 @property (nonatomic, retain) NSDate * creationDate;
-@property (nonatomic, retain) CLLocation * location;
-@property (nonatomic, retain) CLPlacemark * placemark;
+@property (nonatomic, retain) NSNumber * latitude;
+@property (nonatomic, retain) NSNumber * longitude;
+@property (nonatomic, retain) NSNumber * horizontalAccuracy;
+@property (nonatomic, retain) NSDate * locationTimestamp;
+@property (nonatomic, retain) CLLocation * legacyLocation;
+@property (nonatomic, retain) CLPlacemark * legacyPlacemark;
 @property (nonatomic, retain) NSString * name;
+@property (nonatomic, retain) NSString * syncID;
 @property (nonatomic, retain) NSNumber * timeout;
+@property (nonatomic, retain) NSString * trailName;
+@property (nonatomic, retain) RTCPlacemark *placemarkRecord;
+
+/**
+ * CLLocation built from the scalar location columns. Setting it fills in those
+ * columns; setting nil clears them.
+ */
+@property (nonatomic, retain) CLLocation * location;
+
+/**
+ * Reverse-geocoded placemark. It lives in a separate RTCPlacemark row so it is
+ * only unarchived when this is read, not whenever the place is fetched.
+ */
+@property (nonatomic, retain) CLPlacemark * placemark;
+
+/**
+ * Move places saved by the first model version, which kept location and
+ * placemark as archived blobs, into the scalar columns and placemark rows.
+ * Run this once after opening a store.
+ *
+ * @param context   handle to database
+ *
+ * @return number of places migrated
+ */
++ (NSUInteger)migrateLegacyPlacesInManagedObjectContext:(NSManagedObjectContext *)context;
+
+/**
+ * Give places saved before model v4, which had no syncID, one each. Places
+ * inserted since get theirs when they're inserted. Run this once after
+ * opening a store.
+ *
+ * @param context   handle to database
+ *
+ * @return number of places given a syncID
+ */
++ (NSUInteger)assignSyncIDsInManagedObjectContext:(NSManagedObjectContext *)context;
 
 @end
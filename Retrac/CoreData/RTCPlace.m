@@ -7,14 +7,146 @@
 //
 
 #import "RTCPlace.h"
+#import "RTCPlacemark.h"
+#import "RTCPlace+Trail.h"
+
+// places migrated per fetch batch, so a large store isn't unarchived at once
+static const NSUInteger kLegacyMigrationBatchSize = 100;
+
+
+@interface RTCPlace ()
+
+// trail file of a deleted place, removed once the deletion is saved
+@property (strong, nonatomic) NSURL *deletedTrailURL;
+
+@end
 
 
 @implementation RTCPlace
 
 @dynamic creationDate;
-@dynamic location;
-@dynamic placemark;
+@dynamic latitude;
+@dynamic longitude;
+@dynamic horizontalAccuracy;
+@dynamic locationTimestamp;
+@dynamic legacyLocation;
+@dynamic legacyPlacemark;
 @dynamic name;
+@dynamic syncID;
 @dynamic timeout;
+@dynamic trailName;
+@dynamic placemarkRecord;
+@synthesize deletedTrailURL = _deletedTrailURL;
+
+#pragma mark - Properties
+- (CLLocation *)location
+{
+    if (!self.latitude || !self.longitude) return nil;
+
+    CLLocationCoordinate2D coordinate = CLLocationCoordinate2DMake([self.latitude doubleValue],
+                                                                   [self.longitude doubleValue]);
+    return [[CLLocation alloc] initWithCoordinate:coordinate
+                                         altitude:0
+                               horizontalAccuracy:[self.horizontalAccuracy doubleValue]
+                                 verticalAccuracy:-1
+                                        timestamp:(self.locationTimestamp ?: [NSDate date])];
+}
+
+- (void)setLocation:(CLLocation *)location
+{
+    if (location) {
+        self.latitude = @(location.coordinate.latitude);
+        self.longitude = @(location.coordinate.longitude);
+        self.horizontalAccuracy = @(location.horizontalAccuracy);
+        self.locationTimestamp = location.timestamp;
+    } else {
+        self.latitude = nil;
+        self.longitude = nil;
+        self.horizontalAccuracy = nil;
+        self.locationTimestamp = nil;
+    }
+}
+
+- (CLPlacemark *)placemark
+{
+    return self.placemarkRecord.placemark;
+}
+
+- (void)setPlacemark:(CLPlacemark *)placemark
+{
+    if (placemark) {
+        if (!self.placemarkRecord) {
+            self.placemarkRecord = [NSEntityDescription insertNewObjectForEntityForName:@"RTCPlacemark"
+                                                                 inManagedObjectContext:self.managedObjectContext];
+        }
+        self.placemarkRecord.placemark = placemark;
+
+    } else if (self.placemarkRecord) {
+        [self.managedObjectContext deleteObject:self.placemarkRecord];
+        self.placemarkRecord = nil;
+    }
+}
+
+
+#pragma mark - Lifecycle
+- (void)awakeFromInsert
+{
+    [super awakeFromInsert];
+
+    // the place's ID on every device it syncs to (see RTCPlaceSyncLog.h)
+    self.syncID = [[NSUUID UUID] UUIDString];
+}
+
+- (void)willSave
+{
+    [super willSave];
+    if ([self isDeleted]) self.deletedTrailURL = [self trailURL];
+}
+
+- (void)didSave
+{
+    [super didSave];
+
+    // the trail file isn't in the store, so it goes once the deletion sticks
+    if (self.deletedTrailURL) {
+        [[NSFileManager defaultManager] removeItemAtURL:self.deletedTrailURL error:NULL];
+        self.deletedTrailURL = nil;
+    }
+}
+
+
+#pragma mark - Class Methods
++ (NSUInteger)migrateLegacyPlacesInManagedObjectContext:(NSManagedObjectContext *)context
+{
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    request.predicate = [NSPredicate predicateWithFormat:@"legacyLocation != nil OR legacyPlacemark != nil"];
+    request.fetchBatchSize = kLegacyMigrationBatchSize;
+    NSArray *places = [context executeFetchRequest:request error:NULL];
+
+    NSUInteger numMigrated = 0;
+    for (RTCPlace *place in places) {
+        @autoreleasepool {
+            if (place.legacyLocation) place.location = place.legacyLocation;
+            if (place.legacyPlacemark) place.placemark = place.legacyPlacemark;
+            place.legacyLocation = nil;
+            place.legacyPlacemark = nil;
+            numMigrated++;
+        }
+    }
+    return numMigrated;
+}
+
++ (NSUInteger)assignSyncIDsInManagedObjectContext:(NSManagedObjectContext *)context
+{
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    request.predicate = [NSPredicate predicateWithFormat:@"syncID == nil"];
+    request.fetchBatchSize = kLegacyMigrationBatchSize;
+    NSArray *places = [context executeFetchRequest:request error:NULL];
+
+    for (RTCPlace *place in places) {
+        place.syncID = [[NSUUID UUID] UUIDString];
+    }
+    return [places count];
+}
 
 @end
@@ -0,0 +1,76 @@
+//
+//  RTCPlaceArchiver.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/21/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreData/CoreData.h>
+
+/**
+ * Place archive formats, see rtc::PlaceFormat
+ */
+typedef NS_ENUM(NSInteger, RTCPlaceArchiveFormat) {
+    RTCPlaceArchiveFormatGeoJSON,   // newline-delimited GeoJSON, one place a line
+    RTCPlaceArchiveFormatBinary     // compact, length-prefixed, delta-encoded
+};
+
+/**
+ * RTCPlaceArchiver exports places to a file and imports them from one in bulk.
+ *
+ * Both directions stream through the engine's rtc::PlaceArchiveWriter and
+ * rtc::PlaceArchiveReader on a private queue context of their own, straight on
+ * the persistent store coordinator, so neither the main queue nor the
+ * document's contexts see the rows go by. Imports are inserted and saved
+ * kRTCPlaceArchiveBatchSize at a time, and the context is reset after each
+ * save, so memory stays flat however long the file is. Exports fault places in
+ * kRTCPlaceArchiveBatchSize at a time and turn them back into faults once
+ * written; only their object IDs are held for the whole export.
+ *
+ * Imported places aren't merged into any other context. Refetch (and rebuild
+ * the place index) once the import completes; RTCModelManager does this.
+ */
+@interface RTCPlaceArchiver : NSObject
+
+#pragma mark - Properties
+/**
+ * Coordinator of the store places are exported from and imported to
+ */
+@property (strong, nonatomic, readonly) NSPersistentStoreCoordinator *persistentStoreCoordinator;
+
+/**
+ * Peak resident memory (in bytes) of the process during the last import or
+ * export, for tuning kRTCPlaceArchiveBatchSize
+ */
+@property (nonatomic, readonly) unsigned long long peakResidentSize;
+
+
+#pragma mark - Initialization
+- (instancetype)initWithPersistentStoreCoordinator:(NSPersistentStoreCoordinator *)coordinator;
+
+
+#pragma mark - Instance Methods
+/**
+ * Write every place with a location to fileURL, oldest first.
+ *
+ * @param completion    called on the main queue with the number of places
+ *                      written
+ */
+- (void)exportPlacesToURL:(NSURL *)fileURL
+                   format:(RTCPlaceArchiveFormat)format
+               completion:(void (^)(BOOL success, NSUInteger numPlaces))completion;
+
+/**
+ * Insert the places in the archive at fileURL, whichever format it's in.
+ * GeoJSON lines that aren't places are skipped. Batches saved before an error
+ * stay imported.
+ *
+ * @param completion    called on the main queue with the number of places
+ *                      inserted
+ */
+- (void)importPlacesFromURL:(NSURL *)fileURL
+                 completion:(void (^)(BOOL success, NSUInteger numPlaces))completion;
+
+@end
@@ -0,0 +1,200 @@
+//
+//  RTCPlaceArchiver.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/21/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCPlaceArchiver.h"
+#import <mach/mach.h>
+#import "RTCPlace.h"
+#import "RTCPlace+Location.h"
+#include <cmath>
+#include <fstream>
+#include "RTCPlaceArchive.h"
+
+
+#pragma mark - Helpers
+// current resident memory of the process, in bytes
+static unsigned long long residentSize(void)
+{
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) return 0;
+    return info.resident_size;
+}
+
+static NSDate *dateFromArchive(double date)
+{
+    return std::isnan(date) ? nil : [NSDate dateWithTimeIntervalSince1970:date];
+}
+
+static double archiveDateFromDate(NSDate *date)
+{
+    return date ? [date timeIntervalSince1970] : rtc::kUnknownPlaceDate;
+}
+
+
+@interface RTCPlaceArchiver ()
+
+// want all properties to be readwrite internally
+@property (strong, nonatomic, readwrite) NSPersistentStoreCoordinator *persistentStoreCoordinator;
+@property (nonatomic, readwrite) unsigned long long peakResidentSize;
+
+@end
+
+
+@implementation RTCPlaceArchiver
+
+#pragma mark - Initialization
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"RTCPlaceArchiver"
+                                   reason:@"Use - [RTCPlaceArchiver initWithPersistentStoreCoordinator:]"
+                                 userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithPersistentStoreCoordinator:(NSPersistentStoreCoordinator *)coordinator
+{
+    self = [super init];
+    if (self) {
+        _persistentStoreCoordinator = coordinator;
+    }
+    return self;
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Public
+- (void)exportPlacesToURL:(NSURL *)fileURL
+                   format:(RTCPlaceArchiveFormat)format
+               completion:(void (^)(BOOL success, NSUInteger numPlaces))completion
+{
+    NSManagedObjectContext *context = [self archiveContext];
+    [context performBlock:^{
+        unsigned long long peakResidentSize = residentSize();
+        std::ofstream output([fileURL fileSystemRepresentation], std::ios::binary | std::ios::trunc);
+        rtc::PlaceArchiveWriter writer(output, (format == RTCPlaceArchiveFormatBinary) ? rtc::kPlaceFormatBinary : rtc::kPlaceFormatGeoJSON);
+
+        // oldest first keeps binary date deltas small
+        NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+        request.predicate = [NSPredicate predicateWithFormat:@"latitude != nil AND longitude != nil"];
+        request.sortDescriptors = @[[NSSortDescriptor sortDescriptorWithKey:@"creationDate" ascending:YES]];
+        request.fetchBatchSize = kRTCPlaceArchiveBatchSize;
+        NSError *error = nil;
+        NSArray *places = [context executeFetchRequest:request error:&error];
+
+        rtc::PlaceRecord record;
+        for (NSUInteger first = 0; first < [places count]; first += kRTCPlaceArchiveBatchSize) {
+            @autoreleasepool {
+                NSUInteger last = MIN(first + kRTCPlaceArchiveBatchSize, [places count]);
+                for (NSUInteger i = first; i < last; ++i) {
+                    RTCPlace *place = places[i];
+                    record.name = place.name ? [place.name UTF8String] : "";
+                    record.coordinate = rtc::GeoPoint([place.latitude doubleValue], [place.longitude doubleValue]);
+                    record.horizontalAccuracy = place.horizontalAccuracy ? [place.horizontalAccuracy doubleValue] : -1.0;
+                    record.creationDate = archiveDateFromDate(place.creationDate);
+                    record.locationTimestamp = archiveDateFromDate(place.locationTimestamp);
+                    writer.write(record);
+
+                    // done with its row data
+                    [context refreshObject:place mergeChanges:NO];
+                }
+            }
+            peakResidentSize = MAX(peakResidentSize, residentSize());
+        }
+
+        output.flush();
+        BOOL success = places && writer.good();
+        if (!success) {
+            NSLog(@"[%@ %@] %@ (%@)", NSStringFromClass([self class]), NSStringFromSelector(_cmd),
+                  error ? [error localizedDescription] : @"Couldn't write archive", [fileURL path]);
+        }
+
+        NSUInteger numPlaces = writer.numWritten();
+        dispatch_async(dispatch_get_main_queue(), ^{
+            self.peakResidentSize = peakResidentSize;
+            if (completion) completion(success, numPlaces);
+        });
+    }];
+}
+
+- (void)importPlacesFromURL:(NSURL *)fileURL
+                 completion:(void (^)(BOOL success, NSUInteger numPlaces))completion
+{
+    NSManagedObjectContext *context = [self archiveContext];
+    [context performBlock:^{
+        unsigned long long peakResidentSize = residentSize();
+        std::ifstream input([fileURL fileSystemRepresentation], std::ios::binary);
+        rtc::PlaceArchiveReader reader(input);
+
+        NSError *error = nil;
+        NSUInteger numPlaces = 0;
+        BOOL success = input.is_open();
+        rtc::PlaceRecord record;
+        while (success) {
+            NSUInteger numInBatch = 0;
+            @autoreleasepool {
+                for (; (numInBatch < kRTCPlaceArchiveBatchSize) && reader.read(&record); ++numInBatch) {
+                    [self insertPlaceFromRecord:record inManagedObjectContext:context];
+                }
+                if (numInBatch) {
+                    success = [context save:&error];
+                    // forget the saved places so the next batch starts empty
+                    [context reset];
+                }
+            }
+            peakResidentSize = MAX(peakResidentSize, residentSize());
+            if (!numInBatch) break;
+            if (success) numPlaces += numInBatch;
+        }
+        success = success && !reader.failed();
+
+        if (!success) {
+            NSLog(@"[%@ %@] %@ (%@)", NSStringFromClass([self class]), NSStringFromSelector(_cmd),
+                  error ? [error localizedDescription] : @"Couldn't read archive", [fileURL path]);
+        }
+        if (reader.numSkipped()) {
+            NSLog(@"[%@ %@] skipped %lu lines that aren't places (%@)", NSStringFromClass([self class]),
+                  NSStringFromSelector(_cmd), (unsigned long)reader.numSkipped(), [fileURL path]);
+        }
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            self.peakResidentSize = peakResidentSize;
+            if (completion) completion(success, numPlaces);
+        });
+    }];
+}
+
+
+#pragma mark Private
+/**
+ * A private queue context straight on the store, with no undo manager to
+ * remember every insert
+ */
+- (NSManagedObjectContext *)archiveContext
+{
+    NSManagedObjectContext *context = [[NSManagedObjectContext alloc] initWithConcurrencyType:NSPrivateQueueConcurrencyType];
+    context.persistentStoreCoordinator = self.persistentStoreCoordinator;
+    context.undoManager = nil;
+    return context;
+}
+
+- (RTCPlace *)insertPlaceFromRecord:(const rtc::PlaceRecord &)record
+             inManagedObjectContext:(NSManagedObjectContext *)context
+{
+    RTCPlace *place = [NSEntityDescription insertNewObjectForEntityForName:@"RTCPlace" inManagedObjectContext:context];
+
+    NSString *name = [[NSString alloc] initWithBytes:record.name.data() length:record.name.size() encoding:NSUTF8StringEncoding];
+    place.name = [name length] ? [RTCPlace truncatedName:name] : nil;
+    place.latitude = @(record.coordinate.latitude);
+    place.longitude = @(record.coordinate.longitude);
+    place.horizontalAccuracy = (record.horizontalAccuracy >= 0) ? @(record.horizontalAccuracy) : nil;
+    place.locationTimestamp = dateFromArchive(record.locationTimestamp);
+    place.creationDate = dateFromArchive(record.creationDate) ?: (place.locationTimestamp ?: [NSDate date]);
+    return place;
+}
+
+@end
@@ -0,0 +1,49 @@
+//
+//  RTCPlaceCluster.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/20/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <MapKit/MapKit.h>
+
+/**
+ * RTCPlaceCluster is the map annotation standing in for several saved places
+ * too close together to show apart at the current zoom level.
+ *
+ * Clusters are equal if they are the same cluster of places, so a map can keep
+ * the annotations it already shows when the viewport moves.
+ */
+@interface RTCPlaceCluster : NSObject <MKAnnotation>
+
+#pragma mark - Properties
+/**
+ * The places' centroid
+ */
+@property (nonatomic, readonly) CLLocationCoordinate2D coordinate;
+
+/**
+ * Smallest region containing all the places. Zoom to it to split the cluster.
+ */
+@property (nonatomic, readonly) MKCoordinateRegion region;
+
+/**
+ * Number of places
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ * Identifies the cluster within its place index
+ */
+@property (nonatomic, readonly) uint64_t clusterID;
+
+
+#pragma mark - Initialization
+- (instancetype)initWithClusterID:(uint64_t)clusterID
+                            count:(NSUInteger)count
+                       coordinate:(CLLocationCoordinate2D)coordinate
+                           region:(MKCoordinateRegion)region;
+
+@end
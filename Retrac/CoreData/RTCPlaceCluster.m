@@ -0,0 +1,63 @@
+//
+//  RTCPlaceCluster.m
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/20/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCPlaceCluster.h"
+
+@implementation RTCPlaceCluster
+
+#pragma mark - Properties
+- (NSString *)title
+{
+    return [NSString stringWithFormat:@"%lu places", (unsigned long)self.count];
+}
+
+
+#pragma mark - Initialization
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"RTCPlaceCluster"
+                                   reason:@"Use - [RTCPlaceCluster initWithClusterID:count:coordinate:region:]"
+                                 userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithClusterID:(uint64_t)clusterID
+                            count:(NSUInteger)count
+                       coordinate:(CLLocationCoordinate2D)coordinate
+                           region:(MKCoordinateRegion)region
+{
+    self = [super init];
+    if (self) {
+        _clusterID = clusterID;
+        _count = count;
+        _coordinate = coordinate;
+        _region = region;
+    }
+    return self;
+}
+
+
+#pragma mark - Equality
+- (BOOL)isEqual:(id)object
+{
+    if (object == self) return YES;
+    if (![object isKindOfClass:[RTCPlaceCluster class]]) return NO;
+
+    RTCPlaceCluster *other = object;
+    // IDs are reused when the index is rebuilt, so check it's the same places
+    return (other.clusterID == self.clusterID) && (other.count == self.count) &&
+           (other.coordinate.latitude == self.coordinate.latitude) &&
+           (other.coordinate.longitude == self.coordinate.longitude);
+}
+
+- (NSUInteger)hash
+{
+    return (NSUInteger)(self.clusterID ^ (self.clusterID >> 32));
+}
+
+@end
@@ -0,0 +1,90 @@
+//
+//  RTCPlaceDeduplicator.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 9/1/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreData/CoreData.h>
+#import <CoreLocation/CoreLocation.h>
+#import "RTCBackgroundWriter.h"
+
+/**
+ * RTCPlaceDeduplicator stops the same spot being saved over and over.
+ *
+ * It wraps the engine's duplicate index (see rtc::DuplicateIndex), a grid of
+ * the places in the managed object context it was created for, kept in sync as
+ * places are added, moved and deleted. Saving checks a new fix against it and
+ * saves the place it duplicates again rather than adding another, asking the
+ * user first if the two are named differently: a lookup touches a few grid
+ * cells however many places there are.
+ *
+ * Places that got in anyway (imported, synced, or saved before this) are
+ * merged by compaction, a pass over the whole store run through the
+ * background writer so every index and the sync log see the merges. Only
+ * places whose names are mergeable are ever merged (see
+ * +[RTCPlace isName:mergeableWithName:]); the rest are kept as they are.
+ */
+@interface RTCPlaceDeduplicator : NSObject
+
+#pragma mark - Properties
+/**
+ * Number of indexed places
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ * Is a compaction under way?
+ */
+@property (nonatomic, readonly, getter=isCompacting) BOOL compacting;
+
+
+#pragma mark - Initialization
+/**
+ * Build the index from context's places.
+ *
+ * @param context   context whose RTCPlace objects are indexed. Changes made in
+ *      this context are picked up as they happen.
+ * @param writer    background writer for context, which compaction merges
+ *      places through
+ */
+- (instancetype)initWithManagedObjectContext:(NSManagedObjectContext *)context
+                                      writer:(RTCBackgroundWriter *)writer;
+
+
+#pragma mark - Instance Methods
+/**
+ * The saved place a fix at location is the same spot as: the nearest within
+ * the larger of the two horizontal accuracies, kept between
+ * kRTCDuplicateMinRadius and kRTCDuplicateMaxRadius.
+ *
+ * @return NSManagedObjectID of an RTCPlace, or nil if there is none.
+ */
+- (NSManagedObjectID *)objectIDOfPlaceDuplicatingLocation:(CLLocation *)location;
+
+/**
+ * Rebuild the index from the store with a single fetch of every place's
+ * object ID and location columns. Only needed after places were added to the
+ * store past this index's context, e.g. by a bulk import.
+ */
+- (void)rebuildIndex;
+
+/**
+ * Merge every group of duplicate places in the store into its newest place,
+ * in the background, leaving out places named differently from it. Does
+ * nothing if a compaction is already under way.
+ *
+ * @param completion
+ *      block called on the main queue, once the merges are in the context,
+ *      with the number of places merged away
+ */
+- (void)compactPlacesWithCompletion:(void (^)(NSUInteger numMerged))completion;
+
+/**
+ * Compact the store if it hasn't been for kRTCPlaceCompactionInterval.
+ */
+- (void)compactPlacesIfDue;
+
+@end
@@ -0,0 +1,311 @@
+//
+//  RTCPlaceDeduplicator.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 9/1/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCPlaceDeduplicator.h"
+#import "RTCPlace.h"
+#import "RTCPlace+Location.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "RTCDuplicateIndex.h"
+
+#pragma mark - Constants
+// user defaults key of when the store was last compacted
+static NSString *const kLastCompactionDateKey = @"RTCLastPlaceCompactionDate";
+
+// changes to these mean a place may have moved
+static NSString *const kPlaceLatitudeKey            = @"latitude";
+static NSString *const kPlaceLongitudeKey           = @"longitude";
+static NSString *const kPlaceHorizontalAccuracyKey  = @"horizontalAccuracy";
+
+
+@interface RTCPlaceDeduplicator () {
+    rtc::DuplicateIndex _index;
+    rtc::DuplicateIndex::PlaceID _nextPlaceID;
+}
+
+@property (weak, nonatomic) NSManagedObjectContext *managedObjectContext;
+@property (weak, nonatomic) RTCBackgroundWriter *writer;
+
+@property (nonatomic, readwrite, getter=isCompacting) BOOL compacting;
+
+// the engine knows places by integer ID; these map them to Core Data objects
+@property (strong, nonatomic) NSMutableDictionary *objectIDsByPlaceID;  // NSNumber -> NSManagedObjectID
+@property (strong, nonatomic) NSMutableDictionary *placeIDsByObjectID;  // NSManagedObjectID -> NSNumber
+
+@end
+
+
+#pragma mark - Helpers
+static rtc::DuplicatePolicy duplicatePolicy()
+{
+    rtc::DuplicatePolicy policy;
+    policy.minRadius = kRTCDuplicateMinRadius;
+    policy.maxRadius = kRTCDuplicateMaxRadius;
+    return policy;
+}
+
+/**
+ * A fetch of every located place's object ID, location columns and, for
+ * compaction, creation date as dictionaries
+ */
+static NSFetchRequest *duplicateRecordsRequest(BOOL includeCreationDate)
+{
+    NSExpressionDescription *objectIDDescription = [[NSExpressionDescription alloc] init];
+    objectIDDescription.name = @"objectID";
+    objectIDDescription.expression = [NSExpression expressionForEvaluatedObject];
+    objectIDDescription.expressionResultType = NSObjectIDAttributeType;
+
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    request.predicate = [NSPredicate predicateWithFormat:@"latitude != nil AND longitude != nil"];
+    request.resultType = NSDictionaryResultType;
+    NSArray *properties = @[objectIDDescription, kPlaceLatitudeKey, kPlaceLongitudeKey, kPlaceHorizontalAccuracyKey];
+    request.propertiesToFetch = includeCreationDate ? [properties arrayByAddingObject:@"creationDate"] : properties;
+    return request;
+}
+
+static rtc::DuplicateIndex::Record duplicateRecordFromRow(rtc::DuplicateIndex::PlaceID placeID, NSDictionary *row)
+{
+    NSNumber *accuracy = row[kPlaceHorizontalAccuracyKey];
+    NSDate *creationDate = row[@"creationDate"];
+    return rtc::DuplicateIndex::Record(placeID,
+                                       rtc::GeoPoint([row[kPlaceLatitudeKey] doubleValue], [row[kPlaceLongitudeKey] doubleValue]),
+                                       accuracy ? [accuracy doubleValue] : -1.0,
+                                       creationDate ? [creationDate timeIntervalSince1970] : NAN);
+}
+
+
+@implementation RTCPlaceDeduplicator
+
+#pragma mark - Properties
+- (NSUInteger)count
+{
+    return _index.size();
+}
+
+
+#pragma mark - Initialization
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"RTCPlaceDeduplicator"
+                                   reason:@"Use - [RTCPlaceDeduplicator initWithManagedObjectContext:writer:]"
+                                 userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithManagedObjectContext:(NSManagedObjectContext *)context
+                                      writer:(RTCBackgroundWriter *)writer
+{
+    self = [super init];
+    if (self) {
+        _index = rtc::DuplicateIndex(duplicatePolicy());
+        _nextPlaceID = 1;
+        _managedObjectContext = context;
+        _writer = writer;
+        _objectIDsByPlaceID = [[NSMutableDictionary alloc] init];
+        _placeIDsByObjectID = [[NSMutableDictionary alloc] init];
+
+        [self rebuildIndex];
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(contextObjectsDidChange:)
+                                                     name:NSManagedObjectContextObjectsDidChangeNotification
+                                                   object:context];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Public
+- (NSManagedObjectID *)objectIDOfPlaceDuplicatingLocation:(CLLocation *)location
+{
+    if (!location) return nil;
+
+    rtc::DuplicateIndex::PlaceID placeID;
+    rtc::GeoPoint coordinate(location.coordinate.latitude, location.coordinate.longitude);
+    if (!_index.findDuplicate(coordinate, location.horizontalAccuracy, &placeID)) return nil;
+    return self.objectIDsByPlaceID[@(placeID)];
+}
+
+- (void)rebuildIndex
+{
+    _index.clear();
+    _nextPlaceID = 1;
+    [self.objectIDsByPlaceID removeAllObjects];
+    [self.placeIDsByObjectID removeAllObjects];
+
+    NSArray *rows = [self.managedObjectContext executeFetchRequest:duplicateRecordsRequest(NO) error:NULL];
+    std::vector<rtc::DuplicateIndex::Record> records;
+    records.reserve([rows count]);
+    for (NSDictionary *row in rows) {
+        records.push_back(duplicateRecordFromRow([self assignPlaceIDToObjectID:row[@"objectID"]], row));
+    }
+    _index.assign(records);
+}
+
+- (void)compactPlacesWithCompletion:(void (^)(NSUInteger numMerged))completion
+{
+    RTCBackgroundWriter *writer = self.writer;
+    NSPersistentStoreCoordinator *coordinator = self.managedObjectContext.persistentStoreCoordinator;
+    if (self.compacting || !writer || !coordinator) {
+        if (completion) completion(0);
+        return;
+    }
+    self.compacting = YES;
+
+    // the store is read on a context of its own so the writer isn't held up
+    //   by the whole pass, only by the merges
+    NSManagedObjectContext *readContext = [[NSManagedObjectContext alloc] initWithConcurrencyType:NSPrivateQueueConcurrencyType];
+    readContext.persistentStoreCoordinator = coordinator;
+    readContext.undoManager = nil;
+
+    rtc::DuplicatePolicy policy = duplicatePolicy();
+    __block NSUInteger numMerged = 0;
+    [readContext performBlock:^{
+        NSArray *rows = [readContext executeFetchRequest:duplicateRecordsRequest(YES) error:NULL];
+        std::vector<rtc::DuplicateIndex::Record> records;
+        records.reserve([rows count]);
+        for (NSUInteger i = 0; i < [rows count]; ++i) records.push_back(duplicateRecordFromRow(i, rows[i]));
+        std::vector<rtc::DuplicateGroup> groups = rtc::findDuplicateGroups(records, policy);
+
+        // each batch is its own write, so the main context takes the merges a
+        //   save at a time; groups are [survivor, duplicates...] object IDs
+        size_t batchSize = std::max((size_t)1, (size_t)kRTCPlaceCompactionBatchSize);
+        for (size_t start = 0; start < groups.size(); start += batchSize) {
+            NSMutableArray *batch = [[NSMutableArray alloc] init];
+            for (size_t g = start; g < std::min(groups.size(), start + batchSize); ++g) {
+                NSMutableArray *group = [[NSMutableArray alloc] initWithObjects:rows[groups[g].survivor][@"objectID"], nil];
+                for (size_t i = 0; i < groups[g].duplicates.size(); ++i) {
+                    [group addObject:rows[groups[g].duplicates[i]][@"objectID"]];
+                }
+                [batch addObject:group];
+            }
+
+            [writer performWrite:^(NSManagedObjectContext *context) {
+                for (NSArray *group in batch) {
+                    // places edited or deleted since the read are skipped
+                    RTCPlace *survivor = (RTCPlace *)[context existingObjectWithID:group[0] error:NULL];
+                    if (!survivor || [survivor isDeleted]) continue;
+                    for (NSUInteger i = 1; i < [group count]; ++i) {
+                        RTCPlace *duplicate = (RTCPlace *)[context existingObjectWithID:group[i] error:NULL];
+                        if (!duplicate || [duplicate isDeleted]) continue;
+                        // places the user named differently stay apart. The
+                        //   survivor's name is checked as it stands, so it
+                        //   takes at most one name from its duplicates.
+                        if (![RTCPlace isName:survivor.name mergeableWithName:duplicate.name]) continue;
+                        [survivor mergeDuplicatePlace:duplicate];
+                        numMerged++;
+                    }
+                }
+            }];
+        }
+
+        [writer flushWrites:^{
+            self.compacting = NO;
+            [[NSUserDefaults standardUserDefaults] setObject:[NSDate date] forKey:kLastCompactionDateKey];
+            if (completion) completion(numMerged);
+        }];
+    }];
+}
+
+- (void)compactPlacesIfDue
+{
+    NSDate *lastCompaction = [[NSUserDefaults standardUserDefaults] objectForKey:kLastCompactionDateKey];
+    if (lastCompaction && (-[lastCompaction timeIntervalSinceNow] < kRTCPlaceCompactionInterval)) return;
+    [self compactPlacesWithCompletion:nil];
+}
+
+
+#pragma mark Private
+- (rtc::DuplicateIndex::PlaceID)assignPlaceIDToObjectID:(NSManagedObjectID *)objectID
+{
+    NSNumber *placeID = self.placeIDsByObjectID[objectID];
+    if (!placeID) {
+        placeID = @(_nextPlaceID++);
+        self.placeIDsByObjectID[objectID] = placeID;
+        self.objectIDsByPlaceID[placeID] = objectID;
+    }
+    return [placeID unsignedLongLongValue];
+}
+
+- (void)forgetObjectID:(NSManagedObjectID *)objectID
+{
+    NSNumber *placeID = self.placeIDsByObjectID[objectID];
+    if (!placeID) return;
+
+    _index.remove([placeID unsignedLongLongValue]);
+    [self.placeIDsByObjectID removeObjectForKey:objectID];
+    [self.objectIDsByPlaceID removeObjectForKey:placeID];
+}
+
+- (void)indexPlace:(RTCPlace *)place
+{
+    if (!place.latitude || !place.longitude) {
+        [self forgetObjectID:place.objectID];
+        return;
+    }
+
+    rtc::DuplicateIndex::Record record([self assignPlaceIDToObjectID:place.objectID],
+                                       rtc::GeoPoint([place.latitude doubleValue], [place.longitude doubleValue]),
+                                       place.horizontalAccuracy ? [place.horizontalAccuracy doubleValue] : -1.0, NAN);
+    _index.insert(record);
+}
+
+
+#pragma mark - Notification Observer Methods
+/**
+ * Keep the index in step with inserts, moves and deletes in our context
+ */
+- (void)contextObjectsDidChange:(NSNotification *)notification
+{
+    NSDictionary *userInfo = [notification userInfo];
+
+    // the context was reset under us, so start over
+    if (userInfo[NSInvalidatedAllObjectsKey]) {
+        [self rebuildIndex];
+        return;
+    }
+
+    for (NSManagedObject *object in userInfo[NSDeletedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) [self forgetObjectID:object.objectID];
+    }
+
+    NSMutableSet *changedPlaces = [[NSMutableSet alloc] init];
+    for (NSManagedObject *object in userInfo[NSInsertedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) [changedPlaces addObject:object];
+    }
+    // index by permanent ID so lookups still resolve after the next save
+    if ([changedPlaces count]) {
+        [self.managedObjectContext obtainPermanentIDsForObjects:[changedPlaces allObjects] error:NULL];
+    }
+
+    for (NSManagedObject *object in userInfo[NSUpdatedObjectsKey]) {
+        if (![object isKindOfClass:[RTCPlace class]]) continue;
+        NSDictionary *changes = [object changedValuesForCurrentEvent];
+        if (changes[kPlaceLatitudeKey] || changes[kPlaceLongitudeKey] || changes[kPlaceHorizontalAccuracyKey]) {
+            [changedPlaces addObject:object];
+        }
+    }
+    // saves merged in from the background writer show up as refreshes
+    for (NSManagedObject *object in userInfo[NSRefreshedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) [changedPlaces addObject:object];
+    }
+
+    for (RTCPlace *place in changedPlaces) {
+        if ([place isDeleted]) continue;
+        [self indexPlace:place];
+    }
+}
+
+@end
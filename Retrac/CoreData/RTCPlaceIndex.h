@@ -0,0 +1,119 @@
+//
+//  RTCPlaceIndex.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/10/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreData/CoreData.h>
+#import <CoreLocation/CoreLocation.h>
+#import <MapKit/MapKit.h>
+
+/**
+ * RTCPlaceIndex answers "which saved places are near here?" without fetching
+ * every RTCPlace and unarchiving its CLLocation.
+ *
+ * It wraps the engine's Z-order spatial index, keeps it in sync with the
+ * managed object context it was created for, and persists it to a file next
+ * to the places document so it doesn't have to be rebuilt on every launch.
+ * If the saved index doesn't match the store (missing file, crash before save,
+ * places edited elsewhere) it is rebuilt with a single fetch.
+ *
+ * For maps it also keeps the places clustered at every zoom level (see
+ * rtc::ClusterIndex), built the first time they are asked for after a change.
+ */
+@interface RTCPlaceIndex : NSObject
+
+#pragma mark - Properties
+/**
+ * Number of indexed places
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ * Number of index entries examined by the most recent query
+ */
+@property (nonatomic, readonly) NSUInteger lastQueryVisits;
+
+
+#pragma mark - Initialization
+/**
+ * Load the index saved at fileURL, or build it from context's places.
+ *
+ * @param context   context whose RTCPlace objects are indexed. Changes made in
+ *      this context are picked up as they happen.
+ * @param fileURL   where the index is persisted
+ */
+- (instancetype)initWithManagedObjectContext:(NSManagedObjectContext *)context
+                                     fileURL:(NSURL *)fileURL;
+
+
+#pragma mark - Instance Methods
+/**
+ * The count places closest to coordinate.
+ *
+ * @return RTCPlace objects, nearest first.
+ */
+- (NSArray *)placesNearestToCoordinate:(CLLocationCoordinate2D)coordinate
+                                 count:(NSUInteger)count;
+
+/**
+ * All places within distance (meters) of coordinate.
+ *
+ * @return RTCPlace objects, nearest first.
+ */
+- (NSArray *)placesWithinDistance:(CLLocationDistance)distance
+                     ofCoordinate:(CLLocationCoordinate2D)coordinate;
+
+/**
+ * Every place, nearest to coordinate first. Distances are worked out for all
+ * places in one batch (see rtc::distancesFrom) rather than one CLLocation at a
+ * time.
+ *
+ * @param distances     optional, set to the places' distances (meters) from
+ *                      coordinate, as NSNumbers in the same order
+ * @param bearings      optional, set to the bearings (degrees clockwise from
+ *                      true north) from coordinate to the places
+ *
+ * @return RTCPlace objects, nearest first.
+ */
+- (NSArray *)placesOrderedByDistanceFromCoordinate:(CLLocationCoordinate2D)coordinate
+                                         distances:(NSArray **)distances
+                                          bearings:(NSArray **)bearings;
+
+/**
+ * The smallest region containing every place, from the cluster index rather
+ * than a pass over the places.
+ *
+ * @return NO if there are no places.
+ */
+- (BOOL)getRegionContainingPlaces:(MKCoordinateRegion *)region;
+
+/**
+ * What to show on a map of region at zoomLevel: RTCPlace objects for places
+ * on their own and RTCPlaceCluster objects for places clustered together.
+ * Only the annotations in region are returned.
+ *
+ * @param zoomLevel     map zoom level, see - [MKMapView zoomLevel]
+ */
+- (NSArray *)annotationsInRegion:(MKCoordinateRegion)region
+                       zoomLevel:(double)zoomLevel;
+
+/**
+ * Rebuild the index from the store with a single fetch of every place's
+ * object ID and coordinate columns; no RTCPlace objects are materialized. Only
+ * needed after places were added to the store past this index's context, e.g.
+ * by a bulk import.
+ */
+- (void)rebuildIndex;
+
+/**
+ * Write the index to its file if it has changed since it was last written.
+ *
+ * @return NO if the write failed.
+ */
+- (BOOL)saveIndex;
+
+@end
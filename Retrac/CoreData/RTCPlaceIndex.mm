@@ -0,0 +1,439 @@
+//
+//  RTCPlaceIndex.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/10/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCPlaceIndex.h"
+#import "RTCPlace.h"
+#import "RTCPlaceCluster.h"
+#include <sstream>
+#include <string>
+#include "RTCClusterIndex.h"
+#include "RTCGeoKernel.h"
+#include "RTCSpatialIndex.h"
+
+#pragma mark - Constants
+// bump this whenever the on-disk layout changes so old files get rebuilt
+static const NSInteger kPlaceIndexFileVersion = 1;
+
+// keys of the property list the index is saved in
+static NSString *const kPlaceIndexVersionKey    = @"version";
+static NSString *const kPlaceIndexNextIDKey     = @"nextPlaceID";
+static NSString *const kPlaceIndexObjectIDsKey  = @"objectIDs";   // placeID string -> object URI string
+static NSString *const kPlaceIndexDataKey       = @"index";       // serialized rtc::SpatialIndex
+
+// screen points across the whole world at map zoom level 0
+static const double kMapTileSize = 256.0;
+
+
+@interface RTCPlaceIndex () {
+    rtc::SpatialIndex _index;
+    rtc::SpatialIndex::PlaceID _nextPlaceID;
+
+    // every indexed place in batch kernel form, rebuilt when the index changes
+    rtc::GeoPointArray _points;
+    std::vector<rtc::SpatialIndex::PlaceID> _pointPlaceIDs;
+    BOOL _pointsStale;
+
+    // every indexed place clustered for maps, rebuilt when the index changes
+    rtc::ClusterIndex _clusters;
+    BOOL _clustersStale;
+}
+
+@property (weak, nonatomic) NSManagedObjectContext *managedObjectContext;
+@property (strong, nonatomic) NSURL *fileURL;
+
+// the engine knows places by integer ID; these map them to Core Data objects
+@property (strong, nonatomic) NSMutableDictionary *objectIDsByPlaceID;  // NSNumber -> NSManagedObjectID
+@property (strong, nonatomic) NSMutableDictionary *placeIDsByObjectID;  // NSManagedObjectID -> NSNumber
+
+// has the index changed since it was last saved?
+@property (nonatomic) BOOL dirty;
+
+@end
+
+
+#pragma mark - Helpers
+static MKCoordinateRegion regionFromGeoRect(const rtc::GeoRect &rect)
+{
+    CLLocationCoordinate2D center = CLLocationCoordinate2DMake(0.5 * (rect.minLatitude + rect.maxLatitude),
+                                                               0.5 * (rect.minLongitude + rect.maxLongitude));
+    return MKCoordinateRegionMake(center, MKCoordinateSpanMake(rect.maxLatitude - rect.minLatitude,
+                                                               rect.maxLongitude - rect.minLongitude));
+}
+
+// longitude in [-180, 180)
+static double wrapLongitude(double longitude)
+{
+    longitude = fmod(longitude + 180.0, 360.0);
+    return ((longitude < 0) ? longitude + 360.0 : longitude) - 180.0;
+}
+
+
+@implementation RTCPlaceIndex
+
+#pragma mark - Properties
+- (NSUInteger)count
+{
+    return _index.size();
+}
+
+- (NSUInteger)lastQueryVisits
+{
+    return _index.lastQueryVisits();
+}
+
+
+#pragma mark - Initialization
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"RTCPlaceIndex"
+                                   reason:@"Use - [RTCPlaceIndex initWithManagedObjectContext:fileURL:]"
+                                 userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithManagedObjectContext:(NSManagedObjectContext *)context
+                                     fileURL:(NSURL *)fileURL
+{
+    self = [super init];
+    if (self) {
+        _managedObjectContext = context;
+        _fileURL = fileURL;
+        _nextPlaceID = 1;
+        _pointsStale = YES;
+        _clusters = rtc::ClusterIndex(kRTCMapClusterRadius, kMapTileSize, kRTCMapClusterMaxZoomLevel);
+        _clustersStale = YES;
+        _objectIDsByPlaceID = [[NSMutableDictionary alloc] init];
+        _placeIDsByObjectID = [[NSMutableDictionary alloc] init];
+
+        if (![self loadIndex]) [self rebuildIndex];
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(contextObjectsDidChange:)
+                                                     name:NSManagedObjectContextObjectsDidChangeNotification
+                                                   object:context];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Public
+- (NSArray *)placesNearestToCoordinate:(CLLocationCoordinate2D)coordinate
+                                 count:(NSUInteger)count
+{
+    rtc::GeoPoint origin(coordinate.latitude, coordinate.longitude);
+    return [self placesForNeighbors:_index.nearest(origin, count)];
+}
+
+- (NSArray *)placesWithinDistance:(CLLocationDistance)distance
+                     ofCoordinate:(CLLocationCoordinate2D)coordinate
+{
+    rtc::GeoPoint origin(coordinate.latitude, coordinate.longitude);
+    return [self placesForNeighbors:_index.within(origin, distance)];
+}
+
+- (NSArray *)placesOrderedByDistanceFromCoordinate:(CLLocationCoordinate2D)coordinate
+                                         distances:(NSArray **)distances
+                                          bearings:(NSArray **)bearings
+{
+    if (_pointsStale) {
+        std::vector<rtc::SpatialIndex::Record> records = _index.records();
+        _points.clear();
+        _points.reserve(records.size());
+        _pointPlaceIDs.clear();
+        _pointPlaceIDs.reserve(records.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            _points.push_back(records[i].coordinate);
+            _pointPlaceIDs.push_back(records[i].placeID);
+        }
+        _pointsStale = NO;
+    }
+
+    rtc::GeoPoint origin(coordinate.latitude, coordinate.longitude);
+    std::vector<double> pointDistances, pointBearings;
+    std::vector<size_t> order = rtc::orderByDistance(origin, _points, &pointDistances,
+                                                     bearings ? &pointBearings : NULL);
+
+    NSMutableArray *places = [[NSMutableArray alloc] initWithCapacity:order.size()];
+    NSMutableArray *placeDistances = distances ? [[NSMutableArray alloc] initWithCapacity:order.size()] : nil;
+    NSMutableArray *placeBearings = bearings ? [[NSMutableArray alloc] initWithCapacity:order.size()] : nil;
+    for (size_t i = 0; i < order.size(); ++i) {
+        NSManagedObjectID *objectID = self.objectIDsByPlaceID[@(_pointPlaceIDs[order[i]])];
+        NSManagedObject *place = objectID ? [self.managedObjectContext existingObjectWithID:objectID error:NULL] : nil;
+        if (!place) continue;
+
+        [places addObject:place];
+        [placeDistances addObject:@(pointDistances[order[i]])];
+        if (bearings) [placeBearings addObject:@(pointBearings[order[i]])];
+    }
+
+    if (distances) *distances = placeDistances;
+    if (bearings) *bearings = placeBearings;
+    return places;
+}
+
+- (BOOL)getRegionContainingPlaces:(MKCoordinateRegion *)region
+{
+    rtc::GeoRect bounds;
+    if (![self updateClusters].bounds(&bounds)) return NO;
+    if (region) *region = regionFromGeoRect(bounds);
+    return YES;
+}
+
+- (NSArray *)annotationsInRegion:(MKCoordinateRegion)region
+                       zoomLevel:(double)zoomLevel
+{
+    // region as a bounding box, longitudes wrapped so one crossing the
+    // antimeridian has minLongitude > maxLongitude
+    double halfLatitude = 0.5 * region.span.latitudeDelta, halfLongitude = 0.5 * region.span.longitudeDelta;
+    rtc::GeoRect viewport(region.center.latitude - halfLatitude, region.center.longitude - halfLongitude,
+                          region.center.latitude + halfLatitude, region.center.longitude + halfLongitude);
+    if (region.span.longitudeDelta < 360.0) {
+        viewport.minLongitude = wrapLongitude(viewport.minLongitude);
+        viewport.maxLongitude = wrapLongitude(viewport.maxLongitude);
+    }
+
+    std::vector<rtc::ClusterIndex::Cluster> clusters = [self updateClusters].clusters(viewport, zoomLevel);
+
+    NSMutableArray *annotations = [[NSMutableArray alloc] initWithCapacity:clusters.size()];
+    for (size_t i = 0; i < clusters.size(); ++i) {
+        const rtc::ClusterIndex::Cluster &cluster = clusters[i];
+        if (cluster.isPlace()) {
+            NSManagedObjectID *objectID = self.objectIDsByPlaceID[@(cluster.id)];
+            NSManagedObject *place = objectID ? [self.managedObjectContext existingObjectWithID:objectID error:NULL] : nil;
+            if (place) [annotations addObject:place];
+        } else {
+            CLLocationCoordinate2D coordinate = CLLocationCoordinate2DMake(cluster.coordinate.latitude,
+                                                                           cluster.coordinate.longitude);
+            [annotations addObject:[[RTCPlaceCluster alloc] initWithClusterID:cluster.id
+                                                                        count:cluster.count
+                                                                   coordinate:coordinate
+                                                                       region:regionFromGeoRect(cluster.bounds)]];
+        }
+    }
+    return annotations;
+}
+
+- (void)rebuildIndex
+{
+    _index.clear();
+    _nextPlaceID = 1;
+    [self.objectIDsByPlaceID removeAllObjects];
+    [self.placeIDsByObjectID removeAllObjects];
+
+    NSExpressionDescription *objectIDDescription = [[NSExpressionDescription alloc] init];
+    objectIDDescription.name = @"objectID";
+    objectIDDescription.expression = [NSExpression expressionForEvaluatedObject];
+    objectIDDescription.expressionResultType = NSObjectIDAttributeType;
+
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    request.predicate = [NSPredicate predicateWithFormat:@"latitude != nil AND longitude != nil"];
+    request.resultType = NSDictionaryResultType;
+    request.propertiesToFetch = @[objectIDDescription, @"latitude", @"longitude"];
+    NSArray *rows = [self.managedObjectContext executeFetchRequest:request error:NULL];
+
+    std::vector<rtc::SpatialIndex::Record> records;
+    records.reserve([rows count]);
+    for (NSDictionary *row in rows) {
+        rtc::SpatialIndex::PlaceID placeID = [self assignPlaceIDToObjectID:row[@"objectID"]];
+        rtc::GeoPoint coordinate([row[@"latitude"] doubleValue], [row[@"longitude"] doubleValue]);
+        records.push_back(rtc::SpatialIndex::Record(placeID, coordinate));
+    }
+    _index.assign(records);
+    _pointsStale = YES;
+    _clustersStale = YES;
+    self.dirty = YES;
+}
+
+- (BOOL)saveIndex
+{
+    if (!self.dirty) return YES;
+
+    // object IDs are only worth saving once they are permanent
+    NSMutableDictionary *objectURIs = [[NSMutableDictionary alloc] initWithCapacity:[self.objectIDsByPlaceID count]];
+    for (NSNumber *placeID in self.objectIDsByPlaceID) {
+        NSManagedObjectID *objectID = self.objectIDsByPlaceID[placeID];
+        if ([objectID isTemporaryID]) return NO;
+        objectURIs[[placeID stringValue]] = [[objectID URIRepresentation] absoluteString];
+    }
+
+    std::ostringstream output;
+    _index.write(output);
+    std::string bytes = output.str();
+
+    NSDictionary *plist = @{kPlaceIndexVersionKey   : @(kPlaceIndexFileVersion),
+                            kPlaceIndexNextIDKey    : @(_nextPlaceID),
+                            kPlaceIndexObjectIDsKey : objectURIs,
+                            kPlaceIndexDataKey      : [NSData dataWithBytes:bytes.data() length:bytes.size()]};
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:plist
+                                                              format:NSPropertyListBinaryFormat_v1_0
+                                                             options:0
+                                                               error:NULL];
+    if (![data writeToURL:self.fileURL atomically:YES]) return NO;
+
+    self.dirty = NO;
+    return YES;
+}
+
+
+#pragma mark Private
+/**
+ * The cluster index, reclustered first if places have changed since it was
+ * last built
+ */
+- (const rtc::ClusterIndex &)updateClusters
+{
+    if (_clustersStale) {
+        _clusters.assign(_index.records());
+        _clustersStale = NO;
+    }
+    return _clusters;
+}
+
+/**
+ * Map query results back to (faulted) RTCPlace objects, preserving order
+ */
+- (NSArray *)placesForNeighbors:(const std::vector<rtc::SpatialIndex::Neighbor> &)neighbors
+{
+    NSMutableArray *places = [[NSMutableArray alloc] initWithCapacity:neighbors.size()];
+    for (size_t i = 0; i < neighbors.size(); ++i) {
+        NSManagedObjectID *objectID = self.objectIDsByPlaceID[@(neighbors[i].placeID)];
+        NSManagedObject *place = objectID ? [self.managedObjectContext existingObjectWithID:objectID error:NULL] : nil;
+        if (place) [places addObject:place];
+    }
+    return places;
+}
+
+/**
+ * Load the saved index and check it still describes the store.
+ *
+ * @return NO if there is no usable saved index.
+ */
+- (BOOL)loadIndex
+{
+    NSData *data = [NSData dataWithContentsOfURL:self.fileURL];
+    if (!data) return NO;
+
+    NSDictionary *plist = [NSPropertyListSerialization propertyListWithData:data
+                                                                    options:NSPropertyListImmutable
+                                                                     format:NULL
+                                                                      error:NULL];
+    if (![plist isKindOfClass:[NSDictionary class]] ||
+        ([plist[kPlaceIndexVersionKey] integerValue] != kPlaceIndexFileVersion)) {
+        return NO;
+    }
+
+    NSData *indexData = plist[kPlaceIndexDataKey];
+    std::istringstream input(std::string((const char *)[indexData bytes], [indexData length]));
+    if (!_index.read(input)) return NO;
+
+    // every indexed place must still resolve to an object in this store...
+    NSPersistentStoreCoordinator *coordinator = self.managedObjectContext.persistentStoreCoordinator;
+    NSDictionary *objectURIs = plist[kPlaceIndexObjectIDsKey];
+    for (NSString *placeIDString in objectURIs) {
+        NSURL *uri = [NSURL URLWithString:objectURIs[placeIDString]];
+        NSManagedObjectID *objectID = uri ? [coordinator managedObjectIDForURIRepresentation:uri] : nil;
+        NSNumber *placeID = @(strtoull([placeIDString UTF8String], NULL, 10));
+        if (!objectID || !_index.contains([placeID unsignedLongLongValue])) return NO;
+
+        self.objectIDsByPlaceID[placeID] = objectID;
+        self.placeIDsByObjectID[objectID] = placeID;
+    }
+
+    // ...and the store mustn't have places the index hasn't seen
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    request.predicate = [NSPredicate predicateWithFormat:@"latitude != nil AND longitude != nil"];
+    NSUInteger numPlaces = [self.managedObjectContext countForFetchRequest:request error:NULL];
+    if ((numPlaces != _index.size()) || ([objectURIs count] != _index.size())) return NO;
+
+    _nextPlaceID = [plist[kPlaceIndexNextIDKey] unsignedLongLongValue];
+    return YES;
+}
+
+- (rtc::SpatialIndex::PlaceID)assignPlaceIDToObjectID:(NSManagedObjectID *)objectID
+{
+    NSNumber *placeID = self.placeIDsByObjectID[objectID];
+    if (!placeID) {
+        placeID = @(_nextPlaceID++);
+        self.placeIDsByObjectID[objectID] = placeID;
+        self.objectIDsByPlaceID[placeID] = objectID;
+    }
+    return [placeID unsignedLongLongValue];
+}
+
+- (void)forgetObjectID:(NSManagedObjectID *)objectID
+{
+    NSNumber *placeID = self.placeIDsByObjectID[objectID];
+    if (!placeID) return;
+
+    _index.remove([placeID unsignedLongLongValue]);
+    _pointsStale = YES;
+    _clustersStale = YES;
+    [self.placeIDsByObjectID removeObjectForKey:objectID];
+    [self.objectIDsByPlaceID removeObjectForKey:placeID];
+    self.dirty = YES;
+}
+
+
+#pragma mark - Notification Observer Methods
+/**
+ * Keep the index in step with inserts, deletes and moves in our context
+ */
+- (void)contextObjectsDidChange:(NSNotification *)notification
+{
+    NSDictionary *userInfo = [notification userInfo];
+
+    // the context was reset under us, so start over
+    if (userInfo[NSInvalidatedAllObjectsKey]) {
+        [self rebuildIndex];
+        return;
+    }
+
+    for (NSManagedObject *object in userInfo[NSDeletedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) [self forgetObjectID:object.objectID];
+    }
+
+    NSMutableArray *insertedPlaces = [[NSMutableArray alloc] init];
+    for (NSManagedObject *object in userInfo[NSInsertedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) [insertedPlaces addObject:object];
+    }
+    // index by permanent ID so entries survive the next save
+    if ([insertedPlaces count]) {
+        [self.managedObjectContext obtainPermanentIDsForObjects:insertedPlaces error:NULL];
+    }
+
+    // saves merged in from the background writer show up as refreshes
+    NSArray *updatedPlaces = [[userInfo[NSUpdatedObjectsKey] allObjects]
+                              arrayByAddingObjectsFromArray:[userInfo[NSRefreshedObjectsKey] allObjects]];
+    for (RTCPlace *place in [insertedPlaces arrayByAddingObjectsFromArray:updatedPlaces]) {
+        if (![place isKindOfClass:[RTCPlace class]] || [place isDeleted]) continue;
+
+        if (place.latitude && place.longitude) {
+            rtc::SpatialIndex::PlaceID placeID = [self assignPlaceIDToObjectID:place.objectID];
+            rtc::GeoPoint point([place.latitude doubleValue], [place.longitude doubleValue]);
+
+            rtc::GeoPoint indexed;
+            if (!_index.coordinateOf(placeID, &indexed) ||
+                (indexed.latitude != point.latitude) || (indexed.longitude != point.longitude)) {
+                _index.insert(placeID, point);
+                _pointsStale = YES;
+                _clustersStale = YES;
+                self.dirty = YES;
+            }
+        } else {
+            [self forgetObjectID:place.objectID];
+        }
+    }
+}
+
+@end
@@ -0,0 +1,71 @@
+//
+//  RTCPlaceSearchIndex.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/27/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreData/CoreData.h>
+
+/**
+ * RTCPlaceSearchIndex finds saved places by the words of their name and
+ * address as the user types, without a fetch per keystroke or unarchiving
+ * any placemarks.
+ *
+ * It wraps the engine's text index (see rtc::TextIndex), keeps it in sync
+ * with the managed object context it was created for as places are added,
+ * renamed, geocoded and deleted, and persists it to a file next to the places
+ * document. As with RTCPlaceIndex, a saved index that doesn't match the store
+ * is rebuilt, which is the one time every placemark is read. That happens off
+ * the main queue, and the new index replaces the old one when it's done.
+ */
+@interface RTCPlaceSearchIndex : NSObject
+
+#pragma mark - Properties
+/**
+ * Number of indexed places
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+
+#pragma mark - Initialization
+/**
+ * Load the index saved at fileURL, or start building it from context's places.
+ *
+ * @param context   context whose RTCPlace objects are indexed. Changes made in
+ *      this context are picked up as they happen.
+ * @param fileURL   where the index is persisted
+ */
+- (instancetype)initWithManagedObjectContext:(NSManagedObjectContext *)context
+                                     fileURL:(NSURL *)fileURL;
+
+
+#pragma mark - Instance Methods
+/**
+ * Places with a word starting with each word of text, in name or address.
+ *
+ * @param maxResults    most places returned
+ *
+ * @return NSManagedObjectIDs of RTCPlace objects, places whose name matches
+ *      first, then newest first.
+ */
+- (NSArray *)objectIDsOfPlacesMatchingText:(NSString *)text
+                                maxResults:(NSUInteger)maxResults;
+
+/**
+ * Rebuild the index from the store in the background. Only needed after
+ * places were added to the store past this index's context, e.g. by a bulk
+ * import. Searches find what they did before until it's done.
+ */
+- (void)rebuildIndex;
+
+/**
+ * Write the index to its file if it has changed since it was last written.
+ *
+ * @return NO if the write failed.
+ */
+- (BOOL)saveIndex;
+
+@end
@@ -0,0 +1,407 @@
+//
+//  RTCPlaceSearchIndex.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/27/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCPlaceSearchIndex.h"
+#import "RTCPlace.h"
+#import "RTCPlacemark.h"
+#import "RTCPlace+Location.h"
+#include <memory>
+#include <sstream>
+#include <string>
+#include "RTCTextIndex.h"
+
+#pragma mark - Constants
+// bump this whenever the on-disk layout changes so old files get rebuilt
+static const NSInteger kPlaceSearchIndexFileVersion = 1;
+
+// keys of the property list the index is saved in
+static NSString *const kPlaceSearchIndexVersionKey   = @"version";
+static NSString *const kPlaceSearchIndexNextIDKey    = @"nextPlaceID";
+static NSString *const kPlaceSearchIndexObjectIDsKey = @"objectIDs";   // placeID string -> object URI string
+static NSString *const kPlaceSearchIndexDataKey      = @"index";       // serialized rtc::TextIndex
+
+// places read per batch while rebuilding
+static const NSUInteger kRebuildBatchSize = 500;
+
+// changes to these mean a place's words may have changed
+static NSString *const kPlaceNameKey        = @"name";
+static NSString *const kPlacePlacemarkKey   = @"placemarkRecord";
+
+
+@interface RTCPlaceSearchIndex () {
+    rtc::TextIndex _index;
+    rtc::TextIndex::PlaceID _nextPlaceID;
+}
+
+@property (weak, nonatomic) NSManagedObjectContext *managedObjectContext;
+@property (strong, nonatomic) NSURL *fileURL;
+
+// the engine knows places by integer ID; these map them to Core Data objects
+@property (strong, nonatomic) NSMutableDictionary *objectIDsByPlaceID;  // NSNumber -> NSManagedObjectID
+@property (strong, nonatomic) NSMutableDictionary *placeIDsByObjectID;  // NSManagedObjectID -> NSNumber
+
+// has the index changed since it was last saved?
+@property (nonatomic) BOOL dirty;
+
+// the latest rebuild, so an earlier one finishing late is thrown away
+@property (nonatomic) NSUInteger rebuildCount;
+
+// places changed in our context since the rebuild under way read the store,
+//   to bring its result up to date. nil if there's no rebuild.
+@property (strong, nonatomic) NSMutableSet *objectIDsChangedDuringRebuild;
+
+@end
+
+
+#pragma mark - Helpers
+static std::string stdString(NSString *string)
+{
+    const char *utf8 = [string UTF8String];
+    return utf8 ? std::string(utf8) : std::string();
+}
+
+
+@implementation RTCPlaceSearchIndex
+
+#pragma mark - Properties
+- (NSUInteger)count
+{
+    return _index.size();
+}
+
+
+#pragma mark - Initialization
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"RTCPlaceSearchIndex"
+                                   reason:@"Use - [RTCPlaceSearchIndex initWithManagedObjectContext:fileURL:]"
+                                 userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithManagedObjectContext:(NSManagedObjectContext *)context
+                                     fileURL:(NSURL *)fileURL
+{
+    self = [super init];
+    if (self) {
+        _managedObjectContext = context;
+        _fileURL = fileURL;
+        _nextPlaceID = 1;
+        _objectIDsByPlaceID = [[NSMutableDictionary alloc] init];
+        _placeIDsByObjectID = [[NSMutableDictionary alloc] init];
+
+        if (![self loadIndex]) {
+            // what loaded before it turned out unusable can't be searched
+            _index.clear();
+            [_objectIDsByPlaceID removeAllObjects];
+            [_placeIDsByObjectID removeAllObjects];
+            [self rebuildIndex];
+        }
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(contextObjectsDidChange:)
+                                                     name:NSManagedObjectContextObjectsDidChangeNotification
+                                                   object:context];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Public
+- (NSArray *)objectIDsOfPlacesMatchingText:(NSString *)text
+                                maxResults:(NSUInteger)maxResults
+{
+    std::vector<rtc::TextIndex::PlaceID> placeIDs = _index.search(stdString(text), maxResults);
+
+    NSMutableArray *objectIDs = [[NSMutableArray alloc] initWithCapacity:placeIDs.size()];
+    for (size_t i = 0; i < placeIDs.size(); ++i) {
+        NSManagedObjectID *objectID = self.objectIDsByPlaceID[@(placeIDs[i])];
+        if (objectID) [objectIDs addObject:objectID];
+    }
+    return objectIDs;
+}
+
+- (void)rebuildIndex
+{
+    NSManagedObjectContext *context = self.managedObjectContext;
+    if (!context) return;
+    NSUInteger rebuild = ++self.rebuildCount;
+
+    // the store can't see what our context hasn't saved, so go over that again
+    //   once the rebuild is in
+    self.objectIDsChangedDuringRebuild = [[NSMutableSet alloc] init];
+    for (NSSet *objects in @[[context insertedObjects], [context updatedObjects], [context deletedObjects]]) {
+        for (NSManagedObject *object in objects) {
+            if ([object isKindOfClass:[RTCPlace class]]) [self.objectIDsChangedDuringRebuild addObject:object.objectID];
+        }
+    }
+
+    // reading every placemark takes a while with a lot of places, so it's
+    //   done in a context of its own off the main queue. Searches use the old
+    //   index until the new one is swapped in.
+    NSManagedObjectContext *rebuildContext = [[NSManagedObjectContext alloc] initWithConcurrencyType:NSPrivateQueueConcurrencyType];
+    if (context.parentContext) {
+        rebuildContext.parentContext = context.parentContext;
+    } else {
+        rebuildContext.persistentStoreCoordinator = context.persistentStoreCoordinator;
+    }
+
+    [rebuildContext performBlock:^{
+        std::shared_ptr<rtc::TextIndex> index(new rtc::TextIndex());
+        rtc::TextIndex::PlaceID nextPlaceID = 1;
+        NSMutableDictionary *objectIDsByPlaceID = [[NSMutableDictionary alloc] init];
+        NSMutableDictionary *placeIDsByObjectID = [[NSMutableDictionary alloc] init];
+
+        // oldest first so IDs, and so ties in search results, follow creation
+        NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+        request.sortDescriptors = @[[NSSortDescriptor sortDescriptorWithKey:@"creationDate" ascending:YES]];
+        request.relationshipKeyPathsForPrefetching = @[kPlacePlacemarkKey];
+        request.fetchBatchSize = kRebuildBatchSize;
+        NSArray *places = [rebuildContext executeFetchRequest:request error:NULL];
+
+        for (NSUInteger start = 0; start < [places count]; start += kRebuildBatchSize) {
+            @autoreleasepool {
+                NSUInteger end = MIN(start + kRebuildBatchSize, [places count]);
+                for (NSUInteger i = start; i < end; ++i) {
+                    RTCPlace *place = places[i];
+                    rtc::TextIndex::PlaceID placeID = nextPlaceID++;
+                    objectIDsByPlaceID[@(placeID)] = place.objectID;
+                    placeIDsByObjectID[place.objectID] = @(placeID);
+                    index->insert(placeID, stdString(place.name), stdString([RTCPlace addressFromPlacemark:place.placemark]));
+                    // don't hold every unarchived placemark in memory at once
+                    [rebuildContext refreshObject:place mergeChanges:NO];
+                }
+            }
+        }
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (rebuild != self.rebuildCount) return;
+            _index = std::move(*index);
+            _nextPlaceID = nextPlaceID;
+            self.objectIDsByPlaceID = objectIDsByPlaceID;
+            self.placeIDsByObjectID = placeIDsByObjectID;
+            self.dirty = YES;
+
+            NSSet *changedObjectIDs = self.objectIDsChangedDuringRebuild;
+            self.objectIDsChangedDuringRebuild = nil;
+            for (NSManagedObjectID *objectID in changedObjectIDs) {
+                RTCPlace *place = (RTCPlace *)[self.managedObjectContext existingObjectWithID:objectID error:NULL];
+                if (place && ![place isDeleted]) {
+                    [self indexPlace:place];
+                } else {
+                    [self forgetObjectID:objectID];
+                }
+            }
+        });
+    }];
+}
+
+- (BOOL)saveIndex
+{
+    if (!self.dirty) return YES;
+
+    // object IDs are only worth saving once they are permanent
+    NSMutableDictionary *objectURIs = [[NSMutableDictionary alloc] initWithCapacity:[self.objectIDsByPlaceID count]];
+    for (NSNumber *placeID in self.objectIDsByPlaceID) {
+        NSManagedObjectID *objectID = self.objectIDsByPlaceID[placeID];
+        if ([objectID isTemporaryID]) return NO;
+        objectURIs[[placeID stringValue]] = [[objectID URIRepresentation] absoluteString];
+    }
+
+    std::ostringstream output;
+    _index.write(output);
+    std::string bytes = output.str();
+
+    NSDictionary *plist = @{kPlaceSearchIndexVersionKey   : @(kPlaceSearchIndexFileVersion),
+                            kPlaceSearchIndexNextIDKey    : @(_nextPlaceID),
+                            kPlaceSearchIndexObjectIDsKey : objectURIs,
+                            kPlaceSearchIndexDataKey      : [NSData dataWithBytes:bytes.data() length:bytes.size()]};
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:plist
+                                                              format:NSPropertyListBinaryFormat_v1_0
+                                                             options:0
+                                                               error:NULL];
+    if (![data writeToURL:self.fileURL atomically:YES]) return NO;
+
+    self.dirty = NO;
+    return YES;
+}
+
+
+#pragma mark Private
+/**
+ * Load the saved index and check it still describes the store.
+ *
+ * @return NO if there is no usable saved index.
+ */
+- (BOOL)loadIndex
+{
+    NSData *data = [NSData dataWithContentsOfURL:self.fileURL];
+    if (!data) return NO;
+
+    NSDictionary *plist = [NSPropertyListSerialization propertyListWithData:data
+                                                                    options:NSPropertyListImmutable
+                                                                     format:NULL
+                                                                      error:NULL];
+    if (![plist isKindOfClass:[NSDictionary class]] ||
+        ([plist[kPlaceSearchIndexVersionKey] integerValue] != kPlaceSearchIndexFileVersion)) {
+        return NO;
+    }
+
+    NSData *indexData = plist[kPlaceSearchIndexDataKey];
+    std::istringstream input(std::string((const char *)[indexData bytes], [indexData length]));
+    if (!_index.read(input)) return NO;
+
+    // every indexed place must still resolve to an object in this store...
+    NSPersistentStoreCoordinator *coordinator = self.managedObjectContext.persistentStoreCoordinator;
+    NSDictionary *objectURIs = plist[kPlaceSearchIndexObjectIDsKey];
+    for (NSString *placeIDString in objectURIs) {
+        NSURL *uri = [NSURL URLWithString:objectURIs[placeIDString]];
+        NSManagedObjectID *objectID = uri ? [coordinator managedObjectIDForURIRepresentation:uri] : nil;
+        NSNumber *placeID = @(strtoull([placeIDString UTF8String], NULL, 10));
+        if (!objectID || !_index.contains([placeID unsignedLongLongValue])) return NO;
+
+        self.objectIDsByPlaceID[placeID] = objectID;
+        self.placeIDsByObjectID[objectID] = placeID;
+    }
+
+    // ...and the store mustn't have places the index hasn't seen
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    NSUInteger numPlaces = [self.managedObjectContext countForFetchRequest:request error:NULL];
+    if ((numPlaces != _index.size()) || ([objectURIs count] != _index.size())) return NO;
+
+    _nextPlaceID = [plist[kPlaceSearchIndexNextIDKey] unsignedLongLongValue];
+    return YES;
+}
+
+/**
+ * Index, or reindex, place's name and the address its placemark reads as
+ */
+- (void)indexPlace:(RTCPlace *)place
+{
+    rtc::TextIndex::PlaceID placeID = [self assignPlaceIDToObjectID:place.objectID];
+    std::string name = stdString(place.name);
+    std::string address = stdString([RTCPlace addressFromPlacemark:place.placemark]);
+
+    std::string indexedName, indexedAddress;
+    if (_index.textOf(placeID, &indexedName, &indexedAddress) &&
+        (indexedName == name) && (indexedAddress == address)) {
+        return;
+    }
+    _index.insert(placeID, name, address);
+    self.dirty = YES;
+}
+
+/**
+ * Has place's name or placemark changed since it was indexed? Doesn't read
+ * the placemark, so it only tells a placemark coming or going, not changing.
+ */
+- (BOOL)isPlaceStale:(RTCPlace *)place
+{
+    NSNumber *placeID = self.placeIDsByObjectID[place.objectID];
+    std::string indexedName, indexedAddress;
+    if (!placeID || !_index.textOf([placeID unsignedLongLongValue], &indexedName, &indexedAddress)) return YES;
+
+    return (indexedName != stdString(place.name)) || (indexedAddress.empty() != !place.placemarkRecord);
+}
+
+- (rtc::TextIndex::PlaceID)assignPlaceIDToObjectID:(NSManagedObjectID *)objectID
+{
+    NSNumber *placeID = self.placeIDsByObjectID[objectID];
+    if (!placeID) {
+        placeID = @(_nextPlaceID++);
+        self.placeIDsByObjectID[objectID] = placeID;
+        self.objectIDsByPlaceID[placeID] = objectID;
+    }
+    return [placeID unsignedLongLongValue];
+}
+
+- (void)forgetObjectID:(NSManagedObjectID *)objectID
+{
+    NSNumber *placeID = self.placeIDsByObjectID[objectID];
+    if (!placeID) return;
+
+    _index.remove([placeID unsignedLongLongValue]);
+    [self.placeIDsByObjectID removeObjectForKey:objectID];
+    [self.objectIDsByPlaceID removeObjectForKey:placeID];
+    self.dirty = YES;
+}
+
+
+#pragma mark - Notification Observer Methods
+/**
+ * Keep the index in step with inserts, renames, geocoding and deletes in our
+ * context
+ */
+- (void)contextObjectsDidChange:(NSNotification *)notification
+{
+    NSDictionary *userInfo = [notification userInfo];
+
+    // the context was reset under us, so start over
+    if (userInfo[NSInvalidatedAllObjectsKey]) {
+        [self rebuildIndex];
+        return;
+    }
+
+    for (NSManagedObject *object in userInfo[NSDeletedObjectsKey]) {
+        if (![object isKindOfClass:[RTCPlace class]]) continue;
+        [self forgetObjectID:object.objectID];
+        [self.objectIDsChangedDuringRebuild addObject:object.objectID];
+    }
+
+    NSMutableSet *changedPlaces = [[NSMutableSet alloc] init];
+    for (NSManagedObject *object in userInfo[NSInsertedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) {
+            [changedPlaces addObject:object];
+        } else if ([object isKindOfClass:[RTCPlacemark class]] && ((RTCPlacemark *)object).place) {
+            // a place geocoded by the background writer gets a new one
+            [changedPlaces addObject:((RTCPlacemark *)object).place];
+        }
+    }
+    // index by permanent ID so entries survive the next save
+    if ([changedPlaces count]) {
+        [self.managedObjectContext obtainPermanentIDsForObjects:[changedPlaces allObjects] error:NULL];
+    }
+
+    // edits here only matter if they touch the name or placemark, which
+    //   saves reading placemarks on every timestamp update
+    for (NSManagedObject *object in userInfo[NSUpdatedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) {
+            NSDictionary *changes = [object changedValuesForCurrentEvent];
+            if (changes[kPlaceNameKey] || changes[kPlacePlacemarkKey]) [changedPlaces addObject:object];
+        } else if ([object isKindOfClass:[RTCPlacemark class]] && ((RTCPlacemark *)object).place) {
+            [changedPlaces addObject:((RTCPlacemark *)object).place];
+        }
+    }
+
+    // saves merged in from the background writer (new places, geocoded
+    //   addresses) show up as refreshes with no record of what changed, as
+    //   does the sync log's pass over every place at open. So a place is only
+    //   reread if its name changed or it gained or lost a placemark; a
+    //   placemark that changed shows up here itself
+    for (NSManagedObject *object in userInfo[NSRefreshedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) {
+            if ([self isPlaceStale:(RTCPlace *)object]) [changedPlaces addObject:object];
+        } else if ([object isKindOfClass:[RTCPlacemark class]] && ((RTCPlacemark *)object).place) {
+            [changedPlaces addObject:((RTCPlacemark *)object).place];
+        }
+    }
+
+    for (RTCPlace *place in changedPlaces) {
+        [self.objectIDsChangedDuringRebuild addObject:place.objectID];
+        if ([place isDeleted]) continue;
+        [self indexPlace:place];
+    }
+}
+
+@end
@@ -0,0 +1,59 @@
+//
+//  RTCPlaceSnapshot.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/26/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreData/CoreData.h>
+#import <CoreLocation/CoreLocation.h>
+
+/**
+ * RTCPlaceSnapshot is the first kRTCPlaceSnapshotMaxPlaces rows of the places
+ * list, newest first, saved next to the places document so the list has
+ * something to show at launch while the document is still opening.
+ *
+ * The file is memory-mapped and read in place (see rtc::PlaceSnapshotView),
+ * so loading it costs next to nothing however many places there are. Rows are
+ * labels and dates only: there are no RTCPlace objects behind them until the
+ * document is open.
+ */
+@interface RTCPlaceSnapshot : NSObject
+
+#pragma mark - Properties
+/**
+ * Number of places in the snapshot
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+
+#pragma mark - Class Methods
+/**
+ * Map the snapshot saved at fileURL.
+ *
+ * @return nil if there is no snapshot or it is unreadable.
+ */
++ (instancetype)snapshotWithContentsOfURL:(NSURL *)fileURL;
+
+/**
+ * Save the first places of context's list as a snapshot.
+ *
+ * @return NO if the places couldn't be fetched or the file written.
+ */
++ (BOOL)writeSnapshotOfPlacesInManagedObjectContext:(NSManagedObjectContext *)context
+                                              toURL:(NSURL *)fileURL;
+
+
+#pragma mark - Instance Methods
+/**
+ * Place title, as the list shows it
+ */
+- (NSString *)titleAtIndex:(NSUInteger)index;
+
+- (NSDate *)creationDateAtIndex:(NSUInteger)index;
+
+- (CLLocationCoordinate2D)coordinateAtIndex:(NSUInteger)index;
+
+@end
@@ -0,0 +1,99 @@
+//
+//  RTCPlaceSnapshot.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/26/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCPlaceSnapshot.h"
+#import "RTCPlace.h"
+#import "RTCPlace+MKAnnotation.h"
+#include <sstream>
+#include "RTCPlaceListSnapshot.h"
+
+@interface RTCPlaceSnapshot () {
+    rtc::PlaceSnapshotView _view;
+}
+
+// the mapped file, which _view reads from
+@property (strong, nonatomic) NSData *data;
+
+@end
+
+
+@implementation RTCPlaceSnapshot
+
+#pragma mark - Properties
+- (NSUInteger)count
+{
+    return _view.size();
+}
+
+
+#pragma mark - Class Methods
+#pragma mark Public
++ (instancetype)snapshotWithContentsOfURL:(NSURL *)fileURL
+{
+    // mapped, so only the pages holding the first screen's rows are read in
+    NSData *data = [NSData dataWithContentsOfURL:fileURL options:NSDataReadingMappedIfSafe error:NULL];
+    if (!data) return nil;
+
+    RTCPlaceSnapshot *snapshot = [[RTCPlaceSnapshot alloc] init];
+    snapshot.data = data;
+    if (!snapshot->_view.open([data bytes], [data length])) return nil;
+    return snapshot;
+}
+
++ (BOOL)writeSnapshotOfPlacesInManagedObjectContext:(NSManagedObjectContext *)context
+                                              toURL:(NSURL *)fileURL
+{
+    // same order as the places list
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    request.sortDescriptors = @[[NSSortDescriptor sortDescriptorWithKey:@"creationDate" ascending:NO]];
+    request.fetchLimit = kRTCPlaceSnapshotMaxPlaces;
+
+    NSError *error = nil;
+    NSArray *places = [context executeFetchRequest:request error:&error];
+    if (!places) {
+        NSLog(@"[%@ %@] %@ (%@)", NSStringFromClass([self class]), NSStringFromSelector(_cmd), [error localizedDescription], [error localizedFailureReason]);
+        return NO;
+    }
+
+    std::vector<rtc::SnapshotPlace> snapshotPlaces;
+    snapshotPlaces.reserve([places count]);
+    for (RTCPlace *place in places) {
+        const char *title = [place.title UTF8String];
+        snapshotPlaces.push_back(rtc::SnapshotPlace(title ? title : "",
+                                                    rtc::GeoPoint([place.latitude doubleValue], [place.longitude doubleValue]),
+                                                    [place.creationDate timeIntervalSince1970]));
+    }
+
+    std::ostringstream output;
+    if (!rtc::writePlaceSnapshot(output, snapshotPlaces)) return NO;
+    std::string bytes = output.str();
+    return [[NSData dataWithBytes:bytes.data() length:bytes.size()] writeToURL:fileURL atomically:YES];
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Public
+- (NSString *)titleAtIndex:(NSUInteger)index
+{
+    size_t length = 0;
+    const char *bytes = _view.label(index, &length);
+    return [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+}
+
+- (NSDate *)creationDateAtIndex:(NSUInteger)index
+{
+    return [NSDate dateWithTimeIntervalSince1970:_view.creationDate(index)];
+}
+
+- (CLLocationCoordinate2D)coordinateAtIndex:(NSUInteger)index
+{
+    rtc::GeoPoint coordinate = _view.coordinate(index);
+    return CLLocationCoordinate2DMake(coordinate.latitude, coordinate.longitude);
+}
+
+@end
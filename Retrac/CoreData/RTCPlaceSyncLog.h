@@ -0,0 +1,80 @@
+//
+//  RTCPlaceSyncLog.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/31/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreData/CoreData.h>
+
+/**
+ * RTCPlaceSyncLog keeps saved places in step across a user's devices.
+ *
+ * It wraps the engine's place replica (see rtc::PlaceReplica): a log of every
+ * create, rename, delete and timeout change made on any device, keyed by each
+ * place's syncID. Changes made in the managed object context it was created
+ * for are added to the log as they happen, and the log is persisted to a file
+ * next to the places document shortly after.
+ *
+ * A sync is one POST to kRTCPlaceSyncServerURL of an encoded rtc::SyncMessage
+ * carrying the changes the server hasn't seen; the response is a SyncMessage
+ * with the changes this device hasn't. The server only relays changes, and
+ * every device that has seen the same ones ends up with the same places, so
+ * there are never conflicts to resolve. Changes from other devices are applied
+ * to the context, where they autosave with the document.
+ */
+@interface RTCPlaceSyncLog : NSObject
+
+#pragma mark - Properties
+/**
+ * Number of changes in the log, from every device
+ */
+@property (nonatomic, readonly) NSUInteger numChanges;
+
+/**
+ * Is a sync waiting on the server?
+ */
+@property (nonatomic, readonly, getter=isSyncing) BOOL syncing;
+
+
+#pragma mark - Initialization
+/**
+ * Load the log saved at fileURL, or start a new one for a new device ID with
+ * context's places.
+ *
+ * @param context   context whose RTCPlace objects are synced. Changes made in
+ *      this context are logged as they happen.
+ * @param fileURL   where the log is persisted
+ */
+- (instancetype)initWithManagedObjectContext:(NSManagedObjectContext *)context
+                                     fileURL:(NSURL *)fileURL;
+
+
+#pragma mark - Instance Methods
+/**
+ * Log places added to or renamed in the store past this log's context, e.g.
+ * by a bulk import.
+ */
+- (void)logChangesInStore;
+
+/**
+ * Send this device's new changes to kRTCPlaceSyncServerURL and apply the
+ * other devices'. Does nothing if a sync is already under way or syncing is
+ * turned off.
+ *
+ * @param completion
+ *      block called on the main queue with the number of places changed by
+ *      other devices
+ */
+- (void)syncWithCompletion:(void (^)(BOOL success, NSUInteger numPlacesChanged))completion;
+
+/**
+ * Write the log to its file if it has changed since it was last written.
+ *
+ * @return NO if the write failed.
+ */
+- (BOOL)saveLog;
+
+@end
@@ -0,0 +1,406 @@
+//
+//  RTCPlaceSyncLog.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/31/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCPlaceSyncLog.h"
+#import <CoreLocation/CoreLocation.h>
+#import "RTCPlace.h"
+#import "RTCWorkScheduler.h"
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include "RTCPlaceSync.h"
+
+#pragma mark - Constants
+// places read per batch while looking for changes in the store
+static const NSUInteger kStoreBatchSize = 500;
+
+// changes to these are logged
+static NSString *const kPlaceNameKey    = @"name";
+static NSString *const kPlaceTimeoutKey = @"timeout";
+
+
+@interface RTCPlaceSyncLog () {
+    std::unique_ptr<rtc::PlaceReplica> _replica;
+}
+
+@property (weak, nonatomic) NSManagedObjectContext *managedObjectContext;
+@property (strong, nonatomic) NSURL *fileURL;
+@property (strong, nonatomic) NSURLSession *session;
+
+@property (nonatomic, readwrite, getter=isSyncing) BOOL syncing;
+
+// has the log changed since it was last saved?
+@property (nonatomic) BOOL dirty;
+
+// pending save of the log, if one is scheduled
+@property (strong, nonatomic) RTCTimer *saveTimer;
+
+@end
+
+
+#pragma mark - Helpers
+static std::string stdString(NSString *string)
+{
+    const char *utf8 = [string UTF8String];
+    return utf8 ? std::string(utf8) : std::string();
+}
+
+/**
+ * @return NO if syncID isn't a UUID string
+ */
+static BOOL placeUUIDFromSyncID(NSString *syncID, rtc::PlaceUUID *uuid)
+{
+    NSUUID *nsuuid = syncID ? [[NSUUID alloc] initWithUUIDString:syncID] : nil;
+    if (!nsuuid) return NO;
+
+    uuid_t bytes;
+    [nsuuid getUUIDBytes:bytes];
+    *uuid = rtc::PlaceUUID::fromBytes(bytes);
+    return YES;
+}
+
+static NSString *syncIDFromPlaceUUID(const rtc::PlaceUUID &uuid)
+{
+    uuid_t bytes;
+    uuid.getBytes(bytes);
+    return [[[NSUUID alloc] initWithUUIDBytes:bytes] UUIDString];
+}
+
+static double recordDateFromDate(NSDate *date)
+{
+    return date ? [date timeIntervalSince1970] : rtc::kUnknownPlaceDate;
+}
+
+static NSDate *dateFromRecordDate(double seconds)
+{
+    return std::isnan(seconds) ? nil : [NSDate dateWithTimeIntervalSince1970:seconds];
+}
+
+static rtc::PlaceRecord placeRecordFromPlace(RTCPlace *place)
+{
+    rtc::PlaceRecord record;
+    record.name = stdString(place.name);
+    record.coordinate = rtc::GeoPoint([place.latitude doubleValue], [place.longitude doubleValue]);
+    record.horizontalAccuracy = place.horizontalAccuracy ? [place.horizontalAccuracy doubleValue] : -1.0;
+    record.creationDate = recordDateFromDate(place.creationDate);
+    record.locationTimestamp = recordDateFromDate(place.locationTimestamp);
+    return record;
+}
+
+/**
+ * Random ID for a device starting a new log
+ */
+static rtc::DeviceID newDeviceID()
+{
+    rtc::DeviceID device = 0;
+    while (!device) arc4random_buf(&device, sizeof(device));
+    return device;
+}
+
+
+@implementation RTCPlaceSyncLog
+
+#pragma mark - Properties
+- (NSUInteger)numChanges
+{
+    return _replica->numOps();
+}
+
+
+#pragma mark - Initialization
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"RTCPlaceSyncLog"
+                                   reason:@"Use - [RTCPlaceSyncLog initWithManagedObjectContext:fileURL:]"
+                                 userInfo:nil];
+    return nil;
+}
+
+- (instancetype)initWithManagedObjectContext:(NSManagedObjectContext *)context
+                                     fileURL:(NSURL *)fileURL
+{
+    self = [super init];
+    if (self) {
+        _managedObjectContext = context;
+        _fileURL = fileURL;
+
+        // a missing or unreadable log means starting over as a new device, so
+        //   no one else's log is ever continued
+        if (![self loadLog]) {
+            _replica.reset(new rtc::PlaceReplica(newDeviceID(), rtc::SystemClock::sharedClock()));
+            self.dirty = YES;
+        }
+        [self logChangesInStore];
+        // the new device ID in particular must stick
+        [self scheduleSaveLog];
+
+        NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+        configuration.timeoutIntervalForRequest = kRTCPlaceSyncTimeout;
+        _session = [NSURLSession sessionWithConfiguration:configuration];
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(contextObjectsDidChange:)
+                                                     name:NSManagedObjectContextObjectsDidChangeNotification
+                                                   object:context];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [_saveTimer cancel];
+    [_session invalidateAndCancel];
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Public
+- (void)logChangesInStore
+{
+    // a place missing from the store isn't logged as deleted: it may be one
+    //   merged from another device that didn't make it into the store
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    request.fetchBatchSize = kStoreBatchSize;
+    NSArray *places = [self.managedObjectContext executeFetchRequest:request error:NULL];
+
+    for (NSUInteger start = 0; start < [places count]; start += kStoreBatchSize) {
+        @autoreleasepool {
+            NSUInteger end = MIN(start + kStoreBatchSize, [places count]);
+            for (NSUInteger i = start; i < end; ++i) {
+                RTCPlace *place = places[i];
+                [self logPlace:place];
+                if (![place hasChanges]) [self.managedObjectContext refreshObject:place mergeChanges:NO];
+            }
+        }
+    }
+}
+
+- (void)syncWithCompletion:(void (^)(BOOL success, NSUInteger numPlacesChanged))completion
+{
+    NSURL *url = [kRTCPlaceSyncServerURL length] ? [NSURL URLWithString:kRTCPlaceSyncServerURL] : nil;
+    if (!url || self.syncing) {
+        if (completion) completion(NO, 0);
+        return;
+    }
+
+    rtc::SyncMessage message;
+    _replica->syncRequest(&message);
+    std::string bytes;
+    rtc::encodeSyncMessage(message, bytes);
+
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:url];
+    request.HTTPMethod = @"POST";
+    request.HTTPBody = [NSData dataWithBytes:bytes.data() length:bytes.size()];
+    [request setValue:@"application/octet-stream" forHTTPHeaderField:@"Content-Type"];
+
+    self.syncing = YES;
+    NSURLSessionDataTask *task = [self.session dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        // decoding a large response is the slow part, so it stays off the
+        //   main queue
+        BOOL success = !error && ([(NSHTTPURLResponse *)response statusCode] == 200);
+        std::shared_ptr<rtc::SyncMessage> reply(new rtc::SyncMessage());
+        if (success) success = rtc::decodeSyncMessage((const char *)[data bytes], [data length], reply.get());
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            self.syncing = NO;
+            NSUInteger numPlacesChanged = 0;
+            if (success && self.managedObjectContext) {
+                // the server's version is remembered even if nothing merged
+                std::vector<rtc::PlaceUUID> changed;
+                _replica->mergeSyncResponse(*reply, &changed);
+                self.dirty = YES;
+                numPlacesChanged = [self applyChangedPlaces:changed];
+                [self saveLog];
+            }
+            if (completion) completion(success, numPlacesChanged);
+        });
+    }];
+    [task resume];
+}
+
+- (BOOL)saveLog
+{
+    [self.saveTimer cancel];
+    self.saveTimer = nil;
+    if (!self.dirty) return YES;
+
+    std::ostringstream output;
+    if (!_replica->write(output)) return NO;
+    std::string bytes = output.str();
+    if (![[NSData dataWithBytes:bytes.data() length:bytes.size()] writeToURL:self.fileURL atomically:YES]) return NO;
+
+    self.dirty = NO;
+    return YES;
+}
+
+
+#pragma mark Private
+/**
+ * Save the log shortly, along with any changes made in the meantime. A log
+ * that isn't saved is started over as a new device at the next launch.
+ */
+- (void)scheduleSaveLog
+{
+    if (!self.dirty || self.saveTimer) return;
+    __weak RTCPlaceSyncLog *weakSelf = self;
+    self.saveTimer = [[RTCWorkScheduler sharedScheduler] performBlock:^{ [weakSelf saveLog]; }
+                                                              onQueue:[RTCWorkQueue mainQueue]
+                                                           afterDelay:kRTCPlaceSyncLogSaveDelay];
+}
+
+/**
+ * @return NO if there is no usable saved log.
+ */
+- (BOOL)loadLog
+{
+    NSString *path = [self.fileURL path];
+    if (!path) return NO;
+
+    std::ifstream input([path fileSystemRepresentation], std::ios::binary);
+    _replica.reset(new rtc::PlaceReplica(0, rtc::SystemClock::sharedClock()));
+    return input && _replica->read(input);
+}
+
+/**
+ * Log whatever about place differs from the log: a create for a place it
+ * hasn't seen, then a rename and timeout change for one it has. Changes
+ * applied from other devices match the log already, so aren't logged again.
+ */
+- (void)logPlace:(RTCPlace *)place
+{
+    rtc::PlaceUUID uuid;
+    if (!placeUUIDFromSyncID(place.syncID, &uuid)) return;
+
+    const rtc::SyncedPlace *synced = _replica->place(uuid);
+    int32_t timeout = [place.timeout intValue];
+    if (!synced) {
+        _replica->create(uuid, placeRecordFromPlace(place), timeout);
+        self.dirty = YES;
+        return;
+    }
+    if (!synced->isLive()) return;
+
+    std::string name = stdString(place.name);
+    if (synced->record.name != name) {
+        _replica->rename(uuid, name);
+        self.dirty = YES;
+    }
+    if (synced->timeout != timeout) {
+        _replica->setTimeout(uuid, timeout);
+        self.dirty = YES;
+    }
+}
+
+- (void)logDeletedPlace:(RTCPlace *)place
+{
+    rtc::PlaceUUID uuid;
+    if (!placeUUIDFromSyncID(place.syncID, &uuid)) return;
+
+    const rtc::SyncedPlace *synced = _replica->place(uuid);
+    if (synced && synced->isLive()) {
+        _replica->remove(uuid);
+        self.dirty = YES;
+    }
+}
+
+/**
+ * Bring the context's places in line with the log after merging other
+ * devices' changes.
+ *
+ * @return the number of places inserted, updated or deleted.
+ */
+- (NSUInteger)applyChangedPlaces:(const std::vector<rtc::PlaceUUID> &)changed
+{
+    if (changed.empty()) return 0;
+
+    NSMutableArray *syncIDs = [[NSMutableArray alloc] initWithCapacity:changed.size()];
+    for (size_t i = 0; i < changed.size(); ++i) [syncIDs addObject:syncIDFromPlaceUUID(changed[i])];
+
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    request.predicate = [NSPredicate predicateWithFormat:@"syncID IN %@", syncIDs];
+    NSArray *places = [self.managedObjectContext executeFetchRequest:request error:NULL];
+    NSMutableDictionary *placesBySyncID = [[NSMutableDictionary alloc] initWithCapacity:[places count]];
+    for (RTCPlace *place in places) placesBySyncID[place.syncID] = place;
+
+    NSUInteger numApplied = 0;
+    for (size_t i = 0; i < changed.size(); ++i) {
+        const rtc::SyncedPlace *synced = _replica->place(changed[i]);
+        RTCPlace *place = placesBySyncID[syncIDs[i]];
+
+        if (!synced || !synced->isLive()) {
+            if (place) {
+                [self.managedObjectContext deleteObject:place];
+                numApplied++;
+            }
+            continue;
+        }
+
+        if (!place) {
+            place = [NSEntityDescription insertNewObjectForEntityForName:@"RTCPlace"
+                                                  inManagedObjectContext:self.managedObjectContext];
+            place.syncID = syncIDs[i];
+            place.latitude = @(synced->record.coordinate.latitude);
+            place.longitude = @(synced->record.coordinate.longitude);
+            place.horizontalAccuracy = @(synced->record.horizontalAccuracy);
+            place.locationTimestamp = dateFromRecordDate(synced->record.locationTimestamp);
+            place.creationDate = dateFromRecordDate(synced->record.creationDate) ?: [NSDate date];
+        }
+        NSString *name = [NSString stringWithUTF8String:synced->record.name.c_str()];
+        if (![place.name isEqualToString:name]) place.name = name;
+        if ([place.timeout intValue] != synced->timeout) place.timeout = @(synced->timeout);
+        numApplied++;
+    }
+    return numApplied;
+}
+
+
+#pragma mark - Notification Observer Methods
+/**
+ * Log inserts, renames, timeout changes and deletes in our context
+ */
+- (void)contextObjectsDidChange:(NSNotification *)notification
+{
+    NSDictionary *userInfo = [notification userInfo];
+
+    // the context was reset under us, so compare against the whole store
+    if (userInfo[NSInvalidatedAllObjectsKey]) {
+        [self logChangesInStore];
+        [self scheduleSaveLog];
+        return;
+    }
+
+    for (NSManagedObject *object in userInfo[NSDeletedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) [self logDeletedPlace:(RTCPlace *)object];
+    }
+
+    NSMutableSet *changedPlaces = [[NSMutableSet alloc] init];
+    for (NSManagedObject *object in userInfo[NSInsertedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) [changedPlaces addObject:object];
+    }
+    for (NSManagedObject *object in userInfo[NSUpdatedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) {
+            NSDictionary *changes = [object changedValuesForCurrentEvent];
+            if (changes[kPlaceNameKey] || changes[kPlaceTimeoutKey]) [changedPlaces addObject:object];
+        }
+    }
+    // places saved by the background writer arrive as refreshes
+    for (NSManagedObject *object in userInfo[NSRefreshedObjectsKey]) {
+        if ([object isKindOfClass:[RTCPlace class]]) [changedPlaces addObject:object];
+    }
+
+    for (RTCPlace *place in changedPlaces) {
+        if ([place isDeleted]) continue;
+        [self logPlace:place];
+    }
+    [self scheduleSaveLog];
+}
+
+@end
@@ -0,0 +1,25 @@
+//
+//  RTCPlacemark.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/12/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreData/CoreData.h>
+#import <CoreLocation/CoreLocation.h>
+
+@class RTCPlace;
+
+/**
+ * RTCPlacemark holds a place's archived CLPlacemark apart from the place
+ * itself, so fetching places never unarchives placemarks. Use
+ * RTCPlace.placemark rather than this directly.
+ */
+@interface RTCPlacemark : NSManagedObject
+
+@property (nonatomic, retain) CLPlacemark * placemark;
+@property (nonatomic, retain) RTCPlace *place;
+
+@end
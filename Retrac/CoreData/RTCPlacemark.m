@@ -0,0 +1,18 @@
+//
+//  RTCPlacemark.m
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/12/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCPlacemark.h"
+#import "RTCPlace.h"
+
+
+@implementation RTCPlacemark
+
+@dynamic placemark;
+@dynamic place;
+
+@end
@@ -0,0 +1,159 @@
+//
+//  RTCAccuracyReplay.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/24/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCAccuracyReplay.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "RTCTrace.h"
+
+namespace rtc {
+
+typedef AccuracyScheduler::Completion Completion;
+
+#pragma mark - LocationPowerModel
+LocationPowerModel::LocationPowerModel()
+    : initialAccuracyFactor(3.0), fixInterval(1.0)
+{
+    // cell, cell, Wi-Fi, GPS, GPS
+    const double levelPower[AccuracyLevelCount]     = {0.03, 0.03, 0.12, 0.40, 0.45};
+    const double levelDelay[AccuracyLevelCount]     = {1.0, 1.0, 2.0, 8.0, 8.0};
+    const double levelAccuracy[AccuracyLevelCount]  = {1500.0, 800.0, 65.0, 10.0, 5.0};
+    const double levelSettle[AccuracyLevelCount]    = {1.0, 1.0, 2.0, 6.0, 10.0};
+    std::copy(levelPower, levelPower + AccuracyLevelCount, power);
+    std::copy(levelDelay, levelDelay + AccuracyLevelCount, firstFixDelay);
+    std::copy(levelAccuracy, levelAccuracy + AccuracyLevelCount, accuracy);
+    std::copy(levelSettle, levelSettle + AccuracyLevelCount, settleTime);
+}
+
+
+#pragma mark - Helpers
+static bool isGPSLevel(int level)
+{
+    return level >= AccuracyLevelNearestTenMeters;
+}
+
+/**
+ * Accuracy of the fix the provider has at time t, infinity if none yet. Every
+ * level up to the current one contributes, each timed from when it was turned
+ * on; the GPS levels share one receiver.
+ *
+ * @param levelOnSince  when each level was turned on, infinity if it isn't
+ */
+static double simulatedAccuracy(const LocationPowerModel &model, const double *levelOnSince,
+                                AccuracyLevel level, bool indoors, double t)
+{
+    double gpsOnSince = std::numeric_limits<double>::infinity();
+    for (int l = AccuracyLevelNearestTenMeters; l <= level; ++l) gpsOnSince = std::min(gpsOnSince, levelOnSince[l]);
+
+    double best = std::numeric_limits<double>::infinity();
+    for (int l = AccuracyLevelThreeKilometers; l <= level; ++l) {
+        if (isGPSLevel(l) && indoors) continue;
+        double since = t - (isGPSLevel(l) ? gpsOnSince : levelOnSince[l]) - model.firstFixDelay[l];
+        if (since < 0) continue;
+        double factor = 1.0 + (model.initialAccuracyFactor - 1.0) * std::exp(-since / model.settleTime[l]);
+        best = std::min(best, model.accuracy[l] * factor);
+    }
+    return best;
+}
+
+
+#pragma mark - Replay
+AccuracyReplaySummary replayLocationRequests(const std::vector<SimulatedLocationRequest> &requests,
+                                             const AccuracySchedulerPolicy &policy,
+                                             const LocationPowerModel &model)
+{
+    AccuracyReplaySummary summary;
+    if (requests.empty()) return summary;
+
+    const double never = std::numeric_limits<double>::infinity();
+    ManualClock clock(requests[0].time);
+    AccuracyScheduler scheduler(clock, policy);
+
+    std::vector<double> requestTimes;       // by request ID - 1
+    std::vector<double> latencies;
+    double accuracySum = 0;
+    unsigned numFixed = 0;
+
+    double levelOnSince[AccuracyLevelCount];
+    std::fill(levelOnSince, levelOnSince + AccuracyLevelCount, never);
+    AccuracyLevel level = AccuracyLevelThreeKilometers;
+    bool acquiring = false;
+    bool indoors = false;
+    double nextFixTime = never;
+    double lastAccuracy = never;
+    double t = requests[0].time;
+    size_t next = 0;
+
+    while ((next < requests.size()) || scheduler.acquiring()) {
+        // whichever comes first: a request, the timeout or the next fix
+        double nextRequestTime = (next < requests.size()) ? requests[next].time : never;
+        double until = std::min(nextRequestTime, scheduler.acquiring() ? std::min(scheduler.deadline(), nextFixTime) : never);
+
+        if (acquiring) {
+            summary.energy += model.power[level] * (until - t);
+            if (isGPSLevel(level)) summary.gpsTime += until - t;
+        }
+        t = until;
+        clock.setNow(t);
+
+        std::vector<Completion> completed;
+        if (nextRequestTime <= t) {
+            indoors = requests[next].indoors;
+            requestTimes.push_back(t);
+            scheduler.addRequest(requests[next].request, completed);
+            ++next;
+        } else if (scheduler.deadline() <= t) {
+            scheduler.handleTimeout(completed);
+        } else {
+            // like CoreLocation, only report a fix that has changed
+            double accuracy = std::floor(simulatedAccuracy(model, levelOnSince, level, indoors, t));
+            if ((accuracy < never) && (accuracy != lastAccuracy)) {
+                scheduler.processFix(LocationFix(t, 0, 0, accuracy), completed);
+                lastAccuracy = accuracy;
+            }
+            nextFixTime = t + model.fixInterval;
+        }
+
+        for (size_t i = 0; i < completed.size(); ++i) {
+            const Completion &completion = completed[i];
+            const SimulatedLocationRequest &request = requests[completion.requestID - 1];
+            latencies.push_back(t - requestTimes[completion.requestID - 1]);
+            if (completion.fromCache) ++summary.numFromCache;
+            if (!completion.hasFix) continue;
+            ++numFixed;
+            accuracySum += completion.fix.horizontalAccuracy;
+            if (completion.fix.horizontalAccuracy <= request.request.accuracy) ++summary.numSatisfied;
+        }
+
+        // the host turns the provider on, off or up to match
+        if (scheduler.acquiring() && !acquiring) {
+            std::fill(levelOnSince, levelOnSince + AccuracyLevelCount, never);
+            for (int l = AccuracyLevelThreeKilometers; l <= scheduler.level(); ++l) levelOnSince[l] = t;
+            nextFixTime = t + model.fixInterval;
+            lastAccuracy = never;
+        } else if (scheduler.acquiring()) {
+            for (int l = level + 1; l <= scheduler.level(); ++l) levelOnSince[l] = t;
+        }
+        acquiring = scheduler.acquiring();
+        level = scheduler.level();
+    }
+
+    summary.numRequests = (unsigned)requests.size();
+    summary.numAcquisitions = scheduler.numAcquisitions();
+
+    double sum = 0;
+    for (size_t i = 0; i < latencies.size(); ++i) sum += latencies[i];
+    std::sort(latencies.begin(), latencies.end());
+    summary.meanLatency = latencies.empty() ? 0 : sum / latencies.size();
+    summary.p90Latency = percentile(latencies, 0.9);
+    summary.meanAccuracy = numFixed ? accuracySum / numFixed : 0;
+    return summary;
+}
+
+} // namespace rtc
@@ -0,0 +1,91 @@
+//
+//  RTCAccuracyReplay.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/24/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCAccuracyReplay_h
+#define Retrac_RTCAccuracyReplay_h
+
+#include <vector>
+#include "RTCAccuracyScheduler.h"
+
+namespace rtc {
+
+/**
+ * LocationPowerModel is a rough stand-in for the location provider: what each
+ * accuracy level costs, how soon it has a fix and how good that fix gets.
+ * Cell and Wi-Fi levels only aim so high; the two finest levels are the GPS,
+ * which can't see the sky indoors and gives nothing better than Wi-Fi there
+ * while still drawing its power. A level's fixes start out
+ * initialAccuracyFactor times worse than its settled accuracy and close in on
+ * it with time constant settleTime. Like CoreLocation, the provider only
+ * reports a fix when it has changed.
+ *
+ * The defaults are ballpark figures for a 2014 iPhone.
+ */
+struct LocationPowerModel {
+    double power[AccuracyLevelCount];           // watts while updating at the level
+    double firstFixDelay[AccuracyLevelCount];   // seconds till the level's first fix
+    double accuracy[AccuracyLevelCount];        // meters the level's fixes settle at
+    double settleTime[AccuracyLevelCount];      // seconds
+    double initialAccuracyFactor;
+    double fixInterval;                         // seconds between measurements
+
+    LocationPowerModel();
+};
+
+/**
+ * SimulatedLocationRequest is one caller asking for a location
+ */
+struct SimulatedLocationRequest {
+    double time;                // seconds since start
+    AccuracyScheduler::Request request;
+    bool indoors;               // no GPS till the next request
+
+    SimulatedLocationRequest() : time(0), indoors(false) {}
+    SimulatedLocationRequest(double t, const AccuracyScheduler::Request &aRequest, bool isIndoors)
+        : time(t), request(aRequest), indoors(isIndoors) {}
+};
+
+/**
+ * Outcome of replaying requests. Latency is from a request till it was
+ * answered, cached answers included.
+ */
+struct AccuracyReplaySummary {
+    unsigned numRequests;
+    unsigned numSatisfied;      // answered with a fix as accurate as asked for
+    unsigned numFromCache;
+    unsigned numAcquisitions;
+    double meanLatency;
+    double p90Latency;
+    double meanAccuracy;        // of the fixes handed out
+    double energy;              // joules spent by the provider
+    double gpsTime;             // seconds spent at a GPS level
+
+    AccuracyReplaySummary()
+        : numRequests(0), numSatisfied(0), numFromCache(0), numAcquisitions(0), meanLatency(0),
+          p90Latency(0), meanAccuracy(0), energy(0), gpsTime(0) {}
+
+    double satisfiedRate() const { return numRequests ? (double)numSatisfied / numRequests : 0.0; }
+};
+
+/**
+ * Replay requests through a fresh AccuracyScheduler running on virtual time,
+ * with model standing in for the provider.
+ *
+ * @param requests  in time order
+ * @param policy    scheduler knobs
+ * @param model     provider costs and behavior
+ */
+AccuracyReplaySummary replayLocationRequests(const std::vector<SimulatedLocationRequest> &requests,
+                                             const AccuracySchedulerPolicy &policy = AccuracySchedulerPolicy(),
+                                             const LocationPowerModel &model = LocationPowerModel());
+
+} // namespace rtc
+
+#endif
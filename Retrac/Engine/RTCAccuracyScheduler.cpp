@@ -0,0 +1,226 @@
+//
+//  RTCAccuracyScheduler.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/24/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCAccuracyScheduler.h"
+#include <algorithm>
+#include <limits>
+
+namespace rtc {
+
+#pragma mark - Constants
+// what CoreLocation aims for at each level, cheapest first
+static const double kNominalAccuracies[AccuracyLevelCount] = {3000.0, 1000.0, 100.0, 10.0, 0.0};
+
+
+#pragma mark - Levels
+double nominalAccuracy(AccuracyLevel level)
+{
+    return kNominalAccuracies[level];
+}
+
+AccuracyLevel levelForAccuracy(double accuracy)
+{
+    for (int level = AccuracyLevelThreeKilometers; level < AccuracyLevelBest; ++level) {
+        if (kNominalAccuracies[level] <= accuracy) return (AccuracyLevel)level;
+    }
+    return AccuracyLevelBest;
+}
+
+
+#pragma mark - AccuracyScheduler
+AccuracyScheduler::AccuracyScheduler(const Clock &clock, const AccuracySchedulerPolicy &policy)
+    : _clock(clock), _policy(policy), _fixEngine(clock, policy.fix), _nextRequestID(1),
+      _acquiring(false), _level(policy.initialLevel), _levelStart(0), _improvedAtLevel(false),
+      _levelSettled(false), _hasCachedFix(false), _numAcquisitions(0), _numCacheHits(0)
+{
+}
+
+AccuracyScheduler::RequestID AccuracyScheduler::addRequest(const Request &request, std::vector<Completion> &completed)
+{
+    RequestID requestID = _nextRequestID++;
+
+    // a recent enough fix saves turning the provider on at all
+    double maxAge = std::min(request.maxAge, _policy.maxCacheAge);
+    if (_hasCachedFix && (_cachedFix.horizontalAccuracy <= request.accuracy) &&
+        (_clock.now() - _cachedFix.timestamp <= maxAge)) {
+        completed.push_back(Completion(requestID, true, _cachedFix, true));
+        ++_numCacheHits;
+        return requestID;
+    }
+
+    _pending.push_back(PendingRequest(requestID, request));
+    if (!_acquiring) {
+        startAcquisition();
+        return requestID;
+    }
+
+    // join the acquisition under way, holding out for this caller if they're
+    // pickier than everyone else
+    LocationFixPolicy fixPolicy = _fixEngine.policy();
+    fixPolicy.accuracyThreshold = targetAccuracy();
+    _fixEngine.setPolicy(fixPolicy);
+    completeSatisfied(completed);
+    return requestID;
+}
+
+void AccuracyScheduler::processFix(const LocationFix &fix, std::vector<Completion> &completed)
+{
+    if ((fix.horizontalAccuracy >= 0) && (!_hasCachedFix || (fix.timestamp >= _cachedFix.timestamp))) {
+        _cachedFix = fix;
+        _hasCachedFix = true;
+    }
+    if (!_acquiring) return;
+
+    bool isNewBest = false;
+    LocationFixEngine::Action action = _fixEngine.processFix(fix, &isNewBest);
+    if (isNewBest) {
+        _improvedAtLevel = true;
+        completeSatisfied(completed);
+    }
+
+    if ((action == LocationFixEngine::ActionFinish) || _pending.empty()) {
+        finishAcquisition(completed);
+        return;
+    }
+
+    // this level has done all it can
+    if (isNewBest && (fix.horizontalAccuracy <= nominalAccuracy(_level))) moveUp();
+}
+
+void AccuracyScheduler::handleTimeout(std::vector<Completion> &completed)
+{
+    if (!_acquiring) return;
+
+    // a level that is still getting better (or hasn't produced anything) is
+    // worth trying the next one up for; one that has stopped isn't
+    double now = _clock.now();
+    if (!_levelSettled && (_level < maxLevel()) && (now >= _levelStart + _policy.levelWaitTime)) {
+        if (_improvedAtLevel || !_fixEngine.hasBestFix()) {
+            moveUp();
+        } else {
+            _levelSettled = true;
+        }
+        return;
+    }
+
+    if (now >= finishDeadline()) {
+        _fixEngine.handleTimeout();
+        finishAcquisition(completed);
+    }
+}
+
+void AccuracyScheduler::finish(std::vector<Completion> &completed)
+{
+    if (!_acquiring) return;
+    _fixEngine.finish(LocationFixEngine::FinishReasonCancelled);
+    finishAcquisition(completed);
+}
+
+double AccuracyScheduler::deadline() const
+{
+    if (!_acquiring) return std::numeric_limits<double>::infinity();
+
+    double deadline = finishDeadline();
+    if (!_levelSettled && (_level < maxLevel())) deadline = std::min(deadline, _levelStart + _policy.levelWaitTime);
+    return deadline;
+}
+
+double AccuracyScheduler::timeoutDelay() const
+{
+    double delay = deadline() - _clock.now();
+    return (delay > 0) ? delay : 0;
+}
+
+/**
+ * Accuracy the pickiest pending caller wants
+ */
+double AccuracyScheduler::targetAccuracy() const
+{
+    double accuracy = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < _pending.size(); ++i) accuracy = std::min(accuracy, _pending[i].request.accuracy);
+    return accuracy;
+}
+
+/**
+ * When the acquisition gives up on a better fix. A level just moved up to gets
+ * policy.levelWaitTime to improve on the fix, however soon the fix engine
+ * would have given up: a GPS takes longer to its first fix than Wi-Fi.
+ */
+double AccuracyScheduler::finishDeadline() const
+{
+    double deadline = _fixEngine.deadline();
+    if (!_improvedAtLevel && !_levelSettled) deadline = std::max(deadline, _levelStart + _policy.levelWaitTime);
+    return deadline;
+}
+
+/**
+ * Highest level worth going to for the pending callers
+ */
+AccuracyLevel AccuracyScheduler::maxLevel() const
+{
+    return levelForAccuracy(targetAccuracy());
+}
+
+void AccuracyScheduler::startAcquisition()
+{
+    _acquiring = true;
+    ++_numAcquisitions;
+
+    LocationFixPolicy fixPolicy = _policy.fix;
+    fixPolicy.accuracyThreshold = targetAccuracy();
+    _fixEngine.setPolicy(fixPolicy);
+    _fixEngine.start();
+
+    _level = std::min(_policy.initialLevel, maxLevel());
+    _levelStart = _clock.now();
+    _improvedAtLevel = false;
+    _levelSettled = false;
+}
+
+void AccuracyScheduler::moveUp()
+{
+    if (_level >= maxLevel()) return;
+    _level = (AccuracyLevel)(_level + 1);
+    _levelStart = _clock.now();
+    _improvedAtLevel = false;
+}
+
+/**
+ * Answer every pending caller the best fix so far is good enough for
+ */
+void AccuracyScheduler::completeSatisfied(std::vector<Completion> &completed)
+{
+    if (!_fixEngine.hasBestFix()) return;
+
+    const LocationFix &best = _fixEngine.bestFix();
+    for (std::vector<PendingRequest>::iterator it = _pending.begin(); it != _pending.end(); ) {
+        if (best.horizontalAccuracy <= it->request.accuracy) {
+            completed.push_back(Completion(it->requestID, true, best, false));
+            it = _pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/**
+ * Stop acquiring and answer everyone left with the best fix so far
+ */
+void AccuracyScheduler::finishAcquisition(std::vector<Completion> &completed)
+{
+    _fixEngine.finish(LocationFixEngine::FinishReasonCancelled);
+
+    bool hasFix = _fixEngine.hasBestFix();
+    for (size_t i = 0; i < _pending.size(); ++i) {
+        completed.push_back(Completion(_pending[i].requestID, hasFix, _fixEngine.bestFix(), false));
+    }
+    _pending.clear();
+    _acquiring = false;
+}
+
+} // namespace rtc
@@ -0,0 +1,219 @@
+//
+//  RTCAccuracyScheduler.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/24/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCAccuracyScheduler_h
+#define Retrac_RTCAccuracyScheduler_h
+
+#include <cstddef>
+#include <vector>
+#include "RTCClock.h"
+#include "RTCLocationFixEngine.h"
+
+namespace rtc {
+
+/**
+ * How hard the location provider is asked to work, cheapest first. Each maps
+ * to the CLLocationAccuracy of the same name.
+ */
+enum AccuracyLevel {
+    AccuracyLevelThreeKilometers,
+    AccuracyLevelKilometer,
+    AccuracyLevelHundredMeters,
+    AccuracyLevelNearestTenMeters,
+    AccuracyLevelBest,
+    AccuracyLevelCount
+};
+
+/**
+ * Accuracy (meters) the provider aims for at level, 0 for the best it can do
+ */
+double nominalAccuracy(AccuracyLevel level);
+
+/**
+ * Cheapest level that aims for accuracy (meters) or better
+ */
+AccuracyLevel levelForAccuracy(double accuracy);
+
+/**
+ * AccuracySchedulerPolicy holds the knobs that trade power for latency. The
+ * default values mirror the location settings in RTCConstants.m
+ */
+struct AccuracySchedulerPolicy {
+    LocationFixPolicy fix;      // best-fix rules, accuracyThreshold aside
+    AccuracyLevel initialLevel; // most an acquisition starts at
+    double levelWaitTime;       // kRTCLocationMaxWaitTimeAtLevel
+    double maxCacheAge;         // kRTCLocationCacheMaxAge
+
+    AccuracySchedulerPolicy()
+        : initialLevel(AccuracyLevelHundredMeters), levelWaitTime(10.0), maxCacheAge(60.0) {}
+};
+
+/**
+ * AccuracyScheduler decides how to get each caller a location as cheaply as
+ * it will do. Like LocationFixEngine (which it runs for the best-fix rules) it
+ * owns no timers or hardware: the host sets the provider's accuracy to level()
+ * while acquiring(), schedules a timeout at deadline() and feeds every fix in.
+ *
+ * - A caller whose accuracy and maximum age the last fix meets gets it back
+ *   right away, without turning the provider on.
+ * - Otherwise it joins the acquisition under way, or starts one. Each caller
+ *   is answered as soon as the best fix is good enough for it, and everyone
+ *   left gets the best fix when the acquisition finishes.
+ * - An acquisition starts at the cheaper of policy.initialLevel and the level
+ *   the pickiest caller needs. A fix as good as the level aims for moves it up
+ *   a level right away; so does policy.levelWaitTime at a level that is still
+ *   improving the fix. A level that has stopped improving it is as high as it
+ *   goes.
+ * - Each level gets policy.levelWaitTime to improve on the fix before the
+ *   acquisition gives up, so a GPS that was just turned on has time for its
+ *   first fix. After that the usual LocationFixEngine rules decide.
+ */
+class AccuracyScheduler {
+public:
+    typedef unsigned RequestID;
+
+    /**
+     * What a caller will settle for
+     */
+    struct Request {
+        double accuracy;        // meters
+        double maxAge;          // seconds old a cached fix may be
+
+        Request() : accuracy(0), maxAge(0) {}
+        Request(double anAccuracy, double aMaxAge) : accuracy(anAccuracy), maxAge(aMaxAge) {}
+    };
+
+    /**
+     * A caller's answer. The fix may be worse than they asked for if that's
+     * the best the acquisition got.
+     */
+    struct Completion {
+        RequestID requestID;
+        bool hasFix;
+        LocationFix fix;
+        bool fromCache;
+
+        Completion() : requestID(0), hasFix(false), fromCache(false) {}
+        Completion(RequestID anID, bool aHasFix, const LocationFix &aFix, bool aFromCache)
+            : requestID(anID), hasFix(aHasFix), fix(aFix), fromCache(aFromCache) {}
+    };
+
+    /**
+     * @param clock     time source, must outlive the scheduler
+     * @param policy    power/latency knobs
+     */
+    explicit AccuracyScheduler(const Clock &clock,
+                               const AccuracySchedulerPolicy &policy = AccuracySchedulerPolicy());
+
+    const AccuracySchedulerPolicy &policy() const { return _policy; }
+
+    /**
+     * Ask for a location.
+     *
+     * @param completed     the request's completion is appended here if the
+     *                      cached or best fix so far already meets it
+     *
+     * @return ID the request's completion will carry.
+     */
+    RequestID addRequest(const Request &request, std::vector<Completion> &completed);
+
+    /**
+     * Feed a fix from the provider. Fixes that arrive while idle (e.g. from a
+     * trail recording) still refresh the cache.
+     *
+     * @param completed     completions of requests this fix answered
+     */
+    void processFix(const LocationFix &fix, std::vector<Completion> &completed);
+
+    /**
+     * Host's timeout fired. Moves up a level or finishes the acquisition.
+     */
+    void handleTimeout(std::vector<Completion> &completed);
+
+    /**
+     * Finish the acquisition early (e.g. location services denied), answering
+     * everyone with the best fix so far.
+     */
+    void finish(std::vector<Completion> &completed);
+
+    bool acquiring() const { return _acquiring; }
+
+    /**
+     * Level the provider should be at, only meaningful while acquiring()
+     */
+    AccuracyLevel level() const { return _level; }
+
+    /**
+     * Absolute time at which the host should call `handleTimeout()`, infinity
+     * if not acquiring
+     */
+    double deadline() const;
+
+    /**
+     * Seconds from now till the deadline, never negative.
+     */
+    double timeoutDelay() const;
+
+    size_t numPendingRequests() const { return _pending.size(); }
+
+    /**
+     * Best fix of the current (or last) acquisition
+     */
+    bool hasBestFix() const { return _fixEngine.hasBestFix(); }
+    const LocationFix &bestFix() const { return _fixEngine.bestFix(); }
+
+    bool hasCachedFix() const { return _hasCachedFix; }
+    const LocationFix &cachedFix() const { return _cachedFix; }
+
+    /**
+     * Number of acquisitions started, and requests answered from the cache
+     */
+    unsigned numAcquisitions() const { return _numAcquisitions; }
+    unsigned numCacheHits() const { return _numCacheHits; }
+
+private:
+    struct PendingRequest {
+        RequestID requestID;
+        Request request;
+
+        PendingRequest(RequestID anID, const Request &aRequest) : requestID(anID), request(aRequest) {}
+    };
+
+    double targetAccuracy() const;
+    double finishDeadline() const;
+    AccuracyLevel maxLevel() const;
+    void startAcquisition();
+    void moveUp();
+    void completeSatisfied(std::vector<Completion> &completed);
+    void finishAcquisition(std::vector<Completion> &completed);
+
+    const Clock &_clock;
+    AccuracySchedulerPolicy _policy;
+    LocationFixEngine _fixEngine;
+
+    std::vector<PendingRequest> _pending;
+    RequestID _nextRequestID;
+
+    bool _acquiring;
+    AccuracyLevel _level;
+    double _levelStart;
+    bool _improvedAtLevel;      // has this level produced a new best fix?
+    bool _levelSettled;         // stopped improving, so no higher level
+
+    bool _hasCachedFix;
+    LocationFix _cachedFix;
+
+    unsigned _numAcquisitions;
+    unsigned _numCacheHits;
+};
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,38 @@
+//
+//  RTCClock.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/9/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCClock.h"
+#include <chrono>
+
+namespace rtc {
+
+double SystemClock::now() const
+{
+    using namespace std::chrono;
+    return duration_cast<duration<double> >(system_clock::now().time_since_epoch()).count();
+}
+
+SystemClock &SystemClock::sharedClock()
+{
+    static SystemClock sharedInstance;
+    return sharedInstance;
+}
+
+double SteadyClock::now() const
+{
+    using namespace std::chrono;
+    return duration_cast<duration<double> >(steady_clock::now().time_since_epoch()).count();
+}
+
+SteadyClock &SteadyClock::sharedClock()
+{
+    static SteadyClock sharedInstance;
+    return sharedInstance;
+}
+
+} // namespace rtc
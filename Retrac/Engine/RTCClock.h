@@ -0,0 +1,86 @@
+//
+//  RTCClock.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/9/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCClock_h
+#define Retrac_RTCClock_h
+
+namespace rtc {
+
+/**
+ * Clock is the time source injected into the headless engines. Time is
+ * expressed in seconds; the epoch is whatever the clock's owner decides it is
+ * (RTCLocationManager uses seconds since 1970 so it can be compared directly
+ * against CLLocation timestamps).
+ */
+class Clock {
+public:
+    virtual ~Clock() {}
+
+    /**
+     * Current time in seconds
+     */
+    virtual double now() const = 0;
+};
+
+/**
+ * SystemClock reads the wall clock as seconds since 1970.
+ */
+class SystemClock : public Clock {
+public:
+    double now() const;
+
+    /**
+     * Shared instance, good enough for anything running on a device.
+     */
+    static SystemClock &sharedClock();
+};
+
+/**
+ * SteadyClock counts seconds from an arbitrary point and never goes backwards,
+ * so it is the one to time things with.
+ */
+class SteadyClock : public Clock {
+public:
+    double now() const;
+
+    /**
+     * Shared instance, good enough for anything running on a device.
+     */
+    static SteadyClock &sharedClock();
+};
+
+/**
+ * ManualClock only moves when told to. Used for trace replay and tests where
+ * we want deterministic virtual time.
+ */
+class ManualClock : public Clock {
+public:
+    explicit ManualClock(double start = 0.0) : _now(start) {}
+
+    double now() const { return _now; }
+
+    /**
+     * Set absolute time. Time is allowed to go backwards, it's up to the
+     * caller to not do something silly with it.
+     */
+    void setNow(double now) { _now = now; }
+
+    /**
+     * Move time forward by `seconds`
+     */
+    void advance(double seconds) { _now += seconds; }
+
+private:
+    double _now;
+};
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,257 @@
+//
+//  RTCClusterIndex.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/20/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCClusterIndex.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace rtc {
+
+#pragma mark - Constants
+// Web Mercator stops short of the poles
+static const double kMaxMercatorLatitude = 85.05112878;
+
+// cluster IDs carry their level above this bit and their index below it
+static const int kClusterLevelShift = 40;
+
+
+#pragma mark - Helpers
+static double clamp(double value, double low, double high)
+{
+    return std::min(std::max(value, low), high);
+}
+
+static double mercatorX(double longitude)
+{
+    return clamp((longitude + 180.0) / 360.0, 0.0, 1.0);
+}
+
+static double mercatorY(double latitude)
+{
+    double sinLatitude = std::sin(clamp(latitude, -kMaxMercatorLatitude, kMaxMercatorLatitude) * kDegreesToRadians);
+    double y = 0.5 - 0.25 * std::log((1.0 + sinLatitude) / (1.0 - sinLatitude)) / M_PI;
+    return clamp(y, 0.0, 1.0);
+}
+
+static GeoPoint geoPointFromMercator(double x, double y)
+{
+    double latitude = 2.0 * std::atan(std::exp((0.5 - y) * 2.0 * M_PI)) * kRadiansToDegrees - 90.0;
+    return GeoPoint(latitude, x * 360.0 - 180.0);
+}
+
+/**
+ * value as a float no greater (roundDown) or no less than it, so bounds kept
+ * as floats still contain every member
+ */
+static float boundFloat(double value, bool roundDown)
+{
+    float rounded = (float)value;
+    if (roundDown && (rounded > value)) return std::nextafter(rounded, -std::numeric_limits<float>::infinity());
+    if (!roundDown && (rounded < value)) return std::nextafter(rounded, std::numeric_limits<float>::infinity());
+    return rounded;
+}
+
+static uint32_t gridIndex(double value, double cellSize)
+{
+    return (uint32_t)std::min(std::floor(value / cellSize), (double)std::numeric_limits<uint32_t>::max());
+}
+
+
+#pragma mark - ClusterIndex
+ClusterIndex::ClusterIndex(double radius, double tileSize, int maxZoom)
+    : _radius(radius), _tileSize(tileSize), _maxZoom(std::max(maxZoom, 0)), _lastQueryVisits(0)
+{
+}
+
+double ClusterIndex::cellSizeAtZoom(int zoom) const
+{
+    return _radius / (_tileSize * std::ldexp(1.0, zoom));
+}
+
+void ClusterIndex::sortLevel(Level &level)
+{
+    for (size_t i = 0; i < level.nodes.size(); ++i) {
+        level.nodes[i].row = gridIndex(level.nodes[i].y, level.cellSize);
+    }
+    std::sort(level.nodes.begin(), level.nodes.end(), [](const Node &a, const Node &b) {
+        return (a.row < b.row) || ((a.row == b.row) && (a.x < b.x));
+    });
+}
+
+/**
+ * Bucket the level below into this zoom level's grid, one cluster per occupied
+ * cell
+ */
+void ClusterIndex::clusterLevel(const Level &below, int zoom, Level &level) const
+{
+    level.cellSize = cellSizeAtZoom(zoom);
+    level.nodes.clear();
+
+    // (cell key, node below) sorted so each cell's members are adjacent
+    std::vector<std::pair<uint64_t, uint32_t> > cells(below.nodes.size());
+    for (size_t i = 0; i < below.nodes.size(); ++i) {
+        const Node &node = below.nodes[i];
+        uint64_t key = ((uint64_t)gridIndex(node.y, level.cellSize) << 32) | gridIndex(node.x, level.cellSize);
+        cells[i] = std::make_pair(key, (uint32_t)i);
+    }
+    std::sort(cells.begin(), cells.end());
+
+    uint64_t levelID = (uint64_t)(zoom + 1) << kClusterLevelShift;
+    for (size_t first = 0; first < cells.size(); ) {
+        size_t last = first + 1;
+        while ((last < cells.size()) && (cells[last].first == cells[first].first)) ++last;
+
+        if (last - first == 1) {
+            // a lone place or cluster stays as it is
+            level.nodes.push_back(below.nodes[cells[first].second]);
+        } else {
+            Node cluster = below.nodes[cells[first].second];
+            double sumX = cluster.x * cluster.count, sumY = cluster.y * cluster.count;
+            for (size_t k = first + 1; k < last; ++k) {
+                const Node &member = below.nodes[cells[k].second];
+                sumX += member.x * member.count;
+                sumY += member.y * member.count;
+                cluster.count += member.count;
+                cluster.minLatitude = std::min(cluster.minLatitude, member.minLatitude);
+                cluster.minLongitude = std::min(cluster.minLongitude, member.minLongitude);
+                cluster.maxLatitude = std::max(cluster.maxLatitude, member.maxLatitude);
+                cluster.maxLongitude = std::max(cluster.maxLongitude, member.maxLongitude);
+            }
+            cluster.x = sumX / cluster.count;
+            cluster.y = sumY / cluster.count;
+            cluster.id = levelID | level.nodes.size();
+            level.nodes.push_back(cluster);
+        }
+        first = last;
+    }
+
+    sortLevel(level);
+}
+
+void ClusterIndex::assign(const std::vector<Record> &records)
+{
+    _levels.assign(_maxZoom + 2, Level());
+
+    // single places sit above the highest clustered zoom level
+    Level &places = _levels.back();
+    places.cellSize = cellSizeAtZoom(_maxZoom + 1);
+    places.nodes.resize(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        const GeoPoint &coordinate = records[i].coordinate;
+        Node &node = places.nodes[i];
+        node.x = mercatorX(coordinate.longitude);
+        node.y = mercatorY(coordinate.latitude);
+        node.id = records[i].placeID;
+        node.count = 1;
+        node.minLatitude = boundFloat(coordinate.latitude, true);
+        node.minLongitude = boundFloat(coordinate.longitude, true);
+        node.maxLatitude = boundFloat(coordinate.latitude, false);
+        node.maxLongitude = boundFloat(coordinate.longitude, false);
+    }
+    sortLevel(places);
+
+    for (int zoom = _maxZoom; zoom >= 0; --zoom) {
+        clusterLevel(_levels[zoom + 1], zoom, _levels[zoom]);
+    }
+}
+
+void ClusterIndex::clear()
+{
+    _levels.clear();
+    _lastQueryVisits = 0;
+}
+
+size_t ClusterIndex::numNodes() const
+{
+    size_t numNodes = 0;
+    for (size_t i = 0; i < _levels.size(); ++i) numNodes += _levels[i].nodes.size();
+    return numNodes;
+}
+
+bool ClusterIndex::bounds(GeoRect *bounds) const
+{
+    if (empty()) return false;
+
+    // zoom level 0 has a handful of clusters covering everything
+    const std::vector<Node> &nodes = _levels.front().nodes;
+    GeoRect box(nodes[0].minLatitude, nodes[0].minLongitude, nodes[0].maxLatitude, nodes[0].maxLongitude);
+    for (size_t i = 1; i < nodes.size(); ++i) {
+        box.extend(GeoRect(nodes[i].minLatitude, nodes[i].minLongitude, nodes[i].maxLatitude, nodes[i].maxLongitude));
+    }
+    if (bounds) *bounds = box;
+    return true;
+}
+
+std::vector<ClusterIndex::Cluster> ClusterIndex::clusters(const GeoRect &viewport, double zoom) const
+{
+    _lastQueryVisits = 0;
+    std::vector<Cluster> results;
+    if (empty() || !(zoom == zoom)) return results;
+
+    int levelZoom = (int)clamp(std::floor(zoom), 0.0, _maxZoom + 1.0);
+    const Level &level = _levels[levelZoom];
+
+    double minY = mercatorY(viewport.maxLatitude), maxY = mercatorY(viewport.minLatitude);
+    if (viewport.maxLongitude - viewport.minLongitude >= 360.0) {
+        collectRange(level, 0.0, 1.0, minY, maxY, results);
+    } else if (viewport.minLongitude <= viewport.maxLongitude) {
+        collectRange(level, mercatorX(viewport.minLongitude), mercatorX(viewport.maxLongitude), minY, maxY, results);
+    } else {
+        // across the antimeridian: one range either side of it
+        collectRange(level, mercatorX(viewport.minLongitude), 1.0, minY, maxY, results);
+        collectRange(level, 0.0, mercatorX(viewport.maxLongitude), minY, maxY, results);
+    }
+    return results;
+}
+
+/**
+ * Append level's clusters within a Web Mercator box to results
+ */
+void ClusterIndex::collectRange(const Level &level, double minX, double maxX, double minY, double maxY,
+                                std::vector<Cluster> &results) const
+{
+    struct RowOrder {
+        bool operator()(const Node &node, const std::pair<uint32_t, double> &key) const {
+            return (node.row < key.first) || ((node.row == key.first) && (node.x < key.second));
+        }
+    };
+
+    uint32_t firstRow = gridIndex(minY, level.cellSize), lastRow = gridIndex(maxY, level.cellSize);
+    const Node *nodes = level.nodes.data(), *end = nodes + level.nodes.size();
+    const Node *rowsBegin = std::lower_bound(nodes, end, std::make_pair(firstRow, -1.0), RowOrder());
+    const Node *rowsEnd = (lastRow == std::numeric_limits<uint32_t>::max()) ? end :
+        std::lower_bound(rowsBegin, end, std::make_pair(lastRow + 1, -1.0), RowOrder());
+
+    // zoomed far out there can be more rows than clusters in them; then it's
+    // cheaper to scan them than to search each one
+    size_t numInRows = rowsEnd - rowsBegin;
+    double numRows = (double)lastRow - firstRow + 1.0;
+    bool scan = (numRows * std::log2(numInRows + 2.0) >= numInRows);
+
+    const Node *node = rowsBegin;
+    for (uint32_t row = firstRow; node < rowsEnd; ++row) {
+        if (!scan) node = std::lower_bound(node, rowsEnd, std::make_pair(row, minX), RowOrder());
+
+        for (; (node < rowsEnd) && (scan || ((node->row == row) && (node->x <= maxX))); ++node) {
+            _lastQueryVisits++;
+            if ((node->x < minX) || (node->x > maxX) || (node->y < minY) || (node->y > maxY)) continue;
+
+            Cluster cluster;
+            cluster.coordinate = geoPointFromMercator(node->x, node->y);
+            cluster.count = node->count;
+            cluster.id = node->id;
+            cluster.bounds = (node->count == 1) ? GeoRect(cluster.coordinate) :
+                GeoRect(node->minLatitude, node->minLongitude, node->maxLatitude, node->maxLongitude);
+            results.push_back(cluster);
+        }
+        if (scan || (row == lastRow)) break;
+    }
+}
+
+} // namespace rtc
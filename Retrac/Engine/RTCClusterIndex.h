@@ -0,0 +1,129 @@
+//
+//  RTCClusterIndex.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/20/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCClusterIndex_h
+#define Retrac_RTCClusterIndex_h
+
+#include <cstdint>
+#include <vector>
+#include "RTCGeo.h"
+#include "RTCSpatialIndex.h"
+
+namespace rtc {
+
+/**
+ * ClusterIndex groups places into map annotations for every zoom level up
+ * front, so showing a viewport only costs looking up what is in it.
+ *
+ * Places are projected to Web Mercator (the projection MapKit draws in). At
+ * each zoom level from maxZoom down to 0 the level below is bucketed into a
+ * grid of cells `radius` screen points wide, and each occupied cell becomes one
+ * cluster at its members' weighted centroid. Above maxZoom every place is
+ * shown on its own. A level's clusters are kept sorted by grid row and then by
+ * x, so a viewport query binary searches the rows it covers, or scans them if
+ * there are more rows than hits. Query cost is O(rows * log n + clusters
+ * shown), independent of how many places are off screen.
+ *
+ * Grid clustering can leave two close places in separate clusters when a cell
+ * boundary falls between them. At radius-sized cells that is hard to notice
+ * and it keeps the build to a sort per level.
+ */
+class ClusterIndex {
+public:
+    typedef SpatialIndex::PlaceID PlaceID;
+    typedef SpatialIndex::Record Record;
+
+    /**
+     * A query result: a single place (count == 1, id is its PlaceID) or a
+     * cluster of them (id is unique among all clusters at all zoom levels)
+     */
+    struct Cluster {
+        GeoPoint coordinate;    // the place, or the members' centroid
+        GeoRect bounds;         // bounding box of the members
+        uint32_t count;         // number of places
+        uint64_t id;
+
+        bool isPlace() const { return count == 1; }
+    };
+
+    /**
+     * @param radius    cluster cell size, in screen points
+     * @param tileSize  screen points across the whole world at zoom level 0
+     * @param maxZoom   highest zoom level places are clustered at
+     */
+    explicit ClusterIndex(double radius = 60.0, double tileSize = 256.0, int maxZoom = 16);
+
+    /**
+     * Replace the contents of the index and recluster every zoom level.
+     */
+    void assign(const std::vector<Record> &records);
+
+    void clear();
+
+    size_t size() const { return _levels.empty() ? 0 : _levels.back().nodes.size(); }
+    bool empty() const { return size() == 0; }
+    int maxZoom() const { return _maxZoom; }
+
+    /**
+     * Bounding box of every place, without looking at them.
+     *
+     * @return false if the index is empty.
+     */
+    bool bounds(GeoRect *bounds) const;
+
+    /**
+     * Places and clusters to show in viewport at zoom level zoom.
+     *
+     * @param viewport  may cross the antimeridian (minLongitude > maxLongitude)
+     * @param zoom      fractional levels are rounded down; levels above maxZoom
+     *                  return single places
+     */
+    std::vector<Cluster> clusters(const GeoRect &viewport, double zoom) const;
+
+    /**
+     * Number of clusters examined by the most recent query
+     */
+    size_t lastQueryVisits() const { return _lastQueryVisits; }
+
+    /**
+     * Number of clusters (including single places) kept across all levels
+     */
+    size_t numNodes() const;
+
+private:
+    struct Node {
+        double x, y;            // Web Mercator, [0, 1) from north-west
+        uint64_t id;
+        uint32_t count;
+        uint32_t row;           // grid row at this node's level
+        float minLatitude, minLongitude, maxLatitude, maxLongitude;
+    };
+
+    struct Level {
+        double cellSize;        // in Web Mercator units
+        std::vector<Node> nodes;    // sorted by (row, x)
+    };
+
+    double cellSizeAtZoom(int zoom) const;
+    static void sortLevel(Level &level);
+    void clusterLevel(const Level &below, int zoom, Level &level) const;
+    void collectRange(const Level &level, double minX, double maxX, double minY, double maxY,
+                      std::vector<Cluster> &results) const;
+
+    double _radius;
+    double _tileSize;
+    int _maxZoom;
+    std::vector<Level> _levels;     // index zoom 0..maxZoom, then single places
+    mutable size_t _lastQueryVisits;
+};
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,242 @@
+//
+//  RTCDuplicateIndex.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 9/1/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCDuplicateIndex.h"
+#include <algorithm>
+#include <cmath>
+
+namespace rtc {
+
+#pragma mark - Grid
+/**
+ * The grid for a policy: rows of cellHeight degrees of latitude, each split
+ * into as many columns as keep a cell maxRadius wide at its poleward edge
+ */
+class DuplicateGrid {
+public:
+    explicit DuplicateGrid(double maxRadius)
+        : _cellMeters(maxRadius),
+          _cellHeight(maxRadius / (kEarthRadius * kDegreesToRadians)),
+          _numRows((uint32_t)std::ceil(180.0 / _cellHeight)) {}
+
+    uint32_t row(double latitude) const {
+        double scaled = (std::max(-90.0, std::min(90.0, latitude)) + 90.0) / _cellHeight;
+        return std::min(_numRows - 1, (uint32_t)scaled);
+    }
+
+    uint32_t numColumns(uint32_t row) const {
+        double south = -90.0 + row * _cellHeight;
+        double edge = std::min(90.0, std::max(std::fabs(south), std::fabs(south + _cellHeight)));
+        double metersPerDegree = kEarthRadius * kDegreesToRadians * std::cos(edge * kDegreesToRadians);
+        double columns = std::floor(360.0 * metersPerDegree / _cellMeters);
+        return (columns < 1.0) ? 1 : (uint32_t)std::min(columns, 4294967295.0);
+    }
+
+    uint32_t column(double longitude, uint32_t row) const {
+        // normalize to [0, 360)
+        longitude = std::fmod(longitude + 180.0, 360.0);
+        if (longitude < 0) longitude += 360.0;
+        uint32_t numColumns = this->numColumns(row);
+        return std::min(numColumns - 1, (uint32_t)(longitude / 360.0 * numColumns));
+    }
+
+    static uint64_t key(uint32_t row, uint32_t column) { return ((uint64_t)row << 32) | column; }
+
+    uint64_t key(const GeoPoint &coordinate) const {
+        uint32_t row = this->row(coordinate.latitude);
+        return key(row, column(coordinate.longitude, row));
+    }
+
+    /**
+     * Keys of the cell holding coordinate and the cells around it, without
+     * repeats where a row has 3 columns or fewer
+     */
+    size_t neighborhood(const GeoPoint &coordinate, uint64_t keys[9]) const {
+        size_t numKeys = 0;
+        uint32_t centerRow = row(coordinate.latitude);
+        for (int dr = -1; dr <= 1; ++dr) {
+            if (((dr < 0) && (centerRow == 0)) || ((dr > 0) && (centerRow + 1 >= _numRows))) continue;
+            uint32_t row = centerRow + dr;
+            uint32_t numColumns = this->numColumns(row);
+            if (numColumns <= 3) {
+                for (uint32_t c = 0; c < numColumns; ++c) keys[numKeys++] = key(row, c);
+                continue;
+            }
+            uint32_t center = column(coordinate.longitude, row);
+            keys[numKeys++] = key(row, (center + numColumns - 1) % numColumns);
+            keys[numKeys++] = key(row, center);
+            keys[numKeys++] = key(row, (center + 1) % numColumns);
+        }
+        return numKeys;
+    }
+
+private:
+    double _cellMeters;
+    double _cellHeight;     // degrees
+    uint32_t _numRows;
+};
+
+
+#pragma mark - DuplicatePolicy
+double DuplicatePolicy::radius(double accuracy, double otherAccuracy) const
+{
+    double larger = std::max(accuracy, otherAccuracy);
+    return std::max(minRadius, std::min(maxRadius, larger));
+}
+
+
+#pragma mark - DuplicateIndex
+DuplicateIndex::DuplicateIndex(const DuplicatePolicy &policy)
+    : _policy(policy), _lastQueryVisits(0)
+{
+}
+
+void DuplicateIndex::assign(const std::vector<Record> &records)
+{
+    clear();
+    _cellsByPlace.reserve(records.size());
+
+    DuplicateGrid grid(_policy.maxRadius);
+    for (size_t i = 0; i < records.size(); ++i) {
+        const Record &record = records[i];
+        uint64_t key = grid.key(record.coordinate);
+        std::pair<std::unordered_map<PlaceID, uint64_t>::iterator, bool> added =
+            _cellsByPlace.insert(std::make_pair(record.placeID, key));
+        if (!added.second) {
+            // the last record for a place wins, as with insert()
+            insert(record);
+            continue;
+        }
+        Entry entry = {record.placeID, record.coordinate, record.horizontalAccuracy};
+        _cells[key].push_back(entry);
+    }
+}
+
+void DuplicateIndex::insert(const Record &record)
+{
+    remove(record.placeID);
+
+    uint64_t key = DuplicateGrid(_policy.maxRadius).key(record.coordinate);
+    Entry entry = {record.placeID, record.coordinate, record.horizontalAccuracy};
+    _cells[key].push_back(entry);
+    _cellsByPlace[record.placeID] = key;
+}
+
+bool DuplicateIndex::remove(PlaceID placeID)
+{
+    std::unordered_map<PlaceID, uint64_t>::iterator found = _cellsByPlace.find(placeID);
+    if (found == _cellsByPlace.end()) return false;
+
+    std::unordered_map<uint64_t, std::vector<Entry> >::iterator cell = _cells.find(found->second);
+    std::vector<Entry> &entries = cell->second;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].placeID == placeID) {
+            entries[i] = entries.back();
+            entries.pop_back();
+            break;
+        }
+    }
+    if (entries.empty()) _cells.erase(cell);
+    _cellsByPlace.erase(found);
+    return true;
+}
+
+void DuplicateIndex::clear()
+{
+    _cells.clear();
+    _cellsByPlace.clear();
+}
+
+bool DuplicateIndex::findDuplicate(const GeoPoint &coordinate, double horizontalAccuracy,
+                                   PlaceID *placeID, double *distance) const
+{
+    _lastQueryVisits = 0;
+    bool found = false;
+    double bestDistance = 0;
+
+    uint64_t keys[9];
+    size_t numKeys = DuplicateGrid(_policy.maxRadius).neighborhood(coordinate, keys);
+    for (size_t k = 0; k < numKeys; ++k) {
+        std::unordered_map<uint64_t, std::vector<Entry> >::const_iterator cell = _cells.find(keys[k]);
+        if (cell == _cells.end()) continue;
+
+        const std::vector<Entry> &entries = cell->second;
+        _lastQueryVisits += entries.size();
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const Entry &entry = entries[i];
+            double d = distanceBetween(coordinate, entry.coordinate);
+            if (d > _policy.radius(horizontalAccuracy, entry.horizontalAccuracy)) continue;
+            if (!found || (d < bestDistance) || ((d == bestDistance) && (entry.placeID < *placeID))) {
+                found = true;
+                bestDistance = d;
+                *placeID = entry.placeID;
+            }
+        }
+    }
+
+    if (found && distance) *distance = bestDistance;
+    return found;
+}
+
+
+#pragma mark - Compaction
+std::vector<DuplicateGroup> findDuplicateGroups(const std::vector<DuplicateIndex::Record> &records,
+                                                const DuplicatePolicy &policy)
+{
+    DuplicateGrid grid(policy.maxRadius);
+
+    // (cell key, record) sorted, so each cell is a range found by binary search
+    std::vector<std::pair<uint64_t, uint32_t> > cells(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        cells[i] = std::make_pair(grid.key(records[i].coordinate), (uint32_t)i);
+    }
+    std::sort(cells.begin(), cells.end());
+
+    // newest first; unknown dates last
+    std::vector<uint32_t> order(records.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = (uint32_t)i;
+    std::sort(order.begin(), order.end(), [&records](uint32_t a, uint32_t b) {
+        double dateA = records[a].creationDate, dateB = records[b].creationDate;
+        if (std::isnan(dateA) != std::isnan(dateB)) return std::isnan(dateB);
+        if (!std::isnan(dateA) && (dateA != dateB)) return dateA > dateB;
+        return records[a].placeID > records[b].placeID;
+    });
+
+    std::vector<DuplicateGroup> groups;
+    std::vector<bool> grouped(records.size(), false);
+    for (size_t o = 0; o < order.size(); ++o) {
+        uint32_t survivor = order[o];
+        if (grouped[survivor]) continue;
+        grouped[survivor] = true;
+
+        const DuplicateIndex::Record &kept = records[survivor];
+        DuplicateGroup group;
+        group.survivor = kept.placeID;
+
+        uint64_t keys[9];
+        size_t numKeys = grid.neighborhood(kept.coordinate, keys);
+        for (size_t k = 0; k < numKeys; ++k) {
+            std::vector<std::pair<uint64_t, uint32_t> >::const_iterator it =
+                std::lower_bound(cells.begin(), cells.end(), std::make_pair(keys[k], (uint32_t)0));
+            for (; (it != cells.end()) && (it->first == keys[k]); ++it) {
+                uint32_t other = it->second;
+                if (grouped[other]) continue;
+                const DuplicateIndex::Record &record = records[other];
+                double d = distanceBetween(kept.coordinate, record.coordinate);
+                if (d > policy.radius(kept.horizontalAccuracy, record.horizontalAccuracy)) continue;
+
+                grouped[other] = true;
+                group.duplicates.push_back(record.placeID);
+            }
+        }
+        if (!group.duplicates.empty()) groups.push_back(group);
+    }
+    return groups;
+}
+
+} // namespace rtc
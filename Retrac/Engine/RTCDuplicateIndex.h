@@ -0,0 +1,149 @@
+//
+//  RTCDuplicateIndex.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 9/1/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCDuplicateIndex_h
+#define Retrac_RTCDuplicateIndex_h
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "RTCGeo.h"
+
+namespace rtc {
+
+/**
+ * DuplicatePolicy decides when two saved fixes are the same spot. The default
+ * values mirror the duplicate settings in RTCConstants.m
+ */
+struct DuplicatePolicy {
+    double minRadius;           // kRTCDuplicateMinRadius
+    double maxRadius;           // kRTCDuplicateMaxRadius
+
+    DuplicatePolicy() : minRadius(10.0), maxRadius(50.0) {}
+
+    /**
+     * How close (meters) fixes with these horizontal accuracies must be to
+     * count as the same spot: the larger accuracy, kept between minRadius and
+     * maxRadius. An unknown (negative) accuracy counts as minRadius.
+     */
+    double radius(double accuracy, double otherAccuracy) const;
+};
+
+/**
+ * DuplicateIndex finds the saved place a new fix duplicates.
+ *
+ * Places are bucketed in a hashed grid of cells at least policy.maxRadius
+ * across: rows of equal latitude span, each cut into as many equal columns as
+ * keep a cell that wide at the row's poleward edge. Any place close enough to
+ * be a duplicate is then in the fix's cell or one of the 8 around it, so a
+ * lookup or update costs the same however many places are saved.
+ *
+ * Place IDs are opaque to the index; the owner maps them back to its records.
+ */
+class DuplicateIndex {
+public:
+    typedef uint64_t PlaceID;
+
+    /**
+     * A place as far as duplicates go
+     */
+    struct Record {
+        PlaceID placeID;
+        GeoPoint coordinate;
+        double horizontalAccuracy;  // meters, negative if unknown
+        double creationDate;        // seconds since 1970, NaN if unknown
+
+        Record() : placeID(0), horizontalAccuracy(-1.0), creationDate(0) {}
+        Record(PlaceID anID, const GeoPoint &aCoordinate, double accuracy, double date)
+            : placeID(anID), coordinate(aCoordinate), horizontalAccuracy(accuracy), creationDate(date) {}
+    };
+
+    explicit DuplicateIndex(const DuplicatePolicy &policy = DuplicatePolicy());
+
+    const DuplicatePolicy &policy() const { return _policy; }
+
+    /**
+     * Replace the contents of the index
+     */
+    void assign(const std::vector<Record> &records);
+
+    /**
+     * Insert a place, or move it if it is already indexed.
+     */
+    void insert(const Record &record);
+
+    /**
+     * Remove a place.
+     *
+     * @return false if the place wasn't indexed.
+     */
+    bool remove(PlaceID placeID);
+
+    void clear();
+
+    size_t size() const { return _cellsByPlace.size(); }
+    bool contains(PlaceID placeID) const { return _cellsByPlace.count(placeID) > 0; }
+
+    /**
+     * The nearest place a fix at coordinate with horizontalAccuracy is the
+     * same spot as.
+     *
+     * @param distance  optional, set to how far (meters) the place is
+     *
+     * @return false if there is none.
+     */
+    bool findDuplicate(const GeoPoint &coordinate, double horizontalAccuracy,
+                       PlaceID *placeID, double *distance = 0) const;
+
+    /**
+     * Number of places examined by the most recent findDuplicate(). Handy for
+     * checking that lookups don't degrade into scans.
+     */
+    size_t lastQueryVisits() const { return _lastQueryVisits; }
+
+private:
+    struct Entry {
+        PlaceID placeID;
+        GeoPoint coordinate;
+        double horizontalAccuracy;
+    };
+
+    DuplicatePolicy _policy;
+    std::unordered_map<uint64_t, std::vector<Entry> > _cells;  // cell key -> places in it
+    std::unordered_map<PlaceID, uint64_t> _cellsByPlace;
+    mutable size_t _lastQueryVisits;
+};
+
+/**
+ * A place that is kept and the places that duplicate it
+ */
+struct DuplicateGroup {
+    DuplicateIndex::PlaceID survivor;
+    std::vector<DuplicateIndex::PlaceID> duplicates;
+};
+
+/**
+ * Group a whole store's places into duplicates, for compacting it in one
+ * pass. Newest places are kept first: each place not yet grouped keeps the
+ * ones not yet grouped that it's the same spot as, so groups don't chain
+ * along a row of places each close to the next.
+ *
+ * Places are bucketed as in DuplicateIndex but sorted by cell rather than
+ * hashed, which is faster when they're all known up front.
+ *
+ * @return the groups with duplicates, in the order their survivors were
+ *      picked.
+ */
+std::vector<DuplicateGroup> findDuplicateGroups(const std::vector<DuplicateIndex::Record> &records,
+                                                const DuplicatePolicy &policy = DuplicatePolicy());
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,123 @@
+//
+//  RTCFixTraceReplay.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/9/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCFixTraceReplay.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include "RTCTrace.h"
+
+namespace rtc {
+
+#pragma mark - Helpers
+static double mean(const std::vector<double> &values)
+{
+    if (values.empty()) return 0;
+    double sum = 0;
+    for (size_t i = 0; i < values.size(); ++i) sum += values[i];
+    return sum / values.size();
+}
+
+
+#pragma mark - Parsing
+bool parseFixTrace(std::istream &input, FixTrace &trace, std::string *error)
+{
+    std::string line;
+    unsigned lineNumber = 0;
+
+    while (std::getline(input, line)) {
+        ++lineNumber;
+
+        // skip leading whitespace, blank lines and comments
+        size_t start = line.find_first_not_of(" \t\r");
+        if ((start == std::string::npos) || (line[start] == '#')) continue;
+
+        double t, lat, lon, accuracy, age = 0;
+        int numFields = std::sscanf(line.c_str() + start, "%lf,%lf,%lf,%lf,%lf",
+                                    &t, &lat, &lon, &accuracy, &age);
+        if (numFields < 4) {
+            if (error) {
+                std::ostringstream message;
+                message << "line " << lineNumber << ": expected t,latitude,longitude,horizontalAccuracy[,age]";
+                *error = message.str();
+            }
+            return false;
+        }
+
+        trace.push_back(TracedFix(t, LocationFix(t - age, lat, lon, accuracy)));
+    }
+    return true;
+}
+
+
+#pragma mark - Replay
+FixReplayReport replayFixTrace(const FixTrace &trace, const LocationFixPolicy &policy)
+{
+    FixReplayReport report;
+
+    ManualClock clock(0.0);
+    LocationFixEngine engine(clock, policy);
+    engine.start();
+
+    for (size_t i = 0; (i < trace.size()) && (engine.state() == LocationFixEngine::StateAcquiring); ++i) {
+        double t = trace[i].deliveryTime;
+
+        // fire the timeout if it comes before this fix
+        if (engine.deadline() <= t) {
+            clock.setNow(engine.deadline());
+            engine.handleTimeout();
+            break;
+        }
+
+        clock.setNow(t);
+        engine.processFix(trace[i].fix);
+        ++report.fixesConsumed;
+    }
+
+    // trace ran dry, so nothing left to do but wait for the timeout
+    if (engine.state() == LocationFixEngine::StateAcquiring) {
+        clock.setNow(engine.deadline());
+        engine.handleTimeout();
+    }
+
+    report.gotFix = engine.hasBestFix();
+    report.timeToFix = engine.finishTime() - engine.startTime();
+    report.finalAccuracy = engine.hasBestFix() ? engine.bestFix().horizontalAccuracy : -1;
+    report.finishReason = engine.finishReason();
+    return report;
+}
+
+
+#pragma mark - Summary
+FixReplaySummary summarizeFixReplays(const std::vector<FixReplayReport> &reports)
+{
+    FixReplaySummary summary;
+    summary.numTraces = (unsigned)reports.size();
+
+    std::vector<double> times, accuracies, consumed;
+    for (size_t i = 0; i < reports.size(); ++i) {
+        consumed.push_back(reports[i].fixesConsumed);
+        if (!reports[i].gotFix) continue;
+
+        ++summary.numFixed;
+        times.push_back(reports[i].timeToFix);
+        accuracies.push_back(reports[i].finalAccuracy);
+    }
+    std::sort(times.begin(), times.end());
+    std::sort(accuracies.begin(), accuracies.end());
+
+    summary.meanTimeToFix = mean(times);
+    summary.p50TimeToFix = percentile(times, 0.5);
+    summary.p90TimeToFix = percentile(times, 0.9);
+    summary.meanFixesConsumed = mean(consumed);
+    summary.meanFinalAccuracy = mean(accuracies);
+    summary.p90FinalAccuracy = percentile(accuracies, 0.9);
+    return summary;
+}
+
+} // namespace rtc
@@ -0,0 +1,109 @@
+//
+//  RTCFixTraceReplay.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/9/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCFixTraceReplay_h
+#define Retrac_RTCFixTraceReplay_h
+
+#include <istream>
+#include <string>
+#include <vector>
+#include "RTCLocationFixEngine.h"
+
+namespace rtc {
+
+/**
+ * TracedFix is a fix as it was delivered by the location provider. The fix
+ * timestamp can be older than the delivery time when the provider hands over
+ * a cached measurement.
+ */
+struct TracedFix {
+    double deliveryTime;        // seconds since start of the acquisition
+    LocationFix fix;
+
+    TracedFix() : deliveryTime(0) {}
+    TracedFix(double t, const LocationFix &aFix) : deliveryTime(t), fix(aFix) {}
+};
+
+/**
+ * FixTrace is a recorded sequence of fixes, in delivery order. Times are
+ * relative to the start of the acquisition (t = 0 is when
+ * `updateCurrentLocation:failure:` was called).
+ */
+typedef std::vector<TracedFix> FixTrace;
+
+/**
+ * Outcome of replaying one trace through a LocationFixEngine.
+ */
+struct FixReplayReport {
+    bool gotFix;                // did we end up with a usable fix?
+    double timeToFix;           // seconds from start till the engine finished
+    unsigned fixesConsumed;     // fixes delivered before the engine finished
+    double finalAccuracy;       // accuracy of the reported fix, -1 if none
+    LocationFixEngine::FinishReason finishReason;
+
+    FixReplayReport()
+        : gotFix(false), timeToFix(0), fixesConsumed(0), finalAccuracy(-1),
+          finishReason(LocationFixEngine::FinishReasonNone) {}
+};
+
+/**
+ * Aggregate over many replays. Time and accuracy stats only consider the
+ * replays that got a fix.
+ */
+struct FixReplaySummary {
+    unsigned numTraces;
+    unsigned numFixed;
+    double meanTimeToFix;
+    double p50TimeToFix;
+    double p90TimeToFix;
+    double meanFixesConsumed;
+    double meanFinalAccuracy;
+    double p90FinalAccuracy;
+
+    FixReplaySummary()
+        : numTraces(0), numFixed(0), meanTimeToFix(0), p50TimeToFix(0), p90TimeToFix(0),
+          meanFixesConsumed(0), meanFinalAccuracy(0), p90FinalAccuracy(0) {}
+};
+
+/**
+ * Parse a fix trace. One fix per line, comma separated:
+ *
+ *      t,latitude,longitude,horizontalAccuracy[,age]
+ *
+ * `t` is the delivery time in seconds since start. The optional `age` is how
+ * stale the fix already is when delivered (CoreLocation likes to hand over a
+ * cached fix first), so its timestamp becomes t - age.
+ * Blank lines and lines starting with '#' are ignored.
+ *
+ * @param input     stream to read from
+ * @param trace     parsed fixes are appended here
+ * @param error     optional, set to a description of the first bad line
+ *
+ * @return false if a line could not be parsed.
+ */
+bool parseFixTrace(std::istream &input, FixTrace &trace, std::string *error = 0);
+
+/**
+ * Replay a trace against a fresh engine running on virtual time.
+ *
+ * Timeouts fire at the engine's deadline if that comes before the next fix, and
+ * once the trace runs out the engine is left to time out.
+ */
+FixReplayReport replayFixTrace(const FixTrace &trace,
+                               const LocationFixPolicy &policy = LocationFixPolicy());
+
+/**
+ * Compute summary statistics over a set of replay reports
+ */
+FixReplaySummary summarizeFixReplays(const std::vector<FixReplayReport> &reports);
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,112 @@
+//
+//  RTCGeo.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/10/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCGeo_h
+#define Retrac_RTCGeo_h
+
+#include <cmath>
+
+namespace rtc {
+
+/**
+ * Mean earth radius (meters) used by all the spherical approximations here.
+ */
+static const double kEarthRadius = 6371008.8;
+
+static const double kDegreesToRadians = M_PI / 180.0;
+static const double kRadiansToDegrees = 180.0 / M_PI;
+
+/**
+ * GeoPoint is the engine equivalent of CLLocationCoordinate2D
+ */
+struct GeoPoint {
+    double latitude;    // degrees
+    double longitude;   // degrees
+
+    GeoPoint() : latitude(0), longitude(0) {}
+    GeoPoint(double lat, double lon) : latitude(lat), longitude(lon) {}
+};
+
+/**
+ * GeoRect is a latitude/longitude bounding box. A box crossing the
+ * antimeridian has minLongitude > maxLongitude.
+ */
+struct GeoRect {
+    double minLatitude, minLongitude;   // degrees, south-west corner
+    double maxLatitude, maxLongitude;   // degrees, north-east corner
+
+    GeoRect() : minLatitude(0), minLongitude(0), maxLatitude(0), maxLongitude(0) {}
+    GeoRect(double minLat, double minLon, double maxLat, double maxLon)
+        : minLatitude(minLat), minLongitude(minLon), maxLatitude(maxLat), maxLongitude(maxLon) {}
+    explicit GeoRect(const GeoPoint &point)
+        : minLatitude(point.latitude), minLongitude(point.longitude),
+          maxLatitude(point.latitude), maxLongitude(point.longitude) {}
+
+    /**
+     * Grow to take in other. Boxes are treated as not crossing the antimeridian.
+     */
+    void extend(const GeoRect &other) {
+        minLatitude = std::fmin(minLatitude, other.minLatitude);
+        minLongitude = std::fmin(minLongitude, other.minLongitude);
+        maxLatitude = std::fmax(maxLatitude, other.maxLatitude);
+        maxLongitude = std::fmax(maxLongitude, other.maxLongitude);
+    }
+};
+
+/**
+ * Great-circle distance in meters using the haversine formula. Good to well
+ * under a percent which is plenty for a walking app.
+ */
+inline double distanceBetween(const GeoPoint &from, const GeoPoint &to)
+{
+    double lat1 = from.latitude * kDegreesToRadians;
+    double lat2 = to.latitude * kDegreesToRadians;
+    double sinHalfLat = std::sin((lat2 - lat1) * 0.5);
+    double sinHalfLon = std::sin((to.longitude - from.longitude) * kDegreesToRadians * 0.5);
+
+    double a = sinHalfLat * sinHalfLat + std::cos(lat1) * std::cos(lat2) * sinHalfLon * sinHalfLon;
+    if (a > 1.0) a = 1.0;
+    return 2.0 * kEarthRadius * std::asin(std::sqrt(a));
+}
+
+/**
+ * Initial bearing (degrees clockwise from true north, [0, 360)) of the
+ * great-circle path from `from` to `to`.
+ */
+inline double initialBearing(const GeoPoint &from, const GeoPoint &to)
+{
+    double lat1 = from.latitude * kDegreesToRadians;
+    double lat2 = to.latitude * kDegreesToRadians;
+    double dLon = (to.longitude - from.longitude) * kDegreesToRadians;
+
+    double y = std::sin(dLon) * std::cos(lat2);
+    double x = std::cos(lat1) * std::sin(lat2) - std::sin(lat1) * std::cos(lat2) * std::cos(dLon);
+    double bearing = std::atan2(y, x) * kRadiansToDegrees;
+    return (bearing < 0) ? bearing + 360.0 : bearing;
+}
+
+/**
+ * Planar offset (meters east, meters north) of point from origin on a local
+ * equirectangular projection. Plenty accurate over the few hundred meters
+ * it's used for.
+ */
+inline void localOffset(const GeoPoint &origin, const GeoPoint &point, double *x, double *y)
+{
+    double dLon = point.longitude - origin.longitude;
+    if (dLon > 180.0) dLon -= 360.0;
+    else if (dLon < -180.0) dLon += 360.0;
+
+    *x = dLon * kDegreesToRadians * kEarthRadius * std::cos(origin.latitude * kDegreesToRadians);
+    *y = (point.latitude - origin.latitude) * kDegreesToRadians * kEarthRadius;
+}
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,306 @@
+//
+//  RTCGeoKernel.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/17/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCGeoKernel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Vector width. Only double precision vectors are any use here (floats can't
+// tell points a meter apart on the unit sphere), which leaves 32-bit ARM on
+// the scalar loop.
+#if defined(__GNUC__) && defined(__AVX__)
+#include <immintrin.h>
+#define RTC_GEO_KERNEL_LANES 4
+#define RTC_GEO_KERNEL_ISA "AVX"
+#elif defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define RTC_GEO_KERNEL_LANES 2
+#define RTC_GEO_KERNEL_ISA "SSE2"
+#elif defined(__GNUC__) && defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RTC_GEO_KERNEL_LANES 2
+#define RTC_GEO_KERNEL_ISA "NEON"
+#else
+#define RTC_GEO_KERNEL_LANES 1
+#define RTC_GEO_KERNEL_ISA "scalar"
+#endif
+
+namespace rtc {
+
+#pragma mark - GeoPointArray
+void GeoPointArray::assign(const std::vector<GeoPoint> &points)
+{
+    clear();
+    reserve(points.size());
+    for (size_t i = 0; i < points.size(); ++i) push_back(points[i]);
+}
+
+void GeoPointArray::push_back(const GeoPoint &point)
+{
+    double latitude = point.latitude * kDegreesToRadians;
+    double longitude = point.longitude * kDegreesToRadians;
+    _x.push_back(std::cos(latitude) * std::cos(longitude));
+    _y.push_back(std::cos(latitude) * std::sin(longitude));
+    _z.push_back(std::sin(latitude));
+}
+
+void GeoPointArray::reserve(size_t count)
+{
+    _x.reserve(count);
+    _y.reserve(count);
+    _z.reserve(count);
+}
+
+void GeoPointArray::clear()
+{
+    _x.clear();
+    _y.clear();
+    _z.clear();
+}
+
+
+#pragma mark - Origin
+namespace {
+
+/**
+ * Everything about the origin the kernels need, worked out once per call
+ */
+struct Origin {
+    double x, y, z;
+    double sinLatitude, cosLatitude;
+    double sinLongitude, cosLongitude;
+
+    explicit Origin(const GeoPoint &point) {
+        double latitude = point.latitude * kDegreesToRadians;
+        double longitude = point.longitude * kDegreesToRadians;
+        sinLatitude = std::sin(latitude);
+        cosLatitude = std::cos(latitude);
+        sinLongitude = std::sin(longitude);
+        cosLongitude = std::cos(longitude);
+        x = cosLatitude * cosLongitude;
+        y = cosLatitude * sinLongitude;
+        z = sinLatitude;
+    }
+};
+
+} // namespace
+
+
+#pragma mark - Scalar Kernel
+/**
+ * The kernel one point at a time, over points [first, last).
+ *
+ * Distance comes from the chord between the two unit vectors: the haversine
+ * of the central angle is (chord / 2)^2. The bearing's atan2 arguments are
+ * the usual ones with the point's trig expanded into its unit vector.
+ */
+static void scalarDistancesFrom(const Origin &origin, const GeoPointArray &points, size_t first, size_t last,
+                                double *distances, double *bearings)
+{
+    const double *xs = points.x(), *ys = points.y(), *zs = points.z();
+    for (size_t i = first; i < last; ++i) {
+        double dx = xs[i] - origin.x, dy = ys[i] - origin.y, dz = zs[i] - origin.z;
+        double chordSquared = dx * dx + dy * dy + dz * dz;
+        double halfChord = std::min(0.5 * std::sqrt(chordSquared), 1.0);
+        distances[i] = 2.0 * kEarthRadius * std::asin(halfChord);
+
+        if (!bearings) continue;
+        if (chordSquared == 0) {
+            // no way to go, call it north like initialBearing() does
+            bearings[i] = 0;
+            continue;
+        }
+        double east = ys[i] * origin.cosLongitude - xs[i] * origin.sinLongitude;
+        double north = origin.cosLatitude * zs[i] -
+                       origin.sinLatitude * (xs[i] * origin.cosLongitude + ys[i] * origin.sinLongitude);
+        double bearing = std::atan2(east, north) * kRadiansToDegrees;
+        bearings[i] = (bearing < 0) ? bearing + 360.0 : bearing;
+    }
+}
+
+
+#if RTC_GEO_KERNEL_LANES > 1
+#pragma mark - Vector Kernel
+// GCC/Clang vector extensions: arithmetic and comparisons work lane-wise and
+// compile to the target's SIMD instructions. Only square root needs spelling
+// out per instruction set.
+typedef double VDouble __attribute__((vector_size(8 * RTC_GEO_KERNEL_LANES)));
+typedef int64_t VMask __attribute__((vector_size(8 * RTC_GEO_KERNEL_LANES)));
+
+// Cephes atan() rational approximation, good to double precision on
+// [0, 0.66] (http://www.netlib.org/cephes/)
+static const double kAtanP[] = {
+    -8.750608600031904122785E-1, -1.615753718733365076637E1, -7.500855792314704667340E1,
+    -1.228866684490136173410E2, -6.485021904942025371773E1
+};
+static const double kAtanQ[] = {
+    2.485846490142306297962E1, 1.650270098316988542046E2, 4.328810604912902668951E2,
+    4.853903996359136964868E2, 1.945506571482613964425E2
+};
+static const double kAtanReductionThreshold = 0.66;
+static const double kPiOver4MoreBits = 0.5 * 6.123233995736765886130E-17;  // bits of pi/4 a double drops
+
+static inline VDouble splat(double value)
+{
+    VDouble result;
+    for (int i = 0; i < RTC_GEO_KERNEL_LANES; ++i) result[i] = value;
+    return result;
+}
+
+static inline VDouble load(const double *values)
+{
+    VDouble result;
+    std::memcpy(&result, values, sizeof(result));
+    return result;
+}
+
+static inline void store(double *values, VDouble result)
+{
+    std::memcpy(values, &result, sizeof(result));
+}
+
+// a where mask is set, else b
+static inline VDouble select(VMask mask, VDouble a, VDouble b)
+{
+    return (VDouble)(((VMask)a & mask) | ((VMask)b & ~mask));
+}
+
+static inline VDouble vabs(VDouble a)
+{
+    VMask signBits;
+    for (int i = 0; i < RTC_GEO_KERNEL_LANES; ++i) signBits[i] = INT64_MIN;
+    return (VDouble)((VMask)a & ~signBits);
+}
+
+static inline VDouble vsqrt(VDouble a)
+{
+#if defined(__AVX__)
+    return (VDouble)_mm256_sqrt_pd((__m256d)a);
+#elif defined(__SSE2__)
+    return (VDouble)_mm_sqrt_pd((__m128d)a);
+#else
+    return (VDouble)vsqrtq_f64((float64x2_t)a);
+#endif
+}
+
+/**
+ * atan(t) for t in [0, 1]
+ */
+static inline VDouble atanUnit(VDouble t)
+{
+    // above the threshold use atan(t) = pi/4 + atan((t - 1) / (t + 1))
+    VMask reduce = (VMask)(t > splat(kAtanReductionThreshold));
+    VDouble one = splat(1.0);
+    VDouble x = select(reduce, (t - one) / (t + one), t);
+
+    VDouble z = x * x;
+    VDouble p = splat(kAtanP[0]);
+    for (int i = 1; i < 5; ++i) p = p * z + splat(kAtanP[i]);
+    VDouble q = z + splat(kAtanQ[0]);
+    for (int i = 1; i < 5; ++i) q = q * z + splat(kAtanQ[i]);
+
+    VDouble result = x + x * (z * p / q);
+    return result + select(reduce, splat(M_PI_4 + kPiOver4MoreBits), splat(0.0));
+}
+
+/**
+ * atan2(y, x), from the atan of the smaller magnitude over the larger
+ */
+static inline VDouble vatan2(VDouble y, VDouble x)
+{
+    VDouble zero = splat(0.0);
+    VDouble ax = vabs(x), ay = vabs(y);
+    VMask yLarger = (VMask)(ay > ax);
+    VDouble larger = select(yLarger, ay, ax);
+    VDouble smaller = select(yLarger, ax, ay);
+
+    // atan2(0, 0) is 0
+    VDouble t = smaller / select((VMask)(larger > zero), larger, splat(1.0));
+    VDouble angle = atanUnit(t);
+
+    angle = select(yLarger, splat(M_PI_2) - angle, angle);
+    angle = select((VMask)(x < zero), splat(M_PI) - angle, angle);
+    return select((VMask)(y < zero), zero - angle, angle);
+}
+
+/**
+ * The kernel RTC_GEO_KERNEL_LANES points at a time, same math as the scalar
+ * one with asin(h) written as atan2(h, sqrt(1 - h^2)).
+ *
+ * @return number of points done, a multiple of RTC_GEO_KERNEL_LANES
+ */
+static size_t vectorDistancesFrom(const Origin &origin, const GeoPointArray &points,
+                                  double *distances, double *bearings)
+{
+    const double *xs = points.x(), *ys = points.y(), *zs = points.z();
+    size_t count = points.size() - points.size() % RTC_GEO_KERNEL_LANES;
+
+    VDouble ox = splat(origin.x), oy = splat(origin.y), oz = splat(origin.z);
+    VDouble sinLatitude = splat(origin.sinLatitude), cosLatitude = splat(origin.cosLatitude);
+    VDouble sinLongitude = splat(origin.sinLongitude), cosLongitude = splat(origin.cosLongitude);
+    VDouble half = splat(0.5), one = splat(1.0), zero = splat(0.0);
+    VDouble diameter = splat(2.0 * kEarthRadius);
+    VDouble toDegrees = splat(kRadiansToDegrees), fullCircle = splat(360.0);
+
+    for (size_t i = 0; i < count; i += RTC_GEO_KERNEL_LANES) {
+        VDouble x = load(xs + i), y = load(ys + i), z = load(zs + i);
+
+        VDouble dx = x - ox, dy = y - oy, dz = z - oz;
+        VDouble chordSquared = dx * dx + dy * dy + dz * dz;
+        VDouble halfChord = half * vsqrt(chordSquared);
+        halfChord = select((VMask)(halfChord > one), one, halfChord);
+        store(distances + i, diameter * vatan2(halfChord, vsqrt(one - halfChord * halfChord)));
+
+        if (!bearings) continue;
+        VDouble east = y * cosLongitude - x * sinLongitude;
+        VDouble north = cosLatitude * z - sinLatitude * (x * cosLongitude + y * sinLongitude);
+        VDouble bearing = vatan2(east, north) * toDegrees;
+        bearing = select((VMask)(bearing < zero), bearing + fullCircle, bearing);
+        store(bearings + i, select((VMask)(chordSquared > zero), bearing, zero));
+    }
+    return count;
+}
+#endif
+
+
+#pragma mark - Public
+const char *geoKernelInstructionSet()
+{
+    return RTC_GEO_KERNEL_ISA;
+}
+
+void distancesFrom(const GeoPoint &origin, const GeoPointArray &points, double *distances, double *bearings)
+{
+    Origin o(origin);
+    size_t first = 0;
+#if RTC_GEO_KERNEL_LANES > 1
+    first = vectorDistancesFrom(o, points, distances, bearings);
+#endif
+    scalarDistancesFrom(o, points, first, points.size(), distances, bearings);
+}
+
+std::vector<size_t> orderByDistance(const GeoPoint &origin, const GeoPointArray &points,
+                                    std::vector<double> *distances, std::vector<double> *bearings)
+{
+    std::vector<double> keys(points.size());
+    if (bearings) bearings->resize(points.size());
+    distancesFrom(origin, points, keys.data(), bearings ? bearings->data() : 0);
+
+    std::vector<size_t> order(points.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+        return (keys[a] < keys[b]) || ((keys[a] == keys[b]) && (a < b));
+    });
+
+    if (distances) distances->swap(keys);
+    return order;
+}
+
+} // namespace rtc
@@ -0,0 +1,81 @@
+//
+//  RTCGeoKernel.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/17/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCGeoKernel_h
+#define Retrac_RTCGeoKernel_h
+
+#include <cstddef>
+#include <vector>
+#include "RTCGeo.h"
+
+namespace rtc {
+
+/**
+ * GeoPointArray holds many coordinates in struct-of-arrays form for the batch
+ * kernels below.
+ *
+ * Each coordinate is kept as a point on the unit sphere (x, y, z) rather than
+ * latitude and longitude, so the trig is done once when a point is added
+ * instead of on every query, and the kernels are left with multiplies, adds
+ * and a single arctangent per point.
+ */
+class GeoPointArray {
+public:
+    GeoPointArray() {}
+
+    void assign(const std::vector<GeoPoint> &points);
+    void push_back(const GeoPoint &point);
+    void reserve(size_t count);
+    void clear();
+
+    size_t size() const { return _x.size(); }
+    bool empty() const { return _x.empty(); }
+
+    const double *x() const { return _x.data(); }
+    const double *y() const { return _y.data(); }
+    const double *z() const { return _z.data(); }
+
+private:
+    std::vector<double> _x, _y, _z;
+};
+
+/**
+ * Instruction set the batch kernels were built for: "AVX", "SSE2", "NEON" or
+ * "scalar".
+ */
+const char *geoKernelInstructionSet();
+
+/**
+ * Great-circle distance and initial bearing from origin to every point, the
+ * batch equivalent of distanceBetween() and initialBearing() (and agreeing
+ * with them to well under a millimeter and a microdegree).
+ *
+ * Points are processed as many at a time as the CPU's vector registers hold
+ * (SSE2/AVX on the simulator, NEON on arm64) with a scalar loop for the rest
+ * and for CPUs without double precision vectors.
+ *
+ * @param distances     set to the distances (meters), points.size() of them
+ * @param bearings      optional, set to the bearings (degrees clockwise from
+ *                      true north, [0, 360))
+ */
+void distancesFrom(const GeoPoint &origin, const GeoPointArray &points, double *distances, double *bearings = 0);
+
+/**
+ * Indices of points, nearest to origin first.
+ *
+ * @param distances     optional, set to the distances (meters) in point order
+ * @param bearings      optional, set to the bearings (degrees) in point order
+ */
+std::vector<size_t> orderByDistance(const GeoPoint &origin, const GeoPointArray &points,
+                                    std::vector<double> *distances = 0, std::vector<double> *bearings = 0);
+
+} // namespace rtc
+
+#endif
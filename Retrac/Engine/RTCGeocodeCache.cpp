@@ -0,0 +1,287 @@
+//
+//  RTCGeocodeCache.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/16/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCGeocodeCache.h"
+#include <algorithm>
+#include <cmath>
+
+namespace rtc {
+
+#pragma mark - Constants
+static const uint32_t kGeocodeCacheFileMagic = 0x43475452; // "RTGC"
+static const uint32_t kGeocodeCacheFileVersion = 1;
+
+// meters per degree of latitude, for sizing cells
+static const double kMetersPerDegree = kEarthRadius * kDegreesToRadians;
+
+
+#pragma mark - Helpers
+template <typename T>
+static void writeValue(std::ostream &output, const T &value)
+{
+    output.write((const char *)&value, sizeof(value));
+}
+
+template <typename T>
+static bool readValue(std::istream &input, T &value)
+{
+    input.read((char *)&value, sizeof(value));
+    return (bool)input;
+}
+
+
+#pragma mark - GeocodeCache
+GeocodeCache::GeocodeCache(const Clock &clock, const GeocodePolicy &policy)
+    : _clock(clock), _policy(policy), _useCount(0), _inFlight(false), _nextLookupAt(-HUGE_VAL)
+{
+    _inFlightKey.latitude = _inFlightKey.longitude = 0;
+}
+
+GeocodeCache::Key GeocodeCache::keyFor(const GeoPoint &point) const
+{
+    Key key;
+    key.latitude = (int32_t)std::floor(point.latitude * kMetersPerDegree / _policy.cellSize);
+    key.longitude = (int32_t)std::floor(point.longitude * kMetersPerDegree / _policy.cellSize);
+    return key;
+}
+
+/**
+ * Entry for key if there is one young enough to use. Expired ones are dropped.
+ */
+GeocodeCache::Entry *GeocodeCache::freshEntry(const Key &key)
+{
+    std::map<Key, Entry>::iterator found = _entries.find(key);
+    if (found == _entries.end()) return 0;
+
+    if (_clock.now() - found->second.storedAt > _policy.maxAge) {
+        _entries.erase(found);
+        return 0;
+    }
+    found->second.lastUsed = ++_useCount;
+    return &found->second;
+}
+
+bool GeocodeCache::lookup(const GeoPoint &point, std::string *placemark)
+{
+    Entry *entry = freshEntry(keyFor(point));
+    if (!entry) return false;
+
+    if (placemark) *placemark = entry->placemark;
+    return true;
+}
+
+void GeocodeCache::store(const GeoPoint &point, const std::string &placemark)
+{
+    Entry &entry = _entries[keyFor(point)];
+    entry.placemark = placemark;
+    entry.storedAt = _clock.now();
+    entry.lastUsed = ++_useCount;
+    evict();
+}
+
+void GeocodeCache::clear()
+{
+    _entries.clear();
+    _useCount = 0;
+}
+
+/**
+ * Drop least recently used placemarks till we are within policy.maxEntries
+ */
+void GeocodeCache::evict()
+{
+    while (_entries.size() > _policy.maxEntries) {
+        std::map<Key, Entry>::iterator oldest = _entries.begin();
+        for (std::map<Key, Entry>::iterator it = _entries.begin(); it != _entries.end(); ++it) {
+            if (it->second.lastUsed < oldest->second.lastUsed) oldest = it;
+        }
+        _entries.erase(oldest);
+    }
+}
+
+
+#pragma mark - Requests
+GeocodeCache::RequestResult GeocodeCache::request(const GeoPoint &point, RequestID requestID, Priority priority,
+                                                  std::string *placemark)
+{
+    ++_stats.numRequests;
+    Key key = keyFor(point);
+
+    Entry *entry = freshEntry(key);
+    if (entry) {
+        ++_stats.numHits;
+        if (priority == PriorityUser) ++_stats.numUserAnswered;
+        if (placemark) *placemark = entry->placemark;
+        return RequestCached;
+    }
+
+    Waiter waiter;
+    waiter.requestID = requestID;
+    waiter.priority = priority;
+    waiter.requestedAt = _clock.now();
+
+    std::map<Key, Pending>::iterator found = _pending.find(key);
+    if (found != _pending.end()) {
+        Pending &pending = found->second;
+        pending.waiters.push_back(waiter);
+
+        // a user now waits on a background lookup, move it up
+        bool inFlight = _inFlight && (key == _inFlightKey);
+        if ((priority == PriorityUser) && !pending.urgent && !inFlight) {
+            pending.urgent = true;
+            _userQueue.push_back(key);
+        }
+        ++_stats.numJoined;
+        return RequestJoined;
+    }
+
+    Pending &pending = _pending[key];
+    pending.point = point;
+    pending.urgent = (priority == PriorityUser);
+    pending.waiters.push_back(waiter);
+    (pending.urgent ? _userQueue : _backgroundQueue).push_back(key);
+    return RequestQueued;
+}
+
+double GeocodeCache::nextLookupTime() const
+{
+    // every pending cell but the one in flight is queued
+    if (_inFlight || _pending.empty()) return HUGE_VAL;
+    return std::max(_nextLookupAt, _clock.now());
+}
+
+/**
+ * Front of queue that still has requests waiting on it. Cells that were moved
+ * up to the user queue or already looked up are skipped.
+ */
+bool GeocodeCache::popQueue(std::deque<Key> &queue, Key *key)
+{
+    while (!queue.empty()) {
+        Key front = queue.front();
+        queue.pop_front();
+        if (_pending.count(front)) {
+            *key = front;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool GeocodeCache::startLookup(GeoPoint *point)
+{
+    double now = _clock.now();
+    if (_inFlight || _pending.empty() || (now < _nextLookupAt)) return false;
+
+    Key key;
+    if (!popQueue(_userQueue, &key) && !popQueue(_backgroundQueue, &key)) return false;
+
+    _inFlight = true;
+    _inFlightKey = key;
+    _nextLookupAt = now + _policy.minLookupInterval;
+    ++_stats.numLookups;
+
+    *point = _pending[key].point;
+    return true;
+}
+
+std::vector<GeocodeCache::RequestID> GeocodeCache::finishLookup(bool success, const std::string &placemark)
+{
+    std::vector<RequestID> requestIDs;
+    if (!_inFlight) return requestIDs;
+    _inFlight = false;
+
+    double now = _clock.now();
+    std::map<Key, Pending>::iterator found = _pending.find(_inFlightKey);
+    if (found == _pending.end()) return requestIDs;
+
+    if (success) {
+        store(found->second.point, placemark);
+    } else {
+        // the geocoder is most likely throttling us, give it a rest
+        ++_stats.numFailures;
+        _nextLookupAt = std::max(_nextLookupAt, now + _policy.failureBackoff);
+    }
+
+    const std::vector<Waiter> &waiters = found->second.waiters;
+    for (size_t i = 0; i < waiters.size(); ++i) {
+        requestIDs.push_back(waiters[i].requestID);
+        if (waiters[i].priority != PriorityUser) continue;
+
+        double latency = now - waiters[i].requestedAt;
+        ++_stats.numUserAnswered;
+        _stats.totalUserLatency += latency;
+        _stats.maxUserLatency = std::max(_stats.maxUserLatency, latency);
+    }
+
+    _pending.erase(found);
+    return requestIDs;
+}
+
+
+#pragma mark - Serialization
+void GeocodeCache::write(std::ostream &output) const
+{
+    writeValue(output, kGeocodeCacheFileMagic);
+    writeValue(output, kGeocodeCacheFileVersion);
+    writeValue(output, _policy.cellSize);
+    writeValue(output, (uint32_t)_entries.size());
+
+    // least recently used first, so reading it back keeps the order
+    std::vector<std::map<Key, Entry>::const_iterator> order;
+    for (std::map<Key, Entry>::const_iterator it = _entries.begin(); it != _entries.end(); ++it) {
+        order.push_back(it);
+    }
+    std::sort(order.begin(), order.end(), [](std::map<Key, Entry>::const_iterator a,
+                                             std::map<Key, Entry>::const_iterator b) {
+        return a->second.lastUsed < b->second.lastUsed;
+    });
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        const Key &key = order[i]->first;
+        const Entry &entry = order[i]->second;
+        writeValue(output, key.latitude);
+        writeValue(output, key.longitude);
+        writeValue(output, entry.storedAt);
+        writeValue(output, (uint32_t)entry.placemark.size());
+        output.write(entry.placemark.data(), entry.placemark.size());
+    }
+}
+
+bool GeocodeCache::read(std::istream &input)
+{
+    uint32_t magic = 0, version = 0, count = 0;
+    double cellSize = 0;
+    if (!readValue(input, magic) || !readValue(input, version) || !readValue(input, cellSize) ||
+        !readValue(input, count) || (magic != kGeocodeCacheFileMagic) ||
+        (version != kGeocodeCacheFileVersion) || (cellSize != _policy.cellSize)) {
+        return false;
+    }
+
+    std::map<Key, Entry> entries;
+    for (uint32_t e = 0; e < count; ++e) {
+        Key key;
+        Entry entry;
+        uint32_t length;
+        if (!readValue(input, key.latitude) || !readValue(input, key.longitude) ||
+            !readValue(input, entry.storedAt) || !readValue(input, length)) {
+            return false;
+        }
+        entry.placemark.resize(length);
+        if (length && !input.read(&entry.placemark[0], length)) return false;
+
+        entry.lastUsed = e;
+        entries[key] = entry;
+    }
+
+    _entries.swap(entries);
+    _useCount = count;
+    evict();
+    return true;
+}
+
+} // namespace rtc
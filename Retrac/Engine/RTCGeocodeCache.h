@@ -0,0 +1,228 @@
+//
+//  RTCGeocodeCache.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/16/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this
+//  can be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCGeocodeCache_h
+#define Retrac_RTCGeocodeCache_h
+
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "RTCClock.h"
+#include "RTCGeo.h"
+
+namespace rtc {
+
+/**
+ * GeocodePolicy holds the knobs that trade placemark freshness and lookup
+ * pacing for requests. The default values mirror the geocoding settings in
+ * RTCConstants.m
+ */
+struct GeocodePolicy {
+    double cellSize;            // kRTCGeocodeCacheCellSize
+    double maxAge;              // kRTCGeocodeCacheMaxAge
+    unsigned maxEntries;        // kRTCGeocodeCacheMaxEntries
+    double minLookupInterval;   // kRTCGeocodeMinLookupInterval
+    double failureBackoff;      // kRTCGeocodeFailureBackoff
+
+    GeocodePolicy()
+        : cellSize(15.0), maxAge(30.0 * 24.0 * 3600.0), maxEntries(1000),
+          minLookupInterval(1.5), failureBackoff(60.0) {}
+};
+
+/**
+ * GeocodeCache sits between everything that wants a location's placemark and
+ * the reverse geocoder, which answers one request at a time, slowly, and
+ * throttles apps that ask too often.
+ *
+ * Placemarks are opaque bytes (an archived CLPlacemark on device) keyed by
+ * their location quantized to cells of policy.cellSize meters, so a place and
+ * the spot the user stood on when saving it share an entry. Entries older
+ * than policy.maxAge are looked up again, and the least recently used goes
+ * once there are more than policy.maxEntries.
+ *
+ * A request the cache can't answer joins the lookup already pending for its
+ * cell if there is one, else queues a new lookup. The host drains the queue
+ * one lookup at a time through startLookup()/finishLookup(), no sooner than
+ * policy.minLookupInterval apart, backing off policy.failureBackoff after a
+ * failure. User requests jump ahead of background ones, such as filling in
+ * placemarks for places saved without a network.
+ *
+ * Latency counters only cover user requests; background requests are
+ * expected to wait.
+ */
+class GeocodeCache {
+public:
+    typedef uint64_t RequestID;
+
+    enum Priority {
+        PriorityUser,           // someone is looking at the screen
+        PriorityBackground
+    };
+
+    enum RequestResult {
+        RequestCached,          // answered from the cache
+        RequestJoined,          // waiting on a lookup already pending
+        RequestQueued           // waiting on a new lookup
+    };
+
+    /**
+     * Running counts since the cache was created or resetStats()
+     */
+    struct Stats {
+        unsigned numRequests;
+        unsigned numHits;
+        unsigned numJoined;
+        unsigned numLookups;    // lookups started
+        unsigned numFailures;   // lookups that failed
+        unsigned numUserAnswered;
+        double totalUserLatency;
+        double maxUserLatency;
+
+        Stats()
+            : numRequests(0), numHits(0), numJoined(0), numLookups(0), numFailures(0),
+              numUserAnswered(0), totalUserLatency(0), maxUserLatency(0) {}
+
+        double hitRate() const { return numRequests ? (double)numHits / numRequests : 0.0; }
+        double meanUserLatency() const { return numUserAnswered ? totalUserLatency / numUserAnswered : 0.0; }
+    };
+
+    /**
+     * @param clock     time source, must outlive the cache
+     * @param policy    cache knobs
+     */
+    explicit GeocodeCache(const Clock &clock, const GeocodePolicy &policy = GeocodePolicy());
+
+    const GeocodePolicy &policy() const { return _policy; }
+    const Stats &stats() const { return _stats; }
+    void resetStats() { _stats = Stats(); }
+
+    /**
+     * Cached placemark of the cell point is in, without counting a request.
+     *
+     * @return false if there is none or it has expired.
+     */
+    bool lookup(const GeoPoint &point, std::string *placemark);
+
+    /**
+     * Remember the placemark of point's cell, replacing any there was.
+     */
+    void store(const GeoPoint &point, const std::string &placemark);
+
+    /**
+     * Ask for the placemark of point.
+     *
+     * @param requestID     caller's handle, handed back by finishLookup()
+     * @param placemark     set if the result is RequestCached
+     */
+    RequestResult request(const GeoPoint &point, RequestID requestID, Priority priority, std::string *placemark);
+
+    /**
+     * Time (clock seconds) the next lookup may start, HUGE_VAL if there is
+     * nothing to look up or a lookup is in flight.
+     */
+    double nextLookupTime() const;
+
+    bool lookupInFlight() const { return _inFlight; }
+
+    /**
+     * Number of cells waiting on a lookup, the one in flight included
+     */
+    size_t numPending() const { return _pending.size(); }
+
+    /**
+     * Take the next lookup off the queue if one may start now.
+     *
+     * @param point     set to the location to reverse geocode
+     *
+     * @return false if nothing may start yet.
+     */
+    bool startLookup(GeoPoint *point);
+
+    /**
+     * Finish the lookup in flight, caching the placemark if it succeeded.
+     *
+     * @return the requests that were waiting on it, oldest first.
+     */
+    std::vector<RequestID> finishLookup(bool success, const std::string &placemark);
+
+    void clear();
+    size_t size() const { return _entries.size(); }
+
+    /**
+     * Binary serialization. Pending requests aren't saved.
+     *
+     * @return false if the stream is short, not a geocode cache, or was
+     *      written with a different cell size.
+     */
+    void write(std::ostream &output) const;
+    bool read(std::istream &input);
+
+private:
+    struct Key {
+        int32_t latitude, longitude;
+
+        bool operator<(const Key &other) const {
+            return (latitude != other.latitude) ? (latitude < other.latitude) : (longitude < other.longitude);
+        }
+        bool operator==(const Key &other) const {
+            return (latitude == other.latitude) && (longitude == other.longitude);
+        }
+    };
+
+    struct Entry {
+        std::string placemark;
+        double storedAt;
+        uint64_t lastUsed;
+
+        Entry() : storedAt(0), lastUsed(0) {}
+    };
+
+    struct Waiter {
+        RequestID requestID;
+        Priority priority;
+        double requestedAt;
+    };
+
+    struct Pending {
+        GeoPoint point;         // first location asked for in the cell
+        bool urgent;            // has a user request waiting
+        std::vector<Waiter> waiters;
+
+        Pending() : urgent(false) {}
+    };
+
+    Key keyFor(const GeoPoint &point) const;
+    Entry *freshEntry(const Key &key);
+    bool popQueue(std::deque<Key> &queue, Key *key);
+    void evict();
+
+    const Clock &_clock;
+    GeocodePolicy _policy;
+    std::map<Key, Entry> _entries;
+    uint64_t _useCount;
+
+    // lookups waiting to start or in flight. A cell may be in both queues
+    // once a user asks for it after the background did.
+    std::map<Key, Pending> _pending;
+    std::deque<Key> _userQueue, _backgroundQueue;
+    bool _inFlight;
+    Key _inFlightKey;
+    double _nextLookupAt;
+
+    Stats _stats;
+};
+
+} // namespace rtc
+
+#endif
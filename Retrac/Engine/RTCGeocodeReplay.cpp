@@ -0,0 +1,138 @@
+//
+//  RTCGeocodeReplay.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/16/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCGeocodeReplay.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include "RTCTrace.h"
+
+namespace rtc {
+
+#pragma mark - Constants
+// meters per degree of latitude, for sizing blocks
+static const double kMetersPerDegree = kEarthRadius * kDegreesToRadians;
+
+// window the fake provider's rate limit applies to
+static const double kThrottleWindow = 60.0;
+
+
+#pragma mark - Helpers
+static void summarizeLatencies(std::vector<double> &latencies, GeocodeReplaySummary &summary)
+{
+    double sum = 0;
+    for (size_t i = 0; i < latencies.size(); ++i) sum += latencies[i];
+    std::sort(latencies.begin(), latencies.end());
+
+    summary.meanLatency = latencies.empty() ? 0 : sum / latencies.size();
+    summary.p90Latency = percentile(latencies, 0.9);
+}
+
+
+#pragma mark - FakeGeocodeProvider
+bool FakeGeocodeProvider::reverseGeocode(const GeoPoint &point, double now, std::string &placemark)
+{
+    ++_numRequests;
+
+    while (!_recentRequests.empty() && (_recentRequests.front() <= now - kThrottleWindow)) {
+        _recentRequests.pop_front();
+    }
+    bool throttled = (_recentRequests.size() >= _maxRequestsPerMinute);
+    _recentRequests.push_back(now);
+    if (throttled) {
+        ++_numThrottled;
+        return false;
+    }
+
+    double metersPerDegreeLongitude = kMetersPerDegree * std::cos(point.latitude * kDegreesToRadians);
+    std::ostringstream name;
+    name << "Block " << (long)std::floor(point.latitude * kMetersPerDegree / _blockSize)
+         << ", " << (long)std::floor(point.longitude * metersPerDegreeLongitude / _blockSize);
+    placemark = name.str();
+    return true;
+}
+
+
+#pragma mark - Replay
+GeocodeReplaySummary replayGeocodeRequests(const GeocodeRequestTrace &trace, GeocodeProvider &provider,
+                                           double providerLatency, const GeocodePolicy &policy)
+{
+    GeocodeReplaySummary summary;
+    summary.numRequests = (unsigned)trace.size();
+
+    ManualClock clock(0.0);
+    GeocodeCache cache(clock, policy);
+    std::vector<double> latencies;
+
+    // the lookup in flight, if any
+    bool inFlight = false, succeeded = false;
+    double finishAt = 0;
+    std::string placemark;
+
+    // request IDs are trace indices
+    size_t next = 0;
+    while ((next < trace.size()) || inFlight || cache.numPending()) {
+        double arrival = (next < trace.size()) ? trace[next].time : HUGE_VAL;
+        double finish = inFlight ? finishAt : HUGE_VAL;
+        double start = cache.nextLookupTime();
+
+        if ((finish <= arrival) && (finish <= start)) {
+            clock.setNow(finish);
+            inFlight = false;
+            std::vector<GeocodeCache::RequestID> answered = cache.finishLookup(succeeded, placemark);
+            for (size_t i = 0; i < answered.size(); ++i) {
+                const GeocodeRequest &request = trace[answered[i]];
+                if (!succeeded) ++summary.numFailures;
+                if (request.priority == GeocodeCache::PriorityUser) latencies.push_back(finish - request.time);
+            }
+
+        } else if (arrival <= start) {
+            clock.setNow(arrival);
+            const GeocodeRequest &request = trace[next];
+            if ((cache.request(request.point, next, request.priority, 0) == GeocodeCache::RequestCached) &&
+                (request.priority == GeocodeCache::PriorityUser)) {
+                latencies.push_back(0.0);
+            }
+            ++next;
+
+        } else {
+            clock.setNow(start);
+            GeoPoint point;
+            if (!cache.startLookup(&point)) break;     // can't happen, but don't spin if it does
+            succeeded = provider.reverseGeocode(point, start, placemark);
+            inFlight = true;
+            finishAt = start + providerLatency;
+        }
+    }
+
+    summary.numHits = cache.stats().numHits;
+    summary.numJoined = cache.stats().numJoined;
+    summary.numProviderCalls = cache.stats().numLookups;
+    summarizeLatencies(latencies, summary);
+    return summary;
+}
+
+GeocodeReplaySummary replayDirectGeocodeRequests(const GeocodeRequestTrace &trace, GeocodeProvider &provider,
+                                                 double providerLatency)
+{
+    GeocodeReplaySummary summary;
+    summary.numRequests = (unsigned)trace.size();
+    summary.numProviderCalls = (unsigned)trace.size();
+
+    std::vector<double> latencies;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        std::string placemark;
+        if (!provider.reverseGeocode(trace[i].point, trace[i].time, placemark)) ++summary.numFailures;
+        if (trace[i].priority == GeocodeCache::PriorityUser) latencies.push_back(providerLatency);
+    }
+
+    summarizeLatencies(latencies, summary);
+    return summary;
+}
+
+} // namespace rtc
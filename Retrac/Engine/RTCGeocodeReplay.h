@@ -0,0 +1,121 @@
+//
+//  RTCGeocodeReplay.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/16/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this
+//  can be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCGeocodeReplay_h
+#define Retrac_RTCGeocodeReplay_h
+
+#include <deque>
+#include <vector>
+#include "RTCGeocodeCache.h"
+
+namespace rtc {
+
+/**
+ * GeocodeProvider is whatever reverse geocodes locations. On device that is
+ * CLGeocoder; headlessly it is a stand-in.
+ */
+class GeocodeProvider {
+public:
+    virtual ~GeocodeProvider() {}
+
+    /**
+     * @param now   time of the request (seconds), for providers that throttle
+     *
+     * @return false if the location couldn't be geocoded.
+     */
+    virtual bool reverseGeocode(const GeoPoint &point, double now, std::string &placemark) = 0;
+};
+
+/**
+ * FakeGeocodeProvider is a local stand-in for CLGeocoder. The "placemark" of a
+ * location names the city block (`blockSize` meters on a side) it falls in,
+ * and like the real service it fails every request once more than
+ * `maxRequestsPerMinute` have been made in the last minute.
+ */
+class FakeGeocodeProvider : public GeocodeProvider {
+public:
+    explicit FakeGeocodeProvider(double blockSize = 50.0, unsigned maxRequestsPerMinute = 50)
+        : _blockSize(blockSize), _maxRequestsPerMinute(maxRequestsPerMinute),
+          _numRequests(0), _numThrottled(0) {}
+
+    bool reverseGeocode(const GeoPoint &point, double now, std::string &placemark);
+
+    /**
+     * Number of requests made so far, and how many of them were throttled
+     */
+    size_t numRequests() const { return _numRequests; }
+    size_t numThrottled() const { return _numThrottled; }
+
+private:
+    double _blockSize;
+    unsigned _maxRequestsPerMinute;
+    std::deque<double> _recentRequests;     // times of requests in the last minute
+    size_t _numRequests, _numThrottled;
+};
+
+/**
+ * GeocodeRequest is one time a placemark was wanted: a screen showing an
+ * address, or a place saved without one being filled in.
+ */
+struct GeocodeRequest {
+    double time;                // seconds since start
+    GeoPoint point;
+    GeocodeCache::Priority priority;
+
+    GeocodeRequest() : time(0), priority(GeocodeCache::PriorityUser) {}
+    GeocodeRequest(double t, const GeoPoint &aPoint, GeocodeCache::Priority aPriority = GeocodeCache::PriorityUser)
+        : time(t), point(aPoint), priority(aPriority) {}
+};
+
+typedef std::vector<GeocodeRequest> GeocodeRequestTrace;
+
+/**
+ * Outcome of replaying a request trace. Latency is how long user requests
+ * waited for a placemark, failures included.
+ */
+struct GeocodeReplaySummary {
+    unsigned numRequests;
+    unsigned numHits;
+    unsigned numJoined;         // coalesced onto a pending lookup
+    unsigned numProviderCalls;
+    unsigned numFailures;       // requests answered with no placemark
+    double meanLatency;
+    double p90Latency;
+
+    GeocodeReplaySummary()
+        : numRequests(0), numHits(0), numJoined(0), numProviderCalls(0), numFailures(0),
+          meanLatency(0), p90Latency(0) {}
+
+    double hitRate() const { return numRequests ? (double)numHits / numRequests : 0.0; }
+};
+
+/**
+ * Replay a request trace through a fresh GeocodeCache running on virtual time,
+ * feeding its lookups to provider one at a time.
+ *
+ * @param trace             requests in time order
+ * @param provider          answers the cache's lookups
+ * @param providerLatency   seconds each provider call takes
+ * @param policy            cache knobs
+ */
+GeocodeReplaySummary replayGeocodeRequests(const GeocodeRequestTrace &trace, GeocodeProvider &provider,
+                                           double providerLatency,
+                                           const GeocodePolicy &policy = GeocodePolicy());
+
+/**
+ * Replay a request trace the way each screen used to geocode on its own:
+ * every request goes straight to the provider, as soon as it's made.
+ */
+GeocodeReplaySummary replayDirectGeocodeRequests(const GeocodeRequestTrace &trace, GeocodeProvider &provider,
+                                                 double providerLatency);
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,300 @@
+//
+//  RTCGeofenceEngine.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/23/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCGeofenceEngine.h"
+#include <algorithm>
+#include <limits>
+
+namespace rtc {
+
+#pragma mark - Constants
+// a fix's horizontal accuracy is about one standard deviation, so it takes
+// this many of them to be sure which side of an edge the user is on
+static const double kCertainAccuracies = 2.0;
+
+
+#pragma mark - Helpers
+static double clamp(double value, double low, double high)
+{
+    return std::min(std::max(value, low), high);
+}
+
+static bool earlierEvent(const GeofenceEngine::Event &a, const GeofenceEngine::Event &b)
+{
+    return (a.time < b.time) || ((a.time == b.time) && (a.placeID < b.placeID));
+}
+
+
+#pragma mark - GeofenceEngine
+GeofenceEngine::GeofenceEngine(const Clock &clock, const GeofencePolicy &policy)
+    : _clock(clock), _policy(policy), _hasLastFix(false), _numRecomputations(0)
+{
+}
+
+bool GeofenceEngine::assignPlaces(const std::vector<Place> &places)
+{
+    std::unordered_map<PlaceID, Place> previous;
+    previous.swap(_places);
+
+    std::vector<SpatialIndex::Record> records;
+    records.reserve(places.size());
+    for (size_t i = 0; i < places.size(); ++i) {
+        _places[places[i].placeID] = places[i];
+        records.push_back(SpatialIndex::Record(places[i].placeID, places[i].coordinate));
+    }
+    _index.assign(records);
+
+    // forget everything about places that went away or moved
+    for (std::unordered_map<PlaceID, Place>::const_iterator it = previous.begin(); it != previous.end(); ++it) {
+        std::unordered_map<PlaceID, Place>::const_iterator place = _places.find(it->first);
+        if ((place != _places.end()) &&
+            (place->second.coordinate.latitude == it->second.coordinate.latitude) &&
+            (place->second.coordinate.longitude == it->second.coordinate.longitude)) {
+            continue;
+        }
+        _tracking.erase(it->first);
+        _overdue.erase(it->first);
+    }
+
+    if (!_hasLastFix) return false;
+
+    // new places only take their first state from the last fix, so there is
+    // nothing to report
+    std::vector<Event> events;
+    recompute(GeoPoint(_lastFix.latitude, _lastFix.longitude));
+    evaluate(_lastFix, events);
+    return true;
+}
+
+bool GeofenceEngine::processFix(const LocationFix &fix, std::vector<Event> &events)
+{
+    if (!acceptFix(fix)) return false;
+
+    bool changed = false;
+    GeoPoint position(fix.latitude, fix.longitude);
+    if ((_numRecomputations == 0) ||
+        (distanceBetween(position, _refreshRegion.center) > _refreshRegion.radius)) {
+        recompute(position);
+        changed = true;
+    }
+    if (evaluate(fix, events)) changed = true;
+    collectOverdue(_clock.now(), events);
+    return changed;
+}
+
+bool GeofenceEngine::processRefreshRegionExit(const LocationFix &fix, std::vector<Event> &events)
+{
+    if (!acceptFix(fix)) return false;
+
+    recompute(GeoPoint(fix.latitude, fix.longitude));
+    evaluate(fix, events);
+    collectOverdue(_clock.now(), events);
+    return true;
+}
+
+void GeofenceEngine::handleTimeout(std::vector<Event> &events)
+{
+    collectOverdue(_clock.now(), events);
+}
+
+double GeofenceEngine::deadline() const
+{
+    double deadline = std::numeric_limits<double>::infinity();
+    for (std::unordered_map<PlaceID, double>::const_iterator it = _overdue.begin(); it != _overdue.end(); ++it) {
+        deadline = std::min(deadline, it->second);
+    }
+    return deadline;
+}
+
+double GeofenceEngine::timeoutDelay() const
+{
+    double delay = deadline() - _clock.now();
+    return (delay > 0) ? delay : 0;
+}
+
+bool GeofenceEngine::awaitingConfirmation() const
+{
+    for (std::unordered_map<PlaceID, Tracking>::const_iterator it = _tracking.begin(); it != _tracking.end(); ++it) {
+        const Tracking &tracking = it->second;
+        if (tracking.pending != PlaceStateUnknown) return true;
+        if (tracking.watching && (_lastFix.timestamp - tracking.watchingSince < _policy.dwellTime)) return true;
+    }
+    return false;
+}
+
+std::vector<GeofenceEngine::Region> GeofenceEngine::regions() const
+{
+    std::vector<Region> regions;
+    regions.reserve(_monitored.size());
+    for (size_t i = 0; i < _monitored.size(); ++i) {
+        const Place &place = _places.find(_monitored[i])->second;
+        bool inside = (_tracking.find(place.placeID)->second.state == PlaceStateInside);
+        double radius = inside ? _policy.radius + _policy.exitHysteresis : _policy.radius;
+        regions.push_back(Region(place.placeID, place.coordinate, radius));
+    }
+    return regions;
+}
+
+GeofenceEngine::PlaceState GeofenceEngine::placeState(PlaceID placeID) const
+{
+    std::unordered_map<PlaceID, Tracking>::const_iterator it = _tracking.find(placeID);
+    return (it != _tracking.end()) ? it->second.state : PlaceStateUnknown;
+}
+
+/**
+ * Take note of a valid, in-order fix.
+ *
+ * @return false if the fix should be ignored.
+ */
+bool GeofenceEngine::acceptFix(const LocationFix &fix)
+{
+    if (fix.horizontalAccuracy < 0) return false;
+    if (_hasLastFix && (fix.timestamp < _lastFix.timestamp)) return false;
+
+    _lastFix = fix;
+    _hasLastFix = true;
+    return true;
+}
+
+/**
+ * Monitor the places nearest origin, carrying over the state of those that
+ * were already monitored, and put the refresh region just short of the
+ * nearest one left out.
+ */
+void GeofenceEngine::recompute(const GeoPoint &origin)
+{
+    ++_numRecomputations;
+
+    size_t numSlots = std::max(_policy.maxRegions, 2u) - 1;
+    std::vector<SpatialIndex::Neighbor> nearest = _index.nearest(origin, numSlots + 1);
+
+    double refreshRadius = _policy.maxRefreshRadius;
+    if (nearest.size() > numSlots) {
+        refreshRadius = nearest.back().distance - _policy.radius - _policy.exitHysteresis;
+        nearest.pop_back();
+    }
+    _refreshRegion = Region(0, origin, clamp(refreshRadius, _policy.minRefreshRadius, _policy.maxRefreshRadius));
+
+    std::unordered_map<PlaceID, Tracking> tracking;
+    _monitored.clear();
+    for (size_t i = 0; i < nearest.size(); ++i) {
+        PlaceID placeID = nearest[i].placeID;
+        std::unordered_map<PlaceID, Tracking>::const_iterator it = _tracking.find(placeID);
+        tracking[placeID] = (it != _tracking.end()) ? it->second : Tracking();
+        _monitored.push_back(placeID);
+    }
+    _tracking.swap(tracking);
+}
+
+/**
+ * Run fix past every monitored place, appending any arrivals and departures.
+ *
+ * @return true if a place's state changed.
+ */
+bool GeofenceEngine::evaluate(const LocationFix &fix, std::vector<Event> &events)
+{
+    GeoPoint position(fix.latitude, fix.longitude);
+    double accuracy = fix.horizontalAccuracy;
+    double exitRadius = _policy.radius + _policy.exitHysteresis;
+    bool changed = false;
+
+    for (size_t i = 0; i < _monitored.size(); ++i) {
+        const Place &place = _places.find(_monitored[i])->second;
+        Tracking &tracking = _tracking[place.placeID];
+        double distance = distanceBetween(position, place.coordinate);
+
+        // what this fix says about the place, and how sure it is
+        PlaceState observed = PlaceStateUnknown;
+        bool certain = true;
+        if (distance + kCertainAccuracies * accuracy <= _policy.radius) {
+            observed = PlaceStateInside;
+        } else if (distance - kCertainAccuracies * accuracy >= exitRadius) {
+            observed = PlaceStateOutside;
+        } else if (accuracy <= _policy.maxAccuracy) {
+            certain = false;
+            if (distance <= _policy.radius) observed = PlaceStateInside;
+            else if (distance >= exitRadius) observed = PlaceStateOutside;
+        } else {
+            // too coarse to say which side the user is on, but the OS may
+            // have woken us for a crossing, so get a better fix
+            if (!tracking.watching) tracking.watchingSince = fix.timestamp;
+            tracking.watching = true;
+            continue;
+        }
+
+        // near the edge: keep fixes coming for a while to see which way it goes
+        if (observed == PlaceStateUnknown) {
+            if (!tracking.watching) tracking.watchingSince = fix.timestamp;
+            tracking.watching = true;
+        } else {
+            tracking.watching = false;
+        }
+
+        // the first state isn't an event, so any fix that isn't coarse settles
+        // it. One in the band isn't inside the radius, so it hasn't arrived.
+        if (tracking.state == PlaceStateUnknown) {
+            tracking.state = (observed == PlaceStateUnknown) ? PlaceStateOutside : observed;
+            tracking.pending = PlaceStateUnknown;
+            changed = true;
+            continue;
+        }
+
+        // one stray fix doesn't undo a dwell, two in a row do
+        if ((observed == PlaceStateUnknown) || (observed == tracking.state)) {
+            if ((tracking.pending != PlaceStateUnknown) && !tracking.contradicted) {
+                tracking.contradicted = true;
+            } else {
+                tracking.pending = PlaceStateUnknown;
+            }
+            continue;
+        }
+
+        // a certain fix still needs the one before to agree, so a single
+        // wild fix claiming to be accurate can't flip the place
+        bool agreed = (tracking.pending == observed) && !tracking.contradicted;
+        if (tracking.pending != observed) {
+            tracking.pending = observed;
+            tracking.pendingSince = fix.timestamp;
+        }
+        tracking.contradicted = false;
+        if (!(certain && agreed) && (fix.timestamp - tracking.pendingSince < _policy.dwellTime)) continue;
+
+        tracking.state = observed;
+        tracking.pending = PlaceStateUnknown;
+        changed = true;
+
+        if (observed == PlaceStateInside) {
+            events.push_back(Event(Event::TypeArrival, place.placeID, fix.timestamp));
+            _overdue.erase(place.placeID);
+        } else {
+            events.push_back(Event(Event::TypeDeparture, place.placeID, fix.timestamp));
+            if (place.timeout > 0) _overdue[place.placeID] = fix.timestamp + place.timeout;
+        }
+    }
+    return changed;
+}
+
+/**
+ * Append an overdue event for each overdue clock that ran out by now, in the
+ * order they ran out.
+ */
+void GeofenceEngine::collectOverdue(double now, std::vector<Event> &events)
+{
+    size_t first = events.size();
+    for (std::unordered_map<PlaceID, double>::iterator it = _overdue.begin(); it != _overdue.end(); ) {
+        if (it->second <= now) {
+            events.push_back(Event(Event::TypeOverdue, it->first, it->second));
+            it = _overdue.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    std::sort(events.begin() + first, events.end(), earlierEvent);
+}
+
+} // namespace rtc
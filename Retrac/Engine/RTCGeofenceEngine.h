@@ -0,0 +1,234 @@
+//
+//  RTCGeofenceEngine.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/23/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCGeofenceEngine_h
+#define Retrac_RTCGeofenceEngine_h
+
+#include <unordered_map>
+#include <vector>
+#include "RTCClock.h"
+#include "RTCLocationFixEngine.h"
+#include "RTCSpatialIndex.h"
+
+namespace rtc {
+
+/**
+ * GeofencePolicy holds the knobs that trade event latency against false
+ * events and power. The default values mirror the geofence settings in
+ * RTCConstants.m
+ */
+struct GeofencePolicy {
+    unsigned maxRegions;        // kRTCGeofenceMaxRegions, including the refresh region
+    double radius;              // kRTCGeofenceRadius
+    double exitHysteresis;      // kRTCGeofenceExitHysteresis
+    double maxAccuracy;         // kRTCGeofenceMaxAccuracy
+    double dwellTime;           // kRTCGeofenceDwellTime
+    double minRefreshRadius;    // kRTCGeofenceMinRefreshRadius
+    double maxRefreshRadius;    // kRTCGeofenceMaxRefreshRadius
+
+    GeofencePolicy()
+        : maxRegions(20), radius(100.0), exitHysteresis(50.0), maxAccuracy(100.0),
+          dwellTime(30.0), minRefreshRadius(150.0), maxRefreshRadius(20000.0) {}
+};
+
+/**
+ * GeofenceEngine decides when the user arrives at, departs from, or is overdue
+ * back at their saved places. The host turns what it asks for into OS region
+ * monitoring and feeds it whatever fixes those regions wake it up with.
+ *
+ * Regions
+ * - The OS only monitors a handful of regions per app, so just the
+ *   policy.maxRegions - 1 places nearest the last fix are monitored.
+ * - The last region is a refresh region around that fix, just short of the
+ *   nearest place left out. Nothing else can be reached without leaving it, so
+ *   the set is only recomputed then (or on a fix outside it), rather than
+ *   keeping the GPS on to track the user.
+ *
+ * Events
+ * - A fix inside policy.radius of a place, or outside policy.radius +
+ *   policy.exitHysteresis of it, counts if it is no worse than
+ *   policy.maxAccuracy. The place changes state once fixes have agreed for
+ *   policy.dwellTime; two fixes in a row that don't (the hysteresis band in
+ *   between included) cancel it. Jitter at the boundary of a place never
+ *   fires events.
+ * - A fix that is on one side by twice its accuracy cuts the wait short: it
+ *   only needs the fix before it to agree.
+ * - The first state a place is seen in after it starts being monitored is
+ *   not an event. A fix in the band counts as outside for it.
+ * - Departing a place with a timeout starts its overdue clock; arriving back
+ *   before it runs out stops it. Like LocationFixEngine, the engine owns no
+ *   timers: the host schedules one at deadline() and calls handleTimeout().
+ */
+class GeofenceEngine {
+public:
+    typedef SpatialIndex::PlaceID PlaceID;
+
+    enum PlaceState {
+        PlaceStateUnknown,
+        PlaceStateInside,
+        PlaceStateOutside
+    };
+
+    /**
+     * A saved place to watch
+     */
+    struct Place {
+        PlaceID placeID;
+        GeoPoint coordinate;
+        double timeout;         // seconds away before the user is overdue, 0 for never
+
+        Place() : placeID(0), timeout(0) {}
+        Place(PlaceID anID, const GeoPoint &aCoordinate, double aTimeout = 0)
+            : placeID(anID), coordinate(aCoordinate), timeout(aTimeout) {}
+    };
+
+    /**
+     * A circle the host should have the OS monitor
+     */
+    struct Region {
+        PlaceID placeID;        // 0 for the refresh region
+        GeoPoint center;
+        double radius;          // meters
+
+        Region() : placeID(0), radius(0) {}
+        Region(PlaceID anID, const GeoPoint &aCenter, double aRadius)
+            : placeID(anID), center(aCenter), radius(aRadius) {}
+    };
+
+    struct Event {
+        enum Type {
+            TypeArrival,
+            TypeDeparture,
+            TypeOverdue
+        };
+
+        Type type;
+        PlaceID placeID;
+        double time;            // timestamp of the deciding fix, or when the timeout ran out
+
+        Event() : type(TypeArrival), placeID(0), time(0) {}
+        Event(Type aType, PlaceID anID, double t) : type(aType), placeID(anID), time(t) {}
+    };
+
+    /**
+     * @param clock     time source for overdue timeouts, must outlive the engine
+     * @param policy    latency/accuracy/power knobs
+     */
+    explicit GeofenceEngine(const Clock &clock, const GeofencePolicy &policy = GeofencePolicy());
+
+    const GeofencePolicy &policy() const { return _policy; }
+
+    /**
+     * Replace the places being watched. Places keeping their ID and coordinate
+     * keep their state and overdue clock.
+     *
+     * @return true if the regions to monitor changed.
+     */
+    bool assignPlaces(const std::vector<Place> &places);
+
+    size_t numPlaces() const { return _places.size(); }
+
+    /**
+     * Feed a fix. Invalid fixes and fixes older than the last one are ignored.
+     *
+     * @param events    arrivals, departures and overdues are appended here
+     *
+     * @return true if the regions to monitor changed.
+     */
+    bool processFix(const LocationFix &fix, std::vector<Event> &events);
+
+    /**
+     * The OS says the user left the refresh region. Recompute the monitored
+     * places around fix even if it doesn't look outside the region itself.
+     */
+    bool processRefreshRegionExit(const LocationFix &fix, std::vector<Event> &events);
+
+    /**
+     * Host's timeout fired. Appends the overdue events that are due.
+     */
+    void handleTimeout(std::vector<Event> &events);
+
+    /**
+     * Absolute time of the next overdue event, infinity if there is none
+     */
+    double deadline() const;
+
+    /**
+     * Seconds from now till the deadline, never negative.
+     */
+    double timeoutDelay() const;
+
+    /**
+     * Has a place seen a fix that would change its state but still needs
+     * policy.dwellTime of agreeing fixes, or a fix in its hysteresis band or
+     * too coarse to place the user in the last policy.dwellTime? The host should keep fixes coming while this
+     * is true and can let the GPS sleep otherwise.
+     */
+    bool awaitingConfirmation() const;
+
+    /**
+     * Places to monitor, nearest first. An inside place's region is widened
+     * by policy.exitHysteresis so the OS wakes us up to confirm the departure.
+     */
+    std::vector<Region> regions() const;
+
+    /**
+     * Region whose exit means the monitored places need recomputing. Only
+     * valid once hasPosition().
+     */
+    const Region &refreshRegion() const { return _refreshRegion; }
+
+    bool hasPosition() const { return _hasLastFix; }
+
+    PlaceState placeState(PlaceID placeID) const;
+
+    /**
+     * Number of times the monitored places were recomputed
+     */
+    unsigned numRecomputations() const { return _numRecomputations; }
+
+private:
+    struct Tracking {
+        PlaceState state;
+        PlaceState pending;     // state waiting out the dwell time
+        double pendingSince;
+        bool contradicted;      // last fix went against the pending state
+        bool watching;          // last fix was in the hysteresis band or too coarse
+        double watchingSince;
+
+        Tracking()
+            : state(PlaceStateUnknown), pending(PlaceStateUnknown), pendingSince(0),
+              contradicted(false), watching(false), watchingSince(0) {}
+    };
+
+    bool acceptFix(const LocationFix &fix);
+    void recompute(const GeoPoint &origin);
+    bool evaluate(const LocationFix &fix, std::vector<Event> &events);
+    void collectOverdue(double now, std::vector<Event> &events);
+
+    const Clock &_clock;
+    GeofencePolicy _policy;
+
+    SpatialIndex _index;
+    std::unordered_map<PlaceID, Place> _places;
+
+    std::vector<PlaceID> _monitored;                    // nearest first
+    std::unordered_map<PlaceID, Tracking> _tracking;    // monitored places only
+    Region _refreshRegion;
+    std::unordered_map<PlaceID, double> _overdue;       // placeID -> due time
+
+    bool _hasLastFix;
+    LocationFix _lastFix;
+    unsigned _numRecomputations;
+};
+
+} // namespace rtc
+
+#endif
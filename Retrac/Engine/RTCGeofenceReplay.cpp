@@ -0,0 +1,237 @@
+//
+//  RTCGeofenceReplay.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/23/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCGeofenceReplay.h"
+#include <algorithm>
+#include <cmath>
+#include "RTCTrace.h"
+
+namespace rtc {
+
+typedef GeofenceEngine::Event GeofenceEvent;
+
+#pragma mark - Helpers
+static bool earlierEvent(const GeofenceEvent &a, const GeofenceEvent &b)
+{
+    return (a.time < b.time) || ((a.time == b.time) && (a.placeID < b.placeID));
+}
+
+/**
+ * The events the user's real position calls for, under the same dwell time
+ * rule as the engine. Arrivals and departures are timed when the user really
+ * crossed the edge, so latency includes the dwell time. Only places inside
+ * policy.radius + policy.exitHysteresis or waiting out a dwell are tracked;
+ * every other place is known to be outside.
+ */
+static std::vector<GeofenceEvent> trueEvents(const SpatialIndex &index,
+                                             const std::unordered_map<SpatialIndex::PlaceID, double> &timeouts,
+                                             const GeofenceTrace &trace, const GeofencePolicy &policy)
+{
+    typedef SpatialIndex::PlaceID PlaceID;
+    struct Truth {
+        GeofenceEngine::PlaceState state;
+        GeofenceEngine::PlaceState pending;
+        double pendingSince;
+    };
+    double exitRadius = policy.radius + policy.exitHysteresis;
+
+    std::vector<GeofenceEvent> events;
+    std::unordered_map<PlaceID, Truth> truths;
+    std::unordered_map<PlaceID, double> overdue;
+
+    for (size_t i = 0; i < trace.size(); ++i) {
+        double t = trace[i].fix.timestamp;
+        for (std::unordered_map<PlaceID, double>::iterator it = overdue.begin(); it != overdue.end(); ) {
+            if (it->second <= t) {
+                events.push_back(GeofenceEvent(GeofenceEvent::TypeOverdue, it->first, it->second));
+                it = overdue.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        std::unordered_map<PlaceID, double> distances;
+        std::vector<SpatialIndex::Neighbor> near = index.within(trace[i].truth, exitRadius);
+        for (size_t j = 0; j < near.size(); ++j) {
+            distances[near[j].placeID] = near[j].distance;
+            if (truths.count(near[j].placeID)) continue;
+            Truth truth = {(i == 0) ? GeofenceEngine::PlaceStateUnknown : GeofenceEngine::PlaceStateOutside,
+                           GeofenceEngine::PlaceStateUnknown, 0};
+            truths[near[j].placeID] = truth;
+        }
+
+        for (std::unordered_map<PlaceID, Truth>::iterator it = truths.begin(); it != truths.end(); ) {
+            Truth &truth = it->second;
+            std::unordered_map<PlaceID, double>::const_iterator distance = distances.find(it->first);
+            GeofenceEngine::PlaceState observed = (distance == distances.end()) ? GeofenceEngine::PlaceStateOutside :
+                ((distance->second <= policy.radius) ? GeofenceEngine::PlaceStateInside : GeofenceEngine::PlaceStateUnknown);
+
+            if ((observed == GeofenceEngine::PlaceStateUnknown) || (observed == truth.state)) {
+                truth.pending = GeofenceEngine::PlaceStateUnknown;
+            } else {
+                if (truth.pending != observed) {
+                    truth.pending = observed;
+                    truth.pendingSince = t;
+                }
+                if (t - truth.pendingSince >= policy.dwellTime) {
+                    if (truth.state != GeofenceEngine::PlaceStateUnknown) {
+                        if (observed == GeofenceEngine::PlaceStateInside) {
+                            events.push_back(GeofenceEvent(GeofenceEvent::TypeArrival, it->first, truth.pendingSince));
+                            overdue.erase(it->first);
+                        } else {
+                            events.push_back(GeofenceEvent(GeofenceEvent::TypeDeparture, it->first, truth.pendingSince));
+                            std::unordered_map<PlaceID, double>::const_iterator timeout = timeouts.find(it->first);
+                            if ((timeout != timeouts.end()) && (timeout->second > 0)) {
+                                overdue[it->first] = truth.pendingSince + timeout->second;
+                            }
+                        }
+                    }
+                    truth.state = observed;
+                    truth.pending = GeofenceEngine::PlaceStateUnknown;
+                }
+            }
+
+            // settled outside, so no different from any other far away place
+            if ((truth.state == GeofenceEngine::PlaceStateOutside) &&
+                (truth.pending == GeofenceEngine::PlaceStateUnknown) && (distance == distances.end())) {
+                it = truths.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::sort(events.begin(), events.end(), earlierEvent);
+    return events;
+}
+
+/**
+ * Match each event to the nearest-in-time unmatched true event of the same
+ * type and place.
+ */
+static void matchEvents(const std::vector<GeofenceEvent> &events, const std::vector<GeofenceEvent> &expected,
+                        double matchWindow, std::vector<double> &latencies, GeofenceReplaySummary &summary)
+{
+    std::vector<bool> matched(expected.size(), false);
+    for (size_t i = 0; i < events.size(); ++i) {
+        size_t best = expected.size();
+        for (size_t j = 0; j < expected.size(); ++j) {
+            if (matched[j] || (expected[j].type != events[i].type) || (expected[j].placeID != events[i].placeID)) continue;
+            double offset = std::fabs(events[i].time - expected[j].time);
+            if ((offset <= matchWindow) &&
+                ((best == expected.size()) || (offset < std::fabs(events[i].time - expected[best].time)))) {
+                best = j;
+            }
+        }
+
+        if (best == expected.size()) {
+            ++summary.numFalsePositives;
+        } else {
+            matched[best] = true;
+            ++summary.numMatched;
+            latencies.push_back(events[i].time - expected[best].time);
+        }
+    }
+}
+
+static bool regionContains(const GeofenceEngine::Region &region, const GeoPoint &point)
+{
+    return distanceBetween(region.center, point) <= region.radius;
+}
+
+
+#pragma mark - Replay
+GeofenceReplaySummary replayGeofenceTraces(const std::vector<GeofenceEngine::Place> &places,
+                                           const std::vector<GeofenceTrace> &traces,
+                                           const GeofencePolicy &policy,
+                                           double significantChangeDistance,
+                                           double matchWindow)
+{
+    GeofenceReplaySummary summary;
+    std::vector<double> latencies;
+
+    SpatialIndex index;
+    std::vector<SpatialIndex::Record> records;
+    std::unordered_map<SpatialIndex::PlaceID, double> timeouts;
+    for (size_t i = 0; i < places.size(); ++i) {
+        records.push_back(SpatialIndex::Record(places[i].placeID, places[i].coordinate));
+        timeouts[places[i].placeID] = places[i].timeout;
+    }
+    index.assign(records);
+
+    for (size_t n = 0; n < traces.size(); ++n) {
+        const GeofenceTrace &trace = traces[n];
+        if (trace.empty()) continue;
+        ++summary.numTraces;
+        summary.numSamples += (unsigned)trace.size();
+
+        ManualClock clock(trace[0].fix.timestamp);
+        GeofenceEngine engine(clock, policy);
+        engine.assignPlaces(places);
+
+        std::vector<GeofenceEvent> events;
+        std::vector<GeofenceEngine::Region> regions;
+        std::vector<bool> insideRegions;
+        bool insideRefreshRegion = false;
+        GeoPoint lastSignificantChange = trace[0].truth;
+
+        for (size_t i = 0; i < trace.size(); ++i) {
+            const GeofenceSample &sample = trace[i];
+            clock.setNow(sample.fix.timestamp);
+            if (engine.deadline() <= clock.now()) engine.handleTimeout(events);
+
+            bool deliver = (i == 0) || engine.awaitingConfirmation();
+            if (distanceBetween(sample.truth, lastSignificantChange) >= significantChangeDistance) {
+                lastSignificantChange = sample.truth;
+                deliver = true;
+            }
+            for (size_t r = 0; r < regions.size(); ++r) {
+                bool inside = regionContains(regions[r], sample.truth);
+                if (inside != insideRegions[r]) deliver = true;
+                insideRegions[r] = inside;
+            }
+            bool exitedRefreshRegion = insideRefreshRegion && !regionContains(engine.refreshRegion(), sample.truth);
+
+            bool changed = false;
+            if (exitedRefreshRegion) {
+                changed = engine.processRefreshRegionExit(sample.fix, events);
+            } else if (deliver) {
+                changed = engine.processFix(sample.fix, events);
+            } else {
+                continue;
+            }
+            ++summary.numFixesDelivered;
+
+            // the OS doesn't report regions we are already in when they're
+            // registered, only crossings after that
+            if (changed) {
+                regions = engine.regions();
+                insideRegions.resize(regions.size());
+                for (size_t r = 0; r < regions.size(); ++r) insideRegions[r] = regionContains(regions[r], sample.truth);
+                insideRefreshRegion = regionContains(engine.refreshRegion(), sample.truth);
+            }
+        }
+
+        std::vector<GeofenceEvent> expected = trueEvents(index, timeouts, trace, policy);
+        summary.numTrueEvents += (unsigned)expected.size();
+        summary.numEvents += (unsigned)events.size();
+        summary.numRecomputations += engine.numRecomputations();
+        matchEvents(events, expected, matchWindow, latencies, summary);
+    }
+
+    summary.numMissed = summary.numTrueEvents - summary.numMatched;
+
+    double sum = 0;
+    for (size_t i = 0; i < latencies.size(); ++i) sum += latencies[i];
+    std::sort(latencies.begin(), latencies.end());
+    summary.meanLatency = latencies.empty() ? 0 : sum / latencies.size();
+    summary.p90Latency = percentile(latencies, 0.9);
+    return summary;
+}
+
+} // namespace rtc
@@ -0,0 +1,87 @@
+//
+//  RTCGeofenceReplay.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/23/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCGeofenceReplay_h
+#define Retrac_RTCGeofenceReplay_h
+
+#include <vector>
+#include "RTCGeofenceEngine.h"
+
+namespace rtc {
+
+/**
+ * GeofenceSample is one second of a simulated walk: where the user really was
+ * and the fix the GPS would have reported there. The fix's timestamp is the
+ * sample's time.
+ */
+struct GeofenceSample {
+    GeoPoint truth;
+    LocationFix fix;
+
+    GeofenceSample() {}
+    GeofenceSample(const GeoPoint &aTruth, const LocationFix &aFix) : truth(aTruth), fix(aFix) {}
+};
+
+typedef std::vector<GeofenceSample> GeofenceTrace;
+
+/**
+ * Outcome of replaying traces. The true events are the ones the engine would
+ * fire given the user's real position at every second, with the same radius
+ * and hysteresis. An engine event matches a true event of the same type and
+ * place within the match window; any it can't be matched to is a false
+ * positive, and true events left over were missed.
+ */
+struct GeofenceReplaySummary {
+    unsigned numTraces;
+    unsigned numTrueEvents;
+    unsigned numEvents;
+    unsigned numMatched;
+    unsigned numFalsePositives;
+    unsigned numMissed;
+    double meanLatency;         // seconds from a true event to its match
+    double p90Latency;
+    unsigned numRecomputations;
+    unsigned numFixesDelivered; // fixes the host fed the engine
+    unsigned numSamples;        // fixes a GPS left on would have delivered
+
+    GeofenceReplaySummary()
+        : numTraces(0), numTrueEvents(0), numEvents(0), numMatched(0), numFalsePositives(0),
+          numMissed(0), meanLatency(0), p90Latency(0), numRecomputations(0),
+          numFixesDelivered(0), numSamples(0) {}
+
+    double falsePositiveRate() const { return numEvents ? (double)numFalsePositives / numEvents : 0.0; }
+    double missRate() const { return numTrueEvents ? (double)numMissed / numTrueEvents : 0.0; }
+};
+
+/**
+ * Replay traces through a fresh engine each, on virtual time, with a stand-in
+ * for the host and OS. The engine is fed a fix:
+ * - at the start of each trace,
+ * - when the user moves significantChangeDistance since the last such fix,
+ *   like the significant-change location service,
+ * - when the user crosses the edge of a monitored region, like region
+ *   monitoring (the refresh region's exit goes to processRefreshRegionExit),
+ * - and every second while the engine is awaiting confirmation.
+ *
+ * @param places                    the saved places
+ * @param traces                    one simulated walk each
+ * @param policy                    engine knobs
+ * @param significantChangeDistance meters between significant-change fixes
+ * @param matchWindow               seconds an event may be from its true event
+ */
+GeofenceReplaySummary replayGeofenceTraces(const std::vector<GeofenceEngine::Place> &places,
+                                           const std::vector<GeofenceTrace> &traces,
+                                           const GeofencePolicy &policy = GeofencePolicy(),
+                                           double significantChangeDistance = 500.0,
+                                           double matchWindow = 300.0);
+
+} // namespace rtc
+
+#endif
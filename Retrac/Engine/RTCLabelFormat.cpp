@@ -0,0 +1,100 @@
+//
+//  RTCLabelFormat.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/26/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCLabelFormat.h"
+#include <cmath>
+#include <cstdio>
+
+namespace rtc {
+
+#pragma mark - Buckets
+LabelBucket ageBucket(double seconds)
+{
+    if (seconds >= kSecondsInDay) {
+        return LabelBucket(LabelBucket::UnitAgeDays, (long long)(seconds / kSecondsInDay));
+    } else if (seconds >= kSecondsInHour) {
+        return LabelBucket(LabelBucket::UnitAgeHours, (long long)(seconds / kSecondsInHour));
+    } else if (seconds >= 0) {
+        return LabelBucket(LabelBucket::UnitAgeMinutes, (long long)(seconds / kSecondsInMinute));
+    }
+    return LabelBucket();
+}
+
+double ageBucketExpiry(double seconds)
+{
+    LabelBucket bucket = ageBucket(seconds);
+    switch (bucket.unit) {
+        case LabelBucket::UnitAgeDays:      return (bucket.count + 1) * kSecondsInDay - seconds;
+        case LabelBucket::UnitAgeHours:     return (bucket.count + 1) * kSecondsInHour - seconds;
+        case LabelBucket::UnitAgeMinutes:   return (bucket.count + 1) * kSecondsInMinute - seconds;
+        default:                            return -seconds;
+    }
+}
+
+bool ageBucketChanges(double seconds, double elapsed)
+{
+    return ageBucket(seconds) != ageBucket(seconds + elapsed);
+}
+
+LabelBucket distanceBucket(double meters)
+{
+    if (meters >= kMetersInMile * kMinimumMiles) {
+        return LabelBucket(LabelBucket::UnitTenthsOfMile, std::llround(meters / kMetersInMile * 10));
+    } else if (meters >= 0) {
+        return LabelBucket(LabelBucket::UnitFeet, (long long)(meters / kMetersInFoot));
+    }
+    return LabelBucket();
+}
+
+LabelBucket durationBucket(double seconds)
+{
+    return LabelBucket(LabelBucket::UnitDurationMinutes, (long long)(std::fabs(seconds) / kSecondsInMinute));
+}
+
+
+#pragma mark - Text
+std::string labelText(const LabelBucket &bucket)
+{
+    char text[64];
+    switch (bucket.unit) {
+        case LabelBucket::UnitAgeMinutes:
+            snprintf(text, sizeof(text), "%lldm", bucket.count);
+            break;
+        case LabelBucket::UnitAgeHours:
+            snprintf(text, sizeof(text), "%lldh", bucket.count);
+            break;
+        case LabelBucket::UnitAgeDays:
+            snprintf(text, sizeof(text), "%lldd", bucket.count);
+            break;
+        case LabelBucket::UnitFeet:
+            snprintf(text, sizeof(text), "%lld ft", bucket.count);
+            break;
+        case LabelBucket::UnitTenthsOfMile:
+            snprintf(text, sizeof(text), "%lld.%lld mi", bucket.count / 10, bucket.count % 10);
+            break;
+        case LabelBucket::UnitDurationMinutes: {
+            long long hours = bucket.count / 60;
+            long long minutes = bucket.count % 60;
+            const char *hoursUnit = (hours == 1) ? "hour" : "hours";
+            const char *minutesUnit = (minutes == 1) ? "minute" : "minutes";
+            if (hours == 0) {
+                snprintf(text, sizeof(text), "%lld %s", minutes, minutesUnit);
+            } else if (minutes == 0) {
+                snprintf(text, sizeof(text), "%lld %s", hours, hoursUnit);
+            } else {
+                snprintf(text, sizeof(text), "%lld %s %lld %s", hours, hoursUnit, minutes, minutesUnit);
+            }
+            break;
+        }
+        default:
+            return std::string();
+    }
+    return text;
+}
+
+} // namespace rtc
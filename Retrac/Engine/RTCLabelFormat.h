@@ -0,0 +1,158 @@
+//
+//  RTCLabelFormat.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/26/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCLabelFormat_h
+#define Retrac_RTCLabelFormat_h
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace rtc {
+
+#pragma mark - Constants
+// seconds in minute, hour, day per the Gregorian Calendar.
+const double kSecondsInMinute = 60;
+const double kSecondsInHour   = 3600;
+const double kSecondsInDay    = 86400;
+
+const double kMetersInFoot    = 0.3048;
+const double kMetersInMile    = 1609.34;
+
+// below this many miles distances are shown in feet
+const double kMinimumMiles    = 0.1;
+
+
+#pragma mark - LabelBucket
+/**
+ * The label a value is shown as. Every value in a bucket shows the same text,
+ * so labels can be made once per bucket and shared.
+ */
+struct LabelBucket {
+    enum Unit {
+        UnitNone,               // no label, e.g. a negative age
+        UnitAgeMinutes,         // "12m"
+        UnitAgeHours,           // "3h"
+        UnitAgeDays,            // "4d"
+        UnitFeet,               // "250 ft"
+        UnitTenthsOfMile,       // "1.4 mi"
+        UnitDurationMinutes,    // "1 hour 5 minutes"
+        UnitCount
+    };
+
+    Unit unit;
+    long long count;
+
+    LabelBucket(Unit unit = UnitNone, long long count = 0) : unit(unit), count(count) {}
+
+    /**
+     * One number per bucket, for hashing
+     */
+    long long key() const { return count * UnitCount + unit; }
+
+    bool operator==(const LabelBucket &other) const { return (unit == other.unit) && (count == other.count); }
+    bool operator!=(const LabelBucket &other) const { return !(*this == other); }
+};
+
+/**
+ * Bucket of an age in seconds, such as the time since a place was saved:
+ * whole minutes under an hour, whole hours under a day, then whole days.
+ * Negative ages have no label.
+ */
+LabelBucket ageBucket(double seconds);
+
+/**
+ * Seconds more an age can grow before its bucket changes.
+ */
+double ageBucketExpiry(double seconds);
+
+/**
+ * Whether an age's label changes in the next elapsed seconds. Buckets only
+ * go up with age, so a label shown any time in between is stale exactly when
+ * this is true.
+ */
+bool ageBucketChanges(double seconds, double elapsed);
+
+/**
+ * Bucket of a walking distance: whole feet under kMinimumMiles, then tenths
+ * of a mile. Negative distances have no label.
+ */
+LabelBucket distanceBucket(double meters);
+
+/**
+ * Bucket of a travel time: whole minutes, whatever its sign.
+ */
+LabelBucket durationBucket(double seconds);
+
+/**
+ * Text of a bucket's label, empty for UnitNone.
+ */
+std::string labelText(const LabelBucket &bucket);
+
+
+#pragma mark - LabelCache
+/**
+ * LabelCache interns a label per bucket, so showing a value that has been
+ * shown before is a hash lookup: no formatting or allocation. Label is
+ * whatever the host shows (std::string here, NSString in the app), made from
+ * the bucket's text on first use.
+ *
+ * Ages and distances fall in a few hundred buckets in practice. Should the
+ * cache ever reach maxLabels it is emptied and starts over.
+ *
+ * Not thread-safe.
+ */
+template <typename Label>
+class LabelCache {
+public:
+    typedef Label (*MakeLabel)(const std::string &text);
+
+    explicit LabelCache(MakeLabel makeLabel, size_t maxLabels = 4096)
+        : _makeLabel(makeLabel), _maxLabels(maxLabels), _numMisses(0) {}
+
+    const Label &label(const LabelBucket &bucket)
+    {
+        typename std::unordered_map<long long, Label>::iterator it = _labels.find(bucket.key());
+        if (it != _labels.end()) return it->second;
+
+        ++_numMisses;
+        if (_labels.size() >= _maxLabels) _labels.clear();
+        return _labels.insert(std::make_pair(bucket.key(), _makeLabel(labelText(bucket)))).first->second;
+    }
+
+    /**
+     * Make the labels of every age under a day and the first month of days,
+     * which covers most of a places list.
+     */
+    void preloadAges()
+    {
+        for (long long minutes = 0; minutes < 60; ++minutes) label(LabelBucket(LabelBucket::UnitAgeMinutes, minutes));
+        for (long long hours = 1; hours < 24; ++hours) label(LabelBucket(LabelBucket::UnitAgeHours, hours));
+        for (long long days = 1; days <= 31; ++days) label(LabelBucket(LabelBucket::UnitAgeDays, days));
+    }
+
+    size_t size() const { return _labels.size(); }
+
+    /**
+     * Labels made, i.e. lookups that weren't already cached
+     */
+    size_t numMisses() const { return _numMisses; }
+
+private:
+    MakeLabel _makeLabel;
+    size_t _maxLabels;
+    size_t _numMisses;
+    std::unordered_map<long long, Label> _labels;
+};
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,109 @@
+//
+//  RTCLocationFixEngine.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/9/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCLocationFixEngine.h"
+#include <cmath>
+
+namespace rtc {
+
+LocationFixEngine::LocationFixEngine(const Clock &clock, const LocationFixPolicy &policy)
+    : _clock(clock), _policy(policy), _state(StateIdle), _finishReason(FinishReasonNone),
+      _hasBestFix(false), _numAttempts(0), _numFixesReceived(0),
+      _startTime(0), _finishTime(0), _deadline(0)
+{
+}
+
+void LocationFixEngine::start()
+{
+    _state = StateAcquiring;
+    _finishReason = FinishReasonNone;
+    _hasBestFix = false;
+    _bestFix = LocationFix();
+    _numAttempts = 0;
+    _numFixesReceived = 0;
+    _startTime = _clock.now();
+    _finishTime = 0;
+
+    // timeout if we dont get the first location in expected window.
+    _deadline = _startTime + _policy.maxWaitForFirst;
+}
+
+LocationFixEngine::Action LocationFixEngine::processFix(const LocationFix &fix, bool *isNewBest)
+{
+    if (isNewBest) *isNewBest = false;
+    if (_state != StateAcquiring) return ActionNone;
+
+    ++_numFixesReceived;
+
+    // Test the age of the measurement to determine if it is cached. We
+    // definitely don't want to rely on cached measurements.
+    // Also check the horizontal accuracy does not indicate an invalid measurement
+    double howRecent = fix.timestamp - _clock.now();
+    if (!((std::fabs(howRecent) < _policy.expiryTime) && (fix.horizontalAccuracy >= 0))) {
+        return ActionNone;
+    }
+
+    Action action = ActionNone;
+
+    if (!_hasBestFix ||
+        (fix.horizontalAccuracy < (_bestFix.horizontalAccuracy - _policy.significantChange))) {
+        // this is first fix or new one with better accuracy than best seen so
+        // far. So store this new fix as "best effort"
+        _bestFix = fix;
+        _hasBestFix = true;
+        if (isNewBest) *isNewBest = true;
+
+        if (_bestFix.horizontalAccuracy <= _policy.accuracyThreshold) {
+            // we have our result. It is important that we minimize power by
+            // stopping as quickly as possible
+            finishNow(FinishReasonAccuracyReached);
+            return ActionFinish;
+        }
+
+        // set timeout for how long we are willing to wait for a better result
+        _deadline = _clock.now() + _policy.maxWaitForBetter;
+        action = ActionRescheduleTimeout;
+    }
+
+    // Ensure number of attempts doesnt go too far
+    if (++_numAttempts >= _policy.attemptsMax) {
+        finishNow(FinishReasonAttemptsExhausted);
+        return ActionFinish;
+    }
+
+    return action;
+}
+
+LocationFixEngine::Action LocationFixEngine::handleTimeout()
+{
+    if (_state != StateAcquiring) return ActionNone;
+
+    finishNow(_hasBestFix ? FinishReasonBetterFixTimeout : FinishReasonFirstFixTimeout);
+    return ActionFinish;
+}
+
+void LocationFixEngine::finish(FinishReason reason)
+{
+    if (_state != StateAcquiring) return;
+    finishNow(reason);
+}
+
+double LocationFixEngine::timeoutDelay() const
+{
+    double delay = _deadline - _clock.now();
+    return (delay > 0) ? delay : 0;
+}
+
+void LocationFixEngine::finishNow(FinishReason reason)
+{
+    _state = StateFinished;
+    _finishReason = reason;
+    _finishTime = _clock.now();
+}
+
+} // namespace rtc
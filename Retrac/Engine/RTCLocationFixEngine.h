@@ -0,0 +1,183 @@
+//
+//  RTCLocationFixEngine.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/9/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCLocationFixEngine_h
+#define Retrac_RTCLocationFixEngine_h
+
+#include "RTCClock.h"
+
+namespace rtc {
+
+/**
+ * LocationFix is a plain copy of the parts of a CLLocation the engine cares
+ * about.
+ */
+struct LocationFix {
+    double timestamp;           // seconds, same epoch as the engine's Clock
+    double latitude;            // degrees
+    double longitude;           // degrees
+    double horizontalAccuracy;  // meters. Negative means invalid measurement
+
+    LocationFix() : timestamp(0), latitude(0), longitude(0), horizontalAccuracy(-1) {}
+    LocationFix(double t, double lat, double lon, double accuracy)
+        : timestamp(t), latitude(lat), longitude(lon), horizontalAccuracy(accuracy) {}
+};
+
+/**
+ * LocationFixPolicy holds the knobs that trade power for accuracy/latency.
+ * The default values mirror the location settings in RTCConstants.m
+ */
+struct LocationFixPolicy {
+    double expiryTime;          // kRTCLocationUpdateExpiryTime
+    double accuracyThreshold;   // kRTCLocationAccuracyThreshold
+    double significantChange;   // kRTCLocationAccuracySignificantChange
+    unsigned attemptsMax;       // kRTCLocationAttemptsMax
+    double maxWaitForBetter;    // kRTCLocationMaxWaitTimeForBetter
+    double maxWaitForFirst;     // kRTCLocationMaxWaitTimeForFirst
+
+    LocationFixPolicy()
+        : expiryTime(5.0), accuracyThreshold(15.0), significantChange(0.0),
+          attemptsMax(10), maxWaitForBetter(5.0), maxWaitForFirst(30.0) {}
+};
+
+/**
+ * LocationFixEngine is the best-fix state machine that used to live inside
+ * `-[RTCLocationManager locationManager:didUpdateLocations:]`.
+ *
+ * It owns no timers. Instead it tells its host what to do with the returned
+ * Action, and exposes a deadline so the host can schedule a single timeout and
+ * call `handleTimeout()` when it fires. This makes it possible to drive it from
+ * CoreLocation on a device or from a recorded trace with a ManualClock.
+ *
+ * Rules (unchanged from the original implementation):
+ * - Only process fixes that are recent with valid accuracy
+ * - Done if we get a fix with accuracy under policy.accuracyThreshold
+ * - Keep a new fix if it is the first or significantly more accurate than the
+ *   best so far. Significant change requires policy.significantChange.
+ * - Never go past policy.attemptsMax valid fixes
+ * - Give up after policy.maxWaitForFirst without a fix, or after
+ *   policy.maxWaitForBetter without an improvement.
+ */
+class LocationFixEngine {
+public:
+    enum State {
+        StateIdle,
+        StateAcquiring,
+        StateFinished
+    };
+
+    enum FinishReason {
+        FinishReasonNone,
+        FinishReasonAccuracyReached,
+        FinishReasonAttemptsExhausted,
+        FinishReasonFirstFixTimeout,
+        FinishReasonBetterFixTimeout,
+        FinishReasonDenied,
+        FinishReasonCancelled
+    };
+
+    /**
+     * What the host should do after feeding the engine
+     */
+    enum Action {
+        ActionNone,                 // keep going, timeout unchanged
+        ActionRescheduleTimeout,    // cancel pending timeout and reschedule at deadline()
+        ActionFinish                // stop updates and report bestFix()
+    };
+
+    /**
+     * @param clock     time source, must outlive the engine
+     * @param policy    accuracy/power knobs
+     */
+    explicit LocationFixEngine(const Clock &clock,
+                               const LocationFixPolicy &policy = LocationFixPolicy());
+
+    const LocationFixPolicy &policy() const { return _policy; }
+    void setPolicy(const LocationFixPolicy &policy) { _policy = policy; }
+
+    /**
+     * Start a new acquisition. This clears out any previous best fix and sets
+     * the deadline to policy.maxWaitForFirst from now.
+     */
+    void start();
+
+    /**
+     * Feed a fix from the location provider.
+     *
+     * @param fix           the new fix
+     * @param isNewBest     optional output, set to true if this fix replaced
+     *                      the best fix so far
+     *
+     * @return action the host should take.
+     */
+    Action processFix(const LocationFix &fix, bool *isNewBest = 0);
+
+    /**
+     * Host's timeout fired. Finishes the acquisition with whatever best fix we
+     * have so far.
+     *
+     * @return ActionFinish if acquiring, ActionNone otherwise.
+     */
+    Action handleTimeout();
+
+    /**
+     * Finish the acquisition early (e.g. location services denied).
+     */
+    void finish(FinishReason reason);
+
+    State state() const { return _state; }
+    FinishReason finishReason() const { return _finishReason; }
+
+    bool hasBestFix() const { return _hasBestFix; }
+    const LocationFix &bestFix() const { return _bestFix; }
+
+    /**
+     * Number of valid fixes counted against policy.attemptsMax
+     */
+    unsigned numAttempts() const { return _numAttempts; }
+
+    /**
+     * Number of fixes fed in this acquisition, including rejected ones.
+     */
+    unsigned numFixesReceived() const { return _numFixesReceived; }
+
+    double startTime() const { return _startTime; }
+    double finishTime() const { return _finishTime; }
+
+    /**
+     * Absolute time at which the host should call `handleTimeout()`
+     */
+    double deadline() const { return _deadline; }
+
+    /**
+     * Seconds from now till the deadline, never negative.
+     */
+    double timeoutDelay() const;
+
+private:
+    void finishNow(FinishReason reason);
+
+    const Clock &_clock;
+    LocationFixPolicy _policy;
+
+    State _state;
+    FinishReason _finishReason;
+    bool _hasBestFix;
+    LocationFix _bestFix;
+    unsigned _numAttempts;
+    unsigned _numFixesReceived;
+    double _startTime;
+    double _finishTime;
+    double _deadline;
+};
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,517 @@
+//
+//  RTCPlaceArchive.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/21/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCPlaceArchive.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "RTCVarint.h"
+
+namespace rtc {
+
+#pragma mark - Constants
+static const char kBinaryMagic[8] = {'R', 'T', 'C', 'P', 'L', 'A', 'C', 'E'};
+static const uint8_t kBinaryVersion = 1;
+
+// binary record flags: which optional fields follow the coordinate
+static const uint8_t kHasAccuracy           = 1 << 0;
+static const uint8_t kHasCreationDate       = 1 << 1;
+static const uint8_t kHasLocationTimestamp  = 1 << 2;
+
+// binary coordinates are in these units of a degree
+static const double kCoordinateScale = 1e7;
+
+// longest record or line read; anything longer is corrupt, not a place
+static const size_t kMaxRecordLength = 1 << 16;
+
+// deepest JSON nesting skipped over in properties we don't use
+static const int kMaxJSONDepth = 32;
+
+
+#pragma mark - Helpers
+static int64_t milliseconds(double seconds)
+{
+    return (int64_t)std::llround(seconds * 1e3);
+}
+
+
+#pragma mark - JSON
+static void appendJSONString(std::string &buffer, const std::string &value)
+{
+    buffer.push_back('"');
+    for (size_t i = 0; i < value.size(); ++i) {
+        unsigned char c = (unsigned char)value[i];
+        if (c == '"') buffer.append("\\\"");
+        else if (c == '\\') buffer.append("\\\\");
+        else if (c == '\n') buffer.append("\\n");
+        else if (c == '\r') buffer.append("\\r");
+        else if (c == '\t') buffer.append("\\t");
+        else if (c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            buffer.append(escape);
+        } else {
+            buffer.push_back((char)c);
+        }
+    }
+    buffer.push_back('"');
+}
+
+static void appendJSONNumber(std::string &buffer, const char *format, double value)
+{
+    char number[32];
+    snprintf(number, sizeof(number), format, value);
+    buffer.append(number);
+}
+
+static void appendUTF8(std::string &buffer, uint32_t codePoint)
+{
+    if (codePoint < 0x80) {
+        buffer.push_back((char)codePoint);
+    } else if (codePoint < 0x800) {
+        buffer.push_back((char)(0xc0 | (codePoint >> 6)));
+        buffer.push_back((char)(0x80 | (codePoint & 0x3f)));
+    } else if (codePoint < 0x10000) {
+        buffer.push_back((char)(0xe0 | (codePoint >> 12)));
+        buffer.push_back((char)(0x80 | ((codePoint >> 6) & 0x3f)));
+        buffer.push_back((char)(0x80 | (codePoint & 0x3f)));
+    } else {
+        buffer.push_back((char)(0xf0 | (codePoint >> 18)));
+        buffer.push_back((char)(0x80 | ((codePoint >> 12) & 0x3f)));
+        buffer.push_back((char)(0x80 | ((codePoint >> 6) & 0x3f)));
+        buffer.push_back((char)(0x80 | (codePoint & 0x3f)));
+    }
+}
+
+/**
+ * JSONCursor walks one line of JSON picking out the values a feature needs.
+ * Anything it doesn't need is checked for well-formedness and skipped.
+ */
+class JSONCursor {
+public:
+    explicit JSONCursor(const std::string &text) : _p(text.c_str()), _end(text.c_str() + text.size()) {}
+
+    void skipSpace() {
+        while ((_p < _end) && ((*_p == ' ') || (*_p == '\t') || (*_p == '\r') || (*_p == '\n'))) ++_p;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if ((_p < _end) && (*_p == c)) {
+            ++_p;
+            return true;
+        }
+        return false;
+    }
+
+    bool atEnd() {
+        skipSpace();
+        return _p == _end;
+    }
+
+    bool consumeNull() {
+        skipSpace();
+        if ((_end - _p >= 4) && !std::strncmp(_p, "null", 4)) {
+            _p += 4;
+            return true;
+        }
+        return false;
+    }
+
+    bool parseString(std::string *value) {
+        if (!consume('"')) return false;
+        if (value) value->clear();
+        while (_p < _end) {
+            char c = *_p++;
+            if (c == '"') return true;
+            if (c != '\\') {
+                if (value) value->push_back(c);
+                continue;
+            }
+            if (_p >= _end) return false;
+            char escape = *_p++;
+            switch (escape) {
+                case '"': case '\\': case '/': if (value) value->push_back(escape); break;
+                case 'b': if (value) value->push_back('\b'); break;
+                case 'f': if (value) value->push_back('\f'); break;
+                case 'n': if (value) value->push_back('\n'); break;
+                case 'r': if (value) value->push_back('\r'); break;
+                case 't': if (value) value->push_back('\t'); break;
+                case 'u': {
+                    uint32_t codePoint;
+                    if (!parseHex4(&codePoint)) return false;
+                    // a UTF-16 surrogate pair is two escapes
+                    if ((codePoint >= 0xd800) && (codePoint < 0xdc00) && (_end - _p >= 6) &&
+                        (_p[0] == '\\') && (_p[1] == 'u')) {
+                        _p += 2;
+                        uint32_t low;
+                        if (!parseHex4(&low) || (low < 0xdc00) || (low >= 0xe000)) return false;
+                        codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    if (value) appendUTF8(*value, codePoint);
+                    break;
+                }
+                default: return false;
+            }
+        }
+        return false;
+    }
+
+    bool parseNumber(double *value) {
+        skipSpace();
+        if ((_p >= _end) || !((*_p == '-') || ((*_p >= '0') && (*_p <= '9')))) return false;
+        char *numberEnd;
+        double number = std::strtod(_p, &numberEnd);
+        if ((numberEnd == _p) || (numberEnd > _end)) return false;
+        _p = numberEnd;
+        if (value) *value = number;
+        return true;
+    }
+
+    bool skipValue(int depth = 0) {
+        skipSpace();
+        if ((_p >= _end) || (depth > kMaxJSONDepth)) return false;
+        switch (*_p) {
+            case '"': return parseString(NULL);
+            case '{': {
+                ++_p;
+                if (consume('}')) return true;
+                do {
+                    if (!parseString(NULL) || !consume(':') || !skipValue(depth + 1)) return false;
+                } while (consume(','));
+                return consume('}');
+            }
+            case '[': {
+                ++_p;
+                if (consume(']')) return true;
+                do {
+                    if (!skipValue(depth + 1)) return false;
+                } while (consume(','));
+                return consume(']');
+            }
+            case 't': return consumeWord("true");
+            case 'f': return consumeWord("false");
+            case 'n': return consumeNull();
+            default: return parseNumber(NULL);
+        }
+    }
+
+private:
+    bool parseHex4(uint32_t *value) {
+        if (_end - _p < 4) return false;
+        *value = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = *_p++;
+            *value <<= 4;
+            if ((c >= '0') && (c <= '9')) *value |= c - '0';
+            else if ((c >= 'a') && (c <= 'f')) *value |= c - 'a' + 10;
+            else if ((c >= 'A') && (c <= 'F')) *value |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    bool consumeWord(const char *word) {
+        size_t length = std::strlen(word);
+        if (((size_t)(_end - _p) < length) || std::strncmp(_p, word, length)) return false;
+        _p += length;
+        return true;
+    }
+
+    const char *_p, *_end;
+};
+
+/**
+ * A number property, or null for unknown
+ */
+static bool parseOptionalNumber(JSONCursor &cursor, double *value, double unknown)
+{
+    if (cursor.consumeNull()) {
+        *value = unknown;
+        return true;
+    }
+    return cursor.parseNumber(value);
+}
+
+static bool parseGeometry(JSONCursor &cursor, GeoPoint *coordinate)
+{
+    bool isPoint = false, hasCoordinates = false;
+    if (!cursor.consume('{')) return false;
+    if (cursor.consume('}')) return false;
+
+    std::string key, type;
+    do {
+        if (!cursor.parseString(&key) || !cursor.consume(':')) return false;
+        if (key == "type") {
+            if (!cursor.parseString(&type)) return false;
+            isPoint = (type == "Point");
+        } else if (key == "coordinates") {
+            // [longitude, latitude, optional altitude...]
+            if (!cursor.consume('[') || !cursor.parseNumber(&coordinate->longitude) ||
+                !cursor.consume(',') || !cursor.parseNumber(&coordinate->latitude)) {
+                return false;
+            }
+            while (cursor.consume(',')) {
+                if (!cursor.parseNumber(NULL)) return false;
+            }
+            if (!cursor.consume(']')) return false;
+            hasCoordinates = true;
+        } else if (!cursor.skipValue()) {
+            return false;
+        }
+    } while (cursor.consume(','));
+
+    return cursor.consume('}') && isPoint && hasCoordinates;
+}
+
+static bool parseProperties(JSONCursor &cursor, PlaceRecord *record)
+{
+    if (cursor.consumeNull()) return true;
+    if (!cursor.consume('{')) return false;
+    if (cursor.consume('}')) return true;
+
+    std::string key;
+    do {
+        if (!cursor.parseString(&key) || !cursor.consume(':')) return false;
+        bool parsed;
+        if (key == "name") {
+            parsed = cursor.consumeNull() || cursor.parseString(&record->name);
+        } else if (key == "horizontalAccuracy") {
+            parsed = parseOptionalNumber(cursor, &record->horizontalAccuracy, -1.0);
+        } else if (key == "creationDate") {
+            parsed = parseOptionalNumber(cursor, &record->creationDate, kUnknownPlaceDate);
+        } else if (key == "locationTimestamp") {
+            parsed = parseOptionalNumber(cursor, &record->locationTimestamp, kUnknownPlaceDate);
+        } else {
+            parsed = cursor.skipValue();
+        }
+        if (!parsed) return false;
+    } while (cursor.consume(','));
+
+    return cursor.consume('}');
+}
+
+/**
+ * Parse a line holding one GeoJSON Point Feature
+ */
+static bool parseFeature(const std::string &line, PlaceRecord *record)
+{
+    *record = PlaceRecord();
+    JSONCursor cursor(line);
+    bool isFeature = false, hasGeometry = false;
+    if (!cursor.consume('{')) return false;
+    if (cursor.consume('}')) return false;
+
+    std::string key, type;
+    do {
+        if (!cursor.parseString(&key) || !cursor.consume(':')) return false;
+        bool parsed;
+        if (key == "type") {
+            parsed = cursor.parseString(&type);
+            isFeature = (type == "Feature");
+        } else if (key == "geometry") {
+            parsed = hasGeometry = parseGeometry(cursor, &record->coordinate);
+        } else if (key == "properties") {
+            parsed = parseProperties(cursor, record);
+        } else {
+            parsed = cursor.skipValue();
+        }
+        if (!parsed) return false;
+    } while (cursor.consume(','));
+
+    if (!cursor.consume('}') || !cursor.atEnd() || !isFeature || !hasGeometry) return false;
+    return (std::fabs(record->coordinate.latitude) <= 90.0) && (std::fabs(record->coordinate.longitude) <= 180.0);
+}
+
+
+#pragma mark - PlaceArchiveWriter
+PlaceArchiveWriter::PlaceArchiveWriter(std::ostream &output, PlaceFormat format)
+    : _output(output), _format(format), _numWritten(0),
+      _latitude(0), _longitude(0), _creationDate(0), _locationTimestamp(0)
+{
+    if (format == kPlaceFormatBinary) {
+        _output.write(kBinaryMagic, sizeof(kBinaryMagic));
+        _output.put((char)kBinaryVersion);
+    }
+}
+
+void PlaceArchiveWriter::write(const PlaceRecord &record)
+{
+    if (_format == kPlaceFormatBinary) writeBinary(record);
+    else writeGeoJSON(record);
+    _numWritten++;
+}
+
+void PlaceArchiveWriter::writeGeoJSON(const PlaceRecord &record)
+{
+    _buffer.assign("{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[");
+    appendJSONNumber(_buffer, "%.7f", record.coordinate.longitude);
+    _buffer.push_back(',');
+    appendJSONNumber(_buffer, "%.7f", record.coordinate.latitude);
+    _buffer.append("]},\"properties\":{\"name\":");
+    appendJSONString(_buffer, record.name);
+    if (record.horizontalAccuracy >= 0) {
+        _buffer.append(",\"horizontalAccuracy\":");
+        appendJSONNumber(_buffer, "%.2f", record.horizontalAccuracy);
+    }
+    if (!std::isnan(record.creationDate)) {
+        _buffer.append(",\"creationDate\":");
+        appendJSONNumber(_buffer, "%.3f", record.creationDate);
+    }
+    if (!std::isnan(record.locationTimestamp)) {
+        _buffer.append(",\"locationTimestamp\":");
+        appendJSONNumber(_buffer, "%.3f", record.locationTimestamp);
+    }
+    _buffer.append("}}\n");
+    _output.write(_buffer.data(), _buffer.size());
+}
+
+void PlaceArchiveWriter::writeBinary(const PlaceRecord &record)
+{
+    uint8_t flags = 0;
+    if (record.horizontalAccuracy >= 0) flags |= kHasAccuracy;
+    if (!std::isnan(record.creationDate)) flags |= kHasCreationDate;
+    if (!std::isnan(record.locationTimestamp)) flags |= kHasLocationTimestamp;
+
+    _buffer.clear();
+    _buffer.push_back((char)flags);
+
+    int64_t latitude = (int64_t)std::llround(record.coordinate.latitude * kCoordinateScale);
+    int64_t longitude = (int64_t)std::llround(record.coordinate.longitude * kCoordinateScale);
+    appendSignedVarint(_buffer, latitude - _latitude);
+    appendSignedVarint(_buffer, longitude - _longitude);
+    _latitude = latitude;
+    _longitude = longitude;
+
+    if (flags & kHasAccuracy) {
+        appendVarint(_buffer, (uint64_t)std::llround(record.horizontalAccuracy * 100.0));
+    }
+    if (flags & kHasCreationDate) {
+        int64_t creationDate = milliseconds(record.creationDate);
+        appendSignedVarint(_buffer, creationDate - _creationDate);
+        _creationDate = creationDate;
+    }
+    if (flags & kHasLocationTimestamp) {
+        int64_t locationTimestamp = milliseconds(record.locationTimestamp);
+        appendSignedVarint(_buffer, locationTimestamp - _locationTimestamp);
+        _locationTimestamp = locationTimestamp;
+    }
+
+    appendVarint(_buffer, record.name.size());
+    _buffer.append(record.name);
+
+    std::string length;
+    appendVarint(length, _buffer.size());
+    _output.write(length.data(), length.size());
+    _output.write(_buffer.data(), _buffer.size());
+}
+
+
+#pragma mark - PlaceArchiveReader
+PlaceArchiveReader::PlaceArchiveReader(std::istream &input)
+    : _input(input), _format(kPlaceFormatGeoJSON), _failed(false), _numRead(0), _numSkipped(0),
+      _latitude(0), _longitude(0), _creationDate(0), _locationTimestamp(0)
+{
+    // JSON can't start with the binary magic's first byte
+    if (_input.peek() != kBinaryMagic[0]) return;
+
+    _format = kPlaceFormatBinary;
+    char magic[sizeof(kBinaryMagic)];
+    _input.read(magic, sizeof(magic));
+    int version = _input.get();
+    if (!_input || std::memcmp(magic, kBinaryMagic, sizeof(magic)) || (version != kBinaryVersion)) {
+        _failed = true;
+    }
+}
+
+bool PlaceArchiveReader::read(PlaceRecord *record)
+{
+    if (_failed) return false;
+    bool found = (_format == kPlaceFormatBinary) ? readBinary(record) : readGeoJSON(record);
+    if (found) _numRead++;
+    return found;
+}
+
+bool PlaceArchiveReader::readGeoJSON(PlaceRecord *record)
+{
+    while (std::getline(_input, _buffer)) {
+        if (_buffer.size() > kMaxRecordLength) {
+            _numSkipped++;
+            continue;
+        }
+        if (_buffer.find_first_not_of(" \t\r") == std::string::npos) continue;
+        if (parseFeature(_buffer, record)) return true;
+        _numSkipped++;
+    }
+    return false;
+}
+
+bool PlaceArchiveReader::readBinary(PlaceRecord *record)
+{
+    uint64_t length;
+    size_t numLengthBytes;
+    if (!readVarint(_input, &length, &numLengthBytes)) {
+        // a clean end falls exactly between records
+        _failed = (numLengthBytes > 0) || !_input.eof();
+        return false;
+    }
+    if ((length == 0) || (length > kMaxRecordLength)) {
+        _failed = true;
+        return false;
+    }
+    _buffer.resize(length);
+    _input.read(&_buffer[0], length);
+    if ((uint64_t)_input.gcount() != length) {
+        _failed = true;
+        return false;
+    }
+
+    *record = PlaceRecord();
+    const char *cursor = _buffer.data(), *end = cursor + _buffer.size();
+    uint8_t flags = (uint8_t)*cursor++;
+
+    int64_t deltaLatitude, deltaLongitude;
+    if (!parseSignedVarint(cursor, end, &deltaLatitude) || !parseSignedVarint(cursor, end, &deltaLongitude)) {
+        _failed = true;
+        return false;
+    }
+    _latitude += deltaLatitude;
+    _longitude += deltaLongitude;
+    record->coordinate = GeoPoint(_latitude / kCoordinateScale, _longitude / kCoordinateScale);
+
+    bool parsed = true;
+    if (flags & kHasAccuracy) {
+        uint64_t centimeters = 0;
+        parsed = parseVarint(cursor, end, &centimeters);
+        record->horizontalAccuracy = centimeters / 100.0;
+    }
+    if (parsed && (flags & kHasCreationDate)) {
+        int64_t delta = 0;
+        parsed = parseSignedVarint(cursor, end, &delta);
+        _creationDate += delta;
+        record->creationDate = _creationDate / 1e3;
+    }
+    if (parsed && (flags & kHasLocationTimestamp)) {
+        int64_t delta = 0;
+        parsed = parseSignedVarint(cursor, end, &delta);
+        _locationTimestamp += delta;
+        record->locationTimestamp = _locationTimestamp / 1e3;
+    }
+
+    uint64_t nameLength = 0;
+    if (parsed) parsed = parseVarint(cursor, end, &nameLength) && (nameLength <= (uint64_t)(end - cursor));
+    if (!parsed) {
+        _failed = true;
+        return false;
+    }
+    record->name.assign(cursor, nameLength);
+    return true;
+}
+
+} // namespace rtc
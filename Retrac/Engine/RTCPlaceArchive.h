@@ -0,0 +1,138 @@
+//
+//  RTCPlaceArchive.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/21/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCPlaceArchive_h
+#define Retrac_RTCPlaceArchive_h
+
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include "RTCGeo.h"
+
+namespace rtc {
+
+/**
+ * Marks a PlaceRecord date that isn't known
+ */
+static const double kUnknownPlaceDate = std::numeric_limits<double>::quiet_NaN();
+
+/**
+ * PlaceRecord is one saved place as it is exported and imported
+ */
+struct PlaceRecord {
+    std::string name;               // UTF-8
+    GeoPoint coordinate;
+    double horizontalAccuracy;      // meters, negative if unknown
+    double creationDate;            // seconds since 1970, or kUnknownPlaceDate
+    double locationTimestamp;       // seconds since 1970, or kUnknownPlaceDate
+
+    PlaceRecord() : horizontalAccuracy(-1.0), creationDate(kUnknownPlaceDate),
+                    locationTimestamp(kUnknownPlaceDate) {}
+};
+
+/**
+ * Place archive formats.
+ *
+ * - GeoJSON is newline-delimited GeoJSON: one Point Feature per line, with
+ *   name, horizontalAccuracy, creationDate and locationTimestamp properties
+ *   (dates in seconds since 1970).
+ * - Binary starts with the 8 byte magic "RTCPLACE" and a version byte, then
+ *   each place is a varint length followed by that many bytes: a flags byte
+ *   for which optional fields are present, the coordinate as zigzag varint
+ *   deltas from the previous place in units of 1e-7 degrees (about a
+ *   centimeter), accuracy in centimeters, dates as zigzag varint millisecond
+ *   deltas from the previous place's, and the name's length and bytes. Readers
+ *   skip any bytes of a record past the fields they know.
+ */
+enum PlaceFormat {
+    kPlaceFormatGeoJSON,
+    kPlaceFormatBinary
+};
+
+/**
+ * PlaceArchiveWriter streams places to an archive one at a time, so exporting
+ * needs memory for one place rather than all of them.
+ */
+class PlaceArchiveWriter {
+public:
+    PlaceArchiveWriter(std::ostream &output, PlaceFormat format);
+
+    void write(const PlaceRecord &record);
+
+    /**
+     * @return false if writing to the stream failed
+     */
+    bool good() const { return _output.good(); }
+
+    size_t numWritten() const { return _numWritten; }
+
+private:
+    void writeGeoJSON(const PlaceRecord &record);
+    void writeBinary(const PlaceRecord &record);
+
+    std::ostream &_output;
+    PlaceFormat _format;
+    size_t _numWritten;
+
+    // delta encoding state: the previous binary record's quantized fields
+    int64_t _latitude, _longitude, _creationDate, _locationTimestamp;
+
+    std::string _buffer;    // the record being encoded, reused
+};
+
+/**
+ * PlaceArchiveReader streams places from an archive one at a time, working out
+ * its format from the first byte.
+ *
+ * GeoJSON lines that aren't Point features are counted and skipped, so one bad
+ * line doesn't lose the rest of a file. A binary archive has no way to resync
+ * after a corrupt record, so reading stops there and failed() is set.
+ */
+class PlaceArchiveReader {
+public:
+    explicit PlaceArchiveReader(std::istream &input);
+
+    PlaceFormat format() const { return _format; }
+
+    /**
+     * Read the next place.
+     *
+     * @return false at the end of the archive or on an error
+     */
+    bool read(PlaceRecord *record);
+
+    /**
+     * Did reading stop on a bad header or corrupt record rather than at the
+     * end?
+     */
+    bool failed() const { return _failed; }
+
+    size_t numRead() const { return _numRead; }
+    size_t numSkipped() const { return _numSkipped; }
+
+private:
+    bool readGeoJSON(PlaceRecord *record);
+    bool readBinary(PlaceRecord *record);
+
+    std::istream &_input;
+    PlaceFormat _format;
+    bool _failed;
+    size_t _numRead, _numSkipped;
+
+    int64_t _latitude, _longitude, _creationDate, _locationTimestamp;
+
+    std::string _buffer;    // the line or record being decoded, reused
+};
+
+} // namespace rtc
+
+#endif
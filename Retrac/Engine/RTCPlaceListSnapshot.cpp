@@ -0,0 +1,123 @@
+//
+//  RTCPlaceListSnapshot.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/26/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCPlaceListSnapshot.h"
+#include <cstdint>
+#include <cstring>
+
+namespace rtc {
+
+#pragma mark - Constants
+static const uint32_t kPlaceSnapshotMagic = 0x504e5352; // "RSNP"
+static const uint16_t kPlaceSnapshotVersion = 1;
+
+// field offsets within a record
+static const size_t kLatitudeOffset = 0;
+static const size_t kLongitudeOffset = 8;
+static const size_t kCreationDateOffset = 16;
+static const size_t kLabelOffsetOffset = 24;
+static const size_t kLabelLengthOffset = 28;
+
+
+#pragma mark - Helpers
+// records only line up on 8 bytes if the file was mapped at a page boundary,
+// so don't count on it
+template <typename T>
+static T readField(const char *field)
+{
+    T value;
+    memcpy(&value, field, sizeof(value));
+    return value;
+}
+
+
+#pragma mark - Serialization
+bool writePlaceSnapshot(std::ostream &output, const std::vector<SnapshotPlace> &places)
+{
+    uint16_t recordSize = kPlaceSnapshotRecordSize;
+    uint64_t count = places.size();
+    output.write((const char *)&kPlaceSnapshotMagic, sizeof(kPlaceSnapshotMagic));
+    output.write((const char *)&kPlaceSnapshotVersion, sizeof(kPlaceSnapshotVersion));
+    output.write((const char *)&recordSize, sizeof(recordSize));
+    output.write((const char *)&count, sizeof(count));
+
+    // labels go one after another, so each starts where the last ended
+    uint32_t labelOffset = 0;
+    for (size_t i = 0; i < places.size(); ++i) {
+        const SnapshotPlace &place = places[i];
+        uint32_t labelLength = (uint32_t)place.label.size();
+        output.write((const char *)&place.coordinate.latitude, sizeof(place.coordinate.latitude));
+        output.write((const char *)&place.coordinate.longitude, sizeof(place.coordinate.longitude));
+        output.write((const char *)&place.creationDate, sizeof(place.creationDate));
+        output.write((const char *)&labelOffset, sizeof(labelOffset));
+        output.write((const char *)&labelLength, sizeof(labelLength));
+        labelOffset += labelLength;
+    }
+
+    for (size_t i = 0; i < places.size(); ++i) output.write(places[i].label.data(), places[i].label.size());
+    return output.good();
+}
+
+
+#pragma mark - PlaceSnapshotView
+bool PlaceSnapshotView::open(const void *data, size_t size)
+{
+    _data = NULL;
+    _count = 0;
+    if (!data || (size < kPlaceSnapshotHeaderSize)) return false;
+
+    const char *bytes = (const char *)data;
+    uint64_t count = readField<uint64_t>(bytes + 8);
+    if ((readField<uint32_t>(bytes) != kPlaceSnapshotMagic) ||
+        (readField<uint16_t>(bytes + 4) != kPlaceSnapshotVersion) ||
+        (readField<uint16_t>(bytes + 6) != kPlaceSnapshotRecordSize) ||
+        (count > (size - kPlaceSnapshotHeaderSize) / kPlaceSnapshotRecordSize)) {
+        return false;
+    }
+
+    // every label has to lie within the file
+    size_t labelsStart = kPlaceSnapshotHeaderSize + (size_t)count * kPlaceSnapshotRecordSize;
+    size_t labelsSize = size - labelsStart;
+    for (size_t i = 0; i < count; ++i) {
+        const char *fields = bytes + kPlaceSnapshotHeaderSize + i * kPlaceSnapshotRecordSize;
+        uint32_t offset = readField<uint32_t>(fields + kLabelOffsetOffset);
+        uint32_t length = readField<uint32_t>(fields + kLabelLengthOffset);
+        if ((offset > labelsSize) || (length > labelsSize - offset)) return false;
+    }
+
+    _data = bytes;
+    _count = (size_t)count;
+    return true;
+}
+
+GeoPoint PlaceSnapshotView::coordinate(size_t index) const
+{
+    const char *fields = record(index);
+    return GeoPoint(readField<double>(fields + kLatitudeOffset), readField<double>(fields + kLongitudeOffset));
+}
+
+double PlaceSnapshotView::creationDate(size_t index) const
+{
+    return readField<double>(record(index) + kCreationDateOffset);
+}
+
+const char *PlaceSnapshotView::label(size_t index, size_t *length) const
+{
+    const char *fields = record(index);
+    *length = readField<uint32_t>(fields + kLabelLengthOffset);
+    return _data + kPlaceSnapshotHeaderSize + _count * kPlaceSnapshotRecordSize + readField<uint32_t>(fields + kLabelOffsetOffset);
+}
+
+std::string PlaceSnapshotView::labelString(size_t index) const
+{
+    size_t length = 0;
+    const char *bytes = label(index, &length);
+    return std::string(bytes, length);
+}
+
+} // namespace rtc
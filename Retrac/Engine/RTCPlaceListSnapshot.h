@@ -0,0 +1,91 @@
+//
+//  RTCPlaceListSnapshot.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/26/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCPlaceListSnapshot_h
+#define Retrac_RTCPlaceListSnapshot_h
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "RTCGeo.h"
+
+namespace rtc {
+
+/**
+ * SnapshotPlace is one row of the places list as it is first shown
+ */
+struct SnapshotPlace {
+    std::string label;          // UTF-8, as the list shows it
+    GeoPoint coordinate;
+    double creationDate;        // seconds since 1970
+
+    SnapshotPlace() : creationDate(0) {}
+    SnapshotPlace(const std::string &aLabel, const GeoPoint &aCoordinate, double aCreationDate)
+        : label(aLabel), coordinate(aCoordinate), creationDate(aCreationDate) {}
+};
+
+/**
+ * Place snapshot files hold the first rows of the places list so they can be
+ * shown at launch, before the store is open. They are laid out to be read in
+ * place from a memory-mapped file: a 16 byte header (magic, version, record
+ * size, count), then a 32 byte record per place (latitude, longitude,
+ * creation date, label offset and length), then the labels' UTF-8 bytes.
+ * Numbers are in the device's byte order; a snapshot is only ever read back by
+ * the device that wrote it.
+ */
+static const size_t kPlaceSnapshotHeaderSize = 16;
+static const size_t kPlaceSnapshotRecordSize = 32;
+
+/**
+ * Write a snapshot of places, in the order given.
+ *
+ * @return false if writing to the stream failed
+ */
+bool writePlaceSnapshot(std::ostream &output, const std::vector<SnapshotPlace> &places);
+
+/**
+ * PlaceSnapshotView reads a snapshot where it lies, without copying it. Every
+ * offset is checked when it is opened, so a truncated or corrupt file is
+ * rejected up front rather than read past.
+ */
+class PlaceSnapshotView {
+public:
+    PlaceSnapshotView() : _data(NULL), _count(0) {}
+
+    /**
+     * @param data  snapshot bytes, which must outlive the view
+     *
+     * @return false (leaving the view empty) if they aren't a valid snapshot
+     */
+    bool open(const void *data, size_t size);
+
+    size_t size() const { return _count; }
+
+    GeoPoint coordinate(size_t index) const;
+    double creationDate(size_t index) const;
+
+    /**
+     * A place's label bytes, not NUL terminated
+     */
+    const char *label(size_t index, size_t *length) const;
+
+    std::string labelString(size_t index) const;
+
+private:
+    const char *record(size_t index) const { return _data + kPlaceSnapshotHeaderSize + index * kPlaceSnapshotRecordSize; }
+
+    const char *_data;
+    size_t _count;
+};
+
+} // namespace rtc
+
+#endif
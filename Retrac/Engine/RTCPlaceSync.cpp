@@ -0,0 +1,596 @@
+//
+//  RTCPlaceSync.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/31/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCPlaceSync.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "RTCVarint.h"
+
+namespace rtc {
+
+#pragma mark - Constants
+static const uint8_t kMessageVersion = 1;
+
+// a saved replica starts with these, then a version byte
+static const char kReplicaMagic[8] = {'R', 'T', 'C', 'P', 'S', 'Y', 'N', 'C'};
+static const uint8_t kReplicaVersion = 1;
+
+static const unsigned kCounterBits = 16;
+static const uint64_t kMaxMilliseconds = (1ULL << 48) - 1;
+
+// op flags byte: the kind in the low 2 bits, then
+static const uint8_t kKindMask              = 0x03;
+static const uint8_t kSameDevice            = 1 << 2;   // device is the previous op's
+static const uint8_t kNextSeq               = 1 << 3;   // seq is the previous op's plus one
+static const uint8_t kKnownPlace            = 1 << 4;   // place is an index into those already in the message
+static const uint8_t kHasAccuracy           = 1 << 5;   // creates only
+static const uint8_t kHasCreationDate       = 1 << 6;   // creates only
+static const uint8_t kHasLocationTimestamp  = 1 << 7;   // creates only
+static const uint8_t kCreateFlags = kHasAccuracy | kHasCreationDate | kHasLocationTimestamp;
+
+// 1e-7 degrees, about a centimeter, as in the place archive
+static const double kCoordinateScale = 1e7;
+
+// longest name a message may hold
+static const uint64_t kMaxNameLength = 1 << 12;
+
+
+#pragma mark - Encoding Helpers
+static void appendFixed64(std::string &buffer, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i) buffer.push_back((char)(value >> (8 * i)));
+}
+
+static bool parseFixed64(const char *&cursor, const char *end, uint64_t *value)
+{
+    if (end - cursor < 8) return false;
+    uint64_t result = 0;
+    for (int i = 0; i < 8; ++i) result |= (uint64_t)(uint8_t)cursor[i] << (8 * i);
+    cursor += 8;
+    *value = result;
+    return true;
+}
+
+static int64_t milliseconds(double seconds)
+{
+    return (int64_t)std::llround(seconds * 1e3);
+}
+
+/**
+ * A new place's record as it comes out of a message, so the device that made
+ * it holds exactly what every other device will
+ */
+static PlaceRecord quantizedRecord(const PlaceRecord &record)
+{
+    PlaceRecord quantized = record;
+    quantized.coordinate.latitude = std::llround(record.coordinate.latitude * kCoordinateScale) / kCoordinateScale;
+    quantized.coordinate.longitude = std::llround(record.coordinate.longitude * kCoordinateScale) / kCoordinateScale;
+    if (record.horizontalAccuracy >= 0) quantized.horizontalAccuracy = std::llround(record.horizontalAccuracy * 100.0) / 100.0;
+    else quantized.horizontalAccuracy = -1.0;
+    if (!std::isnan(record.creationDate)) quantized.creationDate = milliseconds(record.creationDate) / 1e3;
+    if (!std::isnan(record.locationTimestamp)) quantized.locationTimestamp = milliseconds(record.locationTimestamp) / 1e3;
+    if (quantized.name.size() > kMaxNameLength) quantized.name.resize(kMaxNameLength);
+    return quantized;
+}
+
+
+#pragma mark - PlaceUUID
+PlaceUUID PlaceUUID::fromBytes(const uint8_t bytes[16])
+{
+    PlaceUUID uuid;
+    for (int i = 0; i < 8; ++i) {
+        uuid.high = (uuid.high << 8) | bytes[i];
+        uuid.low = (uuid.low << 8) | bytes[8 + i];
+    }
+    return uuid;
+}
+
+void PlaceUUID::getBytes(uint8_t bytes[16]) const
+{
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = (uint8_t)(high >> (56 - 8 * i));
+        bytes[8 + i] = (uint8_t)(low >> (56 - 8 * i));
+    }
+}
+
+
+#pragma mark - HybridClock
+HybridTime hybridTime(double seconds, uint16_t counter)
+{
+    int64_t ms = milliseconds(seconds);
+    if (ms < 0) ms = 0;
+    if ((uint64_t)ms > kMaxMilliseconds) ms = (int64_t)kMaxMilliseconds;
+    return ((uint64_t)ms << kCounterBits) | counter;
+}
+
+double hybridTimeSeconds(HybridTime time)
+{
+    return (time >> kCounterBits) / 1e3;
+}
+
+HybridTime HybridClock::now()
+{
+    // a clock that went backwards, or a burst within a millisecond, just
+    //   counts up from the last time handed out
+    HybridTime wall = hybridTime(_clock->now());
+    _last = (wall > _last) ? wall : _last + 1;
+    return _last;
+}
+
+
+#pragma mark - SyncMessage
+void encodeSyncMessage(const SyncMessage &message, std::string &bytes)
+{
+    bytes.clear();
+    bytes.push_back((char)kMessageVersion);
+
+    appendVarint(bytes, message.version.size());
+    for (VersionVector::const_iterator it = message.version.begin(); it != message.version.end(); ++it) {
+        appendFixed64(bytes, it->first);
+        appendVarint(bytes, it->second);
+    }
+
+    appendVarint(bytes, message.ops.size());
+    std::unordered_map<PlaceUUID, uint32_t, PlaceUUIDHash> placeIndexes;
+    DeviceID device = 0;
+    uint32_t seq = 0;
+    int64_t ms = 0, latitude = 0, longitude = 0;
+    for (size_t i = 0; i < message.ops.size(); ++i) {
+        const PlaceOp &op = message.ops[i];
+
+        uint8_t flags = (uint8_t)(op.kind & kKindMask);
+        if ((i > 0) && (op.device == device)) flags |= kSameDevice;
+        if ((flags & kSameDevice) && (op.seq == seq + 1)) flags |= kNextSeq;
+        std::unordered_map<PlaceUUID, uint32_t, PlaceUUIDHash>::const_iterator known = placeIndexes.find(op.place);
+        if (known != placeIndexes.end()) flags |= kKnownPlace;
+        if (op.kind == PlaceOp::KindCreate) {
+            if (op.record.horizontalAccuracy >= 0) flags |= kHasAccuracy;
+            if (!std::isnan(op.record.creationDate)) flags |= kHasCreationDate;
+            if (!std::isnan(op.record.locationTimestamp)) flags |= kHasLocationTimestamp;
+        }
+        bytes.push_back((char)flags);
+
+        if (!(flags & kSameDevice)) appendFixed64(bytes, op.device);
+        if (!(flags & kNextSeq)) appendVarint(bytes, op.seq);
+        device = op.device;
+        seq = op.seq;
+
+        // milliseconds from the last op, then the counter
+        int64_t opMs = (int64_t)(op.time >> kCounterBits);
+        appendSignedVarint(bytes, opMs - ms);
+        appendVarint(bytes, op.time & ((1 << kCounterBits) - 1));
+        ms = opMs;
+
+        if (flags & kKnownPlace) {
+            appendVarint(bytes, known->second);
+        } else {
+            uint8_t uuid[16];
+            op.place.getBytes(uuid);
+            bytes.append((const char *)uuid, 16);
+            uint32_t index = (uint32_t)placeIndexes.size();
+            placeIndexes[op.place] = index;
+        }
+
+        switch (op.kind) {
+            case PlaceOp::KindCreate: {
+                int64_t opLatitude = (int64_t)std::llround(op.record.coordinate.latitude * kCoordinateScale);
+                int64_t opLongitude = (int64_t)std::llround(op.record.coordinate.longitude * kCoordinateScale);
+                appendSignedVarint(bytes, opLatitude - latitude);
+                appendSignedVarint(bytes, opLongitude - longitude);
+                latitude = opLatitude;
+                longitude = opLongitude;
+
+                if (flags & kHasAccuracy) {
+                    appendVarint(bytes, (uint64_t)std::llround(op.record.horizontalAccuracy * 100.0));
+                }
+                // dates are close to when the place was saved
+                if (flags & kHasCreationDate) appendSignedVarint(bytes, milliseconds(op.record.creationDate) - opMs);
+                if (flags & kHasLocationTimestamp) appendSignedVarint(bytes, milliseconds(op.record.locationTimestamp) - opMs);
+                appendSignedVarint(bytes, op.timeout);
+                size_t nameLength = std::min<size_t>(op.record.name.size(), kMaxNameLength);
+                appendVarint(bytes, nameLength);
+                bytes.append(op.record.name, 0, nameLength);
+                break;
+            }
+            case PlaceOp::KindRename: {
+                size_t nameLength = std::min<size_t>(op.record.name.size(), kMaxNameLength);
+                appendVarint(bytes, nameLength);
+                bytes.append(op.record.name, 0, nameLength);
+                break;
+            }
+            case PlaceOp::KindSetTimeout:
+                appendSignedVarint(bytes, op.timeout);
+                break;
+            case PlaceOp::KindDelete:
+                break;
+        }
+    }
+}
+
+bool decodeSyncMessage(const char *data, size_t size, SyncMessage *message)
+{
+    message->version.clear();
+    message->ops.clear();
+
+    const char *cursor = data, *end = data + size;
+    if ((cursor == end) || ((uint8_t)*cursor++ != kMessageVersion)) return false;
+
+    // every entry takes at least 9 bytes, and every op 3
+    uint64_t numDevices;
+    if (!parseVarint(cursor, end, &numDevices) || (numDevices > (uint64_t)(end - cursor) / 9)) return false;
+    for (uint64_t i = 0; i < numDevices; ++i) {
+        uint64_t device, seq;
+        if (!parseFixed64(cursor, end, &device) || !parseVarint(cursor, end, &seq) || (seq > UINT32_MAX)) return false;
+        message->version[device] = (uint32_t)seq;
+    }
+
+    uint64_t numOps;
+    if (!parseVarint(cursor, end, &numOps) || (numOps > (uint64_t)(end - cursor) / 3)) return false;
+    message->ops.resize((size_t)numOps);
+
+    std::vector<PlaceUUID> places;
+    DeviceID device = 0;
+    uint64_t seq = 0;
+    int64_t ms = 0, latitude = 0, longitude = 0;
+    for (uint64_t i = 0; i < numOps; ++i) {
+        PlaceOp &op = message->ops[(size_t)i];
+        if (cursor == end) return false;
+        uint8_t flags = (uint8_t)*cursor++;
+        op.kind = (PlaceOp::Kind)(flags & kKindMask);
+        if ((op.kind != PlaceOp::KindCreate) && (flags & kCreateFlags)) return false;
+        if ((i == 0) && (flags & kSameDevice)) return false;
+        if ((flags & kNextSeq) && !(flags & kSameDevice)) return false;
+
+        if (!(flags & kSameDevice) && !parseFixed64(cursor, end, &device)) return false;
+        if (flags & kNextSeq) seq++;
+        else if (!parseVarint(cursor, end, &seq)) return false;
+        if ((seq == 0) || (seq > UINT32_MAX)) return false;
+        op.device = device;
+        op.seq = (uint32_t)seq;
+
+        int64_t deltaMs;
+        uint64_t counter;
+        if (!parseSignedVarint(cursor, end, &deltaMs) || !parseVarint(cursor, end, &counter)) return false;
+        ms += deltaMs;
+        if ((ms < 0) || ((uint64_t)ms > kMaxMilliseconds) || (counter >> kCounterBits)) return false;
+        op.time = ((uint64_t)ms << kCounterBits) | counter;
+
+        if (flags & kKnownPlace) {
+            uint64_t index;
+            if (!parseVarint(cursor, end, &index) || (index >= places.size())) return false;
+            op.place = places[(size_t)index];
+        } else {
+            if (end - cursor < 16) return false;
+            op.place = PlaceUUID::fromBytes((const uint8_t *)cursor);
+            cursor += 16;
+            places.push_back(op.place);
+        }
+
+        bool parsed = true;
+        bool hasName = false;
+        switch (op.kind) {
+            case PlaceOp::KindCreate: {
+                int64_t deltaLatitude = 0, deltaLongitude = 0;
+                parsed = parseSignedVarint(cursor, end, &deltaLatitude) && parseSignedVarint(cursor, end, &deltaLongitude);
+                latitude += deltaLatitude;
+                longitude += deltaLongitude;
+                op.record.coordinate = GeoPoint(latitude / kCoordinateScale, longitude / kCoordinateScale);
+
+                if (parsed && (flags & kHasAccuracy)) {
+                    uint64_t centimeters = 0;
+                    parsed = parseVarint(cursor, end, &centimeters);
+                    op.record.horizontalAccuracy = centimeters / 100.0;
+                }
+                if (parsed && (flags & kHasCreationDate)) {
+                    int64_t delta = 0;
+                    parsed = parseSignedVarint(cursor, end, &delta);
+                    op.record.creationDate = (ms + delta) / 1e3;
+                }
+                if (parsed && (flags & kHasLocationTimestamp)) {
+                    int64_t delta = 0;
+                    parsed = parseSignedVarint(cursor, end, &delta);
+                    op.record.locationTimestamp = (ms + delta) / 1e3;
+                }
+                int64_t timeout = 0;
+                parsed = parsed && parseSignedVarint(cursor, end, &timeout) &&
+                         (timeout >= INT32_MIN) && (timeout <= INT32_MAX);
+                op.timeout = (int32_t)timeout;
+                hasName = true;
+                break;
+            }
+            case PlaceOp::KindRename:
+                hasName = true;
+                break;
+            case PlaceOp::KindSetTimeout: {
+                int64_t timeout = 0;
+                parsed = parseSignedVarint(cursor, end, &timeout) && (timeout >= INT32_MIN) && (timeout <= INT32_MAX);
+                op.timeout = (int32_t)timeout;
+                break;
+            }
+            case PlaceOp::KindDelete:
+                break;
+        }
+        if (parsed && hasName) {
+            uint64_t nameLength = 0;
+            parsed = parseVarint(cursor, end, &nameLength) && (nameLength <= kMaxNameLength) &&
+                     (nameLength <= (uint64_t)(end - cursor));
+            if (parsed) {
+                op.record.name.assign(cursor, (size_t)nameLength);
+                cursor += nameLength;
+            }
+        }
+        if (!parsed) return false;
+    }
+    return cursor == end;
+}
+
+
+#pragma mark - PlaceReplica
+PlaceReplica::PlaceReplica(DeviceID device, const Clock &clock)
+    : _device(device), _clock(clock), _numOps(0), _numLivePlaces(0)
+{
+}
+
+void PlaceReplica::clear()
+{
+    _logs.clear();
+    _version.clear();
+    _serverVersion.clear();
+    _numOps = 0;
+    _places.clear();
+    _numLivePlaces = 0;
+}
+
+PlaceOp PlaceReplica::localOp(PlaceOp::Kind kind, const PlaceUUID &place)
+{
+    PlaceOp op;
+    op.kind = kind;
+    op.device = _device;
+    VersionVector::const_iterator last = _version.find(_device);
+    op.seq = (last != _version.end()) ? last->second + 1 : 1;
+    op.time = _clock.now();
+    op.place = place;
+    return op;
+}
+
+PlaceOp PlaceReplica::create(const PlaceUUID &place, const PlaceRecord &record, int32_t timeout)
+{
+    PlaceOp op = localOp(PlaceOp::KindCreate, place);
+    op.record = quantizedRecord(record);
+    op.timeout = timeout;
+    merge(op);
+    return op;
+}
+
+PlaceOp PlaceReplica::rename(const PlaceUUID &place, const std::string &name)
+{
+    PlaceOp op = localOp(PlaceOp::KindRename, place);
+    op.record.name = name.substr(0, kMaxNameLength);
+    merge(op);
+    return op;
+}
+
+PlaceOp PlaceReplica::remove(const PlaceUUID &place)
+{
+    PlaceOp op = localOp(PlaceOp::KindDelete, place);
+    merge(op);
+    return op;
+}
+
+PlaceOp PlaceReplica::setTimeout(const PlaceUUID &place, int32_t timeout)
+{
+    PlaceOp op = localOp(PlaceOp::KindSetTimeout, place);
+    op.timeout = timeout;
+    merge(op);
+    return op;
+}
+
+bool PlaceReplica::merge(const PlaceOp &op, bool *changed)
+{
+    if (changed) *changed = false;
+
+    VersionVector::iterator last = _version.find(op.device);
+    uint32_t lastSeq = (last != _version.end()) ? last->second : 0;
+    if (op.seq != lastSeq + 1) return false;
+
+    if (last != _version.end()) last->second = op.seq;
+    else _version[op.device] = op.seq;
+    _logs[op.device].push_back(op);
+    _numOps++;
+    _clock.observe(op.time);
+
+    bool visible = apply(op);
+    if (changed) *changed = visible;
+    return true;
+}
+
+size_t PlaceReplica::merge(const std::vector<PlaceOp> &ops, std::vector<PlaceUUID> *changed)
+{
+    size_t numMerged = 0;
+    size_t firstChanged = changed ? changed->size() : 0;
+    for (size_t i = 0; i < ops.size(); ++i) {
+        bool visible = false;
+        if (!merge(ops[i], &visible)) continue;
+        numMerged++;
+        if (visible && changed) changed->push_back(ops[i].place);
+    }
+
+    if (changed) {
+        std::sort(changed->begin() + firstChanged, changed->end());
+        std::inplace_merge(changed->begin(), changed->begin() + firstChanged, changed->end());
+        changed->erase(std::unique(changed->begin(), changed->end()), changed->end());
+    }
+    return numMerged;
+}
+
+/**
+ * Fold op into its place.
+ *
+ * @return true if the place was or is live and looks different for it.
+ */
+bool PlaceReplica::apply(const PlaceOp &op)
+{
+    SyncedPlace &place = _places[op.place];
+    place.uuid = op.place;
+    bool wasLive = place.isLive();
+    SyncedPlace::Stamp stamp(op.time, op.device);
+
+    // each field keeps the latest value written to it, so the order ops
+    //   arrive in doesn't matter
+    bool changed = false;
+    switch (op.kind) {
+        case PlaceOp::KindCreate:
+            if (place.created < stamp) {
+                std::string name;
+                name.swap(place.record.name);   // the name has its own stamp
+                place.record = op.record;
+                place.record.name.swap(name);
+                place.created = stamp;
+                changed = true;
+            }
+            if (place.named < stamp) {
+                place.record.name = op.record.name;
+                place.named = stamp;
+                changed = true;
+            }
+            if (place.timed < stamp) {
+                place.timeout = op.timeout;
+                place.timed = stamp;
+                changed = true;
+            }
+            break;
+        case PlaceOp::KindRename:
+            if (place.named < stamp) {
+                changed = (place.record.name != op.record.name);
+                place.record.name = op.record.name;
+                place.named = stamp;
+            }
+            break;
+        case PlaceOp::KindSetTimeout:
+            if (place.timed < stamp) {
+                changed = (place.timeout != op.timeout);
+                place.timeout = op.timeout;
+                place.timed = stamp;
+            }
+            break;
+        case PlaceOp::KindDelete:
+            changed = !place.deleted;
+            place.deleted = true;
+            break;
+    }
+
+    bool isLive = place.isLive();
+    if (isLive && !wasLive) _numLivePlaces++;
+    if (!isLive && wasLive) _numLivePlaces--;
+    return changed && (wasLive || isLive);
+}
+
+void PlaceReplica::opsSince(const VersionVector &known, std::vector<PlaceOp> &ops) const
+{
+    for (VersionVector::const_iterator it = _version.begin(); it != _version.end(); ++it) {
+        VersionVector::const_iterator seen = known.find(it->first);
+        uint32_t first = (seen != known.end()) ? seen->second : 0;
+        if (first >= it->second) continue;
+
+        const std::vector<PlaceOp> &log = _logs.find(it->first)->second;
+        ops.insert(ops.end(), log.begin() + first, log.end());
+    }
+}
+
+void PlaceReplica::syncRequest(SyncMessage *request) const
+{
+    request->version = _version;
+    request->ops.clear();
+    opsSince(_serverVersion, request->ops);
+}
+
+size_t PlaceReplica::mergeSyncResponse(const SyncMessage &response, std::vector<PlaceUUID> *changed)
+{
+    size_t numMerged = merge(response.ops, changed);
+    _serverVersion = response.version;
+    return numMerged;
+}
+
+const SyncedPlace *PlaceReplica::place(const PlaceUUID &place) const
+{
+    std::unordered_map<PlaceUUID, SyncedPlace, PlaceUUIDHash>::const_iterator it = _places.find(place);
+    return (it != _places.end()) ? &it->second : 0;
+}
+
+void PlaceReplica::livePlaces(std::vector<const SyncedPlace *> &places) const
+{
+    places.clear();
+    places.reserve(_numLivePlaces);
+    for (std::unordered_map<PlaceUUID, SyncedPlace, PlaceUUIDHash>::const_iterator it = _places.begin();
+         it != _places.end(); ++it) {
+        if (it->second.isLive()) places.push_back(&it->second);
+    }
+    std::sort(places.begin(), places.end(), [](const SyncedPlace *a, const SyncedPlace *b) {
+        return a->uuid < b->uuid;
+    });
+}
+
+bool PlaceReplica::write(std::ostream &output) const
+{
+    // the log is the replica: places are rebuilt from it when read
+    SyncMessage saved;
+    saved.version = _serverVersion;
+    opsSince(VersionVector(), saved.ops);
+    std::string bytes;
+    encodeSyncMessage(saved, bytes);
+
+    std::string header(kReplicaMagic, sizeof(kReplicaMagic));
+    header.push_back((char)kReplicaVersion);
+    appendFixed64(header, _device);
+    appendVarint(header, bytes.size());
+
+    output.write(header.data(), header.size());
+    output.write(bytes.data(), bytes.size());
+    return output.good();
+}
+
+bool PlaceReplica::read(std::istream &input)
+{
+    clear();
+
+    char header[sizeof(kReplicaMagic) + 1 + 8];
+    if (!input.read(header, sizeof(header)) || memcmp(header, kReplicaMagic, sizeof(kReplicaMagic)) ||
+        ((uint8_t)header[sizeof(kReplicaMagic)] != kReplicaVersion)) {
+        return false;
+    }
+    const char *cursor = header + sizeof(kReplicaMagic) + 1;
+    uint64_t device;
+    parseFixed64(cursor, header + sizeof(header), &device);
+
+    uint64_t length;
+    size_t numBytes;
+    if (!readVarint(input, &length, &numBytes)) return false;
+
+    // a chunk at a time, so a corrupt length can't ask for gigabytes up front
+    std::string bytes;
+    char chunk[1 << 16];
+    while (bytes.size() < length) {
+        size_t wanted = (size_t)std::min<uint64_t>(sizeof(chunk), length - bytes.size());
+        if (!input.read(chunk, (std::streamsize)wanted)) return false;
+        bytes.append(chunk, wanted);
+    }
+
+    SyncMessage saved;
+    if (!decodeSyncMessage(bytes.data(), bytes.size(), &saved)) return false;
+
+    _device = device;
+    if (merge(saved.ops) != saved.ops.size()) {
+        clear();
+        return false;
+    }
+    _serverVersion = saved.version;
+    return true;
+}
+
+} // namespace rtc
@@ -0,0 +1,308 @@
+//
+//  RTCPlaceSync.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/31/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreData here so this can be
+//  compiled and exercised headlessly.
+
+#ifndef Retrac_RTCPlaceSync_h
+#define Retrac_RTCPlaceSync_h
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "RTCClock.h"
+#include "RTCPlaceArchive.h"
+
+namespace rtc {
+
+/**
+ * PlaceUUID is a place's ID on every device: the 16 bytes of the UUID it was
+ * given when it was saved, as two big-endian halves.
+ */
+struct PlaceUUID {
+    uint64_t high, low;
+
+    PlaceUUID() : high(0), low(0) {}
+    PlaceUUID(uint64_t aHigh, uint64_t aLow) : high(aHigh), low(aLow) {}
+
+    /**
+     * From and to the 16 bytes of a uuid_t
+     */
+    static PlaceUUID fromBytes(const uint8_t bytes[16]);
+    void getBytes(uint8_t bytes[16]) const;
+
+    bool operator==(const PlaceUUID &other) const { return (high == other.high) && (low == other.low); }
+    bool operator!=(const PlaceUUID &other) const { return !(*this == other); }
+    bool operator<(const PlaceUUID &other) const {
+        return (high != other.high) ? (high < other.high) : (low < other.low);
+    }
+};
+
+struct PlaceUUIDHash {
+    size_t operator()(const PlaceUUID &uuid) const { return (size_t)(uuid.high ^ (uuid.low * 0x9e3779b97f4a7c15ULL)); }
+};
+
+/**
+ * DeviceID names one device's change log. Random, so devices never have to
+ * agree on them.
+ */
+typedef uint64_t DeviceID;
+
+/**
+ * HybridTime is a hybrid logical clock reading: milliseconds since 1970 in
+ * the top 48 bits, then a 16-bit counter that orders events within a
+ * millisecond, or after a clock that went backwards.
+ */
+typedef uint64_t HybridTime;
+
+HybridTime hybridTime(double seconds, uint16_t counter = 0);
+double hybridTimeSeconds(HybridTime time);
+
+/**
+ * HybridClock hands out HybridTimes that follow the wall clock but never go
+ * backwards, and that come after every time seen from other devices. So an
+ * edit made after seeing another device's edit is always ordered after it,
+ * however far apart the two devices' clocks are.
+ */
+class HybridClock {
+public:
+    explicit HybridClock(const Clock &clock) : _clock(&clock), _last(0) {}
+
+    /**
+     * Time of a local event
+     */
+    HybridTime now();
+
+    /**
+     * Take in the time of another device's event
+     */
+    void observe(HybridTime time) { if (time > _last) _last = time; }
+
+    HybridTime last() const { return _last; }
+
+private:
+    const Clock *_clock;
+    HybridTime _last;
+};
+
+/**
+ * PlaceOp is one change to a place, as made on one device
+ */
+struct PlaceOp {
+    enum Kind {
+        KindCreate,             // record and timeout hold the new place
+        KindRename,             // record.name holds the new name
+        KindDelete,
+        KindSetTimeout          // timeout holds the new timeout
+    };
+
+    Kind kind;
+    DeviceID device;            // device that made the change
+    uint32_t seq;               // 1 for the device's first change, then 2, ...
+    HybridTime time;            // when the device made it
+    PlaceUUID place;
+
+    PlaceRecord record;
+    int32_t timeout;            // seconds, 0 for none
+
+    PlaceOp() : kind(KindCreate), device(0), seq(0), time(0), timeout(0) {}
+};
+
+/**
+ * VersionVector is how much of each device's change log has been seen: the
+ * seq of its last change.
+ */
+typedef std::map<DeviceID, uint32_t> VersionVector;
+
+/**
+ * SyncedPlace is a place as all the changes to it seen so far leave it
+ */
+struct SyncedPlace {
+    /**
+     * When a field was last set. Later times win, then larger device IDs.
+     */
+    struct Stamp {
+        HybridTime time;
+        DeviceID device;
+
+        Stamp() : time(0), device(0) {}
+        Stamp(HybridTime aTime, DeviceID aDevice) : time(aTime), device(aDevice) {}
+
+        bool isSet() const { return time != 0; }
+        bool operator<(const Stamp &other) const {
+            return (time != other.time) ? (time < other.time) : (device < other.device);
+        }
+    };
+
+    PlaceUUID uuid;
+    PlaceRecord record;
+    int32_t timeout;
+    bool deleted;
+
+    Stamp created, named, timed;
+
+    SyncedPlace() : timeout(0), deleted(false) {}
+
+    /**
+     * Created, and not deleted, on some device
+     */
+    bool isLive() const { return created.isSet() && !deleted; }
+};
+
+/**
+ * SyncMessage is what a device and a sync server exchange: the sender's
+ * version vector and changes it thinks the receiver hasn't seen.
+ */
+struct SyncMessage {
+    VersionVector version;
+    std::vector<PlaceOp> ops;
+};
+
+/**
+ * Encode a message compactly: a version byte, the version vector as varints,
+ * then each op as a flags byte, varint deltas from the op before it (device,
+ * seq, time) and its fields. A place's UUID is written once per message and
+ * referred to by index after that. Coordinates, accuracy and dates are
+ * encoded as in the binary place archive (see RTCPlaceArchive.h). Changes
+ * average about 20 bytes each in a long message and 30 in batches of a
+ * hundred, where more of them carry a full UUID.
+ */
+void encodeSyncMessage(const SyncMessage &message, std::string &bytes);
+
+/**
+ * @return false if data isn't a whole, well-formed message.
+ */
+bool decodeSyncMessage(const char *data, size_t size, SyncMessage *message);
+
+/**
+ * PlaceReplica is one device's copy of the saved places, kept as an
+ * append-only log of changes (create, rename, delete, timeout change) from
+ * every device, keyed by place UUID.
+ *
+ * Devices exchange only the changes the other hasn't seen, worked out from
+ * version vectors, and every device that has seen the same changes has the
+ * same places, in whatever order they arrived: each field is a
+ * last-writer-wins register ordered by HybridTime, and a delete is final.
+ * Re-saving a spot makes a new place, so nothing needs to come back.
+ *
+ * Changes from each device must be merged in the order it made them.
+ */
+class PlaceReplica {
+public:
+    PlaceReplica(DeviceID device, const Clock &clock);
+
+    DeviceID device() const { return _device; }
+
+    /**
+     * Make a change on this device.
+     *
+     * @return the change, as it was added to this device's log.
+     */
+    PlaceOp create(const PlaceUUID &place, const PlaceRecord &record, int32_t timeout);
+    PlaceOp rename(const PlaceUUID &place, const std::string &name);
+    PlaceOp remove(const PlaceUUID &place);
+    PlaceOp setTimeout(const PlaceUUID &place, int32_t timeout);
+
+    /**
+     * Merge a change from another device.
+     *
+     * @param changed   set to whether any place looks different for it
+     *
+     * @return false if it was already seen or one before it is missing.
+     */
+    bool merge(const PlaceOp &op, bool *changed = 0);
+
+    /**
+     * Merge changes, skipping any already seen.
+     *
+     * @param changed   if not null, the places that look different afterwards
+     *                  are added, sorted with no repeats
+     *
+     * @return the number merged.
+     */
+    size_t merge(const std::vector<PlaceOp> &ops, std::vector<PlaceUUID> *changed = 0);
+
+    const VersionVector &version() const { return _version; }
+
+    /**
+     * Changes a device that has seen known hasn't, each device's in order
+     */
+    void opsSince(const VersionVector &known, std::vector<PlaceOp> &ops) const;
+
+    /**
+     * Request for a sync server: this replica's version and the changes the
+     * server didn't have after the last sync.
+     */
+    void syncRequest(SyncMessage *request) const;
+
+    /**
+     * Merge a sync server's response and remember what it has.
+     *
+     * @return the number of changes merged.
+     */
+    size_t mergeSyncResponse(const SyncMessage &response, std::vector<PlaceUUID> *changed = 0);
+
+    /**
+     * The server's version as of the last sync
+     */
+    const VersionVector &serverVersion() const { return _serverVersion; }
+
+    /**
+     * A place, live or deleted.
+     *
+     * @return null if no change to it has been seen.
+     */
+    const SyncedPlace *place(const PlaceUUID &place) const;
+
+    /**
+     * Places created and not deleted, sorted by UUID
+     */
+    void livePlaces(std::vector<const SyncedPlace *> &places) const;
+    size_t numLivePlaces() const { return _numLivePlaces; }
+
+    size_t numOps() const { return _numOps; }
+
+    /**
+     * Save the whole log, this device's ID and the server's version.
+     *
+     * @return false if the write failed.
+     */
+    bool write(std::ostream &output) const;
+
+    /**
+     * Replace this replica with one saved by write(), device ID and all.
+     *
+     * @return false if the stream is short or not a saved replica, leaving
+     *      the replica empty.
+     */
+    bool read(std::istream &input);
+
+private:
+    PlaceOp localOp(PlaceOp::Kind kind, const PlaceUUID &place);
+    bool apply(const PlaceOp &op);
+    void clear();
+
+    DeviceID _device;
+    HybridClock _clock;
+
+    std::unordered_map<DeviceID, std::vector<PlaceOp> > _logs;    // log i holds seqs 1 ... n
+    VersionVector _version;
+    VersionVector _serverVersion;
+    size_t _numOps;
+
+    std::unordered_map<PlaceUUID, SyncedPlace, PlaceUUIDHash> _places;
+    size_t _numLivePlaces;
+};
+
+} // namespace rtc
+
+#endif
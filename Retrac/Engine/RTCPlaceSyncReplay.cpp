@@ -0,0 +1,216 @@
+//
+//  RTCPlaceSyncReplay.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/31/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCPlaceSyncReplay.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include "RTCClock.h"
+#include "RTCVarint.h"
+
+namespace rtc {
+
+#pragma mark - Constants
+// file in the server's directory listing the devices, 8 bytes each
+static const char *const kDevicesFileName = "devices";
+
+// biggest batch read back, to stop at a corrupt length
+static const uint64_t kMaxBatchLength = 1 << 26;
+
+
+#pragma mark - Helpers
+/**
+ * Read the batch at input's position.
+ *
+ * @param size  set to the bytes it takes in the file
+ */
+static bool readBatch(std::istream &input, SyncMessage *batch, uint64_t *size)
+{
+    uint64_t length;
+    size_t lengthBytes;
+    if (!readVarint(input, &length, &lengthBytes) || (length == 0) || (length > kMaxBatchLength)) return false;
+
+    std::string bytes((size_t)length, '\0');
+    if (!input.read(&bytes[0], (std::streamsize)length)) return false;
+    if (!decodeSyncMessage(bytes.data(), bytes.size(), batch) || batch->ops.empty()) return false;
+
+    *size = lengthBytes + length;
+    return true;
+}
+
+
+#pragma mark - FileSyncServer
+FileSyncServer::FileSyncServer(const std::string &directory)
+    : _directory(directory), _byteSize(0)
+{
+    load();
+}
+
+std::string FileSyncServer::devicePath(DeviceID device) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".ops", device);
+    return _directory + "/" + name;
+}
+
+/**
+ * Index the batches already in the directory. A file is only trusted up to
+ * its first batch that's corrupt or out of order.
+ */
+void FileSyncServer::load()
+{
+    std::ifstream devices((_directory + "/" + kDevicesFileName).c_str(), std::ios::binary);
+    char bytes[8];
+    while (devices.read(bytes, sizeof(bytes))) {
+        DeviceID device = 0;
+        for (int i = 0; i < 8; ++i) device |= (uint64_t)(uint8_t)bytes[i] << (8 * i);
+        if (_fileSizes.count(device)) continue;
+
+        std::vector<Batch> &batches = _batches[device];
+        uint64_t &fileSize = _fileSizes[device];
+        fileSize = 0;
+        _byteSize += 8;
+
+        std::ifstream input(devicePath(device).c_str(), std::ios::binary);
+        uint32_t lastSeq = 0;
+        SyncMessage batch;
+        uint64_t size;
+        while (readBatch(input, &batch, &size) && (batch.ops.front().seq == lastSeq + 1) &&
+               (batch.ops.back().seq == lastSeq + batch.ops.size())) {
+            Batch entry = {lastSeq + 1, fileSize};
+            batches.push_back(entry);
+            lastSeq = batch.ops.back().seq;
+            fileSize += size;
+        }
+        if (lastSeq) _version[device] = lastSeq;
+        _byteSize += fileSize;
+    }
+}
+
+bool FileSyncServer::append(DeviceID device, const std::vector<PlaceOp> &ops)
+{
+    SyncMessage batch;
+    batch.ops = ops;
+    std::string bytes;
+    encodeSyncMessage(batch, bytes);
+    std::string record;
+    appendVarint(record, bytes.size());
+    record.append(bytes);
+
+    bool isNew = !_fileSizes.count(device);
+    if (isNew) {
+        std::ofstream devices((_directory + "/" + kDevicesFileName).c_str(), std::ios::binary | std::ios::app);
+        char deviceBytes[8];
+        for (int i = 0; i < 8; ++i) deviceBytes[i] = (char)(device >> (8 * i));
+        if (!devices.write(deviceBytes, sizeof(deviceBytes))) return false;
+        _byteSize += 8;
+    }
+    uint64_t &fileSize = _fileSizes[device];
+
+    // write over anything past the last good batch
+    std::string path = devicePath(device);
+    std::fstream output(path.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+    if (!output.is_open()) output.open(path.c_str(), std::ios::binary | std::ios::out | std::ios::trunc);
+    output.seekp((std::streamoff)fileSize);
+    if (!output.write(record.data(), record.size()) || !output.flush()) return false;
+
+    Batch entry = {ops.front().seq, fileSize};
+    _batches[device].push_back(entry);
+    fileSize += record.size();
+    _byteSize += record.size();
+    _version[device] = ops.back().seq;
+    return true;
+}
+
+/**
+ * Changes device made after its change after
+ */
+void FileSyncServer::readOps(DeviceID device, uint32_t after, std::vector<PlaceOp> &ops) const
+{
+    std::map<DeviceID, std::vector<Batch> >::const_iterator found = _batches.find(device);
+    if (found == _batches.end()) return;
+    const std::vector<Batch> &batches = found->second;
+
+    // the last batch starting at or before the first change wanted
+    std::vector<Batch>::const_iterator first = std::upper_bound(batches.begin(), batches.end(), after + 1,
+                                                                [](uint32_t seq, const Batch &batch) {
+        return seq < batch.firstSeq;
+    });
+    if (first != batches.begin()) --first;
+
+    std::ifstream input(devicePath(device).c_str(), std::ios::binary);
+    input.seekg((std::streamoff)first->offset);
+    for (std::vector<Batch>::const_iterator it = first; it != batches.end(); ++it) {
+        SyncMessage batch;
+        uint64_t size;
+        if (!readBatch(input, &batch, &size)) return;
+        for (size_t i = 0; i < batch.ops.size(); ++i) {
+            if (batch.ops[i].seq > after) ops.push_back(batch.ops[i]);
+        }
+    }
+}
+
+bool FileSyncServer::exchange(const std::string &request, std::string &response)
+{
+    SyncMessage incoming;
+    if (!decodeSyncMessage(request.data(), request.size(), &incoming)) return false;
+
+    // store each device's changes that come right after what's here
+    std::map<DeviceID, std::vector<PlaceOp> > pushed;
+    for (size_t i = 0; i < incoming.ops.size(); ++i) {
+        const PlaceOp &op = incoming.ops[i];
+        std::vector<PlaceOp> &run = pushed[op.device];
+        VersionVector::const_iterator stored = _version.find(op.device);
+        uint32_t next = (run.empty() ? ((stored != _version.end()) ? stored->second : 0) : run.back().seq) + 1;
+        if (op.seq == next) run.push_back(op);
+    }
+    for (std::map<DeviceID, std::vector<PlaceOp> >::const_iterator it = pushed.begin(); it != pushed.end(); ++it) {
+        if (!it->second.empty() && !append(it->first, it->second)) return false;
+    }
+
+    SyncMessage outgoing;
+    outgoing.version = _version;
+    for (VersionVector::const_iterator it = _version.begin(); it != _version.end(); ++it) {
+        VersionVector::const_iterator seen = incoming.version.find(it->first);
+        uint32_t after = (seen != incoming.version.end()) ? seen->second : 0;
+        if (after < it->second) readOps(it->first, after, outgoing.ops);
+    }
+    encodeSyncMessage(outgoing, response);
+    return true;
+}
+
+
+#pragma mark - Replay
+bool syncReplica(PlaceReplica &replica, FileSyncServer &server, PlaceSyncStats *stats,
+                 std::vector<PlaceUUID> *changed)
+{
+    SyncMessage request;
+    replica.syncRequest(&request);
+    std::string requestBytes, responseBytes;
+    encodeSyncMessage(request, requestBytes);
+    if (!server.exchange(requestBytes, responseBytes)) return false;
+
+    double start = SteadyClock::sharedClock().now();
+    SyncMessage response;
+    if (!decodeSyncMessage(responseBytes.data(), responseBytes.size(), &response)) return false;
+    if (changed) changed->clear();
+    size_t numMerged = replica.mergeSyncResponse(response, changed);
+
+    if (stats) {
+        stats->numSyncs++;
+        stats->bytesSent += requestBytes.size();
+        stats->bytesReceived += responseBytes.size();
+        stats->opsSent += request.ops.size();
+        stats->opsReceived += numMerged;
+        stats->mergeTime += SteadyClock::sharedClock().now() - start;
+    }
+    return true;
+}
+
+} // namespace rtc
@@ -0,0 +1,101 @@
+//
+//  RTCPlaceSyncReplay.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/31/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreData here so this can be
+//  compiled and exercised headlessly.
+
+#ifndef Retrac_RTCPlaceSyncReplay_h
+#define Retrac_RTCPlaceSyncReplay_h
+
+#include <map>
+#include <string>
+#include <vector>
+#include "RTCPlaceSync.h"
+
+namespace rtc {
+
+/**
+ * FileSyncServer is a local stand-in for a place sync server, keeping what
+ * devices push on disk as a server would: an append-only file of batches of
+ * changes per device, each batch an encoded SyncMessage after its varint
+ * length, plus a file listing the devices.
+ *
+ * It only ever relays changes; merging is left to the devices. A device's
+ * changes are stored once however many times they're pushed, and a batch
+ * that skips some of a device's changes is only stored up to the gap.
+ */
+class FileSyncServer {
+public:
+    /**
+     * Keep the changes in directory, which must exist, carrying on from
+     * whatever is already there.
+     */
+    explicit FileSyncServer(const std::string &directory);
+
+    /**
+     * Handle a device's sync request (see PlaceReplica::syncRequest()): store
+     * the changes it pushes, then answer with this server's version and the
+     * changes the device hasn't seen.
+     *
+     * @return false if request doesn't decode or a file can't be written.
+     */
+    bool exchange(const std::string &request, std::string &response);
+
+    const VersionVector &version() const { return _version; }
+
+    /**
+     * Size of the files
+     */
+    uint64_t byteSize() const { return _byteSize; }
+
+private:
+    struct Batch {
+        uint32_t firstSeq;
+        uint64_t offset;        // of its length in the device's file
+    };
+
+    std::string devicePath(DeviceID device) const;
+    void load();
+    bool append(DeviceID device, const std::vector<PlaceOp> &ops);
+    void readOps(DeviceID device, uint32_t after, std::vector<PlaceOp> &ops) const;
+
+    std::string _directory;
+    std::map<DeviceID, std::vector<Batch> > _batches;
+    std::map<DeviceID, uint64_t> _fileSizes;
+    VersionVector _version;
+    uint64_t _byteSize;
+};
+
+/**
+ * Counts from syncing a replica
+ */
+struct PlaceSyncStats {
+    size_t numSyncs;
+    uint64_t bytesSent;         // requests
+    uint64_t bytesReceived;     // responses
+    size_t opsSent;
+    size_t opsReceived;         // merged, not counting any already seen
+    double mergeTime;           // seconds decoding and merging responses
+
+    PlaceSyncStats()
+        : numSyncs(0), bytesSent(0), bytesReceived(0), opsSent(0), opsReceived(0), mergeTime(0) {}
+};
+
+/**
+ * Sync replica with server in one exchange, adding to stats.
+ *
+ * @param changed   if not null, set to the places that look different
+ *                  afterwards
+ *
+ * @return false if the exchange failed.
+ */
+bool syncReplica(PlaceReplica &replica, FileSyncServer &server, PlaceSyncStats *stats = 0,
+                 std::vector<PlaceUUID> *changed = 0);
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,350 @@
+//
+//  RTCPolyline.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 9/2/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCPolyline.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "RTCVarint.h"
+
+// Vector compare for finding varint boundaries. The varints themselves are
+// assembled with 8 byte loads, so the vector path also needs little-endian.
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define RTC_POLYLINE_VECTOR 1
+#define RTC_POLYLINE_ISA "SSE2"
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) && \
+      defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RTC_POLYLINE_VECTOR 1
+#define RTC_POLYLINE_ISA "NEON"
+#else
+#define RTC_POLYLINE_VECTOR 0
+#define RTC_POLYLINE_ISA "scalar"
+#endif
+
+namespace rtc {
+
+#pragma mark - Constants
+static const uint8_t kPolylineVersion = 1;
+
+static const double kPowersOfTen[kPolylineMaxPrecision + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+};
+
+// Google's format: 5 bits a character, the 6th set on all but a value's
+// last, offset into printable ASCII
+static const uint64_t kGoogleChunkBits = 5;
+static const uint64_t kGoogleMoreChunks = 0x20;
+static const char kGoogleCharacterOffset = 63;
+
+
+#pragma mark - Helpers
+static int clampPrecision(int precision)
+{
+    return std::max(0, std::min(kPolylineMaxPrecision, precision));
+}
+
+static int64_t fixedPoint(double degrees, double scale)
+{
+    return (int64_t)std::llround(degrees * scale);
+}
+
+// deltas wrap rather than overflow on a corrupt polyline
+static inline int64_t addDelta(int64_t value, int64_t delta)
+{
+    return (int64_t)((uint64_t)value + (uint64_t)delta);
+}
+
+/**
+ * Version, precision and point count. A point takes at least 2 bytes, so a
+ * count the rest of the buffer can't hold is corrupt.
+ */
+static bool parseHeader(const char *&cursor, const char *end, int *precision, size_t *numPoints)
+{
+    if ((end - cursor < 2) || ((uint8_t)cursor[0] != kPolylineVersion) ||
+        ((uint8_t)cursor[1] > kPolylineMaxPrecision)) {
+        return false;
+    }
+    *precision = (uint8_t)cursor[1];
+    cursor += 2;
+
+    uint64_t count;
+    if (!parseVarint(cursor, end, &count) || (count > (uint64_t)(end - cursor) / 2)) return false;
+    *numPoints = (size_t)count;
+    return true;
+}
+
+
+#pragma mark - Encoding
+std::string encodePolyline(const GeoPoint *points, size_t count, int precision)
+{
+    precision = clampPrecision(precision);
+    double scale = kPowersOfTen[precision];
+
+    std::string buffer;
+    buffer.reserve(12 + count * 4);
+    buffer.push_back((char)kPolylineVersion);
+    buffer.push_back((char)precision);
+    appendVarint(buffer, count);
+
+    int64_t latitude = 0, longitude = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int64_t nextLatitude = fixedPoint(points[i].latitude, scale);
+        int64_t nextLongitude = fixedPoint(points[i].longitude, scale);
+        appendSignedVarint(buffer, nextLatitude - latitude);
+        appendSignedVarint(buffer, nextLongitude - longitude);
+        latitude = nextLatitude;
+        longitude = nextLongitude;
+    }
+    return buffer;
+}
+
+std::string encodePolyline(const std::vector<GeoPoint> &points, int precision)
+{
+    return encodePolyline(points.data(), points.size(), precision);
+}
+
+
+#pragma mark - PolylineReader
+PolylineReader::PolylineReader(const char *data, size_t size)
+    : _cursor(data), _end(data + size), _precision(0), _scale(1.0), _numPoints(0), _numRead(0),
+      _latitude(0), _longitude(0), _failed(false)
+{
+    int precision;
+    size_t numPoints;
+    if (!parseHeader(_cursor, _end, &precision, &numPoints)) {
+        _failed = true;
+        return;
+    }
+    _precision = precision;
+    _scale = kPowersOfTen[precision];
+    _numPoints = numPoints;
+}
+
+bool PolylineReader::next(GeoPoint *point)
+{
+    if (_failed) return false;
+    if (_numRead == _numPoints) {
+        // bytes past the last point mean the count is wrong
+        if (_cursor != _end) _failed = true;
+        return false;
+    }
+
+    int64_t deltaLatitude, deltaLongitude;
+    if (!parseSignedVarint(_cursor, _end, &deltaLatitude) || !parseSignedVarint(_cursor, _end, &deltaLongitude)) {
+        _failed = true;
+        return false;
+    }
+    _latitude = addDelta(_latitude, deltaLatitude);
+    _longitude = addDelta(_longitude, deltaLongitude);
+    _numRead++;
+
+    *point = GeoPoint(_latitude / _scale, _longitude / _scale);
+    return true;
+}
+
+
+#if RTC_POLYLINE_VECTOR
+#pragma mark - Vector Decoding
+// bytes examined per vector compare, and how far past them an 8 byte load
+//   of a varint starting in them can reach
+static const ptrdiff_t kBlockSize = 16;
+static const ptrdiff_t kBlockReach = kBlockSize + 8;
+
+/**
+ * Bit n set if byte n of the 16 at bytes is a varint's last (high bit clear)
+ */
+static inline uint32_t varintEnds(const char *bytes)
+{
+#if defined(__SSE2__)
+    uint32_t continues = (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)bytes));
+#else
+    static const uint8_t kBitWeights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t highBits = vandq_u8(vtstq_u8(vld1q_u8((const uint8_t *)bytes), vdupq_n_u8(0x80)), vld1q_u8(kBitWeights));
+    uint32_t continues = (uint32_t)vaddv_u8(vget_low_u8(highBits)) |
+                         ((uint32_t)vaddv_u8(vget_high_u8(highBits)) << 8);
+#endif
+    return ~continues & 0xffff;
+}
+
+/**
+ * Varint of length bytes (at most 8) at bytes, from a single load: mask off
+ * the bytes past it, then squeeze out the high bits in three steps
+ */
+static inline uint64_t assembleVarint(const char *bytes, unsigned length)
+{
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    word &= UINT64_C(0x7f7f7f7f7f7f7f7f) >> (64 - 8 * length);
+    word = (word & UINT64_C(0x007f007f007f007f)) | ((word & UINT64_C(0x7f007f007f007f00)) >> 1);
+    word = (word & UINT64_C(0x00003fff00003fff)) | ((word & UINT64_C(0x3fff00003fff0000)) >> 2);
+    word = (word & UINT64_C(0x000000000fffffff)) | ((word & UINT64_C(0x0fffffff00000000)) >> 4);
+    return word;
+}
+
+/**
+ * Decode as many points as end in each block of 16 bytes, while at least
+ * kBlockReach bytes are left. A point with a varint over 8 bytes is left to
+ * the scalar loop.
+ *
+ * @param numDecoded    points decoded so far, advanced past the ones done
+ *
+ * @return false if a point is bad.
+ */
+static bool vectorDecode(const char *&cursor, const char *end, double scale, int64_t &latitude, int64_t &longitude,
+                         GeoPoint *points, size_t numPoints, size_t &numDecoded)
+{
+    size_t i = numDecoded;
+    while ((i < numPoints) && (end - cursor >= kBlockReach)) {
+        uint32_t ends = varintEnds(cursor);
+        unsigned offset = 0;
+        while ((i < numPoints) && (ends & (ends - 1))) {
+            unsigned latitudeEnd = __builtin_ctz(ends);
+            ends &= ends - 1;
+            unsigned longitudeEnd = __builtin_ctz(ends);
+            ends &= ends - 1;
+
+            unsigned latitudeLength = latitudeEnd + 1 - offset, longitudeLength = longitudeEnd - latitudeEnd;
+            if ((latitudeLength > 8) || (longitudeLength > 8)) break;
+
+            latitude = addDelta(latitude, unzigzag(assembleVarint(cursor + offset, latitudeLength)));
+            longitude = addDelta(longitude, unzigzag(assembleVarint(cursor + latitudeEnd + 1, longitudeLength)));
+            points[i++] = GeoPoint(latitude / scale, longitude / scale);
+            offset = longitudeEnd + 1;
+        }
+
+        if (offset) {
+            cursor += offset;
+        } else if (i < numPoints) {
+            // a point too long for the block
+            int64_t deltaLatitude, deltaLongitude;
+            if (!parseSignedVarint(cursor, end, &deltaLatitude) || !parseSignedVarint(cursor, end, &deltaLongitude)) {
+                return false;
+            }
+            latitude = addDelta(latitude, deltaLatitude);
+            longitude = addDelta(longitude, deltaLongitude);
+            points[i++] = GeoPoint(latitude / scale, longitude / scale);
+        }
+    }
+    numDecoded = i;
+    return true;
+}
+#endif
+
+
+#pragma mark - Bulk Decoding
+bool decodePolyline(const char *data, size_t size, std::vector<GeoPoint> &points, int *precision)
+{
+    points.clear();
+    const char *cursor = data, *end = data + size;
+    int headerPrecision;
+    size_t numPoints;
+    if (!parseHeader(cursor, end, &headerPrecision, &numPoints)) return false;
+
+    double scale = kPowersOfTen[headerPrecision];
+    points.resize(numPoints);
+    int64_t latitude = 0, longitude = 0;
+    size_t i = 0;
+    bool parsed = true;
+#if RTC_POLYLINE_VECTOR
+    parsed = vectorDecode(cursor, end, scale, latitude, longitude, points.data(), numPoints, i);
+#endif
+    for (; parsed && (i < numPoints); ++i) {
+        int64_t deltaLatitude, deltaLongitude;
+        parsed = parseSignedVarint(cursor, end, &deltaLatitude) && parseSignedVarint(cursor, end, &deltaLongitude);
+        if (!parsed) break;
+        latitude = addDelta(latitude, deltaLatitude);
+        longitude = addDelta(longitude, deltaLongitude);
+        points[i] = GeoPoint(latitude / scale, longitude / scale);
+    }
+
+    if (!parsed || (cursor != end)) {
+        points.clear();
+        return false;
+    }
+    if (precision) *precision = headerPrecision;
+    return true;
+}
+
+const char *polylineDecoderInstructionSet()
+{
+    return RTC_POLYLINE_ISA;
+}
+
+
+#pragma mark - Google Format
+static void appendGoogleValue(std::string &text, int64_t value)
+{
+    uint64_t bits = zigzag(value);
+    while (bits >= kGoogleMoreChunks) {
+        text.push_back((char)((kGoogleMoreChunks | (bits & (kGoogleMoreChunks - 1))) + kGoogleCharacterOffset));
+        bits >>= kGoogleChunkBits;
+    }
+    text.push_back((char)(bits + kGoogleCharacterOffset));
+}
+
+static bool parseGoogleValue(const char *&cursor, const char *end, int64_t *value)
+{
+    uint64_t bits = 0;
+    for (uint64_t shift = 0; (cursor < end) && (shift < 64); shift += kGoogleChunkBits) {
+        int chunk = *cursor++ - kGoogleCharacterOffset;
+        if ((chunk < 0) || (chunk >= 2 * (int)kGoogleMoreChunks)) return false;
+        bits |= (uint64_t)(chunk & (kGoogleMoreChunks - 1)) << shift;
+        if (!(chunk & kGoogleMoreChunks)) {
+            *value = unzigzag(bits);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string encodeGooglePolyline(const GeoPoint *points, size_t count, int precision)
+{
+    double scale = kPowersOfTen[clampPrecision(precision)];
+
+    std::string text;
+    text.reserve(count * 6);
+    int64_t latitude = 0, longitude = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int64_t nextLatitude = fixedPoint(points[i].latitude, scale);
+        int64_t nextLongitude = fixedPoint(points[i].longitude, scale);
+        appendGoogleValue(text, nextLatitude - latitude);
+        appendGoogleValue(text, nextLongitude - longitude);
+        latitude = nextLatitude;
+        longitude = nextLongitude;
+    }
+    return text;
+}
+
+std::string encodeGooglePolyline(const std::vector<GeoPoint> &points, int precision)
+{
+    return encodeGooglePolyline(points.data(), points.size(), precision);
+}
+
+bool decodeGooglePolyline(const char *text, size_t length, std::vector<GeoPoint> &points, int precision)
+{
+    points.clear();
+    double scale = kPowersOfTen[clampPrecision(precision)];
+
+    const char *cursor = text, *end = text + length;
+    int64_t latitude = 0, longitude = 0;
+    while (cursor < end) {
+        int64_t deltaLatitude, deltaLongitude;
+        if (!parseGoogleValue(cursor, end, &deltaLatitude) || !parseGoogleValue(cursor, end, &deltaLongitude)) {
+            points.clear();
+            return false;
+        }
+        latitude = addDelta(latitude, deltaLatitude);
+        longitude = addDelta(longitude, deltaLongitude);
+        points.push_back(GeoPoint(latitude / scale, longitude / scale));
+    }
+    return true;
+}
+
+} // namespace rtc
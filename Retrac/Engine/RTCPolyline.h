@@ -0,0 +1,132 @@
+//
+//  RTCPolyline.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 9/2/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/MapKit here so this can be
+//  compiled and exercised headlessly.
+
+#ifndef Retrac_RTCPolyline_h
+#define Retrac_RTCPolyline_h
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "RTCGeo.h"
+
+namespace rtc {
+
+/**
+ * Precision of encoded polylines: coordinates are rounded to 10^-precision
+ * degrees. 5 (about 1m) is what Google's format uses, 6 (about 10cm) is plenty
+ * for walking routes and 7 (about 1cm) matches the other files in the engine.
+ */
+static const int kPolylineDefaultPrecision = 6;
+static const int kGooglePolylinePrecision = 5;
+static const int kPolylineMaxPrecision = 9;
+
+/**
+ * Encode a polyline compactly.
+ *
+ * The format is a version byte, the precision byte, the number of points as a
+ * varint, then each point's latitude and longitude as zigzag varint deltas
+ * from the point before, in units of 10^-precision degrees. Coordinates are
+ * rounded before the deltas are taken, so rounding never accumulates along
+ * the line. A walking route's points are 5 to 30m apart, which at the default
+ * precision is about 3 bytes a point against MKPolyline's 16.
+ *
+ * @param precision     clamped to [0, kPolylineMaxPrecision]
+ */
+std::string encodePolyline(const GeoPoint *points, size_t count, int precision = kPolylineDefaultPrecision);
+std::string encodePolyline(const std::vector<GeoPoint> &points, int precision = kPolylineDefaultPrecision);
+
+/**
+ * PolylineReader iterates the points of an encoded polyline straight out of
+ * the buffer, without decoding it into a vector first. The buffer must
+ * outlive the reader.
+ *
+ *      PolylineReader reader(data, size);
+ *      GeoPoint point;
+ *      while (reader.next(&point)) ...
+ *      if (reader.failed()) ...
+ */
+class PolylineReader {
+public:
+    PolylineReader(const char *data, size_t size);
+
+    /**
+     * Precision and number of points from the header, 0 if it's bad
+     */
+    int precision() const { return _precision; }
+    size_t size() const { return _numPoints; }
+
+    /**
+     * Decode the next point.
+     *
+     * @return false at the end, or if the polyline is bad.
+     */
+    bool next(GeoPoint *point);
+
+    /**
+     * Is the header or a point bad, or the buffer short?
+     */
+    bool failed() const { return _failed; }
+
+private:
+    const char *_cursor;
+    const char *_end;
+    int _precision;
+    double _scale;
+    size_t _numPoints;
+    size_t _numRead;
+    int64_t _latitude, _longitude;
+    bool _failed;
+};
+
+/**
+ * Decode a whole encoded polyline, replacing the contents of points.
+ *
+ * This is the bulk form of PolylineReader: varint boundaries are found 16
+ * bytes at a time with a vector compare (SSE2 on the simulator, NEON on
+ * arm64) and each varint is assembled from a single 8 byte load, with
+ * PolylineReader's loop for the rest and for other CPUs. That takes the
+ * branch on each varint's length out of the loop, so long lines whose
+ * lengths vary, as they do at the default precision, decode up to 1.5x
+ * faster; short or uniform ones about the same.
+ *
+ * @param precision     optional, set to the precision it was encoded at
+ *
+ * @return false if the polyline is bad or the buffer short.
+ */
+bool decodePolyline(const char *data, size_t size, std::vector<GeoPoint> &points, int *precision = 0);
+
+/**
+ * Instruction set decodePolyline() finds varint boundaries with: "SSE2",
+ * "NEON" or "scalar".
+ */
+const char *polylineDecoderInstructionSet();
+
+/**
+ * Encode a polyline in Google's encoded polyline format, as used by the Maps
+ * APIs and most routing servers: the same deltas as encodePolyline(), written
+ * as printable ASCII 5 bits a character with no header.
+ *
+ * https://developers.google.com/maps/documentation/utilities/polylinealgorithm
+ */
+std::string encodeGooglePolyline(const GeoPoint *points, size_t count, int precision = kGooglePolylinePrecision);
+std::string encodeGooglePolyline(const std::vector<GeoPoint> &points, int precision = kGooglePolylinePrecision);
+
+/**
+ * Decode a polyline in Google's format, replacing the contents of points.
+ *
+ * @return false if text isn't an encoded polyline.
+ */
+bool decodeGooglePolyline(const char *text, size_t length, std::vector<GeoPoint> &points,
+                          int precision = kGooglePolylinePrecision);
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,172 @@
+//
+//  RTCPositionFilter.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/28/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCPositionFilter.h"
+#include <algorithm>
+
+namespace rtc {
+
+#pragma mark - Constants
+// meters per degree of latitude
+static const double kMetersPerDegree = kEarthRadius * kDegreesToRadians;
+
+// uncertainty (m/s, standard deviation) of the velocity at the first fix,
+// about walking pace either way
+static const double kInitialSpeedDeviation = 2.0;
+
+// the plane is only flat near its origin, so move it along once the user
+// is this far (meters) from it
+static const double kMaxOriginDistance = 10000.0;
+
+
+#pragma mark - Helpers
+// longitude difference in [-180, 180)
+static double longitudeDelta(double to, double from)
+{
+    double delta = std::fmod(to - from + 180.0, 360.0);
+    return ((delta < 0) ? delta + 360.0 : delta) - 180.0;
+}
+
+
+#pragma mark - PositionEstimate
+double PositionEstimate::course() const
+{
+    double degrees = std::atan2(velocityEast, velocityNorth) * kRadiansToDegrees;
+    return (degrees < 0) ? degrees + 360.0 : degrees;
+}
+
+
+#pragma mark - PositionFilter
+PositionFilter::PositionFilter(const PositionFilterPolicy &policy)
+    : _policy(policy)
+{
+    reset();
+}
+
+void PositionFilter::reset()
+{
+    _hasEstimate = false;
+    _estimate = PositionEstimate();
+    _consecutiveOutliers = 0;
+    _origin = GeoPoint();
+    _metersPerDegreeLongitude = kMetersPerDegree;
+    _x = _y = _vx = _vy = 0;
+    _p00 = _p01 = _p11 = 0;
+    _numFixesReceived = 0;
+    _numFixesUsed = 0;
+    _numOutliers = 0;
+}
+
+bool PositionFilter::addFix(const LocationFix &fix)
+{
+    ++_numFixesReceived;
+    if ((fix.horizontalAccuracy < 0) || (fix.horizontalAccuracy > _policy.maxAccuracy)) return false;
+
+    if (!_hasEstimate || (fix.timestamp - _estimate.timestamp > _policy.maxGap)) {
+        start(fix);
+        return true;
+    }
+    double dt = fix.timestamp - _estimate.timestamp;
+    if (dt < 0) return false;
+
+    // predict: position moves on at the current velocity, and uncertainty
+    //   grows with the acceleration the model can't see
+    double q = _policy.accelerationNoise * _policy.accelerationNoise;
+    double p00 = _p00 + dt * (2.0 * _p01 + dt * _p11) + q * dt * dt * dt / 3.0;
+    double p01 = _p01 + dt * _p11 + q * dt * dt / 2.0;
+    double p11 = _p11 + q * dt;
+    double x = _x + _vx * dt;
+    double y = _y + _vy * dt;
+
+    // how far the fix is from the prediction, against how far it could be
+    double r = fix.horizontalAccuracy * fix.horizontalAccuracy;
+    double s = p00 + r;
+    double innovationX = longitudeDelta(fix.longitude, _origin.longitude) * _metersPerDegreeLongitude - x;
+    double innovationY = (fix.latitude - _origin.latitude) * kMetersPerDegree - y;
+    double gate = _policy.outlierGate;
+    if ((innovationX * innovationX + innovationY * innovationY) > gate * gate * s) {
+        ++_numOutliers;
+        if (++_consecutiveOutliers >= _policy.maxOutliers) {
+            start(fix);
+            return true;
+        }
+        return false;
+    }
+    _consecutiveOutliers = 0;
+
+    // update: move toward the fix by the gain, both axes alike
+    double k0 = p00 / s;
+    double k1 = p01 / s;
+    _x = x + k0 * innovationX;
+    _y = y + k0 * innovationY;
+    _vx += k1 * innovationX;
+    _vy += k1 * innovationY;
+    _p00 = (1.0 - k0) * p00;
+    _p01 = (1.0 - k0) * p01;
+    _p11 = p11 - k1 * p01;
+
+    _estimate.timestamp = fix.timestamp;
+    ++_numFixesUsed;
+    if ((std::fabs(_x) > kMaxOriginDistance) || (std::fabs(_y) > kMaxOriginDistance)) moveOrigin();
+    updateEstimate();
+    return true;
+}
+
+bool PositionFilter::movedSignificantly(const GeoPoint &from, double fromAccuracy) const
+{
+    if (!_hasEstimate) return true;
+
+    double distance = distanceBetween(from, _estimate.coordinate);
+    double deviation = std::sqrt(_estimate.horizontalAccuracy * _estimate.horizontalAccuracy +
+                                 std::max(0.0, fromAccuracy) * std::max(0.0, fromAccuracy));
+    return (distance > _policy.rerouteDistance) && (distance > _policy.rerouteConfidence * deviation);
+}
+
+/**
+ * Start over at fix: position as accurate as the fix, velocity unknown
+ */
+void PositionFilter::start(const LocationFix &fix)
+{
+    _hasEstimate = true;
+    _consecutiveOutliers = 0;
+    _origin = GeoPoint(fix.latitude, fix.longitude);
+    _metersPerDegreeLongitude = kMetersPerDegree * std::cos(fix.latitude * kDegreesToRadians);
+    _x = _y = _vx = _vy = 0;
+    _p00 = fix.horizontalAccuracy * fix.horizontalAccuracy;
+    _p01 = 0;
+    _p11 = kInitialSpeedDeviation * kInitialSpeedDeviation;
+
+    _estimate.timestamp = fix.timestamp;
+    ++_numFixesUsed;
+    updateEstimate();
+}
+
+/**
+ * Re-center the plane on the current position
+ */
+void PositionFilter::moveOrigin()
+{
+    double latitude = _origin.latitude + _y / kMetersPerDegree;
+    double longitude = _origin.longitude + _x / _metersPerDegreeLongitude;
+    longitude = longitudeDelta(longitude, 0.0);
+
+    _origin = GeoPoint(latitude, longitude);
+    _metersPerDegreeLongitude = kMetersPerDegree * std::cos(latitude * kDegreesToRadians);
+    _x = _y = 0;
+}
+
+void PositionFilter::updateEstimate()
+{
+    _estimate.coordinate = GeoPoint(_origin.latitude + _y / kMetersPerDegree,
+                                    longitudeDelta(_origin.longitude + _x / _metersPerDegreeLongitude, 0.0));
+    _estimate.velocityNorth = _vy;
+    _estimate.velocityEast = _vx;
+    _estimate.horizontalAccuracy = std::sqrt(_p00);
+}
+
+} // namespace rtc
@@ -0,0 +1,154 @@
+//
+//  RTCPositionFilter.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/28/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCPositionFilter_h
+#define Retrac_RTCPositionFilter_h
+
+#include <cstddef>
+#include "RTCGeo.h"
+#include "RTCLocationFixEngine.h"
+
+namespace rtc {
+
+/**
+ * PositionFilterPolicy holds the knobs that trade smoothness for lag.
+ * The default values mirror the position settings in RTCConstants.m
+ */
+struct PositionFilterPolicy {
+    double accelerationNoise;   // kRTCPositionAccelerationNoise
+    double maxAccuracy;         // kRTCPositionMaxAccuracy
+    double maxGap;              // kRTCPositionMaxGap
+    double outlierGate;         // kRTCPositionOutlierGate
+    unsigned maxOutliers;       // kRTCPositionMaxOutliers
+    double rerouteDistance;     // kRTCDirectionsRerouteDistance
+    double rerouteConfidence;   // kRTCDirectionsRerouteConfidence
+
+    PositionFilterPolicy()
+        : accelerationNoise(0.5), maxAccuracy(100.0), maxGap(30.0), outlierGate(4.0),
+          maxOutliers(3), rerouteDistance(25.0), rerouteConfidence(2.0) {}
+};
+
+/**
+ * PositionEstimate is the filter's idea of where the user is and how they are
+ * moving, as of the last fix it used.
+ */
+struct PositionEstimate {
+    double timestamp;           // seconds, same epoch as the fixes
+    GeoPoint coordinate;
+    double velocityNorth;       // meters per second
+    double velocityEast;        // meters per second
+    double horizontalAccuracy;  // meters, in the same sense as a fix's
+
+    PositionEstimate() : timestamp(0), velocityNorth(0), velocityEast(0), horizontalAccuracy(-1) {}
+
+    /**
+     * Meters per second over the ground
+     */
+    double speed() const { return std::sqrt(velocityNorth * velocityNorth + velocityEast * velocityEast); }
+
+    /**
+     * Direction of travel, degrees clockwise from true north in [0, 360)
+     */
+    double course() const;
+};
+
+/**
+ * PositionFilter smooths a stream of fixes into a position and velocity with
+ * a constant-velocity Kalman filter, weighing each fix by its accuracy.
+ *
+ * Positions are kept in meters east and north of an origin near the user, so
+ * the filter runs in a plane. The two axes have the same motion model and the
+ * same measurement noise (a fix's horizontalAccuracy, taken as the standard
+ * deviation of each axis), so they share one 2x2 covariance and a fix costs a
+ * couple dozen flops.
+ *
+ * - Fixes that are invalid, older than the last one used, or less accurate
+ *   than policy.maxAccuracy are dropped.
+ * - A fix further from the prediction than policy.outlierGate standard
+ *   deviations is an outlier (multipath, a stale cell tower fix) and dropped,
+ *   unless it is the policy.maxOutliers-th in a row; then the user really did
+ *   jump and the filter restarts there. It also restarts after policy.maxGap
+ *   without a fix.
+ * - policy.accelerationNoise is the standard deviation (m/s^2) of the speed
+ *   changes the model doesn't predict. Higher follows turns and stops sooner
+ *   but smooths less.
+ */
+class PositionFilter {
+public:
+    explicit PositionFilter(const PositionFilterPolicy &policy = PositionFilterPolicy());
+
+    const PositionFilterPolicy &policy() const { return _policy; }
+
+    /**
+     * Forget the estimate, so the next fix starts over.
+     */
+    void reset();
+
+    /**
+     * Feed a fix from the location provider.
+     *
+     * @return false if the fix was dropped and the estimate is unchanged.
+     */
+    bool addFix(const LocationFix &fix);
+
+    bool hasEstimate() const { return _hasEstimate; }
+
+    /**
+     * Current estimate, only meaningful if hasEstimate()
+     */
+    const PositionEstimate &estimate() const { return _estimate; }
+
+    /**
+     * Whether the user has moved far enough from a point to need a new route:
+     * more than policy.rerouteDistance, and more than policy.rerouteConfidence
+     * standard deviations of the estimate and the point combined, so noise
+     * alone doesn't do it.
+     *
+     * @param from          where the current route starts
+     * @param fromAccuracy  how accurately from was known, meters
+     *
+     * @return true if there is no estimate to say otherwise.
+     */
+    bool movedSignificantly(const GeoPoint &from, double fromAccuracy) const;
+
+    /**
+     * Number of fixes fed, used, and dropped as outliers since reset()
+     */
+    size_t numFixesReceived() const { return _numFixesReceived; }
+    size_t numFixesUsed() const { return _numFixesUsed; }
+    size_t numOutliers() const { return _numOutliers; }
+
+private:
+    void start(const LocationFix &fix);
+    void moveOrigin();
+    void updateEstimate();
+
+    PositionFilterPolicy _policy;
+
+    bool _hasEstimate;
+    PositionEstimate _estimate;
+    unsigned _consecutiveOutliers;
+
+    // state in meters east (x) and north (y) of the origin
+    GeoPoint _origin;
+    double _metersPerDegreeLongitude;
+    double _x, _y, _vx, _vy;
+
+    // covariance of (position, velocity) along either axis
+    double _p00, _p01, _p11;
+
+    size_t _numFixesReceived;
+    size_t _numFixesUsed;
+    size_t _numOutliers;
+};
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,310 @@
+//
+//  RTCRouteCache.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/14/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCRouteCache.h"
+#include <algorithm>
+#include <cmath>
+#include "RTCPolyline.h"
+
+namespace rtc {
+
+#pragma mark - Constants
+static const uint32_t kRouteCacheFileMagic = 0x52435452; // "RTCR"
+static const uint32_t kRouteCacheFileVersion = 2;
+
+// precision of stored polylines, 1e-7 degrees
+static const int kRoutePolylinePrecision = 7;
+
+// longest stored polyline; anything longer is corrupt
+static const uint32_t kMaxPolylineBytes = 1 << 24;
+
+// meters per degree of latitude, for sizing cells
+static const double kMetersPerDegree = kEarthRadius * kDegreesToRadians;
+
+
+#pragma mark - Helpers
+static int32_t cellIndex(double degrees, double cellSize)
+{
+    return (int32_t)std::floor(degrees * kMetersPerDegree / cellSize);
+}
+
+template <typename T>
+static void writeValue(std::ostream &output, const T &value)
+{
+    output.write((const char *)&value, sizeof(value));
+}
+
+template <typename T>
+static bool readValue(std::istream &input, T &value)
+{
+    input.read((char *)&value, sizeof(value));
+    return (bool)input;
+}
+
+static double polylineLength(const std::vector<GeoPoint> &polyline, size_t first, size_t last)
+{
+    double length = 0;
+    for (size_t i = first + 1; i <= last && i < polyline.size(); ++i) {
+        length += distanceBetween(polyline[i - 1], polyline[i]);
+    }
+    return length;
+}
+
+
+#pragma mark - Partial Routes
+Route routeFromClosestPoint(const Route &route, const GeoPoint &origin, double *offTrack)
+{
+    const std::vector<GeoPoint> &polyline = route.polyline;
+    if (polyline.size() < 2) {
+        if (offTrack) *offTrack = polyline.empty() ? HUGE_VAL : distanceBetween(origin, polyline[0]);
+        return route;
+    }
+
+    // closest point on any segment, as (segment, fraction along it)
+    size_t bestSegment = 0;
+    double bestT = 0, bestDistance = HUGE_VAL;
+    for (size_t i = 0; i + 1 < polyline.size(); ++i) {
+        double ax, ay, bx, by;
+        localOffset(origin, polyline[i], &ax, &ay);
+        localOffset(origin, polyline[i + 1], &bx, &by);
+        double dx = bx - ax, dy = by - ay;
+        double lengthSquared = dx * dx + dy * dy;
+        double t = (lengthSquared > 0) ? -(ax * dx + ay * dy) / lengthSquared : 0.0;
+        t = std::max(0.0, std::min(1.0, t));
+        double distance = std::hypot(ax + t * dx, ay + t * dy);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            bestSegment = i;
+            bestT = t;
+        }
+    }
+    if (offTrack) *offTrack = bestDistance;
+
+    const GeoPoint &a = polyline[bestSegment];
+    const GeoPoint &b = polyline[bestSegment + 1];
+    GeoPoint start(a.latitude + bestT * (b.latitude - a.latitude),
+                   a.longitude + bestT * (b.longitude - a.longitude));
+
+    Route tail;
+    tail.polyline.push_back(start);
+    tail.polyline.insert(tail.polyline.end(), polyline.begin() + bestSegment + 1, polyline.end());
+
+    // keep the step we're in and the ones after it, re-indexed to the new
+    // polyline. Vertex i of the old polyline is vertex i - bestSegment now.
+    for (size_t s = 0; s < route.steps.size(); ++s) {
+        const RouteStep &step = route.steps[s];
+        size_t nextFirst = (s + 1 < route.steps.size()) ? route.steps[s + 1].firstPoint : polyline.size() - 1;
+        if (nextFirst <= bestSegment && s + 1 < route.steps.size()) continue;
+
+        RouteStep kept = step;
+        if (step.firstPoint <= bestSegment) {
+            kept.firstPoint = 0;
+            kept.distance = polylineLength(tail.polyline, 0, nextFirst - bestSegment);
+        } else {
+            kept.firstPoint = (uint32_t)(step.firstPoint - bestSegment);
+        }
+        tail.steps.push_back(kept);
+    }
+
+    tail.distance = polylineLength(tail.polyline, 0, tail.polyline.size() - 1);
+    double fullLength = polylineLength(polyline, 0, polyline.size() - 1);
+    tail.expectedTravelTime = (fullLength > 0) ? route.expectedTravelTime * (tail.distance / fullLength) : 0;
+    return tail;
+}
+
+
+#pragma mark - RouteCache
+bool RouteCache::Key::operator<(const Key &other) const
+{
+    if (originLatitude != other.originLatitude) return originLatitude < other.originLatitude;
+    if (originLongitude != other.originLongitude) return originLongitude < other.originLongitude;
+    if (destinationLatitude != other.destinationLatitude) return destinationLatitude < other.destinationLatitude;
+    return destinationLongitude < other.destinationLongitude;
+}
+
+RouteCache::RouteCache(const Clock &clock, const RouteCachePolicy &policy)
+    : _clock(clock), _policy(policy), _useCount(0)
+{
+}
+
+RouteCache::Key RouteCache::keyFor(const GeoPoint &origin, const GeoPoint &destination) const
+{
+    Key key;
+    key.originLatitude = cellIndex(origin.latitude, _policy.originCellSize);
+    key.originLongitude = cellIndex(origin.longitude, _policy.originCellSize);
+    key.destinationLatitude = cellIndex(destination.latitude, _policy.destinationCellSize);
+    key.destinationLongitude = cellIndex(destination.longitude, _policy.destinationCellSize);
+    return key;
+}
+
+RouteCache::Match RouteCache::lookup(const GeoPoint &origin, const GeoPoint &destination)
+{
+    Match match;
+    Key key = keyFor(origin, destination);
+
+    std::map<Key, Entry>::iterator found = _entries.find(key);
+    if (found != _entries.end()) {
+        found->second.lastUsed = ++_useCount;
+        match.kind = MatchExact;
+        match.route = found->second.route;
+        match.age = _clock.now() - found->second.storedAt;
+    } else if (!partialMatch(key, origin, match)) {
+        return match;
+    }
+
+    match.stale = (match.age > _policy.maxAge);
+    return match;
+}
+
+/**
+ * Look for a route to the same destination that the origin is already on
+ */
+bool RouteCache::partialMatch(const Key &key, const GeoPoint &origin, Match &match)
+{
+    Entry *best = 0;
+    double bestOffTrack = _policy.reuseDistance;
+    Route bestTail;
+
+    for (std::map<Key, Entry>::iterator it = _entries.begin(); it != _entries.end(); ++it) {
+        if (!it->first.sameDestination(key)) continue;
+
+        double offTrack;
+        Route tail = routeFromClosestPoint(it->second.route, origin, &offTrack);
+        if (offTrack <= bestOffTrack) {
+            best = &it->second;
+            bestOffTrack = offTrack;
+            bestTail = tail;
+        }
+    }
+    if (!best) return false;
+
+    best->lastUsed = ++_useCount;
+    match.kind = MatchPartial;
+    match.route = bestTail;
+    match.age = _clock.now() - best->storedAt;
+    return true;
+}
+
+void RouteCache::store(const GeoPoint &origin, const GeoPoint &destination, const Route &route)
+{
+    Entry &entry = _entries[keyFor(origin, destination)];
+    entry.route = route;
+    entry.storedAt = _clock.now();
+    entry.lastUsed = ++_useCount;
+    evict();
+}
+
+void RouteCache::clear()
+{
+    _entries.clear();
+    _useCount = 0;
+}
+
+/**
+ * Drop least recently used routes till we are within policy.maxEntries
+ */
+void RouteCache::evict()
+{
+    while (_entries.size() > _policy.maxEntries) {
+        std::map<Key, Entry>::iterator oldest = _entries.begin();
+        for (std::map<Key, Entry>::iterator it = _entries.begin(); it != _entries.end(); ++it) {
+            if (it->second.lastUsed < oldest->second.lastUsed) oldest = it;
+        }
+        _entries.erase(oldest);
+    }
+}
+
+
+#pragma mark - Serialization
+void RouteCache::write(std::ostream &output) const
+{
+    writeValue(output, kRouteCacheFileMagic);
+    writeValue(output, kRouteCacheFileVersion);
+    writeValue(output, (uint32_t)_entries.size());
+
+    for (std::map<Key, Entry>::const_iterator it = _entries.begin(); it != _entries.end(); ++it) {
+        const Key &key = it->first;
+        const Entry &entry = it->second;
+        writeValue(output, key.originLatitude);
+        writeValue(output, key.originLongitude);
+        writeValue(output, key.destinationLatitude);
+        writeValue(output, key.destinationLongitude);
+        writeValue(output, entry.storedAt);
+        writeValue(output, (float)entry.route.distance);
+        writeValue(output, (float)entry.route.expectedTravelTime);
+
+        std::string polyline = encodePolyline(entry.route.polyline, kRoutePolylinePrecision);
+        writeValue(output, (uint32_t)polyline.size());
+        output.write(polyline.data(), polyline.size());
+
+        writeValue(output, (uint16_t)entry.route.steps.size());
+        for (size_t i = 0; i < entry.route.steps.size(); ++i) {
+            const RouteStep &step = entry.route.steps[i];
+            uint16_t length = (uint16_t)std::min(step.instructions.size(), (size_t)UINT16_MAX);
+            writeValue(output, step.firstPoint);
+            writeValue(output, (float)step.distance);
+            writeValue(output, length);
+            output.write(step.instructions.data(), length);
+        }
+    }
+}
+
+bool RouteCache::read(std::istream &input)
+{
+    uint32_t magic = 0, version = 0, count = 0;
+    if (!readValue(input, magic) || !readValue(input, version) || !readValue(input, count) ||
+        (magic != kRouteCacheFileMagic) || (version != kRouteCacheFileVersion)) {
+        return false;
+    }
+
+    std::map<Key, Entry> entries;
+    for (uint32_t e = 0; e < count; ++e) {
+        Key key;
+        Entry entry;
+        float distance, expectedTravelTime;
+        uint32_t polylineSize;
+        if (!readValue(input, key.originLatitude) || !readValue(input, key.originLongitude) ||
+            !readValue(input, key.destinationLatitude) || !readValue(input, key.destinationLongitude) ||
+            !readValue(input, entry.storedAt) || !readValue(input, distance) ||
+            !readValue(input, expectedTravelTime) || !readValue(input, polylineSize) ||
+            (polylineSize > kMaxPolylineBytes)) {
+            return false;
+        }
+        entry.route.distance = distance;
+        entry.route.expectedTravelTime = expectedTravelTime;
+
+        std::string polyline(polylineSize, '\0');
+        if (polylineSize && !input.read(&polyline[0], polylineSize)) return false;
+        if (!decodePolyline(polyline.data(), polyline.size(), entry.route.polyline)) return false;
+
+        uint16_t numSteps;
+        if (!readValue(input, numSteps)) return false;
+        for (uint16_t i = 0; i < numSteps; ++i) {
+            RouteStep step;
+            float stepDistance;
+            uint16_t length;
+            if (!readValue(input, step.firstPoint) || !readValue(input, stepDistance) || !readValue(input, length)) {
+                return false;
+            }
+            step.distance = stepDistance;
+            step.instructions.resize(length);
+            if (length && !input.read(&step.instructions[0], length)) return false;
+            entry.route.steps.push_back(step);
+        }
+
+        entry.lastUsed = e;
+        entries[key] = entry;
+    }
+
+    _entries.swap(entries);
+    _useCount = count;
+    evict();
+    return true;
+}
+
+} // namespace rtc
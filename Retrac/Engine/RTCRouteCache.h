@@ -0,0 +1,173 @@
+//
+//  RTCRouteCache.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/14/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/MapKit here so this can be
+//  compiled and exercised headlessly.
+
+#ifndef Retrac_RTCRouteCache_h
+#define Retrac_RTCRouteCache_h
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "RTCClock.h"
+#include "RTCGeo.h"
+
+namespace rtc {
+
+/**
+ * RouteStep is the engine equivalent of MKRouteStep
+ */
+struct RouteStep {
+    std::string instructions;
+    double distance;            // meters
+    uint32_t firstPoint;        // index into Route::polyline where the step starts
+
+    RouteStep() : distance(0), firstPoint(0) {}
+    RouteStep(const std::string &someInstructions, double aDistance, uint32_t aFirstPoint)
+        : instructions(someInstructions), distance(aDistance), firstPoint(aFirstPoint) {}
+};
+
+/**
+ * Route is the engine equivalent of MKRoute: the steps' polylines joined into
+ * one, with each step pointing at where it starts.
+ */
+struct Route {
+    std::vector<GeoPoint> polyline;
+    std::vector<RouteStep> steps;
+    double distance;            // meters
+    double expectedTravelTime;  // seconds
+
+    Route() : distance(0), expectedTravelTime(0) {}
+};
+
+/**
+ * RouteCachePolicy holds the knobs that trade route freshness for requests.
+ * The default values mirror the directions settings in RTCConstants.m
+ */
+struct RouteCachePolicy {
+    double originCellSize;      // kRTCRouteCacheOriginCellSize
+    double destinationCellSize; // kRTCRouteCacheDestinationCellSize
+    double maxAge;              // kRTCRouteCacheMaxAge
+    double reuseDistance;       // kRTCRouteCacheReuseDistance
+    unsigned maxEntries;        // kRTCRouteCacheMaxEntries
+
+    RouteCachePolicy()
+        : originCellSize(25.0), destinationCellSize(10.0), maxAge(3600.0),
+          reuseDistance(25.0), maxEntries(64) {}
+};
+
+/**
+ * RouteCache remembers walking routes so a directions screen can show one
+ * without waiting on the network.
+ *
+ * Routes are keyed by their origin and destination quantized to cells of
+ * policy.originCellSize and policy.destinationCellSize meters, so walking a
+ * few meters doesn't miss the cache. Failing an exact match, a cached route to
+ * the same destination that passes within policy.reuseDistance of the new
+ * origin is cut down to start there (the user is already walking it).
+ *
+ * A route older than policy.maxAge is still returned but flagged stale, so
+ * the host can show it and refresh it in the background. The least recently
+ * used route goes once there are more than policy.maxEntries.
+ */
+class RouteCache {
+public:
+    enum MatchKind {
+        MatchNone,
+        MatchExact,             // same origin and destination cells
+        MatchPartial            // the tail of a route passing near the origin
+    };
+
+    /**
+     * Result of a lookup
+     */
+    struct Match {
+        MatchKind kind;
+        bool stale;             // older than policy.maxAge
+        double age;             // seconds since the route was stored
+        Route route;
+
+        Match() : kind(MatchNone), stale(false), age(0) {}
+    };
+
+    /**
+     * @param clock     time source, must outlive the cache
+     * @param policy    cache knobs
+     */
+    explicit RouteCache(const Clock &clock, const RouteCachePolicy &policy = RouteCachePolicy());
+
+    const RouteCachePolicy &policy() const { return _policy; }
+
+    /**
+     * Find a route from origin to destination.
+     */
+    Match lookup(const GeoPoint &origin, const GeoPoint &destination);
+
+    /**
+     * Remember a route from origin to destination, replacing any in the same
+     * cells.
+     */
+    void store(const GeoPoint &origin, const GeoPoint &destination, const Route &route);
+
+    void clear();
+    size_t size() const { return _entries.size(); }
+
+    /**
+     * Binary serialization. Polylines are stored encoded (see encodePolyline())
+     * at 1e-7 degrees, about 4 bytes a point.
+     *
+     * @return false if the stream is short or not a route cache.
+     */
+    void write(std::ostream &output) const;
+    bool read(std::istream &input);
+
+private:
+    struct Key {
+        int32_t originLatitude, originLongitude;
+        int32_t destinationLatitude, destinationLongitude;
+
+        bool operator<(const Key &other) const;
+        bool sameDestination(const Key &other) const {
+            return (destinationLatitude == other.destinationLatitude) &&
+                   (destinationLongitude == other.destinationLongitude);
+        }
+    };
+
+    struct Entry {
+        Route route;
+        double storedAt;
+        uint64_t lastUsed;
+
+        Entry() : storedAt(0), lastUsed(0) {}
+    };
+
+    Key keyFor(const GeoPoint &origin, const GeoPoint &destination) const;
+    bool partialMatch(const Key &key, const GeoPoint &origin, Match &match);
+    void evict();
+
+    const Clock &_clock;
+    RouteCachePolicy _policy;
+    std::map<Key, Entry> _entries;
+    uint64_t _useCount;
+};
+
+/**
+ * The part of route from the point along it closest to origin, with step
+ * distances and expected travel time cut down in proportion.
+ *
+ * @param offTrack  optional, set to the distance (meters) from origin to the
+ *                  route
+ */
+Route routeFromClosestPoint(const Route &route, const GeoPoint &origin, double *offTrack = 0);
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,218 @@
+//
+//  RTCRouteProgress.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/29/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCRouteProgress.h"
+#include <algorithm>
+
+namespace rtc {
+
+#pragma mark - Constants
+// meters per degree of latitude
+static const double kMetersPerDegree = kEarthRadius * kDegreesToRadians;
+
+// meters of distance from the fix a candidate segment is charged per meter
+// of route ahead of, or behind, the last progress. Where a route comes back
+// near itself the pass the user is on wins, and going on wins over going back.
+static const double kAheadPenalty = 0.05;
+static const double kBehindPenalty = 0.5;
+
+
+#pragma mark - Helpers
+// longitude difference in [-180, 180)
+static double longitudeDelta(double to, double from)
+{
+    double delta = std::fmod(to - from + 180.0, 360.0);
+    return ((delta < 0) ? delta + 360.0 : delta) - 180.0;
+}
+
+
+#pragma mark - RouteTracker
+RouteTracker::RouteTracker(const RouteProgressPolicy &policy)
+    : _policy(policy), _metersPerDegreeLongitude(kMetersPerDegree), _expectedTravelTime(0), _visit(0),
+      _offRoute(false), _offRouteCount(0), _offRouteSince(0), _lastSegmentsTested(0)
+{
+}
+
+void RouteTracker::setRoute(const Route &route)
+{
+    _x.clear();
+    _y.clear();
+    _along.clear();
+    _stepFirstSegments.clear();
+    _cells.clear();
+    _progress = RouteProgress();
+    _offRoute = false;
+    _offRouteCount = 0;
+    _lastSegmentsTested = 0;
+    _expectedTravelTime = route.expectedTravelTime;
+
+    const std::vector<GeoPoint> &polyline = route.polyline;
+    if (polyline.size() < 2) return;
+
+    _origin = polyline[0];
+    _metersPerDegreeLongitude = kMetersPerDegree * std::cos(_origin.latitude * kDegreesToRadians);
+    _x.resize(polyline.size());
+    _y.resize(polyline.size());
+    _along.resize(polyline.size());
+    for (size_t i = 0; i < polyline.size(); ++i) {
+        toPlane(polyline[i], &_x[i], &_y[i]);
+        _along[i] = i ? _along[i - 1] + std::hypot(_x[i] - _x[i - 1], _y[i] - _y[i - 1]) : 0.0;
+    }
+
+    size_t lastSegment = polyline.size() - 2;
+    for (size_t s = 0; s < route.steps.size(); ++s) {
+        _stepFirstSegments.push_back((uint32_t)std::min((size_t)route.steps[s].firstPoint, lastSegment));
+    }
+
+    // file each segment under every cell it crosses: cut it into pieces no
+    //   longer than a cell, so each piece's bounding box covers at most 2x2
+    double cellSize = _policy.searchRadius;
+    for (size_t i = 0; i <= lastSegment; ++i) {
+        double length = _along[i + 1] - _along[i];
+        size_t numPieces = std::max((size_t)1, (size_t)std::ceil(length / cellSize));
+        for (size_t p = 0; p < numPieces; ++p) {
+            double t0 = (double)p / numPieces, t1 = (double)(p + 1) / numPieces;
+            double x0 = _x[i] + t0 * (_x[i + 1] - _x[i]), x1 = _x[i] + t1 * (_x[i + 1] - _x[i]);
+            double y0 = _y[i] + t0 * (_y[i + 1] - _y[i]), y1 = _y[i] + t1 * (_y[i + 1] - _y[i]);
+            for (int32_t cx = cellIndex(std::min(x0, x1)); cx <= cellIndex(std::max(x0, x1)); ++cx) {
+                for (int32_t cy = cellIndex(std::min(y0, y1)); cy <= cellIndex(std::max(y0, y1)); ++cy) {
+                    CellEntry entry = {cellKey(cx, cy), (uint32_t)i};
+                    _cells.push_back(entry);
+                }
+            }
+        }
+    }
+    std::sort(_cells.begin(), _cells.end());
+    _cells.erase(std::unique(_cells.begin(), _cells.end()), _cells.end());
+
+    _segmentVisits.assign(lastSegment + 1, 0);
+    _visit = 0;
+}
+
+RouteTracker::Event RouteTracker::addFix(const LocationFix &fix)
+{
+    if ((fix.horizontalAccuracy < 0) || (_x.size() < 2)) return EventNone;
+
+    double x, y;
+    toPlane(GeoPoint(fix.latitude, fix.longitude), &x, &y);
+    size_t segment = 0;
+    double t = 0, distance = HUGE_VAL;
+    if (match(x, y, &segment, &t, &distance)) {
+        updateProgress(segment, t, distance);
+    } else {
+        _progress.distanceFromRoute = HUGE_VAL;
+    }
+
+    if (_offRoute) {
+        if (distance > _policy.onRouteDistance) return EventNone;
+        _offRoute = false;
+        _offRouteCount = 0;
+        return EventBackOnRoute;
+    }
+
+    if (distance <= _policy.offRouteDistance + fix.horizontalAccuracy) {
+        _offRouteCount = 0;
+        return EventNone;
+    }
+    if (!_offRouteCount++) _offRouteSince = fix.timestamp;
+    if ((_offRouteCount >= _policy.offRouteFixes) && (fix.timestamp - _offRouteSince >= _policy.offRouteTime)) {
+        _offRoute = true;
+        return EventOffRoute;
+    }
+    return EventNone;
+}
+
+void RouteTracker::toPlane(const GeoPoint &point, double *x, double *y) const
+{
+    *x = longitudeDelta(point.longitude, _origin.longitude) * _metersPerDegreeLongitude;
+    *y = (point.latitude - _origin.latitude) * kMetersPerDegree;
+}
+
+RouteTracker::CellKey RouteTracker::cellKey(int32_t cx, int32_t cy) const
+{
+    return ((CellKey)(uint32_t)cx << 32) | (uint32_t)cy;
+}
+
+int32_t RouteTracker::cellIndex(double meters) const
+{
+    return (int32_t)std::floor(meters / _policy.searchRadius);
+}
+
+/**
+ * Closest segment within policy.searchRadius of (x, y), weighing in how far
+ * along the route it is from the last progress.
+ *
+ * @return false if no segment is that close.
+ */
+bool RouteTracker::match(double x, double y, size_t *segment, double *t, double *distance)
+{
+    // a new stamp per fix, so a segment filed under several cells is tested once
+    if (++_visit == 0) {
+        std::fill(_segmentVisits.begin(), _segmentVisits.end(), 0);
+        _visit = 1;
+    }
+
+    double radius = _policy.searchRadius;
+    double bestScore = HUGE_VAL;
+    size_t tested = 0;
+    for (int32_t cx = cellIndex(x - radius); cx <= cellIndex(x + radius); ++cx) {
+        for (int32_t cy = cellIndex(y - radius); cy <= cellIndex(y + radius); ++cy) {
+            CellEntry first = {cellKey(cx, cy), 0};
+            for (std::vector<CellEntry>::const_iterator it = std::lower_bound(_cells.begin(), _cells.end(), first);
+                 (it != _cells.end()) && (it->cell == first.cell); ++it) {
+                uint32_t s = it->segment;
+                if (_segmentVisits[s] == _visit) continue;
+                _segmentVisits[s] = _visit;
+                ++tested;
+
+                double dx = _x[s + 1] - _x[s], dy = _y[s + 1] - _y[s];
+                double lengthSquared = dx * dx + dy * dy;
+                double along = (lengthSquared > 0) ? ((x - _x[s]) * dx + (y - _y[s]) * dy) / lengthSquared : 0.0;
+                along = std::max(0.0, std::min(1.0, along));
+                double segmentDistance = std::hypot(_x[s] + along * dx - x, _y[s] + along * dy - y);
+                if (segmentDistance > radius) continue;
+
+                double score = segmentDistance;
+                if (_progress.matched) {
+                    double ahead = _along[s] + along * (_along[s + 1] - _along[s]) - _progress.distanceAlong;
+                    score += (ahead >= 0) ? kAheadPenalty * ahead : -kBehindPenalty * ahead;
+                }
+                if (score < bestScore) {
+                    bestScore = score;
+                    *segment = s;
+                    *t = along;
+                    *distance = segmentDistance;
+                }
+            }
+        }
+    }
+    _lastSegmentsTested = tested;
+    return bestScore < HUGE_VAL;
+}
+
+void RouteTracker::updateProgress(size_t segment, double t, double distance)
+{
+    double x = _x[segment] + t * (_x[segment + 1] - _x[segment]);
+    double y = _y[segment] + t * (_y[segment + 1] - _y[segment]);
+    double total = _along.back();
+
+    _progress.matched = true;
+    _progress.snapped = GeoPoint(_origin.latitude + y / kMetersPerDegree,
+                                 longitudeDelta(_origin.longitude + x / _metersPerDegreeLongitude, 0.0));
+    _progress.distanceFromRoute = distance;
+    _progress.distanceAlong = _along[segment] + t * (_along[segment + 1] - _along[segment]);
+    _progress.distanceRemaining = std::max(0.0, total - _progress.distanceAlong);
+    _progress.timeRemaining = (total > 0) ? _expectedTravelTime * (_progress.distanceRemaining / total) : 0.0;
+    _progress.segmentIndex = segment;
+
+    std::vector<uint32_t>::const_iterator step = std::upper_bound(_stepFirstSegments.begin(), _stepFirstSegments.end(),
+                                                                 (uint32_t)segment);
+    _progress.stepIndex = (step == _stepFirstSegments.begin()) ? 0 : (size_t)(step - _stepFirstSegments.begin() - 1);
+}
+
+} // namespace rtc
@@ -0,0 +1,156 @@
+//
+//  RTCRouteProgress.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/29/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/MapKit here so this can be
+//  compiled and exercised headlessly.
+
+#ifndef Retrac_RTCRouteProgress_h
+#define Retrac_RTCRouteProgress_h
+
+#include <cstdint>
+#include <vector>
+#include "RTCGeo.h"
+#include "RTCLocationFixEngine.h"
+#include "RTCRouteCache.h"
+
+namespace rtc {
+
+/**
+ * RouteProgressPolicy holds the knobs that trade how soon a wrong turn is
+ * noticed for false alarms. The default values mirror the route progress
+ * settings in RTCConstants.m
+ */
+struct RouteProgressPolicy {
+    double offRouteDistance;    // kRTCRouteOffRouteDistance
+    double onRouteDistance;     // kRTCRouteOnRouteDistance
+    unsigned offRouteFixes;     // kRTCRouteOffRouteFixes
+    double offRouteTime;        // kRTCRouteOffRouteTime
+    double searchRadius;        // kRTCRouteSearchRadius
+
+    RouteProgressPolicy()
+        : offRouteDistance(30.0), onRouteDistance(15.0), offRouteFixes(3),
+          offRouteTime(5.0), searchRadius(100.0) {}
+};
+
+/**
+ * RouteProgress is where along a route the last fix put the user
+ */
+struct RouteProgress {
+    bool matched;               // has any fix been within policy.searchRadius?
+    GeoPoint snapped;           // closest point on the route
+    double distanceFromRoute;   // meters from the fix to snapped, HUGE_VAL if too far to tell
+    double distanceAlong;       // meters from the start of the route to snapped
+    double distanceRemaining;   // meters from snapped to the end
+    double timeRemaining;       // seconds, the route's travel time cut down in proportion
+    size_t segmentIndex;        // polyline segment snapped is on
+    size_t stepIndex;           // route step snapped is in
+
+    RouteProgress()
+        : matched(false), distanceFromRoute(HUGE_VAL), distanceAlong(0), distanceRemaining(0),
+          timeRemaining(0), segmentIndex(0), stepIndex(0) {}
+};
+
+/**
+ * RouteTracker follows the user along a walking route: it projects each fix
+ * onto the route's polyline for progress and the current step, and says when
+ * the user has left the route so the host can ask for a new one.
+ *
+ * The polyline is kept in meters around its first vertex, with every segment
+ * filed under the grid cells of policy.searchRadius it passes through, in one
+ * sorted array. A fix only tests the segments in the handful of cells around
+ * it, so it costs the same on a route of 10 vertices or 10^5.
+ *
+ * Where the route passes near itself (out and back, a loop) the segment just
+ * ahead of the last progress wins unless another is clearly closer to the
+ * fix.
+ *
+ * Off route takes policy.offRouteFixes fixes in a row, over at least
+ * policy.offRouteTime, further than policy.offRouteDistance plus their
+ * accuracy from the route. Back on route takes a single fix within
+ * policy.onRouteDistance.
+ */
+class RouteTracker {
+public:
+    /**
+     * What the host should do after feeding the tracker
+     */
+    enum Event {
+        EventNone,
+        EventOffRoute,          // the user left the route; ask for a new one from here
+        EventBackOnRoute        // the user found their way back
+    };
+
+    explicit RouteTracker(const RouteProgressPolicy &policy = RouteProgressPolicy());
+
+    const RouteProgressPolicy &policy() const { return _policy; }
+
+    /**
+     * Follow route from now on, forgetting progress along any previous one.
+     */
+    void setRoute(const Route &route);
+
+    /**
+     * Feed a fix from the location provider. Fixes with invalid accuracy are
+     * ignored.
+     */
+    Event addFix(const LocationFix &fix);
+
+    const RouteProgress &progress() const { return _progress; }
+    bool isOffRoute() const { return _offRoute; }
+
+    size_t numSegments() const { return _x.empty() ? 0 : _x.size() - 1; }
+
+    /**
+     * Segments tested for the last fix, for measuring the index
+     */
+    size_t lastSegmentsTested() const { return _lastSegmentsTested; }
+
+private:
+    typedef uint64_t CellKey;
+
+    struct CellEntry {
+        CellKey cell;
+        uint32_t segment;
+
+        bool operator<(const CellEntry &other) const {
+            return (cell != other.cell) ? (cell < other.cell) : (segment < other.segment);
+        }
+        bool operator==(const CellEntry &other) const {
+            return (cell == other.cell) && (segment == other.segment);
+        }
+    };
+
+    void toPlane(const GeoPoint &point, double *x, double *y) const;
+    CellKey cellKey(int32_t cx, int32_t cy) const;
+    int32_t cellIndex(double meters) const;
+    bool match(double x, double y, size_t *segment, double *t, double *distance);
+    void updateProgress(size_t segment, double t, double distance);
+
+    RouteProgressPolicy _policy;
+
+    // route polyline in meters east (x) and north (y) of its first vertex,
+    // and meters along the route at each vertex
+    GeoPoint _origin;
+    double _metersPerDegreeLongitude;
+    std::vector<double> _x, _y, _along;
+    std::vector<uint32_t> _stepFirstSegments;
+    double _expectedTravelTime;
+
+    std::vector<CellEntry> _cells;          // sorted
+    std::vector<uint32_t> _segmentVisits;   // fix number a segment was last tested for
+    uint32_t _visit;
+
+    RouteProgress _progress;
+    bool _offRoute;
+    unsigned _offRouteCount;
+    double _offRouteSince;
+    size_t _lastSegmentsTested;
+};
+
+} // namespace rtc
+
+#endif
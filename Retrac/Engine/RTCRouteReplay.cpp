@@ -0,0 +1,103 @@
+//
+//  RTCRouteReplay.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/14/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCRouteReplay.h"
+#include <algorithm>
+#include <cmath>
+#include "RTCTrace.h"
+
+namespace rtc {
+
+#pragma mark - Helpers
+/**
+ * Append the vertices of a straight leg from the route's last vertex to end,
+ * one every spacing meters, as a new step.
+ */
+static void appendLeg(Route &route, const GeoPoint &end, double spacing, const char *instructions)
+{
+    GeoPoint start = route.polyline.back();
+    double length = distanceBetween(start, end);
+    if (length <= 0) return;
+
+    route.steps.push_back(RouteStep(instructions, length, (uint32_t)(route.polyline.size() - 1)));
+
+    size_t numSegments = std::max((size_t)1, (size_t)std::ceil(length / spacing));
+    for (size_t i = 1; i <= numSegments; ++i) {
+        double f = (double)i / numSegments;
+        route.polyline.push_back(GeoPoint(start.latitude + f * (end.latitude - start.latitude),
+                                          start.longitude + f * (end.longitude - start.longitude)));
+    }
+    route.distance += length;
+}
+
+
+#pragma mark - GridDirectionsProvider
+bool GridDirectionsProvider::walkingRoute(const GeoPoint &origin, const GeoPoint &destination, Route &route)
+{
+    ++_numRequests;
+
+    route = Route();
+    route.polyline.push_back(origin);
+
+    GeoPoint corner(destination.latitude, origin.longitude);
+    appendLeg(route, corner, _spacing, (destination.latitude >= origin.latitude) ? "Head north" : "Head south");
+    appendLeg(route, destination, _spacing, (destination.longitude >= origin.longitude) ? "Turn east" : "Turn west");
+    route.steps.push_back(RouteStep("Arrive at the destination", 0, (uint32_t)(route.polyline.size() - 1)));
+
+    route.expectedTravelTime = route.distance / _walkingSpeed;
+    return true;
+}
+
+
+#pragma mark - Replay
+RouteReplaySummary replayRouteRequests(const RouteRequestTrace &trace, DirectionsProvider &provider,
+                                       double providerLatency, const RouteCachePolicy &policy)
+{
+    RouteReplaySummary summary;
+    summary.numRequests = (unsigned)trace.size();
+
+    ManualClock clock(0.0);
+    RouteCache cache(clock, policy);
+    std::vector<double> latencies;
+
+    for (size_t i = 0; i < trace.size(); ++i) {
+        const RouteRequest &request = trace[i];
+        clock.setNow(request.time);
+
+        RouteCache::Match match = cache.lookup(request.origin, request.destination);
+        switch (match.kind) {
+            case RouteCache::MatchExact:    ++summary.numExactHits; break;
+            case RouteCache::MatchPartial:  ++summary.numPartialHits; break;
+            case RouteCache::MatchNone:     ++summary.numMisses; break;
+        }
+        if (match.stale) ++summary.numStaleHits;
+
+        bool waits = (match.kind == RouteCache::MatchNone);
+        latencies.push_back(waits ? providerLatency : 0.0);
+
+        // fetch on a miss, refresh in the background on a stale hit
+        if (waits || match.stale) {
+            ++summary.numProviderCalls;
+            Route route;
+            if (provider.walkingRoute(request.origin, request.destination, route)) {
+                clock.setNow(request.time + providerLatency);
+                cache.store(request.origin, request.destination, route);
+            }
+        }
+    }
+
+    double sum = 0;
+    for (size_t i = 0; i < latencies.size(); ++i) sum += latencies[i];
+    std::sort(latencies.begin(), latencies.end());
+
+    summary.meanLatency = latencies.empty() ? 0 : sum / latencies.size();
+    summary.p90Latency = percentile(latencies, 0.9);
+    return summary;
+}
+
+} // namespace rtc
@@ -0,0 +1,113 @@
+//
+//  RTCRouteReplay.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/14/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/MapKit here so this can be
+//  compiled and exercised headlessly.
+
+#ifndef Retrac_RTCRouteReplay_h
+#define Retrac_RTCRouteReplay_h
+
+#include <vector>
+#include "RTCRouteCache.h"
+
+namespace rtc {
+
+/**
+ * DirectionsProvider is whatever computes walking routes. On device that is
+ * MKDirections; headlessly it is a stand-in.
+ */
+class DirectionsProvider {
+public:
+    virtual ~DirectionsProvider() {}
+
+    /**
+     * @return false if there is no walking route between the two points.
+     */
+    virtual bool walkingRoute(const GeoPoint &origin, const GeoPoint &destination, Route &route) = 0;
+};
+
+/**
+ * GridDirectionsProvider is a local stand-in for MKDirections that walks
+ * city blocks: north/south first, then east/west, with a vertex every
+ * `spacing` meters and a step per leg. Routes from anywhere along an earlier
+ * route follow that route, as real directions would.
+ */
+class GridDirectionsProvider : public DirectionsProvider {
+public:
+    explicit GridDirectionsProvider(double spacing = 20.0, double walkingSpeed = 1.4)
+        : _spacing(spacing), _walkingSpeed(walkingSpeed), _numRequests(0) {}
+
+    bool walkingRoute(const GeoPoint &origin, const GeoPoint &destination, Route &route);
+
+    /**
+     * Number of routes computed so far
+     */
+    size_t numRequests() const { return _numRequests; }
+
+private:
+    double _spacing;            // meters between vertices
+    double _walkingSpeed;       // meters per second
+    size_t _numRequests;
+};
+
+/**
+ * RouteRequest is one time the directions screen wanted a route: when it
+ * appeared or the user's location changed.
+ */
+struct RouteRequest {
+    double time;                // seconds since start
+    GeoPoint origin;
+    GeoPoint destination;
+
+    RouteRequest() : time(0) {}
+    RouteRequest(double t, const GeoPoint &anOrigin, const GeoPoint &aDestination)
+        : time(t), origin(anOrigin), destination(aDestination) {}
+};
+
+typedef std::vector<RouteRequest> RouteRequestTrace;
+
+/**
+ * Outcome of replaying a request trace through a RouteCache.
+ *
+ * Latency is how long the screen waited for a route to show: nothing for a
+ * cache hit (stale or not), the provider's latency on a miss. Stale hits are
+ * still refreshed through the provider, just off the critical path.
+ */
+struct RouteReplaySummary {
+    unsigned numRequests;
+    unsigned numExactHits;
+    unsigned numPartialHits;
+    unsigned numStaleHits;      // hits (of either kind) that were refreshed
+    unsigned numMisses;
+    unsigned numProviderCalls;
+    double meanLatency;
+    double p90Latency;
+
+    RouteReplaySummary()
+        : numRequests(0), numExactHits(0), numPartialHits(0), numStaleHits(0), numMisses(0),
+          numProviderCalls(0), meanLatency(0), p90Latency(0) {}
+
+    double hitRate() const {
+        return numRequests ? (double)(numExactHits + numPartialHits) / numRequests : 0.0;
+    }
+};
+
+/**
+ * Replay a request trace against a fresh cache running on virtual time.
+ *
+ * @param trace             requests in time order
+ * @param provider          computes routes on a miss or a stale hit
+ * @param providerLatency   seconds each provider call takes
+ * @param policy            cache knobs; maxEntries of 0 replays with no cache
+ */
+RouteReplaySummary replayRouteRequests(const RouteRequestTrace &trace, DirectionsProvider &provider,
+                                       double providerLatency,
+                                       const RouteCachePolicy &policy = RouteCachePolicy());
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,116 @@
+//
+//  RTCScheduler.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 9/3/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCScheduler.h"
+#include <algorithm>
+
+namespace rtc {
+
+#pragma mark - ManualExecutor
+size_t ManualExecutor::runPending()
+{
+    size_t count = 0;
+    while (!_work.empty()) {
+        std::function<void()> work;
+        work.swap(_work.front());
+        _work.pop_front();
+        work();
+        ++count;
+    }
+    return count;
+}
+
+
+#pragma mark - Scheduler
+Scheduler::Scheduler(const Clock &clock, double tickDuration)
+    : _clock(clock), _wheel(tickDuration, clock.now())
+{
+}
+
+TimerHandle Scheduler::scheduleAt(double deadline, Executor &executor, const std::function<void()> &work)
+{
+    TimerWheel::TimerID timerID = _wheel.schedule(deadline);
+    size_t index = TimerWheel::indexOf(timerID);
+    if (index >= _timers.size()) _timers.resize(_wheel.capacity());
+
+    Timer &timer = _timers[index];
+    timer.executor = &executor;
+    timer.work = work;
+    timer.state = std::make_shared<TimerHandle::State>(timerID);
+    return TimerHandle(timer.state);
+}
+
+bool Scheduler::cancel(const TimerHandle &handle)
+{
+    if (!handle._state) return false;
+    handle._state->cancelled.store(true);
+
+    TimerWheel::TimerID timerID = handle._state->timerID;
+    if (!_wheel.cancel(timerID)) return false;
+
+    // let go of the work now, not when the slot is next used
+    Timer &timer = _timers[TimerWheel::indexOf(timerID)];
+    timer.work = std::function<void()>();
+    timer.state.reset();
+    return true;
+}
+
+size_t Scheduler::fireDueTimers()
+{
+    _expired.clear();
+    _wheel.advance(_clock.now(), _expired);
+
+    for (size_t i = 0; i < _expired.size(); ++i) {
+        Timer &timer = _timers[TimerWheel::indexOf(_expired[i])];
+        if (!timer.state->cancelled.load()) {
+            std::shared_ptr<TimerHandle::State> state;
+            std::function<void()> work;
+            state.swap(timer.state);
+            work.swap(timer.work);
+            // checked again on the executor, where a cancel is final
+            timer.executor->post([state, work]() {
+                if (!state->cancelled.load()) work();
+            });
+        }
+        timer.work = std::function<void()>();
+        timer.state.reset();
+    }
+    return _expired.size();
+}
+
+void Scheduler::clear()
+{
+    for (size_t i = 0; i < _timers.size(); ++i) {
+        if (_timers[i].state) _timers[i].state->cancelled.store(true);
+        _timers[i] = Timer();
+    }
+    _wheel.clear();
+}
+
+
+#pragma mark - Virtual time
+size_t runVirtualTime(ManualClock &clock, Scheduler &scheduler, ManualExecutor &executor, double until)
+{
+    size_t count = 0;
+    executor.runPending();
+
+    while (true) {
+        double deadline = scheduler.nextDeadline();
+        if (deadline > until) break;
+        clock.setNow(std::max(deadline, clock.now()));
+        count += scheduler.fireDueTimers();
+        executor.runPending();
+    }
+
+    clock.setNow(std::max(until, clock.now()));
+    count += scheduler.fireDueTimers();
+    executor.runPending();
+    return count;
+}
+
+} // namespace rtc
@@ -0,0 +1,189 @@
+//
+//  RTCScheduler.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 9/3/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCScheduler_h
+#define Retrac_RTCScheduler_h
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "RTCClock.h"
+#include "RTCTimerWheel.h"
+
+namespace rtc {
+
+/**
+ * Executor runs work posted to it one piece at a time, in the order posted:
+ * a serial queue. RTCWorkQueue wraps a serial dispatch queue as one.
+ */
+class Executor {
+public:
+    virtual ~Executor() {}
+
+    /**
+     * Run work soon, after anything posted before it. Safe to call from any
+     * thread.
+     */
+    virtual void post(const std::function<void()> &work) = 0;
+};
+
+/**
+ * ManualExecutor only runs work when told to. Used with a ManualClock for
+ * tests in virtual time.
+ */
+class ManualExecutor : public Executor {
+public:
+    void post(const std::function<void()> &work) { _work.push_back(work); }
+
+    /**
+     * Run everything posted so far, and anything that posts in turn.
+     *
+     * @return how many pieces of work ran.
+     */
+    size_t runPending();
+
+    size_t size() const { return _work.size(); }
+
+private:
+    std::deque<std::function<void()> > _work;
+};
+
+/**
+ * TimerHandle stands for a timer set with Scheduler. Copies stand for the
+ * same timer; an empty handle stands for none.
+ */
+class TimerHandle {
+public:
+    TimerHandle() {}
+
+    /**
+     * Stop the timer's work from running, if it hasn't started. Safe to call
+     * from any thread, and certain to win when called on the executor the
+     * work runs on, even if the timer already fired and the work is queued
+     * up behind. The timer is only taken off the scheduler by
+     * Scheduler::cancel(); until then it just fires to no effect.
+     */
+    void cancel() { if (_state) _state->cancelled.store(true); }
+
+    bool isCancelled() const { return _state && _state->cancelled.load(); }
+    bool isEmpty() const { return !_state; }
+
+private:
+    friend class Scheduler;
+
+    struct State {
+        TimerWheel::TimerID timerID;
+        std::atomic<bool> cancelled;
+
+        explicit State(TimerWheel::TimerID anID) : timerID(anID), cancelled(false) {}
+    };
+
+    explicit TimerHandle(const std::shared_ptr<State> &state) : _state(state) {}
+
+    std::shared_ptr<State> _state;
+};
+
+/**
+ * Scheduler runs work on executors at given times, replacing
+ * performSelector:afterDelay: and one NSTimer per timeout.
+ *
+ * Timers are kept in a TimerWheel, so setting and cancelling them is O(1)
+ * however many are pending. Like the other engines it owns no thread or
+ * timer: the host calls fireDueTimers() at nextDeadline(), which posts the
+ * work of every timer due by clock's now() to its executor. So time can be
+ * virtual (see runVirtualTime()), and work runs on the queue it belongs to
+ * rather than the one that kept time.
+ *
+ * Not thread-safe: call it from one serial queue. Only TimerHandle::cancel()
+ * may be called from anywhere.
+ */
+class Scheduler {
+public:
+    /**
+     * @param clock         time source, must outlive the scheduler
+     * @param tickDuration  seconds, how finely deadlines are kept
+     *                      (kRTCSchedulerTickDuration)
+     */
+    explicit Scheduler(const Clock &clock, double tickDuration = 0.001);
+
+    const Clock &clock() const { return _clock; }
+
+    /**
+     * Post work to executor at deadline, or the first tick after it. The
+     * executor must outlive the timer.
+     */
+    TimerHandle scheduleAt(double deadline, Executor &executor, const std::function<void()> &work);
+
+    /**
+     * Post work to executor delay seconds from now.
+     */
+    TimerHandle scheduleAfter(double delay, Executor &executor, const std::function<void()> &work)
+    {
+        return scheduleAt(_clock.now() + delay, executor, work);
+    }
+
+    /**
+     * Cancel a timer and take it off the scheduler.
+     *
+     * @return false if it had already fired or been taken off.
+     */
+    bool cancel(const TimerHandle &handle);
+
+    /**
+     * Post the work of every timer due by now to its executor, earliest
+     * first. Cancelled timers' work is dropped when it comes to run.
+     *
+     * @return how many timers fired.
+     */
+    size_t fireDueTimers();
+
+    /**
+     * When fireDueTimers() next has something to do, infinity if no timers
+     * are pending
+     */
+    double nextDeadline() const { return _wheel.nextDeadline(); }
+
+    size_t size() const { return _wheel.size(); }
+
+    /**
+     * Cancel every timer
+     */
+    void clear();
+
+private:
+    struct Timer {
+        Executor *executor;
+        std::function<void()> work;
+        std::shared_ptr<TimerHandle::State> state;
+
+        Timer() : executor(0) {}
+    };
+
+    const Clock &_clock;
+    TimerWheel _wheel;
+    std::vector<Timer> _timers;                 // by TimerWheel::indexOf()
+    std::vector<TimerWheel::TimerID> _expired;  // reused by fireDueTimers()
+};
+
+/**
+ * Run scheduler in virtual time till until: jump clock to each deadline in
+ * turn, fire the timers due and run executor dry, so anything the work sets
+ * runs too. Timers must all post to executor.
+ *
+ * @return how many timers fired.
+ */
+size_t runVirtualTime(ManualClock &clock, Scheduler &scheduler, ManualExecutor &executor, double until);
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,332 @@
+//
+//  RTCSpatialIndex.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/10/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCSpatialIndex.h"
+#include <algorithm>
+
+namespace rtc {
+
+#pragma mark - Constants
+// number of bits each axis is quantized to. Cell keys hold 2x this.
+static const int kAxisBits = 32;
+
+// initial search radius (meters) for nearest neighbor queries. This grows
+// geometrically until we find enough places.
+static const double kNearestInitialRadius = 100.0;
+static const double kNearestRadiusGrowth = 4.0;
+
+// serialization header
+static const uint32_t kIndexFileMagic = 0x49435452; // "RTCI"
+static const uint32_t kIndexFileVersion = 1;
+
+
+#pragma mark - Cell Keys
+static uint32_t quantizeLatitude(double latitude)
+{
+    double scaled = (latitude + 90.0) / 180.0 * 4294967296.0;
+    if (scaled <= 0) return 0;
+    if (scaled >= 4294967295.0) return 0xFFFFFFFFu;
+    return (uint32_t)scaled;
+}
+
+static uint32_t quantizeLongitude(double longitude)
+{
+    // normalize to [-180, 180)
+    longitude = std::fmod(longitude + 180.0, 360.0);
+    if (longitude < 0) longitude += 360.0;
+    double scaled = longitude / 360.0 * 4294967296.0;
+    if (scaled >= 4294967295.0) return 0xFFFFFFFFu;
+    return (uint32_t)scaled;
+}
+
+// spread the bits of x out so there's a 0 bit between each
+static uint64_t spreadBits(uint32_t x)
+{
+    uint64_t v = x;
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+    v = (v | (v << 8))  & 0x00FF00FF00FF00FFull;
+    v = (v | (v << 4))  & 0x0F0F0F0F0F0F0F0Full;
+    v = (v | (v << 2))  & 0x3333333333333333ull;
+    v = (v | (v << 1))  & 0x5555555555555555ull;
+    return v;
+}
+
+// latitude takes the high bit of each pair
+static uint64_t interleave(uint32_t latitudeBits, uint32_t longitudeBits)
+{
+    return (spreadBits(latitudeBits) << 1) | spreadBits(longitudeBits);
+}
+
+static uint64_t cellKey(const GeoPoint &coordinate)
+{
+    return interleave(quantizeLatitude(coordinate.latitude), quantizeLongitude(coordinate.longitude));
+}
+
+// finest level at which a cell spans at least `extent` of an axis that is
+// `axisSpan` wide.
+static int levelForExtent(double extent, double axisSpan)
+{
+    if (extent <= 0) return kAxisBits;
+    int level = (int)std::floor(std::log2(axisSpan / extent));
+    return std::max(0, std::min(kAxisBits, level));
+}
+
+
+#pragma mark - Mutation
+void SpatialIndex::assign(const std::vector<Record> &records)
+{
+    clear();
+    _entries.reserve(records.size());
+    _cells.reserve(records.size());
+
+    // position of each place in _entries, so the last record wins if there
+    // are duplicate IDs
+    std::unordered_map<PlaceID, size_t> positions;
+    positions.reserve(records.size());
+
+    for (size_t i = 0; i < records.size(); ++i) {
+        Entry entry;
+        entry.cell = cellKey(records[i].coordinate);
+        entry.placeID = records[i].placeID;
+        entry.coordinate = records[i].coordinate;
+
+        std::unordered_map<PlaceID, size_t>::iterator found = positions.find(entry.placeID);
+        if (found != positions.end()) {
+            _entries[found->second] = entry;
+        } else {
+            positions[entry.placeID] = _entries.size();
+            _entries.push_back(entry);
+        }
+        _cells[entry.placeID] = entry.cell;
+    }
+    std::sort(_entries.begin(), _entries.end());
+}
+
+void SpatialIndex::insert(PlaceID placeID, const GeoPoint &coordinate)
+{
+    remove(placeID);
+
+    Entry entry;
+    entry.cell = cellKey(coordinate);
+    entry.placeID = placeID;
+    entry.coordinate = coordinate;
+
+    _entries.insert(std::upper_bound(_entries.begin(), _entries.end(), entry), entry);
+    _cells[placeID] = entry.cell;
+}
+
+bool SpatialIndex::remove(PlaceID placeID)
+{
+    std::unordered_map<PlaceID, uint64_t>::iterator found = _cells.find(placeID);
+    if (found == _cells.end()) return false;
+
+    Entry key;
+    key.cell = found->second;
+    key.placeID = placeID;
+    std::vector<Entry>::iterator it = std::lower_bound(_entries.begin(), _entries.end(), key);
+    if ((it != _entries.end()) && (it->placeID == placeID)) _entries.erase(it);
+
+    _cells.erase(found);
+    return true;
+}
+
+void SpatialIndex::clear()
+{
+    _entries.clear();
+    _cells.clear();
+}
+
+
+#pragma mark - Lookup
+bool SpatialIndex::coordinateOf(PlaceID placeID, GeoPoint *coordinate) const
+{
+    std::unordered_map<PlaceID, uint64_t>::const_iterator found = _cells.find(placeID);
+    if (found == _cells.end()) return false;
+
+    Entry key;
+    key.cell = found->second;
+    key.placeID = placeID;
+    std::vector<Entry>::const_iterator it = std::lower_bound(_entries.begin(), _entries.end(), key);
+    if (coordinate) *coordinate = it->coordinate;
+    return true;
+}
+
+std::vector<SpatialIndex::Record> SpatialIndex::records() const
+{
+    std::vector<Record> records;
+    records.reserve(_entries.size());
+    for (size_t i = 0; i < _entries.size(); ++i) {
+        records.push_back(Record(_entries[i].placeID, _entries[i].coordinate));
+    }
+    return records;
+}
+
+
+#pragma mark - Queries
+std::vector<SpatialIndex::Neighbor> SpatialIndex::within(const GeoPoint &origin, double radius) const
+{
+    std::vector<Neighbor> results;
+    _lastQueryVisits = 0;
+    if (_entries.empty() || (radius < 0)) return results;
+
+    collectWithin(origin, radius, results);
+    std::sort(results.begin(), results.end());
+    return results;
+}
+
+std::vector<SpatialIndex::Neighbor> SpatialIndex::nearest(const GeoPoint &origin, size_t k, double maxDistance) const
+{
+    std::vector<Neighbor> results;
+    _lastQueryVisits = 0;
+    if (_entries.empty() || (k == 0)) return results;
+
+    // Grow the search circle until it holds k places. Everything inside the
+    // circle is found exactly, so once it holds k places those are the k
+    // nearest.
+    double halfCircumference = M_PI * kEarthRadius;
+    double radius = std::min(kNearestInitialRadius, maxDistance);
+    while (true) {
+        results.clear();
+        collectWithin(origin, radius, results);
+        if ((results.size() >= k) || (radius >= maxDistance) || (radius >= halfCircumference)) break;
+        radius = std::min(radius * kNearestRadiusGrowth, maxDistance);
+    }
+
+    if (results.size() > k) {
+        std::partial_sort(results.begin(), results.begin() + k, results.end());
+        results.erase(results.begin() + k, results.end());
+    } else {
+        std::sort(results.begin(), results.end());
+    }
+    return results;
+}
+
+void SpatialIndex::collectWithin(const GeoPoint &origin, double radius, std::vector<Neighbor> &results) const
+{
+    // bounding box of the search circle
+    double deltaLatitude = (radius / kEarthRadius) * kRadiansToDegrees;
+    double minLatitude = std::max(-90.0, origin.latitude - deltaLatitude);
+    double maxLatitude = std::min(90.0, origin.latitude + deltaLatitude);
+
+    // longitude span grows towards the poles. Give up and take every longitude
+    // if the circle covers a pole.
+    // ref: http://janmatuschek.de/LatitudeLongitudeBoundingCoordinates
+    double deltaLongitude = 180.0;
+    if ((maxLatitude < 90.0) && (minLatitude > -90.0)) {
+        double ratio = std::sin(radius / kEarthRadius) / std::cos(origin.latitude * kDegreesToRadians);
+        if (ratio < 1.0) deltaLongitude = std::asin(ratio) * kRadiansToDegrees;
+    }
+
+    // split the longitude range where it crosses the antimeridian
+    double longitudeRanges[2][2];
+    int numLongitudeRanges = 0;
+    if (deltaLongitude >= 180.0) {
+        longitudeRanges[numLongitudeRanges][0] = -180.0;
+        longitudeRanges[numLongitudeRanges++][1] = 180.0;
+    } else {
+        double longitude = std::fmod(origin.longitude + 180.0, 360.0);
+        longitude = ((longitude < 0) ? longitude + 360.0 : longitude) - 180.0;
+        double west = longitude - deltaLongitude;
+        double east = longitude + deltaLongitude;
+        if (west < -180.0) {
+            longitudeRanges[numLongitudeRanges][0] = west + 360.0;
+            longitudeRanges[numLongitudeRanges++][1] = 180.0;
+            west = -180.0;
+        }
+        if (east >= 180.0) {
+            longitudeRanges[numLongitudeRanges][0] = -180.0;
+            longitudeRanges[numLongitudeRanges++][1] = east - 360.0;
+            east = 180.0;
+        }
+        longitudeRanges[numLongitudeRanges][0] = west;
+        longitudeRanges[numLongitudeRanges++][1] = east;
+    }
+
+    for (int r = 0; r < numLongitudeRanges; ++r) {
+        double west = longitudeRanges[r][0];
+        double east = longitudeRanges[r][1];
+
+        // pick a level where cells are at least half the box size, so the box
+        // is covered by at most 3x3 cells.
+        int level = std::min(levelForExtent(maxLatitude - minLatitude, 180.0),
+                             levelForExtent(east - west, 360.0));
+        level = std::min(kAxisBits, level + 1);
+        int shift = kAxisBits - level;
+
+        uint64_t firstRow = quantizeLatitude(minLatitude) >> shift;
+        uint64_t lastRow = quantizeLatitude(maxLatitude) >> shift;
+        uint64_t firstColumn = quantizeLongitude(west) >> shift;
+        uint64_t lastColumn = (east >= 180.0) ? (0xFFFFFFFFull >> shift) : (quantizeLongitude(east) >> shift);
+
+        int cellShift = 2 * shift;
+        for (uint64_t row = firstRow; row <= lastRow; ++row) {
+            for (uint64_t column = firstColumn; column <= lastColumn; ++column) {
+                uint64_t prefix = interleave((uint32_t)row, (uint32_t)column);
+                uint64_t first = (cellShift >= 64) ? 0 : (prefix << cellShift);
+                uint64_t last = (cellShift >= 64) ? ~0ull : (first | ((1ull << cellShift) - 1));
+                collectCellRange(first, last, origin, radius, results);
+            }
+        }
+    }
+}
+
+void SpatialIndex::collectCellRange(uint64_t first, uint64_t last, const GeoPoint &origin, double radius,
+                                  std::vector<Neighbor> &results) const
+{
+    Entry key;
+    key.cell = first;
+    key.placeID = 0;
+
+    for (std::vector<Entry>::const_iterator it = std::lower_bound(_entries.begin(), _entries.end(), key);
+         (it != _entries.end()) && (it->cell <= last); ++it) {
+        ++_lastQueryVisits;
+        double distance = distanceBetween(origin, it->coordinate);
+        if (distance <= radius) results.push_back(Neighbor(it->placeID, distance));
+    }
+}
+
+
+#pragma mark - Serialization
+void SpatialIndex::write(std::ostream &output) const
+{
+    uint64_t count = _entries.size();
+    output.write((const char *)&kIndexFileMagic, sizeof(kIndexFileMagic));
+    output.write((const char *)&kIndexFileVersion, sizeof(kIndexFileVersion));
+    output.write((const char *)&count, sizeof(count));
+
+    for (size_t i = 0; i < _entries.size(); ++i) {
+        output.write((const char *)&_entries[i].placeID, sizeof(PlaceID));
+        output.write((const char *)&_entries[i].coordinate.latitude, sizeof(double));
+        output.write((const char *)&_entries[i].coordinate.longitude, sizeof(double));
+    }
+}
+
+bool SpatialIndex::read(std::istream &input)
+{
+    uint32_t magic = 0, version = 0;
+    uint64_t count = 0;
+    input.read((char *)&magic, sizeof(magic));
+    input.read((char *)&version, sizeof(version));
+    input.read((char *)&count, sizeof(count));
+    if (!input || (magic != kIndexFileMagic) || (version != kIndexFileVersion)) return false;
+
+    std::vector<Record> records;
+    for (uint64_t i = 0; i < count; ++i) {
+        Record record;
+        input.read((char *)&record.placeID, sizeof(PlaceID));
+        input.read((char *)&record.coordinate.latitude, sizeof(double));
+        input.read((char *)&record.coordinate.longitude, sizeof(double));
+        if (!input) return false;
+        records.push_back(record);
+    }
+
+    assign(records);
+    return true;
+}
+
+} // namespace rtc
@@ -0,0 +1,151 @@
+//
+//  RTCSpatialIndex.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/10/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCSpatialIndex_h
+#define Retrac_RTCSpatialIndex_h
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "RTCGeo.h"
+
+namespace rtc {
+
+/**
+ * SpatialIndex is an index over saved places answering k-nearest and
+ * within-radius queries.
+ *
+ * Coordinates are quantized to 32 bits per axis and interleaved into a 64-bit
+ * Z-order (Morton) cell key, and entries are kept in a vector sorted by that
+ * key. Any cell at any level is then a contiguous range of the vector, so a
+ * query covers its bounding box with a handful of cells at a suitable level and
+ * binary searches each one. Query cost is O(log n + number of places near the
+ * query), independent of how many places are saved elsewhere.
+ *
+ * Place IDs are opaque to the index; the owner maps them back to its records.
+ */
+class SpatialIndex {
+public:
+    typedef uint64_t PlaceID;
+
+    /**
+     * A query result: a place and its distance (meters) from the query origin
+     */
+    struct Neighbor {
+        PlaceID placeID;
+        double distance;
+
+        Neighbor(PlaceID anID, double aDistance) : placeID(anID), distance(aDistance) {}
+        bool operator<(const Neighbor &other) const {
+            return (distance < other.distance) ||
+                   ((distance == other.distance) && (placeID < other.placeID));
+        }
+    };
+
+    /**
+     * A place and its coordinate, used for bulk loading and enumeration
+     */
+    struct Record {
+        PlaceID placeID;
+        GeoPoint coordinate;
+
+        Record() : placeID(0) {}
+        Record(PlaceID anID, const GeoPoint &aCoordinate) : placeID(anID), coordinate(aCoordinate) {}
+    };
+
+    SpatialIndex() : _lastQueryVisits(0) {}
+
+    /**
+     * Replace the contents of the index. A single sort, so use this when
+     * rebuilding rather than calling insert() n times.
+     */
+    void assign(const std::vector<Record> &records);
+
+    /**
+     * Insert a place, or move it if it is already indexed.
+     */
+    void insert(PlaceID placeID, const GeoPoint &coordinate);
+
+    /**
+     * Remove a place.
+     *
+     * @return false if the place wasn't indexed.
+     */
+    bool remove(PlaceID placeID);
+
+    void clear();
+
+    size_t size() const { return _entries.size(); }
+    bool contains(PlaceID placeID) const { return _cells.count(placeID) > 0; }
+
+    /**
+     * Get the coordinate of an indexed place.
+     *
+     * @return false if the place isn't indexed.
+     */
+    bool coordinateOf(PlaceID placeID, GeoPoint *coordinate) const;
+
+    /**
+     * All indexed places, in index (Z-order) order
+     */
+    std::vector<Record> records() const;
+
+    /**
+     * The k places closest to origin, nearest first.
+     *
+     * @param maxDistance   ignore places further than this (meters)
+     */
+    std::vector<Neighbor> nearest(const GeoPoint &origin, size_t k,
+                                  double maxDistance = 2.0 * M_PI * kEarthRadius) const;
+
+    /**
+     * All places within radius (meters) of origin, nearest first.
+     */
+    std::vector<Neighbor> within(const GeoPoint &origin, double radius) const;
+
+    /**
+     * Number of index entries examined by the most recent query. Handy for
+     * checking that queries don't degrade into scans.
+     */
+    size_t lastQueryVisits() const { return _lastQueryVisits; }
+
+    /**
+     * Binary serialization.
+     *
+     * @return false if the stream is short or not a place index.
+     */
+    void write(std::ostream &output) const;
+    bool read(std::istream &input);
+
+private:
+    struct Entry {
+        uint64_t cell;
+        PlaceID placeID;
+        GeoPoint coordinate;
+
+        bool operator<(const Entry &other) const {
+            return (cell < other.cell) || ((cell == other.cell) && (placeID < other.placeID));
+        }
+    };
+
+    void collectWithin(const GeoPoint &origin, double radius, std::vector<Neighbor> &results) const;
+    void collectCellRange(uint64_t first, uint64_t last, const GeoPoint &origin, double radius,
+                          std::vector<Neighbor> &results) const;
+
+    std::vector<Entry> _entries;                    // sorted by (cell, placeID)
+    std::unordered_map<PlaceID, uint64_t> _cells;   // placeID -> cell key
+    mutable size_t _lastQueryVisits;
+};
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,289 @@
+//
+//  RTCTableDiff.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/18/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCTableDiff.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace rtc {
+
+#pragma mark - Constants
+// marks a section or row with no counterpart in the other snapshot
+static const size_t kNone = (size_t)-1;
+
+
+#pragma mark - TableSnapshot
+void TableSnapshot::appendSection(Key sectionKey)
+{
+    _sectionKeys.push_back(sectionKey);
+    _sectionStarts.push_back(_rowKeys.size());
+}
+
+void TableSnapshot::appendRow(Key rowKey)
+{
+    // rows before any section go in an unnamed first one
+    if (_sectionKeys.empty()) appendSection(0);
+    _rowKeys.push_back(rowKey);
+    _sectionStarts.back() = _rowKeys.size();
+}
+
+void TableSnapshot::clear()
+{
+    _sectionKeys.clear();
+    _rowKeys.clear();
+    _sectionStarts.assign(1, 0);
+}
+
+void TableSnapshot::swap(TableSnapshot &other)
+{
+    _sectionKeys.swap(other._sectionKeys);
+    _rowKeys.swap(other._rowKeys);
+    _sectionStarts.swap(other._sectionStarts);
+}
+
+
+#pragma mark - Helpers
+/**
+ * Section of every row, numbered through the table
+ */
+static std::vector<size_t> rowSections(const TableSnapshot &snapshot)
+{
+    std::vector<size_t> sections(snapshot.numRows());
+    for (size_t s = 0; s < snapshot.numSections(); ++s) {
+        size_t end = snapshot.sectionStart(s) + snapshot.numRowsInSection(s);
+        for (size_t i = snapshot.sectionStart(s); i < end; ++i) sections[i] = s;
+    }
+    return sections;
+}
+
+static TableDiff reloadAllDiff()
+{
+    TableDiff diff;
+    diff.reloadAll = true;
+    return diff;
+}
+
+
+#pragma mark - Public
+std::vector<size_t> longestIncreasingSubsequence(const std::vector<size_t> &values)
+{
+    // patience sorting: tails[k] is the index of the smallest value ending an
+    // increasing subsequence of length k + 1, previous[] links each value back
+    // to the one before it in its subsequence
+    std::vector<size_t> tails, previous(values.size(), kNone);
+    for (size_t i = 0; i < values.size(); ++i) {
+        size_t low = 0, high = tails.size();
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            if (values[tails[middle]] < values[i]) low = middle + 1;
+            else high = middle;
+        }
+        if (low > 0) previous[i] = tails[low - 1];
+        if (low == tails.size()) tails.push_back(i);
+        else tails[low] = i;
+    }
+
+    std::vector<size_t> subsequence(tails.size());
+    size_t i = tails.empty() ? kNone : tails.back();
+    for (size_t k = subsequence.size(); k > 0; --k) {
+        subsequence[k - 1] = i;
+        i = previous[i];
+    }
+    return subsequence;
+}
+
+bool applyTableChanges(const TableSnapshot &oldSnapshot, const TableChanges &changes, TableSnapshot *newSnapshot)
+{
+    newSnapshot->clear();
+
+    // what's left of the old table
+    std::vector<bool> sectionDeleted(oldSnapshot.numSections(), false);
+    for (size_t i = 0; i < changes.deletedSections.size(); ++i) {
+        if (changes.deletedSections[i] >= oldSnapshot.numSections()) return false;
+        sectionDeleted[changes.deletedSections[i]] = true;
+    }
+    std::vector<bool> rowDeleted(oldSnapshot.numRows(), false);
+    for (size_t i = 0; i < changes.deletedRows.size(); ++i) {
+        const TablePath &path = changes.deletedRows[i];
+        if ((path.section >= oldSnapshot.numSections()) || (path.row >= oldSnapshot.numRowsInSection(path.section))) {
+            return false;
+        }
+        rowDeleted[oldSnapshot.sectionStart(path.section) + path.row] = true;
+    }
+
+    // insertions in the order they are reached
+    std::vector<std::pair<size_t, TableSnapshot::Key> > insertedSections(changes.insertedSections);
+    std::sort(insertedSections.begin(), insertedSections.end());
+    std::vector<std::pair<TablePath, TableSnapshot::Key> > insertedRows(changes.insertedRows);
+    std::sort(insertedRows.begin(), insertedRows.end());
+
+    // new sections, each the old section it was or kNone if inserted
+    std::vector<std::pair<TableSnapshot::Key, size_t> > sections;
+    size_t oldSection = 0, nextSection = 0;
+    for (;;) {
+        while ((oldSection < oldSnapshot.numSections()) && sectionDeleted[oldSection]) ++oldSection;
+        if ((nextSection < insertedSections.size()) && (insertedSections[nextSection].first == sections.size())) {
+            sections.push_back(std::make_pair(insertedSections[nextSection++].second, kNone));
+        } else if (oldSection < oldSnapshot.numSections()) {
+            sections.push_back(std::make_pair(oldSnapshot.sectionKey(oldSection), oldSection));
+            ++oldSection;
+        } else {
+            break;
+        }
+    }
+
+    // and their rows, merged the same way
+    size_t nextRow = 0;
+    for (size_t t = 0; (t < sections.size()) && (nextSection == insertedSections.size()); ++t) {
+        if ((nextRow < insertedRows.size()) && (insertedRows[nextRow].first.section < t)) break;
+        newSnapshot->appendSection(sections[t].first);
+
+        size_t oldRow = 0, end = 0, row = 0;
+        if (sections[t].second != kNone) {
+            oldRow = oldSnapshot.sectionStart(sections[t].second);
+            end = oldRow + oldSnapshot.numRowsInSection(sections[t].second);
+        }
+        for (;; ++row) {
+            while ((oldRow < end) && rowDeleted[oldRow]) ++oldRow;
+            if ((nextRow < insertedRows.size()) && (insertedRows[nextRow].first == TablePath(t, row))) {
+                newSnapshot->appendRow(insertedRows[nextRow++].second);
+            } else if (oldRow < end) {
+                newSnapshot->appendRow(oldSnapshot.rowKeyAt(oldRow++));
+            } else {
+                break;
+            }
+        }
+    }
+
+    // an insertion past the end of its section or the table never got reached
+    if ((nextSection < insertedSections.size()) || (nextRow < insertedRows.size())) {
+        newSnapshot->clear();
+        return false;
+    }
+    return true;
+}
+
+TableDiff diffTables(const TableSnapshot &oldSnapshot, const TableSnapshot &newSnapshot,
+                     const std::unordered_set<TableSnapshot::Key> &updatedRows, size_t maxChanges)
+{
+    typedef TableSnapshot::Key Key;
+    TableDiff diff;
+
+    // sections: match by key, keep the longest in-order run of matches
+    std::unordered_map<Key, size_t> oldSectionIndex;
+    oldSectionIndex.reserve(oldSnapshot.numSections());
+    for (size_t s = 0; s < oldSnapshot.numSections(); ++s) {
+        if (!oldSectionIndex.insert(std::make_pair(oldSnapshot.sectionKey(s), s)).second) return reloadAllDiff();
+    }
+
+    std::vector<size_t> matchedSections, matchedOldSections;
+    std::vector<bool> oldSectionSeen(oldSnapshot.numSections(), false);
+    for (size_t t = 0; t < newSnapshot.numSections(); ++t) {
+        std::unordered_map<Key, size_t>::const_iterator found = oldSectionIndex.find(newSnapshot.sectionKey(t));
+        if (found == oldSectionIndex.end()) continue;
+        if (oldSectionSeen[found->second]) return reloadAllDiff();
+        oldSectionSeen[found->second] = true;
+        matchedSections.push_back(t);
+        matchedOldSections.push_back(found->second);
+    }
+
+    std::vector<size_t> oldToNewSection(oldSnapshot.numSections(), kNone);
+    std::vector<size_t> kept = longestIncreasingSubsequence(matchedOldSections);
+    for (size_t k = 0; k < kept.size(); ++k) oldToNewSection[matchedOldSections[kept[k]]] = matchedSections[kept[k]];
+
+    std::vector<bool> newSectionKept(newSnapshot.numSections(), false);
+    for (size_t s = 0; s < oldSnapshot.numSections(); ++s) {
+        if (oldToNewSection[s] == kNone) diff.deletedSections.push_back(s);
+        else newSectionKept[oldToNewSection[s]] = true;
+    }
+    for (size_t t = 0; t < newSnapshot.numSections(); ++t) {
+        if (!newSectionKept[t]) diff.insertedSections.push_back(t);
+    }
+
+    // rows: match by key across the whole table
+    std::unordered_map<Key, size_t> oldRowIndex;
+    oldRowIndex.reserve(oldSnapshot.numRows());
+    for (size_t i = 0; i < oldSnapshot.numRows(); ++i) {
+        if (!oldRowIndex.insert(std::make_pair(oldSnapshot.rowKeyAt(i), i)).second) return reloadAllDiff();
+    }
+
+    std::vector<size_t> oldSections = rowSections(oldSnapshot), newSections = rowSections(newSnapshot);
+    std::vector<size_t> oldToNewRow(oldSnapshot.numRows(), kNone);
+    std::vector<size_t> inPlaceRows, inPlaceOldRows;        // candidates for staying put, in new order
+    std::vector<std::pair<size_t, size_t> > moves;          // (old row, new row)
+
+    for (size_t j = 0; j < newSnapshot.numRows(); ++j) {
+        std::unordered_map<Key, size_t>::const_iterator found = oldRowIndex.find(newSnapshot.rowKeyAt(j));
+        size_t i = (found == oldRowIndex.end()) ? kNone : found->second;
+        if (i != kNone) {
+            if (oldToNewRow[i] != kNone) return reloadAllDiff();
+            oldToNewRow[i] = j;
+        }
+
+        // rows of an inserted section come with it
+        size_t t = newSections[j];
+        if (!newSectionKept[t]) continue;
+
+        // new here, or its old section is going away (rows can't move out of
+        // a deleted section)
+        if ((i == kNone) || (oldToNewSection[oldSections[i]] == kNone)) {
+            diff.insertedRows.push_back(TablePath(t, j - newSnapshot.sectionStart(t)));
+        } else if (oldToNewSection[oldSections[i]] == t) {
+            inPlaceRows.push_back(j);
+            inPlaceOldRows.push_back(i);
+        } else {
+            moves.push_back(std::make_pair(i, j));
+        }
+    }
+
+    for (size_t i = 0; i < oldSnapshot.numRows(); ++i) {
+        // rows of a deleted section go with it
+        size_t s = oldSections[i];
+        if (oldToNewSection[s] == kNone) continue;
+        if ((oldToNewRow[i] == kNone) || !newSectionKept[newSections[oldToNewRow[i]]]) {
+            diff.deletedRows.push_back(TablePath(s, i - oldSnapshot.sectionStart(s)));
+        }
+    }
+
+    // of the rows that stayed in their section, the longest run still in
+    // order stays put; the rest move
+    std::vector<bool> inPlace(oldSnapshot.numRows(), false);
+    std::vector<size_t> stay = longestIncreasingSubsequence(inPlaceOldRows);
+    for (size_t k = 0; k < stay.size(); ++k) inPlace[inPlaceOldRows[stay[k]]] = true;
+    for (size_t k = 0; k < inPlaceRows.size(); ++k) {
+        if (!inPlace[inPlaceOldRows[k]]) moves.push_back(std::make_pair(inPlaceOldRows[k], inPlaceRows[k]));
+    }
+
+    for (size_t k = 0; k < moves.size(); ++k) {
+        size_t i = moves[k].first, j = moves[k].second;
+        TablePath from(oldSections[i], i - oldSnapshot.sectionStart(oldSections[i]));
+        TablePath to(newSections[j], j - newSnapshot.sectionStart(newSections[j]));
+        if (updatedRows.count(oldSnapshot.rowKeyAt(i))) {
+            diff.deletedRows.push_back(from);
+            diff.insertedRows.push_back(to);
+        } else {
+            diff.movedRows.push_back(std::make_pair(from, to));
+        }
+    }
+
+    for (std::unordered_set<Key>::const_iterator key = updatedRows.begin(); key != updatedRows.end(); ++key) {
+        std::unordered_map<Key, size_t>::const_iterator found = oldRowIndex.find(*key);
+        if ((found == oldRowIndex.end()) || !inPlace[found->second]) continue;
+        size_t i = found->second;
+        diff.reloadedRows.push_back(TablePath(oldSections[i], i - oldSnapshot.sectionStart(oldSections[i])));
+    }
+
+    if (diff.numChanges() > maxChanges) return reloadAllDiff();
+
+    std::sort(diff.deletedRows.begin(), diff.deletedRows.end());
+    std::sort(diff.insertedRows.begin(), diff.insertedRows.end());
+    std::sort(diff.reloadedRows.begin(), diff.reloadedRows.end());
+    return diff;
+}
+
+} // namespace rtc
@@ -0,0 +1,173 @@
+//
+//  RTCTableDiff.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/18/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/UIKit here so this can be
+//  compiled and exercised headlessly.
+
+#ifndef Retrac_RTCTableDiff_h
+#define Retrac_RTCTableDiff_h
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace rtc {
+
+/**
+ * TableSnapshot is the contents of a sectioned table: an ordered list of
+ * sections, each an ordered list of rows, all identified by opaque keys.
+ *
+ * Section keys must be unique among sections and row keys unique among all
+ * rows of the table.
+ */
+class TableSnapshot {
+public:
+    typedef uint64_t Key;
+
+    TableSnapshot() : _sectionStarts(1, 0) {}
+
+    /**
+     * Start a new section. Rows appended after this go into it.
+     */
+    void appendSection(Key sectionKey);
+
+    /**
+     * Add a row to the end of the last section, starting a section keyed 0 if
+     * there is none yet.
+     */
+    void appendRow(Key rowKey);
+
+    void clear();
+    void swap(TableSnapshot &other);
+
+    size_t numSections() const { return _sectionKeys.size(); }
+    size_t numRows() const { return _rowKeys.size(); }
+    size_t numRowsInSection(size_t section) const { return _sectionStarts[section + 1] - _sectionStarts[section]; }
+
+    Key sectionKey(size_t section) const { return _sectionKeys[section]; }
+    Key rowKey(size_t section, size_t row) const { return _rowKeys[_sectionStarts[section] + row]; }
+
+    /**
+     * Rows numbered through the whole table, section after section
+     */
+    size_t sectionStart(size_t section) const { return _sectionStarts[section]; }
+    Key rowKeyAt(size_t index) const { return _rowKeys[index]; }
+
+private:
+    std::vector<Key> _sectionKeys;
+    std::vector<Key> _rowKeys;              // all rows, section after section
+    std::vector<size_t> _sectionStarts;     // index of each section's first row, then numRows()
+};
+
+/**
+ * A row of a table: a section index and a row index within that section
+ */
+struct TablePath {
+    size_t section, row;
+
+    TablePath() : section(0), row(0) {}
+    TablePath(size_t aSection, size_t aRow) : section(aSection), row(aRow) {}
+    bool operator==(const TablePath &other) const { return (section == other.section) && (row == other.row); }
+    bool operator<(const TablePath &other) const {
+        return (section < other.section) || ((section == other.section) && (row < other.row));
+    }
+};
+
+/**
+ * TableDiff is the batch of table view updates that takes a table from one
+ * snapshot to another, in UITableView's batch update terms: deletions and
+ * reloads are at old positions, insertions at new positions and moves from
+ * old to new.
+ */
+struct TableDiff {
+    std::vector<size_t> deletedSections;
+    std::vector<size_t> insertedSections;
+    std::vector<TablePath> deletedRows;
+    std::vector<TablePath> insertedRows;
+    std::vector<TablePath> reloadedRows;
+    std::vector<std::pair<TablePath, TablePath> > movedRows;
+
+    // too many changes to be worth animating; reload the whole table instead.
+    // The lists above are left empty.
+    bool reloadAll;
+
+    TableDiff() : reloadAll(false) {}
+
+    /**
+     * Number of section and row updates in the batch
+     */
+    size_t numChanges() const {
+        return deletedSections.size() + insertedSections.size() + deletedRows.size() +
+               insertedRows.size() + reloadedRows.size() + movedRows.size();
+    }
+
+    bool empty() const { return !reloadAll && (numChanges() == 0); }
+};
+
+/**
+ * TableChanges is a batch of changes to a table as NSFetchedResultsController
+ * reports them: deletions at old positions, insertions at new positions with
+ * the key the new section or row goes by, and a move as a deletion and an
+ * insertion of the same key.
+ */
+struct TableChanges {
+    std::vector<size_t> deletedSections;
+    std::vector<std::pair<size_t, TableSnapshot::Key> > insertedSections;
+    std::vector<TablePath> deletedRows;
+    std::vector<std::pair<TablePath, TableSnapshot::Key> > insertedRows;
+
+    void clear() {
+        deletedSections.clear();
+        insertedSections.clear();
+        deletedRows.clear();
+        insertedRows.clear();
+    }
+};
+
+/**
+ * Make a batch of changes to oldSnapshot, so the table after them can be had
+ * without reading what's in it: what's left of the old sections and rows
+ * keeps its order, and insertions go in at their new positions. Rows of a
+ * deleted section go with it. O(rows + changes log changes).
+ *
+ * @return false, with newSnapshot cleared, if a change doesn't fit the table,
+ *      which is then best read afresh.
+ */
+bool applyTableChanges(const TableSnapshot &oldSnapshot, const TableChanges &changes, TableSnapshot *newSnapshot);
+
+/**
+ * Work out the smallest batch of updates taking a table from oldSnapshot to
+ * newSnapshot.
+ *
+ * Rows and sections are matched by key, Heckel style, through a table of keys
+ * seen in each snapshot; unique keys make that match exact. Of the matched
+ * rows, the longest run that kept its relative order stays put and the rest
+ * move, which gives the fewest moves possible. Sections are treated the same
+ * way except that an out-of-order section is deleted and reinserted. O(n log n)
+ * in the number of rows.
+ *
+ * @param updatedRows   keys of rows whose contents changed. Those that stay
+ *                      put are reloaded; those that move are deleted and
+ *                      reinserted, since a move alone wouldn't redraw them.
+ * @param maxChanges    if the batch would hold more updates than this, or a
+ *                      snapshot has duplicate keys, return a diff with
+ *                      reloadAll set instead
+ */
+TableDiff diffTables(const TableSnapshot &oldSnapshot, const TableSnapshot &newSnapshot,
+                     const std::unordered_set<TableSnapshot::Key> &updatedRows, size_t maxChanges);
+
+/**
+ * Indices of a longest strictly increasing subsequence of values, in order.
+ * Exposed for testing.
+ */
+std::vector<size_t> longestIncreasingSubsequence(const std::vector<size_t> &values);
+
+} // namespace rtc
+
+#endif
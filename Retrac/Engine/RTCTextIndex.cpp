@@ -0,0 +1,327 @@
+//
+//  RTCTextIndex.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/27/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCTextIndex.h"
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace rtc {
+
+#pragma mark - Constants
+static const uint32_t kTextIndexFileMagic = 0x54435452; // "RTCT"
+static const uint32_t kTextIndexFileVersion = 1;
+
+// longest name, address or word read back from a file; anything longer means
+// the file is damaged
+static const uint32_t kMaxTextLength = 1 << 16;
+
+// query words past this many are ignored, so match counts fit a byte
+static const size_t kMaxQueryWords = 255;
+
+
+#pragma mark - Helpers
+static bool isSeparator(unsigned char c)
+{
+    return (c < 0x80) && !(((c >= '0') && (c <= '9')) || ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')));
+}
+
+static std::vector<std::string> uniqueWords(const std::string &text)
+{
+    std::vector<std::string> words = TextIndex::tokenize(text);
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+static bool hasPrefix(const std::string &word, const std::string &prefix)
+{
+    return word.compare(0, prefix.size(), prefix) == 0;
+}
+
+static void writeString(std::ostream &output, const std::string &text)
+{
+    uint32_t length = (uint32_t)text.size();
+    output.write((const char *)&length, sizeof(length));
+    output.write(text.data(), length);
+}
+
+static bool readString(std::istream &input, std::string *text)
+{
+    uint32_t length = 0;
+    input.read((char *)&length, sizeof(length));
+    if (!input || (length > kMaxTextLength)) return false;
+    text->resize(length);
+    if (length) input.read(&(*text)[0], length);
+    return (bool)input;
+}
+
+
+#pragma mark - TextIndex
+std::vector<std::string> TextIndex::tokenize(const std::string &text)
+{
+    std::vector<std::string> words;
+    std::string word;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        unsigned char c = (i < text.size()) ? (unsigned char)text[i] : ' ';
+        if (isSeparator(c)) {
+            if (!word.empty()) words.push_back(word);
+            word.clear();
+        } else {
+            word += ((c >= 'A') && (c <= 'Z')) ? (char)(c - 'A' + 'a') : (char)c;
+        }
+    }
+    return words;
+}
+
+void TextIndex::insert(PlaceID placeID, const std::string &name, const std::string &address)
+{
+    std::unordered_map<PlaceID, Slot>::iterator it = _slots.find(placeID);
+    Slot slot;
+    if (it != _slots.end()) {
+        slot = it->second;
+        const Document &document = _documents[slot];
+        if ((document.name == name) && (document.address == address)) return;
+        removePostings(slot);
+    } else if (!_freeSlots.empty()) {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+        _slots[placeID] = slot;
+    } else {
+        slot = (Slot)_documents.size();
+        _documents.push_back(Document());
+        _placeIDs.push_back(0);
+        _slots[placeID] = slot;
+    }
+
+    Document &document = _documents[slot];
+    _placeIDs[slot] = placeID;
+    document.name = name;
+    document.address = address;
+    document.live = true;
+    addPostings(slot);
+}
+
+bool TextIndex::remove(PlaceID placeID)
+{
+    std::unordered_map<PlaceID, Slot>::iterator it = _slots.find(placeID);
+    if (it == _slots.end()) return false;
+
+    Slot slot = it->second;
+    removePostings(slot);
+    Document &document = _documents[slot];
+    document.live = false;
+    document.name.clear();
+    document.address.clear();
+    _freeSlots.push_back(slot);
+    _slots.erase(it);
+    return true;
+}
+
+bool TextIndex::textOf(PlaceID placeID, std::string *name, std::string *address) const
+{
+    std::unordered_map<PlaceID, Slot>::const_iterator it = _slots.find(placeID);
+    if (it == _slots.end()) return false;
+    if (name) *name = _documents[it->second].name;
+    if (address) *address = _documents[it->second].address;
+    return true;
+}
+
+void TextIndex::clear()
+{
+    _documents.clear();
+    _placeIDs.clear();
+    _freeSlots.clear();
+    _slots.clear();
+    _postings.clear();
+}
+
+std::vector<TextIndex::PlaceID> TextIndex::search(const std::string &query, size_t maxResults) const
+{
+    std::vector<PlaceID> results;
+    std::vector<std::string> words = tokenize(query);
+    if (words.empty() || !maxResults) return results;
+    if (words.size() > kMaxQueryWords) words.resize(kMaxQueryWords);
+
+    // how many words so far each place has matched, anywhere and in its name
+    std::vector<unsigned char> matched(_documents.size(), 0);
+    std::vector<unsigned char> matchedInName(_documents.size(), 0);
+    for (size_t i = 0; i < words.size(); ++i) {
+        size_t numMatched = 0;
+        for (std::map<std::string, std::vector<Posting> >::const_iterator it = _postings.lower_bound(words[i]);
+             (it != _postings.end()) && hasPrefix(it->first, words[i]); ++it) {
+            const std::vector<Posting> &postings = it->second;
+            for (size_t p = 0; p < postings.size(); ++p) {
+                Slot slot = postings[p] >> 1;
+                if (matched[slot] == i) {
+                    matched[slot] = (unsigned char)(i + 1);
+                    ++numMatched;
+                }
+                if ((postings[p] & 1) && (matchedInName[slot] == i)) matchedInName[slot] = (unsigned char)(i + 1);
+            }
+        }
+        if (!numMatched) return results;
+    }
+
+    // name matches rank above address matches, then newer above older. keep
+    //   the best maxResults in a min-heap rather than sorting every match;
+    //   slots mostly follow IDs, so going newest first most matches are
+    //   turned away without touching the heap.
+    typedef std::pair<bool, PlaceID> Rank;
+    std::vector<Rank> best;
+    best.reserve(std::min(maxResults, _documents.size()) + 1);
+    for (Slot slot = (Slot)matched.size(); slot-- > 0; ) {
+        if (matched[slot] != words.size()) continue;
+        Rank rank(matchedInName[slot] == words.size(), _placeIDs[slot]);
+        if ((best.size() == maxResults) && !(best.front() < rank)) continue;
+
+        best.push_back(rank);
+        std::push_heap(best.begin(), best.end(), std::greater<Rank>());
+        if (best.size() > maxResults) {
+            std::pop_heap(best.begin(), best.end(), std::greater<Rank>());
+            best.pop_back();
+        }
+    }
+    std::sort_heap(best.begin(), best.end(), std::greater<Rank>());
+
+    results.reserve(best.size());
+    for (size_t i = 0; i < best.size(); ++i) results.push_back(best[i].second);
+    return results;
+}
+
+/**
+ * Add the words of the document in slot to the term dictionary
+ */
+void TextIndex::addPostings(Slot slot)
+{
+    const Document &document = _documents[slot];
+    std::vector<std::string> nameWords = uniqueWords(document.name);
+    std::vector<std::string> addressWords = uniqueWords(document.address);
+
+    for (size_t i = 0; i < nameWords.size(); ++i) _postings[nameWords[i]].push_back((slot << 1) | 1);
+    for (size_t i = 0; i < addressWords.size(); ++i) {
+        // a word in both counts as a name word
+        if (std::binary_search(nameWords.begin(), nameWords.end(), addressWords[i])) continue;
+        _postings[addressWords[i]].push_back(slot << 1);
+    }
+}
+
+/**
+ * Take the words of the document in slot out of the term dictionary
+ */
+void TextIndex::removePostings(Slot slot)
+{
+    const Document &document = _documents[slot];
+    std::vector<std::string> words = uniqueWords(document.name + " " + document.address);
+    for (size_t i = 0; i < words.size(); ++i) {
+        std::map<std::string, std::vector<Posting> >::iterator it = _postings.find(words[i]);
+        if (it == _postings.end()) continue;
+
+        std::vector<Posting> &postings = it->second;
+        for (size_t p = 0; p < postings.size(); ++p) {
+            if ((postings[p] >> 1) != slot) continue;
+            // order within a term doesn't matter
+            postings[p] = postings.back();
+            postings.pop_back();
+            break;
+        }
+        if (postings.empty()) _postings.erase(it);
+    }
+}
+
+void TextIndex::write(std::ostream &output) const
+{
+    // live documents only, renumbered from 0
+    std::vector<Slot> newSlots(_documents.size(), 0);
+    uint64_t numDocuments = 0;
+    for (Slot slot = 0; slot < _documents.size(); ++slot) {
+        if (_documents[slot].live) newSlots[slot] = (Slot)numDocuments++;
+    }
+
+    uint64_t numTerms = _postings.size();
+    output.write((const char *)&kTextIndexFileMagic, sizeof(kTextIndexFileMagic));
+    output.write((const char *)&kTextIndexFileVersion, sizeof(kTextIndexFileVersion));
+    output.write((const char *)&numDocuments, sizeof(numDocuments));
+    output.write((const char *)&numTerms, sizeof(numTerms));
+
+    for (Slot slot = 0; slot < _documents.size(); ++slot) {
+        const Document &document = _documents[slot];
+        if (!document.live) continue;
+        output.write((const char *)&_placeIDs[slot], sizeof(PlaceID));
+        writeString(output, document.name);
+        writeString(output, document.address);
+    }
+
+    // in dictionary order, so reading appends
+    for (std::map<std::string, std::vector<Posting> >::const_iterator it = _postings.begin(); it != _postings.end(); ++it) {
+        writeString(output, it->first);
+        uint32_t numPostings = (uint32_t)it->second.size();
+        output.write((const char *)&numPostings, sizeof(numPostings));
+        for (size_t p = 0; p < it->second.size(); ++p) {
+            Posting posting = (newSlots[it->second[p] >> 1] << 1) | (it->second[p] & 1);
+            output.write((const char *)&posting, sizeof(posting));
+        }
+    }
+}
+
+bool TextIndex::read(std::istream &input)
+{
+    clear();
+
+    uint32_t magic = 0, version = 0;
+    uint64_t numDocuments = 0, numTerms = 0;
+    input.read((char *)&magic, sizeof(magic));
+    input.read((char *)&version, sizeof(version));
+    input.read((char *)&numDocuments, sizeof(numDocuments));
+    input.read((char *)&numTerms, sizeof(numTerms));
+    if (!input || (magic != kTextIndexFileMagic) || (version != kTextIndexFileVersion) ||
+        (numDocuments >= (1u << 31))) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < numDocuments; ++i) {
+        PlaceID placeID = 0;
+        Document document;
+        document.live = true;
+        input.read((char *)&placeID, sizeof(PlaceID));
+        if (!input || !readString(input, &document.name) || !readString(input, &document.address) ||
+            _slots.count(placeID)) {
+            clear();
+            return false;
+        }
+        _slots[placeID] = (Slot)_documents.size();
+        _documents.push_back(document);
+        _placeIDs.push_back(placeID);
+    }
+
+    std::string previous;
+    for (uint64_t i = 0; i < numTerms; ++i) {
+        std::string term;
+        uint32_t numPostings = 0;
+        if (!readString(input, &term)) break;
+        input.read((char *)&numPostings, sizeof(numPostings));
+        if (!input || term.empty() || (i && (term <= previous)) || (numPostings > numDocuments)) break;
+
+        std::vector<Posting> postings(numPostings);
+        if (numPostings) input.read((char *)&postings[0], numPostings * sizeof(Posting));
+        if (!input) break;
+        bool valid = true;
+        for (size_t p = 0; valid && (p < postings.size()); ++p) valid = ((postings[p] >> 1) < numDocuments);
+        if (!valid) break;
+
+        _postings.insert(_postings.end(), std::make_pair(term, postings));
+        previous.swap(term);
+    }
+    if (_postings.size() != numTerms) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+} // namespace rtc
@@ -0,0 +1,123 @@
+//
+//  RTCTextIndex.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/27/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCTextIndex_h
+#define Retrac_RTCTextIndex_h
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rtc {
+
+/**
+ * TextIndex finds saved places by the words in their name and address, for
+ * search as you type: every word of the query matches the start of some word
+ * of the place, so "star coff" finds "Starbucks Coffee".
+ *
+ * Words are kept in a sorted term dictionary, each with the places it occurs
+ * in, so all the words starting with a prefix are one contiguous range. A
+ * query walks the range for each of its words and counts matches per place in
+ * a flat array; cost is the number of postings under the query's prefixes,
+ * not the number of places.
+ *
+ * Words are split on ASCII punctuation and spaces and ASCII letters are
+ * lowercased. Other UTF-8 text is matched byte for byte.
+ *
+ * Place IDs are opaque to the index; the owner maps them back to its records.
+ */
+class TextIndex {
+public:
+    typedef uint64_t PlaceID;
+
+    TextIndex() {}
+
+    /**
+     * Index a place, or reindex it if it is already indexed.
+     */
+    void insert(PlaceID placeID, const std::string &name, const std::string &address);
+
+    /**
+     * @return false if the place wasn't indexed.
+     */
+    bool remove(PlaceID placeID);
+
+    bool contains(PlaceID placeID) const { return _slots.count(placeID) != 0; }
+
+    /**
+     * Name and address a place was indexed with.
+     *
+     * @return false if the place isn't indexed.
+     */
+    bool textOf(PlaceID placeID, std::string *name, std::string *address) const;
+
+    size_t size() const { return _slots.size(); }
+
+    /**
+     * Number of distinct words indexed
+     */
+    size_t numTerms() const { return _postings.size(); }
+
+    void clear();
+
+    /**
+     * Places matching every word of query, places whose name alone matches
+     * first, then most recently indexed (highest ID) first.
+     *
+     * @param maxResults    most places returned
+     */
+    std::vector<PlaceID> search(const std::string &query, size_t maxResults) const;
+
+    void write(std::ostream &output) const;
+
+    /**
+     * Replace the index with one written by write().
+     *
+     * @return false if the input is not a valid index, leaving this empty.
+     */
+    bool read(std::istream &input);
+
+    /**
+     * The words of text, as they are indexed and matched
+     */
+    static std::vector<std::string> tokenize(const std::string &text);
+
+private:
+    typedef uint32_t Slot;
+
+    struct Document {
+        std::string name;
+        std::string address;
+        bool live;
+    };
+
+    /**
+     * A term's occurrence: the place's slot shifted left one, low bit set if
+     * the term is in its name.
+     */
+    typedef uint32_t Posting;
+
+    void addPostings(Slot slot);
+    void removePostings(Slot slot);
+
+    std::vector<Document> _documents;                   // by slot
+    std::vector<PlaceID> _placeIDs;                     // by slot, apart so ranking reads them densely
+    std::vector<Slot> _freeSlots;
+    std::unordered_map<PlaceID, Slot> _slots;
+    std::map<std::string, std::vector<Posting> > _postings;
+};
+
+} // namespace rtc
+
+#endif
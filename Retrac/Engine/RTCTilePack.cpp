@@ -0,0 +1,632 @@
+//
+//  RTCTilePack.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/30/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCTilePack.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace rtc {
+
+#pragma mark - Constants
+static const uint32_t kPackFileMagic = 0x50545452; // "RTTP"
+static const uint32_t kPackFileVersion = 1;
+
+// bits of a TileID below the zoom level
+static const uint64_t kTileIndexMask = (1ULL << 56) - 1;
+
+// web mercator stops short of the poles
+static const double kMaxMercatorLatitude = 85.05112878;
+
+/**
+ * Pack file header. The sections follow it in this order, each padded to 8
+ * bytes: index (numTiles), blobs (numBlobs), regions (numRegions), region
+ * tiles (numRegionTiles), names (nameBytes), data (dataBytes).
+ */
+struct PackFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numTiles;
+    uint32_t numBlobs;
+    uint32_t numRegions;
+    uint32_t numRegionTiles;
+    uint32_t nameBytes;
+    uint32_t reserved;
+    uint64_t dataBytes;
+};
+
+struct TilePack::IndexEntry {
+    TileID tile;
+    uint32_t blob;
+    uint32_t reserved;
+};
+
+struct TilePack::BlobEntry {
+    uint64_t offset;            // into the data section
+    uint64_t hash;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+struct TilePack::RegionEntry {
+    double lastUsed;
+    uint32_t firstTile;         // into the region tiles section
+    uint32_t numTiles;
+    uint32_t nameOffset;        // into the names section
+    uint32_t nameLength;
+};
+
+
+#pragma mark - Helpers
+static uint64_t paddedSize(uint64_t size)
+{
+    return (size + 7) & ~(uint64_t)7;
+}
+
+static void writePadding(std::ostream &output, uint64_t size)
+{
+    static const char zeros[8] = {0};
+    output.write(zeros, (std::streamsize)(paddedSize(size) - size));
+}
+
+// spread the low 28 bits of value out to the even bits
+static uint64_t spreadBits(uint32_t value)
+{
+    uint64_t bits = value & 0x0fffffff;
+    bits = (bits | (bits << 16)) & 0x0000ffff0000ffffULL;
+    bits = (bits | (bits << 8)) & 0x00ff00ff00ff00ffULL;
+    bits = (bits | (bits << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    bits = (bits | (bits << 2)) & 0x3333333333333333ULL;
+    bits = (bits | (bits << 1)) & 0x5555555555555555ULL;
+    return bits;
+}
+
+// gather the even bits of value
+static uint32_t gatherBits(uint64_t value)
+{
+    uint64_t bits = value & 0x5555555555555555ULL;
+    bits = (bits | (bits >> 1)) & 0x3333333333333333ULL;
+    bits = (bits | (bits >> 2)) & 0x0f0f0f0f0f0f0f0fULL;
+    bits = (bits | (bits >> 4)) & 0x00ff00ff00ff00ffULL;
+    bits = (bits | (bits >> 8)) & 0x0000ffff0000ffffULL;
+    bits = (bits | (bits >> 16)) & 0x00000000ffffffffULL;
+    return (uint32_t)bits;
+}
+
+// longitude difference in [-180, 180)
+static double longitudeDelta(double to, double from)
+{
+    double delta = std::fmod(to - from + 180.0, 360.0);
+    return ((delta < 0) ? delta + 360.0 : delta) - 180.0;
+}
+
+// point in web mercator world coordinates, [0, 1) both ways
+static void worldPoint(const GeoPoint &point, double *x, double *y)
+{
+    double latitude = std::max(-kMaxMercatorLatitude, std::min(kMaxMercatorLatitude, point.latitude));
+    double longitude = longitudeDelta(point.longitude, 0.0);
+    *x = (longitude + 180.0) / 360.0;
+    *y = 0.5 - std::asinh(std::tan(latitude * kDegreesToRadians)) / (2.0 * M_PI);
+}
+
+/**
+ * Append the tiles near center to tiles, unsorted
+ */
+static void appendTilesAround(const GeoPoint &center, double radius, unsigned minZoom, unsigned maxZoom,
+                              std::vector<TileID> &tiles)
+{
+    double wx, wy;
+    worldPoint(center, &wx, &wy);
+
+    // meters per world unit where center is
+    double latitude = std::min(kMaxMercatorLatitude, std::fabs(center.latitude));
+    double worldSize = 2.0 * M_PI * kEarthRadius * std::cos(latitude * kDegreesToRadians);
+
+    maxZoom = std::min(maxZoom, kMaxTileZoom);
+    for (unsigned zoom = minZoom; zoom <= maxZoom; ++zoom) {
+        int64_t numTiles = (int64_t)1 << zoom;
+        double x = wx * numTiles, y = wy * numTiles;
+        double r = std::max(0.0, radius) * numTiles / worldSize;
+
+        int64_t minY = std::max((int64_t)0, (int64_t)std::floor(y - r));
+        int64_t maxY = std::min(numTiles - 1, (int64_t)std::floor(y + r));
+        int64_t minX = (int64_t)std::floor(x - r), maxX = (int64_t)std::floor(x + r);
+        if (maxX - minX >= numTiles) {
+            minX = 0;
+            maxX = numTiles - 1;
+        }
+        for (int64_t ty = minY; ty <= maxY; ++ty) {
+            double dy = std::max(0.0, std::max(ty - y, y - (ty + 1)));
+            for (int64_t tx = minX; tx <= maxX; ++tx) {
+                double dx = std::max(0.0, std::max(tx - x, x - (tx + 1)));
+                if (dx * dx + dy * dy > r * r) continue;
+                // columns wrap around at the antimeridian
+                int64_t column = ((tx % numTiles) + numTiles) % numTiles;
+                tiles.push_back(tileID(zoom, (uint32_t)column, (uint32_t)ty));
+            }
+        }
+    }
+}
+
+static void sortTiles(std::vector<TileID> &tiles)
+{
+    std::sort(tiles.begin(), tiles.end());
+    tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+}
+
+
+#pragma mark - Tiles
+TileID tileID(unsigned zoom, uint32_t x, uint32_t y)
+{
+    return ((TileID)zoom << 56) | spreadBits(x) | (spreadBits(y) << 1);
+}
+
+unsigned tileZoom(TileID tile)
+{
+    return (unsigned)(tile >> 56);
+}
+
+uint32_t tileX(TileID tile)
+{
+    return gatherBits(tile & kTileIndexMask);
+}
+
+uint32_t tileY(TileID tile)
+{
+    return gatherBits((tile & kTileIndexMask) >> 1);
+}
+
+TileID tileForPoint(const GeoPoint &point, unsigned zoom)
+{
+    zoom = std::min(zoom, kMaxTileZoom);
+    double wx, wy;
+    worldPoint(point, &wx, &wy);
+    int64_t numTiles = (int64_t)1 << zoom;
+    int64_t x = std::min(numTiles - 1, std::max((int64_t)0, (int64_t)std::floor(wx * numTiles)));
+    int64_t y = std::min(numTiles - 1, std::max((int64_t)0, (int64_t)std::floor(wy * numTiles)));
+    return tileID(zoom, (uint32_t)x, (uint32_t)y);
+}
+
+void tilesAround(const GeoPoint &center, double radius, unsigned minZoom, unsigned maxZoom,
+                 std::vector<TileID> &tiles)
+{
+    appendTilesAround(center, radius, minZoom, maxZoom, tiles);
+    sortTiles(tiles);
+}
+
+void tilesAlong(const std::vector<GeoPoint> &polyline, double corridor, unsigned minZoom, unsigned maxZoom,
+                std::vector<TileID> &tiles)
+{
+    // circles half a corridor apart cover the corridor to within a few percent
+    double spacing = std::max(1.0, corridor * 0.5);
+    for (size_t i = 0; i < polyline.size(); ++i) {
+        appendTilesAround(polyline[i], corridor, minZoom, maxZoom, tiles);
+        if (i + 1 == polyline.size()) break;
+
+        const GeoPoint &from = polyline[i], &to = polyline[i + 1];
+        double deltaLongitude = longitudeDelta(to.longitude, from.longitude);
+        size_t numSteps = (size_t)std::ceil(distanceBetween(from, to) / spacing);
+        for (size_t s = 1; s < numSteps; ++s) {
+            double t = (double)s / numSteps;
+            GeoPoint point(from.latitude + t * (to.latitude - from.latitude),
+                           longitudeDelta(from.longitude + t * deltaLongitude, 0.0));
+            appendTilesAround(point, corridor, minZoom, maxZoom, tiles);
+        }
+    }
+    sortTiles(tiles);
+}
+
+std::vector<TileID> neighbourhoodTiles(const GeoPoint &center, const std::vector<GeoPoint> &route,
+                                       const TilePackPolicy &policy)
+{
+    std::vector<TileID> tiles;
+    appendTilesAround(center, policy.placeRadius, policy.minZoom, policy.maxZoom, tiles);
+    if (!route.empty()) tilesAlong(route, policy.routeCorridor, policy.minZoom, policy.maxZoom, tiles);
+    sortTiles(tiles);
+    return tiles;
+}
+
+uint64_t tileHash(const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+#pragma mark - TilePack
+TilePack::TilePack()
+    : _size(0), _numTiles(0), _numBlobs(0), _numRegions(0), _dataBytes(0),
+      _index(0), _blobs(0), _regions(0), _regionTiles(0), _names(0), _data(0)
+{
+}
+
+bool TilePack::attach(const void *data, size_t size)
+{
+    PackFileHeader header;
+    if (size < sizeof(header)) return false;
+    std::memcpy(&header, data, sizeof(header));
+    if ((header.magic != kPackFileMagic) || (header.version != kPackFileVersion)) return false;
+
+    // section sizes, checked in 64 bits so a corrupt header can't overflow
+    uint64_t expected = sizeof(header) +
+                        (uint64_t)header.numTiles * sizeof(IndexEntry) +
+                        (uint64_t)header.numBlobs * sizeof(BlobEntry) +
+                        (uint64_t)header.numRegions * sizeof(RegionEntry) +
+                        (uint64_t)header.numRegionTiles * sizeof(TileID) +
+                        paddedSize(header.nameBytes) +
+                        paddedSize(header.dataBytes);
+    if (expected != size) return false;
+
+    const char *bytes = (const char *)data + sizeof(header);
+    const IndexEntry *index = (const IndexEntry *)bytes;
+    bytes += header.numTiles * sizeof(IndexEntry);
+    const BlobEntry *blobs = (const BlobEntry *)bytes;
+    bytes += header.numBlobs * sizeof(BlobEntry);
+    const RegionEntry *regions = (const RegionEntry *)bytes;
+    bytes += header.numRegions * sizeof(RegionEntry);
+    const TileID *regionTiles = (const TileID *)bytes;
+    bytes += header.numRegionTiles * sizeof(TileID);
+    const char *names = bytes;
+    bytes += paddedSize(header.nameBytes);
+
+    // regions are few, so check them all. Tiles and blobs are checked as
+    //   they are looked up, so attaching doesn't page in the whole index.
+    for (uint32_t r = 0; r < header.numRegions; ++r) {
+        if (((uint64_t)regions[r].firstTile + regions[r].numTiles > header.numRegionTiles) ||
+            ((uint64_t)regions[r].nameOffset + regions[r].nameLength > header.nameBytes)) return false;
+    }
+
+    _size = size;
+    _numTiles = header.numTiles;
+    _numBlobs = header.numBlobs;
+    _numRegions = header.numRegions;
+    _index = index;
+    _blobs = blobs;
+    _regions = regions;
+    _regionTiles = regionTiles;
+    _names = names;
+    _data = bytes;
+    _dataBytes = header.dataBytes;
+    return true;
+}
+
+bool TilePack::read(std::istream &input)
+{
+    std::vector<char> storage((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    if (storage.empty() || !attach(&storage[0], storage.size())) return false;
+
+    // vector storage doesn't move when the vector does
+    _storage.swap(storage);
+    return true;
+}
+
+bool TilePack::tile(TileID tile, Tile *contents) const
+{
+    const IndexEntry *end = _index + _numTiles;
+    const IndexEntry *entry = std::lower_bound(_index, end, tile,
+                                               [](const IndexEntry &e, TileID t) { return e.tile < t; });
+    if ((entry == end) || (entry->tile != tile)) return false;
+
+    size_t index = (size_t)(entry - _index);
+    if (contents) *contents = tileContentsAt(index);
+    return true;
+}
+
+bool TilePack::contains(TileID tile) const
+{
+    return this->tile(tile, 0);
+}
+
+TileID TilePack::tileAt(size_t index) const
+{
+    return _index[index].tile;
+}
+
+TilePack::Tile TilePack::tileContentsAt(size_t index) const
+{
+    Tile contents;
+    uint32_t blob = _index[index].blob;
+    if (blob >= _numBlobs) return contents;
+    const BlobEntry &entry = _blobs[blob];
+    if ((entry.offset > _dataBytes) || (entry.size > _dataBytes - entry.offset)) return contents;
+
+    contents.data = _data + entry.offset;
+    contents.size = entry.size;
+    return contents;
+}
+
+uint64_t TilePack::tileHashAt(size_t index) const
+{
+    uint32_t blob = _index[index].blob;
+    return (blob < _numBlobs) ? _blobs[blob].hash : 0;
+}
+
+std::string TilePack::regionName(size_t region) const
+{
+    return std::string(_names + _regions[region].nameOffset, _regions[region].nameLength);
+}
+
+double TilePack::regionLastUsed(size_t region) const
+{
+    return _regions[region].lastUsed;
+}
+
+std::vector<TileID> TilePack::regionTiles(size_t region) const
+{
+    const TileID *first = _regionTiles + _regions[region].firstTile;
+    return std::vector<TileID>(first, first + _regions[region].numTiles);
+}
+
+
+#pragma mark - TilePackBuilder
+TilePackBuilder::TilePackBuilder()
+    : _blobBytes(0)
+{
+}
+
+TilePackBuilder::TilePackBuilder(const TilePack &pack)
+    : _blobBytes(0)
+{
+    for (size_t r = 0; r < pack.numRegions(); ++r) {
+        setRegion(pack.regionName(r), pack.regionTiles(r), pack.regionLastUsed(r));
+    }
+
+    // old contents aren't hashed or copied again: tiles that shared them in
+    //   the old pack share them here
+    std::unordered_map<const char *, uint32_t> blobs;
+    for (size_t i = 0; i < pack.numTiles(); ++i) {
+        TileID tile = pack.tileAt(i);
+        if (!_wanted.count(tile)) continue;
+        TilePack::Tile contents = pack.tileContentsAt(i);
+        if (!contents.data) continue;
+
+        std::unordered_map<const char *, uint32_t>::iterator found = blobs.find(contents.data);
+        uint32_t blob;
+        if (found != blobs.end()) {
+            blob = found->second;
+            ++_blobs[blob].numTiles;
+        } else {
+            blob = addBlob(contents.data, (uint32_t)contents.size, pack.tileHashAt(i), false);
+            blobs[contents.data] = blob;
+        }
+        _tiles[tile] = blob;
+    }
+}
+
+void TilePackBuilder::setRegion(const std::string &name, const std::vector<TileID> &tiles, double lastUsed)
+{
+    // want the new tiles before letting go of the old, so shared ones stay
+    Region region;
+    region.tiles = tiles;
+    sortTiles(region.tiles);
+    region.lastUsed = lastUsed;
+    for (size_t i = 0; i < region.tiles.size(); ++i) ++_wanted[region.tiles[i]];
+
+    removeRegion(name);
+    _regions[name].tiles.swap(region.tiles);
+    _regions[name].lastUsed = lastUsed;
+}
+
+void TilePackBuilder::removeRegion(const std::string &name)
+{
+    std::map<std::string, Region>::iterator region = _regions.find(name);
+    if (region == _regions.end()) return;
+
+    const std::vector<TileID> &tiles = region->second.tiles;
+    for (size_t i = 0; i < tiles.size(); ++i) releaseTile(tiles[i]);
+    _regions.erase(region);
+}
+
+std::vector<TileID> TilePackBuilder::missingTiles() const
+{
+    std::vector<TileID> missing;
+    for (std::unordered_map<TileID, uint32_t>::const_iterator it = _wanted.begin(); it != _wanted.end(); ++it) {
+        if (!_tiles.count(it->first)) missing.push_back(it->first);
+    }
+    std::sort(missing.begin(), missing.end());
+    return missing;
+}
+
+void TilePackBuilder::addTile(TileID tile, const void *data, size_t size)
+{
+    if (!_wanted.count(tile) || (size > UINT32_MAX)) return;
+
+    std::map<TileID, uint32_t>::iterator existing = _tiles.find(tile);
+    if (existing != _tiles.end()) {
+        uint32_t old = existing->second;
+        _tiles.erase(existing);
+        releaseBlob(old);
+    }
+
+    _tiles[tile] = addBlob((const char *)data, (uint32_t)size, tileHash(data, size), true);
+}
+
+uint32_t TilePackBuilder::addBlob(const char *data, uint32_t size, uint64_t hash, bool copy)
+{
+    std::pair<std::unordered_multimap<uint64_t, uint32_t>::iterator,
+              std::unordered_multimap<uint64_t, uint32_t>::iterator> range = _blobsByHash.equal_range(hash);
+    for (std::unordered_multimap<uint64_t, uint32_t>::iterator it = range.first; it != range.second; ++it) {
+        Blob &blob = _blobs[it->second];
+        if ((blob.size == size) && (std::memcmp(blob.data, data, size) == 0)) {
+            ++blob.numTiles;
+            return it->second;
+        }
+    }
+
+    if (copy) {
+        _copies.push_back(std::string(data, size));
+        data = _copies.back().data();
+    }
+    Blob blob;
+    blob.data = data;
+    blob.size = size;
+    blob.hash = hash;
+    blob.numTiles = 1;
+
+    uint32_t index;
+    if (!_freeBlobs.empty()) {
+        index = _freeBlobs.back();
+        _freeBlobs.pop_back();
+        _blobs[index] = blob;
+    } else {
+        index = (uint32_t)_blobs.size();
+        _blobs.push_back(blob);
+    }
+    _blobsByHash.insert(std::make_pair(hash, index));
+    _blobBytes += size;
+    return index;
+}
+
+/**
+ * One less region wants tile: drop it, and its contents, once none do
+ */
+void TilePackBuilder::releaseTile(TileID tile)
+{
+    std::unordered_map<TileID, uint32_t>::iterator wanted = _wanted.find(tile);
+    if ((wanted == _wanted.end()) || (--wanted->second > 0)) return;
+    _wanted.erase(wanted);
+
+    std::map<TileID, uint32_t>::iterator existing = _tiles.find(tile);
+    if (existing == _tiles.end()) return;
+    uint32_t blob = existing->second;
+    _tiles.erase(existing);
+    releaseBlob(blob);
+}
+
+/**
+ * One less tile has blob's contents: free it once none do
+ */
+void TilePackBuilder::releaseBlob(uint32_t blob)
+{
+    if (--_blobs[blob].numTiles > 0) return;
+
+    std::pair<std::unordered_multimap<uint64_t, uint32_t>::iterator,
+              std::unordered_multimap<uint64_t, uint32_t>::iterator> range =
+        _blobsByHash.equal_range(_blobs[blob].hash);
+    for (std::unordered_multimap<uint64_t, uint32_t>::iterator it = range.first; it != range.second; ++it) {
+        if (it->second == blob) {
+            _blobsByHash.erase(it);
+            break;
+        }
+    }
+    _blobBytes -= _blobs[blob].size;
+    _blobs[blob] = Blob();
+    _freeBlobs.push_back(blob);
+}
+
+uint64_t TilePackBuilder::byteSize() const
+{
+    uint64_t numRegionTiles = 0, nameBytes = 0;
+    for (std::map<std::string, Region>::const_iterator it = _regions.begin(); it != _regions.end(); ++it) {
+        numRegionTiles += it->second.tiles.size();
+        nameBytes += it->first.size();
+    }
+    return sizeof(PackFileHeader) +
+           _tiles.size() * sizeof(TilePack::IndexEntry) +
+           (uint64_t)numBlobs() * sizeof(TilePack::BlobEntry) +
+           _regions.size() * sizeof(TilePack::RegionEntry) +
+           numRegionTiles * sizeof(TileID) +
+           paddedSize(nameBytes) +
+           paddedSize(_blobBytes);
+}
+
+size_t TilePackBuilder::evict(uint64_t maxBytes)
+{
+    size_t numEvicted = 0;
+    while ((_regions.size() > 1) && (byteSize() > maxBytes)) {
+        std::map<std::string, Region>::const_iterator oldest = _regions.begin();
+        for (std::map<std::string, Region>::const_iterator it = _regions.begin(); it != _regions.end(); ++it) {
+            if (it->second.lastUsed < oldest->second.lastUsed) oldest = it;
+        }
+        removeRegion(oldest->first);
+        ++numEvicted;
+    }
+    return numEvicted;
+}
+
+bool TilePackBuilder::write(std::ostream &output, TilePackStats *stats) const
+{
+    // number the blobs in use in the order their first tile comes, so tiles
+    //   close on the ground have their contents close in the file too
+    std::vector<uint32_t> blobNumbers(_blobs.size(), UINT32_MAX);
+    std::vector<uint32_t> blobOrder;
+    blobOrder.reserve(numBlobs());
+    std::vector<TilePack::IndexEntry> index;
+    index.reserve(_tiles.size());
+    for (std::map<TileID, uint32_t>::const_iterator it = _tiles.begin(); it != _tiles.end(); ++it) {
+        if (blobNumbers[it->second] == UINT32_MAX) {
+            blobNumbers[it->second] = (uint32_t)blobOrder.size();
+            blobOrder.push_back(it->second);
+        }
+        TilePack::IndexEntry entry = {it->first, blobNumbers[it->second], 0};
+        index.push_back(entry);
+    }
+
+    std::vector<TilePack::BlobEntry> blobs;
+    blobs.reserve(blobOrder.size());
+    uint64_t dataBytes = 0;
+    for (size_t i = 0; i < blobOrder.size(); ++i) {
+        const Blob &blob = _blobs[blobOrder[i]];
+        TilePack::BlobEntry entry = {dataBytes, blob.hash, blob.size, 0};
+        blobs.push_back(entry);
+        dataBytes += blob.size;
+    }
+
+    std::vector<TilePack::RegionEntry> regions;
+    std::vector<TileID> regionTiles;
+    std::string names;
+    for (std::map<std::string, Region>::const_iterator it = _regions.begin(); it != _regions.end(); ++it) {
+        TilePack::RegionEntry entry = {it->second.lastUsed, (uint32_t)regionTiles.size(),
+                                       (uint32_t)it->second.tiles.size(), (uint32_t)names.size(),
+                                       (uint32_t)it->first.size()};
+        regions.push_back(entry);
+        regionTiles.insert(regionTiles.end(), it->second.tiles.begin(), it->second.tiles.end());
+        names += it->first;
+    }
+
+    PackFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = kPackFileMagic;
+    header.version = kPackFileVersion;
+    header.numTiles = (uint32_t)index.size();
+    header.numBlobs = (uint32_t)blobs.size();
+    header.numRegions = (uint32_t)regions.size();
+    header.numRegionTiles = (uint32_t)regionTiles.size();
+    header.nameBytes = (uint32_t)names.size();
+    header.dataBytes = dataBytes;
+
+    output.write((const char *)&header, sizeof(header));
+    if (!index.empty()) output.write((const char *)&index[0], index.size() * sizeof(index[0]));
+    if (!blobs.empty()) output.write((const char *)&blobs[0], blobs.size() * sizeof(blobs[0]));
+    if (!regions.empty()) output.write((const char *)&regions[0], regions.size() * sizeof(regions[0]));
+    if (!regionTiles.empty()) output.write((const char *)&regionTiles[0], regionTiles.size() * sizeof(TileID));
+    output.write(names.data(), (std::streamsize)names.size());
+    writePadding(output, names.size());
+    for (size_t i = 0; i < blobOrder.size(); ++i) {
+        const Blob &blob = _blobs[blobOrder[i]];
+        output.write(blob.data, blob.size);
+    }
+    writePadding(output, dataBytes);
+
+    if (stats) {
+        stats->numTiles = index.size();
+        stats->numBlobs = blobs.size();
+        stats->numRegions = regions.size();
+        stats->byteSize = sizeof(header) + index.size() * sizeof(index[0]) + blobs.size() * sizeof(blobs[0]) +
+                          regions.size() * sizeof(regions[0]) + regionTiles.size() * sizeof(TileID) +
+                          paddedSize(names.size()) + paddedSize(dataBytes);
+    }
+    return output.good();
+}
+
+} // namespace rtc
@@ -0,0 +1,292 @@
+//
+//  RTCTilePack.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/30/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/MapKit here so this can be
+//  compiled and exercised headlessly.
+
+#ifndef Retrac_RTCTilePack_h
+#define Retrac_RTCTilePack_h
+
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "RTCGeo.h"
+
+namespace rtc {
+
+/**
+ * TileID names a web mercator map tile: zoom level in the top 8 bits, then
+ * the column (x, from the antimeridian east) and row (y, from the north down,
+ * as in XYZ tile URLs) bit-interleaved. Sorting by TileID keeps the tiles of
+ * one zoom level that are close on the ground close together.
+ */
+typedef uint64_t TileID;
+
+static const unsigned kMaxTileZoom = 28;
+
+TileID tileID(unsigned zoom, uint32_t x, uint32_t y);
+unsigned tileZoom(TileID tile);
+uint32_t tileX(TileID tile);
+uint32_t tileY(TileID tile);
+
+/**
+ * Tile of zoom level zoom that point is in
+ */
+TileID tileForPoint(const GeoPoint &point, unsigned zoom);
+
+/**
+ * Add the tiles of zoom levels [minZoom, maxZoom] that come within radius
+ * (meters) of center to tiles, keeping it sorted with no repeats.
+ */
+void tilesAround(const GeoPoint &center, double radius, unsigned minZoom, unsigned maxZoom,
+                 std::vector<TileID> &tiles);
+
+/**
+ * Add the tiles of zoom levels [minZoom, maxZoom] that come within corridor
+ * (meters) of polyline to tiles, keeping it sorted with no repeats.
+ */
+void tilesAlong(const std::vector<GeoPoint> &polyline, double corridor, unsigned minZoom, unsigned maxZoom,
+                std::vector<TileID> &tiles);
+
+/**
+ * TilePackPolicy holds the knobs that trade offline map coverage for storage.
+ * The default values mirror the tile pack settings in RTCConstants.m
+ */
+struct TilePackPolicy {
+    unsigned minZoom;           // kRTCTilePackMinZoom
+    unsigned maxZoom;           // kRTCTilePackMaxZoom
+    double placeRadius;         // kRTCTilePackPlaceRadius
+    double routeCorridor;       // kRTCTilePackRouteCorridor
+    uint64_t maxBytes;          // kRTCTilePackMaxBytes
+
+    TilePackPolicy()
+        : minZoom(14), maxZoom(18), placeRadius(400.0), routeCorridor(100.0),
+          maxBytes(64 * 1024 * 1024) {}
+};
+
+/**
+ * Tiles a neighbourhood needs: those within policy.placeRadius of center,
+ * and within policy.routeCorridor of route if it isn't empty. Sorted.
+ */
+std::vector<TileID> neighbourhoodTiles(const GeoPoint &center, const std::vector<GeoPoint> &route,
+                                       const TilePackPolicy &policy);
+
+/**
+ * TilePack is a read-only store of map tiles for offline use, in one file
+ * like an MBTiles database: a tile index sorted by TileID, pointing into a
+ * table of tile contents. Tiles with the same contents (open water, an empty
+ * park) share one copy.
+ *
+ * Tiles are grouped into regions, one per saved place's neighbourhood, each
+ * with the time it was last used, so a TilePackBuilder can drop the least
+ * recently used neighbourhoods when the pack grows too big.
+ *
+ * The file format is the in-memory format: every section is a flat array at
+ * an 8-byte aligned offset, so a pack file can be memory mapped and attached
+ * with no parsing or copying. A lookup is a binary search of the index and
+ * the tile's bytes are read straight out of the mapping.
+ *
+ * Tile contents are opaque: raster or vector tiles alike.
+ */
+class TilePack {
+public:
+    /**
+     * A tile's contents, pointing into the pack
+     */
+    struct Tile {
+        const char *data;
+        size_t size;
+
+        Tile() : data(0), size(0) {}
+    };
+
+    TilePack();
+
+    /**
+     * Use a pack file already in memory, typically memory mapped. The data is
+     * not copied and must outlive the pack.
+     *
+     * @return false if data isn't a complete pack file.
+     */
+    bool attach(const void *data, size_t size);
+
+    /**
+     * Read a pack file into memory owned by the pack.
+     *
+     * @return false if the stream is short or not a pack file.
+     */
+    bool read(std::istream &input);
+
+    bool empty() const { return _numTiles == 0; }
+    size_t numTiles() const { return _numTiles; }
+    size_t numBlobs() const { return _numBlobs; }
+    size_t numRegions() const { return _numRegions; }
+    size_t byteSize() const { return _size; }
+
+    /**
+     * Look up a tile.
+     *
+     * @return false if the pack doesn't have it.
+     */
+    bool tile(TileID tile, Tile *contents) const;
+    bool contains(TileID tile) const;
+
+    /**
+     * Tiles in the pack, in TileID order
+     */
+    TileID tileAt(size_t index) const;
+    Tile tileContentsAt(size_t index) const;
+    uint64_t tileHashAt(size_t index) const;
+
+    std::string regionName(size_t region) const;
+    double regionLastUsed(size_t region) const;
+
+    /**
+     * Tiles region wants, whether or not the pack has them all
+     */
+    std::vector<TileID> regionTiles(size_t region) const;
+
+private:
+    struct IndexEntry;
+    struct BlobEntry;
+    struct RegionEntry;
+
+    std::vector<char> _storage;     // only used by read()
+    size_t _size;
+
+    uint32_t _numTiles, _numBlobs, _numRegions;
+    uint64_t _dataBytes;
+
+    const IndexEntry *_index;
+    const BlobEntry *_blobs;
+    const RegionEntry *_regions;
+    const TileID *_regionTiles;
+    const char *_names;
+    const char *_data;
+
+    friend class TilePackBuilder;   // for the entry sizes
+};
+
+/**
+ * Counts from building a pack
+ */
+struct TilePackStats {
+    size_t numTiles;            // tiles in the pack
+    size_t numBlobs;            // distinct tile contents
+    size_t numRegions;          // neighbourhoods in the pack
+    uint64_t byteSize;          // size of the pack file
+
+    TilePackStats() : numTiles(0), numBlobs(0), numRegions(0), byteSize(0) {}
+};
+
+/**
+ * TilePackBuilder puts together a new pack from an old one and newly
+ * fetched tiles, then writes it.
+ *
+ * A tile is kept as long as a region wants it. Contents are deduplicated by
+ * their 64-bit FNV-1a hash, checked byte for byte.
+ */
+class TilePackBuilder {
+public:
+    TilePackBuilder();
+
+    /**
+     * Start from the tiles and regions of pack. Tile contents aren't copied,
+     * so pack's data must outlive the builder.
+     */
+    explicit TilePackBuilder(const TilePack &pack);
+
+    /**
+     * Want tiles for the region name, last used at lastUsed (seconds since
+     * 1970), replacing what it wanted before.
+     */
+    void setRegion(const std::string &name, const std::vector<TileID> &tiles, double lastUsed);
+    void removeRegion(const std::string &name);
+    bool hasRegion(const std::string &name) const { return _regions.count(name) != 0; }
+
+    /**
+     * Tiles a region wants that the builder has no contents for, sorted
+     */
+    std::vector<TileID> missingTiles() const;
+
+    /**
+     * Add the contents of a tile. Copied, unless a tile with the same
+     * contents is already in. Tiles no region wants are ignored.
+     */
+    void addTile(TileID tile, const void *data, size_t size);
+    bool hasTile(TileID tile) const { return _tiles.count(tile) != 0; }
+
+    /**
+     * Size of the pack file as things stand
+     */
+    uint64_t byteSize() const;
+
+    /**
+     * Drop the least recently used regions, and the tiles only they want,
+     * until the pack fits in maxBytes. The most recently used region is
+     * always kept.
+     *
+     * @return the number of regions dropped.
+     */
+    size_t evict(uint64_t maxBytes);
+
+    /**
+     * Write the pack.
+     *
+     * @return false if the write failed.
+     */
+    bool write(std::ostream &output, TilePackStats *stats = 0) const;
+
+    size_t numTiles() const { return _tiles.size(); }
+    size_t numBlobs() const { return _blobs.size() - _freeBlobs.size(); }
+    size_t numRegions() const { return _regions.size(); }
+
+private:
+    struct Blob {
+        const char *data;       // empty blobs are free
+        uint32_t size;
+        uint64_t hash;
+        uint32_t numTiles;      // tiles with these contents
+
+        Blob() : data(0), size(0), hash(0), numTiles(0) {}
+    };
+
+    struct Region {
+        std::vector<TileID> tiles;
+        double lastUsed;
+
+        Region() : lastUsed(0) {}
+    };
+
+    uint32_t addBlob(const char *data, uint32_t size, uint64_t hash, bool copy);
+    void releaseTile(TileID tile);
+    void releaseBlob(uint32_t blob);
+
+    std::vector<Blob> _blobs;
+    std::vector<uint32_t> _freeBlobs;
+    std::deque<std::string> _copies;                    // contents not in the old pack
+    std::unordered_multimap<uint64_t, uint32_t> _blobsByHash;
+    uint64_t _blobBytes;
+
+    std::map<TileID, uint32_t> _tiles;                  // tile -> blob
+    std::unordered_map<TileID, uint32_t> _wanted;       // tile -> number of regions wanting it
+    std::map<std::string, Region> _regions;
+};
+
+/**
+ * 64-bit FNV-1a hash of size bytes at data
+ */
+uint64_t tileHash(const void *data, size_t size);
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,251 @@
+//
+//  RTCTimerWheel.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 9/3/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCTimerWheel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace rtc {
+
+#pragma mark - Constants
+// fraction of a tick times are allowed to be off by, so a deadline worked out
+// as now + delay, or read back from nextDeadline(), lands on the tick it means
+static const double kTickTolerance = 1e-6;
+
+
+#pragma mark - Helpers
+static inline unsigned lowestBit(uint64_t bits)
+{
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctzll(bits);
+#else
+    unsigned bit = 0;
+    while (!(bits & 1)) { bits >>= 1; ++bit; }
+    return bit;
+#endif
+}
+
+static inline unsigned highestBit(uint64_t bits)
+{
+#if defined(__GNUC__)
+    return 63 - (unsigned)__builtin_clzll(bits);
+#else
+    unsigned bit = 0;
+    while (bits >>= 1) ++bit;
+    return bit;
+#endif
+}
+
+
+#pragma mark - TimerWheel
+const unsigned TimerWheel::kSlotBits;
+const unsigned TimerWheel::kNumSlots;
+const unsigned TimerWheel::kNumWheels;
+const uint32_t TimerWheel::kNoNode;
+
+TimerWheel::TimerWheel(double tickDuration, double startTime)
+    : _tickDuration(tickDuration > 0 ? tickDuration : 0.001), _startTime(startTime),
+      _currentTick(0), _numTimers(0)
+{
+    std::fill(_heads, _heads + kNumWheels * kNumSlots, kNoNode);
+    std::fill(_tails, _tails + kNumWheels * kNumSlots, kNoNode);
+    std::fill(_occupied, _occupied + kNumWheels, 0);
+}
+
+uint64_t TimerWheel::tickForTime(double time) const
+{
+    // round up, so a timer never fires before its deadline
+    double ticks = std::ceil((time - _startTime) / _tickDuration - kTickTolerance);
+    if (!(ticks > 0)) return 0; // also catches NaN
+    if (ticks >= 18446744073709551615.0) return UINT64_MAX;
+    return (uint64_t)ticks;
+}
+
+TimerWheel::TimerID TimerWheel::schedule(double deadline)
+{
+    uint32_t index;
+    if (!_freeNodes.empty()) {
+        index = _freeNodes.back();
+        _freeNodes.pop_back();
+    } else {
+        index = (uint32_t)_nodes.size();
+        Node node;
+        node.generation = 1;
+        _nodes.push_back(node);
+    }
+
+    Node &node = _nodes[index];
+    // a deadline already past goes in the current slot, which the next
+    // advance() looks at again
+    node.tick = std::max(tickForTime(deadline), _currentTick);
+    node.scheduled = true;
+    link(index);
+    ++_numTimers;
+
+    return ((uint64_t)node.generation << 32) | (index + 1);
+}
+
+bool TimerWheel::isScheduled(TimerID timerID) const
+{
+    uint32_t index = (uint32_t)timerID - 1;
+    if (index >= _nodes.size()) return false;
+    const Node &node = _nodes[index];
+    return node.scheduled && (node.generation == (uint32_t)(timerID >> 32));
+}
+
+bool TimerWheel::cancel(TimerID timerID)
+{
+    if (!isScheduled(timerID)) return false;
+    uint32_t index = (uint32_t)timerID - 1;
+    unlink(index);
+    release(index);
+    return true;
+}
+
+void TimerWheel::link(uint32_t index)
+{
+    Node &node = _nodes[index];
+
+    // file the timer under the wheel of the highest digit where its tick
+    // differs from the current one, in the slot of its digit there. So every
+    // timer in a wheel is in a later slot than the current one, and is spread
+    // over the lower wheels when time gets to the start of its slot.
+    uint64_t difference = node.tick ^ _currentTick;
+    unsigned wheel = difference ? highestBit(difference) / kSlotBits : 0;
+    unsigned slot = wheel * kNumSlots + (unsigned)((node.tick >> (wheel * kSlotBits)) & (kNumSlots - 1));
+
+    node.slot = (uint16_t)slot;
+    node.next = kNoNode;
+    node.previous = _tails[slot];
+    if (_tails[slot] == kNoNode) {
+        _heads[slot] = index;
+        _occupied[wheel] |= (uint64_t)1 << (slot & (kNumSlots - 1));
+    } else {
+        _nodes[_tails[slot]].next = index;
+    }
+    _tails[slot] = index;
+}
+
+void TimerWheel::unlink(uint32_t index)
+{
+    Node &node = _nodes[index];
+    unsigned slot = node.slot;
+
+    if (node.previous == kNoNode) _heads[slot] = node.next;
+    else _nodes[node.previous].next = node.next;
+    if (node.next == kNoNode) _tails[slot] = node.previous;
+    else _nodes[node.next].previous = node.previous;
+
+    if (_heads[slot] == kNoNode) {
+        _occupied[slot / kNumSlots] &= ~((uint64_t)1 << (slot & (kNumSlots - 1)));
+    }
+}
+
+void TimerWheel::release(uint32_t index)
+{
+    Node &node = _nodes[index];
+    node.scheduled = false;
+    ++node.generation;
+    _freeNodes.push_back(index);
+    --_numTimers;
+}
+
+uint32_t TimerWheel::takeSlot(unsigned slot)
+{
+    uint32_t head = _heads[slot];
+    _heads[slot] = _tails[slot] = kNoNode;
+    _occupied[slot / kNumSlots] &= ~((uint64_t)1 << (slot & (kNumSlots - 1)));
+    return head;
+}
+
+uint64_t TimerWheel::nextEventTick() const
+{
+    // the lowest wheel with anything in it has the earliest event: its slots
+    // all lie within the current slot of the wheel above
+    for (unsigned wheel = 0; wheel < kNumWheels; ++wheel) {
+        if (!_occupied[wheel]) continue;
+
+        unsigned shift = wheel * kSlotBits;
+        unsigned slot = lowestBit(_occupied[wheel]);
+        uint64_t prefix = (shift + kSlotBits < 64) ? (_currentTick >> (shift + kSlotBits)) << (shift + kSlotBits) : 0;
+        return prefix | ((uint64_t)slot << shift);
+    }
+    return UINT64_MAX;
+}
+
+void TimerWheel::advance(double now, std::vector<TimerID> &expired)
+{
+    // unlike deadlines, now rounds down: a tick is only over once it's passed
+    double ticks = std::floor((now - _startTime) / _tickDuration + kTickTolerance);
+    uint64_t target = _currentTick;
+    if (ticks >= 18446744073709551615.0) target = UINT64_MAX;
+    else if (ticks > (double)_currentTick) target = (uint64_t)ticks;
+
+    while (_numTimers) {
+        uint64_t event = nextEventTick();
+        if (event > target) break;
+        _currentTick = event;
+
+        // spread out the slots that start here, top down so timers cascade
+        // all the way in one pass
+        for (unsigned wheel = kNumWheels - 1; wheel > 0; --wheel) {
+            unsigned digit = (unsigned)((event >> (wheel * kSlotBits)) & (kNumSlots - 1));
+            if (!(_occupied[wheel] & ((uint64_t)1 << digit))) continue;
+
+            uint32_t index = takeSlot(wheel * kNumSlots + digit);
+            while (index != kNoNode) {
+                uint32_t next = _nodes[index].next;
+                link(index);
+                index = next;
+            }
+        }
+
+        unsigned slot = (unsigned)(event & (kNumSlots - 1));
+        uint32_t index = takeSlot(slot);
+        while (index != kNoNode) {
+            Node &node = _nodes[index];
+            uint32_t next = node.next;
+            expired.push_back(((uint64_t)node.generation << 32) | (index + 1));
+            release(index);
+            index = next;
+        }
+    }
+
+    _currentTick = target;
+}
+
+double TimerWheel::nextDeadline() const
+{
+    if (!_numTimers) return std::numeric_limits<double>::infinity();
+
+    // the earliest timer is in the first slot of the lowest wheel in use, at
+    // its own tick on the first wheel, but anywhere in the slot on the others
+    unsigned wheel = 0;
+    while (!_occupied[wheel]) ++wheel;
+    if (wheel == 0) return _startTime + nextEventTick() * _tickDuration;
+
+    uint64_t earliest = UINT64_MAX;
+    unsigned slot = wheel * kNumSlots + lowestBit(_occupied[wheel]);
+    for (uint32_t index = _heads[slot]; index != kNoNode; index = _nodes[index].next) {
+        earliest = std::min(earliest, _nodes[index].tick);
+    }
+    return _startTime + earliest * _tickDuration;
+}
+
+void TimerWheel::clear()
+{
+    for (uint32_t index = 0; index < _nodes.size(); ++index) {
+        if (_nodes[index].scheduled) release(index);
+    }
+    std::fill(_heads, _heads + kNumWheels * kNumSlots, kNoNode);
+    std::fill(_tails, _tails + kNumWheels * kNumSlots, kNoNode);
+    std::fill(_occupied, _occupied + kNumWheels, 0);
+}
+
+} // namespace rtc
@@ -0,0 +1,140 @@
+//
+//  RTCTimerWheel.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 9/3/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCTimerWheel_h
+#define Retrac_RTCTimerWheel_h
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rtc {
+
+/**
+ * TimerWheel keeps track of many timers cheaply. Like the other engines it
+ * runs nothing itself: the host asks for nextDeadline(), and calls advance()
+ * once it has passed to collect the timers that are due.
+ *
+ * Time is cut into ticks of tickDuration seconds and timers are filed under
+ * a hierarchy of wheels of 64 slots, the first a tick a slot, the next 64
+ * ticks a slot and so on, enough for any tick a uint64_t holds. Each timer
+ * goes in the lowest wheel whose span reaches it, and a slot of a higher
+ * wheel is spread over the lower ones when time gets to it. Each wheel keeps
+ * a bitmap of its non-empty slots, so:
+ *
+ * - scheduling and cancelling a timer are O(1), however many are pending
+ * - advance() jumps straight to the next non-empty slot, so a long gap with
+ *   nothing due costs nothing, and each timer is moved at most once per
+ *   wheel on its way down
+ *
+ * Timers fire at the first tick at or after their deadline, never early.
+ */
+class TimerWheel {
+public:
+    /**
+     * Opaque, never 0, and never reused for another timer, so cancelling a
+     * timer that already fired is harmless
+     */
+    typedef uint64_t TimerID;
+
+    /**
+     * @param tickDuration  seconds per tick, the resolution of deadlines
+     * @param startTime     time of the first tick, in the same units as
+     *                      deadlines (usually a Clock's now())
+     */
+    explicit TimerWheel(double tickDuration = 0.001, double startTime = 0.0);
+
+    double tickDuration() const { return _tickDuration; }
+
+    /**
+     * Time the wheel was last advanced to, rounded down to a tick
+     */
+    double now() const { return _startTime + _currentTick * _tickDuration; }
+
+    /**
+     * Schedule a timer. A deadline already past fires on the next advance().
+     */
+    TimerID schedule(double deadline);
+
+    /**
+     * Cancel a timer.
+     *
+     * @return false if it isn't pending, having fired or been cancelled.
+     */
+    bool cancel(TimerID timerID);
+
+    bool isScheduled(TimerID timerID) const;
+
+    /**
+     * Move time on to now and collect the timers due by then, earliest first.
+     * Time never goes backwards; an earlier now is ignored.
+     *
+     * @param expired   IDs of the timers that fired are appended here
+     */
+    void advance(double now, std::vector<TimerID> &expired);
+
+    /**
+     * When the next timer fires (its deadline rounded up to a tick), infinity
+     * if none are pending
+     */
+    double nextDeadline() const;
+
+    size_t size() const { return _numTimers; }
+    bool empty() const { return _numTimers == 0; }
+
+    /**
+     * Pending timers' IDs map to distinct indexes below capacity(), so a host
+     * can keep what each timer is for in a vector rather than a map. An index
+     * is reused once its timer fires or is cancelled.
+     */
+    static size_t indexOf(TimerID timerID) { return (size_t)(uint32_t)timerID - 1; }
+    size_t capacity() const { return _nodes.size(); }
+
+    /**
+     * Cancel every timer
+     */
+    void clear();
+
+private:
+    static const unsigned kSlotBits = 6;
+    static const unsigned kNumSlots = 1 << kSlotBits;
+    static const unsigned kNumWheels = (64 + kSlotBits - 1) / kSlotBits;
+    static const uint32_t kNoNode = UINT32_MAX;
+
+    struct Node {
+        uint64_t tick;          // tick the timer fires at
+        uint32_t generation;    // bumped whenever the node is freed
+        uint32_t previous, next;
+        uint16_t slot;          // wheel * kNumSlots + slot, while scheduled
+        bool scheduled;
+    };
+
+    uint64_t tickForTime(double time) const;
+    uint64_t nextEventTick() const;
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    uint32_t takeSlot(unsigned slot);
+
+    double _tickDuration;
+    double _startTime;
+    uint64_t _currentTick;
+    size_t _numTimers;
+
+    std::vector<Node> _nodes;
+    std::vector<uint32_t> _freeNodes;
+    uint32_t _heads[kNumWheels * kNumSlots];
+    uint32_t _tails[kNumWheels * kNumSlots];
+    uint64_t _occupied[kNumWheels];     // bit n set if slot n is non-empty
+};
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,255 @@
+//
+//  RTCTrace.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/25/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCTrace.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace rtc {
+
+#pragma mark - Percentiles
+double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+
+#pragma mark - Helpers
+// name as a JSON string, quotes included
+static std::string jsonString(const char *name)
+{
+    std::string json = "\"";
+    for (const char *c = name; *c; ++c) {
+        if ((*c == '"') || (*c == '\\')) {
+            json += '\\';
+            json += *c;
+        } else if ((unsigned char)*c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+            json += escaped;
+        } else {
+            json += *c;
+        }
+    }
+    return json + "\"";
+}
+
+// microseconds, as Chrome wants trace times
+static long long microseconds(double seconds)
+{
+    return (long long)(seconds * 1e6 + 0.5);
+}
+
+
+#pragma mark - Tracer
+Tracer::Tracer(const Clock &clock, size_t maxEvents)
+    : _clock(clock), _maxEvents(maxEvents), _enabled(false), _epoch(clock.now()),
+      _nextSpanID(1), _numDropped(0)
+{
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+    _enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Tracer::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _epoch = _clock.now();
+    _events.clear();
+    _openSpans.clear();
+    _counters.clear();
+    _numDropped = 0;
+}
+
+size_t Tracer::numEvents() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _events.size();
+}
+
+size_t Tracer::numDropped() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numDropped;
+}
+
+Tracer::SpanID Tracer::recordBegin(const char *name)
+{
+    double now = _clock.now();
+    std::lock_guard<std::mutex> lock(_mutex);
+    SpanID span = _nextSpanID++;
+    OpenSpan open = {name, now - _epoch, currentThread()};
+    _openSpans[span] = open;
+    return span;
+}
+
+void Tracer::recordEnd(SpanID span)
+{
+    double now = _clock.now();
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // cleared since it began
+    std::map<SpanID, OpenSpan>::iterator it = _openSpans.find(span);
+    if (it == _openSpans.end()) return;
+
+    Event event = {EventSpan, it->second.name, it->second.start, (now - _epoch) - it->second.start, it->second.thread};
+    _openSpans.erase(it);
+    pushEvent(event);
+}
+
+void Tracer::recordCounter(const char *name, double delta)
+{
+    double now = _clock.now();
+    std::lock_guard<std::mutex> lock(_mutex);
+    double &total = _counters[name];
+    total += delta;
+    Event event = {EventCounter, name, now - _epoch, total, currentThread()};
+    pushEvent(event);
+}
+
+void Tracer::recordHistogram(const char *name, double value)
+{
+    double now = _clock.now();
+    std::lock_guard<std::mutex> lock(_mutex);
+    Event event = {EventValue, name, now - _epoch, value, currentThread()};
+    pushEvent(event);
+}
+
+/**
+ * Keep an event if there's room. Call with the lock held.
+ */
+void Tracer::pushEvent(const Event &event)
+{
+    if (_events.size() >= _maxEvents) {
+        ++_numDropped;
+        return;
+    }
+    _events.push_back(event);
+}
+
+/**
+ * Small number for the calling thread, 1 for the first seen. Call with the
+ * lock held.
+ */
+unsigned Tracer::currentThread()
+{
+    std::thread::id threadID = std::this_thread::get_id();
+    std::map<std::thread::id, unsigned>::iterator it = _threads.find(threadID);
+    if (it != _threads.end()) return it->second;
+
+    unsigned thread = (unsigned)_threads.size() + 1;
+    _threads[threadID] = thread;
+    return thread;
+}
+
+std::vector<TraceMetric> Tracer::summary() const
+{
+    // the same name may be different pointers from different files, so group
+    // by the string
+    std::map<std::string, std::pair<TraceMetric::Kind, std::vector<double> > > values;
+    std::map<std::string, double> counters;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t i = 0; i < _events.size(); ++i) {
+            const Event &event = _events[i];
+            std::pair<TraceMetric::Kind, std::vector<double> > &entry = values[event.name];
+            switch (event.kind) {
+                case EventSpan:     entry.first = TraceMetric::KindSpan; break;
+                case EventCounter:  entry.first = TraceMetric::KindCounter; break;
+                case EventValue:    entry.first = TraceMetric::KindHistogram; break;
+            }
+            entry.second.push_back(event.value);
+        }
+        counters = _counters;
+    }
+
+    std::vector<TraceMetric> metrics;
+    for (std::map<std::string, std::pair<TraceMetric::Kind, std::vector<double> > >::iterator it = values.begin();
+         it != values.end(); ++it) {
+        TraceMetric metric;
+        metric.name = it->first;
+        metric.kind = it->second.first;
+        std::vector<double> &sorted = it->second.second;
+        metric.count = (unsigned)sorted.size();
+
+        if (metric.kind == TraceMetric::KindCounter) {
+            // the running totals say nothing about the increments' spread
+            metric.total = counters[it->first];
+        } else {
+            std::sort(sorted.begin(), sorted.end());
+            for (size_t i = 0; i < sorted.size(); ++i) metric.total += sorted[i];
+            metric.mean = metric.total / sorted.size();
+            metric.p50 = percentile(sorted, 0.5);
+            metric.p90 = percentile(sorted, 0.9);
+            metric.p99 = percentile(sorted, 0.99);
+            metric.max = sorted.back();
+        }
+        metrics.push_back(metric);
+    }
+    return metrics;
+}
+
+void Tracer::writeChromeTrace(std::ostream &out) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    out << "{\"traceEvents\":[";
+    for (size_t i = 0; i < _events.size(); ++i) {
+        const Event &event = _events[i];
+        if (i) out << ",";
+        out << "\n{\"name\":" << jsonString(event.name) << ",\"cat\":\"retrac\",\"pid\":1,\"tid\":" << event.thread
+            << ",\"ts\":" << microseconds(event.time);
+        switch (event.kind) {
+            case EventSpan:
+                out << ",\"ph\":\"X\",\"dur\":" << microseconds(event.value) << "}";
+                break;
+            case EventCounter:
+                out << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}}";
+                break;
+            case EventValue:
+                out << ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"value\":" << event.value << "}}";
+                break;
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":" << _numDropped << "}}\n";
+}
+
+void Tracer::writeSummary(std::ostream &out) const
+{
+    std::vector<TraceMetric> metrics = summary();
+
+    char line[256];
+    snprintf(line, sizeof(line), "%-32s %8s %10s %10s %10s %10s %10s\n", "name", "count", "mean", "p50", "p90", "p99", "max");
+    out << line;
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        const TraceMetric &metric = metrics[i];
+        if (metric.kind == TraceMetric::KindCounter) {
+            snprintf(line, sizeof(line), "%-32s %8u %10s total %g\n", metric.name.c_str(), metric.count, "", metric.total);
+        } else {
+            // span times read better in milliseconds
+            double scale = (metric.kind == TraceMetric::KindSpan) ? 1e3 : 1.0;
+            snprintf(line, sizeof(line), "%-32s %8u %10.3f %10.3f %10.3f %10.3f %10.3f%s\n", metric.name.c_str(),
+                     metric.count, metric.mean * scale, metric.p50 * scale, metric.p90 * scale, metric.p99 * scale,
+                     metric.max * scale, (metric.kind == TraceMetric::KindSpan) ? " ms" : "");
+        }
+        out << line;
+    }
+    if (numDropped()) out << numDropped() << " events dropped\n";
+}
+
+Tracer &Tracer::sharedTracer()
+{
+    static Tracer sharedInstance(SteadyClock::sharedClock());
+    return sharedInstance;
+}
+
+} // namespace rtc
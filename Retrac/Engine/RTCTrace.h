@@ -0,0 +1,202 @@
+//
+//  RTCTrace.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/25/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCTrace_h
+#define Retrac_RTCTrace_h
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "RTCClock.h"
+
+namespace rtc {
+
+/**
+ * What a named span, counter or histogram added up to. Span values are
+ * durations in seconds; histogram values are whatever was recorded.
+ */
+struct TraceMetric {
+    enum Kind {
+        KindSpan,
+        KindCounter,
+        KindHistogram
+    };
+
+    std::string name;
+    Kind kind;
+    unsigned count;         // spans ended, counter increments or values recorded
+    double total;           // a counter's value
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+
+    TraceMetric() : kind(KindSpan), count(0), total(0), mean(0), p50(0), p90(0), p99(0), max(0) {}
+};
+
+/**
+ * Nearest-rank percentile of values already sorted in ascending order, 0 if
+ * there are none. The replays sum up their runs with it too.
+ *
+ * @param p     fraction, 0.9 for the 90th percentile
+ */
+double percentile(const std::vector<double> &sorted, double p);
+
+/**
+ * Tracer records where time goes: named spans, counters and histograms, kept
+ * in memory till they are written out as a Chrome trace (chrome://tracing or
+ * Perfetto) or summed up as percentiles.
+ *
+ * It is off by default, and while off every call is one relaxed atomic load
+ * and a branch: no clock read, lock or allocation. While on, calls take a
+ * lock, so any thread can trace. Once maxEvents are held further events are
+ * dropped (and counted) rather than letting a forgotten trace eat memory.
+ *
+ * Names must be string literals (or otherwise outlive the tracer): only the
+ * pointer is kept.
+ */
+class Tracer {
+public:
+    typedef unsigned long long SpanID;
+
+    /**
+     * Span ID handed out while disabled. Ending it does nothing.
+     */
+    static const SpanID kNoSpan = 0;
+
+    /**
+     * @param clock     time source, must outlive the tracer
+     * @param maxEvents most events held before new ones are dropped
+     */
+    explicit Tracer(const Clock &clock, size_t maxEvents = 100000);
+
+    bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Turn recording on or off. Spans begun while on still end after it's off.
+     */
+    void setEnabled(bool enabled);
+
+    /**
+     * Start a span, which may end on another thread (e.g. in a completion
+     * handler).
+     *
+     * @return ID to end the span with, kNoSpan if disabled.
+     */
+    SpanID beginSpan(const char *name) { return enabled() ? recordBegin(name) : kNoSpan; }
+
+    void endSpan(SpanID span) { if (span != kNoSpan) recordEnd(span); }
+
+    /**
+     * Add delta to a counter
+     */
+    void addCounter(const char *name, double delta = 1.0) { if (enabled()) recordCounter(name, delta); }
+
+    /**
+     * Record a value (a size, an accuracy, a latency measured elsewhere) in a
+     * histogram
+     */
+    void recordValue(const char *name, double value) { if (enabled()) recordHistogram(name, value); }
+
+    /**
+     * Drop everything recorded, including spans still open
+     */
+    void clear();
+
+    size_t numEvents() const;
+    size_t numDropped() const;
+
+    /**
+     * Everything recorded so far, summed up by name, sorted by name
+     */
+    std::vector<TraceMetric> summary() const;
+
+    /**
+     * Write everything recorded so far in Chrome's trace event format
+     */
+    void writeChromeTrace(std::ostream &out) const;
+
+    /**
+     * Write summary() as a table, span times in milliseconds
+     */
+    void writeSummary(std::ostream &out) const;
+
+    /**
+     * Shared instance on the steady clock, which the app traces to
+     */
+    static Tracer &sharedTracer();
+
+private:
+    enum EventKind {
+        EventSpan,
+        EventCounter,
+        EventValue
+    };
+
+    struct Event {
+        EventKind kind;
+        const char *name;
+        double time;        // seconds since the tracer's epoch
+        double value;       // span duration, counter total or recorded value
+        unsigned thread;
+    };
+
+    struct OpenSpan {
+        const char *name;
+        double start;
+        unsigned thread;
+    };
+
+    SpanID recordBegin(const char *name);
+    void recordEnd(SpanID span);
+    void recordCounter(const char *name, double delta);
+    void recordHistogram(const char *name, double value);
+    void pushEvent(const Event &event);
+    unsigned currentThread();
+
+    const Clock &_clock;
+    size_t _maxEvents;
+    std::atomic<bool> _enabled;
+
+    mutable std::mutex _mutex;
+    double _epoch;
+    std::vector<Event> _events;
+    std::map<SpanID, OpenSpan> _openSpans;
+    std::map<std::string, double> _counters;
+    std::map<std::thread::id, unsigned> _threads;
+    SpanID _nextSpanID;
+    size_t _numDropped;
+};
+
+/**
+ * TraceScope spans its own lifetime, for code that starts and finishes in one
+ * block:
+ *
+ *     rtc::TraceScope scope(rtc::Tracer::sharedTracer(), "index.rebuild");
+ */
+class TraceScope {
+public:
+    TraceScope(Tracer &tracer, const char *name) : _tracer(tracer), _span(tracer.beginSpan(name)) {}
+    ~TraceScope() { _tracer.endSpan(_span); }
+
+private:
+    Tracer &_tracer;
+    Tracer::SpanID _span;
+};
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,219 @@
+//
+//  RTCTrail.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/13/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCTrail.h"
+#include <algorithm>
+#include <cmath>
+
+namespace rtc {
+
+#pragma mark - Constants
+static const uint32_t kTrailFileMagic = 0x4c525452; // "RTRL"
+static const uint16_t kTrailFileVersion = 1;
+
+// fixed-point scales of the stored record fields
+static const double kCoordinateScale = 1e7;         // 1e-7 degrees
+static const double kTimeScale = 1e3;               // milliseconds
+static const double kAccuracyScale = 10.0;          // decimeters
+
+
+#pragma mark - Helpers
+/**
+ * Distance (meters) from point (px, py) to the segment from the origin to
+ * (ex, ey)
+ */
+static double distanceToSegment(double px, double py, double ex, double ey)
+{
+    double lengthSquared = ex * ex + ey * ey;
+    double t = (lengthSquared > 0) ? (px * ex + py * ey) / lengthSquared : 0.0;
+    t = std::max(0.0, std::min(1.0, t));
+    double dx = px - t * ex;
+    double dy = py - t * ey;
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+template <typename T>
+static T clampedRound(double value, double low, double high)
+{
+    return (T)std::llround(std::max(low, std::min(high, value)));
+}
+
+
+#pragma mark - TrailSimplifier
+TrailSimplifier::TrailSimplifier(const TrailPolicy &policy)
+    : _policy(policy)
+{
+    reset();
+}
+
+void TrailSimplifier::reset()
+{
+    _hasAnchor = false;
+    _anchor = TrailPoint();
+    _window.clear();
+    _window.reserve(_policy.maxWindow);
+    _hasLastKept = false;
+    _lastKept = TrailPoint();
+    _numFixesReceived = 0;
+    _numFixesKept = 0;
+    _numCommitted = 0;
+}
+
+bool TrailSimplifier::addFix(const LocationFix &fix, Trail &committed)
+{
+    ++_numFixesReceived;
+
+    // filter out invalid, inaccurate and out of order fixes
+    if ((fix.horizontalAccuracy < 0) || (fix.horizontalAccuracy > _policy.maxAccuracy)) return false;
+
+    TrailPoint point(fix.timestamp, GeoPoint(fix.latitude, fix.longitude), fix.horizontalAccuracy);
+    if (_hasLastKept) {
+        if (point.timestamp <= _lastKept.timestamp) return false;
+        // standing still just produces jitter
+        if (distanceBetween(_lastKept.coordinate, point.coordinate) < _policy.minSpacing) return false;
+    }
+    _lastKept = point;
+    _hasLastKept = true;
+    ++_numFixesKept;
+
+    if (!_hasAnchor) {
+        commit(point, committed);
+        return true;
+    }
+
+    if (windowFits(point)) {
+        _window.push_back(point);
+        // cap the window so each fix stays O(1) however straight the walk
+        if (_window.size() >= _policy.maxWindow) commit(_window.back(), committed);
+
+    } else {
+        // the previous fix is as far as the segment could go
+        TrailPoint corner = _window.back();
+        commit(corner, committed);
+        _window.push_back(point);
+    }
+    return true;
+}
+
+void TrailSimplifier::finish(Trail &committed)
+{
+    if (!_window.empty()) commit(_window.back(), committed);
+}
+
+bool TrailSimplifier::pendingTail(TrailPoint *tail) const
+{
+    if (_window.empty()) return false;
+    if (tail) *tail = _window.back();
+    return true;
+}
+
+/**
+ * Make point a vertex and open a new window there
+ */
+void TrailSimplifier::commit(const TrailPoint &point, Trail &committed)
+{
+    committed.push_back(point);
+    ++_numCommitted;
+    _anchor = point;
+    _hasAnchor = true;
+    _window.clear();
+}
+
+/**
+ * Does every fix in the window lie within tolerance of the segment from the
+ * anchor to end?
+ */
+bool TrailSimplifier::windowFits(const TrailPoint &end) const
+{
+    // an empty window always fits, any single segment is exact
+    if (_window.empty()) return true;
+
+    double ex, ey;
+    localOffset(_anchor.coordinate, end.coordinate, &ex, &ey);
+    for (size_t i = 0; i < _window.size(); ++i) {
+        double px, py;
+        localOffset(_anchor.coordinate, _window[i].coordinate, &px, &py);
+        if (distanceToSegment(px, py, ex, ey) > _policy.tolerance) return false;
+    }
+    return true;
+}
+
+
+#pragma mark - Serialization
+void writeTrailHeader(std::ostream &output, double startTime)
+{
+    uint16_t recordSize = kTrailFileRecordSize;
+    output.write((const char *)&kTrailFileMagic, sizeof(kTrailFileMagic));
+    output.write((const char *)&kTrailFileVersion, sizeof(kTrailFileVersion));
+    output.write((const char *)&recordSize, sizeof(recordSize));
+    output.write((const char *)&startTime, sizeof(startTime));
+}
+
+void appendTrailPoints(std::ostream &output, double startTime, const Trail &points)
+{
+    for (size_t i = 0; i < points.size(); ++i) {
+        const TrailPoint &point = points[i];
+        int32_t latitude = clampedRound<int32_t>(point.coordinate.latitude * kCoordinateScale, -9e8, 9e8);
+        int32_t longitude = clampedRound<int32_t>(point.coordinate.longitude * kCoordinateScale, -18e8, 18e8);
+        uint32_t time = clampedRound<uint32_t>((point.timestamp - startTime) * kTimeScale, 0, UINT32_MAX);
+        uint16_t accuracy = clampedRound<uint16_t>(point.horizontalAccuracy * kAccuracyScale, 0, UINT16_MAX);
+        uint16_t reserved = 0;
+
+        output.write((const char *)&latitude, sizeof(latitude));
+        output.write((const char *)&longitude, sizeof(longitude));
+        output.write((const char *)&time, sizeof(time));
+        output.write((const char *)&accuracy, sizeof(accuracy));
+        output.write((const char *)&reserved, sizeof(reserved));
+    }
+}
+
+bool readTrail(std::istream &input, Trail &trail, double *startTime)
+{
+    uint32_t magic = 0;
+    uint16_t version = 0, recordSize = 0;
+    double start = 0;
+    input.read((char *)&magic, sizeof(magic));
+    input.read((char *)&version, sizeof(version));
+    input.read((char *)&recordSize, sizeof(recordSize));
+    input.read((char *)&start, sizeof(start));
+    if (!input || (magic != kTrailFileMagic) || (version != kTrailFileVersion) ||
+        (recordSize != kTrailFileRecordSize)) {
+        return false;
+    }
+
+    trail.clear();
+    while (true) {
+        int32_t latitude, longitude;
+        uint32_t time;
+        uint16_t accuracy, reserved;
+        input.read((char *)&latitude, sizeof(latitude));
+        input.read((char *)&longitude, sizeof(longitude));
+        input.read((char *)&time, sizeof(time));
+        input.read((char *)&accuracy, sizeof(accuracy));
+        input.read((char *)&reserved, sizeof(reserved));
+        if (!input) break;
+
+        trail.push_back(TrailPoint(start + time / kTimeScale,
+                                   GeoPoint(latitude / kCoordinateScale, longitude / kCoordinateScale),
+                                   accuracy / kAccuracyScale));
+    }
+
+    if (startTime) *startTime = start;
+    return true;
+}
+
+double trailLength(const Trail &trail)
+{
+    double length = 0;
+    for (size_t i = 1; i < trail.size(); ++i) {
+        length += distanceBetween(trail[i - 1].coordinate, trail[i].coordinate);
+    }
+    return length;
+}
+
+} // namespace rtc
@@ -0,0 +1,170 @@
+//
+//  RTCTrail.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/13/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCTrail_h
+#define Retrac_RTCTrail_h
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include "RTCGeo.h"
+#include "RTCLocationFixEngine.h"
+
+namespace rtc {
+
+/**
+ * TrailPoint is one vertex of a recorded breadcrumb trail
+ */
+struct TrailPoint {
+    double timestamp;           // seconds, same epoch as the fixes
+    GeoPoint coordinate;
+    double horizontalAccuracy;  // meters
+
+    TrailPoint() : timestamp(0), horizontalAccuracy(-1) {}
+    TrailPoint(double t, const GeoPoint &aCoordinate, double accuracy)
+        : timestamp(t), coordinate(aCoordinate), horizontalAccuracy(accuracy) {}
+};
+
+typedef std::vector<TrailPoint> Trail;
+
+/**
+ * TrailPolicy holds the knobs that trade trail fidelity for storage.
+ * The default values mirror the trail settings in RTCConstants.m
+ */
+struct TrailPolicy {
+    double maxAccuracy;         // kRTCTrailMaxAccuracy
+    double minSpacing;          // kRTCTrailMinSpacing
+    double tolerance;           // kRTCTrailTolerance
+    unsigned maxWindow;         // kRTCTrailMaxWindow
+
+    TrailPolicy()
+        : maxAccuracy(50.0), minSpacing(5.0), tolerance(10.0), maxWindow(64) {}
+};
+
+/**
+ * TrailSimplifier turns a stream of fixes into a simplified polyline as they
+ * arrive, so a trail stays small however long the walk.
+ *
+ * Each fix goes through two stages:
+ * - A filter drops fixes that are invalid, older than the last one, less
+ *   accurate than policy.maxAccuracy, or within policy.minSpacing of the last
+ *   kept fix (GPS jitter while standing still).
+ * - An opening-window simplifier (the streaming form of Douglas-Peucker) keeps
+ *   extending a segment from the last committed vertex while every fix since
+ *   then lies within policy.tolerance of it. When a fix breaks the corridor,
+ *   the fix before it is committed as a vertex and a new window opens there.
+ *
+ * The window is capped at policy.maxWindow fixes, so each fix costs O(1)
+ * amortized and memory stays bounded. Every fix the filter kept ends up within
+ * policy.tolerance of the committed polyline.
+ */
+class TrailSimplifier {
+public:
+    explicit TrailSimplifier(const TrailPolicy &policy = TrailPolicy());
+
+    const TrailPolicy &policy() const { return _policy; }
+
+    /**
+     * Start a new trail, dropping any uncommitted fixes.
+     */
+    void reset();
+
+    /**
+     * Feed a fix from the location provider.
+     *
+     * @param fix           the new fix
+     * @param committed     vertices that became final are appended here
+     *
+     * @return false if the filter dropped the fix.
+     */
+    bool addFix(const LocationFix &fix, Trail &committed);
+
+    /**
+     * Commit the fix still pending at the end of the window, if any. Call
+     * this when recording stops.
+     */
+    void finish(Trail &committed);
+
+    /**
+     * Most recent kept fix that isn't committed yet, for drawing the live end
+     * of the trail.
+     *
+     * @return false if there is none.
+     */
+    bool pendingTail(TrailPoint *tail) const;
+
+    /**
+     * Number of fixes fed, and kept by the filter, since reset().
+     */
+    size_t numFixesReceived() const { return _numFixesReceived; }
+    size_t numFixesKept() const { return _numFixesKept; }
+
+    /**
+     * Number of vertices committed since reset()
+     */
+    size_t numCommitted() const { return _numCommitted; }
+
+private:
+    void commit(const TrailPoint &point, Trail &committed);
+    bool windowFits(const TrailPoint &end) const;
+
+    TrailPolicy _policy;
+
+    bool _hasAnchor;
+    TrailPoint _anchor;             // last committed vertex
+    std::vector<TrailPoint> _window;// kept fixes since the anchor
+    bool _hasLastKept;
+    TrailPoint _lastKept;
+
+    size_t _numFixesReceived;
+    size_t _numFixesKept;
+    size_t _numCommitted;
+};
+
+/**
+ * Trail files are append-only: a fixed header followed by fixed-size records,
+ * so a recorder can append vertices as they are committed without rewriting
+ * anything.
+ *
+ * Each record is 16 bytes: latitude and longitude in 1e-7 degrees (about 1cm),
+ * milliseconds since the trail's start time, and accuracy in decimeters.
+ */
+static const size_t kTrailFileHeaderSize = 16;
+static const size_t kTrailFileRecordSize = 16;
+
+/**
+ * Write the header of a new trail file.
+ *
+ * @param startTime     timestamps are stored relative to this
+ */
+void writeTrailHeader(std::ostream &output, double startTime);
+
+/**
+ * Append trail points to a file written by writeTrailHeader().
+ */
+void appendTrailPoints(std::ostream &output, double startTime, const Trail &points);
+
+/**
+ * Read a trail file. A partial record at the end (an interrupted append) is
+ * ignored.
+ *
+ * @return false if the stream is short or not a trail file.
+ */
+bool readTrail(std::istream &input, Trail &trail, double *startTime = 0);
+
+/**
+ * Length of a polyline in meters
+ */
+double trailLength(const Trail &trail);
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,102 @@
+//
+//  RTCVarint.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 9/4/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/CoreLocation here so this can
+//  be compiled and exercised headlessly.
+
+#ifndef Retrac_RTCVarint_h
+#define Retrac_RTCVarint_h
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+
+namespace rtc {
+
+/**
+ * Varints as in protocol buffers (LEB128): 7 bits a byte, low bits first, the
+ * top bit set on all but the last byte. Signed values are zigzagged first so
+ * small negative ones stay small. The place archive, the sync log and encoded
+ * polylines all use these, so their formats are tied to this one copy.
+ */
+inline uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+inline void appendVarint(std::string &buffer, uint64_t value)
+{
+    while (value >= 0x80) {
+        buffer.push_back((char)((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back((char)value);
+}
+
+inline void appendSignedVarint(std::string &buffer, int64_t value)
+{
+    appendVarint(buffer, zigzag(value));
+}
+
+/**
+ * Parse a varint at cursor, moving cursor past it.
+ *
+ * @return false if the buffer ends first or it runs past 64 bits.
+ */
+inline bool parseVarint(const char *&cursor, const char *end, uint64_t *value)
+{
+    uint64_t result = 0;
+    for (int shift = 0; (cursor < end) && (shift < 64); shift += 7) {
+        uint8_t byte = (uint8_t)*cursor++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool parseSignedVarint(const char *&cursor, const char *end, int64_t *value)
+{
+    uint64_t zigzagged;
+    if (!parseVarint(cursor, end, &zigzagged)) return false;
+    *value = unzigzag(zigzagged);
+    return true;
+}
+
+/**
+ * Varint straight from a stream, for record lengths
+ *
+ * @param numBytes  set to the number of bytes read
+ */
+inline bool readVarint(std::istream &input, uint64_t *value, size_t *numBytes)
+{
+    uint64_t result = 0;
+    *numBytes = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = input.get();
+        if (byte == std::char_traits<char>::eof()) return false;
+        (*numBytes)++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace rtc
+
+#endif
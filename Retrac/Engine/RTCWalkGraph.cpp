@@ -0,0 +1,539 @@
+//
+//  RTCWalkGraph.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/15/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCWalkGraph.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+namespace rtc {
+
+#pragma mark - Constants
+static const uint32_t kGraphFileMagic = 0x47575452; // "RTWG"
+static const uint32_t kGraphFileVersion = 1;
+
+// fixed-point scale of stored coordinates
+static const double kCoordinateScale = 1e7;         // 1e-7 degrees
+
+// meters per degree of latitude, for sizing cells
+static const double kMetersPerDegree = kEarthRadius * kDegreesToRadians;
+
+// keep the snapping grid to a sane size however big the extract
+static const double kMaxGridCells = 4e6;
+
+/**
+ * Graph file header. The sections follow it in this order: nodes, first edges
+ * (numNodes + 1), edges, cell starts (columns * rows + 1), name offsets
+ * (numNames + 1), names (padded to 4 bytes).
+ */
+struct GraphFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numNodes;
+    uint32_t numEdges;
+    uint32_t numNames;
+    uint32_t nameBytes;
+    uint32_t gridColumns;
+    uint32_t gridRows;
+    double gridLatitude;
+    double gridLongitude;
+    double cellLatitude;
+    double cellLongitude;
+};
+
+
+#pragma mark - Helpers
+template <typename T>
+static void writeArray(std::ostream &output, const std::vector<T> &values)
+{
+    if (!values.empty()) output.write((const char *)&values[0], values.size() * sizeof(T));
+}
+
+static size_t paddedSize(size_t size)
+{
+    return (size + 3) & ~(size_t)3;
+}
+
+
+#pragma mark - WalkGraph
+WalkGraph::WalkGraph()
+    : _size(0), _numNodes(0), _numEdges(0), _numNames(0), _gridColumns(0), _gridRows(0),
+      _gridLatitude(0), _gridLongitude(0), _cellLatitude(0), _cellLongitude(0),
+      _nodes(0), _firstEdges(0), _edges(0), _cellStarts(0), _nameOffsets(0), _names(0)
+{
+}
+
+bool WalkGraph::attach(const void *data, size_t size)
+{
+    GraphFileHeader header;
+    if (size < sizeof(header)) return false;
+    std::memcpy(&header, data, sizeof(header));
+    if ((header.magic != kGraphFileMagic) || (header.version != kGraphFileVersion)) return false;
+
+    // section sizes, checked in 64 bits so a corrupt header can't overflow
+    uint64_t numCells = (uint64_t)header.gridColumns * header.gridRows;
+    uint64_t expected = sizeof(header) +
+                        (uint64_t)header.numNodes * sizeof(Node) +
+                        ((uint64_t)header.numNodes + 1) * sizeof(uint32_t) +
+                        (uint64_t)header.numEdges * sizeof(Edge) +
+                        (numCells + 1) * sizeof(uint32_t) +
+                        ((uint64_t)header.numNames + 1) * sizeof(uint32_t) +
+                        paddedSize(header.nameBytes);
+    if ((expected != size) || (header.numNames == 0)) return false;
+
+    const char *bytes = (const char *)data + sizeof(header);
+    _nodes = (const Node *)bytes;
+    bytes += header.numNodes * sizeof(Node);
+    _firstEdges = (const uint32_t *)bytes;
+    bytes += (header.numNodes + 1) * sizeof(uint32_t);
+    _edges = (const Edge *)bytes;
+    bytes += header.numEdges * sizeof(Edge);
+    _cellStarts = (const uint32_t *)bytes;
+    bytes += (numCells + 1) * sizeof(uint32_t);
+    _nameOffsets = (const uint32_t *)bytes;
+    bytes += (header.numNames + 1) * sizeof(uint32_t);
+    _names = bytes;
+
+    if ((_firstEdges[header.numNodes] != header.numEdges) || (_cellStarts[numCells] != header.numNodes) ||
+        (_nameOffsets[header.numNames] > header.nameBytes)) {
+        _numNodes = 0;
+        return false;
+    }
+
+    _size = size;
+    _numNodes = header.numNodes;
+    _numEdges = header.numEdges;
+    _numNames = header.numNames;
+    _gridColumns = header.gridColumns;
+    _gridRows = header.gridRows;
+    _gridLatitude = header.gridLatitude;
+    _gridLongitude = header.gridLongitude;
+    _cellLatitude = header.cellLatitude;
+    _cellLongitude = header.cellLongitude;
+    return true;
+}
+
+bool WalkGraph::read(std::istream &input)
+{
+    std::vector<char> storage((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    if (storage.empty() || !attach(&storage[0], storage.size())) return false;
+
+    // vector storage doesn't move when the vector does
+    _storage.swap(storage);
+    return true;
+}
+
+GeoPoint WalkGraph::coordinate(NodeID node) const
+{
+    return GeoPoint(_nodes[node].latitude / kCoordinateScale, _nodes[node].longitude / kCoordinateScale);
+}
+
+const char *WalkGraph::name(uint32_t index) const
+{
+    if (index >= _numNames) return "";
+    return _names + _nameOffsets[index];
+}
+
+/**
+ * Grid cell of point. It may lie outside the grid.
+ */
+bool WalkGraph::cellOf(const GeoPoint &point, int64_t *column, int64_t *row) const
+{
+    *column = (int64_t)std::floor((point.longitude - _gridLongitude) / _cellLongitude);
+    *row = (int64_t)std::floor((point.latitude - _gridLatitude) / _cellLatitude);
+    return (*column >= 0) && (*column < _gridColumns) && (*row >= 0) && (*row < _gridRows);
+}
+
+bool WalkGraph::nearestNode(const GeoPoint &point, double maxDistance, NodeID *node, double *distance) const
+{
+    if (empty()) return false;
+
+    int64_t column, row;
+    cellOf(point, &column, &row);
+
+    // anything in ring r + 1 of cells around point's cell is at least r cells away
+    double cellMeters = std::min(_cellLatitude * kMetersPerDegree,
+                                 _cellLongitude * kMetersPerDegree * std::cos(point.latitude * kDegreesToRadians));
+    int64_t maxRing = (int64_t)std::ceil(maxDistance / cellMeters) + 1;
+    maxRing = std::min(maxRing, (int64_t)std::max(_gridColumns, _gridRows) + std::max(std::abs(column), std::abs(row)));
+
+    bool found = false;
+    double bestDistance = maxDistance;
+    for (int64_t ring = 0; ring <= maxRing; ++ring) {
+        if (found && (bestDistance <= (ring - 1) * cellMeters)) break;
+
+        for (int64_t r = row - ring; r <= row + ring; ++r) {
+            if ((r < 0) || (r >= _gridRows)) continue;
+            // interior rows only have the two edge cells of the ring
+            int64_t step = ((r == row - ring) || (r == row + ring)) ? 1 : std::max((int64_t)1, 2 * ring);
+            for (int64_t c = column - ring; c <= column + ring; c += step) {
+                if ((c < 0) || (c >= _gridColumns)) continue;
+
+                uint64_t cell = (uint64_t)r * _gridColumns + c;
+                for (uint32_t n = _cellStarts[cell]; n < _cellStarts[cell + 1]; ++n) {
+                    double d = distanceBetween(point, coordinate(n));
+                    if (d <= bestDistance) {
+                        bestDistance = d;
+                        *node = n;
+                        found = true;
+                    }
+                }
+            }
+        }
+    }
+
+    if (found && distance) *distance = bestDistance;
+    return found;
+}
+
+
+#pragma mark - WalkGraphBuilder
+void WalkGraphBuilder::addNode(int64_t nodeID, const GeoPoint &coordinate)
+{
+    _nodes[nodeID] = coordinate;
+}
+
+void WalkGraphBuilder::addWay(const std::vector<int64_t> &nodeIDs, const std::string &name)
+{
+    std::map<std::string, uint32_t>::iterator found = _nameIndices.find(name);
+    uint32_t nameIndex;
+    if (found != _nameIndices.end()) {
+        nameIndex = found->second;
+    } else {
+        nameIndex = (uint32_t)_names.size();
+        _names.push_back(name);
+        _nameIndices[name] = nameIndex;
+    }
+
+    // skip over nodes we don't know, joining up the ones either side
+    int64_t previous = 0;
+    bool hasPrevious = false;
+    for (size_t i = 0; i < nodeIDs.size(); ++i) {
+        if (!_nodes.count(nodeIDs[i])) continue;
+        if (hasPrevious && (previous != nodeIDs[i])) {
+            Segment segment = {previous, nodeIDs[i], nameIndex};
+            _segments.push_back(segment);
+        }
+        previous = nodeIDs[i];
+        hasPrevious = true;
+    }
+    ++_numWays;
+}
+
+bool WalkGraphBuilder::write(std::ostream &output, double cellSize) const
+{
+    // number the nodes used by a segment
+    std::unordered_map<int64_t, uint32_t> indices;
+    std::vector<GeoPoint> coordinates;
+    for (size_t i = 0; i < _segments.size(); ++i) {
+        int64_t ends[] = {_segments[i].from, _segments[i].to};
+        for (int e = 0; e < 2; ++e) {
+            if (indices.count(ends[e])) continue;
+            indices[ends[e]] = (uint32_t)coordinates.size();
+            coordinates.push_back(_nodes.find(ends[e])->second);
+        }
+    }
+
+    // lay a grid over them
+    GraphFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = kGraphFileMagic;
+    header.version = kGraphFileVersion;
+    header.numNodes = (uint32_t)coordinates.size();
+
+    double south = 0, west = 0, north = 0, east = 0;
+    for (size_t i = 0; i < coordinates.size(); ++i) {
+        const GeoPoint &p = coordinates[i];
+        if ((i == 0) || (p.latitude < south)) south = p.latitude;
+        if ((i == 0) || (p.latitude > north)) north = p.latitude;
+        if ((i == 0) || (p.longitude < west)) west = p.longitude;
+        if ((i == 0) || (p.longitude > east)) east = p.longitude;
+    }
+    double middle = (south + north) * 0.5;
+    double cellLatitude = cellSize / kMetersPerDegree;
+    double cellLongitude = cellSize / (kMetersPerDegree * std::max(0.01, std::cos(middle * kDegreesToRadians)));
+    double numCells = (std::floor((north - south) / cellLatitude) + 1) * (std::floor((east - west) / cellLongitude) + 1);
+    if (numCells > kMaxGridCells) {
+        double scale = std::sqrt(numCells / kMaxGridCells) + 0.01;
+        cellLatitude *= scale;
+        cellLongitude *= scale;
+    }
+    header.gridLatitude = south;
+    header.gridLongitude = west;
+    header.cellLatitude = cellLatitude;
+    header.cellLongitude = cellLongitude;
+    header.gridColumns = coordinates.empty() ? 0 : (uint32_t)std::floor((east - west) / cellLongitude) + 1;
+    header.gridRows = coordinates.empty() ? 0 : (uint32_t)std::floor((north - south) / cellLatitude) + 1;
+
+    // order nodes by cell so each cell is a contiguous run
+    std::vector<uint32_t> cells(coordinates.size());
+    std::vector<uint32_t> order(coordinates.size());
+    for (size_t i = 0; i < coordinates.size(); ++i) {
+        uint32_t column = std::min(header.gridColumns - 1, (uint32_t)((coordinates[i].longitude - west) / cellLongitude));
+        uint32_t row = std::min(header.gridRows - 1, (uint32_t)((coordinates[i].latitude - south) / cellLatitude));
+        cells[i] = row * header.gridColumns + column;
+        order[i] = (uint32_t)i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&cells](uint32_t a, uint32_t b) { return cells[a] < cells[b]; });
+
+    std::vector<uint32_t> rank(coordinates.size());
+    std::vector<WalkGraph::Node> nodes(coordinates.size());
+    std::vector<uint32_t> cellStarts((size_t)header.gridColumns * header.gridRows + 1, 0);
+    for (size_t i = 0; i < order.size(); ++i) {
+        rank[order[i]] = (uint32_t)i;
+        nodes[i].latitude = (int32_t)std::llround(coordinates[order[i]].latitude * kCoordinateScale);
+        nodes[i].longitude = (int32_t)std::llround(coordinates[order[i]].longitude * kCoordinateScale);
+        ++cellStarts[cells[order[i]] + 1];
+    }
+    for (size_t c = 1; c < cellStarts.size(); ++c) cellStarts[c] += cellStarts[c - 1];
+
+    // both directions of every segment, grouped by source node
+    struct DirectedEdge {
+        uint32_t source;
+        WalkGraph::Edge edge;
+        bool operator<(const DirectedEdge &other) const {
+            if (source != other.source) return source < other.source;
+            if (edge.target != other.edge.target) return edge.target < other.edge.target;
+            return edge.length < other.edge.length;
+        }
+    };
+    std::vector<DirectedEdge> directed;
+    directed.reserve(2 * _segments.size());
+    for (size_t i = 0; i < _segments.size(); ++i) {
+        uint32_t a = rank[indices[_segments[i].from]];
+        uint32_t b = rank[indices[_segments[i].to]];
+        if (a == b) continue;
+
+        DirectedEdge forward = {a, {b, 0, _segments[i].name}};
+        forward.edge.length = (float)distanceBetween(coordinates[order[a]], coordinates[order[b]]);
+        DirectedEdge backward = {b, {a, forward.edge.length, _segments[i].name}};
+        directed.push_back(forward);
+        directed.push_back(backward);
+    }
+    std::sort(directed.begin(), directed.end());
+
+    // ways sharing a segment only need it once, the shortest
+    std::vector<WalkGraph::Edge> edges;
+    std::vector<uint32_t> firstEdges(nodes.size() + 1, 0);
+    for (size_t i = 0; i < directed.size(); ++i) {
+        if ((i > 0) && (directed[i].source == directed[i - 1].source) &&
+            (directed[i].edge.target == directed[i - 1].edge.target)) continue;
+        edges.push_back(directed[i].edge);
+        ++firstEdges[directed[i].source + 1];
+    }
+    for (size_t n = 1; n < firstEdges.size(); ++n) firstEdges[n] += firstEdges[n - 1];
+    header.numEdges = (uint32_t)edges.size();
+
+    // name table; entry 0 is always there
+    std::vector<std::string> names(_names);
+    if (names.empty()) names.push_back("");
+    std::vector<uint32_t> nameOffsets;
+    std::string nameBytes;
+    for (size_t i = 0; i < names.size(); ++i) {
+        nameOffsets.push_back((uint32_t)nameBytes.size());
+        nameBytes.append(names[i].c_str(), names[i].size() + 1);
+    }
+    nameOffsets.push_back((uint32_t)nameBytes.size());
+    header.numNames = (uint32_t)names.size();
+    header.nameBytes = (uint32_t)nameBytes.size();
+    nameBytes.resize(paddedSize(nameBytes.size()), '\0');
+
+    output.write((const char *)&header, sizeof(header));
+    writeArray(output, nodes);
+    writeArray(output, firstEdges);
+    writeArray(output, edges);
+    writeArray(output, cellStarts);
+    writeArray(output, nameOffsets);
+    output.write(nameBytes.data(), nameBytes.size());
+    return (bool)output;
+}
+
+
+#pragma mark - OpenStreetMap Import
+typedef std::map<std::string, std::string> Attributes;
+
+static std::string unescapeXML(const std::string &text)
+{
+    if (text.find('&') == std::string::npos) return text;
+
+    static const char *const entities[][2] = {
+        {"&amp;", "&"}, {"&lt;", "<"}, {"&gt;", ">"}, {"&quot;", "\""}, {"&apos;", "'"}
+    };
+    std::string result;
+    for (size_t i = 0; i < text.size(); ) {
+        bool replaced = false;
+        if (text[i] == '&') {
+            for (size_t e = 0; e < sizeof(entities) / sizeof(entities[0]); ++e) {
+                size_t length = std::strlen(entities[e][0]);
+                if (text.compare(i, length, entities[e][0]) == 0) {
+                    result += entities[e][1];
+                    i += length;
+                    replaced = true;
+                    break;
+                }
+            }
+        }
+        if (!replaced) result += text[i++];
+    }
+    return result;
+}
+
+/**
+ * Split the inside of a start tag into its name and attributes
+ */
+static void parseTag(const std::string &tag, std::string &name, Attributes &attributes)
+{
+    attributes.clear();
+    size_t i = tag.find_first_of(" \t\r\n/");
+    name = tag.substr(0, i);
+
+    while (i < tag.size()) {
+        size_t keyStart = tag.find_first_not_of(" \t\r\n/", i);
+        if (keyStart == std::string::npos) break;
+        size_t equals = tag.find('=', keyStart);
+        if (equals == std::string::npos) break;
+        size_t quote = tag.find_first_of("\"'", equals);
+        if (quote == std::string::npos) break;
+        size_t valueEnd = tag.find(tag[quote], quote + 1);
+        if (valueEnd == std::string::npos) break;
+
+        std::string key = tag.substr(keyStart, tag.find_first_of(" \t\r\n=", keyStart) - keyStart);
+        attributes[key] = unescapeXML(tag.substr(quote + 1, valueEnd - quote - 1));
+        i = valueEnd + 1;
+    }
+}
+
+static std::string valueOf(const Attributes &attributes, const char *key)
+{
+    Attributes::const_iterator found = attributes.find(key);
+    return (found != attributes.end()) ? found->second : std::string();
+}
+
+static bool isWalkable(const Attributes &tags)
+{
+    std::string highway = valueOf(tags, "highway");
+    if (highway.empty()) return false;
+
+    std::string foot = valueOf(tags, "foot");
+    if (foot == "no") return false;
+    if ((foot == "yes") || (foot == "designated") || (foot == "permissive")) return true;
+
+    std::string access = valueOf(tags, "access");
+    if ((access == "no") || (access == "private")) return false;
+
+    static const char *const excluded[] = {
+        "motorway", "motorway_link", "trunk", "trunk_link", "construction", "proposed",
+        "raceway", "bus_guideway", "abandoned", "razed"
+    };
+    for (size_t i = 0; i < sizeof(excluded) / sizeof(excluded[0]); ++i) {
+        if (highway == excluded[i]) return false;
+    }
+    return true;
+}
+
+/**
+ * What directions should call a way: its name, else its ref, else its kind
+ */
+static std::string displayName(const Attributes &tags)
+{
+    std::string name = valueOf(tags, "name");
+    if (name.empty()) name = valueOf(tags, "ref");
+    if (!name.empty()) return name;
+
+    std::string highway = valueOf(tags, "highway");
+    std::string footway = valueOf(tags, "footway");
+    if (footway == "sidewalk") return "the sidewalk";
+    if (footway == "crossing") return "the crosswalk";
+    if (highway == "footway") return "the footpath";
+    if (highway == "path") return "the path";
+    if (highway == "steps") return "the steps";
+    if (highway == "pedestrian") return "the pedestrian street";
+    if (highway == "corridor") return "the corridor";
+    if (highway == "cycleway") return "the cycle path";
+    if (highway == "track") return "the track";
+    if (highway == "service") {
+        return (valueOf(tags, "service") == "parking_aisle") ? "the parking aisle" : "the service road";
+    }
+    return "the road";
+}
+
+bool importOSM(std::istream &input, WalkGraphBuilder &builder, OSMImportStats *stats, std::string *error)
+{
+    OSMImportStats counts;
+    bool sawRoot = false, inWay = false;
+    std::vector<int64_t> wayNodes;
+    Attributes wayTags, attributes;
+    std::string chunk, tag, name;
+
+    while (std::getline(input, chunk, '>')) {
+        size_t open = chunk.find('<');
+        if (open == std::string::npos) continue;
+        tag.assign(chunk, open + 1, std::string::npos);
+
+        // comments may contain '>', so read on to the real end
+        if (tag.compare(0, 3, "!--") == 0) {
+            while ((tag.size() < 5 || tag.compare(tag.size() - 2, 2, "--") != 0) && std::getline(input, chunk, '>')) {
+                tag += ">" + chunk;
+            }
+            continue;
+        }
+        if (tag.empty() || (tag[0] == '?') || (tag[0] == '!')) continue;
+
+        if (tag[0] == '/') {
+            if (inWay && (tag.compare(1, 3, "way") == 0)) {
+                if (isWalkable(wayTags)) {
+                    builder.addWay(wayNodes, displayName(wayTags));
+                    ++counts.numWalkableWays;
+                }
+                inWay = false;
+            }
+            continue;
+        }
+
+        bool selfClosing = (tag[tag.size() - 1] == '/');
+        parseTag(tag, name, attributes);
+
+        if (name == "osm") {
+            sawRoot = true;
+
+        } else if (name == "node") {
+            std::string latitude = valueOf(attributes, "lat");
+            std::string longitude = valueOf(attributes, "lon");
+            std::string nodeID = valueOf(attributes, "id");
+            if (latitude.empty() || longitude.empty() || nodeID.empty()) {
+                if (error) *error = "node without id, lat or lon";
+                return false;
+            }
+            builder.addNode(std::strtoll(nodeID.c_str(), 0, 10),
+                            GeoPoint(std::strtod(latitude.c_str(), 0), std::strtod(longitude.c_str(), 0)));
+            ++counts.numNodes;
+
+        } else if (name == "way") {
+            ++counts.numWays;
+            inWay = !selfClosing;
+            wayNodes.clear();
+            wayTags.clear();
+
+        } else if (inWay && (name == "nd")) {
+            wayNodes.push_back(std::strtoll(valueOf(attributes, "ref").c_str(), 0, 10));
+
+        } else if (inWay && (name == "tag")) {
+            wayTags[valueOf(attributes, "k")] = valueOf(attributes, "v");
+        }
+    }
+
+    if (!sawRoot) {
+        if (error) *error = "not an OpenStreetMap XML file";
+        return false;
+    }
+    if (stats) *stats = counts;
+    return true;
+}
+
+} // namespace rtc
@@ -0,0 +1,190 @@
+//
+//  RTCWalkGraph.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/15/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/MapKit here so this can be
+//  compiled and exercised headlessly.
+
+#ifndef Retrac_RTCWalkGraph_h
+#define Retrac_RTCWalkGraph_h
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "RTCGeo.h"
+
+namespace rtc {
+
+/**
+ * WalkGraph is a read-only pedestrian street network in compressed sparse row
+ * (CSR) form: node coordinates, each node's outgoing edges packed together,
+ * and a coarse grid over the nodes for snapping a location to the network.
+ *
+ * The file format is the in-memory format. Every section is a flat array at a
+ * 4-byte aligned offset, so a graph file can be memory mapped and attached
+ * with no parsing or copying; pages are only read in as a route touches them.
+ * Nodes are ordered by grid cell, so nodes that are close on the ground are
+ * close in the file too.
+ *
+ * Every street segment is stored in both directions; pedestrians ignore one
+ * way streets.
+ */
+class WalkGraph {
+public:
+    typedef uint32_t NodeID;
+    typedef uint32_t EdgeID;
+
+    struct Node {
+        int32_t latitude;       // 1e-7 degrees
+        int32_t longitude;      // 1e-7 degrees
+    };
+
+    struct Edge {
+        NodeID target;
+        float length;           // meters
+        uint32_t name;          // index into the name table
+    };
+
+    WalkGraph();
+
+    /**
+     * Use a graph file already in memory, typically memory mapped. The data is
+     * not copied and must outlive the graph.
+     *
+     * @return false if data isn't a complete graph file.
+     */
+    bool attach(const void *data, size_t size);
+
+    /**
+     * Read a graph file into memory owned by the graph.
+     *
+     * @return false if the stream is short or not a graph file.
+     */
+    bool read(std::istream &input);
+
+    bool empty() const { return _numNodes == 0; }
+    size_t numNodes() const { return _numNodes; }
+    size_t numEdges() const { return _numEdges; }
+    size_t byteSize() const { return _size; }
+
+    GeoPoint coordinate(NodeID node) const;
+
+    /**
+     * Outgoing edges of node are [firstEdge(node), lastEdge(node))
+     */
+    EdgeID firstEdge(NodeID node) const { return _firstEdges[node]; }
+    EdgeID lastEdge(NodeID node) const { return _firstEdges[node + 1]; }
+    const Edge &edge(EdgeID edge) const { return _edges[edge]; }
+
+    /**
+     * Street name of an edge, "" if it has none.
+     */
+    const char *name(uint32_t index) const;
+
+    /**
+     * Node closest to point.
+     *
+     * @param maxDistance   ignore nodes further than this (meters)
+     *
+     * @return false if there is none within maxDistance.
+     */
+    bool nearestNode(const GeoPoint &point, double maxDistance, NodeID *node, double *distance = 0) const;
+
+private:
+    bool cellOf(const GeoPoint &point, int64_t *column, int64_t *row) const;
+
+    std::vector<char> _storage;     // only used by read()
+    size_t _size;
+
+    uint32_t _numNodes, _numEdges, _numNames;
+    uint32_t _gridColumns, _gridRows;
+    double _gridLatitude, _gridLongitude;       // south west corner
+    double _cellLatitude, _cellLongitude;       // cell size in degrees
+
+    const Node *_nodes;
+    const uint32_t *_firstEdges;
+    const Edge *_edges;
+    const uint32_t *_cellStarts;                // first node of each cell
+    const uint32_t *_nameOffsets;
+    const char *_names;
+};
+
+/**
+ * WalkGraphBuilder collects nodes and ways, then writes a WalkGraph file.
+ *
+ * Only nodes used by a way end up in the graph, so it is fine to add every
+ * node of a map extract.
+ */
+class WalkGraphBuilder {
+public:
+    WalkGraphBuilder() : _numWays(0) {}
+
+    void addNode(int64_t nodeID, const GeoPoint &coordinate);
+
+    /**
+     * Add a walkable way through the given nodes, in order. Nodes that were
+     * never added are skipped.
+     */
+    void addWay(const std::vector<int64_t> &nodeIDs, const std::string &name);
+
+    size_t numWays() const { return _numWays; }
+
+    /**
+     * Write the graph.
+     *
+     * @param cellSize  size (meters) of the grid cells used to snap locations
+     *                  to the graph
+     *
+     * @return false if the write failed.
+     */
+    bool write(std::ostream &output, double cellSize = 100.0) const;
+
+private:
+    struct Segment {
+        int64_t from, to;
+        uint32_t name;
+    };
+
+    std::unordered_map<int64_t, GeoPoint> _nodes;
+    std::vector<Segment> _segments;
+    std::vector<std::string> _names;
+    std::map<std::string, uint32_t> _nameIndices;
+    size_t _numWays;
+};
+
+/**
+ * Counts from importing a map extract
+ */
+struct OSMImportStats {
+    size_t numNodes;            // nodes in the extract
+    size_t numWays;             // ways in the extract
+    size_t numWalkableWays;     // ways added to the graph
+
+    OSMImportStats() : numNodes(0), numWays(0), numWalkableWays(0) {}
+};
+
+/**
+ * Add the walkable ways of an OpenStreetMap XML extract (.osm) to builder.
+ *
+ * A way is walkable if it's a highway people may walk on: footways, paths,
+ * steps, residential and service roads (parking garage aisles included) and
+ * so on, but not motorways, or anything tagged foot=no or access=no without
+ * foot=yes. Unnamed ways are named after their kind ("the footpath").
+ *
+ * @param error     optional, set to a description of what went wrong
+ *
+ * @return false if input isn't an OSM file.
+ */
+bool importOSM(std::istream &input, WalkGraphBuilder &builder, OSMImportStats *stats = 0,
+               std::string *error = 0);
+
+} // namespace rtc
+
+#endif
@@ -0,0 +1,200 @@
+//
+//  RTCWalkRouter.cpp
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/15/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#include "RTCWalkRouter.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace rtc {
+
+#pragma mark - Constants
+// snaps shorter than this (meters) don't get their own polyline segment
+static const double kMinSnapDistance = 1.0;
+
+// bearing changes (degrees) that make a continue, a bear, a turn or a sharp turn
+static const double kContinueAngle = 20.0;
+static const double kBearAngle = 60.0;
+static const double kTurnAngle = 135.0;
+
+
+#pragma mark - Instructions
+static std::string compassDirection(double bearing)
+{
+    static const char *const directions[] = {
+        "north", "northeast", "east", "southeast", "south", "southwest", "west", "northwest"
+    };
+    return directions[(int)((bearing + 22.5) / 45.0) % 8];
+}
+
+static std::string headInstructions(double bearing, const std::string &name)
+{
+    std::string instructions = "Head " + compassDirection(bearing);
+    if (!name.empty()) instructions += " on " + name;
+    return instructions;
+}
+
+static std::string turnInstructions(double fromBearing, double toBearing, const std::string &name)
+{
+    double delta = std::fmod(toBearing - fromBearing + 540.0, 360.0) - 180.0;
+    const char *side = (delta < 0) ? "left" : "right";
+    double angle = std::fabs(delta);
+
+    std::string instructions;
+    if (angle < kContinueAngle) {
+        instructions = "Continue";
+    } else if (angle < kBearAngle) {
+        instructions = std::string("Bear ") + side;
+    } else if (angle < kTurnAngle) {
+        instructions = std::string("Turn ") + side;
+    } else {
+        instructions = std::string("Turn sharply ") + side;
+    }
+    if (!name.empty()) instructions += " onto " + name;
+    return instructions;
+}
+
+
+#pragma mark - WalkRouter
+WalkRouter::WalkRouter(const WalkGraph &graph, const WalkRoutePolicy &policy)
+    : _graph(graph), _policy(policy),
+      _distance(graph.numNodes()), _parentEdge(graph.numNodes()), _parentNode(graph.numNodes()),
+      _visited(graph.numNodes(), 0), _settled(graph.numNodes(), 0), _generation(0),
+      _lastQuerySettled(0)
+{
+}
+
+bool WalkRouter::route(const GeoPoint &origin, const GeoPoint &destination, Route &route)
+{
+    _lastQuerySettled = 0;
+
+    WalkGraph::NodeID source, target;
+    if (!_graph.nearestNode(origin, _policy.maxSnapDistance, &source) ||
+        !_graph.nearestNode(destination, _policy.maxSnapDistance, &target)) {
+        return false;
+    }
+
+    std::vector<WalkGraph::EdgeID> path;
+    if (!findPath(source, target, path)) return false;
+
+    buildRoute(origin, destination, source, path, route);
+    return true;
+}
+
+/**
+ * A* from source to target
+ *
+ * @param path  set to the edges from source to target
+ */
+bool WalkRouter::findPath(WalkGraph::NodeID source, WalkGraph::NodeID target, std::vector<WalkGraph::EdgeID> &path)
+{
+    // a new generation invalidates all the old search state at once
+    if (++_generation == 0) {
+        std::fill(_visited.begin(), _visited.end(), 0);
+        std::fill(_settled.begin(), _settled.end(), 0);
+        _generation = 1;
+    }
+
+    typedef std::pair<double, WalkGraph::NodeID> QueueEntry;   // (estimated total, node)
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > queue;
+    GeoPoint goal = _graph.coordinate(target);
+
+    _distance[source] = 0;
+    _visited[source] = _generation;
+    queue.push(QueueEntry(distanceBetween(_graph.coordinate(source), goal), source));
+
+    while (!queue.empty()) {
+        WalkGraph::NodeID node = queue.top().second;
+        queue.pop();
+
+        // stale entry for a node we already found a shorter way to
+        if (_settled[node] == _generation) continue;
+        _settled[node] = _generation;
+        ++_lastQuerySettled;
+        if (node == target) break;
+
+        for (WalkGraph::EdgeID e = _graph.firstEdge(node); e < _graph.lastEdge(node); ++e) {
+            const WalkGraph::Edge &edge = _graph.edge(e);
+            double distance = _distance[node] + edge.length;
+            if ((_visited[edge.target] == _generation) && (distance >= _distance[edge.target])) continue;
+
+            _visited[edge.target] = _generation;
+            _distance[edge.target] = distance;
+            _parentEdge[edge.target] = e;
+            _parentNode[edge.target] = node;
+            queue.push(QueueEntry(distance + distanceBetween(_graph.coordinate(edge.target), goal), edge.target));
+        }
+    }
+
+    if (_settled[target] != _generation) return false;
+
+    path.clear();
+    for (WalkGraph::NodeID node = target; node != source; node = _parentNode[node]) {
+        path.push_back(_parentEdge[node]);
+    }
+    std::reverse(path.begin(), path.end());
+    return true;
+}
+
+/**
+ * Turn a path into a Route: polyline from origin through the path's nodes to
+ * destination, and a step per run of edges on the same street.
+ */
+void WalkRouter::buildRoute(const GeoPoint &origin, const GeoPoint &destination, WalkGraph::NodeID source,
+                            const std::vector<WalkGraph::EdgeID> &path, Route &route) const
+{
+    route = Route();
+
+    // walk from the origin to the graph, along it, then off it to the destination
+    double leadIn = distanceBetween(origin, _graph.coordinate(source));
+    if (leadIn >= kMinSnapDistance) route.polyline.push_back(origin);
+    else leadIn = 0;
+
+    route.polyline.push_back(_graph.coordinate(source));
+    for (size_t i = 0; i < path.size(); ++i) {
+        route.polyline.push_back(_graph.coordinate(_graph.edge(path[i]).target));
+    }
+
+    double leadOut = distanceBetween(route.polyline.back(), destination);
+    if (leadOut >= kMinSnapDistance) route.polyline.push_back(destination);
+    else leadOut = 0;
+
+    const std::vector<GeoPoint> &polyline = route.polyline;
+    size_t lastPoint = polyline.size() - 1;
+    size_t pathStart = (leadIn > 0) ? 1 : 0;      // polyline index of the source node
+
+    // the first step takes in the walk onto the graph
+    std::string name = path.empty() ? std::string() : _graph.name(_graph.edge(path[0]).name);
+    double firstBearing = (lastPoint > 0) ? initialBearing(polyline[0], polyline[1]) : 0;
+    RouteStep step(headInstructions(firstBearing, name), leadIn, 0);
+
+    for (size_t i = 0; i < path.size(); ++i) {
+        const WalkGraph::Edge &edge = _graph.edge(path[i]);
+        size_t from = pathStart + i;
+
+        if ((i > 0) && (edge.name != _graph.edge(path[i - 1]).name)) {
+            route.steps.push_back(step);
+            double inBearing = initialBearing(polyline[from - 1], polyline[from]);
+            double outBearing = initialBearing(polyline[from], polyline[from + 1]);
+            step = RouteStep(turnInstructions(inBearing, outBearing, _graph.name(edge.name)), 0, (uint32_t)from);
+        }
+        step.distance += edge.length;
+    }
+
+    // and the last one the walk off it
+    step.distance += leadOut;
+    route.steps.push_back(step);
+    route.steps.push_back(RouteStep("Arrive at the destination", 0, (uint32_t)lastPoint));
+
+    for (size_t i = 0; i < route.steps.size(); ++i) route.distance += route.steps[i].distance;
+    route.expectedTravelTime = route.distance / _policy.walkingSpeed;
+}
+
+} // namespace rtc
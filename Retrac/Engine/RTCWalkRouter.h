@@ -0,0 +1,92 @@
+//
+//  RTCWalkRouter.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/15/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+//  Platform-neutral C++. Do not import Foundation/MapKit here so this can be
+//  compiled and exercised headlessly.
+
+#ifndef Retrac_RTCWalkRouter_h
+#define Retrac_RTCWalkRouter_h
+
+#include <vector>
+#include "RTCRouteCache.h"
+#include "RTCWalkGraph.h"
+
+namespace rtc {
+
+/**
+ * WalkRoutePolicy holds the knobs of offline routing.
+ * The default values mirror the offline routing settings in RTCConstants.m
+ */
+struct WalkRoutePolicy {
+    double walkingSpeed;        // kRTCOfflineRouteWalkingSpeed
+    double maxSnapDistance;     // kRTCOfflineRouteMaxSnapDistance
+
+    WalkRoutePolicy() : walkingSpeed(1.4), maxSnapDistance(200.0) {}
+};
+
+/**
+ * WalkRouter finds walking routes over a WalkGraph without a network.
+ *
+ * The origin and destination are snapped to the nearest graph nodes within
+ * policy.maxSnapDistance, then A* with a great-circle heuristic finds the
+ * shortest path between them. Since every edge is at least as long as the
+ * straight line between its ends the heuristic never overestimates, so the
+ * path is optimal while settling far fewer nodes than Dijkstra would.
+ *
+ * The path comes back as a Route, the shape MKDirections routes are turned
+ * into: consecutive edges of the same street make up a step, with turn
+ * instructions worked out from the change in bearing between streets.
+ *
+ * Search state is kept between queries and reset lazily, so a query only
+ * costs in proportion to the nodes it touches. A router isn't thread safe.
+ */
+class WalkRouter {
+public:
+    /**
+     * @param graph     graph to route over, must outlive the router
+     * @param policy    routing knobs
+     */
+    explicit WalkRouter(const WalkGraph &graph, const WalkRoutePolicy &policy = WalkRoutePolicy());
+
+    const WalkRoutePolicy &policy() const { return _policy; }
+
+    /**
+     * Find a walking route.
+     *
+     * @return false if either end is too far from the graph or they aren't
+     *      connected.
+     */
+    bool route(const GeoPoint &origin, const GeoPoint &destination, Route &route);
+
+    /**
+     * Number of nodes settled by the most recent query. Handy for checking
+     * the heuristic is pulling its weight.
+     */
+    size_t lastQuerySettled() const { return _lastQuerySettled; }
+
+private:
+    bool findPath(WalkGraph::NodeID source, WalkGraph::NodeID target, std::vector<WalkGraph::EdgeID> &path);
+    void buildRoute(const GeoPoint &origin, const GeoPoint &destination, WalkGraph::NodeID source,
+                    const std::vector<WalkGraph::EdgeID> &path, Route &route) const;
+
+    const WalkGraph &_graph;
+    WalkRoutePolicy _policy;
+
+    // per node search state, valid where _visited matches _generation
+    std::vector<double> _distance;
+    std::vector<WalkGraph::EdgeID> _parentEdge;
+    std::vector<WalkGraph::NodeID> _parentNode;
+    std::vector<uint32_t> _visited;
+    std::vector<uint32_t> _settled;
+    uint32_t _generation;
+
+    size_t _lastQuerySettled;
+};
+
+} // namespace rtc
+
+#endif
@@ -49,6 +49,24 @@ extern NSString *const kRTCFontNameBold;
  */
 extern const NSUInteger kRTCPlaceNameMaxLength;
 
+/**
+ * kRTCWriteBatchSize is the most background writes saved together
+ */
+extern const NSUInteger kRTCWriteBatchSize;
+
+/**
+ * kRTCWriteBatchDelay is the longest (in seconds) a background write waits for
+ * others to be saved with
+ */
+extern const NSTimeInterval kRTCWriteBatchDelay;
+
+/**
+ * kRTCPlaceArchiveBatchSize is the number of places imported or exported
+ * between context saves and resets. It bounds the memory a bulk import or
+ * export uses, however many places there are.
+ */
+extern const NSUInteger kRTCPlaceArchiveBatchSize;
+
 
 // Location Settings
 /**
@@ -108,6 +126,401 @@ extern const NSTimeInterval kRTCLocationMaxWaitTimeForBetter;
  */
 extern const NSTimeInterval kRTCLocationMaxWaitTimeForFirst;
 
+/**
+ * kRTCLocationMaxWaitTimeAtLevel is how long (in seconds) a location request
+ * stays at a desired accuracy level before trying the next, more power hungry
+ * one, provided the level is still improving the location.
+ */
+extern const NSTimeInterval kRTCLocationMaxWaitTimeAtLevel;
+
+/**
+ * kRTCLocationCacheMaxAge is the oldest (in seconds) the last location update
+ * can be and still answer a location request without turning on updates
+ */
+extern const NSTimeInterval kRTCLocationCacheMaxAge;
+
+/**
+ * kRTCDirectionsLocationAccuracy is the accuracy (in meters) directions need
+ * of the current location: a route's start doesn't have to be exact
+ */
+extern const CLLocationAccuracy kRTCDirectionsLocationAccuracy;
+
+/**
+ * kRTCDirectionsLocationMaxAge is the oldest (in seconds) a location can be
+ * and still be a route's start
+ */
+extern const NSTimeInterval kRTCDirectionsLocationMaxAge;
+
+
+// Trail Settings
+/**
+ * kRTCTrailMaxAccuracy is the worst accuracy (in meters) of a location update
+ * that still gets recorded in a trail
+ */
+extern const CLLocationAccuracy kRTCTrailMaxAccuracy;
+
+/**
+ * kRTCTrailMinSpacing is the distance (in meters) a location update has to be
+ * from the previous recorded one to count. Filters out jitter while standing.
+ */
+extern const CLLocationDistance kRTCTrailMinSpacing;
+
+/**
+ * kRTCTrailTolerance is how far (in meters) a recorded location update may be
+ * from the simplified trail. Bigger means fewer points stored.
+ */
+extern const CLLocationDistance kRTCTrailTolerance;
+
+/**
+ * kRTCTrailMaxWindow is the most location updates held back while deciding
+ * where the next trail point goes. Bounds the work per update.
+ */
+extern const NSUInteger kRTCTrailMaxWindow;
+
+
+// Directions Settings
+/**
+ * kRTCRouteCacheOriginCellSize is the size (in meters) of the cells route
+ * origins are snapped to. Routes from anywhere in the same cell are shared.
+ */
+extern const CLLocationDistance kRTCRouteCacheOriginCellSize;
+
+/**
+ * kRTCRouteCacheDestinationCellSize is the size (in meters) of the cells route
+ * destinations are snapped to.
+ */
+extern const CLLocationDistance kRTCRouteCacheDestinationCellSize;
+
+/**
+ * kRTCRouteCacheMaxAge is the age (in seconds) after which a cached route is
+ * refreshed. It is still shown while the refresh is under way.
+ */
+extern const NSTimeInterval kRTCRouteCacheMaxAge;
+
+/**
+ * kRTCRouteCacheReuseDistance is how far (in meters) the current location may
+ * be from a cached route to the same destination for the rest of that route
+ * to be reused.
+ */
+extern const CLLocationDistance kRTCRouteCacheReuseDistance;
+
+/**
+ * kRTCRouteCacheMaxEntries is the most routes kept in the cache
+ */
+extern const NSUInteger kRTCRouteCacheMaxEntries;
+
+/**
+ * kRTCOfflineRouteWalkingSpeed is the walking speed (in meters per second)
+ * used to estimate travel time on routes found without MapKit
+ */
+extern const CLLocationSpeed kRTCOfflineRouteWalkingSpeed;
+
+/**
+ * kRTCOfflineRouteMaxSnapDistance is how far (in meters) a location may be from
+ * the offline walking graph and still be routed from or to
+ */
+extern const CLLocationDistance kRTCOfflineRouteMaxSnapDistance;
+
+/**
+ * kRTCPositionAccelerationNoise is how hard (in meters per second squared) the
+ * user is expected to speed up, slow down or turn between location updates.
+ * Higher follows the user sooner, lower smooths more.
+ */
+extern const double kRTCPositionAccelerationNoise;
+
+/**
+ * kRTCPositionMaxAccuracy is the worst accuracy (in meters) of a location
+ * update that is still smoothed into the directions location
+ */
+extern const CLLocationAccuracy kRTCPositionMaxAccuracy;
+
+/**
+ * kRTCPositionMaxGap is how long (in seconds) without a location update before
+ * smoothing starts over from the next one
+ */
+extern const NSTimeInterval kRTCPositionMaxGap;
+
+/**
+ * kRTCPositionOutlierGate is how many standard deviations a location update
+ * can be from where smoothing expects it before it is ignored as an outlier
+ */
+extern const double kRTCPositionOutlierGate;
+
+/**
+ * kRTCPositionMaxOutliers is how many outliers in a row are taken to mean the
+ * user really is there, and smoothing starts over
+ */
+extern const NSUInteger kRTCPositionMaxOutliers;
+
+/**
+ * kRTCDirectionsRerouteDistance is how far (in meters) the user has to move
+ * from the start of the walking route before a new one is requested
+ */
+extern const CLLocationDistance kRTCDirectionsRerouteDistance;
+
+/**
+ * kRTCDirectionsRerouteConfidence is how many standard deviations of location
+ * error the user has to move as well, so a noisy location doesn't reroute
+ */
+extern const double kRTCDirectionsRerouteConfidence;
+
+/**
+ * kRTCRouteOffRouteDistance is how far (in meters), on top of the location's
+ * accuracy, the user has to be from the walking route to be off it
+ */
+extern const CLLocationDistance kRTCRouteOffRouteDistance;
+
+/**
+ * kRTCRouteOnRouteDistance is how close (in meters) the user has to come back
+ * to the walking route to be on it again
+ */
+extern const CLLocationDistance kRTCRouteOnRouteDistance;
+
+/**
+ * kRTCRouteOffRouteFixes is how many location updates in a row have to be off
+ * the walking route before a new one is requested
+ */
+extern const NSUInteger kRTCRouteOffRouteFixes;
+
+/**
+ * kRTCRouteOffRouteTime is how long (in seconds) those updates have to span,
+ * so a burst of bad ones doesn't reroute
+ */
+extern const NSTimeInterval kRTCRouteOffRouteTime;
+
+/**
+ * kRTCRouteSearchRadius is how far (in meters) from a location the walking
+ * route is searched for it. Also the cell size of the route's segment index.
+ */
+extern const CLLocationDistance kRTCRouteSearchRadius;
+
+
+// Geocoding Settings
+/**
+ * kRTCGeocodeCacheCellSize is the size (in meters) of the cells placemarks are
+ * cached by. Locations in the same cell share a placemark.
+ */
+extern const CLLocationDistance kRTCGeocodeCacheCellSize;
+
+/**
+ * kRTCGeocodeCacheMaxAge is the age (in seconds) after which a cached placemark
+ * is looked up again
+ */
+extern const NSTimeInterval kRTCGeocodeCacheMaxAge;
+
+/**
+ * kRTCGeocodeCacheMaxEntries is the most placemarks kept in the cache
+ */
+extern const NSUInteger kRTCGeocodeCacheMaxEntries;
+
+/**
+ * kRTCGeocodeMinLookupInterval is the least time (in seconds) between the
+ * starts of two reverse geocoding requests. Keeps us under the geocoder's
+ * rate limit.
+ */
+extern const NSTimeInterval kRTCGeocodeMinLookupInterval;
+
+/**
+ * kRTCGeocodeFailureBackoff is how long (in seconds) to hold off reverse
+ * geocoding after a request fails, since that's usually throttling or no
+ * network.
+ */
+extern const NSTimeInterval kRTCGeocodeFailureBackoff;
+
+
+// Geofence Settings
+/**
+ * kRTCGeofenceMaxRegions is the most regions we have the OS monitor at once,
+ * including the one that tells us to pick new places. iOS allows 20 per app.
+ */
+extern const NSUInteger kRTCGeofenceMaxRegions;
+
+/**
+ * kRTCGeofenceRadius is how close (in meters) the user has to be to a place to
+ * have arrived
+ */
+extern const CLLocationDistance kRTCGeofenceRadius;
+
+/**
+ * kRTCGeofenceExitHysteresis is how much further (in meters) than
+ * kRTCGeofenceRadius the user has to go to have departed. Stops GPS jitter at
+ * the edge of a place from firing events.
+ */
+extern const CLLocationDistance kRTCGeofenceExitHysteresis;
+
+/**
+ * kRTCGeofenceMaxAccuracy is the worst accuracy (in meters) of a location
+ * update that counts towards an arrival or departure
+ */
+extern const CLLocationAccuracy kRTCGeofenceMaxAccuracy;
+
+/**
+ * kRTCGeofenceDwellTime is how long (in seconds) location updates have to
+ * agree before an arrival or departure fires
+ */
+extern const NSTimeInterval kRTCGeofenceDwellTime;
+
+/**
+ * kRTCGeofenceMinRefreshRadius is the least distance (in meters) the user has
+ * to move before the monitored places are picked again
+ */
+extern const CLLocationDistance kRTCGeofenceMinRefreshRadius;
+
+/**
+ * kRTCGeofenceMaxRefreshRadius is the most distance (in meters) the user can
+ * move before the monitored places are picked again
+ */
+extern const CLLocationDistance kRTCGeofenceMaxRefreshRadius;
+
+/**
+ * kRTCGeofenceMaxConfirmationTime is the longest (in seconds) location updates
+ * are kept on to confirm an arrival or departure before giving up to save power
+ */
+extern const NSTimeInterval kRTCGeofenceMaxConfirmationTime;
+
+
+// Map Settings
+/**
+ * kRTCMapClusterRadius is the size (in screen points) of the grid cells places
+ * are clustered in on a map
+ */
+extern const CGFloat kRTCMapClusterRadius;
+
+/**
+ * kRTCMapClusterMaxZoomLevel is the highest map zoom level places are
+ * clustered at. Zoomed in further, every place gets its own pin.
+ */
+extern const NSInteger kRTCMapClusterMaxZoomLevel;
+
+
+// Offline Map Settings
+/**
+ * kRTCTileServerURLTemplate is where map tiles are downloaded from for offline
+ * use, with {z}, {x} and {y} placeholders as in MKTileOverlay. Empty turns
+ * downloading off.
+ */
+extern NSString *const kRTCTileServerURLTemplate;
+
+/**
+ * kRTCTilePackMinZoom is the lowest map zoom level tiles are kept for offline
+ * use at
+ */
+extern const NSUInteger kRTCTilePackMinZoom;
+
+/**
+ * kRTCTilePackMaxZoom is the highest map zoom level tiles are kept for offline
+ * use at
+ */
+extern const NSUInteger kRTCTilePackMaxZoom;
+
+/**
+ * kRTCTilePackPlaceRadius is how far (in meters) around a saved place the map
+ * is kept for offline use
+ */
+extern const CLLocationDistance kRTCTilePackPlaceRadius;
+
+/**
+ * kRTCTilePackRouteCorridor is how far (in meters) either side of the route to
+ * a saved place the map is kept for offline use
+ */
+extern const CLLocationDistance kRTCTilePackRouteCorridor;
+
+/**
+ * kRTCTilePackMaxBytes is the most space (in bytes) offline map tiles may take.
+ * The least recently used places' tiles go first.
+ */
+extern const unsigned long long kRTCTilePackMaxBytes;
+
+/**
+ * kRTCTilePackMaxConnections is the most tile downloads run at once
+ */
+extern const NSUInteger kRTCTilePackMaxConnections;
+
+
+// Place Sync Settings
+/**
+ * kRTCPlaceSyncServerURL is where saved places are synced with other devices
+ * (see RTCPlaceSyncLog.h). Empty turns syncing off.
+ */
+extern NSString *const kRTCPlaceSyncServerURL;
+
+/**
+ * kRTCPlaceSyncTimeout is how long (in seconds) a sync waits on the server
+ */
+extern const NSTimeInterval kRTCPlaceSyncTimeout;
+
+/**
+ * kRTCPlaceSyncLogSaveDelay is how long (in seconds) the sync log waits after
+ * a change for more before writing itself out
+ */
+extern const NSTimeInterval kRTCPlaceSyncLogSaveDelay;
+
+
+// Duplicate Place Settings
+/**
+ * kRTCDuplicateMinRadius is how close (in meters) a new fix must be to a saved
+ * place to be taken as the same spot, however accurate the two fixes are
+ */
+extern const CLLocationDistance kRTCDuplicateMinRadius;
+
+/**
+ * kRTCDuplicateMaxRadius is the furthest (in meters) a new fix can be from a
+ * saved place and still be taken as the same spot, however inaccurate the two
+ * fixes are. Between the two it's the larger horizontal accuracy.
+ */
+extern const CLLocationDistance kRTCDuplicateMaxRadius;
+
+/**
+ * kRTCPlaceCompactionInterval is the least time (in seconds) between passes
+ * over the whole store merging duplicate places
+ */
+extern const NSTimeInterval kRTCPlaceCompactionInterval;
+
+/**
+ * kRTCPlaceCompactionBatchSize is how many duplicate groups are merged per
+ * background write during compaction
+ */
+extern const NSUInteger kRTCPlaceCompactionBatchSize;
+
+
+// Table View Settings
+/**
+ * kRTCTableMaxAnimatedChanges is the most row and section updates a table view
+ * animates in one batch. Bigger batches reload the table instead.
+ */
+extern const NSUInteger kRTCTableMaxAnimatedChanges;
+
+/**
+ * kRTCPlaceSnapshotMaxPlaces is how many of the newest places are kept in the
+ * snapshot the places list shows at launch, before the store is open. A
+ * screenful or so is all it needs.
+ */
+extern const NSUInteger kRTCPlaceSnapshotMaxPlaces;
+
+/**
+ * kRTCPlaceSearchMaxResults is the most places the places list shows for a
+ * search. Matches past it are the lowest ranked ones, and an
+ * "IN" predicate over fewer object IDs is a cheaper fetch.
+ */
+extern const NSUInteger kRTCPlaceSearchMaxResults;
+
+// Trace Settings
+/**
+ * kRTCTraceEnabled turns on tracing of document opens, location requests,
+ * geocoding and directions at launch. The trace is written to the caches
+ * directory when the app goes into the background.
+ */
+extern const BOOL kRTCTraceEnabled;
+
+
+// Scheduler Settings
+/**
+ * kRTCSchedulerTickDuration is how finely (in seconds) RTCWorkScheduler keeps
+ * deadlines. Timers fire up to this late, and that much apart are batched.
+ */
+extern const NSTimeInterval kRTCSchedulerTickDuration;
+
+
 // Notifications
 /**
  * NSNotification identifier for Retrac's managedObjectContext availability
@@ -119,6 +532,24 @@ extern NSString *const kRTCMOCAvailableNotification;
  */
 extern NSString *const kRTCMOCDeletedNotification;
 
+/**
+ * NSNotification identifier for the user arriving at a place. The object is the
+ * RTCPlace.
+ */
+extern NSString *const kRTCPlaceArrivalNotification;
+
+/**
+ * NSNotification identifier for the user departing from a place. The object is
+ * the RTCPlace.
+ */
+extern NSString *const kRTCPlaceDepartureNotification;
+
+/**
+ * NSNotification identifier for the user not being back at a place within its
+ * timeout. The object is the RTCPlace.
+ */
+extern NSString *const kRTCPlaceOverdueNotification;
+
 
 // Application Error Strings
 /**
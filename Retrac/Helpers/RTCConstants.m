@@ -18,6 +18,9 @@ NSString *const kRTCFontNameBold            = @"Avenir-Medium";
 
 // Place Settings
 const NSUInteger kRTCPlaceNameMaxLength     = 100;
+const NSUInteger kRTCWriteBatchSize         = 50;
+const NSTimeInterval kRTCWriteBatchDelay    = 0.25;
+const NSUInteger kRTCPlaceArchiveBatchSize  = 1000;
 
 // Location Settings
 const NSTimeInterval kRTCLocationUpdateExpiryTime       = 5.0;
@@ -27,10 +30,96 @@ const CLLocationAccuracy kRTCLocationAccuracySignificantChange = 0.0;
 const NSUInteger kRTCLocationAttemptsMax                = 10;
 const NSTimeInterval kRTCLocationMaxWaitTimeForBetter   = 5.0;
 const NSTimeInterval kRTCLocationMaxWaitTimeForFirst    = 30.0;
+const NSTimeInterval kRTCLocationMaxWaitTimeAtLevel     = 10.0;
+const NSTimeInterval kRTCLocationCacheMaxAge            = 60.0;
+const CLLocationAccuracy kRTCDirectionsLocationAccuracy = 100.0;
+const NSTimeInterval kRTCDirectionsLocationMaxAge       = 60.0;
+
+// Trail Settings
+const CLLocationAccuracy kRTCTrailMaxAccuracy   = 50.0;
+const CLLocationDistance kRTCTrailMinSpacing    = 5.0;
+const CLLocationDistance kRTCTrailTolerance     = 10.0;
+const NSUInteger kRTCTrailMaxWindow             = 64;
+
+// Directions Settings
+const CLLocationDistance kRTCRouteCacheOriginCellSize       = 25.0;
+const CLLocationDistance kRTCRouteCacheDestinationCellSize  = 10.0;
+const NSTimeInterval kRTCRouteCacheMaxAge                   = 3600.0;
+const CLLocationDistance kRTCRouteCacheReuseDistance        = 25.0;
+const NSUInteger kRTCRouteCacheMaxEntries                   = 64;
+const CLLocationSpeed kRTCOfflineRouteWalkingSpeed          = 1.4;
+const CLLocationDistance kRTCOfflineRouteMaxSnapDistance    = 200.0;
+const double kRTCPositionAccelerationNoise                  = 0.5;
+const CLLocationAccuracy kRTCPositionMaxAccuracy            = 100.0;
+const NSTimeInterval kRTCPositionMaxGap                     = 30.0;
+const double kRTCPositionOutlierGate                        = 4.0;
+const NSUInteger kRTCPositionMaxOutliers                    = 3;
+const CLLocationDistance kRTCDirectionsRerouteDistance      = 25.0;
+const double kRTCDirectionsRerouteConfidence                = 2.0;
+const CLLocationDistance kRTCRouteOffRouteDistance          = 30.0;
+const CLLocationDistance kRTCRouteOnRouteDistance           = 15.0;
+const NSUInteger kRTCRouteOffRouteFixes                     = 3;
+const NSTimeInterval kRTCRouteOffRouteTime                  = 5.0;
+const CLLocationDistance kRTCRouteSearchRadius              = 100.0;
+
+// Geocoding Settings
+const CLLocationDistance kRTCGeocodeCacheCellSize     = 15.0;
+const NSTimeInterval kRTCGeocodeCacheMaxAge           = 30.0 * 24.0 * 3600.0;
+const NSUInteger kRTCGeocodeCacheMaxEntries           = 1000;
+const NSTimeInterval kRTCGeocodeMinLookupInterval     = 1.5;
+const NSTimeInterval kRTCGeocodeFailureBackoff        = 60.0;
+
+// Geofence Settings
+const NSUInteger kRTCGeofenceMaxRegions                 = 20;
+const CLLocationDistance kRTCGeofenceRadius             = 100.0;
+const CLLocationDistance kRTCGeofenceExitHysteresis     = 50.0;
+const CLLocationAccuracy kRTCGeofenceMaxAccuracy        = 100.0;
+const NSTimeInterval kRTCGeofenceDwellTime              = 30.0;
+const CLLocationDistance kRTCGeofenceMinRefreshRadius   = 150.0;
+const CLLocationDistance kRTCGeofenceMaxRefreshRadius   = 20000.0;
+const NSTimeInterval kRTCGeofenceMaxConfirmationTime    = 120.0;
+
+// Map Settings
+const CGFloat kRTCMapClusterRadius          = 60.0;
+const NSInteger kRTCMapClusterMaxZoomLevel  = 16;
+
+// Offline Map Settings
+NSString *const kRTCTileServerURLTemplate             = @"";
+const NSUInteger kRTCTilePackMinZoom                  = 14;
+const NSUInteger kRTCTilePackMaxZoom                  = 18;
+const CLLocationDistance kRTCTilePackPlaceRadius      = 400.0;
+const CLLocationDistance kRTCTilePackRouteCorridor    = 100.0;
+const unsigned long long kRTCTilePackMaxBytes         = 64ULL * 1024 * 1024;
+const NSUInteger kRTCTilePackMaxConnections           = 4;
+
+// Place Sync Settings
+NSString *const kRTCPlaceSyncServerURL          = @"";
+const NSTimeInterval kRTCPlaceSyncTimeout       = 30.0;
+const NSTimeInterval kRTCPlaceSyncLogSaveDelay  = 1.0;
+
+// Duplicate Place Settings
+const CLLocationDistance kRTCDuplicateMinRadius     = 10.0;
+const CLLocationDistance kRTCDuplicateMaxRadius     = 50.0;
+const NSTimeInterval kRTCPlaceCompactionInterval    = 7 * 24 * 60 * 60;
+const NSUInteger kRTCPlaceCompactionBatchSize       = 20;
+
+// Table View Settings
+const NSUInteger kRTCTableMaxAnimatedChanges = 250;
+const NSUInteger kRTCPlaceSnapshotMaxPlaces  = 50;
+const NSUInteger kRTCPlaceSearchMaxResults   = 200;
+
+// Trace Settings
+const BOOL kRTCTraceEnabled = NO;
+
+// Scheduler Settings
+const NSTimeInterval kRTCSchedulerTickDuration = 0.001;
 
 // Notifications
 NSString *const kRTCMOCAvailableNotification    = @"kRTCMOCAvailableNotification";
 NSString *const kRTCMOCDeletedNotification      = @"kRTCMOCDeletedNotification";
+NSString *const kRTCPlaceArrivalNotification    = @"kRTCPlaceArrivalNotification";
+NSString *const kRTCPlaceDepartureNotification  = @"kRTCPlaceDepartureNotification";
+NSString *const kRTCPlaceOverdueNotification    = @"kRTCPlaceOverdueNotification";
 
 // Application Error Strings
 NSString *const kRTCErrorMsgLocationDisabled    = @"You have to enable your location in your device settings to save and navigate to places.";
@@ -0,0 +1,54 @@
+//
+//  RTCLabelFormatter.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/26/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * RTCLabelFormatter makes the short labels table cells show (ages like "3d",
+ * distances like "0.4 mi", travel times) once per distinct label and hands
+ * out the same string after that, so configuring a cell doesn't format or
+ * allocate. See rtc::LabelCache.
+ *
+ * Main queue only, like the cells it labels.
+ */
+@interface RTCLabelFormatter : NSObject
+
+#pragma mark - Class Methods
+/**
+ * Label for an age, such as the time since a place was created
+ *
+ * @return "xxm" under an hour, "xxh" under a day, else "xxd"; nil if age is
+ *      negative.
+ */
++ (NSString *)labelForAge:(NSTimeInterval)age;
+
+/**
+ * Seconds till the label of an age changes
+ */
++ (NSTimeInterval)expiryOfLabelForAge:(NSTimeInterval)age;
+
+/**
+ * Whether the label of an age changes once elapsed more seconds have passed
+ */
++ (BOOL)labelForAge:(NSTimeInterval)age changesAfter:(NSTimeInterval)elapsed;
+
+/**
+ * Label for a walking distance
+ *
+ * @return "xx ft" under a tenth of a mile, else "x.x mi"; nil if distance is
+ *      negative.
+ */
++ (NSString *)labelForDistance:(double)meters;
+
+/**
+ * Label for a travel time: "mm minute(s)", "hh hour(s)" or
+ * "hh hour(s) mm minute(s)"
+ */
++ (NSString *)labelForDuration:(NSTimeInterval)duration;
+
+@end
@@ -0,0 +1,71 @@
+//
+//  RTCLabelFormatter.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/26/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCLabelFormatter.h"
+#include "RTCLabelFormat.h"
+
+#pragma mark - Helpers
+static NSString *makeLabel(const std::string &text)
+{
+    return [[NSString alloc] initWithUTF8String:text.c_str()];
+}
+
+/**
+ * The labels made so far, ages preloaded since every places list shows some
+ */
+static rtc::LabelCache<NSString *> &sharedLabels()
+{
+    static rtc::LabelCache<NSString *> *labels = NULL;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        labels = new rtc::LabelCache<NSString *>(makeLabel);
+        labels->preloadAges();
+    });
+    return *labels;
+}
+
+/**
+ * Shared label for bucket, nil for one with no label
+ */
+static NSString *labelForBucket(const rtc::LabelBucket &bucket)
+{
+    if (bucket.unit == rtc::LabelBucket::UnitNone) return nil;
+    return sharedLabels().label(bucket);
+}
+
+
+@implementation RTCLabelFormatter
+
+#pragma mark - Class Methods
+#pragma mark Public
++ (NSString *)labelForAge:(NSTimeInterval)age
+{
+    return labelForBucket(rtc::ageBucket(age));
+}
+
++ (NSTimeInterval)expiryOfLabelForAge:(NSTimeInterval)age
+{
+    return rtc::ageBucketExpiry(age);
+}
+
++ (BOOL)labelForAge:(NSTimeInterval)age changesAfter:(NSTimeInterval)elapsed
+{
+    return rtc::ageBucketChanges(age, elapsed);
+}
+
++ (NSString *)labelForDistance:(double)meters
+{
+    return labelForBucket(rtc::distanceBucket(meters));
+}
+
++ (NSString *)labelForDuration:(NSTimeInterval)duration
+{
+    return labelForBucket(rtc::durationBucket(duration));
+}
+
+@end
@@ -0,0 +1,49 @@
+//
+//  RTCPositionSmoother.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/28/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
+
+/**
+ * RTCPositionSmoother turns a stream of location updates into a steady
+ * location, with speed and course, for showing the user on a map and
+ * routing from. Updates are weighed by their accuracy and outliers are
+ * ignored; see rtc::PositionFilter.
+ */
+@interface RTCPositionSmoother : NSObject
+
+#pragma mark - Properties
+/**
+ * Smoothed location as of the last update used, nil before the first
+ */
+@property (strong, nonatomic, readonly) CLLocation *location;
+
+
+#pragma mark - Instance Methods
+/**
+ * Smooth in a location update.
+ *
+ * @return NO if the update was ignored and location is unchanged.
+ */
+- (BOOL)addLocation:(CLLocation *)location;
+
+/**
+ * Whether the user has moved far enough from location, the start of the
+ * current route, to need a new one: kRTCDirectionsRerouteDistance, and more
+ * than location errors can account for.
+ *
+ * @return YES if there is no smoothed location yet.
+ */
+- (BOOL)hasMovedSignificantlyFromLocation:(CLLocation *)location;
+
+/**
+ * Forget past updates, so the next one starts over
+ */
+- (void)reset;
+
+@end
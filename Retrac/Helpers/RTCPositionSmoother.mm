@@ -0,0 +1,93 @@
+//
+//  RTCPositionSmoother.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/28/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCPositionSmoother.h"
+#include "RTCPositionFilter.h"
+
+// slower than this (meters per second) the course is noise, so not reported
+static const CLLocationSpeed kMinCourseSpeed = 0.5;
+
+@interface RTCPositionSmoother () {
+    rtc::PositionFilter _filter;
+}
+
+// want all properties to be readwrite internally
+@property (strong, nonatomic, readwrite) CLLocation *location;
+
+@end
+
+
+#pragma mark - Helpers
+/**
+ * Position filter policy built from the app's position settings
+ */
+static rtc::PositionFilterPolicy positionFilterPolicy()
+{
+    rtc::PositionFilterPolicy policy;
+    policy.accelerationNoise = kRTCPositionAccelerationNoise;
+    policy.maxAccuracy = kRTCPositionMaxAccuracy;
+    policy.maxGap = kRTCPositionMaxGap;
+    policy.outlierGate = kRTCPositionOutlierGate;
+    policy.maxOutliers = (unsigned)kRTCPositionMaxOutliers;
+    policy.rerouteDistance = kRTCDirectionsRerouteDistance;
+    policy.rerouteConfidence = kRTCDirectionsRerouteConfidence;
+    return policy;
+}
+
+
+@implementation RTCPositionSmoother
+
+#pragma mark - Initialization
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _filter = rtc::PositionFilter(positionFilterPolicy());
+    }
+    return self;
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Public
+- (BOOL)addLocation:(CLLocation *)location
+{
+    if (!location) return NO;
+    rtc::LocationFix fix([location.timestamp timeIntervalSince1970],
+                         location.coordinate.latitude,
+                         location.coordinate.longitude,
+                         location.horizontalAccuracy);
+    if (!_filter.addFix(fix)) return NO;
+
+    const rtc::PositionEstimate &estimate = _filter.estimate();
+    CLLocationSpeed speed = estimate.speed();
+    self.location = [[CLLocation alloc] initWithCoordinate:CLLocationCoordinate2DMake(estimate.coordinate.latitude,
+                                                                                      estimate.coordinate.longitude)
+                                                  altitude:location.altitude
+                                        horizontalAccuracy:estimate.horizontalAccuracy
+                                          verticalAccuracy:location.verticalAccuracy
+                                                    course:((speed < kMinCourseSpeed) ? -1 : estimate.course())
+                                                     speed:speed
+                                                 timestamp:location.timestamp];
+    return YES;
+}
+
+- (BOOL)hasMovedSignificantlyFromLocation:(CLLocation *)location
+{
+    if (!location) return YES;
+    return _filter.movedSignificantly(rtc::GeoPoint(location.coordinate.latitude, location.coordinate.longitude),
+                                      location.horizontalAccuracy);
+}
+
+- (void)reset
+{
+    _filter.reset();
+    self.location = nil;
+}
+
+@end
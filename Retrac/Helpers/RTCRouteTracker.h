@@ -0,0 +1,59 @@
+//
+//  RTCRouteTracker.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/29/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
+#import "RTCRoute.h"
+
+/**
+ * What a location update did to the user's place on the route
+ */
+typedef NS_ENUM(NSInteger, RTCRouteTrackerEvent) {
+    RTCRouteTrackerEventNone,
+    RTCRouteTrackerEventOffRoute,       // the user left the route; get a new one
+    RTCRouteTrackerEventBackOnRoute     // the user found their way back
+};
+
+
+/**
+ * RTCRouteTracker follows the user along a walking route: how far is left,
+ * which step they are on, and when they have left it. A wrong turn takes a
+ * few location updates to count, so a noisy one doesn't reroute; see
+ * rtc::RouteTracker.
+ */
+@interface RTCRouteTracker : NSObject
+
+#pragma mark - Properties
+/**
+ * Route being followed. Setting it starts over at its beginning.
+ */
+@property (strong, nonatomic) RTCRoute *route;
+
+/**
+ * Has a location update put the user on the route yet?
+ */
+@property (nonatomic, readonly) BOOL hasProgress;
+
+/**
+ * Index into route.steps of the step the user is on
+ */
+@property (nonatomic, readonly) NSUInteger stepIndex;
+
+@property (nonatomic, readonly) CLLocationDistance distanceRemaining;
+@property (nonatomic, readonly) NSTimeInterval timeRemaining;
+
+@property (nonatomic, readonly, getter=isOffRoute) BOOL offRoute;
+
+
+#pragma mark - Instance Methods
+/**
+ * Follow the user to location.
+ */
+- (RTCRouteTrackerEvent)addLocation:(CLLocation *)location;
+
+@end
@@ -0,0 +1,124 @@
+//
+//  RTCRouteTracker.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 8/29/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCRouteTracker.h"
+#include "RTCRouteProgress.h"
+
+@interface RTCRouteTracker () {
+    rtc::RouteTracker _tracker;
+}
+@end
+
+
+#pragma mark - Helpers
+/**
+ * Route progress policy built from the app's route settings
+ */
+static rtc::RouteProgressPolicy routeProgressPolicy()
+{
+    rtc::RouteProgressPolicy policy;
+    policy.offRouteDistance = kRTCRouteOffRouteDistance;
+    policy.onRouteDistance = kRTCRouteOnRouteDistance;
+    policy.offRouteFixes = (unsigned)kRTCRouteOffRouteFixes;
+    policy.offRouteTime = kRTCRouteOffRouteTime;
+    policy.searchRadius = kRTCRouteSearchRadius;
+    return policy;
+}
+
+/**
+ * Convert an RTCRoute to the tracker's representation. Only the polyline,
+ * where the steps start and the travel time matter to it.
+ */
+static rtc::Route trackerRouteFromRoute(RTCRoute *route)
+{
+    rtc::Route trackerRoute;
+    trackerRoute.distance = route.distance;
+    trackerRoute.expectedTravelTime = route.expectedTravelTime;
+
+    MKPolyline *polyline = route.polyline;
+    MKMapPoint *points = polyline.points;
+    trackerRoute.polyline.reserve(polyline.pointCount);
+    for (NSUInteger i = 0; i < polyline.pointCount; ++i) {
+        CLLocationCoordinate2D coordinate = MKCoordinateForMapPoint(points[i]);
+        trackerRoute.polyline.push_back(rtc::GeoPoint(coordinate.latitude, coordinate.longitude));
+    }
+
+    for (RTCRouteStep *step in route.steps) {
+        trackerRoute.steps.push_back(rtc::RouteStep("", step.distance, (uint32_t)step.firstPointIndex));
+    }
+    return trackerRoute;
+}
+
+
+@implementation RTCRouteTracker
+
+#pragma mark - Properties
+- (void)setRoute:(RTCRoute *)route
+{
+    _route = route;
+    _tracker.setRoute(route ? trackerRouteFromRoute(route) : rtc::Route());
+}
+
+- (BOOL)hasProgress
+{
+    return _tracker.progress().matched;
+}
+
+- (NSUInteger)stepIndex
+{
+    return _tracker.progress().stepIndex;
+}
+
+- (CLLocationDistance)distanceRemaining
+{
+    return _tracker.progress().matched ? _tracker.progress().distanceRemaining : self.route.distance;
+}
+
+- (NSTimeInterval)timeRemaining
+{
+    return _tracker.progress().matched ? _tracker.progress().timeRemaining : self.route.expectedTravelTime;
+}
+
+- (BOOL)isOffRoute
+{
+    return _tracker.isOffRoute();
+}
+
+
+#pragma mark - Initialization
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _tracker = rtc::RouteTracker(routeProgressPolicy());
+    }
+    return self;
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Public
+- (RTCRouteTrackerEvent)addLocation:(CLLocation *)location
+{
+    if (!location || !self.route) return RTCRouteTrackerEventNone;
+    rtc::LocationFix fix([location.timestamp timeIntervalSince1970],
+                         location.coordinate.latitude,
+                         location.coordinate.longitude,
+                         location.horizontalAccuracy);
+
+    switch (_tracker.addFix(fix)) {
+        case rtc::RouteTracker::EventOffRoute:
+            return RTCRouteTrackerEventOffRoute;
+        case rtc::RouteTracker::EventBackOnRoute:
+            return RTCRouteTrackerEventBackOnRoute;
+        default:
+            return RTCRouteTrackerEventNone;
+    }
+}
+
+@end
@@ -0,0 +1,99 @@
+//
+//  RTCWorkScheduler.h
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 9/3/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * RTCWorkQueue runs blocks one at a time in the order they were added: a
+ * serial dispatch queue, that RTCWorkScheduler can post timed work to.
+ */
+@interface RTCWorkQueue : NSObject
+
+#pragma mark - Properties
+@property (strong, nonatomic, readonly) dispatch_queue_t queue;
+
+
+#pragma mark - Class Methods
+/**
+ * Queue on the main thread, for work that touches the UI or CoreLocation
+ */
++ (instancetype)mainQueue;
+
+
+#pragma mark - Initialization
+/**
+ * Designated initializer. Wraps an existing queue, which must be serial.
+ */
+- (instancetype)initWithQueue:(dispatch_queue_t)queue;
+
+/**
+ * With a new serial queue.
+ *
+ * @param label     dispatch queue label, e.g. @"com.retracapp.sync"
+ */
+- (instancetype)initWithLabel:(NSString *)label;
+
+
+#pragma mark - Instance Methods
+/**
+ * Run block on the queue after anything added before it
+ */
+- (void)performBlock:(dispatch_block_t)block;
+
+@end
+
+
+/**
+ * RTCTimer stands for work set to run later with RTCWorkScheduler. The work
+ * runs whether or not the timer is kept around; only -cancel stops it.
+ */
+@interface RTCTimer : NSObject
+
+@property (nonatomic, readonly, getter=isCancelled) BOOL cancelled;
+
+/**
+ * Stop the work from running, if it hasn't started. Can be called from any
+ * thread, and is certain to win when called on the work's own queue, even if
+ * the timer fired and the work is waiting its turn there.
+ */
+- (void)cancel;
+
+@end
+
+
+/**
+ * RTCWorkScheduler is a singleton class that runs blocks on work queues after
+ * a delay, in place of performSelector:afterDelay: and NSTimer.
+ *
+ * Timers are kept by rtc::Scheduler in a timing wheel on a private queue, so
+ * setting and cancelling one is O(1) however many are pending, and a single
+ * dispatch timer wakes it up for whichever is due first. Work is never run
+ * on that queue: it is added to its own work queue when due. Time is kept by
+ * rtc::SteadyClock, so changing the wall clock doesn't move timers.
+ */
+@interface RTCWorkScheduler : NSObject
+
+#pragma mark - Class Methods
+/**
+ * Single instance manager.
+ * It creates the instance if this hasn't been done or simply returns it.
+ *
+ * @return An initialized RTCWorkScheduler object.
+ */
++ (instancetype)sharedScheduler;
+
+
+#pragma mark - Instance Methods
+/**
+ * Run block on queue after delay seconds (to within kRTCSchedulerTickDuration).
+ *
+ * @return the timer, to cancel the work with.
+ */
+- (RTCTimer *)performBlock:(dispatch_block_t)block onQueue:(RTCWorkQueue *)queue afterDelay:(NSTimeInterval)delay;
+
+@end
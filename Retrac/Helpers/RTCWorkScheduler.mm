@@ -0,0 +1,293 @@
+//
+//  RTCWorkScheduler.mm
+//  Retrac
+//
+//  Created by Nnoduka Eruchalu on 9/3/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import "RTCWorkScheduler.h"
+#include <cmath>
+#include <limits>
+#include <memory>
+#include "RTCScheduler.h"
+
+#pragma mark - Helpers
+/**
+ * DispatchExecutor lets rtc::Scheduler post work to a dispatch queue
+ */
+class DispatchExecutor : public rtc::Executor {
+public:
+    explicit DispatchExecutor(dispatch_queue_t queue) : _queue(queue) {}
+
+    void post(const std::function<void()> &work)
+    {
+        std::function<void()> block(work);
+        dispatch_async(_queue, ^{ block(); });
+    }
+
+private:
+    dispatch_queue_t _queue;
+};
+
+
+#pragma mark - RTCWorkQueue
+@interface RTCWorkQueue () {
+    std::unique_ptr<DispatchExecutor> _executor;
+}
+
+@property (strong, nonatomic, readwrite) dispatch_queue_t queue;
+
+/**
+ * The queue as an rtc::Executor, for rtc::Scheduler
+ */
+- (rtc::Executor &)executor;
+
+@end
+
+
+@implementation RTCWorkQueue
+
+#pragma mark - Class Methods
++ (instancetype)mainQueue
+{
+    static RTCWorkQueue *sharedInstance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [[self alloc] initWithQueue:dispatch_get_main_queue()];
+    });
+    return sharedInstance;
+}
+
+
+#pragma mark - Initialization
+- (instancetype)initWithQueue:(dispatch_queue_t)queue
+{
+    self = [super init];
+    if (self) {
+        _queue = queue;
+        _executor.reset(new DispatchExecutor(queue));
+    }
+    return self;
+}
+
+- (instancetype)initWithLabel:(NSString *)label
+{
+    return [self initWithQueue:dispatch_queue_create([label UTF8String], DISPATCH_QUEUE_SERIAL)];
+}
+
+- (instancetype)init
+{
+    return [self initWithLabel:nil];
+}
+
+
+#pragma mark - Instance Methods
+- (void)performBlock:(dispatch_block_t)block
+{
+    if (block) dispatch_async(self.queue, block);
+}
+
+- (rtc::Executor &)executor
+{
+    return *_executor;
+}
+
+@end
+
+
+#pragma mark - RTCTimer
+@interface RTCTimer () {
+    rtc::TimerHandle _handle;
+}
+
+- (instancetype)initWithHandle:(const rtc::TimerHandle &)handle;
+
+@end
+
+
+@interface RTCWorkScheduler ()
+
+/**
+ * Take a cancelled timer off the scheduler
+ */
+- (void)removeTimer:(const rtc::TimerHandle &)handle;
+
+@end
+
+
+@implementation RTCTimer
+
+#pragma mark - Properties
+- (BOOL)isCancelled
+{
+    return _handle.isCancelled();
+}
+
+
+#pragma mark - Initialization
+- (instancetype)initWithHandle:(const rtc::TimerHandle &)handle
+{
+    self = [super init];
+    if (self) {
+        _handle = handle;
+    }
+    return self;
+}
+
+
+#pragma mark - Instance Methods
+- (void)cancel
+{
+    if (_handle.isCancelled()) return;
+    // the flag stops the work at once; the scheduler lets go of it in its own
+    // time
+    _handle.cancel();
+    [[RTCWorkScheduler sharedScheduler] removeTimer:_handle];
+}
+
+@end
+
+
+#pragma mark - RTCWorkScheduler
+@interface RTCWorkScheduler () {
+    // pending timers. Only touched on timerQueue.
+    std::unique_ptr<rtc::Scheduler> _scheduler;
+    double _armedDeadline;      // when timerSource fires next, infinity if never
+}
+
+@property (strong, nonatomic) dispatch_queue_t timerQueue;
+@property (strong, nonatomic) dispatch_source_t timerSource;
+
+@end
+
+
+@implementation RTCWorkScheduler
+
+#pragma mark - Class Methods
+#pragma mark Public
+// Declare a static variable, which is an instance of this class
+// It is initialized once and only once in a thread-safe manner by using
+//   Grand Central Dispatch (GCD)
++ (instancetype)sharedScheduler
+{
+    static RTCWorkScheduler *sharedInstance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [[self alloc] initPrivate];
+    });
+    return sharedInstance;
+}
+
+
+#pragma mark - Initialization
+// ideally we would make the designated initializer of the superclass call
+//   the new designated initializer, but that doesn't make sense in this case.
+// if a programmer calls [RTCWorkScheduler alloc] init], let them know the error
+//   of their ways.
+- (instancetype)init
+{
+    @throw [NSException exceptionWithName:@"Singleton"
+                                   reason:@"Use + [RTCWorkScheduler sharedScheduler]"
+                                 userInfo:nil];
+    return nil;
+}
+
+// here is the real (secret) initializer
+// this is the official designated initializer so it will call the designated
+//   initializer of the superclass
+- (instancetype)initPrivate
+{
+    self = [super init];
+    if (self) {
+        _scheduler.reset(new rtc::Scheduler(rtc::SteadyClock::sharedClock(), kRTCSchedulerTickDuration));
+        _armedDeadline = std::numeric_limits<double>::infinity();
+
+        _timerQueue = dispatch_queue_create("com.retracapp.timers", DISPATCH_QUEUE_SERIAL);
+        _timerSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _timerQueue);
+        __weak RTCWorkScheduler *weakSelf = self;
+        dispatch_source_set_event_handler(_timerSource, ^{
+            [weakSelf fireDueTimers];
+        });
+        dispatch_source_set_timer(_timerSource, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+        dispatch_resume(_timerSource);
+    }
+    return self;
+}
+
+
+#pragma mark - Instance Methods
+#pragma mark Private
+/**
+ * Make sure timerSource fires by deadline. Call on timerQueue.
+ */
+- (void)armTimerForDeadline:(double)deadline
+{
+    if (deadline >= _armedDeadline) return;
+    _armedDeadline = deadline;
+
+    if (std::isinf(deadline)) {
+        dispatch_source_set_timer(self.timerSource, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+        return;
+    }
+    double delay = MAX(deadline - rtc::SteadyClock::sharedClock().now(), 0.0);
+    dispatch_source_set_timer(self.timerSource,
+                              dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                              DISPATCH_TIME_FOREVER,
+                              (uint64_t)(kRTCSchedulerTickDuration * NSEC_PER_SEC));
+}
+
+/**
+ * timerSource fired: hand the work that's due to its queues and wait for the
+ * next. Call on timerQueue.
+ */
+- (void)fireDueTimers
+{
+    _armedDeadline = std::numeric_limits<double>::infinity();
+    _scheduler->fireDueTimers();
+    // a dispatch timer can go off a hair early, in which case this is again
+    // nearly at once
+    double deadline = _scheduler->nextDeadline();
+    if (std::isinf(deadline)) {
+        dispatch_source_set_timer(self.timerSource, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+    } else {
+        [self armTimerForDeadline:deadline];
+    }
+}
+
+- (void)removeTimer:(const rtc::TimerHandle &)handle
+{
+    // timerSource is left armed: waking up to nothing is cheaper than finding
+    // the next deadline on every cancel
+    rtc::TimerHandle timer(handle);
+    dispatch_async(self.timerQueue, ^{
+        _scheduler->cancel(timer);
+    });
+}
+
+#pragma mark Public
+- (RTCTimer *)performBlock:(dispatch_block_t)block onQueue:(RTCWorkQueue *)queue afterDelay:(NSTimeInterval)delay
+{
+    if (!block || !queue) return nil;
+
+    // the deadline is from now, not from when timerQueue gets to it
+    double deadline = rtc::SteadyClock::sharedClock().now() + MAX(delay, 0.0);
+    dispatch_block_t work = [block copy];
+    __block rtc::TimerHandle handle;
+
+    // timerQueue only ever does a little bookkeeping and never runs work, so
+    // waiting on it is quick and can't deadlock
+    dispatch_sync(self.timerQueue, ^{
+        // the work holds on to its queue, and so the queue's executor, until
+        // it has run
+        handle = _scheduler->scheduleAt(deadline, [queue executor], [queue, work]() {
+            (void)queue;
+            work();
+        });
+        [self armTimerForDeadline:deadline];
+    });
+
+    return [[RTCTimer alloc] initWithHandle:handle];
+}
+
+@end
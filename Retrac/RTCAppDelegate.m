@@ -8,6 +8,10 @@
 
 #import "RTCAppDelegate.h"
 #import "RTCModelManager.h"
+#import "RTCDirectionsManager.h"
+#import "RTCGeocodingManager.h"
+#import "RTCGeofenceManager.h"
+#import "RTCTraceManager.h"
 
 // Tab Bar item positions
 static const NSUInteger kTabBarIndexPlaces      = 0;
@@ -20,9 +24,16 @@ static const NSUInteger kTabBarIndexAbout       = 2;
 {
     // Override point for customization after application launch.
     
+    // start tracing (if kRTCTraceEnabled) before there's anything to trace
+    [RTCTraceManager sharedManager];
+    
     // Set up managed object context
     [[RTCModelManager sharedManager] setupPlacesDocument:nil];
     
+    // watch for arrivals at and departures from places. A region crossing
+    //   relaunches the app through here too.
+    [[RTCGeofenceManager sharedManager] startMonitoringPlaces];
+    
     // set appearance of views
     [[UITabBar appearance] setTintColor:kRTCThemeColor];
     [[UILabel appearanceWhenContainedIn:[UITableViewHeaderFooterView class], nil] setFont:[UIFont fontWithName:kRTCFontNameBold size:14.0]];
@@ -42,6 +53,22 @@ static const NSUInteger kTabBarIndexAbout       = 2;
     
     return YES;
 }
+
+- (BOOL)application:(UIApplication *)application openURL:(NSURL *)url sourceApplication:(NSString *)sourceApplication annotation:(id)annotation
+{
+    // OpenStreetMap extracts opened in Retrac become the offline walking graph
+    if (![[url pathExtension] isEqualToString:@"osm"]) return NO;
+    
+    [[RTCDirectionsManager sharedManager] importWalkingGraphFromOSMFileAtURL:url completion:^(BOOL success) {
+        // the extract was copied into our Inbox and isn't needed any more
+        [[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+        
+        NSString *message = success ? @"Walking directions will now work offline in the area of this map." : @"This doesn't look like an OpenStreetMap file.";
+        UIAlertView *alertView = [[UIAlertView alloc] initWithTitle:(success ? @"Map Imported" : @"Oops. That didn't work!") message:message delegate:nil cancelButtonTitle:@"OK" otherButtonTitles:nil];
+        [alertView show];
+    }];
+    return YES;
+}
 							
 - (void)applicationWillResignActive:(UIApplication *)application
 {
@@ -53,11 +80,24 @@ static const NSUInteger kTabBarIndexAbout       = 2;
 {
     // Use this method to release shared resources, save user data, invalidate timers, and store enough application state information to restore your application to its current state in case it is terminated later. 
     // If your application supports background execution, this method is called instead of applicationWillTerminate: when the user quits.
+    
+    // the document autosaves itself but the place indexes, sync log, route
+    // and placemark caches are ours to persist
+    [[RTCModelManager sharedManager].placeIndex saveIndex];
+    [[RTCModelManager sharedManager].placeSearchIndex saveIndex];
+    [[RTCModelManager sharedManager].placeSyncLog saveLog];
+    [[RTCModelManager sharedManager] savePlaceSnapshot];
+    [[RTCDirectionsManager sharedManager] saveCache];
+    [[RTCGeocodingManager sharedManager] saveCache];
+    [[RTCTraceManager sharedManager] saveTrace];
 }
 
 - (void)applicationWillEnterForeground:(UIApplication *)application
 {
     // Called as part of the transition from the background to the inactive state; here you can undo many of the changes made on entering the background.
+    
+    // other devices may have changed places while we were away
+    [[RTCModelManager sharedManager].placeSyncLog syncWithCompletion:nil];
 }
 
 - (void)applicationDidBecomeActive:(UIApplication *)application
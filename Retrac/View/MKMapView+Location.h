@@ -19,7 +19,32 @@
  * Sets the visible region so that the map displays the specified annotations.
  * This does a better job than `showAnnotations:animated:` which does cover all
  * annotations but has the camera too far out.
+ *
+ * It goes over every annotation, so it's for maps showing a few of them. Maps
+ * of saved places zoom to - [RTCPlaceIndex getRegionContainingPlaces:] with
+ * `zoomToRegion:` instead.
  */
 - (void)zoomToAnnotations;
 
+/**
+ * Sets the visible region to region plus the same padding
+ * `zoomToAnnotations` uses. Use this with a bounding box that's already known,
+ * such as - [RTCPlaceIndex getRegionContainingPlaces:], rather than adding
+ * every annotation first.
+ */
+- (void)zoomToRegion:(MKCoordinateRegion)region;
+
+/**
+ * Map zoom level: 0 shows the whole world 256 points wide, and each level up
+ * doubles that. Fractional between levels.
+ */
+- (double)zoomLevel;
+
+/**
+ * Make annotations the map's annotations (besides the user location),
+ * removing and adding only the ones that changed so views of the rest stay
+ * put. Annotations are matched with isEqual:.
+ */
+- (void)updateAnnotations:(NSArray *)annotations;
+
 @end
@@ -14,6 +14,9 @@
 static const CLLocationDegrees kMapViewPaddingWidth    = 1.1;
 static const CLLocationDegrees kMapViewPaddingHeight   = 1.5; // maybe use 1.1 here
 
+// screen points across the whole world at zoom level 0
+static const double kMapViewTileSize = 256.0;
+
 @implementation MKMapView (Location)
 
 - (void)zoomToAnnotations
@@ -42,11 +45,46 @@ static const CLLocationDegrees kMapViewPaddingHeight   = 1.5; // maybe use 1.1 h
     MKCoordinateRegion region;
     region.center.latitude = topLeftCoord.latitude - (topLeftCoord.latitude - bottomRightCoord.latitude) * 0.5;
     region.center.longitude = topLeftCoord.longitude + (bottomRightCoord.longitude - topLeftCoord.longitude) * 0.5;
-    region.span.latitudeDelta = fabs(topLeftCoord.latitude - bottomRightCoord.latitude) * kMapViewPaddingHeight; // Add a little extra space on the sides
-    region.span.longitudeDelta = fabs(bottomRightCoord.longitude - topLeftCoord.longitude) * kMapViewPaddingWidth; // Add a little extra space on the sides
+    region.span.latitudeDelta = fabs(topLeftCoord.latitude - bottomRightCoord.latitude);
+    region.span.longitudeDelta = fabs(bottomRightCoord.longitude - topLeftCoord.longitude);
+    
+    [self zoomToRegion:region];
+}
+
+- (void)zoomToRegion:(MKCoordinateRegion)region
+{
+    region.span.latitudeDelta *= kMapViewPaddingHeight; // Add a little extra space on the sides
+    region.span.longitudeDelta *= kMapViewPaddingWidth; // Add a little extra space on the sides
     
     region = [self regionThatFits:region];
     [self setRegion:region animated:YES];
 }
 
+- (double)zoomLevel
+{
+    CLLocationDegrees longitudeDelta = self.region.span.longitudeDelta;
+    if ((longitudeDelta <= 0) || (self.bounds.size.width <= 0)) return 0;
+    return log2(360.0 * self.bounds.size.width / (longitudeDelta * kMapViewTileSize));
+}
+
+- (void)updateAnnotations:(NSArray *)annotations
+{
+    NSSet *shown = [NSSet setWithArray:self.annotations];
+    NSSet *wanted = [NSSet setWithArray:annotations];
+    
+    NSMutableArray *stale = [[NSMutableArray alloc] init];
+    for (id <MKAnnotation> annotation in shown) {
+        if (![annotation isKindOfClass:[MKUserLocation class]] && ![wanted containsObject:annotation]) {
+            [stale addObject:annotation];
+        }
+    }
+    NSMutableArray *fresh = [[NSMutableArray alloc] init];
+    for (id <MKAnnotation> annotation in annotations) {
+        if (![shown containsObject:annotation]) [fresh addObject:annotation];
+    }
+    
+    if ([stale count]) [self removeAnnotations:stale];
+    if ([fresh count]) [self addAnnotations:fresh];
+}
+
 @end
@@ -0,0 +1,283 @@
+//
+//  RTCAccuracySchedulerTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/24/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <cmath>
+#include <random>
+#include "RTCAccuracyReplay.h"
+
+// size of the synthetic request trace in the benchmark
+static const NSUInteger kNumBenchmarkSessions = 400;
+
+// what the screens ask for: saving a place wants a fresh accurate fix,
+//   directions will take a rougher, older one
+static const rtc::AccuracyScheduler::Request kSavePlaceRequest(15.0, 5.0);
+static const rtc::AccuracyScheduler::Request kDirectionsRequest(100.0, 60.0);
+
+@interface RTCAccuracySchedulerTests : XCTestCase
+
+@end
+
+@implementation RTCAccuracySchedulerTests
+
+#pragma mark - Helpers
+static rtc::LocationFix fixAt(double t, double accuracy)
+{
+    return rtc::LocationFix(t, 37.33, -121.89, accuracy);
+}
+
+/**
+ * A day's worth of sessions every few hours for a couple of weeks. Half are
+ * indoors. A session saves a place, gets directions, or gets directions and
+ * then saves the place on arrival; now and then two screens ask at once.
+ */
+static std::vector<rtc::SimulatedLocationRequest> syntheticRequests(std::mt19937 &generator, size_t numSessions)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    std::vector<rtc::SimulatedLocationRequest> requests;
+    double t = 0.0;
+    for (size_t s = 0; s < numSessions; ++s) {
+        bool indoors = (unit(generator) < 0.5);
+        double kind = unit(generator);
+        if (kind < 0.4) {
+            requests.push_back(rtc::SimulatedLocationRequest(t, kSavePlaceRequest, indoors));
+        } else if (kind < 0.8) {
+            requests.push_back(rtc::SimulatedLocationRequest(t, kDirectionsRequest, indoors));
+            // the directions screen asks again on its way back
+            if (unit(generator) < 0.5) {
+                requests.push_back(rtc::SimulatedLocationRequest(t + 10.0 + 40.0 * unit(generator), kDirectionsRequest, indoors));
+            }
+        } else {
+            requests.push_back(rtc::SimulatedLocationRequest(t, kDirectionsRequest, false));
+            requests.push_back(rtc::SimulatedLocationRequest(t + 2.0 + 18.0 * unit(generator), kSavePlaceRequest, false));
+        }
+        if (unit(generator) < 0.2) {
+            requests.push_back(rtc::SimulatedLocationRequest(requests.back().time + 0.5, kDirectionsRequest, indoors));
+        }
+        t = requests.back().time + 3600.0 * (1.0 + 3.0 * unit(generator));
+    }
+    return requests;
+}
+
+
+#pragma mark - Cache
+- (void)testRecentFixAnswersWithoutAcquiring
+{
+    rtc::ManualClock clock(100.0);
+    rtc::AccuracyScheduler scheduler(clock);
+    std::vector<rtc::AccuracyScheduler::Completion> completed;
+
+    // a fix from a trail recording, while idle
+    scheduler.processFix(fixAt(100.0, 20.0), completed);
+    XCTAssertFalse(scheduler.acquiring());
+
+    clock.setNow(130.0);
+    rtc::AccuracyScheduler::RequestID requestID = scheduler.addRequest(kDirectionsRequest, completed);
+    XCTAssertEqual(completed.size(), (size_t)1);
+    XCTAssertEqual(completed[0].requestID, requestID);
+    XCTAssertTrue(completed[0].fromCache);
+    XCTAssertFalse(scheduler.acquiring());
+    XCTAssertEqual(scheduler.numCacheHits(), 1u);
+}
+
+- (void)testStaleOrCoarseFixStartsAcquisition
+{
+    rtc::ManualClock clock(100.0);
+    rtc::AccuracyScheduler scheduler(clock);
+    std::vector<rtc::AccuracyScheduler::Completion> completed;
+
+    scheduler.processFix(fixAt(100.0, 20.0), completed);
+
+    // too coarse for saving a place
+    clock.setNow(101.0);
+    scheduler.addRequest(kSavePlaceRequest, completed);
+    XCTAssertTrue(completed.empty());
+    XCTAssertTrue(scheduler.acquiring());
+    scheduler.finish(completed);
+
+    // too old for directions
+    clock.setNow(200.0);
+    completed.clear();
+    scheduler.addRequest(kDirectionsRequest, completed);
+    XCTAssertTrue(completed.empty());
+    XCTAssertTrue(scheduler.acquiring());
+}
+
+
+#pragma mark - Levels
+- (void)testStartsCoarseAndMovesUp
+{
+    rtc::ManualClock clock(0.0);
+    rtc::AccuracyScheduler scheduler(clock);
+    std::vector<rtc::AccuracyScheduler::Completion> completed;
+
+    scheduler.addRequest(kSavePlaceRequest, completed);
+    XCTAssertEqual(scheduler.level(), rtc::AccuracyLevelHundredMeters);
+
+    // Wi-Fi has done all it can
+    clock.setNow(1.5);
+    scheduler.processFix(fixAt(1.5, 65.0), completed);
+    XCTAssertEqual(scheduler.level(), rtc::AccuracyLevelNearestTenMeters);
+    XCTAssertTrue(completed.empty());
+
+    // never higher than the caller needs
+    clock.setNow(9.0);
+    scheduler.processFix(fixAt(9.0, 12.0), completed);
+    XCTAssertFalse(scheduler.acquiring());
+    XCTAssertEqual(completed.size(), (size_t)1);
+    XCTAssertEqualWithAccuracy(completed[0].fix.horizontalAccuracy, 12.0, 1e-9);
+}
+
+- (void)testLooseRequestStaysCoarse
+{
+    rtc::ManualClock clock(0.0);
+    rtc::AccuracyScheduler scheduler(clock);
+    std::vector<rtc::AccuracyScheduler::Completion> completed;
+
+    scheduler.addRequest(rtc::AccuracyScheduler::Request(1000.0, 0.0), completed);
+    XCTAssertEqual(scheduler.level(), rtc::AccuracyLevelKilometer);
+
+    clock.setNow(1.0);
+    scheduler.processFix(fixAt(1.0, 800.0), completed);
+    XCTAssertFalse(scheduler.acquiring());
+    XCTAssertEqual(completed.size(), (size_t)1);
+}
+
+- (void)testSilentLevelMovesUp
+{
+    rtc::ManualClock clock(0.0);
+    rtc::AccuracyScheduler scheduler(clock);
+    std::vector<rtc::AccuracyScheduler::Completion> completed;
+
+    scheduler.addRequest(kSavePlaceRequest, completed);
+    XCTAssertEqualWithAccuracy(scheduler.deadline(), scheduler.policy().levelWaitTime, 1e-9);
+
+    clock.setNow(scheduler.deadline());
+    scheduler.handleTimeout(completed);
+    XCTAssertEqual(scheduler.level(), rtc::AccuracyLevelNearestTenMeters);
+    XCTAssertTrue(scheduler.acquiring());
+}
+
+- (void)testStopsMovingUpOnceNotImproving
+{
+    rtc::ManualClock clock(0.0);
+    rtc::AccuracyScheduler scheduler(clock);
+    std::vector<rtc::AccuracyScheduler::Completion> completed;
+
+    // indoors: the GPS gets nothing better than Wi-Fi
+    scheduler.addRequest(rtc::AccuracyScheduler::Request(5.0, 0.0), completed);
+    clock.setNow(1.0);
+    scheduler.processFix(fixAt(1.0, 65.0), completed);
+    XCTAssertEqual(scheduler.level(), rtc::AccuracyLevelNearestTenMeters);
+    for (double t = 2.0; t < 4.5; t += 1.0) {
+        clock.setNow(t);
+        scheduler.processFix(fixAt(t, 65.0), completed);
+    }
+
+    clock.setNow(scheduler.deadline());
+    scheduler.handleTimeout(completed);
+    XCTAssertEqual(scheduler.level(), rtc::AccuracyLevelNearestTenMeters);
+    XCTAssertTrue(scheduler.acquiring());
+
+    // so it gives up with what it has rather than going to Best
+    clock.setNow(scheduler.deadline());
+    scheduler.handleTimeout(completed);
+    XCTAssertFalse(scheduler.acquiring());
+    XCTAssertEqual(completed.size(), (size_t)1);
+    XCTAssertTrue(completed[0].hasFix);
+}
+
+
+#pragma mark - Sharing
+- (void)testConcurrentRequestsShareAcquisition
+{
+    rtc::ManualClock clock(0.0);
+    rtc::AccuracyScheduler scheduler(clock);
+    std::vector<rtc::AccuracyScheduler::Completion> completed;
+
+    rtc::AccuracyScheduler::RequestID directions = scheduler.addRequest(kDirectionsRequest, completed);
+    clock.setNow(0.5);
+    rtc::AccuracyScheduler::RequestID savePlace = scheduler.addRequest(kSavePlaceRequest, completed);
+    XCTAssertNotEqual(directions, savePlace);
+    XCTAssertEqual(scheduler.numPendingRequests(), (size_t)2);
+
+    // good enough for directions, not for saving
+    clock.setNow(1.5);
+    scheduler.processFix(fixAt(1.5, 65.0), completed);
+    XCTAssertEqual(completed.size(), (size_t)1);
+    XCTAssertEqual(completed[0].requestID, directions);
+    XCTAssertTrue(scheduler.acquiring());
+
+    clock.setNow(9.0);
+    scheduler.processFix(fixAt(9.0, 8.0), completed);
+    XCTAssertEqual(completed.size(), (size_t)2);
+    XCTAssertEqual(completed[1].requestID, savePlace);
+    XCTAssertFalse(scheduler.acquiring());
+    XCTAssertEqual(scheduler.numAcquisitions(), 1u);
+}
+
+- (void)testFinishAnswersEveryone
+{
+    rtc::ManualClock clock(0.0);
+    rtc::AccuracyScheduler scheduler(clock);
+    std::vector<rtc::AccuracyScheduler::Completion> completed;
+
+    scheduler.addRequest(kSavePlaceRequest, completed);
+    scheduler.addRequest(kSavePlaceRequest, completed);
+    scheduler.finish(completed);
+    XCTAssertEqual(completed.size(), (size_t)2);
+    XCTAssertFalse(completed[0].hasFix);
+    XCTAssertFalse(scheduler.acquiring());
+    XCTAssertTrue(std::isinf(scheduler.deadline()));
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Replay a couple of weeks of synthetic location requests through the
+ * simulated provider, with the GPS on from the start and no cache like
+ * RTCLocationManager used to, and with the default policy. Logs energy, GPS
+ * time, latency and how many callers got the accuracy they asked for.
+ */
+- (void)testReplaySyntheticRequestsPerformance
+{
+    std::mt19937 generator(2014);
+    std::vector<rtc::SimulatedLocationRequest> requests = syntheticRequests(generator, kNumBenchmarkSessions);
+
+    rtc::AccuracySchedulerPolicy alwaysBest;
+    alwaysBest.initialLevel = rtc::AccuracyLevelBest;
+    alwaysBest.maxCacheAge = 0;
+
+    const rtc::AccuracySchedulerPolicy policies[] = {alwaysBest, rtc::AccuracySchedulerPolicy()};
+    const char *policyNames[] = {"always best", "scheduler"};
+    rtc::AccuracyReplaySummary summaries[2];
+    for (size_t p = 0; p < 2; ++p) {
+        summaries[p] = rtc::replayLocationRequests(requests, policies[p]);
+        const rtc::AccuracyReplaySummary &summary = summaries[p];
+        NSLog(@"[%@] %s: %u requests, %.1f%% satisfied, %u from cache, %u acquisitions; latency %.2fs mean, %.2fs p90; "
+              "mean accuracy %.1fm; %.1fJ, %.0fs of GPS",
+              NSStringFromSelector(_cmd), policyNames[p], summary.numRequests, 100.0 * summary.satisfiedRate(),
+              summary.numFromCache, summary.numAcquisitions, summary.meanLatency, summary.p90Latency,
+              summary.meanAccuracy, summary.energy, summary.gpsTime);
+    }
+
+    const rtc::AccuracyReplaySummary &before = summaries[0], &after = summaries[1];
+    XCTAssertGreaterThan(after.numFromCache, 0u);
+    XCTAssertLessThan(after.numAcquisitions, before.numAcquisitions);
+    XCTAssertLessThan(after.energy, 0.7 * before.energy);
+    XCTAssertGreaterThan(after.satisfiedRate(), before.satisfiedRate() - 0.02);
+    XCTAssertLessThan(after.meanLatency, before.meanLatency);
+
+    const std::vector<rtc::SimulatedLocationRequest> *requestsPtr = &requests;
+    [self measureBlock:^{
+        rtc::replayLocationRequests(*requestsPtr);
+    }];
+}
+
+@end
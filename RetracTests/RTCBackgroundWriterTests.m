@@ -0,0 +1,237 @@
+//
+//  RTCBackgroundWriterTests.m
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/19/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "RTCBackgroundWriter.h"
+#import "RTCPlace.h"
+#import "RTCPlace+Location.h"
+
+// synthetic load for the benchmark: inserts per second, and for how long
+static const double kBenchmarkInsertsPerSecond = 200.0;
+static const NSTimeInterval kBenchmarkDuration = 5.0;
+
+@interface RTCBackgroundWriterTests : XCTestCase
+
+@property (strong, nonatomic) NSURL *storeDirectoryURL;
+
+@end
+
+@implementation RTCBackgroundWriterTests
+
+#pragma mark - Setup
+- (void)setUp
+{
+    [super setUp];
+    NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    self.storeDirectoryURL = [NSURL fileURLWithPath:directory isDirectory:YES];
+    [[NSFileManager defaultManager] createDirectoryAtURL:self.storeDirectoryURL
+                             withIntermediateDirectories:YES
+                                              attributes:nil
+                                                   error:NULL];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtURL:self.storeDirectoryURL error:NULL];
+    [super tearDown];
+}
+
+
+#pragma mark - Helpers
+/**
+ * A main-queue context on an SQLite store in the test's directory, set up the
+ * way UIManagedDocument does it: a child of a private-queue context that owns
+ * the store
+ */
+- (NSManagedObjectContext *)documentStyleContextForStoreNamed:(NSString *)storeName
+{
+    NSBundle *bundle = [NSBundle bundleForClass:[RTCPlace class]];
+    NSURL *modelURL = [bundle URLForResource:@"Retrac 2" withExtension:@"mom" subdirectory:@"Retrac.momd"];
+    NSManagedObjectModel *model = [[NSManagedObjectModel alloc] initWithContentsOfURL:modelURL];
+
+    NSPersistentStoreCoordinator *coordinator = [[NSPersistentStoreCoordinator alloc] initWithManagedObjectModel:model];
+    NSError *error = nil;
+    [coordinator addPersistentStoreWithType:NSSQLiteStoreType
+                              configuration:nil
+                                        URL:[self.storeDirectoryURL URLByAppendingPathComponent:storeName]
+                                    options:nil
+                                      error:&error];
+    XCTAssertNil(error);
+
+    NSManagedObjectContext *parentContext = [[NSManagedObjectContext alloc] initWithConcurrencyType:NSPrivateQueueConcurrencyType];
+    parentContext.persistentStoreCoordinator = coordinator;
+    NSManagedObjectContext *context = [[NSManagedObjectContext alloc] initWithConcurrencyType:NSMainQueueConcurrencyType];
+    context.parentContext = parentContext;
+    return context;
+}
+
+- (CLLocation *)locationForPlaceNumber:(NSUInteger)i
+{
+    return [[CLLocation alloc] initWithLatitude:37.0 + i * 1e-4 longitude:-122.0 - i * 1e-4];
+}
+
+- (NSUInteger)numPlacesInContext:(NSManagedObjectContext *)context
+{
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    return [context countForFetchRequest:request error:NULL];
+}
+
+/**
+ * Flush writer and wait for the writes to reach its main context
+ */
+- (void)flushWriter:(RTCBackgroundWriter *)writer
+{
+    XCTestExpectation *flushed = [self expectationWithDescription:@"flushed"];
+    [writer flushWrites:^{
+        [flushed fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10.0 handler:nil];
+}
+
+
+#pragma mark - Writing
+- (void)testWritesAreBatchedAndMerged
+{
+    NSManagedObjectContext *context = [self documentStyleContextForStoreNamed:@"Places.sqlite"];
+    RTCBackgroundWriter *writer = [[RTCBackgroundWriter alloc] initWithManagedObjectContext:context];
+    __block NSUInteger numMerges = 0;
+    writer.writesMerged = ^{
+        numMerges++;
+    };
+
+    NSUInteger numPlaces = 2 * kRTCWriteBatchSize + 1;
+    for (NSUInteger i = 0; i < numPlaces; ++i) {
+        NSString *name = [NSString stringWithFormat:@"Place %lu", (unsigned long)i];
+        CLLocation *location = [self locationForPlaceNumber:i];
+        [writer performWrite:^(NSManagedObjectContext *writerContext) {
+            [RTCPlace placeWithName:name location:location placemark:nil inManagedObjectContext:writerContext];
+        }];
+    }
+    [self flushWriter:writer];
+
+    // two full batches and the one left over
+    XCTAssertEqual([self numPlacesInContext:context], numPlaces);
+    XCTAssertEqual(writer.numWrites, numPlaces);
+    XCTAssertEqual(writer.numSaves, (NSUInteger)3);
+    XCTAssertEqual(numMerges, (NSUInteger)3);
+
+    // merged places have the IDs the store will give them
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    for (RTCPlace *place in [context executeFetchRequest:request error:NULL]) {
+        XCTAssertFalse([place.objectID isTemporaryID]);
+    }
+
+    XCTAssertGreaterThan([writer saveLatencyAtPercentile:0.5], 0.0);
+    XCTAssertLessThanOrEqual([writer saveLatencyAtPercentile:0.5], [writer saveLatencyAtPercentile:0.99]);
+}
+
+- (void)testUpdatesReachMainContext
+{
+    NSManagedObjectContext *context = [self documentStyleContextForStoreNamed:@"Places.sqlite"];
+    RTCPlace *place = [RTCPlace placeWithName:@"Home" location:[self locationForPlaceNumber:0] placemark:nil inManagedObjectContext:context];
+    XCTAssertTrue([context obtainPermanentIDsForObjects:@[place] error:NULL]);
+    XCTAssertTrue([context save:NULL]);
+    NSManagedObjectID *placeID = place.objectID;
+    XCTAssertFalse([placeID isTemporaryID]);
+
+    RTCBackgroundWriter *writer = [[RTCBackgroundWriter alloc] initWithManagedObjectContext:context];
+    [writer performWrite:^(NSManagedObjectContext *writerContext) {
+        RTCPlace *writerPlace = (RTCPlace *)[writerContext existingObjectWithID:placeID error:NULL];
+        writerPlace.name = @"Work";
+    }];
+    [self flushWriter:writer];
+
+    XCTAssertEqualObjects(place.name, @"Work");
+    XCTAssertFalse([context hasChanges]);
+}
+
+- (void)testWritesWaitForBatchDelay
+{
+    NSManagedObjectContext *context = [self documentStyleContextForStoreNamed:@"Places.sqlite"];
+    RTCBackgroundWriter *writer = [[RTCBackgroundWriter alloc] initWithManagedObjectContext:context];
+
+    XCTestExpectation *merged = [self expectationWithDescription:@"merged"];
+    writer.writesMerged = ^{
+        [merged fulfill];
+    };
+    CLLocation *location = [self locationForPlaceNumber:0];
+    [writer performWrite:^(NSManagedObjectContext *writerContext) {
+        [RTCPlace placeWithName:@"Home" location:location placemark:nil inManagedObjectContext:writerContext];
+    }];
+
+    // not merged straight away, but without a flush
+    XCTAssertEqual([self numPlacesInContext:context], (NSUInteger)0);
+    [self waitForExpectationsWithTimeout:10.0 * kRTCWriteBatchDelay handler:nil];
+    XCTAssertEqual([self numPlacesInContext:context], (NSUInteger)1);
+    XCTAssertGreaterThanOrEqual([writer saveLatencyAtPercentile:1.0], kRTCWriteBatchDelay);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Insert kBenchmarkInsertsPerSecond places a second for kBenchmarkDuration,
+ * once straight into the main context with a save after each (what an
+ * autosave after every insert costs the main queue) and once through the
+ * writer. Logs main queue time per insert for both, and the writer's save
+ * latency percentiles.
+ */
+- (void)testWriteLoadBenchmark
+{
+    NSUInteger numInserts = (NSUInteger)(kBenchmarkInsertsPerSecond * kBenchmarkDuration);
+
+    // on the main queue
+    NSManagedObjectContext *directContext = [self documentStyleContextForStoreNamed:@"Direct.sqlite"];
+    NSDate *start = [NSDate date];
+    for (NSUInteger i = 0; i < numInserts; ++i) {
+        [RTCPlace placeWithName:@"Place" location:[self locationForPlaceNumber:i] placemark:nil inManagedObjectContext:directContext];
+        XCTAssertTrue([directContext save:NULL]);
+        NSManagedObjectContext *parentContext = directContext.parentContext;
+        [parentContext performBlock:^{
+            [parentContext save:NULL];
+        }];
+    }
+    NSTimeInterval directTime = -[start timeIntervalSinceNow];
+
+    // through the writer, paced to the load so batching works as it would
+    NSManagedObjectContext *context = [self documentStyleContextForStoreNamed:@"Places.sqlite"];
+    RTCBackgroundWriter *writer = [[RTCBackgroundWriter alloc] initWithManagedObjectContext:context];
+    NSManagedObjectContext *parentContext = context.parentContext;
+    writer.writesMerged = ^{
+        [parentContext performBlock:^{
+            [parentContext save:NULL];
+        }];
+    };
+
+    __block NSTimeInterval queueTime = 0;
+    XCTestExpectation *queued = [self expectationWithDescription:@"queued"];
+    for (NSUInteger i = 0; i < numInserts; ++i) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(i / kBenchmarkInsertsPerSecond * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+            NSDate *queueStart = [NSDate date];
+            CLLocation *location = [self locationForPlaceNumber:i];
+            [writer performWrite:^(NSManagedObjectContext *writerContext) {
+                [RTCPlace placeWithName:@"Place" location:location placemark:nil inManagedObjectContext:writerContext];
+            }];
+            queueTime -= [queueStart timeIntervalSinceNow];
+            if (i == numInserts - 1) [queued fulfill];
+        });
+    }
+    [self waitForExpectationsWithTimeout:2.0 * kBenchmarkDuration handler:nil];
+    [self flushWriter:writer];
+    XCTAssertEqual([self numPlacesInContext:context], numInserts);
+
+    NSTimeInterval writerTime = queueTime + writer.mainQueueTime;
+    NSLog(@"[%@] %lu inserts at %.0f/s: main queue %.3fms per insert direct, %.3fms per insert through the writer (%lu saves); save latency p50 %.0fms, p90 %.0fms, p99 %.0fms",
+          NSStringFromSelector(_cmd), (unsigned long)numInserts, kBenchmarkInsertsPerSecond,
+          directTime / numInserts * 1e3, writerTime / numInserts * 1e3, (unsigned long)writer.numSaves,
+          [writer saveLatencyAtPercentile:0.5] * 1e3, [writer saveLatencyAtPercentile:0.9] * 1e3,
+          [writer saveLatencyAtPercentile:0.99] * 1e3);
+
+    XCTAssertLessThan(writerTime, directTime);
+}
+
+@end
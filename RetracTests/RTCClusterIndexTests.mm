@@ -0,0 +1,251 @@
+//
+//  RTCClusterIndexTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/20/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <set>
+#include "RTCClusterIndex.h"
+
+// viewport size, in screen points, of the queries in the benchmark
+static const double kViewportWidth  = 320.0;
+static const double kViewportHeight = 568.0;
+
+// number of random viewports timed per index size in the benchmark
+static const NSUInteger kNumBenchmarkQueries = 10000;
+
+// benchmark places are spread at this density (per square degree) whatever
+// their number, like a city's worth of saved places
+static const double kBenchmarkPlacesPerSquareDegree = 1e5;
+
+@interface RTCClusterIndexTests : XCTestCase
+
+@end
+
+@implementation RTCClusterIndexTests
+
+#pragma mark - Helpers
+/**
+ * numPlaces uniformly spread over a square of side degrees with a corner at
+ * origin
+ */
+static std::vector<rtc::ClusterIndex::Record> randomRecords(std::mt19937 &generator, size_t numPlaces,
+                                                            const rtc::GeoPoint &origin, double side)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<rtc::ClusterIndex::Record> records;
+    for (size_t i = 0; i < numPlaces; ++i) {
+        rtc::GeoPoint coordinate(origin.latitude + side * unit(generator),
+                                 origin.longitude + side * unit(generator));
+        records.push_back(rtc::ClusterIndex::Record(i + 1, coordinate));
+    }
+    return records;
+}
+
+/**
+ * The viewport a map of kViewportWidth x kViewportHeight points shows around
+ * center at zoom level zoom
+ */
+static rtc::GeoRect viewportAround(const rtc::GeoPoint &center, double zoom)
+{
+    double worldSize = 256.0 * std::pow(2.0, zoom);
+    double halfLongitude = 180.0 * kViewportWidth / worldSize;
+
+    double sinLatitude = std::sin(center.latitude * rtc::kDegreesToRadians);
+    double y = 0.5 - 0.25 * std::log((1.0 + sinLatitude) / (1.0 - sinLatitude)) / M_PI;
+    double halfY = 0.5 * kViewportHeight / worldSize;
+    double north = 2.0 * std::atan(std::exp((0.5 - (y - halfY)) * 2.0 * M_PI)) * rtc::kRadiansToDegrees - 90.0;
+    double south = 2.0 * std::atan(std::exp((0.5 - (y + halfY)) * 2.0 * M_PI)) * rtc::kRadiansToDegrees - 90.0;
+
+    return rtc::GeoRect(south, center.longitude - halfLongitude, north, center.longitude + halfLongitude);
+}
+
+static bool viewportContains(const rtc::GeoRect &viewport, const rtc::GeoPoint &point)
+{
+    if ((point.latitude < viewport.minLatitude) || (point.latitude > viewport.maxLatitude)) return false;
+    if (viewport.minLongitude <= viewport.maxLongitude) {
+        return (point.longitude >= viewport.minLongitude) && (point.longitude <= viewport.maxLongitude);
+    }
+    return (point.longitude >= viewport.minLongitude) || (point.longitude <= viewport.maxLongitude);
+}
+
+static std::set<uint64_t> clusterIDs(const std::vector<rtc::ClusterIndex::Cluster> &clusters)
+{
+    std::set<uint64_t> ids;
+    for (size_t i = 0; i < clusters.size(); ++i) ids.insert(clusters[i].id);
+    return ids;
+}
+
+
+#pragma mark - Clusters
+- (void)testEveryPlaceIsInOneClusterAtEveryZoom
+{
+    std::mt19937 generator(2014);
+    std::vector<rtc::ClusterIndex::Record> records = randomRecords(generator, 5000, rtc::GeoPoint(37.0, -122.5), 1.0);
+    rtc::ClusterIndex index;
+    index.assign(records);
+    XCTAssertEqual(index.size(), records.size());
+
+    rtc::GeoRect world(-90.0, -180.0, 90.0, 180.0);
+    size_t previousCount = 0;
+    for (int zoom = 0; zoom <= index.maxZoom() + 1; ++zoom) {
+        std::vector<rtc::ClusterIndex::Cluster> clusters = index.clusters(world, zoom);
+        XCTAssertGreaterThanOrEqual(clusters.size(), previousCount, @"zoom %d", zoom);
+        previousCount = clusters.size();
+
+        size_t numPlaces = 0;
+        for (size_t i = 0; i < clusters.size(); ++i) {
+            numPlaces += clusters[i].count;
+            const rtc::GeoRect &bounds = clusters[i].bounds;
+            XCTAssertLessThanOrEqual(bounds.minLatitude, clusters[i].coordinate.latitude);
+            XCTAssertGreaterThanOrEqual(bounds.maxLatitude, clusters[i].coordinate.latitude);
+            XCTAssertLessThanOrEqual(bounds.minLongitude, clusters[i].coordinate.longitude);
+            XCTAssertGreaterThanOrEqual(bounds.maxLongitude, clusters[i].coordinate.longitude);
+        }
+        XCTAssertEqual(numPlaces, records.size(), @"zoom %d", zoom);
+    }
+
+    // places are all shown on their own past the last clustered level
+    XCTAssertEqual(previousCount, records.size());
+    XCTAssertLessThan(index.clusters(world, 0).size(), (size_t)10);
+}
+
+- (void)testViewportQueriesMatchBruteForce
+{
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    rtc::GeoPoint corner(37.0, -122.5);
+    std::vector<rtc::ClusterIndex::Record> records = randomRecords(generator, 5000, corner, 1.0);
+    rtc::ClusterIndex index;
+    index.assign(records);
+
+    rtc::GeoRect world(-90.0, -180.0, 90.0, 180.0);
+    for (NSUInteger q = 0; q < 200; ++q) {
+        double zoom = (index.maxZoom() + 2) * unit(generator);
+        rtc::GeoPoint center(corner.latitude + unit(generator), corner.longitude + unit(generator));
+        rtc::GeoRect viewport = viewportAround(center, zoom);
+
+        // the viewport's clusters are the ones of the whole world inside it
+        std::set<uint64_t> expected;
+        std::vector<rtc::ClusterIndex::Cluster> all = index.clusters(world, zoom);
+        for (size_t i = 0; i < all.size(); ++i) {
+            if (viewportContains(viewport, all[i].coordinate)) expected.insert(all[i].id);
+        }
+        std::vector<rtc::ClusterIndex::Cluster> clusters = index.clusters(viewport, zoom);
+        XCTAssertTrue(clusterIDs(clusters) == expected, @"viewport %lu at zoom %.2f", (unsigned long)q, zoom);
+        XCTAssertEqual(clusters.size(), expected.size());
+        XCTAssertLessThan(index.lastQueryVisits(), 4 * expected.size() + 100);
+    }
+}
+
+- (void)testViewportAcrossAntimeridian
+{
+    std::vector<rtc::ClusterIndex::Record> records;
+    records.push_back(rtc::ClusterIndex::Record(1, rtc::GeoPoint(-17.0, 179.9)));
+    records.push_back(rtc::ClusterIndex::Record(2, rtc::GeoPoint(-17.0, -179.9)));
+    records.push_back(rtc::ClusterIndex::Record(3, rtc::GeoPoint(-17.0, 170.0)));
+    rtc::ClusterIndex index;
+    index.assign(records);
+
+    rtc::GeoRect viewport(-18.0, 179.0, -16.0, -179.0);
+    std::set<uint64_t> ids = clusterIDs(index.clusters(viewport, index.maxZoom() + 1));
+    XCTAssertEqual(ids.size(), (size_t)2);
+    XCTAssertTrue(ids.count(1) && ids.count(2));
+}
+
+- (void)testBoundsComeFromIndex
+{
+    rtc::ClusterIndex index;
+    XCTAssertFalse(index.bounds(NULL));
+
+    std::mt19937 generator(3);
+    std::vector<rtc::ClusterIndex::Record> records = randomRecords(generator, 1000, rtc::GeoPoint(51.3, -0.5), 0.8);
+    index.assign(records);
+
+    rtc::GeoRect expected(records[0].coordinate);
+    for (size_t i = 1; i < records.size(); ++i) expected.extend(rtc::GeoRect(records[i].coordinate));
+
+    rtc::GeoRect bounds;
+    XCTAssertTrue(index.bounds(&bounds));
+    XCTAssertLessThanOrEqual(bounds.minLatitude, expected.minLatitude);
+    XCTAssertLessThanOrEqual(bounds.minLongitude, expected.minLongitude);
+    XCTAssertGreaterThanOrEqual(bounds.maxLatitude, expected.maxLatitude);
+    XCTAssertGreaterThanOrEqual(bounds.maxLongitude, expected.maxLongitude);
+    XCTAssertEqualWithAccuracy(bounds.minLatitude, expected.minLatitude, 1e-4);
+    XCTAssertEqualWithAccuracy(bounds.maxLongitude, expected.maxLongitude, 1e-4);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Query random phone-sized viewports at random zoom levels over 10^5 and 10^6
+ * places. Logs build time, average and 99th percentile query time and visits.
+ * Showing a viewport has to stay well under a frame.
+ */
+- (void)testViewportQueryPerformance
+{
+    const size_t sizes[] = {100000, 1000000};
+    const size_t numSizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    rtc::GeoPoint corner(37.0, -122.0);
+
+    for (size_t s = 0; s < numSizes; ++s) {
+        double side = std::sqrt(sizes[s] / kBenchmarkPlacesPerSquareDegree);
+        std::vector<rtc::ClusterIndex::Record> records = randomRecords(generator, sizes[s], corner, side);
+
+        rtc::ClusterIndex index;
+        auto buildStart = std::chrono::steady_clock::now();
+        index.assign(records);
+        auto buildEnd = std::chrono::steady_clock::now();
+
+        std::vector<rtc::GeoRect> viewports;
+        std::vector<double> zooms;
+        for (NSUInteger q = 0; q < kNumBenchmarkQueries; ++q) {
+            zooms.push_back((index.maxZoom() + 2) * unit(generator));
+            rtc::GeoPoint center(corner.latitude + side * unit(generator), corner.longitude + side * unit(generator));
+            viewports.push_back(viewportAround(center, zooms.back()));
+        }
+
+        std::vector<double> times;
+        size_t visits = 0, numClusters = 0;
+        for (size_t q = 0; q < viewports.size(); ++q) {
+            auto start = std::chrono::steady_clock::now();
+            numClusters += index.clusters(viewports[q], zooms[q]).size();
+            auto end = std::chrono::steady_clock::now();
+            times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+            visits += index.lastQueryVisits();
+        }
+        double average = 0;
+        for (size_t q = 0; q < times.size(); ++q) average += times[q] / times.size();
+        std::sort(times.begin(), times.end());
+        double p99 = times[(size_t)(0.99 * times.size())];
+
+        NSLog(@"[%@] %zu places: built in %.0fms (%zu clusters over all levels); viewport %.2fus average, %.2fus p99, %.0f visits, %.0f clusters shown",
+              NSStringFromSelector(_cmd), sizes[s],
+              std::chrono::duration<double, std::milli>(buildEnd - buildStart).count(), index.numNodes(),
+              average, p99, (double)visits / viewports.size(), (double)numClusters / viewports.size());
+
+        XCTAssertLessThan(average, 1000.0);
+
+        // time the largest index with XCTest so regressions show up in the report
+        if (s == numSizes - 1) {
+            const rtc::ClusterIndex *indexPtr = &index;
+            const std::vector<rtc::GeoRect> *viewportsPtr = &viewports;
+            const std::vector<double> *zoomsPtr = &zooms;
+            [self measureBlock:^{
+                for (size_t q = 0; q < viewportsPtr->size(); ++q) indexPtr->clusters((*viewportsPtr)[q], (*zoomsPtr)[q]);
+            }];
+        }
+    }
+}
+
+@end
@@ -0,0 +1,319 @@
+//
+//  RTCDuplicateIndexTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 9/1/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include "RTCDuplicateIndex.h"
+
+// number of random fixes checked against a linear scan
+static const NSUInteger kNumBruteForceQueries = 2000;
+
+// number of saves timed per store size in the benchmark
+static const NSUInteger kNumBenchmarkSaves = 10000;
+
+// benchmark places are spread at this density (per square degree) whatever
+// their number, so a save's neighbourhood looks the same at every size: about
+// one place per 100m square, as in a busy downtown
+static const double kBenchmarkPlacesPerSquareDegree = 1e6;
+
+@interface RTCDuplicateIndexTests : XCTestCase
+
+@end
+
+@implementation RTCDuplicateIndexTests
+
+#pragma mark - Helpers
+/**
+ * Point east and north (meters) of origin
+ */
+static rtc::GeoPoint offsetPoint(const rtc::GeoPoint &origin, double east, double north)
+{
+    double metersPerDegree = rtc::kEarthRadius * rtc::kDegreesToRadians;
+    double longitude = origin.longitude + east / (metersPerDegree * std::cos(origin.latitude * rtc::kDegreesToRadians));
+    if (longitude >= 180.0) longitude -= 360.0;
+    if (longitude < -180.0) longitude += 360.0;
+    return rtc::GeoPoint(origin.latitude + north / metersPerDegree, longitude);
+}
+
+/**
+ * numPlaces uniformly spread over a square of side degrees with a corner at
+ * origin, with accuracies from 5 to 65m and a creation date a minute apart
+ */
+static std::vector<rtc::DuplicateIndex::Record> randomRecords(std::mt19937 &generator, size_t numPlaces,
+                                                              const rtc::GeoPoint &origin, double side)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<rtc::DuplicateIndex::Record> records;
+    records.reserve(numPlaces);
+    for (size_t i = 0; i < numPlaces; ++i) {
+        rtc::GeoPoint coordinate(std::min(90.0, origin.latitude + side * unit(generator)),
+                                 origin.longitude + side * unit(generator));
+        if (coordinate.longitude >= 180.0) coordinate.longitude -= 360.0;
+        records.push_back(rtc::DuplicateIndex::Record(i + 1, coordinate, 5.0 + 60.0 * unit(generator), 60.0 * i));
+    }
+    return records;
+}
+
+/**
+ * The duplicate a fix has by linear scan, for checking lookups
+ */
+static bool bruteForceDuplicate(const std::vector<rtc::DuplicateIndex::Record> &records, const rtc::DuplicatePolicy &policy,
+                                const rtc::GeoPoint &coordinate, double accuracy, rtc::DuplicateIndex::PlaceID *placeID)
+{
+    bool found = false;
+    double bestDistance = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        double d = rtc::distanceBetween(coordinate, records[i].coordinate);
+        if (d > policy.radius(accuracy, records[i].horizontalAccuracy)) continue;
+        if (!found || (d < bestDistance) || ((d == bestDistance) && (records[i].placeID < *placeID))) {
+            found = true;
+            bestDistance = d;
+            *placeID = records[i].placeID;
+        }
+    }
+    return found;
+}
+
+
+#pragma mark - Lookups
+- (void)testDuplicateRadiusFollowsAccuracy
+{
+    rtc::GeoPoint spot(37.3259, -121.9455);
+    rtc::DuplicateIndex index;
+    index.insert(rtc::DuplicateIndex::Record(1, spot, 5.0, 0));
+
+    rtc::DuplicateIndex::PlaceID placeID = 0;
+    double distance = 0;
+    XCTAssertTrue(index.findDuplicate(offsetPoint(spot, 6.0, 6.0), 5.0, &placeID, &distance));
+    XCTAssertEqual(placeID, 1u);
+    XCTAssertEqualWithAccuracy(distance, 6.0 * std::sqrt(2.0), 0.01);
+
+    // 30m off is only the same spot if the fix could be that far out...
+    XCTAssertFalse(index.findDuplicate(offsetPoint(spot, 30.0, 0.0), 5.0, &placeID));
+    XCTAssertTrue(index.findDuplicate(offsetPoint(spot, 30.0, 0.0), 40.0, &placeID));
+    XCTAssertFalse(index.findDuplicate(offsetPoint(spot, 30.0, 0.0), -1.0, &placeID));
+
+    // ...and a poor fix never reaches past maxRadius
+    XCTAssertFalse(index.findDuplicate(offsetPoint(spot, 0.0, 60.0), 500.0, &placeID));
+
+    // the nearer of two wins
+    index.insert(rtc::DuplicateIndex::Record(2, offsetPoint(spot, 20.0, 0.0), 30.0, 60.0));
+    XCTAssertTrue(index.findDuplicate(offsetPoint(spot, 15.0, 0.0), 30.0, &placeID));
+    XCTAssertEqual(placeID, 2u);
+}
+
+- (void)testLookupsMatchBruteForce
+{
+    std::mt19937 generator(2014);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    rtc::DuplicatePolicy policy;
+
+    // a dense patch, one across the antimeridian and one at the pole
+    std::vector<rtc::DuplicateIndex::Record> records = randomRecords(generator, 20000, rtc::GeoPoint(37.0, -122.0), 0.02);
+    std::vector<rtc::DuplicateIndex::Record> more = randomRecords(generator, 5000, rtc::GeoPoint(-20.005, 179.995), 0.01);
+    std::vector<rtc::DuplicateIndex::Record> polar = randomRecords(generator, 5000, rtc::GeoPoint(89.995, -180.0), 0.01);
+    for (size_t i = 0; i < polar.size(); ++i) polar[i].placeID += more.size();
+    more.insert(more.end(), polar.begin(), polar.end());
+    for (size_t i = 0; i < more.size(); ++i) more[i].placeID += records.size();
+    records.insert(records.end(), more.begin(), more.end());
+
+    rtc::DuplicateIndex index(policy);
+    index.assign(records);
+    XCTAssertEqual(index.size(), records.size());
+
+    for (NSUInteger q = 0; q < kNumBruteForceQueries; ++q) {
+        const rtc::DuplicateIndex::Record &near = records[generator() % records.size()];
+        rtc::GeoPoint fix = offsetPoint(near.coordinate, 120.0 * (unit(generator) - 0.5), 120.0 * (unit(generator) - 0.5));
+        if (fix.latitude > 90.0) fix.latitude = 180.0 - fix.latitude;
+        double accuracy = 80.0 * unit(generator) - 5.0;
+
+        rtc::DuplicateIndex::PlaceID expected = 0, found = 0;
+        bool hasExpected = bruteForceDuplicate(records, policy, fix, accuracy, &expected);
+        XCTAssertEqual(index.findDuplicate(fix, accuracy, &found), hasExpected, @"fix %zu", (size_t)q);
+        if (hasExpected) XCTAssertEqual(found, expected, @"fix %zu", (size_t)q);
+    }
+}
+
+- (void)testInsertMoveRemove
+{
+    rtc::GeoPoint spot(51.5007, -0.1246);
+    rtc::DuplicateIndex index;
+    index.insert(rtc::DuplicateIndex::Record(1, spot, 10.0, 0));
+    index.insert(rtc::DuplicateIndex::Record(2, offsetPoint(spot, 500.0, 0.0), 10.0, 0));
+    XCTAssertEqual(index.size(), 2u);
+
+    // moving a place re-buckets it rather than duplicating it
+    rtc::DuplicateIndex::PlaceID placeID = 0;
+    index.insert(rtc::DuplicateIndex::Record(1, offsetPoint(spot, 1000.0, 0.0), 10.0, 0));
+    XCTAssertEqual(index.size(), 2u);
+    XCTAssertFalse(index.findDuplicate(spot, 10.0, &placeID));
+    XCTAssertTrue(index.findDuplicate(offsetPoint(spot, 1000.0, 0.0), 10.0, &placeID));
+    XCTAssertEqual(placeID, 1u);
+
+    XCTAssertTrue(index.remove(2));
+    XCTAssertFalse(index.remove(2));
+    XCTAssertFalse(index.contains(2));
+    XCTAssertFalse(index.findDuplicate(offsetPoint(spot, 500.0, 0.0), 10.0, &placeID));
+}
+
+
+#pragma mark - Compaction
+- (void)testGroupsKeepNewest
+{
+    rtc::GeoPoint spot(40.7580, -73.9855);
+    std::vector<rtc::DuplicateIndex::Record> records;
+    records.push_back(rtc::DuplicateIndex::Record(1, spot, 10.0, 100.0));
+    records.push_back(rtc::DuplicateIndex::Record(2, offsetPoint(spot, 3.0, 0.0), 10.0, 300.0));
+    records.push_back(rtc::DuplicateIndex::Record(3, offsetPoint(spot, 0.0, 4.0), 10.0, NAN));
+    records.push_back(rtc::DuplicateIndex::Record(4, offsetPoint(spot, 0.0, 400.0), 10.0, 200.0));
+
+    std::vector<rtc::DuplicateGroup> groups = rtc::findDuplicateGroups(records);
+    XCTAssertEqual(groups.size(), 1u);
+    XCTAssertEqual(groups[0].survivor, 2u);
+    std::sort(groups[0].duplicates.begin(), groups[0].duplicates.end());
+    XCTAssertEqual(groups[0].duplicates.size(), 2u);
+    XCTAssertEqual(groups[0].duplicates[0], 1u);
+    XCTAssertEqual(groups[0].duplicates[1], 3u);
+}
+
+- (void)testGroupsDontChain
+{
+    // a row of places 8m apart, newest at the west end: each survivor only
+    //   takes the place next to it
+    rtc::GeoPoint spot(-33.8568, 151.2153);
+    std::vector<rtc::DuplicateIndex::Record> records;
+    for (size_t i = 0; i < 10; ++i) {
+        records.push_back(rtc::DuplicateIndex::Record(i + 1, offsetPoint(spot, 8.0 * i, 0.0), 5.0, 1000.0 - i));
+    }
+    std::vector<rtc::DuplicateGroup> groups = rtc::findDuplicateGroups(records);
+    XCTAssertEqual(groups.size(), 5u);
+    for (size_t g = 0; g < groups.size(); ++g) {
+        XCTAssertEqual(groups[g].survivor, 2 * g + 1);
+        XCTAssertEqual(groups[g].duplicates.size(), 1u);
+        XCTAssertEqual(groups[g].duplicates[0], 2 * g + 2);
+    }
+}
+
+- (void)testGroupsMatchBruteForce
+{
+    std::mt19937 generator(5);
+    rtc::DuplicatePolicy policy;
+    std::vector<rtc::DuplicateIndex::Record> records = randomRecords(generator, 4000, rtc::GeoPoint(48.85, 2.29), 0.01);
+    std::shuffle(records.begin(), records.end(), generator);
+
+    // the same greedy pass, comparing every pair
+    std::vector<size_t> order(records.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&records](size_t a, size_t b) {
+        return records[a].creationDate > records[b].creationDate;
+    });
+    std::vector<bool> grouped(records.size(), false);
+    std::vector<std::pair<rtc::DuplicateIndex::PlaceID, rtc::DuplicateIndex::PlaceID> > expected, found;
+    for (size_t o = 0; o < order.size(); ++o) {
+        size_t survivor = order[o];
+        if (grouped[survivor]) continue;
+        grouped[survivor] = true;
+        for (size_t other = 0; other < records.size(); ++other) {
+            if (grouped[other]) continue;
+            double d = rtc::distanceBetween(records[survivor].coordinate, records[other].coordinate);
+            if (d > policy.radius(records[survivor].horizontalAccuracy, records[other].horizontalAccuracy)) continue;
+            grouped[other] = true;
+            expected.push_back(std::make_pair(records[other].placeID, records[survivor].placeID));
+        }
+    }
+
+    std::vector<rtc::DuplicateGroup> groups = rtc::findDuplicateGroups(records, policy);
+    for (size_t g = 0; g < groups.size(); ++g) {
+        for (size_t i = 0; i < groups[g].duplicates.size(); ++i) {
+            found.push_back(std::make_pair(groups[g].duplicates[i], groups[g].survivor));
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(found.begin(), found.end());
+    XCTAssertGreaterThan(expected.size(), 0u);
+    XCTAssertTrue(found == expected);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Save-path cost (a duplicate check, then indexing the new place) and
+ * whole-store compaction throughput from 10^5 to 10^6 places at constant
+ * density. The save path should stay flat; compaction should grow about
+ * linearly.
+ */
+- (void)testDuplicatePerformance
+{
+    const size_t sizes[] = {100000, 1000000};
+    const size_t numSizes = sizeof(sizes) / sizeof(sizes[0]);
+    std::vector<double> saveVisits(numSizes);
+
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    rtc::GeoPoint corner(37.0, -122.0);
+
+    for (size_t s = 0; s < numSizes; ++s) {
+        double side = std::sqrt(sizes[s] / kBenchmarkPlacesPerSquareDegree);
+        std::vector<rtc::DuplicateIndex::Record> records = randomRecords(generator, sizes[s], corner, side);
+
+        auto buildStart = std::chrono::steady_clock::now();
+        rtc::DuplicateIndex index;
+        index.assign(records);
+        double buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
+
+        std::vector<rtc::DuplicateIndex::Record> saves;
+        for (NSUInteger q = 0; q < kNumBenchmarkSaves; ++q) {
+            rtc::GeoPoint coordinate(corner.latitude + side * unit(generator), corner.longitude + side * unit(generator));
+            saves.push_back(rtc::DuplicateIndex::Record(sizes[s] + q + 1, coordinate, 5.0 + 60.0 * unit(generator), 0));
+        }
+
+        size_t visits = 0, numDuplicates = 0;
+        std::vector<double> latencies;
+        auto saveStart = std::chrono::steady_clock::now();
+        for (size_t q = 0; q < saves.size(); ++q) {
+            auto start = std::chrono::steady_clock::now();
+            rtc::DuplicateIndex::PlaceID placeID;
+            if (index.findDuplicate(saves[q].coordinate, saves[q].horizontalAccuracy, &placeID)) numDuplicates++;
+            else index.insert(saves[q]);
+            visits += index.lastQueryVisits();
+            latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+        double saveTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - saveStart).count();
+        saveVisits[s] = (double)visits / saves.size();
+        std::sort(latencies.begin(), latencies.end());
+
+        auto compactStart = std::chrono::steady_clock::now();
+        std::vector<rtc::DuplicateGroup> groups = rtc::findDuplicateGroups(records);
+        double compactTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - compactStart).count();
+        size_t numMerged = 0;
+        for (size_t g = 0; g < groups.size(); ++g) numMerged += groups[g].duplicates.size();
+
+        NSLog(@"[%@] %zu places: save %.2fus mean, %.2fus p99, %.1f visits, %.0f%% duplicates; "
+              "index built in %.0fms; compaction %.0fms (%.2f M places/s), %zu merged into %zu",
+              NSStringFromSelector(_cmd), sizes[s], saveTime / saves.size(),
+              latencies[latencies.size() * 99 / 100], saveVisits[s], 100.0 * numDuplicates / saves.size(),
+              buildTime * 1e3, compactTime * 1e3, sizes[s] / compactTime / 1e6, numMerged, groups.size());
+
+        // time compaction of the largest store with XCTest so regressions show
+        //   up in the report (through a pointer so the block doesn't copy it)
+        if (s == numSizes - 1) {
+            const std::vector<rtc::DuplicateIndex::Record> *recordsPtr = &records;
+            [self measureBlock:^{
+                rtc::findDuplicateGroups(*recordsPtr);
+            }];
+        }
+    }
+
+    // a scan would grow 10x here
+    XCTAssertLessThan(saveVisits[numSizes - 1], 2.0 * saveVisits[0]);
+}
+
+@end
@@ -0,0 +1,199 @@
+//
+//  RTCGeoKernelTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/17/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include "RTCGeoKernel.h"
+
+// the benchmark sweeps N from 10 points up to this many
+static const size_t kBenchmarkMaxPoints = 10000000;
+
+// points actually held in memory. Bigger sweeps go over them repeatedly, which
+// keeps the run inside a phone's memory; past a few hundred thousand points the
+// arrays are out of cache either way.
+static const size_t kBenchmarkHeldPoints = 1000000;
+
+// meters per degree of latitude, near enough for building test points
+static const double kMetersPerDegree = rtc::kEarthRadius * rtc::kDegreesToRadians;
+
+@interface RTCGeoKernelTests : XCTestCase
+
+@end
+
+@implementation RTCGeoKernelTests
+
+#pragma mark - Helpers
+/**
+ * Points scattered over the whole globe, and a few within a few kilometers of
+ * origin, the way saved places cluster around home
+ */
+static std::vector<rtc::GeoPoint> randomPoints(std::mt19937 &generator, const rtc::GeoPoint &origin, size_t count)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<rtc::GeoPoint> points;
+    points.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (i % 4 == 0) {
+            double latitude = std::asin(2.0 * unit(generator) - 1.0) * rtc::kRadiansToDegrees;
+            points.push_back(rtc::GeoPoint(latitude, 360.0 * unit(generator) - 180.0));
+        } else {
+            double north = 5000.0 * (unit(generator) - 0.5), east = 5000.0 * (unit(generator) - 0.5);
+            double metersPerDegreeLongitude = kMetersPerDegree * std::cos(origin.latitude * rtc::kDegreesToRadians);
+            points.push_back(rtc::GeoPoint(origin.latitude + north / kMetersPerDegree,
+                                           origin.longitude + east / metersPerDegreeLongitude));
+        }
+    }
+    return points;
+}
+
+// difference between two bearings, allowing for the wrap at 360
+static double bearingDifference(double a, double b)
+{
+    double difference = std::fabs(a - b);
+    return std::min(difference, 360.0 - difference);
+}
+
+static double pointsPerSecond(size_t numPoints, std::chrono::steady_clock::duration elapsed)
+{
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return (seconds > 0) ? numPoints / seconds : 0.0;
+}
+
+
+#pragma mark - Accuracy
+- (void)testReferenceValues
+{
+    // one degree along the equator, across the antimeridian, up a meridian,
+    // to a pole and halfway round the world
+    rtc::GeoPoint origins[] = {
+        rtc::GeoPoint(0, 0), rtc::GeoPoint(0, 179.5), rtc::GeoPoint(0, 0),
+        rtc::GeoPoint(45, 10), rtc::GeoPoint(0, 0), rtc::GeoPoint(37.3259, -121.9455)
+    };
+    rtc::GeoPoint targets[] = {
+        rtc::GeoPoint(0, 1), rtc::GeoPoint(0, -179.5), rtc::GeoPoint(-1, 0),
+        rtc::GeoPoint(90, 0), rtc::GeoPoint(0, 180), rtc::GeoPoint(37.3259, -121.9455)
+    };
+    double oneDegree = M_PI / 180.0 * rtc::kEarthRadius;
+    double distances[] = {oneDegree, oneDegree, oneDegree, 45.0 * oneDegree, 180.0 * oneDegree, 0.0};
+    double bearings[] = {90.0, 90.0, 180.0, 0.0, -1.0, 0.0};     // halfway round has no bearing
+
+    for (size_t i = 0; i < sizeof(distances) / sizeof(distances[0]); ++i) {
+        // pad with copies so every target goes through the vector lanes and the scalar tail
+        rtc::GeoPointArray points;
+        for (size_t j = 0; j < 7; ++j) points.push_back(targets[i]);
+
+        std::vector<double> kernelDistances(points.size()), kernelBearings(points.size());
+        rtc::distancesFrom(origins[i], points, kernelDistances.data(), kernelBearings.data());
+        for (size_t j = 0; j < points.size(); ++j) {
+            XCTAssertEqualWithAccuracy(kernelDistances[j], distances[i], 1e-6);
+            if (bearings[i] >= 0) XCTAssertLessThan(bearingDifference(kernelBearings[j], bearings[i]), 1e-9);
+        }
+    }
+}
+
+- (void)testMatchesScalarFormulas
+{
+    std::mt19937 generator(2014);
+    rtc::GeoPoint origin(37.3259, -121.9455);
+    std::vector<rtc::GeoPoint> points = randomPoints(generator, origin, 10001);
+
+    rtc::GeoPointArray array;
+    array.assign(points);
+    std::vector<double> distances(points.size()), bearings(points.size());
+    rtc::distancesFrom(origin, array, distances.data(), bearings.data());
+
+    double maxDistanceError = 0, maxBearingError = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        maxDistanceError = std::max(maxDistanceError, std::fabs(distances[i] - rtc::distanceBetween(origin, points[i])));
+        maxBearingError = std::max(maxBearingError, bearingDifference(bearings[i], rtc::initialBearing(origin, points[i])));
+        XCTAssertGreaterThanOrEqual(bearings[i], 0.0);
+        XCTAssertLessThan(bearings[i], 360.0);
+    }
+    NSLog(@"[%@] %s kernel: max distance error %.2g m, max bearing error %.2g degrees",
+          NSStringFromSelector(_cmd), rtc::geoKernelInstructionSet(), maxDistanceError, maxBearingError);
+
+    XCTAssertLessThan(maxDistanceError, 1e-3);
+    XCTAssertLessThan(maxBearingError, 1e-6);
+}
+
+- (void)testOrderByDistance
+{
+    std::mt19937 generator(7);
+    rtc::GeoPoint origin(-33.8688, 151.2093);
+    std::vector<rtc::GeoPoint> points = randomPoints(generator, origin, 999);
+
+    rtc::GeoPointArray array;
+    array.assign(points);
+    std::vector<double> distances, bearings;
+    std::vector<size_t> order = rtc::orderByDistance(origin, array, &distances, &bearings);
+
+    XCTAssertEqual(order.size(), points.size());
+    XCTAssertEqual(distances.size(), points.size());
+    XCTAssertEqual(bearings.size(), points.size());
+    for (size_t i = 1; i < order.size(); ++i) {
+        XCTAssertLessThanOrEqual(distances[order[i - 1]], distances[order[i]]);
+    }
+
+    // every point exactly once
+    std::vector<size_t> sorted(order);
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < sorted.size(); ++i) XCTAssertEqual(sorted[i], i);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Distance and bearing to N points, N = 10 ... 10^7, through the batch kernel
+ * and through distanceBetween()/initialBearing() one point at a time (what a
+ * -[CLLocation distanceFromLocation:] per place amounts to, minus the message
+ * sends). Logs millions of points per second for both.
+ */
+- (void)testDistanceThroughputPerformance
+{
+    std::mt19937 generator(2014);
+    rtc::GeoPoint origin(37.3259, -121.9455);
+    std::vector<rtc::GeoPoint> points = randomPoints(generator, origin, kBenchmarkHeldPoints);
+
+    rtc::GeoPointArray array;
+    array.assign(points);
+    std::vector<double> distances(points.size()), bearings(points.size());
+
+    for (size_t n = 10; n <= kBenchmarkMaxPoints; n *= 10) {
+        size_t held = std::min(n, kBenchmarkHeldPoints);
+        size_t repeats = std::max((size_t)1, kBenchmarkMaxPoints / 10 / n) * (n / held);
+
+        rtc::GeoPointArray batch;
+        batch.assign(std::vector<rtc::GeoPoint>(points.begin(), points.begin() + held));
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < repeats; ++r) rtc::distancesFrom(origin, batch, distances.data(), bearings.data());
+        double kernelRate = pointsPerSecond(repeats * held, std::chrono::steady_clock::now() - start);
+
+        start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < repeats; ++r) {
+            for (size_t i = 0; i < held; ++i) {
+                distances[i] = rtc::distanceBetween(origin, points[i]);
+                bearings[i] = rtc::initialBearing(origin, points[i]);
+            }
+        }
+        double scalarRate = pointsPerSecond(repeats * held, std::chrono::steady_clock::now() - start);
+
+        NSLog(@"[%@] N=%zu: %s kernel %.1fM points/s, one at a time %.1fM points/s (%.1fx)",
+              NSStringFromSelector(_cmd), n, rtc::geoKernelInstructionSet(), kernelRate / 1e6,
+              scalarRate / 1e6, (scalarRate > 0) ? kernelRate / scalarRate : 0.0);
+    }
+
+    [self measureBlock:^{
+        rtc::distancesFrom(origin, array, distances.data(), bearings.data());
+    }];
+}
+
+@end
@@ -0,0 +1,289 @@
+//
+//  RTCGeocodeCacheTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/16/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include "RTCGeocodeReplay.h"
+
+// size of the synthetic request trace in the benchmark
+static const NSUInteger kNumBenchmarkPlaces = 150;
+static const NSUInteger kNumBenchmarkMissingPlacemarks = 100;
+static const NSUInteger kNumBenchmarkSessions = 400;
+
+// seconds CLGeocoder typically takes to answer on a phone
+static const double kProviderLatency = 0.5;
+
+// meters per degree of latitude, near enough for building test locations
+static const double kMetersPerDegree = rtc::kEarthRadius * rtc::kDegreesToRadians;
+
+@interface RTCGeocodeCacheTests : XCTestCase
+
+@end
+
+@implementation RTCGeocodeCacheTests
+
+#pragma mark - Helpers
+/**
+ * Point offset (meters north, meters east) from an origin
+ */
+static rtc::GeoPoint offsetPoint(const rtc::GeoPoint &origin, double north, double east)
+{
+    double metersPerDegreeLongitude = kMetersPerDegree * std::cos(origin.latitude * rtc::kDegreesToRadians);
+    return rtc::GeoPoint(origin.latitude + north / kMetersPerDegree,
+                         origin.longitude + east / metersPerDegreeLongitude);
+}
+
+/**
+ * Placemark requests over a few weeks. At launch the places saved without a
+ * network are queued for their placemarks in the background. Then, every few
+ * hours, the user checks where they are from one of a handful of usual spots,
+ * opens a saved place (some much more often than others), sometimes opens
+ * directions to it, and sometimes flicks through several places in a row.
+ */
+static rtc::GeocodeRequestTrace syntheticRequests(std::mt19937 &generator, size_t numPlaces,
+                                                  size_t numMissingPlacemarks, size_t numSessions)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    rtc::GeoPoint home(37.3259, -121.9455);
+
+    std::vector<rtc::GeoPoint> places, spots;
+    for (size_t i = 0; i < numPlaces; ++i) {
+        places.push_back(offsetPoint(home, 3000.0 * (unit(generator) - 0.5), 3000.0 * (unit(generator) - 0.5)));
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        spots.push_back(offsetPoint(home, 1000.0 * (unit(generator) - 0.5), 1000.0 * (unit(generator) - 0.5)));
+    }
+
+    rtc::GeocodeRequestTrace trace;
+    for (size_t i = 0; i < numMissingPlacemarks; ++i) {
+        trace.push_back(rtc::GeocodeRequest(0.0, places[i], rtc::GeocodeCache::PriorityBackground));
+    }
+
+    double t = 1.0;
+    for (size_t s = 0; s < numSessions; ++s) {
+        rtc::GeoPoint here = offsetPoint(spots[(size_t)(unit(generator) * spots.size())],
+                                         6.0 * (unit(generator) - 0.5), 6.0 * (unit(generator) - 0.5));
+        trace.push_back(rtc::GeocodeRequest(t, here));
+
+        size_t numViewed = (unit(generator) < 0.2) ? 8 : 1;
+        for (size_t v = 0; v < numViewed; ++v) {
+            t += 2.0 + 3.0 * unit(generator);
+            const rtc::GeoPoint &place = places[(size_t)(unit(generator) * unit(generator) * numPlaces)];
+            trace.push_back(rtc::GeocodeRequest(t, place));
+            if (unit(generator) < 0.3) trace.push_back(rtc::GeocodeRequest(t + 1.0, place));
+        }
+        t += 3600.0 * (1.0 + 3.0 * unit(generator));
+    }
+    return trace;
+}
+
+
+#pragma mark - Lookup
+- (void)testHitWithinCell
+{
+    rtc::ManualClock clock(0.0);
+    rtc::GeocodeCache cache(clock);
+
+    rtc::GeoPoint point(37.3259, -121.9455);
+    std::string placemark;
+    XCTAssertFalse(cache.lookup(point, &placemark));
+    cache.store(point, "1 Infinite Loop");
+
+    // a few meters away is the same cell more often than not; this one is
+    XCTAssertTrue(cache.lookup(offsetPoint(point, 0.5, 0.5), &placemark));
+    XCTAssertEqual(placemark, std::string("1 Infinite Loop"));
+    XCTAssertFalse(cache.lookup(offsetPoint(point, 100.0, 0), &placemark));
+
+    // old placemarks are looked up again
+    clock.advance(cache.policy().maxAge + 1.0);
+    XCTAssertFalse(cache.lookup(point, &placemark));
+    XCTAssertEqual(cache.size(), (size_t)0);
+}
+
+- (void)testLeastRecentlyUsedEvicted
+{
+    rtc::ManualClock clock(0.0);
+    rtc::GeocodePolicy policy;
+    policy.maxEntries = 2;
+    rtc::GeocodeCache cache(clock, policy);
+
+    rtc::GeoPoint origin(37.3259, -121.9455);
+    rtc::GeoPoint points[] = {offsetPoint(origin, 500, 0), offsetPoint(origin, 0, 500), offsetPoint(origin, -500, 0)};
+    cache.store(points[0], "a");
+    cache.store(points[1], "b");
+
+    // touch the first so the second is the oldest
+    XCTAssertTrue(cache.lookup(points[0], 0));
+    cache.store(points[2], "c");
+
+    XCTAssertEqual(cache.size(), (size_t)2);
+    XCTAssertTrue(cache.lookup(points[0], 0));
+    XCTAssertFalse(cache.lookup(points[1], 0));
+    XCTAssertTrue(cache.lookup(points[2], 0));
+}
+
+
+#pragma mark - Requests
+- (void)testDuplicateRequestsCoalesce
+{
+    rtc::ManualClock clock(0.0);
+    rtc::GeocodeCache cache(clock);
+
+    rtc::GeoPoint point(37.3259, -121.9455);
+    std::string placemark;
+    XCTAssertEqual(cache.request(point, 1, rtc::GeocodeCache::PriorityUser, &placemark), rtc::GeocodeCache::RequestQueued);
+    XCTAssertEqual(cache.request(point, 2, rtc::GeocodeCache::PriorityBackground, &placemark), rtc::GeocodeCache::RequestJoined);
+    XCTAssertEqual(cache.numPending(), (size_t)1);
+
+    rtc::GeoPoint lookupPoint;
+    XCTAssertEqual(cache.nextLookupTime(), clock.now());
+    XCTAssertTrue(cache.startLookup(&lookupPoint));
+    XCTAssertEqual(lookupPoint.latitude, point.latitude);
+    XCTAssertTrue(cache.lookupInFlight());
+
+    // joining a lookup in flight doesn't start another
+    XCTAssertEqual(cache.request(point, 3, rtc::GeocodeCache::PriorityUser, &placemark), rtc::GeocodeCache::RequestJoined);
+    XCTAssertFalse(cache.startLookup(&lookupPoint));
+
+    clock.advance(0.5);
+    std::vector<rtc::GeocodeCache::RequestID> answered = cache.finishLookup(true, "1 Infinite Loop");
+    XCTAssertEqual(answered.size(), (size_t)3);
+    XCTAssertEqual(answered[0], (rtc::GeocodeCache::RequestID)1);
+    XCTAssertEqual(answered[2], (rtc::GeocodeCache::RequestID)3);
+    XCTAssertEqual(cache.numPending(), (size_t)0);
+
+    XCTAssertEqual(cache.request(point, 4, rtc::GeocodeCache::PriorityUser, &placemark), rtc::GeocodeCache::RequestCached);
+    XCTAssertEqual(placemark, std::string("1 Infinite Loop"));
+
+    const rtc::GeocodeCache::Stats &stats = cache.stats();
+    XCTAssertEqual(stats.numRequests, 4u);
+    XCTAssertEqual(stats.numHits, 1u);
+    XCTAssertEqual(stats.numJoined, 2u);
+    XCTAssertEqual(stats.numLookups, 1u);
+    XCTAssertEqual(stats.numUserAnswered, 3u);
+    XCTAssertEqualWithAccuracy(stats.meanUserLatency(), 1.0 / 3.0, 1e-9);
+    XCTAssertEqualWithAccuracy(stats.hitRate(), 0.25, 1e-9);
+}
+
+- (void)testUserRequestsJumpQueue
+{
+    rtc::ManualClock clock(0.0);
+    rtc::GeocodeCache cache(clock);
+
+    rtc::GeoPoint origin(37.3259, -121.9455);
+    rtc::GeoPoint first = offsetPoint(origin, 100, 0), second = offsetPoint(origin, 200, 0);
+    rtc::GeoPoint urgent = offsetPoint(origin, 300, 0);
+    cache.request(first, 1, rtc::GeocodeCache::PriorityBackground, 0);
+    cache.request(second, 2, rtc::GeocodeCache::PriorityBackground, 0);
+    cache.request(urgent, 3, rtc::GeocodeCache::PriorityUser, 0);
+
+    rtc::GeoPoint point;
+    XCTAssertTrue(cache.startLookup(&point));
+    XCTAssertEqual(point.latitude, urgent.latitude);
+    cache.finishLookup(true, "urgent");
+
+    // lookups are paced
+    XCTAssertFalse(cache.startLookup(&point));
+    XCTAssertEqual(cache.nextLookupTime(), cache.policy().minLookupInterval);
+
+    // a user waiting on a background cell moves it up
+    cache.request(second, 4, rtc::GeocodeCache::PriorityUser, 0);
+    clock.advance(cache.policy().minLookupInterval);
+    XCTAssertTrue(cache.startLookup(&point));
+    XCTAssertEqual(point.latitude, second.latitude);
+
+    // failures back off
+    std::vector<rtc::GeocodeCache::RequestID> answered = cache.finishLookup(false, "");
+    XCTAssertEqual(answered.size(), (size_t)2);
+    XCTAssertEqual(cache.stats().numFailures, 1u);
+    XCTAssertEqual(cache.nextLookupTime(), clock.now() + cache.policy().failureBackoff);
+    XCTAssertFalse(cache.lookup(second, 0));
+
+    clock.advance(cache.policy().failureBackoff);
+    XCTAssertTrue(cache.startLookup(&point));
+    XCTAssertEqual(point.latitude, first.latitude);
+    cache.finishLookup(true, "first");
+    XCTAssertEqual(cache.nextLookupTime(), HUGE_VAL);
+}
+
+
+#pragma mark - Storage
+- (void)testCacheFileRoundTrip
+{
+    rtc::ManualClock clock(1000.0);
+    rtc::GeocodeCache cache(clock);
+
+    rtc::GeoPoint point(-33.8688, 151.2093);
+    std::string archived("bplist00\0\x01\x02 binary", 18);
+    cache.store(point, archived);
+    cache.store(offsetPoint(point, 100, 100), "next door");
+
+    std::stringstream file;
+    cache.write(file);
+    std::string bytes = file.str();
+
+    rtc::GeocodeCache loaded(clock);
+    XCTAssertTrue(loaded.read(file));
+    XCTAssertEqual(loaded.size(), (size_t)2);
+
+    std::string placemark;
+    XCTAssertTrue(loaded.lookup(point, &placemark));
+    XCTAssertEqual(placemark, archived);
+
+    // cells of another size are different cells
+    rtc::GeocodePolicy policy;
+    policy.cellSize *= 2;
+    rtc::GeocodeCache resized(clock, policy);
+    std::istringstream resizedFile(bytes);
+    XCTAssertFalse(resized.read(resizedFile));
+
+    std::istringstream garbage("not a geocode cache");
+    XCTAssertFalse(loaded.read(garbage));
+    XCTAssertEqual(loaded.size(), (size_t)2);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Replay a few weeks of synthetic placemark requests with every screen
+ * geocoding on its own and through the shared cache, and log hit rate,
+ * throttled requests and how long screens wait for an address.
+ */
+- (void)testReplaySyntheticRequestsPerformance
+{
+    std::mt19937 generator(2014);
+    rtc::GeocodeRequestTrace trace = syntheticRequests(generator, kNumBenchmarkPlaces,
+                                                       kNumBenchmarkMissingPlacemarks, kNumBenchmarkSessions);
+
+    rtc::FakeGeocodeProvider directProvider;
+    rtc::GeocodeReplaySummary direct = rtc::replayDirectGeocodeRequests(trace, directProvider, kProviderLatency);
+
+    rtc::FakeGeocodeProvider cachedProvider;
+    rtc::GeocodeReplaySummary cached = rtc::replayGeocodeRequests(trace, cachedProvider, kProviderLatency);
+
+    NSLog(@"[%@] %u requests: direct %u provider calls, %u failed, mean latency %.2fs; "
+          "cache %u hits (%.1f%%), %u coalesced, %u provider calls, %u failed, mean latency %.2fs, p90 %.2fs",
+          NSStringFromSelector(_cmd), cached.numRequests, direct.numProviderCalls, direct.numFailures,
+          direct.meanLatency, cached.numHits, 100.0 * cached.hitRate(), cached.numJoined,
+          cached.numProviderCalls, cached.numFailures, cached.meanLatency, cached.p90Latency);
+
+    [self measureBlock:^{
+        rtc::FakeGeocodeProvider provider;
+        rtc::replayGeocodeRequests(trace, provider, kProviderLatency);
+    }];
+
+    XCTAssertGreaterThan(direct.numFailures, 0u);
+    XCTAssertEqual(cached.numFailures, 0u);
+    XCTAssertGreaterThan(cached.hitRate(), 0.6);
+    XCTAssertLessThan(cached.numProviderCalls, direct.numProviderCalls / 2);
+    XCTAssertLessThan(cached.meanLatency, direct.meanLatency);
+}
+
+@end
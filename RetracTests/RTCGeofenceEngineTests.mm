@@ -0,0 +1,408 @@
+//
+//  RTCGeofenceEngineTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/23/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include "RTCGeofenceEngine.h"
+#include "RTCGeofenceReplay.h"
+
+// number of simulated walks replayed in the benchmark
+static const NSUInteger kNumSimulatedWalks = 40;
+
+// saved places the simulated walks wander between
+static const NSUInteger kNumSimulatedPlaces = 400;
+
+// meters on a side of the square the simulated places are spread over
+static const double kSimulatedAreaSize = 10000.0;
+
+// farthest (meters) a simulated walk heads for in one go
+static const double kSimulatedLegLength = 2000.0;
+
+@interface RTCGeofenceEngineTests : XCTestCase
+
+@end
+
+@implementation RTCGeofenceEngineTests
+
+#pragma mark - Helpers
+static const rtc::GeoPoint kOrigin(37.3300, -121.8900);
+
+/**
+ * The point east and north meters from origin
+ */
+static rtc::GeoPoint offsetPoint(const rtc::GeoPoint &origin, double east, double north)
+{
+    double metersPerDegree = rtc::kEarthRadius * rtc::kDegreesToRadians;
+    return rtc::GeoPoint(origin.latitude + north / metersPerDegree,
+                         origin.longitude + east / (metersPerDegree * std::cos(origin.latitude * rtc::kDegreesToRadians)));
+}
+
+static rtc::LocationFix fixAt(double t, const rtc::GeoPoint &point, double accuracy)
+{
+    return rtc::LocationFix(t, point.latitude, point.longitude, accuracy);
+}
+
+/**
+ * Feed a fix a second for seconds, standing at point
+ */
+static void standAt(rtc::GeofenceEngine &engine, rtc::ManualClock &clock, const rtc::GeoPoint &point,
+                    double accuracy, double seconds, std::vector<rtc::GeofenceEngine::Event> &events)
+{
+    for (double t = 0; t < seconds; t += 1.0) {
+        clock.advance(1.0);
+        engine.processFix(fixAt(clock.now(), point, accuracy), events);
+    }
+}
+
+static std::vector<rtc::GeofenceEngine::Place> randomPlaces(std::mt19937 &generator, size_t numPlaces)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<rtc::GeofenceEngine::Place> places;
+    for (size_t i = 0; i < numPlaces; ++i) {
+        rtc::GeoPoint coordinate = offsetPoint(kOrigin, kSimulatedAreaSize * unit(generator),
+                                               kSimulatedAreaSize * unit(generator));
+        // some places the user means to be back at within half an hour
+        double timeout = (i % 3 == 0) ? 1800.0 : 0.0;
+        places.push_back(rtc::GeofenceEngine::Place(i + 1, coordinate, timeout));
+    }
+    return places;
+}
+
+/**
+ * A few hours of walking between saved places and random spots, a fix a
+ * second. Visits stand still near the place for a while. GPS error drifts
+ * slowly; now and then a fix jumps far off with an honest accuracy, and
+ * rarely a multipath fix jumps off while claiming to be accurate.
+ */
+static rtc::GeofenceTrace simulatedWalk(std::mt19937 &generator, const rtc::SpatialIndex &index)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    rtc::GeofenceTrace trace;
+
+    double t = 1.4e9;
+    double east = kSimulatedAreaSize * unit(generator), north = kSimulatedAreaSize * unit(generator);
+    double errorEast = 0, errorNorth = 0, accuracy = 10.0;
+
+    for (int leg = 0; leg < 6; ++leg) {
+        // head for a place or just somewhere not too far off
+        double targetEast = std::min(std::max(east + kSimulatedLegLength * (2.0 * unit(generator) - 1.0), 0.0), kSimulatedAreaSize);
+        double targetNorth = std::min(std::max(north + kSimulatedLegLength * (2.0 * unit(generator) - 1.0), 0.0), kSimulatedAreaSize);
+        double dwell = 0;
+        if (unit(generator) < 0.6) {
+            std::vector<rtc::SpatialIndex::Neighbor> nearest = index.nearest(offsetPoint(kOrigin, targetEast, targetNorth), 1);
+            rtc::GeoPoint coordinate;
+            index.coordinateOf(nearest[0].placeID, &coordinate);
+            rtc::localOffset(kOrigin, coordinate, &targetEast, &targetNorth);
+            targetEast += 10.0 * normal(generator);
+            targetNorth += 10.0 * normal(generator);
+            dwell = 300.0 + 900.0 * unit(generator);
+        }
+
+        double speed = 1.2 + 0.4 * unit(generator);
+        double legLength = std::hypot(targetEast - east, targetNorth - north);
+        double stepEast = (targetEast - east) * speed / std::max(legLength, 1.0);
+        double stepNorth = (targetNorth - north) * speed / std::max(legLength, 1.0);
+        int numSteps = (int)(legLength / speed) + (int)dwell;
+
+        for (int step = 0; step < numSteps; ++step) {
+            if (step < (int)(legLength / speed)) {
+                east += stepEast;
+                north += stepNorth;
+            }
+
+            accuracy = std::min(std::max(accuracy + normal(generator), 5.0), 30.0);
+            errorEast = 0.95 * errorEast + 0.2 * accuracy * normal(generator);
+            errorNorth = 0.95 * errorNorth + 0.2 * accuracy * normal(generator);
+
+            double fixEast = east + errorEast, fixNorth = north + errorNorth, reported = accuracy;
+            double glitch = unit(generator);
+            if (glitch < 0.02) {
+                double angle = 2.0 * M_PI * unit(generator), jump = 150.0 + 250.0 * unit(generator);
+                fixEast += jump * std::cos(angle);
+                fixNorth += jump * std::sin(angle);
+                reported = jump * (0.8 + 0.8 * unit(generator));
+            } else if (glitch < 0.025) {
+                double angle = 2.0 * M_PI * unit(generator), jump = 60.0 + 60.0 * unit(generator);
+                fixEast += jump * std::cos(angle);
+                fixNorth += jump * std::sin(angle);
+            }
+
+            rtc::GeoPoint truth = offsetPoint(kOrigin, east, north);
+            trace.push_back(rtc::GeofenceSample(truth, fixAt(t, offsetPoint(kOrigin, fixEast, fixNorth), reported)));
+            t += 1.0;
+        }
+    }
+    return trace;
+}
+
+static size_t countEvents(const std::vector<rtc::GeofenceEngine::Event> &events, rtc::GeofenceEngine::Event::Type type)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < events.size(); ++i) count += (events[i].type == type);
+    return count;
+}
+
+
+#pragma mark - Events
+- (void)testArrivalAndDepartureWaitOutDwellTime
+{
+    rtc::ManualClock clock(1000.0);
+    rtc::GeofenceEngine engine(clock);
+    std::vector<rtc::GeofenceEngine::Place> places(1, rtc::GeofenceEngine::Place(1, kOrigin));
+    engine.assignPlaces(places);
+
+    std::vector<rtc::GeofenceEngine::Event> events;
+    standAt(engine, clock, offsetPoint(kOrigin, 400.0, 0.0), 20.0, 5.0, events);
+    XCTAssertEqual(engine.placeState(1), rtc::GeofenceEngine::PlaceStateOutside);
+    XCTAssertTrue(events.empty(), @"first sighting isn't an event");
+
+    // inside, but not by more than the fix's accuracy
+    double arrived = clock.now() + 1.0;
+    standAt(engine, clock, offsetPoint(kOrigin, 80.0, 0.0), 40.0, 10.0, events);
+    XCTAssertTrue(events.empty());
+    XCTAssertTrue(engine.awaitingConfirmation());
+    standAt(engine, clock, offsetPoint(kOrigin, 80.0, 0.0), 40.0, 25.0, events);
+    XCTAssertEqual(events.size(), (size_t)1);
+    XCTAssertEqual(events[0].type, rtc::GeofenceEngine::Event::TypeArrival);
+    XCTAssertEqual(events[0].time, arrived + engine.policy().dwellTime);
+    XCTAssertFalse(engine.awaitingConfirmation());
+
+    // an inside place is watched out to the hysteresis band
+    XCTAssertEqual(engine.regions()[0].radius, engine.policy().radius + engine.policy().exitHysteresis);
+
+    events.clear();
+    standAt(engine, clock, offsetPoint(kOrigin, 160.0, 0.0), 30.0, 40.0, events);
+    XCTAssertEqual(events.size(), (size_t)1);
+    XCTAssertEqual(events[0].type, rtc::GeofenceEngine::Event::TypeDeparture);
+    XCTAssertEqual(engine.regions()[0].radius, engine.policy().radius);
+}
+
+- (void)testCertainFixSkipsDwellTime
+{
+    rtc::ManualClock clock(0.0);
+    rtc::GeofenceEngine engine(clock);
+    engine.assignPlaces(std::vector<rtc::GeofenceEngine::Place>(1, rtc::GeofenceEngine::Place(1, kOrigin)));
+
+    std::vector<rtc::GeofenceEngine::Event> events;
+    standAt(engine, clock, offsetPoint(kOrigin, 0.0, 500.0), 10.0, 1.0, events);
+    standAt(engine, clock, offsetPoint(kOrigin, 0.0, 20.0), 10.0, 1.0, events);
+    XCTAssertTrue(events.empty(), @"one fix isn't enough");
+    standAt(engine, clock, offsetPoint(kOrigin, 0.0, 20.0), 10.0, 1.0, events);
+    XCTAssertEqual(countEvents(events, rtc::GeofenceEngine::Event::TypeArrival), (size_t)1);
+
+    // a wild fix on its own doesn't undo it
+    standAt(engine, clock, offsetPoint(kOrigin, 0.0, 500.0), 10.0, 1.0, events);
+    standAt(engine, clock, offsetPoint(kOrigin, 0.0, 20.0), 10.0, 1.0, events);
+    XCTAssertEqual(countEvents(events, rtc::GeofenceEngine::Event::TypeDeparture), (size_t)0);
+    standAt(engine, clock, offsetPoint(kOrigin, 0.0, 500.0), 100.0, 2.0, events);
+    XCTAssertEqual(countEvents(events, rtc::GeofenceEngine::Event::TypeDeparture), (size_t)1);
+}
+
+- (void)testJitterAtTheEdgeIsIgnored
+{
+    rtc::ManualClock clock(0.0);
+    rtc::GeofenceEngine engine(clock);
+    engine.assignPlaces(std::vector<rtc::GeofenceEngine::Place>(1, rtc::GeofenceEngine::Place(1, kOrigin)));
+
+    // standing just outside the place for an hour, fixes either side of its edge
+    std::mt19937 generator(5);
+    std::normal_distribution<double> normal(0.0, 15.0);
+    std::vector<rtc::GeofenceEngine::Event> events;
+    standAt(engine, clock, offsetPoint(kOrigin, 300.0, 0.0), 10.0, 1.0, events);
+    for (int i = 0; i < 3600; ++i) {
+        clock.advance(1.0);
+        engine.processFix(fixAt(clock.now(), offsetPoint(kOrigin, 110.0 + normal(generator), 0.0), 20.0), events);
+    }
+    XCTAssertTrue(events.empty(), @"%zu events", events.size());
+
+    // coarse fixes say nothing either way
+    standAt(engine, clock, kOrigin, 500.0, 120.0, events);
+    XCTAssertTrue(events.empty());
+
+    // stale and invalid fixes are ignored
+    XCTAssertFalse(engine.processFix(fixAt(clock.now() - 10.0, kOrigin, 5.0), events));
+    XCTAssertFalse(engine.processFix(fixAt(clock.now(), kOrigin, -1.0), events));
+    XCTAssertTrue(events.empty());
+}
+
+- (void)testOverdueAfterTimeout
+{
+    rtc::ManualClock clock(0.0);
+    rtc::GeofenceEngine engine(clock);
+    std::vector<rtc::GeofenceEngine::Place> places;
+    places.push_back(rtc::GeofenceEngine::Place(1, kOrigin, 600.0));
+    places.push_back(rtc::GeofenceEngine::Place(2, offsetPoint(kOrigin, 0.0, 2000.0)));
+    engine.assignPlaces(places);
+    XCTAssertTrue(std::isinf(engine.deadline()));
+
+    // arriving isn't an event when it's the first thing we see
+    std::vector<rtc::GeofenceEngine::Event> events;
+    standAt(engine, clock, kOrigin, 5.0, 2.0, events);
+    XCTAssertTrue(events.empty());
+
+    standAt(engine, clock, offsetPoint(kOrigin, 0.0, 1000.0), 5.0, 2.0, events);
+    double departed = clock.now();
+    XCTAssertEqual(countEvents(events, rtc::GeofenceEngine::Event::TypeDeparture), (size_t)1);
+    XCTAssertEqual(engine.deadline(), departed + 600.0);
+
+    // place 2 has no timeout
+    standAt(engine, clock, offsetPoint(kOrigin, 0.0, 2000.0), 5.0, 2.0, events);
+    standAt(engine, clock, offsetPoint(kOrigin, 0.0, 1000.0), 5.0, 2.0, events);
+    XCTAssertEqual(engine.deadline(), departed + 600.0);
+
+    clock.setNow(departed + 599.0);
+    engine.handleTimeout(events);
+    XCTAssertEqual(countEvents(events, rtc::GeofenceEngine::Event::TypeOverdue), (size_t)0);
+    XCTAssertEqual(engine.timeoutDelay(), 1.0);
+
+    clock.setNow(departed + 700.0);
+    engine.handleTimeout(events);
+    XCTAssertEqual(countEvents(events, rtc::GeofenceEngine::Event::TypeOverdue), (size_t)1);
+    XCTAssertEqual(events.back().placeID, (rtc::GeofenceEngine::PlaceID)1);
+    XCTAssertEqual(events.back().time, departed + 600.0);
+    XCTAssertTrue(std::isinf(engine.deadline()));
+
+    // coming back in time stops the clock
+    standAt(engine, clock, kOrigin, 5.0, 2.0, events);
+    standAt(engine, clock, offsetPoint(kOrigin, 0.0, 1000.0), 5.0, 2.0, events);
+    standAt(engine, clock, kOrigin, 5.0, 2.0, events);
+    XCTAssertTrue(std::isinf(engine.deadline()));
+}
+
+
+#pragma mark - Regions
+- (void)testMonitorsNearestPlacesWithinRegionLimit
+{
+    std::mt19937 generator(2014);
+    std::vector<rtc::GeofenceEngine::Place> places = randomPlaces(generator, 1000);
+    rtc::ManualClock clock(0.0);
+    rtc::GeofenceEngine engine(clock);
+    XCTAssertFalse(engine.assignPlaces(places), @"nowhere to monitor around yet");
+
+    rtc::GeoPoint here = offsetPoint(kOrigin, 2000.0, 2000.0);
+    std::vector<rtc::GeofenceEngine::Event> events;
+    XCTAssertTrue(engine.processFix(fixAt(0.0, here, 10.0), events));
+    XCTAssertEqual(engine.numRecomputations(), 1u);
+
+    std::vector<rtc::GeofenceEngine::Region> regions = engine.regions();
+    XCTAssertEqual(regions.size() + 1, (size_t)engine.policy().maxRegions);
+
+    // the monitored places are the nearest ones...
+    std::vector<double> distances;
+    for (size_t i = 0; i < places.size(); ++i) distances.push_back(rtc::distanceBetween(here, places[i].coordinate));
+    std::sort(distances.begin(), distances.end());
+    for (size_t i = 0; i < regions.size(); ++i) {
+        XCTAssertEqualWithAccuracy(rtc::distanceBetween(here, regions[i].center), distances[i], 1e-6);
+    }
+
+    // ...and the refresh region stops short of the next one
+    const rtc::GeofenceEngine::Region &refresh = engine.refreshRegion();
+    XCTAssertEqual(refresh.placeID, (rtc::GeofenceEngine::PlaceID)0);
+    XCTAssertLessThanOrEqual(refresh.radius, std::max(distances[regions.size()] - engine.policy().radius - engine.policy().exitHysteresis,
+                                                      engine.policy().minRefreshRadius));
+
+    // moving about inside it changes nothing; leaving it recomputes
+    engine.processFix(fixAt(1.0, offsetPoint(here, 0.5 * refresh.radius, 0.0), 10.0), events);
+    XCTAssertEqual(engine.numRecomputations(), 1u);
+    XCTAssertTrue(engine.processFix(fixAt(2.0, offsetPoint(here, 1.5 * refresh.radius, 0.0), 10.0), events));
+    XCTAssertEqual(engine.numRecomputations(), 2u);
+
+    // the OS saying we left forces it
+    XCTAssertTrue(engine.processRefreshRegionExit(fixAt(3.0, offsetPoint(here, 1.5 * refresh.radius, 0.0), 10.0), events));
+    XCTAssertEqual(engine.numRecomputations(), 3u);
+}
+
+- (void)testAssignPlacesKeepsState
+{
+    rtc::ManualClock clock(0.0);
+    rtc::GeofenceEngine engine(clock);
+    std::vector<rtc::GeofenceEngine::Place> places;
+    places.push_back(rtc::GeofenceEngine::Place(1, kOrigin, 600.0));
+    places.push_back(rtc::GeofenceEngine::Place(2, offsetPoint(kOrigin, 0.0, 1000.0)));
+    engine.assignPlaces(places);
+
+    std::vector<rtc::GeofenceEngine::Event> events;
+    standAt(engine, clock, kOrigin, 5.0, 2.0, events);
+    standAt(engine, clock, offsetPoint(kOrigin, 0.0, 500.0), 5.0, 2.0, events);
+    standAt(engine, clock, kOrigin, 5.0, 2.0, events);
+    standAt(engine, clock, offsetPoint(kOrigin, 0.0, 500.0), 5.0, 2.0, events);
+    XCTAssertFalse(std::isinf(engine.deadline()));
+
+    // a new place nearby starts out in whatever state the last fix puts it
+    places.push_back(rtc::GeofenceEngine::Place(3, offsetPoint(kOrigin, 0.0, 510.0)));
+    XCTAssertTrue(engine.assignPlaces(places));
+    XCTAssertEqual(engine.placeState(1), rtc::GeofenceEngine::PlaceStateOutside);
+    XCTAssertEqual(engine.placeState(3), rtc::GeofenceEngine::PlaceStateInside);
+    XCTAssertFalse(std::isinf(engine.deadline()));
+
+    // moving a place forgets it
+    places[0].coordinate = offsetPoint(kOrigin, 100.0, 0.0);
+    engine.assignPlaces(places);
+    XCTAssertTrue(std::isinf(engine.deadline()));
+    XCTAssertEqual(engine.numPlaces(), (size_t)3);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Replay simulated walks around a city's worth of saved places, with the host
+ * only feeding the engine fixes the OS would wake it up with. Logs the false
+ * positive and miss rates, event latency, recomputations and how many fixes
+ * were used against leaving the GPS on. The same walks through an engine that
+ * believes every fix show what dwell time and hysteresis are worth.
+ */
+- (void)testReplaySimulatedWalksPerformance
+{
+    std::mt19937 generator(1);
+    std::vector<rtc::GeofenceEngine::Place> places = randomPlaces(generator, kNumSimulatedPlaces);
+    rtc::SpatialIndex index;
+    for (size_t i = 0; i < places.size(); ++i) index.insert(places[i].placeID, places[i].coordinate);
+    std::vector<rtc::GeofenceTrace> traces;
+    for (NSUInteger i = 0; i < kNumSimulatedWalks; ++i) traces.push_back(simulatedWalk(generator, index));
+
+    rtc::GeofencePolicy naive;
+    naive.dwellTime = 0;
+    naive.maxAccuracy = INFINITY;
+
+    const rtc::GeofencePolicy policies[] = {rtc::GeofencePolicy(), naive};
+    const char *policyNames[] = {"engine", "every fix"};
+    rtc::GeofenceReplaySummary summaries[2];
+    for (size_t p = 0; p < 2; ++p) {
+        summaries[p] = rtc::replayGeofenceTraces(places, traces, policies[p]);
+        const rtc::GeofenceReplaySummary &summary = summaries[p];
+        NSLog(@"[%@] %s: %u true events, %u fired, %.1f%% false positives, %.1f%% missed; latency %.1fs mean, %.1fs p90; %u recomputations, %u of %u fixes used (%.2f%%)",
+              NSStringFromSelector(_cmd), policyNames[p], summary.numTrueEvents, summary.numEvents,
+              100.0 * summary.falsePositiveRate(), 100.0 * summary.missRate(),
+              summary.meanLatency, summary.p90Latency, summary.numRecomputations,
+              summary.numFixesDelivered, summary.numSamples,
+              100.0 * summary.numFixesDelivered / summary.numSamples);
+    }
+
+    const rtc::GeofenceReplaySummary &summary = summaries[0];
+    XCTAssertGreaterThan(summary.numTrueEvents, 100u);
+    XCTAssertLessThan(summary.falsePositiveRate(), 0.05);
+    // what's left is mostly the user stopping a few meters inside the radius,
+    // which fixes this noisy can't tell from stopping just outside it
+    XCTAssertLessThan(summary.missRate(), 0.10);
+    XCTAssertLessThan(summary.p90Latency, 60.0);
+    XCTAssertLessThan(summary.falsePositiveRate(), summaries[1].falsePositiveRate());
+    XCTAssertLessThan(summary.missRate(), summaries[1].missRate());
+    XCTAssertLessThan(summary.numFixesDelivered, summary.numSamples / 10);
+
+    const std::vector<rtc::GeofenceEngine::Place> *placesPtr = &places;
+    const std::vector<rtc::GeofenceTrace> *tracesPtr = &traces;
+    [self measureBlock:^{
+        rtc::replayGeofenceTraces(*placesPtr, *tracesPtr);
+    }];
+}
+
+@end
@@ -0,0 +1,225 @@
+//
+//  RTCLabelFormatTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/26/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <chrono>
+#include <vector>
+#include "RTCLabelFormat.h"
+
+// places in the scrolled list, and rows on screen at once
+static const size_t kBenchmarkPlaces = 10000;
+static const size_t kScreenRows = 12;
+
+@interface RTCLabelFormatTests : XCTestCase
+
+@end
+
+@implementation RTCLabelFormatTests
+
+#pragma mark - Helpers
+static std::string makeLabel(const std::string &text)
+{
+    return text;
+}
+
+static std::string ageLabel(double seconds)
+{
+    return rtc::labelText(rtc::ageBucket(seconds));
+}
+
+/**
+ * Ages of a list of places, newest first: a few saved in the last hour, more
+ * over the last day, most over the last year
+ */
+static std::vector<double> placeAges(size_t count)
+{
+    std::vector<double> ages;
+    double age = 30;
+    for (size_t i = 0; i < count; ++i) {
+        ages.push_back(age);
+        age += (age < rtc::kSecondsInHour) ? 300 : (age < rtc::kSecondsInDay) ? 1800 : 3000;
+    }
+    return ages;
+}
+
+
+#pragma mark - Ages
+- (void)testAgeLabels
+{
+    XCTAssertTrue(ageLabel(0) == "0m");
+    XCTAssertTrue(ageLabel(59) == "0m");
+    XCTAssertTrue(ageLabel(60) == "1m");
+    XCTAssertTrue(ageLabel(3599) == "59m");
+    XCTAssertTrue(ageLabel(3600) == "1h");
+    XCTAssertTrue(ageLabel(86399) == "23h");
+    XCTAssertTrue(ageLabel(86400) == "1d");
+    XCTAssertTrue(ageLabel(400 * 86400.0 + 5) == "400d");
+
+    XCTAssertEqual(rtc::ageBucket(-1).unit, rtc::LabelBucket::UnitNone);
+    XCTAssertTrue(ageLabel(-1) == "");
+}
+
+- (void)testAgeExpiry
+{
+    XCTAssertEqualWithAccuracy(rtc::ageBucketExpiry(0), 60.0, 1e-9);
+    XCTAssertEqualWithAccuracy(rtc::ageBucketExpiry(125), 55.0, 1e-9);
+    XCTAssertEqualWithAccuracy(rtc::ageBucketExpiry(3600), 3600.0, 1e-9);
+    XCTAssertEqualWithAccuracy(rtc::ageBucketExpiry(86400 + 10), 86390.0, 1e-9);
+    XCTAssertEqualWithAccuracy(rtc::ageBucketExpiry(-5), 5.0, 1e-9);
+
+    // the label changes right at the expiry, not before
+    double age = 2 * 3600 + 17;
+    double expiry = rtc::ageBucketExpiry(age);
+    XCTAssertFalse(rtc::ageBucketChanges(age, expiry - 0.5));
+    XCTAssertTrue(rtc::ageBucketChanges(age, expiry));
+}
+
+- (void)testOnlyChangedRowsAreStale
+{
+    // a minute later only the rows under an hour old, and the one about to
+    //   turn an hour, have new labels
+    std::vector<double> ages;
+    ages.push_back(30);
+    ages.push_back(3590);
+    ages.push_back(5 * 3600 + 100);
+    ages.push_back(3 * 86400.0);
+
+    std::vector<size_t> stale;
+    for (size_t row = 0; row < ages.size(); ++row) {
+        if (rtc::ageBucketChanges(ages[row], 60)) stale.push_back(row);
+    }
+    XCTAssertEqual(stale.size(), (size_t)2);
+    XCTAssertEqual(stale[0], (size_t)0);
+    XCTAssertEqual(stale[1], (size_t)1);
+}
+
+
+#pragma mark - Distances and Durations
+- (void)testDistanceLabels
+{
+    XCTAssertTrue(rtc::labelText(rtc::distanceBucket(0)) == "0 ft");
+    XCTAssertTrue(rtc::labelText(rtc::distanceBucket(100)) == "328 ft");
+    XCTAssertTrue(rtc::labelText(rtc::distanceBucket(160)) == "524 ft");
+    XCTAssertTrue(rtc::labelText(rtc::distanceBucket(161)) == "0.1 mi");
+    XCTAssertTrue(rtc::labelText(rtc::distanceBucket(650)) == "0.4 mi");
+    XCTAssertTrue(rtc::labelText(rtc::distanceBucket(24140)) == "15.0 mi");
+    XCTAssertEqual(rtc::distanceBucket(-1).unit, rtc::LabelBucket::UnitNone);
+
+    // rounded to the tenth, like the "%.1f" it replaces
+    XCTAssertTrue(rtc::distanceBucket(1609.34 * 1.26) == rtc::distanceBucket(1609.34 * 1.34));
+}
+
+- (void)testDurationLabels
+{
+    XCTAssertTrue(rtc::labelText(rtc::durationBucket(59)) == "0 minutes");
+    XCTAssertTrue(rtc::labelText(rtc::durationBucket(60)) == "1 minute");
+    XCTAssertTrue(rtc::labelText(rtc::durationBucket(25 * 60 + 30)) == "25 minutes");
+    XCTAssertTrue(rtc::labelText(rtc::durationBucket(3600)) == "1 hour");
+    XCTAssertTrue(rtc::labelText(rtc::durationBucket(3660)) == "1 hour 1 minute");
+    XCTAssertTrue(rtc::labelText(rtc::durationBucket(2 * 3600 + 5 * 60)) == "2 hours 5 minutes");
+    XCTAssertTrue(rtc::labelText(rtc::durationBucket(-120)) == "2 minutes");
+}
+
+
+#pragma mark - Cache
+- (void)testCacheHandsOutTheSameLabel
+{
+    rtc::LabelCache<std::string> cache(makeLabel);
+    const std::string *first = &cache.label(rtc::ageBucket(7200));
+    const std::string *second = &cache.label(rtc::ageBucket(7300));
+    XCTAssertEqual(first, second);
+    XCTAssertTrue(*first == "2h");
+    XCTAssertEqual(cache.numMisses(), (size_t)1);
+
+    // same count, different unit
+    XCTAssertTrue(cache.label(rtc::ageBucket(2 * 86400.0)) == "2d");
+    XCTAssertTrue(cache.label(rtc::distanceBucket(0.6)) == "1 ft");
+    XCTAssertTrue(cache.label(rtc::ageBucket(60)) == "1m");
+    XCTAssertEqual(cache.numMisses(), (size_t)4);
+}
+
+- (void)testPreloadedAges
+{
+    rtc::LabelCache<std::string> cache(makeLabel);
+    cache.preloadAges();
+    size_t preloaded = cache.numMisses();
+    XCTAssertEqual(preloaded, (size_t)(60 + 23 + 31));
+
+    std::vector<double> ages = placeAges(500);
+    for (size_t i = 0; i < ages.size(); ++i) {
+        if (ages[i] < 32 * rtc::kSecondsInDay) cache.label(rtc::ageBucket(ages[i]));
+    }
+    XCTAssertEqual(cache.numMisses(), preloaded);
+}
+
+- (void)testFullCacheStartsOver
+{
+    rtc::LabelCache<std::string> cache(makeLabel, 10);
+    for (long long days = 1; days <= 10; ++days) cache.label(rtc::LabelBucket(rtc::LabelBucket::UnitAgeDays, days));
+    XCTAssertEqual(cache.size(), (size_t)10);
+
+    XCTAssertTrue(cache.label(rtc::LabelBucket(rtc::LabelBucket::UnitAgeDays, 11)) == "11d");
+    XCTAssertEqual(cache.size(), (size_t)1);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Scroll a 10,000 place list a row a frame with 12 rows on screen, and label
+ * each row coming on screen: formatting a new label per cell, as the list did,
+ * against the shared labels. Labels made stand in for allocations, which is
+ * what a new NSString per cell costs in the app.
+ */
+- (void)testScrollPerformance
+{
+    std::vector<double> ages = placeAges(kBenchmarkPlaces);
+    size_t numFrames = kBenchmarkPlaces - kScreenRows;
+
+    // first screen, then a row per frame
+    size_t numCells = kScreenRows;
+    size_t length = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t row = 0; row < kScreenRows; ++row) length += ageLabel(ages[row]).size();
+    for (size_t frame = 1; frame <= numFrames; ++frame) {
+        length += ageLabel(ages[frame + kScreenRows - 1]).size();
+        ++numCells;
+    }
+    double formattedTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    double formattedPerFrame = (double)numCells / (numFrames + 1);
+
+    rtc::LabelCache<std::string> cache(makeLabel);
+    cache.preloadAges();
+    size_t preloaded = cache.numMisses();
+    size_t cachedLength = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t row = 0; row < kScreenRows; ++row) cachedLength += cache.label(rtc::ageBucket(ages[row])).size();
+    for (size_t frame = 1; frame <= numFrames; ++frame) {
+        cachedLength += cache.label(rtc::ageBucket(ages[frame + kScreenRows - 1])).size();
+    }
+    double cachedTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    double cachedPerFrame = (double)(cache.numMisses() - preloaded) / (numFrames + 1);
+
+    NSLog(@"[%@] %lu frames: formatted %.1fns per cell, %.3f labels made per frame; shared %.1fns per cell, %.3f labels made per frame (%lu labels held)",
+          NSStringFromSelector(_cmd), (unsigned long)(numFrames + 1), formattedTime / numCells, formattedPerFrame,
+          cachedTime / numCells, cachedPerFrame, (unsigned long)cache.size());
+    XCTAssertEqual(length, cachedLength);
+    XCTAssertLessThan(cachedPerFrame, 0.1);
+    XCTAssertLessThan(cachedTime, formattedTime);
+
+    std::vector<double> *agesPointer = &ages;
+    rtc::LabelCache<std::string> *cachePointer = &cache;
+    [self measureBlock:^{
+        size_t total = 0;
+        for (size_t row = 0; row < agesPointer->size(); ++row) {
+            total += cachePointer->label(rtc::ageBucket((*agesPointer)[row])).size();
+        }
+        XCTAssertGreaterThan(total, (size_t)0);
+    }];
+}
+
+@end
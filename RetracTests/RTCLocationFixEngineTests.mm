@@ -0,0 +1,228 @@
+//
+//  RTCLocationFixEngineTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/9/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include "RTCLocationFixEngine.h"
+#include "RTCFixTraceReplay.h"
+
+// number of synthetic traces used when benchmarking the replay harness
+static const NSUInteger kNumSyntheticTraces = 5000;
+
+@interface RTCLocationFixEngineTests : XCTestCase
+
+@end
+
+@implementation RTCLocationFixEngineTests
+
+#pragma mark - Helpers
+/**
+ * Load a recorded trace that was copied into the test bundle
+ */
+- (rtc::FixTrace)traceNamed:(NSString *)name
+{
+    NSString *path = [[NSBundle bundleForClass:[self class]] pathForResource:name ofType:@"csv"];
+    XCTAssertNotNil(path, @"missing trace %@", name);
+
+    rtc::FixTrace trace;
+    std::ifstream input([path fileSystemRepresentation]);
+    std::string error;
+    XCTAssertTrue(rtc::parseFixTrace(input, trace, &error), @"%s", error.c_str());
+    return trace;
+}
+
+/**
+ * Generate a trace that behaves like a cold GPS start: accuracy improves
+ * roughly geometrically with the occasional stale or invalid fix thrown in.
+ */
+static rtc::FixTrace syntheticTrace(std::mt19937 &generator)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    rtc::FixTrace trace;
+
+    double t = 0.5 + 2.0 * unit(generator);
+    double accuracy = 1414.0;
+    double decay = 0.35 + 0.5 * unit(generator);    // how quickly accuracy improves
+    double floor = 5.0 + 60.0 * unit(generator);    // best accuracy this environment allows
+
+    for (int i = 0; i < 30; ++i) {
+        double age = (unit(generator) < 0.05) ? 30.0 : 0.0;
+        double reported = (unit(generator) < 0.03) ? -1.0 : accuracy;
+        trace.push_back(rtc::TracedFix(t, rtc::LocationFix(t - age, 37.3259, -121.9455, reported)));
+
+        accuracy = std::max(floor, accuracy * decay * (0.8 + 0.4 * unit(generator)));
+        t += 0.5 + 2.5 * unit(generator);
+    }
+    return trace;
+}
+
+
+#pragma mark - Engine
+- (void)testFirstFixStartsBetterTimeout
+{
+    rtc::ManualClock clock(100.0);
+    rtc::LocationFixEngine engine(clock);
+    engine.start();
+    XCTAssertEqual(engine.deadline(), 130.0, @"first timeout should be maxWaitForFirst out");
+
+    clock.advance(2.0);
+    bool isNewBest = false;
+    rtc::LocationFixEngine::Action action = engine.processFix(rtc::LocationFix(102.0, 37.0, -121.0, 500.0), &isNewBest);
+    XCTAssertEqual(action, rtc::LocationFixEngine::ActionRescheduleTimeout);
+    XCTAssertTrue(isNewBest);
+    XCTAssertEqual(engine.deadline(), 107.0, @"better timeout should be maxWaitForBetter out");
+    XCTAssertEqual(engine.timeoutDelay(), 5.0);
+}
+
+- (void)testAccurateFixFinishes
+{
+    rtc::ManualClock clock;
+    rtc::LocationFixEngine engine(clock);
+    engine.start();
+
+    XCTAssertEqual(engine.processFix(rtc::LocationFix(0, 37.0, -121.0, 12.0)), rtc::LocationFixEngine::ActionFinish);
+    XCTAssertEqual(engine.state(), rtc::LocationFixEngine::StateFinished);
+    XCTAssertEqual(engine.finishReason(), rtc::LocationFixEngine::FinishReasonAccuracyReached);
+    XCTAssertEqual(engine.bestFix().horizontalAccuracy, 12.0);
+
+    // further fixes are ignored once done
+    XCTAssertEqual(engine.processFix(rtc::LocationFix(0, 37.0, -121.0, 3.0)), rtc::LocationFixEngine::ActionNone);
+}
+
+- (void)testStaleAndInvalidFixesRejected
+{
+    rtc::ManualClock clock(50.0);
+    rtc::LocationFixEngine engine(clock);
+    engine.start();
+
+    XCTAssertEqual(engine.processFix(rtc::LocationFix(40.0, 37.0, -121.0, 10.0)), rtc::LocationFixEngine::ActionNone);
+    XCTAssertEqual(engine.processFix(rtc::LocationFix(50.0, 37.0, -121.0, -1.0)), rtc::LocationFixEngine::ActionNone);
+    XCTAssertFalse(engine.hasBestFix());
+    XCTAssertEqual(engine.numAttempts(), 0u, @"rejected fixes don't count as attempts");
+    XCTAssertEqual(engine.numFixesReceived(), 2u);
+}
+
+- (void)testAttemptsExhausted
+{
+    rtc::ManualClock clock;
+    rtc::LocationFixPolicy policy;
+    policy.attemptsMax = 3;
+    rtc::LocationFixEngine engine(clock, policy);
+    engine.start();
+
+    XCTAssertEqual(engine.processFix(rtc::LocationFix(0, 37.0, -121.0, 100.0)), rtc::LocationFixEngine::ActionRescheduleTimeout);
+    XCTAssertEqual(engine.processFix(rtc::LocationFix(0, 37.0, -121.0, 100.0)), rtc::LocationFixEngine::ActionNone);
+    XCTAssertEqual(engine.processFix(rtc::LocationFix(0, 37.0, -121.0, 90.0)), rtc::LocationFixEngine::ActionFinish);
+    XCTAssertEqual(engine.finishReason(), rtc::LocationFixEngine::FinishReasonAttemptsExhausted);
+    XCTAssertEqual(engine.bestFix().horizontalAccuracy, 90.0);
+}
+
+- (void)testTimeoutReasons
+{
+    rtc::ManualClock clock;
+    rtc::LocationFixEngine engine(clock);
+
+    engine.start();
+    clock.advance(30.0);
+    XCTAssertEqual(engine.handleTimeout(), rtc::LocationFixEngine::ActionFinish);
+    XCTAssertEqual(engine.finishReason(), rtc::LocationFixEngine::FinishReasonFirstFixTimeout);
+    XCTAssertFalse(engine.hasBestFix());
+
+    engine.start();
+    engine.processFix(rtc::LocationFix(clock.now(), 37.0, -121.0, 200.0));
+    XCTAssertEqual(engine.handleTimeout(), rtc::LocationFixEngine::ActionFinish);
+    XCTAssertEqual(engine.finishReason(), rtc::LocationFixEngine::FinishReasonBetterFixTimeout);
+    XCTAssertEqual(engine.handleTimeout(), rtc::LocationFixEngine::ActionNone, @"timeout after finishing is a no-op");
+}
+
+
+#pragma mark - Replay
+- (void)testParseRejectsBadLine
+{
+    std::istringstream input("# comment\n1.0,37.0,-121.0,10.0\nnonsense\n");
+    rtc::FixTrace trace;
+    std::string error;
+    XCTAssertFalse(rtc::parseFixTrace(input, trace, &error));
+    XCTAssertEqual(trace.size(), 1u);
+    XCTAssertTrue(error.find("line 3") != std::string::npos);
+}
+
+- (void)testReplayRecordedTrace
+{
+    rtc::FixTrace trace = [self traceNamed:@"Parking Garage Exit"];
+    XCTAssertEqual(trace.size(), 10u);
+
+    rtc::FixReplayReport report = rtc::replayFixTrace(trace);
+    XCTAssertTrue(report.gotFix);
+    XCTAssertEqual(report.finishReason, rtc::LocationFixEngine::FinishReasonAccuracyReached);
+    XCTAssertEqualWithAccuracy(report.timeToFix, 12.8, 1e-9);
+    XCTAssertEqual(report.fixesConsumed, 9u);
+    XCTAssertEqual(report.finalAccuracy, 10.0);
+}
+
+- (void)testReplayTimesOutBetweenFixes
+{
+    rtc::FixTrace trace;
+    trace.push_back(rtc::TracedFix(1.0, rtc::LocationFix(1.0, 37.0, -121.0, 300.0)));
+    trace.push_back(rtc::TracedFix(20.0, rtc::LocationFix(20.0, 37.0, -121.0, 5.0)));
+
+    rtc::FixReplayReport report = rtc::replayFixTrace(trace);
+    XCTAssertEqual(report.finishReason, rtc::LocationFixEngine::FinishReasonBetterFixTimeout);
+    XCTAssertEqualWithAccuracy(report.timeToFix, 6.0, 1e-9);
+    XCTAssertEqual(report.fixesConsumed, 1u);
+    XCTAssertEqual(report.finalAccuracy, 300.0);
+}
+
+- (void)testReplayEmptyTrace
+{
+    rtc::FixReplayReport report = rtc::replayFixTrace(rtc::FixTrace());
+    XCTAssertFalse(report.gotFix);
+    XCTAssertEqual(report.finishReason, rtc::LocationFixEngine::FinishReasonFirstFixTimeout);
+    XCTAssertEqual(report.timeToFix, 30.0);
+}
+
+/**
+ * Replay a few thousand synthetic cold starts and log the power/latency
+ * tradeoff of the shipped policy against a stricter one.
+ */
+- (void)testReplaySyntheticTracesPerformance
+{
+    std::mt19937 generator(2014);
+    std::vector<rtc::FixTrace> traces;
+    for (NSUInteger i = 0; i < kNumSyntheticTraces; ++i) traces.push_back(syntheticTrace(generator));
+
+    rtc::LocationFixPolicy strict;
+    strict.accuracyThreshold = 8.0;
+    strict.maxWaitForBetter = 10.0;
+
+    __block rtc::FixReplaySummary shipped, stricter;
+    [self measureBlock:^{
+        std::vector<rtc::FixReplayReport> shippedReports, strictReports;
+        for (size_t i = 0; i < traces.size(); ++i) {
+            shippedReports.push_back(rtc::replayFixTrace(traces[i]));
+            strictReports.push_back(rtc::replayFixTrace(traces[i], strict));
+        }
+        shipped = rtc::summarizeFixReplays(shippedReports);
+        stricter = rtc::summarizeFixReplays(strictReports);
+    }];
+
+    NSLog(@"[%@] shipped: fixed %u/%u, time-to-fix mean %.1fs p90 %.1fs, %.1f fixes, accuracy mean %.1fm p90 %.1fm",
+          NSStringFromSelector(_cmd), shipped.numFixed, shipped.numTraces, shipped.meanTimeToFix, shipped.p90TimeToFix,
+          shipped.meanFixesConsumed, shipped.meanFinalAccuracy, shipped.p90FinalAccuracy);
+    NSLog(@"[%@] strict: fixed %u/%u, time-to-fix mean %.1fs p90 %.1fs, %.1f fixes, accuracy mean %.1fm p90 %.1fm",
+          NSStringFromSelector(_cmd), stricter.numFixed, stricter.numTraces, stricter.meanTimeToFix, stricter.p90TimeToFix,
+          stricter.meanFixesConsumed, stricter.meanFinalAccuracy, stricter.p90FinalAccuracy);
+
+    XCTAssertEqual(shipped.numTraces, (unsigned)kNumSyntheticTraces);
+    XCTAssertGreaterThanOrEqual(stricter.meanFixesConsumed, shipped.meanFixesConsumed);
+}
+
+@end
@@ -0,0 +1,231 @@
+//
+//  RTCPlaceArchiveTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/21/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include "RTCPlaceArchive.h"
+
+// number of places streamed each way in the benchmark
+static const size_t kNumBenchmarkPlaces = 1000000;
+
+@interface RTCPlaceArchiveTests : XCTestCase
+
+@end
+
+@implementation RTCPlaceArchiveTests
+
+#pragma mark - Helpers
+/**
+ * Places saved a few minutes apart around a city, like a real history
+ */
+static std::vector<rtc::PlaceRecord> randomPlaces(std::mt19937 &generator, size_t numPlaces)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<rtc::PlaceRecord> places(numPlaces);
+    double date = 1.4e9;
+    for (size_t i = 0; i < numPlaces; ++i) {
+        rtc::PlaceRecord &place = places[i];
+        place.name = "Place " + std::to_string(i);
+        place.coordinate = rtc::GeoPoint(37.7 + 0.2 * unit(generator), -122.5 + 0.2 * unit(generator));
+        place.horizontalAccuracy = std::round(5.0 + 60.0 * unit(generator));
+        date += std::round(600.0 * unit(generator) * 1e3) / 1e3;
+        place.creationDate = date;
+        place.locationTimestamp = date - 2.0;
+    }
+    return places;
+}
+
+- (void)assertPlace:(const rtc::PlaceRecord &)place equalTo:(const rtc::PlaceRecord &)expected
+{
+    XCTAssertEqual(place.name, expected.name);
+    XCTAssertEqualWithAccuracy(place.coordinate.latitude, expected.coordinate.latitude, 1e-7);
+    XCTAssertEqualWithAccuracy(place.coordinate.longitude, expected.coordinate.longitude, 1e-7);
+    XCTAssertEqualWithAccuracy(place.horizontalAccuracy, expected.horizontalAccuracy, 0.01);
+    XCTAssertEqual(std::isnan(place.creationDate), std::isnan(expected.creationDate));
+    if (!std::isnan(expected.creationDate)) XCTAssertEqualWithAccuracy(place.creationDate, expected.creationDate, 1e-3);
+    XCTAssertEqual(std::isnan(place.locationTimestamp), std::isnan(expected.locationTimestamp));
+    if (!std::isnan(expected.locationTimestamp)) XCTAssertEqualWithAccuracy(place.locationTimestamp, expected.locationTimestamp, 1e-3);
+}
+
+- (void)assertRoundTrip:(const std::vector<rtc::PlaceRecord> &)places format:(rtc::PlaceFormat)format
+{
+    std::stringstream stream;
+    rtc::PlaceArchiveWriter writer(stream, format);
+    for (size_t i = 0; i < places.size(); ++i) writer.write(places[i]);
+    XCTAssertTrue(writer.good());
+    XCTAssertEqual(writer.numWritten(), places.size());
+
+    rtc::PlaceArchiveReader reader(stream);
+    XCTAssertEqual(reader.format(), format);
+    rtc::PlaceRecord place;
+    for (size_t i = 0; i < places.size(); ++i) {
+        XCTAssertTrue(reader.read(&place), @"place %zu", i);
+        [self assertPlace:place equalTo:places[i]];
+    }
+    XCTAssertFalse(reader.read(&place));
+    XCTAssertFalse(reader.failed());
+    XCTAssertEqual(reader.numRead(), places.size());
+    XCTAssertEqual(reader.numSkipped(), (size_t)0);
+}
+
+
+#pragma mark - Round Trips
+- (void)testRoundTripBothFormats
+{
+    std::mt19937 generator(2014);
+    std::vector<rtc::PlaceRecord> places = randomPlaces(generator, 1000);
+
+    // names JSON has to escape, and fields left unknown
+    places[1].name = "Caf\xc3\xa9 \"Le Quai\"\\\n\ttab \xf0\x9f\x8d\xb0";
+    places[2].name = "";
+    places[3].horizontalAccuracy = -1.0;
+    places[3].creationDate = rtc::kUnknownPlaceDate;
+    places[4].locationTimestamp = rtc::kUnknownPlaceDate;
+    places[5].coordinate = rtc::GeoPoint(-33.8688, 151.2093);    // a long way from the last one
+    places[6].coordinate = rtc::GeoPoint(-90.0, -180.0);
+
+    [self assertRoundTrip:places format:rtc::kPlaceFormatGeoJSON];
+    [self assertRoundTrip:places format:rtc::kPlaceFormatBinary];
+}
+
+- (void)testBinaryIsCompact
+{
+    std::mt19937 generator(1);
+    std::vector<rtc::PlaceRecord> places = randomPlaces(generator, 10000);
+
+    std::stringstream geoJSON, binary;
+    rtc::PlaceArchiveWriter geoJSONWriter(geoJSON, rtc::kPlaceFormatGeoJSON);
+    rtc::PlaceArchiveWriter binaryWriter(binary, rtc::kPlaceFormatBinary);
+    for (size_t i = 0; i < places.size(); ++i) {
+        geoJSONWriter.write(places[i]);
+        binaryWriter.write(places[i]);
+    }
+
+    double geoJSONBytes = (double)geoJSON.str().size() / places.size();
+    double binaryBytes = (double)binary.str().size() / places.size();
+    NSLog(@"[%@] %.1f bytes per place as GeoJSON, %.1f as binary",
+          NSStringFromSelector(_cmd), geoJSONBytes, binaryBytes);
+    XCTAssertLessThan(binaryBytes, 0.25 * geoJSONBytes);
+}
+
+
+#pragma mark - Bad Input
+- (void)testGeoJSONSkipsLinesThatArentPlaces
+{
+    std::istringstream input(
+        "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[-122.4,37.8]},\"properties\":{\"name\":\"Home\"}}\n"
+        "\n"
+        "{\"type\":\"Feature\",\"geometry\":{\"type\":\"LineString\",\"coordinates\":[[0,0],[1,1]]},\"properties\":{}}\n"
+        "not json at all\n"
+        "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[-122.4,95.0]},\"properties\":null}\n"
+        "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[-122.4,37.8]}} trailing\n"
+        "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[-122.4,37.8]},\r\n"
+    );
+    // key order, extra members, altitude, nulls and CRLF are all fine
+    std::istringstream tail(
+        " { \"properties\" : {\"marker-color\" : [1, {\"a\": true}], \"name\":\"Work\",\"horizontalAccuracy\":12.5, \"creationDate\" : null },"
+        "\"id\":7,\"geometry\":{\"coordinates\":[2.35, 48.85, 35.0],\"type\":\"Point\"},\"type\":\"Feature\"}\r\n"
+    );
+
+    rtc::PlaceArchiveReader reader(input);
+    rtc::PlaceRecord place;
+    XCTAssertTrue(reader.read(&place));
+    XCTAssertEqual(place.name, std::string("Home"));
+    XCTAssertEqualWithAccuracy(place.coordinate.longitude, -122.4, 1e-12);
+    XCTAssertFalse(reader.read(&place));
+    XCTAssertFalse(reader.failed());
+    XCTAssertEqual(reader.numSkipped(), (size_t)5);
+
+    rtc::PlaceArchiveReader tailReader(tail);
+    XCTAssertTrue(tailReader.read(&place));
+    XCTAssertEqual(place.name, std::string("Work"));
+    XCTAssertEqualWithAccuracy(place.coordinate.latitude, 48.85, 1e-12);
+    XCTAssertEqualWithAccuracy(place.horizontalAccuracy, 12.5, 1e-12);
+    XCTAssertTrue(std::isnan(place.creationDate));
+
+    std::istringstream escaped("{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[0,0]},\"properties\":{\"name\":\"\\u00e9\\ud83c\\udf70\"}}");
+    rtc::PlaceArchiveReader escapedReader(escaped);
+    XCTAssertTrue(escapedReader.read(&place));
+    XCTAssertEqual(place.name, std::string("\xc3\xa9\xf0\x9f\x8d\xb0"));
+}
+
+- (void)testBinaryStopsAtCorruptRecord
+{
+    std::mt19937 generator(3);
+    std::vector<rtc::PlaceRecord> places = randomPlaces(generator, 10);
+    std::stringstream stream;
+    rtc::PlaceArchiveWriter writer(stream, rtc::kPlaceFormatBinary);
+    for (size_t i = 0; i < places.size(); ++i) writer.write(places[i]);
+
+    // cut off part way through the last place
+    std::string bytes = stream.str();
+    std::istringstream truncated(bytes.substr(0, bytes.size() - 3));
+    rtc::PlaceArchiveReader reader(truncated);
+    rtc::PlaceRecord place;
+    size_t numRead = 0;
+    while (reader.read(&place)) numRead++;
+    XCTAssertEqual(numRead, places.size() - 1);
+    XCTAssertTrue(reader.failed());
+
+    // not an archive at all
+    std::istringstream garbage("RTCPLAC\x01");
+    rtc::PlaceArchiveReader garbageReader(garbage);
+    XCTAssertEqual(garbageReader.format(), rtc::kPlaceFormatBinary);
+    XCTAssertFalse(garbageReader.read(&place));
+    XCTAssertTrue(garbageReader.failed());
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Stream kNumBenchmarkPlaces places to a file and back in each format and log
+ * places per second and bytes per place. Memory use is one place and the
+ * stream buffers regardless of the count.
+ */
+- (void)testStreamingThroughput
+{
+    std::mt19937 generator(1);
+    std::vector<rtc::PlaceRecord> places = randomPlaces(generator, kNumBenchmarkPlaces);
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RTCPlaceArchiveTests.places"];
+
+    const rtc::PlaceFormat formats[] = {rtc::kPlaceFormatGeoJSON, rtc::kPlaceFormatBinary};
+    const char *formatNames[] = {"GeoJSON", "binary"};
+    for (size_t f = 0; f < 2; ++f) {
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::ofstream output([path fileSystemRepresentation], std::ios::binary | std::ios::trunc);
+            rtc::PlaceArchiveWriter writer(output, formats[f]);
+            for (size_t i = 0; i < places.size(); ++i) writer.write(places[i]);
+            XCTAssertTrue(writer.good());
+        }
+        auto written = std::chrono::steady_clock::now();
+
+        std::ifstream input([path fileSystemRepresentation], std::ios::binary);
+        rtc::PlaceArchiveReader reader(input);
+        rtc::PlaceRecord place;
+        size_t numRead = 0;
+        while (reader.read(&place)) numRead++;
+        auto read = std::chrono::steady_clock::now();
+        XCTAssertEqual(numRead, places.size());
+        XCTAssertFalse(reader.failed());
+
+        input.clear();
+        std::streamoff size = input.seekg(0, std::ios::end).tellg();
+        NSLog(@"[%@] %zu places as %s (%.1f bytes each): write %.0f places/s, read %.0f places/s",
+              NSStringFromSelector(_cmd), places.size(), formatNames[f], (double)size / places.size(),
+              places.size() / std::chrono::duration<double>(written - start).count(),
+              places.size() / std::chrono::duration<double>(read - written).count());
+    }
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+@end
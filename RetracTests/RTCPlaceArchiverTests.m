@@ -0,0 +1,259 @@
+//
+//  RTCPlaceArchiverTests.m
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/21/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "RTCPlaceArchiver.h"
+#import "RTCPlace.h"
+#import "RTCPlace+Location.h"
+
+// number of places imported and exported in the benchmark. Raise to 1000000
+//   for the full run; memory shouldn't change, only the time.
+static const NSUInteger kNumBenchmarkPlaces = 100000;
+
+@interface RTCPlaceArchiverTests : XCTestCase
+
+@property (strong, nonatomic) NSURL *directoryURL;
+
+@end
+
+@implementation RTCPlaceArchiverTests
+
+#pragma mark - Setup
+- (void)setUp
+{
+    [super setUp];
+    NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    self.directoryURL = [NSURL fileURLWithPath:directory isDirectory:YES];
+    [[NSFileManager defaultManager] createDirectoryAtURL:self.directoryURL
+                             withIntermediateDirectories:YES
+                                              attributes:nil
+                                                   error:NULL];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtURL:self.directoryURL error:NULL];
+    [super tearDown];
+}
+
+
+#pragma mark - Helpers
+/**
+ * A coordinator on an empty SQLite store in the test's directory
+ */
+- (NSPersistentStoreCoordinator *)coordinatorForStoreNamed:(NSString *)storeName
+{
+    NSBundle *bundle = [NSBundle bundleForClass:[RTCPlace class]];
+    NSURL *modelURL = [bundle URLForResource:@"Retrac 2" withExtension:@"mom" subdirectory:@"Retrac.momd"];
+    NSManagedObjectModel *model = [[NSManagedObjectModel alloc] initWithContentsOfURL:modelURL];
+
+    NSPersistentStoreCoordinator *coordinator = [[NSPersistentStoreCoordinator alloc] initWithManagedObjectModel:model];
+    NSError *error = nil;
+    [coordinator addPersistentStoreWithType:NSSQLiteStoreType
+                              configuration:nil
+                                        URL:[self.directoryURL URLByAppendingPathComponent:storeName]
+                                    options:nil
+                                      error:&error];
+    XCTAssertNil(error);
+    return coordinator;
+}
+
+- (NSManagedObjectContext *)contextForCoordinator:(NSPersistentStoreCoordinator *)coordinator
+{
+    NSManagedObjectContext *context = [[NSManagedObjectContext alloc] initWithConcurrencyType:NSMainQueueConcurrencyType];
+    context.persistentStoreCoordinator = coordinator;
+    return context;
+}
+
+- (NSArray *)placesInContext:(NSManagedObjectContext *)context
+{
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    request.sortDescriptors = @[[NSSortDescriptor sortDescriptorWithKey:@"creationDate" ascending:YES]];
+    return [context executeFetchRequest:request error:NULL];
+}
+
+/**
+ * Run an export and wait for it
+ */
+- (NSUInteger)exportPlacesWithArchiver:(RTCPlaceArchiver *)archiver
+                                 toURL:(NSURL *)fileURL
+                                format:(RTCPlaceArchiveFormat)format
+{
+    XCTestExpectation *exported = [self expectationWithDescription:@"exported"];
+    __block NSUInteger numExported = 0;
+    [archiver exportPlacesToURL:fileURL format:format completion:^(BOOL success, NSUInteger numPlaces) {
+        XCTAssertTrue(success);
+        numExported = numPlaces;
+        [exported fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:600.0 handler:nil];
+    return numExported;
+}
+
+/**
+ * Run an import and wait for it
+ */
+- (NSUInteger)importPlacesWithArchiver:(RTCPlaceArchiver *)archiver
+                               fromURL:(NSURL *)fileURL
+                               success:(BOOL *)success
+{
+    XCTestExpectation *imported = [self expectationWithDescription:@"imported"];
+    __block NSUInteger numImported = 0;
+    __block BOOL importSucceeded = NO;
+    [archiver importPlacesFromURL:fileURL completion:^(BOOL succeeded, NSUInteger numPlaces) {
+        importSucceeded = succeeded;
+        numImported = numPlaces;
+        [imported fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:600.0 handler:nil];
+    if (success) *success = importSucceeded;
+    return numImported;
+}
+
+/**
+ * Write numPlaces places to fileURL as GeoJSON a line at a time
+ */
+- (void)writeGeoJSONPlaces:(NSUInteger)numPlaces toURL:(NSURL *)fileURL
+{
+    [[NSFileManager defaultManager] createFileAtPath:[fileURL path] contents:nil attributes:nil];
+    NSFileHandle *file = [NSFileHandle fileHandleForWritingToURL:fileURL error:NULL];
+    for (NSUInteger first = 0; first < numPlaces; first += 1000) {
+        @autoreleasepool {
+            NSMutableString *lines = [[NSMutableString alloc] init];
+            for (NSUInteger i = first; i < MIN(first + 1000, numPlaces); ++i) {
+                [lines appendFormat:@"{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.7f,%.7f]},\"properties\":{\"name\":\"Place %lu\",\"horizontalAccuracy\":10,\"creationDate\":%lu}}\n",
+                 -122.5 + (i % 1000) * 1e-4, 37.7 + (i / 1000) * 1e-4, (unsigned long)i, (unsigned long)(1400000000 + i)];
+            }
+            [file writeData:[lines dataUsingEncoding:NSUTF8StringEncoding]];
+        }
+    }
+    [file closeFile];
+}
+
+
+#pragma mark - Round Trips
+- (void)testExportThenImportBothFormats
+{
+    NSPersistentStoreCoordinator *coordinator = [self coordinatorForStoreNamed:@"Places.sqlite"];
+    NSManagedObjectContext *context = [self contextForCoordinator:coordinator];
+    NSUInteger numPlaces = kRTCPlaceArchiveBatchSize + 10;
+    for (NSUInteger i = 0; i < numPlaces; ++i) {
+        CLLocation *location = [[CLLocation alloc] initWithCoordinate:CLLocationCoordinate2DMake(37.0 + i * 1e-4, -122.0)
+                                                             altitude:0
+                                                   horizontalAccuracy:5.0 + i % 10
+                                                     verticalAccuracy:-1
+                                                            timestamp:[NSDate dateWithTimeIntervalSince1970:1.4e9 + i]];
+        RTCPlace *place = [RTCPlace placeWithName:[NSString stringWithFormat:@"Café \"%lu\"", (unsigned long)i]
+                                         location:location
+                                        placemark:nil
+                           inManagedObjectContext:context];
+        place.creationDate = [NSDate dateWithTimeIntervalSince1970:1.4e9 + i + 0.5];
+    }
+    // a place with no location isn't exported
+    [RTCPlace placeWithName:@"Nowhere" location:nil placemark:nil inManagedObjectContext:context];
+    XCTAssertTrue([context save:NULL]);
+
+    RTCPlaceArchiver *archiver = [[RTCPlaceArchiver alloc] initWithPersistentStoreCoordinator:coordinator];
+    NSArray *formats = @[@(RTCPlaceArchiveFormatGeoJSON), @(RTCPlaceArchiveFormatBinary)];
+    for (NSNumber *format in formats) {
+        NSURL *fileURL = [self.directoryURL URLByAppendingPathComponent:[format stringValue]];
+        XCTAssertEqual([self exportPlacesWithArchiver:archiver toURL:fileURL format:[format integerValue]], numPlaces);
+
+        NSPersistentStoreCoordinator *importCoordinator = [self coordinatorForStoreNamed:[[format stringValue] stringByAppendingString:@".sqlite"]];
+        RTCPlaceArchiver *importer = [[RTCPlaceArchiver alloc] initWithPersistentStoreCoordinator:importCoordinator];
+        BOOL success = NO;
+        XCTAssertEqual([self importPlacesWithArchiver:importer fromURL:fileURL success:&success], numPlaces);
+        XCTAssertTrue(success);
+
+        NSArray *places = [self placesInContext:[self contextForCoordinator:coordinator]];
+        NSArray *imported = [self placesInContext:[self contextForCoordinator:importCoordinator]];
+        XCTAssertEqual([imported count], numPlaces);
+        NSUInteger numChecked = 0;
+        for (RTCPlace *place in places) {
+            if (!place.latitude) continue;
+            RTCPlace *copy = imported[numChecked++];
+            XCTAssertEqualObjects(copy.name, place.name);
+            XCTAssertEqualWithAccuracy([copy.latitude doubleValue], [place.latitude doubleValue], 1e-7);
+            XCTAssertEqualWithAccuracy([copy.longitude doubleValue], [place.longitude doubleValue], 1e-7);
+            XCTAssertEqualWithAccuracy([copy.horizontalAccuracy doubleValue], [place.horizontalAccuracy doubleValue], 0.01);
+            XCTAssertEqualWithAccuracy([copy.creationDate timeIntervalSinceDate:place.creationDate], 0.0, 1e-3);
+            XCTAssertEqualWithAccuracy([copy.locationTimestamp timeIntervalSinceDate:place.locationTimestamp], 0.0, 1e-3);
+        }
+    }
+}
+
+- (void)testImportKeepsGoodLines
+{
+    NSURL *fileURL = [self.directoryURL URLByAppendingPathComponent:@"places.geojson"];
+    NSString *lines = @"{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[-122.4,37.8]},\"properties\":{\"name\":\"Home\"}}\n"
+                      @"garbage\n"
+                      @"{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[2.35,48.85]},\"properties\":{}}\n";
+    XCTAssertTrue([lines writeToURL:fileURL atomically:YES encoding:NSUTF8StringEncoding error:NULL]);
+
+    NSPersistentStoreCoordinator *coordinator = [self coordinatorForStoreNamed:@"Places.sqlite"];
+    RTCPlaceArchiver *archiver = [[RTCPlaceArchiver alloc] initWithPersistentStoreCoordinator:coordinator];
+    BOOL success = NO;
+    XCTAssertEqual([self importPlacesWithArchiver:archiver fromURL:fileURL success:&success], (NSUInteger)2);
+    XCTAssertTrue(success);
+
+    NSArray *places = [self placesInContext:[self contextForCoordinator:coordinator]];
+    XCTAssertEqual([places count], (NSUInteger)2);
+    for (RTCPlace *place in places) XCTAssertNotNil(place.creationDate);
+
+    // a missing file imports nothing
+    NSURL *missingURL = [self.directoryURL URLByAppendingPathComponent:@"missing"];
+    XCTAssertEqual([self importPlacesWithArchiver:archiver fromURL:missingURL success:&success], (NSUInteger)0);
+    XCTAssertFalse(success);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Import kNumBenchmarkPlaces places from GeoJSON, export them as GeoJSON and
+ * binary, and import the binary into a fresh store. Logs places per second and
+ * peak resident memory for each, which should stay flat as the count grows.
+ */
+- (void)testArchiveThroughput
+{
+    NSURL *sourceURL = [self.directoryURL URLByAppendingPathComponent:@"source.geojson"];
+    [self writeGeoJSONPlaces:kNumBenchmarkPlaces toURL:sourceURL];
+
+    NSPersistentStoreCoordinator *coordinator = [self coordinatorForStoreNamed:@"Places.sqlite"];
+    RTCPlaceArchiver *archiver = [[RTCPlaceArchiver alloc] initWithPersistentStoreCoordinator:coordinator];
+    NSURL *geoJSONURL = [self.directoryURL URLByAppendingPathComponent:@"export.geojson"];
+    NSURL *binaryURL = [self.directoryURL URLByAppendingPathComponent:@"export.places"];
+
+    NSDate *start = [NSDate date];
+    XCTAssertEqual([self importPlacesWithArchiver:archiver fromURL:sourceURL success:NULL], kNumBenchmarkPlaces);
+    NSTimeInterval importTime = -[start timeIntervalSinceNow];
+    unsigned long long importPeak = archiver.peakResidentSize;
+
+    start = [NSDate date];
+    XCTAssertEqual([self exportPlacesWithArchiver:archiver toURL:geoJSONURL format:RTCPlaceArchiveFormatGeoJSON], kNumBenchmarkPlaces);
+    NSTimeInterval geoJSONTime = -[start timeIntervalSinceNow];
+    unsigned long long geoJSONPeak = archiver.peakResidentSize;
+
+    start = [NSDate date];
+    XCTAssertEqual([self exportPlacesWithArchiver:archiver toURL:binaryURL format:RTCPlaceArchiveFormatBinary], kNumBenchmarkPlaces);
+    NSTimeInterval binaryTime = -[start timeIntervalSinceNow];
+    unsigned long long binaryPeak = archiver.peakResidentSize;
+
+    RTCPlaceArchiver *importer = [[RTCPlaceArchiver alloc] initWithPersistentStoreCoordinator:[self coordinatorForStoreNamed:@"Binary.sqlite"]];
+    start = [NSDate date];
+    XCTAssertEqual([self importPlacesWithArchiver:importer fromURL:binaryURL success:NULL], kNumBenchmarkPlaces);
+    NSTimeInterval binaryImportTime = -[start timeIntervalSinceNow];
+
+    NSLog(@"[%@] %lu places: GeoJSON import %.0f/s (peak %.0fMB), GeoJSON export %.0f/s (peak %.0fMB), binary export %.0f/s (peak %.0fMB), binary import %.0f/s (peak %.0fMB)",
+          NSStringFromSelector(_cmd), (unsigned long)kNumBenchmarkPlaces,
+          kNumBenchmarkPlaces / importTime, importPeak / 1e6,
+          kNumBenchmarkPlaces / geoJSONTime, geoJSONPeak / 1e6,
+          kNumBenchmarkPlaces / binaryTime, binaryPeak / 1e6,
+          kNumBenchmarkPlaces / binaryImportTime, importer.peakResidentSize / 1e6);
+}
+
+@end
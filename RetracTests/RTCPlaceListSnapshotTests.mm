@@ -0,0 +1,168 @@
+//
+//  RTCPlaceListSnapshotTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/26/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include "RTCPlaceListSnapshot.h"
+
+// places in the benchmark snapshot, as kRTCPlaceSnapshotMaxPlaces has it
+static const size_t kBenchmarkPlaces = 50;
+
+// rows on the first screen of the places list
+static const size_t kFirstScreenRows = 12;
+
+@interface RTCPlaceListSnapshotTests : XCTestCase
+
+@end
+
+@implementation RTCPlaceListSnapshotTests
+
+#pragma mark - Helpers
+static std::vector<rtc::SnapshotPlace> somePlaces(size_t count)
+{
+    std::vector<rtc::SnapshotPlace> places;
+    for (size_t i = 0; i < count; ++i) {
+        std::ostringstream label;
+        label << "Place " << i;
+        places.push_back(rtc::SnapshotPlace(label.str(), rtc::GeoPoint(34.1377 + i * 1e-4, -118.1253 - i * 1e-4),
+                                            1408000000.0 - i * 3600.0));
+    }
+    return places;
+}
+
+static std::string snapshotBytes(const std::vector<rtc::SnapshotPlace> &places)
+{
+    std::ostringstream output;
+    rtc::writePlaceSnapshot(output, places);
+    return output.str();
+}
+
+
+#pragma mark - Round Trip
+- (void)testRoundTrip
+{
+    std::vector<rtc::SnapshotPlace> places = somePlaces(3);
+    places[1].label = "Caf\xc3\xa9 \xe2\x98\x95";     // UTF-8 comes back byte for byte
+    places[2].label = "";
+    std::string bytes = snapshotBytes(places);
+    XCTAssertEqual(bytes.size(), rtc::kPlaceSnapshotHeaderSize + 3 * rtc::kPlaceSnapshotRecordSize +
+                                 places[0].label.size() + places[1].label.size());
+
+    rtc::PlaceSnapshotView view;
+    XCTAssertTrue(view.open(bytes.data(), bytes.size()));
+    XCTAssertEqual(view.size(), (size_t)3);
+    for (size_t i = 0; i < places.size(); ++i) {
+        XCTAssertTrue(view.labelString(i) == places[i].label);
+        XCTAssertEqual(view.coordinate(i).latitude, places[i].coordinate.latitude);
+        XCTAssertEqual(view.coordinate(i).longitude, places[i].coordinate.longitude);
+        XCTAssertEqual(view.creationDate(i), places[i].creationDate);
+    }
+}
+
+- (void)testEmptySnapshot
+{
+    std::string bytes = snapshotBytes(std::vector<rtc::SnapshotPlace>());
+    XCTAssertEqual(bytes.size(), rtc::kPlaceSnapshotHeaderSize);
+
+    rtc::PlaceSnapshotView view;
+    XCTAssertTrue(view.open(bytes.data(), bytes.size()));
+    XCTAssertEqual(view.size(), (size_t)0);
+}
+
+- (void)testUnalignedBytes
+{
+    // a copy one byte in, so no field is aligned
+    std::string bytes = " " + snapshotBytes(somePlaces(4));
+
+    rtc::PlaceSnapshotView view;
+    XCTAssertTrue(view.open(bytes.data() + 1, bytes.size() - 1));
+    XCTAssertTrue(view.labelString(3) == "Place 3");
+    XCTAssertEqual(view.creationDate(3), 1408000000.0 - 3 * 3600.0);
+}
+
+
+#pragma mark - Corruption
+- (void)testRejectsBadHeader
+{
+    std::string bytes = snapshotBytes(somePlaces(2));
+    rtc::PlaceSnapshotView view;
+
+    XCTAssertFalse(view.open(NULL, 0));
+    XCTAssertFalse(view.open(bytes.data(), rtc::kPlaceSnapshotHeaderSize - 1));
+
+    std::string badMagic = bytes;
+    badMagic[0] ^= 0xff;
+    XCTAssertFalse(view.open(badMagic.data(), badMagic.size()));
+
+    std::string badVersion = bytes;
+    badVersion[4] += 1;
+    XCTAssertFalse(view.open(badVersion.data(), badVersion.size()));
+    XCTAssertEqual(view.size(), (size_t)0);
+}
+
+- (void)testRejectsTruncatedFile
+{
+    std::string bytes = snapshotBytes(somePlaces(5));
+    rtc::PlaceSnapshotView view;
+
+    // every cut short of the whole file loses a label or record
+    for (size_t size = rtc::kPlaceSnapshotHeaderSize; size < bytes.size(); ++size) {
+        XCTAssertFalse(view.open(bytes.data(), size));
+    }
+    XCTAssertTrue(view.open(bytes.data(), bytes.size()));
+}
+
+- (void)testRejectsLabelOutsideFile
+{
+    std::string bytes = snapshotBytes(somePlaces(2));
+
+    // point the second label's length past the end
+    uint32_t length = 1000;
+    memcpy(&bytes[rtc::kPlaceSnapshotHeaderSize + rtc::kPlaceSnapshotRecordSize + 28], &length, sizeof(length));
+
+    rtc::PlaceSnapshotView view;
+    XCTAssertFalse(view.open(bytes.data(), bytes.size()));
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Time from having the snapshot's bytes to having the first screen of rows,
+ * which is all launch waits on. The store's size doesn't come into it;
+ * RTCPlaceStorageTests measures that against opening the store.
+ */
+- (void)testFirstScreenPerformance
+{
+    std::string bytes = snapshotBytes(somePlaces(kBenchmarkPlaces));
+    const std::string *bytesPointer = &bytes;
+
+    const size_t kRepeats = 10000;
+    size_t labelBytes = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < kRepeats; ++r) {
+        rtc::PlaceSnapshotView view;
+        view.open(bytes.data(), bytes.size());
+        for (size_t i = 0; (i < kFirstScreenRows) && (i < view.size()); ++i) labelBytes += view.labelString(i).size();
+    }
+    double microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / kRepeats;
+    NSLog(@"[%@] %zu place snapshot (%zu bytes): first screen in %.2fus", NSStringFromSelector(_cmd),
+          kBenchmarkPlaces, bytes.size(), microseconds);
+    XCTAssertGreaterThan(labelBytes, (size_t)0);
+
+    [self measureBlock:^{
+        for (size_t r = 0; r < kRepeats; ++r) {
+            rtc::PlaceSnapshotView view;
+            view.open(bytesPointer->data(), bytesPointer->size());
+            for (size_t i = 0; (i < kFirstScreenRows) && (i < view.size()); ++i) view.labelString(i);
+        }
+    }];
+}
+
+@end
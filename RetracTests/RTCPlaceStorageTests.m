@@ -0,0 +1,353 @@
+//
+//  RTCPlaceStorageTests.m
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/12/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import <MapKit/MapKit.h>
+#import "RTCPlace.h"
+#import "RTCPlace+MKAnnotation.h"
+#import "RTCPlacemark.h"
+#import "RTCPlaceSnapshot.h"
+
+// number of places saved for the migration and fetch benchmark
+static const NSUInteger kNumBenchmarkPlaces = 5000;
+
+// rows on the first screen of the places list
+static const NSUInteger kNumFirstScreenPlaces = 12;
+
+@interface RTCPlaceStorageTests : XCTestCase
+
+@property (strong, nonatomic) NSURL *storeDirectoryURL;
+
+@end
+
+@implementation RTCPlaceStorageTests
+
+#pragma mark - Setup
+- (void)setUp
+{
+    [super setUp];
+    NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    self.storeDirectoryURL = [NSURL fileURLWithPath:directory isDirectory:YES];
+    [[NSFileManager defaultManager] createDirectoryAtURL:self.storeDirectoryURL
+                             withIntermediateDirectories:YES
+                                              attributes:nil
+                                                   error:NULL];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtURL:self.storeDirectoryURL error:NULL];
+    [super tearDown];
+}
+
+
+#pragma mark - Helpers
+/**
+ * A version of the place model, by name ("Retrac" is v1, "Retrac 2" is v2)
+ */
+- (NSManagedObjectModel *)modelNamed:(NSString *)name
+{
+    NSBundle *bundle = [NSBundle bundleForClass:[RTCPlace class]];
+    NSURL *modelURL = [bundle URLForResource:name withExtension:@"mom" subdirectory:@"Retrac.momd"];
+    return [[NSManagedObjectModel alloc] initWithContentsOfURL:modelURL];
+}
+
+/**
+ * Model v1 with plain NSManagedObjects, since RTCPlace's accessors now expect
+ * the v2 columns
+ */
+- (NSManagedObjectModel *)legacyModel
+{
+    NSManagedObjectModel *model = [self modelNamed:@"Retrac"];
+    for (NSEntityDescription *entity in [model entities]) {
+        entity.managedObjectClassName = NSStringFromClass([NSManagedObject class]);
+    }
+    return model;
+}
+
+/**
+ * A main-queue context on an SQLite store in the test's directory, migrating
+ * the store to model automatically if needed
+ */
+- (NSManagedObjectContext *)contextForStoreNamed:(NSString *)storeName model:(NSManagedObjectModel *)model
+{
+    NSPersistentStoreCoordinator *coordinator = [[NSPersistentStoreCoordinator alloc] initWithManagedObjectModel:model];
+    NSDictionary *options = @{NSMigratePersistentStoresAutomaticallyOption  : @(YES),
+                              NSInferMappingModelAutomaticallyOption        : @(YES)};
+    NSError *error = nil;
+    [coordinator addPersistentStoreWithType:NSSQLiteStoreType
+                              configuration:nil
+                                        URL:[self.storeDirectoryURL URLByAppendingPathComponent:storeName]
+                                    options:options
+                                      error:&error];
+    XCTAssertNil(error);
+
+    NSManagedObjectContext *context = [[NSManagedObjectContext alloc] initWithConcurrencyType:NSMainQueueConcurrencyType];
+    context.persistentStoreCoordinator = coordinator;
+    return context;
+}
+
+- (CLLocation *)locationForPlaceNumber:(NSUInteger)i
+{
+    CLLocationCoordinate2D coordinate = CLLocationCoordinate2DMake(37.0 + i * 1e-4, -122.0 - i * 1e-4);
+    return [[CLLocation alloc] initWithCoordinate:coordinate
+                                         altitude:0
+                               horizontalAccuracy:5.0 + i % 50
+                                 verticalAccuracy:-1
+                                        timestamp:[NSDate dateWithTimeIntervalSince1970:1407000000 + i]];
+}
+
+- (CLPlacemark *)placemarkForPlaceNumber:(NSUInteger)i
+{
+    NSDictionary *address = @{@"Street" : [NSString stringWithFormat:@"%lu Maurice Lane", (unsigned long)i],
+                              @"City"   : @"San Jose",
+                              @"State"  : @"CA"};
+    return [[MKPlacemark alloc] initWithCoordinate:[self locationForPlaceNumber:i].coordinate
+                                 addressDictionary:address];
+}
+
+/**
+ * Save numPlaces places the way model v1 did: archived location and placemark
+ * blobs on the place row
+ */
+- (void)populateLegacyStoreNamed:(NSString *)storeName numPlaces:(NSUInteger)numPlaces
+{
+    NSManagedObjectContext *context = [self contextForStoreNamed:storeName model:[self legacyModel]];
+    for (NSUInteger i = 0; i < numPlaces; ++i) {
+        NSManagedObject *place = [NSEntityDescription insertNewObjectForEntityForName:@"RTCPlace"
+                                                               inManagedObjectContext:context];
+        [place setValue:[NSString stringWithFormat:@"Place %lu", (unsigned long)i] forKey:@"name"];
+        [place setValue:[NSDate date] forKey:@"creationDate"];
+        [place setValue:[self locationForPlaceNumber:i] forKey:@"location"];
+        [place setValue:[self placemarkForPlaceNumber:i] forKey:@"placemark"];
+    }
+    XCTAssertTrue([context save:NULL]);
+}
+
+/**
+ * Save numPlaces places with model v2, place i created i seconds after the
+ * first
+ */
+- (void)populateStoreNamed:(NSString *)storeName numPlaces:(NSUInteger)numPlaces
+{
+    NSManagedObjectContext *context = [self contextForStoreNamed:storeName model:[self modelNamed:@"Retrac 2"]];
+    for (NSUInteger i = 0; i < numPlaces; ++i) {
+        RTCPlace *place = [NSEntityDescription insertNewObjectForEntityForName:@"RTCPlace" inManagedObjectContext:context];
+        place.name = [NSString stringWithFormat:@"Place %lu", (unsigned long)i];
+        place.creationDate = [NSDate dateWithTimeIntervalSince1970:1407000000 + i];
+        place.location = [self locationForPlaceNumber:i];
+    }
+    XCTAssertTrue([context save:NULL]);
+}
+
+
+#pragma mark - Storage
+- (void)testLocationRoundTripsThroughColumns
+{
+    NSManagedObjectContext *context = [self contextForStoreNamed:@"Places.sqlite" model:[self modelNamed:@"Retrac 2"]];
+    RTCPlace *place = [NSEntityDescription insertNewObjectForEntityForName:@"RTCPlace" inManagedObjectContext:context];
+    XCTAssertNil(place.location);
+
+    CLLocation *location = [self locationForPlaceNumber:7];
+    place.location = location;
+    XCTAssertEqual([place.latitude doubleValue], location.coordinate.latitude);
+    XCTAssertEqual([place.longitude doubleValue], location.coordinate.longitude);
+    XCTAssertEqual(place.location.horizontalAccuracy, location.horizontalAccuracy);
+    XCTAssertEqualObjects(place.location.timestamp, location.timestamp);
+    XCTAssertEqual(place.coordinate.latitude, location.coordinate.latitude);
+
+    place.location = nil;
+    XCTAssertNil(place.latitude);
+    XCTAssertNil(place.location);
+}
+
+- (void)testPlacemarkIsOnlyLoadedWhenRead
+{
+    NSManagedObjectContext *context = [self contextForStoreNamed:@"Places.sqlite" model:[self modelNamed:@"Retrac 2"]];
+    RTCPlace *place = [NSEntityDescription insertNewObjectForEntityForName:@"RTCPlace" inManagedObjectContext:context];
+    place.location = [self locationForPlaceNumber:1];
+    place.placemark = [self placemarkForPlaceNumber:1];
+    XCTAssertTrue([context save:NULL]);
+    [context reset];
+
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    request.returnsObjectsAsFaults = NO;
+    RTCPlace *fetched = [[context executeFetchRequest:request error:NULL] firstObject];
+    XCTAssertNotNil(fetched.location);
+    XCTAssertTrue([fetched hasFaultForRelationshipNamed:@"placemarkRecord"]);
+
+    XCTAssertEqualObjects(fetched.placemark.locality, @"San Jose");
+    XCTAssertFalse([fetched hasFaultForRelationshipNamed:@"placemarkRecord"]);
+
+    // clearing the placemark removes its row
+    fetched.placemark = nil;
+    XCTAssertTrue([context save:NULL]);
+    request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlacemark"];
+    XCTAssertEqual([context countForFetchRequest:request error:NULL], (NSUInteger)0);
+}
+
+
+#pragma mark - Migration
+- (void)testLegacyPlacesMigrate
+{
+    [self populateLegacyStoreNamed:@"Places.sqlite" numPlaces:10];
+
+    NSManagedObjectContext *context = [self contextForStoreNamed:@"Places.sqlite" model:[self modelNamed:@"Retrac 2"]];
+    XCTAssertEqual([RTCPlace migrateLegacyPlacesInManagedObjectContext:context], (NSUInteger)10);
+    XCTAssertTrue([context save:NULL]);
+    [context reset];
+
+    // nothing left to migrate the second time around
+    XCTAssertEqual([RTCPlace migrateLegacyPlacesInManagedObjectContext:context], (NSUInteger)0);
+
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+    NSArray *places = [context executeFetchRequest:request error:NULL];
+    XCTAssertEqual([places count], (NSUInteger)10);
+    for (RTCPlace *place in places) {
+        NSUInteger i = [[[place.name componentsSeparatedByString:@" "] lastObject] integerValue];
+        CLLocation *expected = [self locationForPlaceNumber:i];
+        XCTAssertNil(place.legacyLocation);
+        XCTAssertNil(place.legacyPlacemark);
+        XCTAssertEqual([place.latitude doubleValue], expected.coordinate.latitude);
+        XCTAssertEqual([place.longitude doubleValue], expected.coordinate.longitude);
+        XCTAssertEqual([place.horizontalAccuracy doubleValue], expected.horizontalAccuracy);
+        XCTAssertEqualObjects(place.locationTimestamp, expected.timestamp);
+        XCTAssertEqualObjects(place.placemark.thoroughfare, [self placemarkForPlaceNumber:i].thoroughfare);
+    }
+}
+
+
+#pragma mark - Launch Snapshot
+- (void)testSnapshotMatchesPlacesList
+{
+    [self populateStoreNamed:@"Places.sqlite" numPlaces:kRTCPlaceSnapshotMaxPlaces + 10];
+    NSManagedObjectContext *context = [self contextForStoreNamed:@"Places.sqlite" model:[self modelNamed:@"Retrac 2"]];
+    NSURL *snapshotURL = [self.storeDirectoryURL URLByAppendingPathComponent:@"PlacesSnapshot"];
+    XCTAssertTrue([RTCPlaceSnapshot writeSnapshotOfPlacesInManagedObjectContext:context toURL:snapshotURL]);
+
+    RTCPlaceSnapshot *snapshot = [RTCPlaceSnapshot snapshotWithContentsOfURL:snapshotURL];
+    XCTAssertEqual(snapshot.count, kRTCPlaceSnapshotMaxPlaces);
+
+    // newest first, as the list sorts them
+    NSUInteger newest = kRTCPlaceSnapshotMaxPlaces + 9;
+    XCTAssertEqualObjects([snapshot titleAtIndex:0], ([NSString stringWithFormat:@"Place %lu", (unsigned long)newest]));
+    XCTAssertEqualObjects([snapshot creationDateAtIndex:0], [NSDate dateWithTimeIntervalSince1970:1407000000 + newest]);
+    XCTAssertEqual([snapshot coordinateAtIndex:0].latitude, [self locationForPlaceNumber:newest].coordinate.latitude);
+    XCTAssertEqualObjects([snapshot titleAtIndex:kRTCPlaceSnapshotMaxPlaces - 1], @"Place 10");
+}
+
+- (void)testMissingOrDamagedSnapshotIsNil
+{
+    NSURL *snapshotURL = [self.storeDirectoryURL URLByAppendingPathComponent:@"PlacesSnapshot"];
+    XCTAssertNil([RTCPlaceSnapshot snapshotWithContentsOfURL:snapshotURL]);
+
+    [[@"not a snapshot" dataUsingEncoding:NSUTF8StringEncoding] writeToURL:snapshotURL atomically:YES];
+    XCTAssertNil([RTCPlaceSnapshot snapshotWithContentsOfURL:snapshotURL]);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Fetch every place and read its coordinate, as the map does, from a v1 store
+ * and from the same places migrated to v2.
+ */
+- (void)testFetchBenchmark
+{
+    [self populateLegacyStoreNamed:@"Legacy.sqlite" numPlaces:kNumBenchmarkPlaces];
+    NSManagedObjectContext *legacyContext = [self contextForStoreNamed:@"Legacy.sqlite" model:[self legacyModel]];
+
+    [self populateLegacyStoreNamed:@"Places.sqlite" numPlaces:kNumBenchmarkPlaces];
+    NSManagedObjectContext *context = [self contextForStoreNamed:@"Places.sqlite" model:[self modelNamed:@"Retrac 2"]];
+    [RTCPlace migrateLegacyPlacesInManagedObjectContext:context];
+    XCTAssertTrue([context save:NULL]);
+
+    NSTimeInterval (^timeFetch)(NSManagedObjectContext *, CLLocationCoordinate2D (^)(NSManagedObject *)) =
+    ^(NSManagedObjectContext *aContext, CLLocationCoordinate2D (^coordinateOf)(NSManagedObject *)) {
+        [aContext reset];
+        NSDate *start = [NSDate date];
+        NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+        request.returnsObjectsAsFaults = NO;
+        double sum = 0;
+        for (NSManagedObject *place in [aContext executeFetchRequest:request error:NULL]) {
+            sum += coordinateOf(place).latitude;
+        }
+        XCTAssertGreaterThan(sum, 0.0);
+        return -[start timeIntervalSinceNow];
+    };
+
+    NSTimeInterval legacyTime = timeFetch(legacyContext, ^(NSManagedObject *place) {
+        return [(CLLocation *)[place valueForKey:@"location"] coordinate];
+    });
+    NSTimeInterval columnTime = timeFetch(context, ^(NSManagedObject *place) {
+        return [(RTCPlace *)place coordinate];
+    });
+
+    NSLog(@"[%@] %lu places: archived blobs %.1fms, scalar columns %.1fms",
+          NSStringFromSelector(_cmd), (unsigned long)kNumBenchmarkPlaces, legacyTime * 1e3, columnTime * 1e3);
+
+    [self measureBlock:^{
+        timeFetch(context, ^(NSManagedObject *place) {
+            return [(RTCPlace *)place coordinate];
+        });
+    }];
+
+    XCTAssertLessThan(columnTime, legacyTime);
+}
+
+/**
+ * Time to the first screen of the places list at launch, for stores from 10
+ * to 100,000 places: opening the store and fetching the first rows, against
+ * mapping the snapshot and reading its labels.
+ */
+- (void)testStartupBenchmark
+{
+    NSURL *snapshotURL = [self.storeDirectoryURL URLByAppendingPathComponent:@"PlacesSnapshot"];
+    NSTimeInterval (^timeSnapshot)(void) = ^{
+        NSDate *start = [NSDate date];
+        RTCPlaceSnapshot *snapshot = [RTCPlaceSnapshot snapshotWithContentsOfURL:snapshotURL];
+        NSUInteger length = 0;
+        for (NSUInteger row = 0; row < MIN(kNumFirstScreenPlaces, snapshot.count); ++row) {
+            length += [[snapshot titleAtIndex:row] length] + [[[snapshot creationDateAtIndex:row] description] length];
+        }
+        XCTAssertGreaterThan(length, (NSUInteger)0);
+        return -[start timeIntervalSinceNow];
+    };
+
+    for (NSUInteger numPlaces = 10; numPlaces <= 100000; numPlaces *= 10) {
+        NSString *storeName = [NSString stringWithFormat:@"Places%lu.sqlite", (unsigned long)numPlaces];
+        [self populateStoreNamed:storeName numPlaces:numPlaces];
+
+        // what the list does once the document is open
+        NSDate *start = [NSDate date];
+        NSManagedObjectContext *context = [self contextForStoreNamed:storeName model:[self modelNamed:@"Retrac 2"]];
+        NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:@"RTCPlace"];
+        request.sortDescriptors = @[[NSSortDescriptor sortDescriptorWithKey:@"creationDate" ascending:NO]];
+        request.fetchBatchSize = 20;
+        NSArray *places = [context executeFetchRequest:request error:NULL];
+        NSUInteger length = 0;
+        for (NSUInteger row = 0; row < MIN(kNumFirstScreenPlaces, [places count]); ++row) {
+            RTCPlace *place = places[row];
+            length += [place.title length] + [[place.creationDate description] length];
+        }
+        XCTAssertGreaterThan(length, (NSUInteger)0);
+        NSTimeInterval storeTime = -[start timeIntervalSinceNow];
+
+        XCTAssertTrue([RTCPlaceSnapshot writeSnapshotOfPlacesInManagedObjectContext:context toURL:snapshotURL]);
+        NSTimeInterval snapshotTime = timeSnapshot();
+
+        NSLog(@"[%@] %lu places: store open and fetch %.2fms, snapshot %.3fms",
+              NSStringFromSelector(_cmd), (unsigned long)numPlaces, storeTime * 1e3, snapshotTime * 1e3);
+        XCTAssertLessThan(snapshotTime, storeTime);
+    }
+
+    [self measureBlock:^{
+        timeSnapshot();
+    }];
+}
+
+@end
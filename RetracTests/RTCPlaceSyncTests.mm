@@ -0,0 +1,576 @@
+//
+//  RTCPlaceSyncTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/31/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include "RTCPlaceSync.h"
+#include "RTCPlaceSyncReplay.h"
+
+// changes made between the two devices in the benchmark, and how many each
+//   makes between syncs
+static const size_t kBenchmarkOps = 100000;
+static const size_t kBenchmarkOpsPerSync = 100;
+
+static const rtc::DeviceID kPhone = 0x5a17c0ffee000001ULL;
+static const rtc::DeviceID kTablet = 0x5a17c0ffee000002ULL;
+
+static const double kStartTime = 1409500000.0;      // 31 Aug 2014
+
+@interface RTCPlaceSyncTests : XCTestCase
+
+@end
+
+@implementation RTCPlaceSyncTests
+
+#pragma mark - Helpers
+static rtc::PlaceUUID randomUUID(std::mt19937_64 &generator)
+{
+    return rtc::PlaceUUID(generator(), generator());
+}
+
+static rtc::PlaceRecord parkingSpot(std::mt19937_64 &generator, double time)
+{
+    std::uniform_real_distribution<double> offset(-0.05, 0.05);
+    rtc::PlaceRecord record;
+    record.name = "Level " + std::to_string(generator() % 6) + ", row " + std::to_string(generator() % 40);
+    record.coordinate = rtc::GeoPoint(37.3259 + offset(generator), -121.9455 + offset(generator));
+    record.horizontalAccuracy = 5.0 + (generator() % 60);
+    record.creationDate = time;
+    record.locationTimestamp = time - 2.5;
+    return record;
+}
+
+/**
+ * Make a random change on replica, like staff saving, renaming and clearing
+ * parking spots: a new place a fifth of the time (or if there are none), else
+ * a rename, a timeout change or a delete of a live place.
+ */
+static rtc::PlaceOp randomChange(rtc::PlaceReplica &replica, std::vector<rtc::PlaceUUID> &uuids,
+                                 std::mt19937_64 &generator, double time)
+{
+    // forget places another device deleted
+    while (!uuids.empty()) {
+        size_t index = generator() % uuids.size();
+        const rtc::SyncedPlace *place = replica.place(uuids[index]);
+        if (place && place->isLive()) break;
+        uuids[index] = uuids.back();
+        uuids.pop_back();
+    }
+
+    uint64_t kind = generator() % 20;
+    if (uuids.empty() || (kind < 4)) {
+        rtc::PlaceUUID uuid = randomUUID(generator);
+        uuids.push_back(uuid);
+        return replica.create(uuid, parkingSpot(generator, time), 0);
+    }
+
+    size_t index = generator() % uuids.size();
+    rtc::PlaceUUID uuid = uuids[index];
+    if (kind < 12) return replica.rename(uuid, "Spot " + std::to_string(generator() % 1000));
+    if (kind < 17) return replica.setTimeout(uuid, (int32_t)(900 * (generator() % 16)));
+
+    uuids[index] = uuids.back();
+    uuids.pop_back();
+    return replica.remove(uuid);
+}
+
+/**
+ * Do replicas show the same places, field for field?
+ */
+static bool sameLivePlaces(const rtc::PlaceReplica &a, const rtc::PlaceReplica &b)
+{
+    std::vector<const rtc::SyncedPlace *> placesA, placesB;
+    a.livePlaces(placesA);
+    b.livePlaces(placesB);
+    if (placesA.size() != placesB.size()) return false;
+    for (size_t i = 0; i < placesA.size(); ++i) {
+        const rtc::SyncedPlace &placeA = *placesA[i], &placeB = *placesB[i];
+        if ((placeA.uuid != placeB.uuid) || (placeA.record.name != placeB.record.name) ||
+            (placeA.timeout != placeB.timeout) ||
+            (placeA.record.coordinate.latitude != placeB.record.coordinate.latitude) ||
+            (placeA.record.coordinate.longitude != placeB.record.coordinate.longitude) ||
+            (placeA.record.creationDate != placeB.record.creationDate)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Empty directory for a FileSyncServer, in the temporary directory
+ */
+static std::string serverDirectory(NSString *name)
+{
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    [[NSFileManager defaultManager] createDirectoryAtPath:path withIntermediateDirectories:YES attributes:nil error:NULL];
+    return [path fileSystemRepresentation];
+}
+
+
+#pragma mark - Clock
+- (void)testHybridClockNeverGoesBack
+{
+    rtc::ManualClock clock(kStartTime);
+    rtc::HybridClock hybridClock(clock);
+
+    rtc::HybridTime first = hybridClock.now();
+    XCTAssertEqualWithAccuracy(rtc::hybridTimeSeconds(first), kStartTime, 1e-3);
+
+    // same millisecond, then the wall clock going back a minute
+    rtc::HybridTime second = hybridClock.now();
+    clock.advance(-60.0);
+    rtc::HybridTime third = hybridClock.now();
+    XCTAssertGreaterThan(second, first);
+    XCTAssertGreaterThan(third, second);
+
+    // another device an hour ahead
+    rtc::HybridTime remote = rtc::hybridTime(kStartTime + 3600.0);
+    hybridClock.observe(remote);
+    XCTAssertGreaterThan(hybridClock.now(), remote);
+
+    // and the wall clock takes over again once it passes
+    clock.setNow(kStartTime + 7200.0);
+    XCTAssertEqual(hybridClock.now(), rtc::hybridTime(kStartTime + 7200.0));
+}
+
+
+#pragma mark - Replica
+- (void)testLocalChanges
+{
+    rtc::ManualClock clock(kStartTime);
+    rtc::PlaceReplica replica(kPhone, clock);
+    std::mt19937_64 generator(1);
+
+    rtc::PlaceUUID car = randomUUID(generator), bike = randomUUID(generator);
+    replica.create(car, parkingSpot(generator, kStartTime), 0);
+    replica.create(bike, parkingSpot(generator, kStartTime), 3600);
+    replica.rename(car, "Car");
+    replica.setTimeout(car, 1800);
+    rtc::PlaceOp removed = replica.remove(bike);
+
+    XCTAssertEqual(removed.seq, 5u);
+    XCTAssertEqual(replica.numOps(), 5u);
+    XCTAssertEqual(replica.version().at(kPhone), 5u);
+    XCTAssertEqual(replica.numLivePlaces(), 1u);
+    XCTAssertEqual(replica.place(car)->record.name, std::string("Car"));
+    XCTAssertEqual(replica.place(car)->timeout, 1800);
+    XCTAssertTrue(replica.place(bike)->deleted);
+    XCTAssertTrue(replica.place(randomUUID(generator)) == NULL);
+}
+
+- (void)testConcurrentRenamesConverge
+{
+    rtc::ManualClock phoneClock(kStartTime), tabletClock(kStartTime - 30.0);    // tablet runs 30s slow
+    rtc::PlaceReplica phone(kPhone, phoneClock), tablet(kTablet, tabletClock);
+    std::mt19937_64 generator(2);
+
+    rtc::PlaceUUID car = randomUUID(generator);
+    std::vector<rtc::PlaceOp> created(1, phone.create(car, parkingSpot(generator, kStartTime), 0));
+    XCTAssertEqual(tablet.merge(created), 1u);
+
+    // renamed on both before either syncs. The tablet's clock is still behind
+    //   the create it has seen, so its rename goes just after that, and the
+    //   phone's, made later, wins on both
+    phoneClock.advance(5.0);
+    tabletClock.advance(10.0);
+    std::vector<rtc::PlaceOp> fromPhone(1, phone.rename(car, "Phone"));
+    std::vector<rtc::PlaceOp> fromTablet(1, tablet.rename(car, "Tablet"));
+    XCTAssertGreaterThan(fromTablet[0].time, created[0].time);
+
+    std::vector<rtc::PlaceUUID> changed;
+    XCTAssertEqual(phone.merge(fromTablet, &changed), 1u);
+    XCTAssertTrue(changed.empty());
+    XCTAssertEqual(tablet.merge(fromPhone, &changed), 1u);
+    XCTAssertEqual(changed.size(), 1u);
+    XCTAssertTrue(sameLivePlaces(phone, tablet));
+    XCTAssertEqual(phone.place(car)->record.name, std::string("Phone"));
+}
+
+- (void)testDeleteWinsOverConcurrentEdits
+{
+    rtc::ManualClock clock(kStartTime);
+    rtc::PlaceReplica phone(kPhone, clock), tablet(kTablet, clock);
+    std::mt19937_64 generator(3);
+
+    rtc::PlaceUUID car = randomUUID(generator);
+    std::vector<rtc::PlaceOp> created(1, phone.create(car, parkingSpot(generator, kStartTime), 0));
+    tablet.merge(created);
+
+    std::vector<rtc::PlaceOp> fromPhone(1, phone.remove(car));
+    clock.advance(60.0);
+    std::vector<rtc::PlaceOp> fromTablet;
+    fromTablet.push_back(tablet.rename(car, "Still here"));
+    fromTablet.push_back(tablet.setTimeout(car, 600));
+
+    phone.merge(fromTablet);
+    tablet.merge(fromPhone);
+    XCTAssertEqual(phone.numLivePlaces(), 0u);
+    XCTAssertEqual(tablet.numLivePlaces(), 0u);
+}
+
+- (void)testMergeIgnoresOrderAndRepeats
+{
+    // three devices make changes, each seeing the others' now and then
+    rtc::ManualClock clock(kStartTime);
+    std::vector<rtc::PlaceReplica> devices;
+    for (rtc::DeviceID device = 1; device <= 3; ++device) devices.push_back(rtc::PlaceReplica(device, clock));
+    std::vector<std::vector<rtc::PlaceUUID> > uuids(devices.size());
+    std::mt19937_64 generator(4);
+    size_t numChanges = 3000;
+    for (size_t i = 0; i < numChanges; ++i) {
+        clock.advance(1.0);
+        size_t d = generator() % devices.size();
+        randomChange(devices[d], uuids[d], generator, clock.now());
+        if (generator() % 10 == 0) {
+            std::vector<rtc::PlaceOp> ops;
+            devices[(d + 1) % devices.size()].opsSince(devices[d].version(), ops);
+            devices[d].merge(ops);
+        }
+    }
+
+    // every device's log, so each change is in there more than once
+    std::vector<rtc::PlaceOp> all;
+    for (size_t d = 0; d < devices.size(); ++d) {
+        std::vector<rtc::PlaceOp> ops;
+        devices[d].opsSince(rtc::VersionVector(), ops);
+        all.insert(all.end(), ops.begin(), ops.end());
+    }
+    std::vector<rtc::PlaceReplica> copies;
+    for (size_t c = 0; c < 3; ++c) {
+        std::vector<rtc::PlaceOp> shuffled = all;
+        std::stable_sort(shuffled.begin(), shuffled.end(), [](const rtc::PlaceOp &a, const rtc::PlaceOp &b) {
+            return a.device < b.device;
+        });
+        if (c == 1) std::reverse(shuffled.begin(), shuffled.end());
+        if (c == 2) std::rotate(shuffled.begin(), shuffled.begin() + shuffled.size() / 3, shuffled.end());
+
+        copies.push_back(rtc::PlaceReplica(100 + c, clock));
+        // reversed or rotated, a device's changes only go in once their
+        //   predecessors have, so keep merging until nothing more does
+        while (copies.back().merge(shuffled)) {}
+        copies.back().merge(shuffled);
+        XCTAssertEqual(copies.back().numOps(), numChanges);
+    }
+    for (size_t d = 0; d < devices.size(); ++d) {
+        std::vector<rtc::PlaceOp> ops;
+        copies[0].opsSince(devices[d].version(), ops);
+        devices[d].merge(ops);
+        XCTAssertTrue(sameLivePlaces(devices[d], copies[0]));
+    }
+    XCTAssertTrue(sameLivePlaces(copies[0], copies[1]));
+    XCTAssertTrue(sameLivePlaces(copies[0], copies[2]));
+    XCTAssertGreaterThan(copies[0].numLivePlaces(), 0u);
+}
+
+- (void)testRejectsGapsAndRepeats
+{
+    rtc::ManualClock clock(kStartTime);
+    rtc::PlaceReplica phone(kPhone, clock), tablet(kTablet, clock);
+    std::mt19937_64 generator(5);
+
+    rtc::PlaceUUID car = randomUUID(generator);
+    rtc::PlaceOp first = phone.create(car, parkingSpot(generator, kStartTime), 0);
+    rtc::PlaceOp second = phone.rename(car, "Car");
+
+    XCTAssertFalse(tablet.merge(second));
+    XCTAssertTrue(tablet.merge(first));
+    XCTAssertFalse(tablet.merge(first));
+    XCTAssertTrue(tablet.merge(second));
+    XCTAssertEqual(tablet.numOps(), 2u);
+}
+
+- (void)testReplicaRoundTrip
+{
+    rtc::ManualClock clock(kStartTime);
+    rtc::PlaceReplica phone(kPhone, clock), tablet(kTablet, clock);
+    std::vector<rtc::PlaceUUID> phoneUUIDs, tabletUUIDs;
+    std::mt19937_64 generator(6);
+    for (size_t i = 0; i < 500; ++i) {
+        clock.advance(30.0);
+        randomChange(phone, phoneUUIDs, generator, clock.now());
+        randomChange(tablet, tabletUUIDs, generator, clock.now());
+    }
+    std::vector<rtc::PlaceOp> ops;
+    tablet.opsSince(phone.version(), ops);
+    phone.merge(ops);
+
+    std::stringstream stream;
+    XCTAssertTrue(phone.write(stream));
+    rtc::PlaceReplica read(0, clock);
+    XCTAssertTrue(read.read(stream));
+    XCTAssertEqual(read.device(), kPhone);
+    XCTAssertEqual(read.numOps(), phone.numOps());
+    XCTAssertTrue(read.version() == phone.version());
+    XCTAssertTrue(sameLivePlaces(read, phone));
+
+    // and carries on numbering its changes where it left off
+    rtc::PlaceOp next = read.rename(phoneUUIDs.empty() ? randomUUID(generator) : phoneUUIDs[0], "Next");
+    XCTAssertEqual(next.seq, phone.version().at(kPhone) + 1);
+}
+
+- (void)testRejectsCorruptReplica
+{
+    rtc::ManualClock clock(kStartTime);
+    rtc::PlaceReplica phone(kPhone, clock);
+    std::vector<rtc::PlaceUUID> uuids;
+    std::mt19937_64 generator(7);
+    for (size_t i = 0; i < 50; ++i) randomChange(phone, uuids, generator, clock.now());
+    std::stringstream stream;
+    phone.write(stream);
+    std::string bytes = stream.str();
+
+    rtc::PlaceReplica read(0, clock);
+    std::istringstream truncated(bytes.substr(0, bytes.size() - 3));
+    XCTAssertFalse(read.read(truncated));
+    XCTAssertEqual(read.numOps(), 0u);
+
+    std::istringstream garbage("RTCPSYNC\x01");
+    XCTAssertFalse(read.read(garbage));
+}
+
+
+#pragma mark - Messages
+- (void)testMessageRoundTrip
+{
+    rtc::ManualClock clock(kStartTime);
+    rtc::PlaceReplica phone(kPhone, clock);
+    std::mt19937_64 generator(8);
+
+    rtc::PlaceUUID car = randomUUID(generator), bike = randomUUID(generator);
+    rtc::PlaceRecord unknownDates = parkingSpot(generator, kStartTime);
+    unknownDates.creationDate = rtc::kUnknownPlaceDate;
+    unknownDates.locationTimestamp = rtc::kUnknownPlaceDate;
+    unknownDates.horizontalAccuracy = -1.0;
+    unknownDates.name = "Caf\xc3\xa9 \xe2\x80\x94 level 2";
+
+    rtc::SyncMessage message;
+    message.version[kPhone] = 6;
+    message.version[kTablet] = 123456;
+    message.ops.push_back(phone.create(car, parkingSpot(generator, kStartTime), 900));
+    message.ops.push_back(phone.create(bike, unknownDates, -5));
+    clock.advance(-10.0);
+    message.ops.push_back(phone.rename(car, ""));
+    message.ops.push_back(phone.setTimeout(bike, 7200));
+    message.ops.push_back(phone.remove(car));
+    rtc::PlaceOp fromTablet = message.ops[3];
+    fromTablet.device = kTablet;
+    fromTablet.seq = 77;
+    message.ops.push_back(fromTablet);
+
+    std::string bytes;
+    rtc::encodeSyncMessage(message, bytes);
+    rtc::SyncMessage decoded;
+    XCTAssertTrue(rtc::decodeSyncMessage(bytes.data(), bytes.size(), &decoded));
+    XCTAssertTrue(decoded.version == message.version);
+    XCTAssertEqual(decoded.ops.size(), message.ops.size());
+    for (size_t i = 0; i < message.ops.size(); ++i) {
+        const rtc::PlaceOp &op = message.ops[i], &decodedOp = decoded.ops[i];
+        XCTAssertEqual(decodedOp.kind, op.kind);
+        XCTAssertEqual(decodedOp.device, op.device);
+        XCTAssertEqual(decodedOp.seq, op.seq);
+        XCTAssertEqual(decodedOp.time, op.time);
+        XCTAssertTrue(decodedOp.place == op.place);
+        XCTAssertEqual(decodedOp.timeout, op.timeout);
+        XCTAssertEqual(decodedOp.record.name, op.record.name);
+        XCTAssertEqual(decodedOp.record.coordinate.latitude, op.record.coordinate.latitude);
+        XCTAssertEqual(decodedOp.record.coordinate.longitude, op.record.coordinate.longitude);
+        XCTAssertEqual(decodedOp.record.horizontalAccuracy, op.record.horizontalAccuracy);
+        XCTAssertEqual(std::isnan(decodedOp.record.creationDate), std::isnan(op.record.creationDate));
+        if (!std::isnan(op.record.creationDate)) {
+            XCTAssertEqual(decodedOp.record.creationDate, op.record.creationDate);
+            XCTAssertEqual(decodedOp.record.locationTimestamp, op.record.locationTimestamp);
+        }
+    }
+}
+
+- (void)testRejectsCorruptMessages
+{
+    rtc::ManualClock clock(kStartTime);
+    rtc::PlaceReplica phone(kPhone, clock);
+    std::vector<rtc::PlaceUUID> uuids;
+    std::mt19937_64 generator(9);
+    rtc::SyncMessage message;
+    for (size_t i = 0; i < 200; ++i) message.ops.push_back(randomChange(phone, uuids, generator, clock.now()));
+    std::string bytes;
+    rtc::encodeSyncMessage(message, bytes);
+
+    rtc::SyncMessage decoded;
+    for (size_t length = 0; length < bytes.size(); length += 7) {
+        XCTAssertFalse(rtc::decodeSyncMessage(bytes.data(), length, &decoded));
+    }
+
+    // flipped bits mustn't crash, and whatever still decodes is well formed
+    for (size_t i = 0; i < 2000; ++i) {
+        std::string corrupt = bytes;
+        corrupt[generator() % corrupt.size()] ^= (char)(1 << (generator() % 8));
+        if (rtc::decodeSyncMessage(corrupt.data(), corrupt.size(), &decoded)) {
+            XCTAssertEqual(decoded.ops.size(), message.ops.size());
+        }
+    }
+}
+
+
+#pragma mark - Server
+- (void)testServerSendsOnlyWhatIsMissing
+{
+    rtc::ManualClock clock(kStartTime);
+    rtc::PlaceReplica phone(kPhone, clock), tablet(kTablet, clock);
+    std::vector<rtc::PlaceUUID> phoneUUIDs, tabletUUIDs;
+    std::mt19937_64 generator(10);
+    std::string directory = serverDirectory(@"RTCPlaceSyncTests.server");
+    rtc::FileSyncServer server(directory);
+
+    for (size_t i = 0; i < 300; ++i) randomChange(phone, phoneUUIDs, generator, clock.now());
+    rtc::PlaceSyncStats phoneStats, tabletStats;
+    XCTAssertTrue(rtc::syncReplica(phone, server, &phoneStats));
+    XCTAssertTrue(rtc::syncReplica(tablet, server, &tabletStats));
+    XCTAssertEqual(phoneStats.opsSent, 300u);
+    XCTAssertEqual(tabletStats.opsReceived, 300u);
+    XCTAssertTrue(sameLivePlaces(phone, tablet));
+
+    // a few more changes on each: only those go anywhere
+    for (size_t i = 0; i < 5; ++i) {
+        clock.advance(60.0);
+        randomChange(phone, phoneUUIDs, generator, clock.now());
+        randomChange(tablet, tabletUUIDs, generator, clock.now());
+    }
+    uint64_t bytesBefore = phoneStats.bytesSent + phoneStats.bytesReceived;
+    rtc::syncReplica(phone, server, &phoneStats);
+    rtc::syncReplica(tablet, server, &tabletStats);
+    rtc::syncReplica(phone, server, &phoneStats);
+    XCTAssertEqual(phoneStats.opsSent, 305u);
+    XCTAssertEqual(phoneStats.opsReceived, 5u);
+    XCTAssertEqual(tabletStats.opsReceived, 305u);
+    XCTAssertLessThan(phoneStats.bytesSent + phoneStats.bytesReceived - bytesBefore, 400u);
+    XCTAssertTrue(sameLivePlaces(phone, tablet));
+
+    // a repeated request stores nothing twice
+    uint64_t stored = server.byteSize();
+    std::string request, response;
+    rtc::SyncMessage message;
+    message.version[kPhone] = 0;
+    phone.opsSince(rtc::VersionVector(), message.ops);
+    rtc::encodeSyncMessage(message, request);
+    XCTAssertTrue(server.exchange(request, response));
+    XCTAssertEqual(server.byteSize(), stored);
+
+    // the server picks up where it left off, and a fresh device gets it all
+    rtc::FileSyncServer reopened(directory);
+    XCTAssertTrue(reopened.version() == server.version());
+    rtc::PlaceReplica laptop(0x1a7709, clock);
+    XCTAssertTrue(rtc::syncReplica(laptop, reopened));
+    XCTAssertTrue(sameLivePlaces(laptop, phone));
+}
+
+- (void)testServerStopsAtGaps
+{
+    rtc::ManualClock clock(kStartTime);
+    rtc::PlaceReplica phone(kPhone, clock);
+    std::vector<rtc::PlaceUUID> uuids;
+    std::mt19937_64 generator(11);
+    rtc::FileSyncServer server(serverDirectory(@"RTCPlaceSyncTests.gaps"));
+    for (size_t i = 0; i < 10; ++i) randomChange(phone, uuids, generator, clock.now());
+
+    rtc::SyncMessage message;
+    phone.opsSince(rtc::VersionVector(), message.ops);
+    message.ops.erase(message.ops.begin() + 4);
+    std::string request, response;
+    rtc::encodeSyncMessage(message, request);
+    XCTAssertTrue(server.exchange(request, response));
+    XCTAssertEqual(server.version().at(kPhone), 4u);
+
+    XCTAssertFalse(server.exchange(std::string("\x01\x05", 2), response));
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Two devices make kBenchmarkOps changes between them, syncing through the
+ * file-based server every kBenchmarkOpsPerSync changes. Logs bytes sent and
+ * received against re-uploading every place each sync, then how long a new
+ * device takes to catch up on all of it.
+ */
+- (void)testSyncPerformance
+{
+    rtc::ManualClock phoneClock(kStartTime), tabletClock(kStartTime + 45.0);
+    rtc::PlaceReplica phone(kPhone, phoneClock), tablet(kTablet, tabletClock);
+    std::vector<rtc::PlaceUUID> phoneUUIDs, tabletUUIDs;
+    std::mt19937_64 generator(12);
+    std::string directory = serverDirectory(@"RTCPlaceSyncTests.benchmark");
+    rtc::FileSyncServer server(directory);
+
+    rtc::PlaceSyncStats stats;
+    uint64_t fullUploadBytes = 0;
+    std::vector<rtc::PlaceUUID> changed;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kBenchmarkOps; i += 2) {
+        phoneClock.advance(20.0);
+        tabletClock.advance(20.0);
+        randomChange(phone, phoneUUIDs, generator, phoneClock.now());
+        randomChange(tablet, tabletUUIDs, generator, tabletClock.now());
+
+        if ((i + 2) % kBenchmarkOpsPerSync == 0) {
+            XCTAssertTrue(rtc::syncReplica(phone, server, &stats, &changed));
+            XCTAssertTrue(rtc::syncReplica(tablet, server, &stats, &changed));
+
+            // what a re-upload of the phone's places would send instead
+            std::vector<const rtc::SyncedPlace *> places;
+            phone.livePlaces(places);
+            rtc::SyncMessage everything;
+            for (size_t p = 0; p < places.size(); ++p) {
+                rtc::PlaceOp op;
+                op.device = kPhone;
+                op.seq = (uint32_t)(p + 1);
+                op.time = places[p]->created.time;
+                op.place = places[p]->uuid;
+                op.record = places[p]->record;
+                op.timeout = places[p]->timeout;
+                everything.ops.push_back(op);
+            }
+            std::string bytes;
+            rtc::encodeSyncMessage(everything, bytes);
+            fullUploadBytes += 2 * bytes.size();
+        }
+    }
+    rtc::syncReplica(phone, server, &stats);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    XCTAssertTrue(sameLivePlaces(phone, tablet));
+
+    NSLog(@"[%@] %zu changes, %zu places left, %zu syncs: sent %.2f MB (%.1f bytes/change), "
+          "received %.2f MB, against %.2f MB re-uploading every place; merge %.1f ms in all, "
+          "%.1f s with the server",
+          NSStringFromSelector(_cmd), phone.numOps(), phone.numLivePlaces(), stats.numSyncs,
+          stats.bytesSent / 1e6, (double)stats.bytesSent / stats.opsSent, stats.bytesReceived / 1e6,
+          fullUploadBytes / 1e6, stats.mergeTime * 1e3, elapsed);
+    NSLog(@"[%@] server keeps %.2f MB (%.1f bytes/change)",
+          NSStringFromSelector(_cmd), server.byteSize() / 1e6, (double)server.byteSize() / phone.numOps());
+
+    rtc::PlaceReplica *phonePtr = &phone;
+    rtc::FileSyncServer *serverPtr = &server;
+    [self measureBlock:^{
+        rtc::ManualClock clock(kStartTime);
+        rtc::PlaceReplica laptop(0x1a7709, clock);
+        rtc::PlaceSyncStats catchUp;
+        rtc::syncReplica(laptop, *serverPtr, &catchUp);
+        XCTAssertEqual(laptop.numOps(), phonePtr->numOps());
+        NSLog(@"[%@] new device: %.2f MB received, %zu changes merged in %.1f ms (%.2f M changes/s)",
+              NSStringFromSelector(_cmd), catchUp.bytesReceived / 1e6, catchUp.opsReceived,
+              catchUp.mergeTime * 1e3, catchUp.opsReceived / catchUp.mergeTime / 1e6);
+    }];
+
+    std::stringstream saved;
+    phone.write(saved);
+    NSLog(@"[%@] replica saved in %.2f MB", NSStringFromSelector(_cmd), saved.str().size() / 1e6);
+}
+
+@end
@@ -0,0 +1,341 @@
+//
+//  RTCPolylineTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 9/2/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include "RTCPolyline.h"
+#include "RTCTrail.h"
+
+// number of walking routes in the benchmark and their length range (meters)
+static const NSUInteger kNumBenchmarkRoutes = 2000;
+static const double kBenchmarkMinRouteLength = 300.0;
+static const double kBenchmarkMaxRouteLength = 5000.0;
+
+// number of recorded trails in the benchmark, and how long each walk is
+static const NSUInteger kNumBenchmarkTrails = 20;
+static const double kBenchmarkTrailHours = 3.0;
+
+// times each set is decoded for timing
+static const NSUInteger kBenchmarkPasses = 20;
+
+// meters per degree of latitude, near enough for building test lines
+static const double kMetersPerDegree = rtc::kEarthRadius * rtc::kDegreesToRadians;
+
+// bytes a point takes in an MKPolyline (an MKMapPoint)
+static const double kMapPointSize = 16.0;
+
+@interface RTCPolylineTests : XCTestCase
+
+@end
+
+@implementation RTCPolylineTests
+
+#pragma mark - Helpers
+/**
+ * A walking route like MapKit's: vertices 5 to 30m apart along streets that
+ * mostly run straight, bend a little and turn at corners
+ */
+static std::vector<rtc::GeoPoint> walkingRoute(std::mt19937 &generator, double length)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    double latitude = 37.30 + 0.1 * unit(generator), longitude = -122.00 + 0.1 * unit(generator);
+    double metersPerDegreeLongitude = kMetersPerDegree * std::cos(latitude * rtc::kDegreesToRadians);
+    double heading = M_PI_2 * std::floor(4.0 * unit(generator));
+
+    std::vector<rtc::GeoPoint> route(1, rtc::GeoPoint(latitude, longitude));
+    for (double walked = 0; walked < length; ) {
+        if (unit(generator) < 0.08) heading += (unit(generator) < 0.5 ? -1.0 : 1.0) * M_PI_2;
+        heading += 0.1 * (unit(generator) - 0.5);
+        double step = 5.0 + 25.0 * unit(generator);
+        latitude += step * std::cos(heading) / kMetersPerDegree;
+        longitude += step * std::sin(heading) / metersPerDegreeLongitude;
+        route.push_back(rtc::GeoPoint(latitude, longitude));
+        walked += step;
+    }
+    return route;
+}
+
+/**
+ * The trail recorded on a walk at about 1.4m/s with one fix a second, as
+ * RTCTrailTests walks it
+ */
+static std::vector<rtc::GeoPoint> recordedTrail(std::mt19937 &generator, double hours)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> noise(0.0, 3.0);
+    double latitude = 37.3259, longitude = -121.9455;
+    double metersPerDegreeLongitude = kMetersPerDegree * std::cos(latitude * rtc::kDegreesToRadians);
+    double heading = 2.0 * M_PI * unit(generator);
+
+    rtc::TrailSimplifier simplifier;
+    rtc::Trail trail;
+    for (size_t t = 0; t < (size_t)(hours * 3600.0); ++t) {
+        heading += 0.05 * (unit(generator) - 0.5);
+        if (unit(generator) < 0.005) heading += (unit(generator) < 0.5 ? -1.0 : 1.0) * M_PI_2;
+        double speed = 1.2 + 0.4 * unit(generator);
+        latitude += speed * std::cos(heading) / kMetersPerDegree;
+        longitude += speed * std::sin(heading) / metersPerDegreeLongitude;
+        simplifier.addFix(rtc::LocationFix(t, latitude + noise(generator) / kMetersPerDegree,
+                                           longitude + noise(generator) / metersPerDegreeLongitude,
+                                           5.0 + 10.0 * unit(generator)), trail);
+    }
+    simplifier.finish(trail);
+
+    std::vector<rtc::GeoPoint> points;
+    for (size_t i = 0; i < trail.size(); ++i) points.push_back(trail[i].coordinate);
+    return points;
+}
+
+/**
+ * Points from PolylineReader, which must agree with decodePolyline()
+ */
+static bool readPolyline(const std::string &encoded, std::vector<rtc::GeoPoint> &points)
+{
+    points.clear();
+    rtc::PolylineReader reader(encoded.data(), encoded.size());
+    rtc::GeoPoint point;
+    while (reader.next(&point)) points.push_back(point);
+    return !reader.failed();
+}
+
+- (void)assertPoints:(const std::vector<rtc::GeoPoint> &)points
+          equalPoints:(const std::vector<rtc::GeoPoint> &)expected
+            accuracy:(double)accuracy
+{
+    XCTAssertEqual(points.size(), expected.size());
+    for (size_t i = 0; i < std::min(points.size(), expected.size()); ++i) {
+        XCTAssertEqualWithAccuracy(points[i].latitude, expected[i].latitude, accuracy, @"point %zu", i);
+        XCTAssertEqualWithAccuracy(points[i].longitude, expected[i].longitude, accuracy, @"point %zu", i);
+    }
+}
+
+
+#pragma mark - Google Format
+- (void)testGoogleReferenceExample
+{
+    // from Google's description of the format
+    std::vector<rtc::GeoPoint> points;
+    points.push_back(rtc::GeoPoint(38.5, -120.2));
+    points.push_back(rtc::GeoPoint(40.7, -120.95));
+    points.push_back(rtc::GeoPoint(43.252, -126.453));
+    std::string expected = "_p~iF~ps|U_ulLnnqC_mqNvxq`@";
+
+    XCTAssertEqual(rtc::encodeGooglePolyline(points), expected);
+
+    std::vector<rtc::GeoPoint> decoded;
+    XCTAssertTrue(rtc::decodeGooglePolyline(expected.data(), expected.size(), decoded));
+    [self assertPoints:decoded equalPoints:points accuracy:1e-9];
+}
+
+- (void)testGoogleRejectsGarbage
+{
+    std::vector<rtc::GeoPoint> decoded;
+    std::string truncated = "_p~iF~ps|U_ulLnnqC_mqNvxq";
+    XCTAssertFalse(rtc::decodeGooglePolyline(truncated.data(), truncated.size(), decoded));
+    XCTAssertTrue(decoded.empty());
+
+    std::string unprintable = "_p~iF\x01ps|U";
+    XCTAssertFalse(rtc::decodeGooglePolyline(unprintable.data(), unprintable.size(), decoded));
+
+    XCTAssertTrue(rtc::decodeGooglePolyline("", 0, decoded));
+    XCTAssertTrue(decoded.empty());
+}
+
+
+#pragma mark - Round Trips
+- (void)testRoundTripAtEachPrecision
+{
+    std::mt19937 generator(2014);
+    std::vector<rtc::GeoPoint> route = walkingRoute(generator, 3000.0);
+    // and the far corners of the map
+    route.push_back(rtc::GeoPoint(-90.0, -180.0));
+    route.push_back(rtc::GeoPoint(90.0, 180.0));
+    route.push_back(rtc::GeoPoint(-33.8688, 151.2093));
+
+    for (int precision = 0; precision <= rtc::kPolylineMaxPrecision; ++precision) {
+        double accuracy = 0.5 * std::pow(10.0, -precision) + 1e-12;
+        std::string encoded = rtc::encodePolyline(route, precision);
+
+        std::vector<rtc::GeoPoint> decoded;
+        int decodedPrecision = -1;
+        XCTAssertTrue(rtc::decodePolyline(encoded.data(), encoded.size(), decoded, &decodedPrecision));
+        XCTAssertEqual(decodedPrecision, precision);
+        [self assertPoints:decoded equalPoints:route accuracy:accuracy];
+
+        // the reader and the bulk decoder agree to the bit
+        std::vector<rtc::GeoPoint> read;
+        XCTAssertTrue(readPolyline(encoded, read));
+        XCTAssertEqual(read.size(), decoded.size());
+        for (size_t i = 0; i < std::min(read.size(), decoded.size()); ++i) {
+            XCTAssertEqual(read[i].latitude, decoded[i].latitude);
+            XCTAssertEqual(read[i].longitude, decoded[i].longitude);
+        }
+
+        // and so does Google's format at the same precision
+        std::string text = rtc::encodeGooglePolyline(route, precision);
+        std::vector<rtc::GeoPoint> fromText;
+        XCTAssertTrue(rtc::decodeGooglePolyline(text.data(), text.size(), fromText, precision));
+        [self assertPoints:fromText equalPoints:decoded accuracy:0.0];
+
+        // a decoded line encodes to the same bytes
+        XCTAssertEqual(rtc::encodePolyline(decoded, precision), encoded);
+    }
+}
+
+- (void)testLongVarintsDecode
+{
+    // deltas too big for real coordinates, so some varints are 9 or 10 bytes
+    //   and the bulk decoder has to fall back
+    std::vector<rtc::GeoPoint> points;
+    for (int i = 0; i < 40; ++i) {
+        double far = (i % 2) ? 4e9 : -4e9;
+        points.push_back(rtc::GeoPoint((i % 3) ? far : 1e-9 * i, (i % 5) ? -far : 1e-9 * i));
+    }
+    std::string encoded = rtc::encodePolyline(points, rtc::kPolylineMaxPrecision);
+
+    std::vector<rtc::GeoPoint> decoded, read;
+    XCTAssertTrue(rtc::decodePolyline(encoded.data(), encoded.size(), decoded));
+    XCTAssertTrue(readPolyline(encoded, read));
+    [self assertPoints:decoded equalPoints:points accuracy:1e-5];
+    [self assertPoints:read equalPoints:decoded accuracy:0.0];
+}
+
+- (void)testEmptyPolyline
+{
+    std::string encoded = rtc::encodePolyline(std::vector<rtc::GeoPoint>());
+    std::vector<rtc::GeoPoint> decoded(1);
+    XCTAssertTrue(rtc::decodePolyline(encoded.data(), encoded.size(), decoded));
+    XCTAssertTrue(decoded.empty());
+
+    rtc::PolylineReader reader(encoded.data(), encoded.size());
+    rtc::GeoPoint point;
+    XCTAssertEqual(reader.size(), (size_t)0);
+    XCTAssertFalse(reader.next(&point));
+    XCTAssertFalse(reader.failed());
+}
+
+- (void)testCorruptPolylinesFail
+{
+    std::mt19937 generator(7);
+    std::string encoded = rtc::encodePolyline(walkingRoute(generator, 500.0));
+    std::vector<rtc::GeoPoint> decoded;
+
+    // every truncation
+    for (size_t length = 0; length < encoded.size(); ++length) {
+        std::string truncated = encoded.substr(0, length);
+        XCTAssertFalse(rtc::decodePolyline(truncated.data(), truncated.size(), decoded), @"length %zu", length);
+        XCTAssertTrue(decoded.empty());
+        XCTAssertFalse(readPolyline(truncated, decoded), @"length %zu", length);
+    }
+
+    // bytes past the last point
+    std::string padded = encoded + '\0';
+    XCTAssertFalse(rtc::decodePolyline(padded.data(), padded.size(), decoded));
+    XCTAssertFalse(readPolyline(padded, decoded));
+
+    // unknown version and precision
+    std::string badVersion = encoded;
+    badVersion[0] = 9;
+    XCTAssertFalse(rtc::decodePolyline(badVersion.data(), badVersion.size(), decoded));
+    std::string badPrecision = encoded;
+    badPrecision[1] = rtc::kPolylineMaxPrecision + 1;
+    XCTAssertFalse(readPolyline(badPrecision, decoded));
+
+    // a varint that never ends
+    std::string endless = encoded.substr(0, 3) + std::string(encoded.size(), '\xff');
+    XCTAssertFalse(rtc::decodePolyline(endless.data(), endless.size(), decoded));
+    XCTAssertFalse(readPolyline(endless, decoded));
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Encode and decode walking routes and recorded trails and log bytes per
+ * point at a few precisions, compression against MKPolyline, and encode and
+ * decode throughput.
+ */
+- (void)testCodecPerformance
+{
+    std::mt19937 generator(2014);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    std::vector<std::vector<rtc::GeoPoint> > routes, trails;
+    for (NSUInteger i = 0; i < kNumBenchmarkRoutes; ++i) {
+        double length = kBenchmarkMinRouteLength + (kBenchmarkMaxRouteLength - kBenchmarkMinRouteLength) * unit(generator);
+        routes.push_back(walkingRoute(generator, length));
+    }
+    for (NSUInteger i = 0; i < kNumBenchmarkTrails; ++i) trails.push_back(recordedTrail(generator, kBenchmarkTrailHours));
+
+    const std::vector<std::vector<rtc::GeoPoint> > *sets[] = {&routes, &trails};
+    const char *setNames[] = {"routes", "trails"};
+    for (size_t s = 0; s < 2; ++s) {
+        const std::vector<std::vector<rtc::GeoPoint> > &lines = *sets[s];
+        size_t numPoints = 0;
+        for (size_t i = 0; i < lines.size(); ++i) numPoints += lines[i].size();
+
+        const int precisions[] = {rtc::kGooglePolylinePrecision, rtc::kPolylineDefaultPrecision, 7};
+        for (size_t p = 0; p < 3; ++p) {
+            std::vector<std::string> encoded(lines.size());
+            size_t numBytes = 0, numTextBytes = 0;
+            auto encodeStart = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < lines.size(); ++i) {
+                encoded[i] = rtc::encodePolyline(lines[i], precisions[p]);
+                numBytes += encoded[i].size();
+            }
+            auto encodeEnd = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < lines.size(); ++i) {
+                numTextBytes += rtc::encodeGooglePolyline(lines[i], precisions[p]).size();
+            }
+
+            std::vector<rtc::GeoPoint> decoded;
+            double checksum = 0;
+            auto readStart = std::chrono::steady_clock::now();
+            for (NSUInteger pass = 0; pass < kBenchmarkPasses; ++pass) {
+                for (size_t i = 0; i < lines.size(); ++i) {
+                    rtc::PolylineReader reader(encoded[i].data(), encoded[i].size());
+                    rtc::GeoPoint point;
+                    while (reader.next(&point)) checksum += point.latitude;
+                }
+            }
+            auto readEnd = std::chrono::steady_clock::now();
+            for (NSUInteger pass = 0; pass < kBenchmarkPasses; ++pass) {
+                for (size_t i = 0; i < lines.size(); ++i) {
+                    rtc::decodePolyline(encoded[i].data(), encoded[i].size(), decoded);
+                    checksum -= decoded.empty() ? 0 : decoded.back().latitude;
+                }
+            }
+            auto decodeEnd = std::chrono::steady_clock::now();
+
+            double decodedPoints = (double)numPoints * kBenchmarkPasses;
+            NSLog(@"[%@] %zu %s, %zu points, precision %d: %.2f bytes/point binary (%.1fx smaller than MKPolyline), "
+                  "%.2f text; encode %.0f M points/s, reader %.0f M points/s, bulk decode (%s) %.0f M points/s",
+                  NSStringFromSelector(_cmd), lines.size(), setNames[s], numPoints, precisions[p],
+                  (double)numBytes / numPoints, kMapPointSize * numPoints / numBytes, (double)numTextBytes / numPoints,
+                  numPoints / std::chrono::duration<double, std::micro>(encodeEnd - encodeStart).count(),
+                  decodedPoints / std::chrono::duration<double, std::micro>(readEnd - readStart).count(),
+                  rtc::polylineDecoderInstructionSet(),
+                  decodedPoints / std::chrono::duration<double, std::micro>(decodeEnd - readEnd).count());
+            XCTAssertNotEqual(checksum, 1.0);
+
+            XCTAssertLessThan((double)numBytes / numPoints, 8.0);
+        }
+    }
+
+    const std::vector<std::vector<rtc::GeoPoint> > *timed = &routes;
+    [self measureBlock:^{
+        std::vector<rtc::GeoPoint> decoded;
+        for (size_t i = 0; i < timed->size(); ++i) {
+            std::string encoded = rtc::encodePolyline((*timed)[i]);
+            rtc::decodePolyline(encoded.data(), encoded.size(), decoded);
+        }
+    }];
+}
+
+@end
@@ -0,0 +1,334 @@
+//
+//  RTCPositionFilterTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/28/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include "RTCPositionFilter.h"
+#include "RTCFixTraceReplay.h"
+
+// number of simulated walks in the benchmark, and how long each one is
+static const NSUInteger kNumBenchmarkWalks = 20;
+static const double kBenchmarkWalkHours = 1.0;
+
+// meters per degree of latitude, near enough for building test walks
+static const double kMetersPerDegree = rtc::kEarthRadius * rtc::kDegreesToRadians;
+
+static const double kStartLatitude = 37.3259;
+static const double kStartLongitude = -121.9455;
+
+@interface RTCPositionFilterTests : XCTestCase
+
+@end
+
+@implementation RTCPositionFilterTests
+
+#pragma mark - Helpers
+/**
+ * Load a recorded trace that was copied into the test bundle
+ */
+- (rtc::FixTrace)traceNamed:(NSString *)name
+{
+    NSString *path = [[NSBundle bundleForClass:[self class]] pathForResource:name ofType:@"csv"];
+    XCTAssertNotNil(path, @"missing trace %@", name);
+
+    rtc::FixTrace trace;
+    std::ifstream input([path fileSystemRepresentation]);
+    std::string error;
+    XCTAssertTrue(rtc::parseFixTrace(input, trace, &error), @"%s", error.c_str());
+    return trace;
+}
+
+/**
+ * Fix (east, north) meters from the start
+ */
+static rtc::LocationFix fixAt(double t, double east, double north, double accuracy)
+{
+    double metersPerDegreeLongitude = kMetersPerDegree * std::cos(kStartLatitude * rtc::kDegreesToRadians);
+    return rtc::LocationFix(t, kStartLatitude + north / kMetersPerDegree,
+                            kStartLongitude + east / metersPerDegreeLongitude, accuracy);
+}
+
+static double distanceFromStart(const rtc::GeoPoint &point, double east, double north)
+{
+    rtc::LocationFix start = fixAt(0, east, north, 0);
+    return rtc::distanceBetween(rtc::GeoPoint(start.latitude, start.longitude), point);
+}
+
+/**
+ * A walk at about 1.4m/s with one fix a second, wandering heading, the odd
+ * sharp turn and a pause now and then. Fixes carry GPS-like noise that
+ * matches their accuracy, and now and then a multipath jump that doesn't.
+ *
+ * @param truth     where the walker really was at each fix
+ */
+static std::vector<rtc::LocationFix> simulatedWalk(std::mt19937 &generator, double hours,
+                                                   std::vector<rtc::GeoPoint> &truth)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::vector<rtc::LocationFix> fixes;
+
+    double latitude = kStartLatitude, longitude = kStartLongitude;
+    double heading = 2.0 * M_PI * unit(generator);
+    double metersPerDegreeLongitude = kMetersPerDegree * std::cos(latitude * rtc::kDegreesToRadians);
+    size_t numFixes = (size_t)(hours * 3600.0);
+    size_t pausedUntil = 0;
+
+    for (size_t t = 0; t < numFixes; ++t) {
+        if (t >= pausedUntil) {
+            if (unit(generator) < 0.002) pausedUntil = t + 30 + (size_t)(120 * unit(generator));
+            heading += 0.05 * (unit(generator) - 0.5);
+            if (unit(generator) < 0.005) heading += (unit(generator) < 0.5 ? -1.0 : 1.0) * M_PI_2;
+
+            double speed = 1.2 + 0.4 * unit(generator);
+            latitude += speed * std::cos(heading) / kMetersPerDegree;
+            longitude += speed * std::sin(heading) / metersPerDegreeLongitude;
+        }
+        truth.push_back(rtc::GeoPoint(latitude, longitude));
+
+        // reported accuracy is about a 68% radius, so each axis is off by
+        //   about two thirds of it
+        double accuracy = 5.0 + 15.0 * unit(generator);
+        double deviation = accuracy / 1.5;
+        double north = deviation * normal(generator), east = deviation * normal(generator);
+        if (unit(generator) < 0.01) {
+            double bearing = 2.0 * M_PI * unit(generator);
+            double jump = 60.0 + 90.0 * unit(generator);
+            north += jump * std::cos(bearing);
+            east += jump * std::sin(bearing);
+        }
+        fixes.push_back(rtc::LocationFix(t, latitude + north / kMetersPerDegree,
+                                         longitude + east / metersPerDegreeLongitude, accuracy));
+    }
+    return fixes;
+}
+
+static double percentile(std::vector<double> values, double fraction)
+{
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(fraction * values.size()))];
+}
+
+
+#pragma mark - Filter
+- (void)testFirstFixStartsFilter
+{
+    rtc::PositionFilter filter;
+    XCTAssertFalse(filter.hasEstimate());
+
+    XCTAssertTrue(filter.addFix(fixAt(10, 0, 0, 20)));
+    XCTAssertTrue(filter.hasEstimate());
+    const rtc::PositionEstimate &estimate = filter.estimate();
+    XCTAssertEqualWithAccuracy(estimate.coordinate.latitude, kStartLatitude, 1e-9);
+    XCTAssertEqualWithAccuracy(estimate.coordinate.longitude, kStartLongitude, 1e-9);
+    XCTAssertEqualWithAccuracy(estimate.horizontalAccuracy, 20.0, 1e-9);
+    XCTAssertEqual(estimate.speed(), 0.0);
+    XCTAssertEqual(estimate.timestamp, 10.0);
+}
+
+- (void)testDropsUnusableFixes
+{
+    rtc::PositionFilter filter;
+    XCTAssertFalse(filter.addFix(fixAt(0, 0, 0, -1)));
+    XCTAssertFalse(filter.addFix(fixAt(0, 0, 0, 500)));
+    XCTAssertFalse(filter.hasEstimate());
+
+    XCTAssertTrue(filter.addFix(fixAt(10, 0, 0, 10)));
+    XCTAssertFalse(filter.addFix(fixAt(9, 5, 0, 10)), @"older than the estimate");
+    XCTAssertEqual(filter.numFixesReceived(), (size_t)4);
+    XCTAssertEqual(filter.numFixesUsed(), (size_t)1);
+}
+
+- (void)testStandingStillAveragesNoise
+{
+    std::mt19937 generator(7);
+    std::normal_distribution<double> noise(0.0, 10.0);
+
+    rtc::PositionFilter filter;
+    for (int t = 0; t < 60; ++t) filter.addFix(fixAt(t, noise(generator), noise(generator), 15));
+
+    // fixes scatter about 12m; the estimate stays well inside that
+    const rtc::PositionEstimate &estimate = filter.estimate();
+    XCTAssertLessThan(distanceFromStart(estimate.coordinate, 0, 0), 10.0);
+    XCTAssertLessThan(estimate.horizontalAccuracy, 10.0);
+    XCTAssertLessThan(estimate.speed(), 0.5);
+}
+
+- (void)testTracksSteadyWalk
+{
+    std::mt19937 generator(11);
+    std::normal_distribution<double> noise(0.0, 5.0);
+
+    // east at 1.4m/s
+    rtc::PositionFilter filter;
+    for (int t = 0; t <= 60; ++t) filter.addFix(fixAt(t, 1.4 * t + noise(generator), noise(generator), 8));
+
+    const rtc::PositionEstimate &estimate = filter.estimate();
+    XCTAssertLessThan(distanceFromStart(estimate.coordinate, 1.4 * 60, 0), 5.0);
+    XCTAssertEqualWithAccuracy(estimate.speed(), 1.4, 0.3);
+    XCTAssertEqualWithAccuracy(estimate.course(), 90.0, 15.0);
+}
+
+- (void)testRejectsOutliersButFollowsRealJumps
+{
+    rtc::PositionFilter filter;
+    for (int t = 0; t < 10; ++t) filter.addFix(fixAt(t, 0, 0, 10));
+
+    // one wild fix is ignored...
+    XCTAssertFalse(filter.addFix(fixAt(10, 200, 0, 10)));
+    XCTAssertEqual(filter.numOutliers(), (size_t)1);
+    XCTAssertTrue(filter.addFix(fixAt(11, 0, 0, 10)));
+    XCTAssertLessThan(distanceFromStart(filter.estimate().coordinate, 0, 0), 1.0);
+
+    // ...but a run of them is where the user really is
+    unsigned maxOutliers = filter.policy().maxOutliers;
+    for (unsigned i = 1; i < maxOutliers; ++i) XCTAssertFalse(filter.addFix(fixAt(11 + i, 300, 0, 10)));
+    XCTAssertTrue(filter.addFix(fixAt(11 + maxOutliers, 300, 0, 10)));
+    XCTAssertLessThan(distanceFromStart(filter.estimate().coordinate, 300, 0), 1.0);
+}
+
+- (void)testRestartsAfterGap
+{
+    rtc::PositionFilter filter;
+    for (int t = 0; t < 10; ++t) filter.addFix(fixAt(t, 0, 0, 10));
+
+    double t = 9 + filter.policy().maxGap + 1;
+    XCTAssertTrue(filter.addFix(fixAt(t, 1000, 0, 30)));
+    XCTAssertLessThan(distanceFromStart(filter.estimate().coordinate, 1000, 0), 1e-3);
+    XCTAssertEqualWithAccuracy(filter.estimate().horizontalAccuracy, 30.0, 1e-9);
+}
+
+- (void)testReroutesOnlyOnRealMovement
+{
+    std::mt19937 generator(3);
+    std::normal_distribution<double> noise(0.0, 12.0);
+
+    rtc::PositionFilter filter;
+    filter.addFix(fixAt(0, 0, 0, 15));
+    rtc::GeoPoint routeStart = filter.estimate().coordinate;
+    double routeStartAccuracy = filter.estimate().horizontalAccuracy;
+
+    // two minutes of noise standing still
+    for (int t = 1; t < 120; ++t) {
+        filter.addFix(fixAt(t, noise(generator), noise(generator), 15));
+        XCTAssertFalse(filter.movedSignificantly(routeStart, routeStartAccuracy), @"rerouted at t=%d", t);
+    }
+
+    // then walking off north
+    int t = 120;
+    while (!filter.movedSignificantly(routeStart, routeStartAccuracy) && (t < 240)) {
+        filter.addFix(fixAt(t, noise(generator), 1.4 * (t - 120) + noise(generator), 15));
+        ++t;
+    }
+    XCTAssertLessThan(t, 180, @"took too long to notice walking off");
+
+    XCTAssertTrue(rtc::PositionFilter().movedSignificantly(routeStart, 10), @"no estimate means go ahead");
+}
+
+- (void)testRecordedTrace
+{
+    // walking out of a parking garage: fixes start off miles out and settle
+    rtc::FixTrace trace = [self traceNamed:@"Parking Garage Exit"];
+    XCTAssertGreaterThan(trace.size(), (size_t)0);
+
+    rtc::PositionFilter filter;
+    for (size_t i = 0; i < trace.size(); ++i) filter.addFix(trace[i].fix);
+
+    XCTAssertTrue(filter.hasEstimate());
+    const rtc::LocationFix &last = trace.back().fix;
+    double error = rtc::distanceBetween(rtc::GeoPoint(last.latitude, last.longitude), filter.estimate().coordinate);
+    XCTAssertLessThan(error, 10.0);
+    XCTAssertLessThan(filter.estimate().horizontalAccuracy, 10.0);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Hour long walks: position error of raw fixes against the filter's, how
+ * often each would have asked for a new route (25m of movement) against
+ * how often the walker really moved that far, and time per fix.
+ */
+- (void)testSmoothingPerformance
+{
+    std::mt19937 generator(42);
+    std::vector<std::vector<rtc::LocationFix> > walks;
+    std::vector<std::vector<rtc::GeoPoint> > truths(kNumBenchmarkWalks);
+    size_t numFixes = 0;
+    for (NSUInteger i = 0; i < kNumBenchmarkWalks; ++i) {
+        walks.push_back(simulatedWalk(generator, kBenchmarkWalkHours, truths[i]));
+        numFixes += walks.back().size();
+    }
+
+    rtc::PositionFilterPolicy policy;
+    std::vector<double> rawErrors, filteredErrors;
+    size_t rawReroutes = 0, filteredReroutes = 0, trueReroutes = 0;
+    double filterTime = 0;
+    for (size_t w = 0; w < walks.size(); ++w) {
+        const std::vector<rtc::LocationFix> &fixes = walks[w];
+        const std::vector<rtc::GeoPoint> &truth = truths[w];
+
+        rtc::PositionFilter filter(policy);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<rtc::GeoPoint> estimates;
+        std::vector<double> accuracies;
+        for (size_t i = 0; i < fixes.size(); ++i) {
+            filter.addFix(fixes[i]);
+            estimates.push_back(filter.estimate().coordinate);
+            accuracies.push_back(filter.estimate().horizontalAccuracy);
+        }
+        filterTime += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        rtc::GeoPoint rawRouteStart(fixes[0].latitude, fixes[0].longitude);
+        rtc::GeoPoint trueRouteStart = truth[0];
+        rtc::GeoPoint filteredRouteStart = estimates[0];
+        double filteredRouteStartAccuracy = accuracies[0];
+        rtc::PositionFilter replay(policy);
+        for (size_t i = 0; i < fixes.size(); ++i) {
+            rtc::GeoPoint raw(fixes[i].latitude, fixes[i].longitude);
+            rawErrors.push_back(rtc::distanceBetween(raw, truth[i]));
+            filteredErrors.push_back(rtc::distanceBetween(estimates[i], truth[i]));
+
+            if (rtc::distanceBetween(rawRouteStart, raw) > policy.rerouteDistance) {
+                rawRouteStart = raw;
+                ++rawReroutes;
+            }
+            if (rtc::distanceBetween(trueRouteStart, truth[i]) > policy.rerouteDistance) {
+                trueRouteStart = truth[i];
+                ++trueReroutes;
+            }
+            replay.addFix(fixes[i]);
+            if (replay.movedSignificantly(filteredRouteStart, filteredRouteStartAccuracy)) {
+                filteredRouteStart = replay.estimate().coordinate;
+                filteredRouteStartAccuracy = replay.estimate().horizontalAccuracy;
+                ++filteredReroutes;
+            }
+        }
+    }
+
+    double rawP50 = percentile(rawErrors, 0.5), rawP95 = percentile(rawErrors, 0.95);
+    double filteredP50 = percentile(filteredErrors, 0.5), filteredP95 = percentile(filteredErrors, 0.95);
+    NSLog(@"[%@] %lu fixes: error p50/p95 raw %.1f/%.1fm, filtered %.1f/%.1fm; reroutes raw %lu, filtered %lu, walked %lu; %.0fns per fix",
+          NSStringFromSelector(_cmd), (unsigned long)numFixes, rawP50, rawP95, filteredP50, filteredP95,
+          (unsigned long)rawReroutes, (unsigned long)filteredReroutes, (unsigned long)trueReroutes, filterTime / numFixes);
+    XCTAssertLessThan(filteredP50, rawP50);
+    XCTAssertLessThan(filteredP95, rawP95);
+    XCTAssertLessThan(filteredReroutes, rawReroutes);
+
+    const std::vector<rtc::LocationFix> *fixesPointer = &walks[0];
+    [self measureBlock:^{
+        rtc::PositionFilter filter;
+        for (size_t i = 0; i < fixesPointer->size(); ++i) filter.addFix((*fixesPointer)[i]);
+        XCTAssertTrue(filter.hasEstimate());
+    }];
+}
+
+@end
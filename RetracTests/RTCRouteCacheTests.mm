@@ -0,0 +1,260 @@
+//
+//  RTCRouteCacheTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/14/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include "RTCRouteReplay.h"
+
+// size of the synthetic request trace in the benchmark
+static const NSUInteger kNumBenchmarkDestinations = 12;
+static const NSUInteger kNumBenchmarkSessions = 400;
+
+// seconds MKDirections typically takes to answer on a phone
+static const double kProviderLatency = 0.8;
+
+// meters per degree of latitude, near enough for building test routes
+static const double kMetersPerDegree = rtc::kEarthRadius * rtc::kDegreesToRadians;
+
+@interface RTCRouteCacheTests : XCTestCase
+
+@end
+
+@implementation RTCRouteCacheTests
+
+#pragma mark - Helpers
+/**
+ * Point offset (meters north, meters east) from an origin
+ */
+static rtc::GeoPoint offsetPoint(const rtc::GeoPoint &origin, double north, double east)
+{
+    double metersPerDegreeLongitude = kMetersPerDegree * std::cos(origin.latitude * rtc::kDegreesToRadians);
+    return rtc::GeoPoint(origin.latitude + north / kMetersPerDegree,
+                         origin.longitude + east / metersPerDegreeLongitude);
+}
+
+/**
+ * Requests a user makes over a few weeks: open directions to a saved place
+ * from one of a handful of usual spots, then walk there with the route
+ * re-requested on every location update (about every 15s) and now and then
+ * the screen re-appearing.
+ */
+static rtc::RouteRequestTrace syntheticRequests(std::mt19937 &generator, size_t numDestinations, size_t numSessions)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    rtc::GeoPoint home(37.3259, -121.9455);
+
+    std::vector<rtc::GeoPoint> destinations, starts;
+    for (size_t i = 0; i < numDestinations; ++i) {
+        destinations.push_back(offsetPoint(home, 2000.0 * (unit(generator) - 0.5), 2000.0 * (unit(generator) - 0.5)));
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        starts.push_back(offsetPoint(home, 1000.0 * (unit(generator) - 0.5), 1000.0 * (unit(generator) - 0.5)));
+    }
+
+    rtc::GridDirectionsProvider provider;
+    rtc::RouteRequestTrace trace;
+    double t = 0;
+    for (size_t s = 0; s < numSessions; ++s) {
+        t += 3600.0 * (1.0 + 3.0 * unit(generator));
+        rtc::GeoPoint destination = destinations[(size_t)(unit(generator) * unit(generator) * numDestinations)];
+        rtc::GeoPoint origin = offsetPoint(starts[(size_t)(unit(generator) * starts.size())],
+                                           5.0 * (unit(generator) - 0.5), 5.0 * (unit(generator) - 0.5));
+
+        // the path actually walked
+        rtc::Route walk;
+        provider.walkingRoute(origin, destination, walk);
+        double walked = 0, elapsed = 0;
+        trace.push_back(rtc::RouteRequest(t, origin, destination));
+        for (size_t i = 1; i < walk.polyline.size(); ++i) {
+            double length = rtc::distanceBetween(walk.polyline[i - 1], walk.polyline[i]);
+            walked += length;
+            elapsed += length / 1.4;
+            if (elapsed < 15.0) continue;
+
+            rtc::GeoPoint here = offsetPoint(walk.polyline[i], 4.0 * (unit(generator) - 0.5), 4.0 * (unit(generator) - 0.5));
+            trace.push_back(rtc::RouteRequest(t + walked / 1.4, here, destination));
+            if (unit(generator) < 0.1) trace.push_back(rtc::RouteRequest(t + walked / 1.4 + 1.0, here, destination));
+            elapsed = 0;
+        }
+        t += walked / 1.4;
+    }
+    return trace;
+}
+
+
+#pragma mark - Lookup
+- (void)testExactHitWithinCells
+{
+    rtc::ManualClock clock(0.0);
+    rtc::RouteCache cache(clock);
+    rtc::GridDirectionsProvider provider;
+
+    rtc::GeoPoint origin(37.3259, -121.9455);
+    rtc::GeoPoint destination = offsetPoint(origin, 300.0, 200.0);
+    rtc::Route route;
+    XCTAssertTrue(provider.walkingRoute(origin, destination, route));
+
+    XCTAssertEqual(cache.lookup(origin, destination).kind, rtc::RouteCache::MatchNone);
+    cache.store(origin, destination, route);
+
+    clock.advance(60.0);
+    rtc::RouteCache::Match match = cache.lookup(origin, destination);
+    XCTAssertEqual(match.kind, rtc::RouteCache::MatchExact);
+    XCTAssertFalse(match.stale);
+    XCTAssertEqual(match.age, 60.0);
+    XCTAssertEqual(match.route.polyline.size(), route.polyline.size());
+    XCTAssertEqual(match.route.distance, route.distance);
+
+    // a different destination never matches
+    XCTAssertEqual(cache.lookup(origin, offsetPoint(destination, 100.0, 0)).kind, rtc::RouteCache::MatchNone);
+
+    // old routes are still served, but flagged for refresh
+    clock.advance(cache.policy().maxAge);
+    XCTAssertTrue(cache.lookup(origin, destination).stale);
+}
+
+- (void)testPartialHitAlongRoute
+{
+    rtc::ManualClock clock(0.0);
+    rtc::RouteCache cache(clock);
+    rtc::GridDirectionsProvider provider;
+
+    rtc::GeoPoint origin(37.3259, -121.9455);
+    rtc::GeoPoint destination = offsetPoint(origin, 300.0, 200.0);
+    rtc::Route route;
+    provider.walkingRoute(origin, destination, route);
+    cache.store(origin, destination, route);
+
+    // 100m up the first leg, a few meters off it
+    rtc::GeoPoint along = offsetPoint(origin, 100.0, 5.0);
+    rtc::RouteCache::Match match = cache.lookup(along, destination);
+    XCTAssertEqual(match.kind, rtc::RouteCache::MatchPartial);
+    XCTAssertEqualWithAccuracy(match.route.distance, route.distance - 100.0, 1.0);
+    XCTAssertEqualWithAccuracy(match.route.expectedTravelTime, route.expectedTravelTime * match.route.distance / route.distance, 1e-6);
+    XCTAssertEqual(match.route.steps.size(), route.steps.size());
+    XCTAssertEqual(match.route.steps[0].firstPoint, (uint32_t)0);
+    XCTAssertEqualWithAccuracy(match.route.steps[0].distance, 200.0, 1.0);
+
+    // onto the second leg, the first step is gone
+    match = cache.lookup(offsetPoint(origin, 300.0, 50.0), destination);
+    XCTAssertEqual(match.kind, rtc::RouteCache::MatchPartial);
+    XCTAssertEqual(match.route.steps.size(), route.steps.size() - 1);
+    XCTAssertEqualWithAccuracy(match.route.steps[0].distance, 150.0, 1.0);
+
+    // too far off the route to reuse it
+    XCTAssertEqual(cache.lookup(offsetPoint(origin, 100.0, 100.0), destination).kind, rtc::RouteCache::MatchNone);
+}
+
+- (void)testLeastRecentlyUsedEvicted
+{
+    rtc::ManualClock clock(0.0);
+    rtc::RouteCachePolicy policy;
+    policy.maxEntries = 2;
+    rtc::RouteCache cache(clock, policy);
+    rtc::GridDirectionsProvider provider;
+
+    rtc::GeoPoint origin(37.3259, -121.9455);
+    rtc::GeoPoint destinations[] = {offsetPoint(origin, 500, 0), offsetPoint(origin, 0, 500), offsetPoint(origin, -500, 0)};
+    rtc::Route route;
+    for (size_t i = 0; i < 2; ++i) {
+        provider.walkingRoute(origin, destinations[i], route);
+        cache.store(origin, destinations[i], route);
+    }
+
+    // touch the first so the second is the oldest
+    cache.lookup(origin, destinations[0]);
+    provider.walkingRoute(origin, destinations[2], route);
+    cache.store(origin, destinations[2], route);
+
+    XCTAssertEqual(cache.size(), (size_t)2);
+    XCTAssertEqual(cache.lookup(origin, destinations[0]).kind, rtc::RouteCache::MatchExact);
+    XCTAssertEqual(cache.lookup(origin, destinations[1]).kind, rtc::RouteCache::MatchNone);
+    XCTAssertEqual(cache.lookup(origin, destinations[2]).kind, rtc::RouteCache::MatchExact);
+}
+
+
+#pragma mark - Storage
+- (void)testCacheFileRoundTrip
+{
+    rtc::ManualClock clock(1000.0);
+    rtc::RouteCache cache(clock);
+    rtc::GridDirectionsProvider provider;
+
+    rtc::GeoPoint origin(-33.8688, 151.2093);
+    rtc::GeoPoint destination = offsetPoint(origin, -400.0, 250.0);
+    rtc::Route route;
+    provider.walkingRoute(origin, destination, route);
+    cache.store(origin, destination, route);
+
+    std::stringstream file;
+    cache.write(file);
+
+    rtc::RouteCache loaded(clock);
+    XCTAssertTrue(loaded.read(file));
+    XCTAssertEqual(loaded.size(), (size_t)1);
+
+    rtc::RouteCache::Match match = loaded.lookup(origin, destination);
+    XCTAssertEqual(match.kind, rtc::RouteCache::MatchExact);
+    XCTAssertEqual(match.age, 0.0);
+    XCTAssertEqualWithAccuracy(match.route.distance, route.distance, 0.01);
+    XCTAssertEqualWithAccuracy(match.route.expectedTravelTime, route.expectedTravelTime, 0.01);
+    XCTAssertEqual(match.route.polyline.size(), route.polyline.size());
+    for (size_t i = 0; i < std::min(match.route.polyline.size(), route.polyline.size()); ++i) {
+        XCTAssertEqualWithAccuracy(match.route.polyline[i].latitude, route.polyline[i].latitude, 1e-7);
+        XCTAssertEqualWithAccuracy(match.route.polyline[i].longitude, route.polyline[i].longitude, 1e-7);
+    }
+    XCTAssertEqual(match.route.steps.size(), route.steps.size());
+    for (size_t i = 0; i < std::min(match.route.steps.size(), route.steps.size()); ++i) {
+        XCTAssertEqual(match.route.steps[i].instructions, route.steps[i].instructions);
+        XCTAssertEqual(match.route.steps[i].firstPoint, route.steps[i].firstPoint);
+    }
+
+    std::istringstream garbage("not a route cache");
+    XCTAssertFalse(loaded.read(garbage));
+    XCTAssertEqual(loaded.size(), (size_t)1);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Replay a few weeks of synthetic directions requests with and without the
+ * cache and log hit rate and how long the screen waits for a route.
+ */
+- (void)testReplaySyntheticRequestsPerformance
+{
+    std::mt19937 generator(2014);
+    rtc::RouteRequestTrace trace = syntheticRequests(generator, kNumBenchmarkDestinations, kNumBenchmarkSessions);
+
+    rtc::RouteCachePolicy uncachedPolicy;
+    uncachedPolicy.maxEntries = 0;
+    rtc::GridDirectionsProvider uncachedProvider;
+    rtc::RouteReplaySummary uncached = rtc::replayRouteRequests(trace, uncachedProvider, kProviderLatency, uncachedPolicy);
+
+    rtc::GridDirectionsProvider cachedProvider;
+    rtc::RouteReplaySummary cached = rtc::replayRouteRequests(trace, cachedProvider, kProviderLatency);
+
+    NSLog(@"[%@] %u requests: no cache %u provider calls, mean latency %.2fs; "
+          "cache %u exact + %u partial hits (%.1f%%, %u stale), %u provider calls, mean latency %.2fs, p90 %.2fs",
+          NSStringFromSelector(_cmd), cached.numRequests, uncached.numProviderCalls, uncached.meanLatency,
+          cached.numExactHits, cached.numPartialHits, 100.0 * cached.hitRate(), cached.numStaleHits,
+          cached.numProviderCalls, cached.meanLatency, cached.p90Latency);
+
+    [self measureBlock:^{
+        rtc::GridDirectionsProvider provider;
+        rtc::replayRouteRequests(trace, provider, kProviderLatency);
+    }];
+
+    XCTAssertEqual(uncached.numMisses, uncached.numRequests);
+    XCTAssertGreaterThan(cached.hitRate(), 0.8);
+    XCTAssertLessThan(cached.numProviderCalls, uncached.numProviderCalls / 4);
+    XCTAssertLessThan(cached.meanLatency, uncached.meanLatency / 4);
+}
+
+@end
@@ -0,0 +1,303 @@
+//
+//  RTCRouteProgressTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/29/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include "RTCRouteProgress.h"
+
+// vertices of the synthetic routes in the benchmark
+static const size_t kBenchmarkRouteSizes[] = {10000, 100000};
+
+// meters per degree of latitude, near enough for building test routes
+static const double kMetersPerDegree = rtc::kEarthRadius * rtc::kDegreesToRadians;
+
+static const rtc::GeoPoint kStart(37.3259, -121.9455);
+
+@interface RTCRouteProgressTests : XCTestCase
+
+@end
+
+@implementation RTCRouteProgressTests
+
+#pragma mark - Helpers
+/**
+ * Point offset (meters east, meters north) from the start
+ */
+static rtc::GeoPoint offsetPoint(double east, double north)
+{
+    double metersPerDegreeLongitude = kMetersPerDegree * std::cos(kStart.latitude * rtc::kDegreesToRadians);
+    return rtc::GeoPoint(kStart.latitude + north / kMetersPerDegree,
+                         kStart.longitude + east / metersPerDegreeLongitude);
+}
+
+static rtc::LocationFix fixAt(double t, double east, double north, double accuracy = 5.0)
+{
+    rtc::GeoPoint point = offsetPoint(east, north);
+    return rtc::LocationFix(t, point.latitude, point.longitude, accuracy);
+}
+
+/**
+ * Route through points given in meters (east, north), a step starting at
+ * each of stepStarts, at 1.4m/s
+ */
+static rtc::Route routeThrough(const std::vector<std::pair<double, double> > &points, const std::vector<uint32_t> &stepStarts)
+{
+    rtc::Route route;
+    for (size_t i = 0; i < points.size(); ++i) {
+        route.polyline.push_back(offsetPoint(points[i].first, points[i].second));
+        if (i) route.distance += rtc::distanceBetween(route.polyline[i - 1], route.polyline[i]);
+    }
+    for (size_t s = 0; s < stepStarts.size(); ++s) route.steps.push_back(rtc::RouteStep("step", 0, stepStarts[s]));
+    route.expectedTravelTime = route.distance / 1.4;
+    return route;
+}
+
+/**
+ * A route wandering through a city: vertices every 5 to 30m, turning now
+ * and then, a step every 40 vertices. Routes this long never come from
+ * MapKit, which is the point.
+ *
+ * @param points    the route's vertices in meters (east, north)
+ */
+static rtc::Route syntheticRoute(std::mt19937 &generator, size_t numVertices,
+                                 std::vector<std::pair<double, double> > &points)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<uint32_t> stepStarts;
+    double x = 0, y = 0, heading = 0;
+    for (size_t i = 0; i < numVertices; ++i) {
+        points.push_back(std::make_pair(x, y));
+        if (i % 40 == 0) stepStarts.push_back((uint32_t)i);
+
+        if (unit(generator) < 0.05) heading += (unit(generator) < 0.5 ? -1.0 : 1.0) * M_PI_2;
+        heading += 0.1 * (unit(generator) - 0.5);
+        double length = 5.0 + 25.0 * unit(generator);
+        x += length * std::sin(heading);
+        y += length * std::cos(heading);
+    }
+    return routeThrough(points, stepStarts);
+}
+
+/**
+ * Distance (meters) from (x, y) to the closest segment, testing every one
+ */
+static double scanDistance(const std::vector<std::pair<double, double> > &points, double x, double y, size_t *closest)
+{
+    double best = HUGE_VAL;
+    for (size_t i = 0; i + 1 < points.size(); ++i) {
+        double ax = points[i].first - x, ay = points[i].second - y;
+        double dx = points[i + 1].first - points[i].first, dy = points[i + 1].second - points[i].second;
+        double lengthSquared = dx * dx + dy * dy;
+        double t = (lengthSquared > 0) ? std::max(0.0, std::min(1.0, -(ax * dx + ay * dy) / lengthSquared)) : 0.0;
+        double distance = std::hypot(ax + t * dx, ay + t * dy);
+        if (distance < best) {
+            best = distance;
+            if (closest) *closest = i;
+        }
+    }
+    return best;
+}
+
+
+#pragma mark - Progress
+- (void)testProgressAlongRoute
+{
+    // 1km east, turning at 500m
+    std::vector<std::pair<double, double> > points;
+    for (int i = 0; i <= 10; ++i) points.push_back(std::make_pair(100.0 * i, 0.0));
+    std::vector<uint32_t> stepStarts;
+    stepStarts.push_back(0);
+    stepStarts.push_back(5);
+    rtc::Route route = routeThrough(points, stepStarts);
+
+    rtc::RouteTracker tracker;
+    tracker.setRoute(route);
+    XCTAssertEqual(tracker.numSegments(), (size_t)10);
+    XCTAssertFalse(tracker.progress().matched);
+
+    XCTAssertEqual(tracker.addFix(fixAt(0, 250, 5)), rtc::RouteTracker::EventNone);
+    const rtc::RouteProgress &progress = tracker.progress();
+    XCTAssertTrue(progress.matched);
+    XCTAssertEqualWithAccuracy(progress.distanceAlong, 250.0, 0.5);
+    XCTAssertEqualWithAccuracy(progress.distanceRemaining, 750.0, 0.5);
+    XCTAssertEqualWithAccuracy(progress.distanceFromRoute, 5.0, 0.1);
+    XCTAssertEqualWithAccuracy(progress.timeRemaining, route.expectedTravelTime * 0.75, 1.0);
+    XCTAssertEqual(progress.segmentIndex, (size_t)2);
+    XCTAssertEqual(progress.stepIndex, (size_t)0);
+    XCTAssertEqualWithAccuracy(rtc::distanceBetween(progress.snapped, offsetPoint(250, 0)), 0.0, 0.1);
+
+    tracker.addFix(fixAt(10, 600, -3));
+    XCTAssertEqual(tracker.progress().stepIndex, (size_t)1);
+    XCTAssertEqualWithAccuracy(tracker.progress().distanceRemaining, 400.0, 0.5);
+
+    // too far to tell keeps the last progress
+    tracker.addFix(fixAt(20, 600, 1000));
+    XCTAssertEqual(tracker.progress().distanceFromRoute, HUGE_VAL);
+    XCTAssertEqualWithAccuracy(tracker.progress().distanceAlong, 600.0, 0.5);
+}
+
+- (void)testOffRouteTakesHysteresis
+{
+    std::vector<std::pair<double, double> > points;
+    points.push_back(std::make_pair(0.0, 0.0));
+    points.push_back(std::make_pair(1000.0, 0.0));
+    rtc::RouteTracker tracker;
+    tracker.setRoute(routeThrough(points, std::vector<uint32_t>(1, 0)));
+    rtc::RouteProgressPolicy policy = tracker.policy();
+
+    // a stray fix or two is nothing
+    tracker.addFix(fixAt(0, 100, 0));
+    XCTAssertEqual(tracker.addFix(fixAt(1, 101, 60)), rtc::RouteTracker::EventNone);
+    XCTAssertEqual(tracker.addFix(fixAt(2, 102, 60)), rtc::RouteTracker::EventNone);
+    XCTAssertEqual(tracker.addFix(fixAt(3, 103, 0)), rtc::RouteTracker::EventNone);
+
+    // walking off: enough fixes, for long enough
+    double t = 4;
+    rtc::RouteTracker::Event event = rtc::RouteTracker::EventNone;
+    for (; t < 30 && (event == rtc::RouteTracker::EventNone); ++t) {
+        event = tracker.addFix(fixAt(t, 104, 10 + 10 * (t - 4)));
+    }
+    XCTAssertEqual(event, rtc::RouteTracker::EventOffRoute);
+    XCTAssertTrue(tracker.isOffRoute());
+    XCTAssertGreaterThanOrEqual(t - 1 - 4, policy.offRouteTime);
+
+    // a poor fix well off isn't enough on its own
+    XCTAssertEqual(tracker.addFix(fixAt(40, 104, 20)), rtc::RouteTracker::EventNone);
+    XCTAssertEqual(tracker.addFix(fixAt(41, 104, 5)), rtc::RouteTracker::EventBackOnRoute);
+    XCTAssertFalse(tracker.isOffRoute());
+
+    // inaccurate fixes get more room
+    for (double u = 50; u < 60; ++u) XCTAssertEqual(tracker.addFix(fixAt(u, 104, 60, 50)), rtc::RouteTracker::EventNone);
+}
+
+- (void)testOutAndBackKeepsDirection
+{
+    // 500m east then back along the other side of the street, walking on the
+    //   side of the road in between that the leg is on
+    std::vector<std::pair<double, double> > points;
+    for (int i = 0; i <= 50; ++i) points.push_back(std::make_pair(10.0 * i, 0.0));
+    for (int i = 50; i >= 0; --i) points.push_back(std::make_pair(10.0 * i, 8.0));
+    rtc::RouteTracker tracker;
+    tracker.setRoute(routeThrough(points, std::vector<uint32_t>(1, 0)));
+
+    double t = 0, lastAlong = -1;
+    for (double x = 0; x <= 500; x += 5, ++t) {
+        tracker.addFix(fixAt(t, x, 2));
+        XCTAssertGreaterThan(tracker.progress().distanceAlong, lastAlong);
+        lastAlong = tracker.progress().distanceAlong;
+    }
+    for (double x = 495; x >= 0; x -= 5, ++t) {
+        tracker.addFix(fixAt(t, x, 6));
+        XCTAssertGreaterThan(tracker.progress().distanceAlong, lastAlong, @"went back at x=%.0f", x);
+        lastAlong = tracker.progress().distanceAlong;
+    }
+    XCTAssertFalse(tracker.isOffRoute());
+}
+
+- (void)testIndexFindsClosestSegment
+{
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<std::pair<double, double> > points;
+    rtc::RouteTracker route;
+    route.setRoute(syntheticRoute(generator, 10000, points));
+
+    for (int i = 0; i < 200; ++i) {
+        size_t vertex = (size_t)(unit(generator) * (points.size() - 1));
+        double x = points[vertex].first + 160.0 * (unit(generator) - 0.5);
+        double y = points[vertex].second + 160.0 * (unit(generator) - 0.5);
+        double expected = scanDistance(points, x, y, NULL);
+
+        // a fresh tracker has no progress to weigh in
+        rtc::RouteTracker tracker = route;
+        tracker.addFix(fixAt(0, x, y));
+        if (expected > tracker.policy().searchRadius) {
+            XCTAssertFalse(tracker.progress().matched);
+        } else {
+            XCTAssertEqualWithAccuracy(tracker.progress().distanceFromRoute, expected, 0.5);
+        }
+        XCTAssertLessThan(tracker.lastSegmentsTested(), (size_t)200);
+    }
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Walk 10^4 and 10^5 vertex routes with 5m of noise per fix, taking a wrong
+ * turn now and then, and time each fix against a scan of every segment.
+ */
+- (void)testTrackingPerformance
+{
+    std::mt19937 generator(42);
+    std::normal_distribution<double> noise(0.0, 5.0);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    for (size_t r = 0; r < sizeof(kBenchmarkRouteSizes) / sizeof(kBenchmarkRouteSizes[0]); ++r) {
+        std::vector<std::pair<double, double> > points;
+        rtc::Route route = syntheticRoute(generator, kBenchmarkRouteSizes[r], points);
+
+        rtc::RouteTracker tracker;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        tracker.setRoute(route);
+        double buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // a fix per vertex, wandering 80m off the route for 20 fixes now and then
+        std::vector<double> latencies;
+        size_t numOffRoute = 0, numTested = 0, detourLeft = 0;
+        double scanTime = 0;
+        size_t numScanned = 0;
+        for (size_t i = 0; i < points.size(); ++i) {
+            if (!detourLeft && (unit(generator) < 0.001)) detourLeft = 20;
+            double offset = detourLeft ? 80.0 : 0.0;
+            if (detourLeft) --detourLeft;
+            double x = points[i].first + offset + noise(generator), y = points[i].second + noise(generator);
+            rtc::LocationFix fix = fixAt(i, x, y);
+
+            start = std::chrono::steady_clock::now();
+            if (tracker.addFix(fix) == rtc::RouteTracker::EventOffRoute) ++numOffRoute;
+            latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            numTested += tracker.lastSegmentsTested();
+
+            if (i % 100 == 0) {
+                start = std::chrono::steady_clock::now();
+                scanDistance(points, x, y, NULL);
+                scanTime += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                ++numScanned;
+            }
+        }
+        double meanLatency = 0;
+        for (size_t i = 0; i < latencies.size(); ++i) meanLatency += latencies[i];
+        meanLatency /= latencies.size();
+        std::sort(latencies.begin(), latencies.end());
+
+        NSLog(@"[%@] %lu vertices: index built in %.1fms; per fix mean %.2fus, p99 %.2fus, %.1f segments tested; linear scan %.1fus; %lu off route",
+              NSStringFromSelector(_cmd), (unsigned long)points.size(), buildTime, meanLatency,
+              latencies[latencies.size() * 99 / 100], (double)numTested / points.size(), scanTime / numScanned,
+              (unsigned long)numOffRoute);
+        XCTAssertGreaterThan(numOffRoute, (size_t)0);
+        XCTAssertLessThan(meanLatency, scanTime / numScanned);
+        XCTAssertFalse(tracker.progress().distanceRemaining > 100.0);
+    }
+
+    std::vector<std::pair<double, double> > points;
+    rtc::Route route = syntheticRoute(generator, kBenchmarkRouteSizes[0], points);
+    rtc::RouteTracker tracker;
+    tracker.setRoute(route);
+    rtc::RouteTracker *trackerPointer = &tracker;
+    std::vector<std::pair<double, double> > *pointsPointer = &points;
+    [self measureBlock:^{
+        for (size_t i = 0; i < pointsPointer->size(); ++i) {
+            trackerPointer->addFix(fixAt(i, (*pointsPointer)[i].first, (*pointsPointer)[i].second));
+        }
+    }];
+}
+
+@end
@@ -0,0 +1,347 @@
+//
+//  RTCSchedulerTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 9/3/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <random>
+#include "RTCScheduler.h"
+
+// timers outstanding while arm and cancel are timed
+static const NSUInteger kNumBenchmarkTimers = 100000;
+
+// arm/cancel pairs timed against them
+static const NSUInteger kNumBenchmarkOperations = 1000000;
+
+// timeouts in the benchmark, seconds: from a UI debounce to a location request
+static const double kBenchmarkMinDelay = 0.05;
+static const double kBenchmarkMaxDelay = 60.0;
+
+@interface RTCSchedulerTests : XCTestCase
+
+@end
+
+@implementation RTCSchedulerTests
+
+#pragma mark - Helpers
+/**
+ * Advance wheel to now and check the timers that fired are the ones reference
+ * (ID -> tick) says are due, taking them out of it.
+ */
+static void advanceAndCheck(rtc::TimerWheel &wheel, std::map<rtc::TimerWheel::TimerID, uint64_t> &reference,
+                            double now, bool *matched)
+{
+    std::vector<rtc::TimerWheel::TimerID> expired;
+    wheel.advance(now, expired);
+
+    std::vector<rtc::TimerWheel::TimerID> expected;
+    for (std::map<rtc::TimerWheel::TimerID, uint64_t>::iterator it = reference.begin(); it != reference.end(); ) {
+        if ((double)it->second <= now) {
+            expected.push_back(it->first);
+            reference.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+
+    std::sort(expired.begin(), expired.end());
+    std::sort(expected.begin(), expected.end());
+    *matched = (expired == expected);
+}
+
+/**
+ * Timeouts a screen sets and mostly cancels, as RTCLocationManager does
+ */
+static double randomDelay(std::mt19937 &generator)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    return kBenchmarkMinDelay * std::pow(kBenchmarkMaxDelay / kBenchmarkMinDelay, unit(generator));
+}
+
+
+#pragma mark - Timer Wheel
+- (void)testWheelMatchesReference
+{
+    // a tick a second, so deadlines are ticks and the reference is exact
+    std::mt19937 generator(2014);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    rtc::TimerWheel wheel(1.0, 0.0);
+    std::map<rtc::TimerWheel::TimerID, uint64_t> reference;
+    std::vector<rtc::TimerWheel::TimerID> ids;
+
+    double now = 0;
+    for (NSUInteger step = 0; step < 20000; ++step) {
+        double kind = unit(generator);
+        if (kind < 0.5) {
+            // spans every wheel, with most near at hand
+            double reach = std::pow(2.0, 1.0 + 44.0 * unit(generator) * unit(generator));
+            uint64_t tick = (uint64_t)(now + std::floor(reach * unit(generator)));
+            rtc::TimerWheel::TimerID timerID = wheel.schedule((double)tick);
+            XCTAssertNotEqual(timerID, 0ULL);
+            XCTAssertEqual(reference.count(timerID), 0UL, @"IDs are never reused");
+            reference[timerID] = std::max(tick, (uint64_t)now);
+            ids.push_back(timerID);
+        } else if (kind < 0.7 && !ids.empty()) {
+            size_t i = (size_t)(unit(generator) * ids.size());
+            rtc::TimerWheel::TimerID timerID = ids[i];
+            XCTAssertEqual(wheel.cancel(timerID), reference.erase(timerID) > 0);
+            XCTAssertFalse(wheel.isScheduled(timerID));
+        } else {
+            // mostly small steps, now and then a long sleep
+            double jump = (unit(generator) < 0.05) ? std::pow(2.0, 40.0 * unit(generator)) : 100.0 * unit(generator);
+            now = std::floor(now + jump);
+            bool matched = false;
+            advanceAndCheck(wheel, reference, now, &matched);
+            XCTAssertTrue(matched, @"step %lu", (unsigned long)step);
+            if (!matched) return;
+        }
+        XCTAssertEqual(wheel.size(), reference.size());
+
+        double expectedDeadline = std::numeric_limits<double>::infinity();
+        for (std::map<rtc::TimerWheel::TimerID, uint64_t>::const_iterator it = reference.begin(); it != reference.end(); ++it) {
+            expectedDeadline = std::min(expectedDeadline, (double)it->second);
+        }
+        XCTAssertEqual(wheel.nextDeadline(), expectedDeadline);
+    }
+
+    bool matched = false;
+    advanceAndCheck(wheel, reference, 1e15, &matched);
+    XCTAssertTrue(matched);
+    XCTAssertTrue(wheel.empty());
+}
+
+- (void)testTimersFireInOrderAndNeverEarly
+{
+    rtc::TimerWheel wheel(0.001, 1000.0);
+    std::map<rtc::TimerWheel::TimerID, double> deadlines;
+    std::mt19937 generator(9);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (NSUInteger i = 0; i < 5000; ++i) {
+        double deadline = 1000.0 + 3600.0 * unit(generator) * unit(generator);
+        deadlines[wheel.schedule(deadline)] = deadline;
+    }
+
+    double last = 0;
+    std::vector<rtc::TimerWheel::TimerID> expired;
+    while (!wheel.empty()) {
+        double now = wheel.nextDeadline();
+        XCTAssertGreaterThanOrEqual(now, last);
+        expired.clear();
+        wheel.advance(now, expired);
+        XCTAssertFalse(expired.empty(), @"nextDeadline() is when something fires");
+        for (size_t i = 0; i < expired.size(); ++i) {
+            double deadline = deadlines[expired[i]];
+            XCTAssertGreaterThanOrEqual(now, deadline - 1e-9);
+            XCTAssertLessThan(now - deadline, 0.001 + 1e-9, @"fires within a tick");
+            XCTAssertGreaterThanOrEqual(deadline, last - 0.001);
+        }
+        last = now;
+    }
+}
+
+- (void)testPastDeadlineFiresOnNextAdvance
+{
+    rtc::TimerWheel wheel(0.5, 0.0);
+    std::vector<rtc::TimerWheel::TimerID> expired;
+    wheel.advance(100.0, expired);
+
+    rtc::TimerWheel::TimerID late = wheel.schedule(10.0);
+    XCTAssertEqual(wheel.nextDeadline(), 100.0);
+    wheel.advance(100.0, expired);
+    XCTAssertEqual(expired.size(), 1UL);
+    XCTAssertEqual(expired[0], late);
+    XCTAssertFalse(wheel.cancel(late), @"already fired");
+}
+
+- (void)testStaleIDsAreIgnored
+{
+    rtc::TimerWheel wheel;
+    rtc::TimerWheel::TimerID first = wheel.schedule(1.0);
+    XCTAssertTrue(wheel.cancel(first));
+
+    // the node is reused, but not the ID
+    rtc::TimerWheel::TimerID second = wheel.schedule(2.0);
+    XCTAssertNotEqual(first, second);
+    XCTAssertEqual(rtc::TimerWheel::indexOf(first), rtc::TimerWheel::indexOf(second));
+    XCTAssertFalse(wheel.cancel(first));
+    XCTAssertTrue(wheel.isScheduled(second));
+    XCTAssertFalse(wheel.cancel(0));
+
+    wheel.clear();
+    XCTAssertFalse(wheel.isScheduled(second));
+    XCTAssertEqual(wheel.nextDeadline(), std::numeric_limits<double>::infinity());
+}
+
+
+#pragma mark - Scheduler
+- (void)testVirtualTimeRunsWorkInOrder
+{
+    rtc::ManualClock clock(1000.0);
+    rtc::Scheduler scheduler(clock);
+    rtc::ManualExecutor queue;
+    std::vector<int> order;
+    std::vector<double> times;
+
+    scheduler.scheduleAfter(3.0, queue, [&]() { order.push_back(3); times.push_back(clock.now()); });
+    scheduler.scheduleAfter(1.0, queue, [&]() {
+        order.push_back(1);
+        times.push_back(clock.now());
+        // work can set timers of its own
+        scheduler.scheduleAfter(1.0, queue, [&]() { order.push_back(2); times.push_back(clock.now()); });
+    });
+    scheduler.scheduleAfter(3600.0, queue, [&]() { order.push_back(4); });
+
+    XCTAssertEqual(rtc::runVirtualTime(clock, scheduler, queue, 1010.0), 3UL);
+    XCTAssertEqual(order.size(), 3UL);
+    for (int i = 0; i < 3; ++i) {
+        XCTAssertEqual(order[i], i + 1);
+        XCTAssertEqualWithAccuracy(times[i], 1001.0 + i, 1e-6);
+    }
+    XCTAssertEqual(clock.now(), 1010.0);
+    XCTAssertEqual(scheduler.size(), 1UL);
+
+    // a timer an hour out costs nothing to wait for
+    XCTAssertEqual(rtc::runVirtualTime(clock, scheduler, queue, 1e6), 1UL);
+    XCTAssertEqual(order.back(), 4);
+}
+
+- (void)testCancelledWorkDoesNotRun
+{
+    rtc::ManualClock clock;
+    rtc::Scheduler scheduler(clock);
+    rtc::ManualExecutor queue;
+    int runs = 0;
+
+    rtc::TimerHandle taken = scheduler.scheduleAfter(1.0, queue, [&]() { ++runs; });
+    rtc::TimerHandle flagged = scheduler.scheduleAfter(1.0, queue, [&]() { ++runs; });
+    rtc::TimerHandle queued = scheduler.scheduleAfter(1.0, queue, [&]() { ++runs; });
+
+    XCTAssertTrue(scheduler.cancel(taken));
+    XCTAssertFalse(scheduler.cancel(taken));
+    flagged.cancel();
+    XCTAssertEqual(scheduler.size(), 2UL);
+
+    // fired, but cancelled before the queue got to it
+    clock.setNow(1.0);
+    scheduler.fireDueTimers();
+    XCTAssertEqual(queue.size(), 1UL);
+    queued.cancel();
+    queue.runPending();
+
+    XCTAssertEqual(runs, 0);
+    XCTAssertTrue(queued.isCancelled());
+    XCTAssertTrue(rtc::TimerHandle().isEmpty());
+}
+
+- (void)testRearmedTimeoutFiresOnce
+{
+    // RTCLocationManager's pattern: every new request pushes the timeout back
+    rtc::ManualClock clock;
+    rtc::Scheduler scheduler(clock, 0.01);
+    rtc::ManualExecutor queue;
+    int timeouts = 0;
+    double firedAt = 0;
+
+    rtc::TimerHandle timeout;
+    for (int i = 0; i < 50; ++i) {
+        scheduler.cancel(timeout);
+        timeout = scheduler.scheduleAfter(5.0, queue, [&]() { ++timeouts; firedAt = clock.now(); });
+        rtc::runVirtualTime(clock, scheduler, queue, clock.now() + 1.0);
+    }
+    rtc::runVirtualTime(clock, scheduler, queue, clock.now() + 10.0);
+
+    XCTAssertEqual(timeouts, 1);
+    XCTAssertEqualWithAccuracy(firedAt, 49.0 + 5.0, 0.01);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Time arming and cancelling a timer with kNumBenchmarkTimers outstanding,
+ * against a std::multimap kept in deadline order (what a heap or sorted
+ * timer list costs), and through Scheduler with its work and handle.
+ */
+- (void)testArmCancelPerformance
+{
+    std::mt19937 generator(2014);
+    std::vector<double> delays(kNumBenchmarkTimers + kNumBenchmarkOperations);
+    for (size_t i = 0; i < delays.size(); ++i) delays[i] = randomDelay(generator);
+
+    // timing wheel
+    rtc::TimerWheel wheel(0.001, 0.0);
+    std::vector<rtc::TimerWheel::TimerID> wheelIDs(kNumBenchmarkTimers);
+    for (size_t i = 0; i < kNumBenchmarkTimers; ++i) wheelIDs[i] = wheel.schedule(delays[i]);
+    auto wheelStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kNumBenchmarkOperations; ++i) {
+        size_t slot = i % kNumBenchmarkTimers;
+        wheel.cancel(wheelIDs[slot]);
+        wheelIDs[slot] = wheel.schedule(delays[kNumBenchmarkTimers + i]);
+    }
+    auto wheelEnd = std::chrono::steady_clock::now();
+    XCTAssertEqual(wheel.size(), kNumBenchmarkTimers);
+
+    // ordered map
+    std::multimap<double, size_t> timers;
+    std::vector<std::multimap<double, size_t>::iterator> mapIDs(kNumBenchmarkTimers);
+    for (size_t i = 0; i < kNumBenchmarkTimers; ++i) mapIDs[i] = timers.insert(std::make_pair(delays[i], i));
+    auto mapStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kNumBenchmarkOperations; ++i) {
+        size_t slot = i % kNumBenchmarkTimers;
+        timers.erase(mapIDs[slot]);
+        mapIDs[slot] = timers.insert(std::make_pair(delays[kNumBenchmarkTimers + i], slot));
+    }
+    auto mapEnd = std::chrono::steady_clock::now();
+
+    // scheduler, with work to post
+    rtc::ManualClock clock;
+    rtc::Scheduler scheduler(clock);
+    rtc::ManualExecutor queue;
+    int runs = 0;
+    std::vector<rtc::TimerHandle> handles(kNumBenchmarkTimers);
+    for (size_t i = 0; i < kNumBenchmarkTimers; ++i) handles[i] = scheduler.scheduleAfter(delays[i], queue, [&runs]() { ++runs; });
+    auto schedulerStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kNumBenchmarkOperations; ++i) {
+        size_t slot = i % kNumBenchmarkTimers;
+        scheduler.cancel(handles[slot]);
+        handles[slot] = scheduler.scheduleAfter(delays[kNumBenchmarkTimers + i], queue, [&runs]() { ++runs; });
+    }
+    auto schedulerEnd = std::chrono::steady_clock::now();
+
+    // and firing them all
+    size_t fired = rtc::runVirtualTime(clock, scheduler, queue, kBenchmarkMaxDelay + 1.0);
+    auto fireEnd = std::chrono::steady_clock::now();
+    XCTAssertEqual(fired, kNumBenchmarkTimers);
+    XCTAssertEqual(runs, (int)kNumBenchmarkTimers);
+
+    double wheelTime = std::chrono::duration<double, std::nano>(wheelEnd - wheelStart).count() / kNumBenchmarkOperations;
+    double mapTime = std::chrono::duration<double, std::nano>(mapEnd - mapStart).count() / kNumBenchmarkOperations;
+    double schedulerTime = std::chrono::duration<double, std::nano>(schedulerEnd - schedulerStart).count() / kNumBenchmarkOperations;
+    double fireTime = std::chrono::duration<double, std::nano>(fireEnd - schedulerEnd).count() / kNumBenchmarkTimers;
+    NSLog(@"[%@] %lu outstanding timers, cancel + arm: timing wheel %.0f ns, std::multimap %.0f ns (%.1fx), "
+          "Scheduler %.0f ns; fire and run %.0f ns a timer",
+          NSStringFromSelector(_cmd), (unsigned long)kNumBenchmarkTimers,
+          wheelTime, mapTime, mapTime / wheelTime, schedulerTime, fireTime);
+
+    XCTAssertLessThan(wheelTime, mapTime);
+
+    rtc::TimerWheel *timed = &wheel;
+    const std::vector<double> *timedDelays = &delays;
+    std::vector<rtc::TimerWheel::TimerID> *timedIDs = &wheelIDs;
+    [self measureBlock:^{
+        for (size_t i = 0; i < kNumBenchmarkOperations; ++i) {
+            size_t slot = i % kNumBenchmarkTimers;
+            timed->cancel((*timedIDs)[slot]);
+            (*timedIDs)[slot] = timed->schedule((*timedDelays)[kNumBenchmarkTimers + i]);
+        }
+    }];
+}
+
+@end
@@ -0,0 +1,235 @@
+//
+//  RTCSpatialIndexTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/10/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include "RTCSpatialIndex.h"
+
+// number of random queries checked against a linear scan
+static const NSUInteger kNumBruteForceQueries = 200;
+
+// number of queries timed per index size in the benchmark
+static const NSUInteger kNumBenchmarkQueries = 10000;
+
+// benchmark places are spread at this density (per square degree) whatever
+// their number, so the neighbourhood of a query looks the same at every size
+static const double kBenchmarkPlacesPerSquareDegree = 1e7;
+
+@interface RTCSpatialIndexTests : XCTestCase
+
+@end
+
+@implementation RTCSpatialIndexTests
+
+#pragma mark - Helpers
+/**
+ * numPlaces uniformly spread over a square of side degrees with a corner at
+ * origin
+ */
+static std::vector<rtc::SpatialIndex::Record> randomRecords(std::mt19937 &generator, size_t numPlaces,
+                                                            const rtc::GeoPoint &origin, double side)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<rtc::SpatialIndex::Record> records;
+    for (size_t i = 0; i < numPlaces; ++i) {
+        rtc::GeoPoint coordinate(origin.latitude + side * unit(generator),
+                                 origin.longitude + side * unit(generator));
+        if (coordinate.longitude >= 180.0) coordinate.longitude -= 360.0;
+        records.push_back(rtc::SpatialIndex::Record(i + 1, coordinate));
+    }
+    return records;
+}
+
+/**
+ * The k nearest records by linear scan, for checking query results
+ */
+static std::vector<rtc::SpatialIndex::Neighbor> bruteForceNearest(const std::vector<rtc::SpatialIndex::Record> &records,
+                                                                  const rtc::GeoPoint &origin, size_t k)
+{
+    std::vector<rtc::SpatialIndex::Neighbor> neighbors;
+    for (size_t i = 0; i < records.size(); ++i) {
+        neighbors.push_back(rtc::SpatialIndex::Neighbor(records[i].placeID, rtc::distanceBetween(origin, records[i].coordinate)));
+    }
+    std::sort(neighbors.begin(), neighbors.end());
+    if (neighbors.size() > k) neighbors.erase(neighbors.begin() + k, neighbors.end());
+    return neighbors;
+}
+
+- (void)assertNeighbors:(const std::vector<rtc::SpatialIndex::Neighbor> &)neighbors
+                 equalTo:(const std::vector<rtc::SpatialIndex::Neighbor> &)expected
+{
+    XCTAssertEqual(neighbors.size(), expected.size());
+    for (size_t i = 0; i < std::min(neighbors.size(), expected.size()); ++i) {
+        XCTAssertEqual(neighbors[i].placeID, expected[i].placeID, @"result %zu", i);
+        XCTAssertEqualWithAccuracy(neighbors[i].distance, expected[i].distance, 1e-6);
+    }
+}
+
+
+#pragma mark - Queries
+- (void)testQueriesMatchBruteForce
+{
+    std::mt19937 generator(2014);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<rtc::SpatialIndex::Record> records = randomRecords(generator, 5000, rtc::GeoPoint(37.0, -122.5), 1.0);
+
+    rtc::SpatialIndex index;
+    index.assign(records);
+    XCTAssertEqual(index.size(), records.size());
+
+    for (NSUInteger q = 0; q < kNumBruteForceQueries; ++q) {
+        rtc::GeoPoint origin(36.8 + 1.4 * unit(generator), -122.7 + 1.4 * unit(generator));
+        [self assertNeighbors:index.nearest(origin, 8) equalTo:bruteForceNearest(records, origin, 8)];
+
+        double radius = 20000.0 * unit(generator);
+        std::vector<rtc::SpatialIndex::Neighbor> expected = bruteForceNearest(records, origin, records.size());
+        expected.erase(std::find_if(expected.begin(), expected.end(),
+                                    [radius](const rtc::SpatialIndex::Neighbor &n) { return n.distance > radius; }),
+                       expected.end());
+        [self assertNeighbors:index.within(origin, radius) equalTo:expected];
+    }
+}
+
+- (void)testQueriesAcrossAntimeridianAndPoles
+{
+    std::mt19937 generator(7);
+    std::vector<rtc::SpatialIndex::Record> records = randomRecords(generator, 2000, rtc::GeoPoint(-20.0, 179.0), 2.0);
+    std::vector<rtc::SpatialIndex::Record> polar = randomRecords(generator, 2000, rtc::GeoPoint(88.0, -180.0), 2.0);
+    for (size_t i = 0; i < polar.size(); ++i) polar[i].placeID += records.size();
+    records.insert(records.end(), polar.begin(), polar.end());
+
+    rtc::SpatialIndex index;
+    index.assign(records);
+
+    rtc::GeoPoint origins[] = {rtc::GeoPoint(-19.0, 180.0), rtc::GeoPoint(-19.0, -179.9),
+                               rtc::GeoPoint(-19.0, 179.9), rtc::GeoPoint(90.0, 0.0),
+                               rtc::GeoPoint(89.5, 135.0)};
+    for (size_t i = 0; i < sizeof(origins) / sizeof(origins[0]); ++i) {
+        [self assertNeighbors:index.nearest(origins[i], 25) equalTo:bruteForceNearest(records, origins[i], 25)];
+
+        std::vector<rtc::SpatialIndex::Neighbor> expected = bruteForceNearest(records, origins[i], records.size());
+        expected.erase(std::find_if(expected.begin(), expected.end(),
+                                    [](const rtc::SpatialIndex::Neighbor &n) { return n.distance > 50000.0; }),
+                       expected.end());
+        [self assertNeighbors:index.within(origins[i], 50000.0) equalTo:expected];
+    }
+}
+
+- (void)testInsertMoveRemove
+{
+    rtc::SpatialIndex index;
+    index.insert(1, rtc::GeoPoint(37.3259, -121.9455));
+    index.insert(2, rtc::GeoPoint(37.3300, -121.9500));
+    XCTAssertEqual(index.size(), 2u);
+
+    std::vector<rtc::SpatialIndex::Neighbor> nearest = index.nearest(rtc::GeoPoint(37.3259, -121.9455), 1);
+    XCTAssertEqual(nearest.size(), 1u);
+    XCTAssertEqual(nearest[0].placeID, 1u);
+
+    // moving a place re-keys it rather than duplicating it
+    index.insert(1, rtc::GeoPoint(40.0, -100.0));
+    XCTAssertEqual(index.size(), 2u);
+    XCTAssertEqual(index.nearest(rtc::GeoPoint(37.3259, -121.9455), 1)[0].placeID, 2u);
+
+    XCTAssertTrue(index.remove(2));
+    XCTAssertFalse(index.remove(2));
+    XCTAssertFalse(index.contains(2));
+    XCTAssertTrue(index.within(rtc::GeoPoint(37.33, -121.95), 1000.0).empty());
+}
+
+- (void)testSerializationRoundTrip
+{
+    std::mt19937 generator(42);
+    rtc::SpatialIndex index;
+    index.assign(randomRecords(generator, 1000, rtc::GeoPoint(51.0, -0.5), 1.0));
+
+    std::stringstream stream;
+    index.write(stream);
+
+    rtc::SpatialIndex copy;
+    XCTAssertTrue(copy.read(stream));
+    XCTAssertEqual(copy.size(), index.size());
+
+    rtc::GeoPoint origin(51.5, 0.0);
+    [self assertNeighbors:copy.nearest(origin, 10) equalTo:index.nearest(origin, 10)];
+
+    std::istringstream garbage("not an index");
+    XCTAssertFalse(copy.read(garbage));
+}
+
+
+#pragma mark - Performance
+/**
+ * Query cost should depend on how many places are near the query, not on how
+ * many are saved. Time nearest and radius queries from 100 to 1,000,000 places
+ * at constant density and check the work per query stays flat.
+ */
+- (void)testQueryPerformanceIsFlat
+{
+    const size_t sizes[] = {100, 10000, 1000000};
+    const size_t numSizes = sizeof(sizes) / sizeof(sizes[0]);
+    std::vector<double> nearestVisits(numSizes), withinVisits(numSizes);
+
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    rtc::GeoPoint corner(37.0, -122.0);
+
+    for (size_t s = 0; s < numSizes; ++s) {
+        double side = std::sqrt(sizes[s] / kBenchmarkPlacesPerSquareDegree);
+        rtc::SpatialIndex index;
+        index.assign(randomRecords(generator, sizes[s], corner, side));
+
+        std::vector<rtc::GeoPoint> origins;
+        for (NSUInteger q = 0; q < kNumBenchmarkQueries; ++q) {
+            origins.push_back(rtc::GeoPoint(corner.latitude + side * unit(generator),
+                                            corner.longitude + side * unit(generator)));
+        }
+
+        size_t visits = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t q = 0; q < origins.size(); ++q) {
+            index.nearest(origins[q], 10);
+            visits += index.lastQueryVisits();
+        }
+        auto middle = std::chrono::steady_clock::now();
+        nearestVisits[s] = (double)visits / origins.size();
+
+        visits = 0;
+        for (size_t q = 0; q < origins.size(); ++q) {
+            index.within(origins[q], 50.0);
+            visits += index.lastQueryVisits();
+        }
+        auto end = std::chrono::steady_clock::now();
+        withinVisits[s] = (double)visits / origins.size();
+
+        NSLog(@"[%@] %zu places: nearest(10) %.2fus, %.0f visits; within(50m) %.2fus, %.0f visits",
+              NSStringFromSelector(_cmd), sizes[s],
+              std::chrono::duration<double, std::micro>(middle - start).count() / origins.size(), nearestVisits[s],
+              std::chrono::duration<double, std::micro>(end - middle).count() / origins.size(), withinVisits[s]);
+
+        // time the largest index with XCTest so regressions show up in the report
+        // (through pointers so the block doesn't copy a million places)
+        if (s == numSizes - 1) {
+            const rtc::SpatialIndex *indexPtr = &index;
+            const std::vector<rtc::GeoPoint> *originsPtr = &origins;
+            [self measureBlock:^{
+                for (size_t q = 0; q < originsPtr->size(); ++q) indexPtr->nearest((*originsPtr)[q], 10);
+            }];
+        }
+    }
+
+    // a scan would grow 10,000x here; allow for the edge effects of the small index
+    XCTAssertLessThan(nearestVisits[numSizes - 1], 4.0 * nearestVisits[0]);
+    XCTAssertLessThan(withinVisits[numSizes - 1], 4.0 * withinVisits[0]);
+}
+
+@end
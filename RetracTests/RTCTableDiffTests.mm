@@ -0,0 +1,429 @@
+//
+//  RTCTableDiffTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/18/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <random>
+#include <set>
+#include "RTCTableDiff.h"
+
+// batches bigger than this reload the table, as kRTCTableMaxAnimatedChanges
+// does in the app
+static const size_t kMaxAnimatedChanges = 250;
+
+// rows in the benchmark table
+static const size_t kBenchmarkRows = 200000;
+
+// rows in each section of the benchmark table
+static const size_t kBenchmarkRowsPerSection = 1000;
+
+@interface RTCTableDiffTests : XCTestCase
+
+@end
+
+@implementation RTCTableDiffTests
+
+#pragma mark - Helpers
+typedef std::vector<std::pair<rtc::TableSnapshot::Key, std::vector<rtc::TableSnapshot::Key> > > Sections;
+
+static rtc::TableSnapshot snapshotOf(const Sections &sections)
+{
+    rtc::TableSnapshot snapshot;
+    for (size_t s = 0; s < sections.size(); ++s) {
+        snapshot.appendSection(sections[s].first);
+        for (size_t r = 0; r < sections[s].second.size(); ++r) snapshot.appendRow(sections[s].second[r]);
+    }
+    return snapshot;
+}
+
+static bool isSameTable(const rtc::TableSnapshot &snapshot, const rtc::TableSnapshot &other)
+{
+    if ((snapshot.numSections() != other.numSections()) || (snapshot.numRows() != other.numRows())) return false;
+    for (size_t s = 0; s < snapshot.numSections(); ++s) {
+        if ((snapshot.sectionKey(s) != other.sectionKey(s)) || (snapshot.sectionStart(s) != other.sectionStart(s))) return false;
+    }
+    for (size_t i = 0; i < snapshot.numRows(); ++i) {
+        if (snapshot.rowKeyAt(i) != other.rowKeyAt(i)) return false;
+    }
+    return true;
+}
+
+/**
+ * The changes NSFetchedResultsController would report going from before to
+ * after: rows that stay in their section and in order are left alone, the
+ * rest are deleted and inserted. Sections in both must be in the same order.
+ */
+static rtc::TableChanges changesBetween(const Sections &before, const Sections &after)
+{
+    std::map<rtc::TableSnapshot::Key, size_t> oldSections, newSections;
+    std::map<rtc::TableSnapshot::Key, rtc::TablePath> oldRows;
+    for (size_t s = 0; s < before.size(); ++s) {
+        oldSections[before[s].first] = s;
+        for (size_t r = 0; r < before[s].second.size(); ++r) oldRows[before[s].second[r]] = rtc::TablePath(s, r);
+    }
+    for (size_t t = 0; t < after.size(); ++t) newSections[after[t].first] = t;
+
+    rtc::TableChanges changes;
+    for (size_t s = 0; s < before.size(); ++s) {
+        if (!newSections.count(before[s].first)) changes.deletedSections.push_back(s);
+    }
+    for (size_t t = 0; t < after.size(); ++t) {
+        if (!oldSections.count(after[t].first)) changes.insertedSections.push_back(std::make_pair(t, after[t].first));
+    }
+
+    std::set<rtc::TableSnapshot::Key> staying;
+    for (size_t t = 0; t < after.size(); ++t) {
+        std::map<rtc::TableSnapshot::Key, size_t>::const_iterator section = oldSections.find(after[t].first);
+        if (section == oldSections.end()) continue;
+
+        std::vector<size_t> oldPositions;
+        std::vector<rtc::TableSnapshot::Key> keys;
+        for (size_t r = 0; r < after[t].second.size(); ++r) {
+            std::map<rtc::TableSnapshot::Key, rtc::TablePath>::const_iterator row = oldRows.find(after[t].second[r]);
+            if ((row == oldRows.end()) || (row->second.section != section->second)) continue;
+            oldPositions.push_back(row->second.row);
+            keys.push_back(after[t].second[r]);
+        }
+        std::vector<size_t> inOrder = rtc::longestIncreasingSubsequence(oldPositions);
+        for (size_t i = 0; i < inOrder.size(); ++i) staying.insert(keys[inOrder[i]]);
+    }
+
+    for (size_t s = 0; s < before.size(); ++s) {
+        for (size_t r = 0; r < before[s].second.size(); ++r) {
+            if (!staying.count(before[s].second[r])) changes.deletedRows.push_back(rtc::TablePath(s, r));
+        }
+    }
+    for (size_t t = 0; t < after.size(); ++t) {
+        for (size_t r = 0; r < after[t].second.size(); ++r) {
+            if (!staying.count(after[t].second[r])) {
+                changes.insertedRows.push_back(std::make_pair(rtc::TablePath(t, r), after[t].second[r]));
+            }
+        }
+    }
+    return changes;
+}
+
+/**
+ * Play diff back onto oldSnapshot the way UITableView does a batch update,
+ * getting inserted rows and sections from newSnapshot as its data source
+ * would, and check the table ends up as newSnapshot with every updated row
+ * reloaded or reinserted.
+ *
+ * @return NO (after failing the test) if it doesn't.
+ */
+- (BOOL)assertDiff:(const rtc::TableDiff &)diff
+              from:(const rtc::TableSnapshot &)oldSnapshot
+                to:(const rtc::TableSnapshot &)newSnapshot
+           updated:(const std::unordered_set<rtc::TableSnapshot::Key> &)updated
+{
+    std::set<size_t> deletedSections(diff.deletedSections.begin(), diff.deletedSections.end());
+    std::set<size_t> insertedSections(diff.insertedSections.begin(), diff.insertedSections.end());
+    std::set<rtc::TablePath> gone(diff.deletedRows.begin(), diff.deletedRows.end());
+    std::set<rtc::TablePath> reloaded(diff.reloadedRows.begin(), diff.reloadedRows.end());
+    std::set<rtc::TablePath> arriving(diff.insertedRows.begin(), diff.insertedRows.end());
+    std::map<rtc::TablePath, rtc::TablePath> movedTo;
+    for (size_t k = 0; k < diff.movedRows.size(); ++k) {
+        XCTAssertTrue(gone.insert(diff.movedRows[k].first).second, @"row moved twice or moved and deleted");
+        XCTAssertTrue(movedTo.insert(std::make_pair(diff.movedRows[k].second, diff.movedRows[k].first)).second);
+    }
+    for (std::set<rtc::TablePath>::const_iterator path = reloaded.begin(); path != reloaded.end(); ++path) {
+        XCTAssertFalse(gone.count(*path), @"row reloaded and deleted or moved");
+    }
+    if (oldSnapshot.numSections() - deletedSections.size() != newSnapshot.numSections() - insertedSections.size()) {
+        XCTFail(@"section counts don't add up");
+        return NO;
+    }
+
+    // surviving old sections line up with non-inserted new sections in order
+    size_t s = 0;
+    for (size_t t = 0; t < newSnapshot.numSections(); ++t) {
+        if (insertedSections.count(t)) continue;
+        while (deletedSections.count(s)) ++s;
+        if (oldSnapshot.sectionKey(s) != newSnapshot.sectionKey(t)) {
+            XCTFail(@"section %zu lands at %zu", s, t);
+            return NO;
+        }
+
+        // rows that stay, in order
+        std::vector<size_t> staying;
+        for (size_t r = 0; r < oldSnapshot.numRowsInSection(s); ++r) {
+            if (!gone.count(rtc::TablePath(s, r))) staying.push_back(r);
+        }
+
+        size_t next = 0;
+        for (size_t r = 0; r < newSnapshot.numRowsInSection(t); ++r) {
+            rtc::TablePath path(t, r);
+            rtc::TableSnapshot::Key key = newSnapshot.rowKey(t, r);
+            if (arriving.count(path)) continue;
+
+            std::map<rtc::TablePath, rtc::TablePath>::const_iterator move = movedTo.find(path);
+            if (move != movedTo.end()) {
+                XCTAssertEqual(oldSnapshot.rowKey(move->second.section, move->second.row), key);
+                XCTAssertFalse(updated.count(key), @"updated row moved without a reload");
+                continue;
+            }
+            if (next == staying.size()) {
+                XCTFail(@"section %zu runs out of rows", t);
+                return NO;
+            }
+            size_t oldRow = staying[next++];
+            if (oldSnapshot.rowKey(s, oldRow) != key) {
+                XCTFail(@"row %zu of section %zu ends up at %zu", oldRow, s, r);
+                return NO;
+            }
+            if (updated.count(key)) XCTAssertTrue(reloaded.count(rtc::TablePath(s, oldRow)), @"updated row not reloaded");
+        }
+        XCTAssertEqual(next, staying.size(), @"section %zu has rows left over", t);
+        ++s;
+    }
+    return YES;
+}
+
+/**
+ * A table of numRows rows in sections of rowsPerSection, and the same table
+ * after numEdits random inserts, deletes, moves and updates (some of which may
+ * cancel out)
+ */
+static void randomEdits(std::mt19937 &generator, size_t numRows, size_t rowsPerSection, size_t numEdits,
+                        Sections *before, Sections *after, std::unordered_set<rtc::TableSnapshot::Key> *updated)
+{
+    before->clear();
+    rtc::TableSnapshot::Key nextKey = 1;
+    for (size_t i = 0; i < numRows; ++i) {
+        if (i % rowsPerSection == 0) before->push_back(std::make_pair(nextKey++, std::vector<rtc::TableSnapshot::Key>()));
+        before->back().second.push_back(nextKey++);
+    }
+    *after = *before;
+    updated->clear();
+
+    for (size_t e = 0; e < numEdits; ++e) {
+        size_t s = std::uniform_int_distribution<size_t>(0, after->size() - 1)(generator);
+        std::vector<rtc::TableSnapshot::Key> &rows = (*after)[s].second;
+        size_t r = std::uniform_int_distribution<size_t>(0, rows.size())(generator);
+        switch (std::uniform_int_distribution<int>(0, 3)(generator)) {
+            case 0:
+                rows.insert(rows.begin() + r, nextKey++);
+                break;
+            case 1:
+                if (r < rows.size()) rows.erase(rows.begin() + r);
+                break;
+            case 2:
+                if (r < rows.size()) {
+                    rtc::TableSnapshot::Key key = rows[r];
+                    rows.erase(rows.begin() + r);
+                    std::vector<rtc::TableSnapshot::Key> &to = (*after)[std::uniform_int_distribution<size_t>(0, after->size() - 1)(generator)].second;
+                    to.insert(to.begin() + std::uniform_int_distribution<size_t>(0, to.size())(generator), key);
+                }
+                break;
+            default:
+                if (r < rows.size()) updated->insert(rows[r]);
+                break;
+        }
+    }
+}
+
+
+#pragma mark - Diffing
+- (void)testLongestIncreasingSubsequence
+{
+    std::vector<size_t> values = {3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 8, 9, 7, 9};
+    std::vector<size_t> subsequence = rtc::longestIncreasingSubsequence(values);
+    XCTAssertEqual(subsequence.size(), (size_t)6);     // e.g. 1 4 5 6 8 9
+    for (size_t k = 1; k < subsequence.size(); ++k) {
+        XCTAssertLessThan(subsequence[k - 1], subsequence[k]);
+        XCTAssertLessThan(values[subsequence[k - 1]], values[subsequence[k]]);
+    }
+    XCTAssertTrue(rtc::longestIncreasingSubsequence(std::vector<size_t>()).empty());
+}
+
+- (void)testUnchangedTableHasNoChanges
+{
+    Sections sections = {{1, {10, 11, 12}}, {2, {20, 21}}};
+    rtc::TableDiff diff = rtc::diffTables(snapshotOf(sections), snapshotOf(sections),
+                                          std::unordered_set<rtc::TableSnapshot::Key>(), kMaxAnimatedChanges);
+    XCTAssertTrue(diff.empty());
+}
+
+- (void)testRowChanges
+{
+    Sections before = {{1, {10, 11, 12, 13, 14}}, {2, {20, 21}}};
+    Sections after = {{1, {14, 10, 12, 15, 13}}, {2, {11, 20, 21}}};
+    std::unordered_set<rtc::TableSnapshot::Key> updated = {12, 21};
+    rtc::TableSnapshot oldSnapshot = snapshotOf(before), newSnapshot = snapshotOf(after);
+
+    rtc::TableDiff diff = rtc::diffTables(oldSnapshot, newSnapshot, updated, kMaxAnimatedChanges);
+    [self assertDiff:diff from:oldSnapshot to:newSnapshot updated:updated];
+
+    // 14 to the front and 11 to the next section are the only moves needed
+    XCTAssertEqual(diff.movedRows.size(), (size_t)2);
+    XCTAssertEqual(diff.insertedRows.size(), (size_t)1);
+    XCTAssertTrue(diff.insertedRows[0] == rtc::TablePath(0, 3));
+    XCTAssertTrue(diff.deletedRows.empty());
+    XCTAssertEqual(diff.reloadedRows.size(), (size_t)2);
+}
+
+- (void)testUpdatedRowThatMovesIsReinserted
+{
+    Sections before = {{1, {10, 11, 12}}};
+    Sections after = {{1, {12, 10, 11}}};
+    std::unordered_set<rtc::TableSnapshot::Key> updated = {12};
+    rtc::TableSnapshot oldSnapshot = snapshotOf(before), newSnapshot = snapshotOf(after);
+
+    rtc::TableDiff diff = rtc::diffTables(oldSnapshot, newSnapshot, updated, kMaxAnimatedChanges);
+    [self assertDiff:diff from:oldSnapshot to:newSnapshot updated:updated];
+    XCTAssertTrue(diff.movedRows.empty());
+    XCTAssertTrue(diff.reloadedRows.empty());
+    XCTAssertEqual(diff.deletedRows.size(), (size_t)1);
+    XCTAssertEqual(diff.insertedRows.size(), (size_t)1);
+}
+
+- (void)testSectionChanges
+{
+    // section 2 goes, 4 arrives, 3 swaps with 1; rows of 2 that survive can't
+    // move out of a deleted section so they are inserted
+    Sections before = {{1, {10, 11}}, {2, {20, 21}}, {3, {30}}};
+    Sections after = {{3, {30, 21}}, {4, {40, 10}}, {1, {11}}};
+    std::unordered_set<rtc::TableSnapshot::Key> updated;
+    rtc::TableSnapshot oldSnapshot = snapshotOf(before), newSnapshot = snapshotOf(after);
+
+    rtc::TableDiff diff = rtc::diffTables(oldSnapshot, newSnapshot, updated, kMaxAnimatedChanges);
+    [self assertDiff:diff from:oldSnapshot to:newSnapshot updated:updated];
+    XCTAssertEqual(diff.deletedSections.size(), (size_t)2);
+    XCTAssertEqual(diff.insertedSections.size(), (size_t)2);
+}
+
+- (void)testRandomEditsReachNewTable
+{
+    std::mt19937 generator(2014);
+    for (size_t trial = 0; trial < 200; ++trial) {
+        Sections before, after;
+        std::unordered_set<rtc::TableSnapshot::Key> updated;
+        randomEdits(generator, 1 + trial, 1 + trial % 7, trial % 40, &before, &after, &updated);
+        rtc::TableSnapshot oldSnapshot = snapshotOf(before), newSnapshot = snapshotOf(after);
+
+        rtc::TableDiff diff = rtc::diffTables(oldSnapshot, newSnapshot, updated, (size_t)-1);
+        XCTAssertFalse(diff.reloadAll);
+        if (![self assertDiff:diff from:oldSnapshot to:newSnapshot updated:updated]) {
+            XCTFail(@"trial %zu", trial);
+            break;
+        }
+    }
+}
+
+- (void)testReloadAll
+{
+    Sections before = {{1, {10, 11, 12, 13}}};
+    Sections after = {{1, {13, 12, 11, 10}}};
+    std::unordered_set<rtc::TableSnapshot::Key> updated;
+
+    // reversing four rows takes three moves
+    XCTAssertEqual(rtc::diffTables(snapshotOf(before), snapshotOf(after), updated, 3).movedRows.size(), (size_t)3);
+    rtc::TableDiff diff = rtc::diffTables(snapshotOf(before), snapshotOf(after), updated, 2);
+    XCTAssertTrue(diff.reloadAll);
+    XCTAssertEqual(diff.numChanges(), (size_t)0);
+
+    Sections duplicated = {{1, {10, 11, 10}}};
+    XCTAssertTrue(rtc::diffTables(snapshotOf(before), snapshotOf(duplicated), updated, kMaxAnimatedChanges).reloadAll);
+}
+
+
+#pragma mark - Reported Changes
+- (void)testAppliedChangesReachNewTable
+{
+    Sections before = {{1, {10, 11}}, {2, {20, 21}}, {3, {30}}};
+    Sections after = {{1, {11}}, {4, {40, 10, 21}}, {3, {30, 31}}, {5, {}}};
+    rtc::TableSnapshot applied;
+    XCTAssertTrue(rtc::applyTableChanges(snapshotOf(before), changesBetween(before, after), &applied));
+    XCTAssertTrue(isSameTable(applied, snapshotOf(after)));
+
+    std::mt19937 generator(2014);
+    for (size_t trial = 0; trial < 200; ++trial) {
+        std::unordered_set<rtc::TableSnapshot::Key> updated;
+        randomEdits(generator, 1 + trial, 1 + trial % 7, trial % 40, &before, &after, &updated);
+        if (!rtc::applyTableChanges(snapshotOf(before), changesBetween(before, after), &applied) ||
+            !isSameTable(applied, snapshotOf(after))) {
+            XCTFail(@"trial %zu", trial);
+            break;
+        }
+    }
+}
+
+- (void)testChangesOutsideTableAreRejected
+{
+    rtc::TableSnapshot snapshot = snapshotOf({{1, {10, 11, 12}}});
+    rtc::TableSnapshot applied;
+
+    rtc::TableChanges changes;
+    changes.deletedRows.push_back(rtc::TablePath(0, 3));
+    XCTAssertFalse(rtc::applyTableChanges(snapshot, changes, &applied));
+    XCTAssertEqual(applied.numSections(), (size_t)0);
+
+    changes.clear();
+    changes.insertedRows.push_back(std::make_pair(rtc::TablePath(0, 5), (rtc::TableSnapshot::Key)13));
+    XCTAssertFalse(rtc::applyTableChanges(snapshot, changes, &applied));
+
+    changes.clear();
+    changes.insertedSections.push_back(std::make_pair((size_t)2, (rtc::TableSnapshot::Key)2));
+    XCTAssertFalse(rtc::applyTableChanges(snapshot, changes, &applied));
+
+    // the last row is fine to append after
+    changes.clear();
+    changes.insertedRows.push_back(std::make_pair(rtc::TablePath(0, 3), (rtc::TableSnapshot::Key)13));
+    XCTAssertTrue(rtc::applyTableChanges(snapshot, changes, &applied));
+    XCTAssertEqual(applied.numRows(), (size_t)4);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Main thread time to turn a batch of 10 to 100,000 changes to a 200,000 row
+ * table into table view updates: making the reported changes to the shown
+ * table to get the fetched one, then diffing the two. Before coalescing each
+ * change was its own table view call; logs how many calls the batch comes to
+ * now and whether it is animated or a single reload.
+ */
+- (void)testDiffPerformance
+{
+    std::mt19937 generator(2014);
+    Sections before, after;
+    std::unordered_set<rtc::TableSnapshot::Key> updated;
+
+    for (size_t numEdits = 10; numEdits <= 100000; numEdits *= 10) {
+        randomEdits(generator, kBenchmarkRows, kBenchmarkRowsPerSection, numEdits, &before, &after, &updated);
+        rtc::TableSnapshot oldSnapshot = snapshotOf(before), newSnapshot;
+        rtc::TableChanges changes = changesBetween(before, after);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        XCTAssertTrue(rtc::applyTableChanges(oldSnapshot, changes, &newSnapshot));
+        std::chrono::steady_clock::time_point applied = std::chrono::steady_clock::now();
+        rtc::TableDiff diff = rtc::diffTables(oldSnapshot, newSnapshot, updated, kMaxAnimatedChanges);
+        std::chrono::steady_clock::time_point diffed = std::chrono::steady_clock::now();
+        double snapshotMilliseconds = std::chrono::duration<double, std::milli>(applied - start).count();
+        double diffMilliseconds = std::chrono::duration<double, std::milli>(diffed - applied).count();
+
+        // the same diff with no limit, to see how many updates it would have animated
+        rtc::TableDiff full = rtc::diffTables(oldSnapshot, newSnapshot, updated, (size_t)-1);
+        NSLog(@"[%@] %zu changes: snapshot %.1fms, diff %.1fms, %zu table view updates, %@",
+              NSStringFromSelector(_cmd), numEdits, snapshotMilliseconds, diffMilliseconds, full.numChanges(),
+              diff.reloadAll ? @"reload" : @"animated");
+        XCTAssertEqual(diff.reloadAll, full.numChanges() > kMaxAnimatedChanges);
+    }
+
+    randomEdits(generator, kBenchmarkRows, kBenchmarkRowsPerSection, 1000, &before, &after, &updated);
+    rtc::TableSnapshot oldSnapshot = snapshotOf(before);
+    rtc::TableChanges changes = changesBetween(before, after);
+    [self measureBlock:^{
+        rtc::TableSnapshot newSnapshot;
+        rtc::applyTableChanges(oldSnapshot, changes, &newSnapshot);
+        rtc::diffTables(oldSnapshot, newSnapshot, updated, kMaxAnimatedChanges);
+    }];
+}
+
+@end
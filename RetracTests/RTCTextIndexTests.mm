@@ -0,0 +1,240 @@
+//
+//  RTCTextIndexTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/27/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include "RTCTextIndex.h"
+
+// places indexed by the benchmark
+static const size_t kBenchmarkPlaces = 100000;
+
+// results a search as you type shows
+static const size_t kMaxResults = 50;
+
+@interface RTCTextIndexTests : XCTestCase
+
+@end
+
+@implementation RTCTextIndexTests
+
+#pragma mark - Helpers
+static bool containsPlace(const std::vector<rtc::TextIndex::PlaceID> &results, rtc::TextIndex::PlaceID placeID)
+{
+    return std::find(results.begin(), results.end(), placeID) != results.end();
+}
+
+/**
+ * Names and addresses made up from a few word lists, so words repeat across
+ * places as they do in real ones
+ */
+static void benchmarkPlace(size_t i, std::string *name, std::string *address)
+{
+    static const char *adjectives[] = {"Blue", "Golden", "Old", "Little", "Grand", "Sunny", "Hidden", "Corner", "Royal", "Happy"};
+    static const char *nouns[] = {"Coffee", "Bakery", "Diner", "Park", "Library", "Garage", "Tavern", "Market", "Studio", "Gym",
+                                  "Bistro", "Cafe", "Deli", "Pharmacy", "Gallery", "Theater", "Station", "Pier"};
+    static const char *streets[] = {"Main", "Oak", "Maple", "Maurice", "Colorado", "Lake", "Hill", "Washington", "Sunset", "Mission",
+                                    "Valencia", "Broadway", "Market", "Pine", "Cedar", "Elm", "Walnut", "Orange", "Foothill", "Canyon"};
+    static const char *cities[] = {"Pasadena", "San Jose", "Oakland", "Berkeley", "Fresno", "Sacramento", "Irvine", "Glendale"};
+
+    std::ostringstream nameStream, addressStream;
+    nameStream << adjectives[i % 10] << " " << nouns[(i / 10) % 18] << " " << (i % 997);
+    addressStream << (100 + i % 9000) << " " << streets[(i / 7) % 20] << " St, " << cities[(i / 3) % 8] << ", CA " << (90000 + i % 6000);
+    *name = nameStream.str();
+    *address = addressStream.str();
+}
+
+
+#pragma mark - Tokenizing
+- (void)testTokenize
+{
+    std::vector<std::string> words = rtc::TextIndex::tokenize("  Joe's Caf\xc3\xa9, 1200 E. Colorado-Blvd ");
+    XCTAssertEqual(words.size(), (size_t)7);
+    if (words.size() != 7) return;
+    XCTAssertTrue(words[0] == "joe");
+    XCTAssertTrue(words[1] == "s");
+    XCTAssertTrue(words[2] == "caf\xc3\xa9");     // UTF-8 kept whole
+    XCTAssertTrue(words[3] == "1200");
+    XCTAssertTrue(words[4] == "e");
+    XCTAssertTrue(words[5] == "colorado");
+    XCTAssertTrue(words[6] == "blvd");
+
+    XCTAssertTrue(rtc::TextIndex::tokenize(" ,. ").empty());
+}
+
+
+#pragma mark - Search
+- (void)testPrefixSearch
+{
+    rtc::TextIndex index;
+    index.insert(1, "Starbucks Coffee", "1200 E Colorado Blvd, Pasadena, CA");
+    index.insert(2, "Star Diner", "35 Main St, San Jose, CA");
+    index.insert(3, "Home", "12 Starling Way, Pasadena, CA");
+    XCTAssertEqual(index.size(), (size_t)3);
+
+    std::vector<rtc::TextIndex::PlaceID> results = index.search("star", 10);
+    XCTAssertEqual(results.size(), (size_t)3);
+    // names first, newest first
+    if (results.size() == 3) {
+        XCTAssertEqual(results[0], (rtc::TextIndex::PlaceID)2);
+        XCTAssertEqual(results[1], (rtc::TextIndex::PlaceID)1);
+        XCTAssertEqual(results[2], (rtc::TextIndex::PlaceID)3);
+    }
+
+    // every word must match, in the name or the address
+    results = index.search("STAR coff", 10);
+    XCTAssertEqual(results.size(), (size_t)1);
+    XCTAssertTrue(containsPlace(results, 1));
+
+    results = index.search("pasadena star", 10);
+    XCTAssertEqual(results.size(), (size_t)2);
+    XCTAssertTrue(containsPlace(results, 1) && containsPlace(results, 3));
+
+    XCTAssertTrue(index.search("starz", 10).empty());
+    XCTAssertTrue(index.search("", 10).empty());
+    XCTAssertEqual(index.search("ca", 2).size(), (size_t)2);
+}
+
+- (void)testRenameAndRemove
+{
+    rtc::TextIndex index;
+    index.insert(1, "Gym", "5 Oak St");
+    index.insert(2, "Office", "9 Oak St");
+    XCTAssertEqual(index.search("oak", 10).size(), (size_t)2);
+
+    // renaming replaces the old words
+    index.insert(1, "Climbing Gym", "5 Oak St");
+    XCTAssertTrue(containsPlace(index.search("climb", 10), 1));
+    XCTAssertTrue(containsPlace(index.search("gym", 10), 1));
+    index.insert(1, "Pool", "5 Oak St");
+    XCTAssertTrue(index.search("gym", 10).empty());
+    XCTAssertEqual(index.size(), (size_t)2);
+
+    XCTAssertTrue(index.remove(2));
+    XCTAssertFalse(index.remove(2));
+    XCTAssertFalse(index.contains(2));
+    XCTAssertTrue(index.search("office", 10).empty());
+    XCTAssertEqual(index.search("oak", 10).size(), (size_t)1);
+
+    // a removed place's slot is reused
+    index.insert(3, "Office", "1 Pine St");
+    XCTAssertTrue(containsPlace(index.search("office", 10), 3));
+    XCTAssertFalse(containsPlace(index.search("office", 10), 2));
+
+    std::string name, address;
+    XCTAssertTrue(index.textOf(3, &name, &address));
+    XCTAssertTrue((name == "Office") && (address == "1 Pine St"));
+}
+
+
+#pragma mark - Persistence
+- (void)testRoundTrip
+{
+    rtc::TextIndex index;
+    index.insert(10, "Starbucks Coffee", "1200 E Colorado Blvd");
+    index.insert(11, "Library", "285 E Walnut St");
+    index.insert(12, "Gone", "Nowhere");
+    index.remove(12);
+
+    std::ostringstream output;
+    index.write(output);
+    rtc::TextIndex loaded;
+    std::istringstream input(output.str());
+    XCTAssertTrue(loaded.read(input));
+
+    XCTAssertEqual(loaded.size(), (size_t)2);
+    XCTAssertEqual(loaded.numTerms(), index.numTerms());
+    XCTAssertTrue(containsPlace(loaded.search("e", 10), 10) && containsPlace(loaded.search("e", 10), 11));
+    XCTAssertTrue(loaded.search("gone", 10).empty());
+
+    // and it stays editable
+    loaded.insert(13, "Gym", "1 Walnut St");
+    XCTAssertEqual(loaded.search("walnut", 10).size(), (size_t)2);
+}
+
+- (void)testRejectsDamagedFile
+{
+    rtc::TextIndex index;
+    index.insert(1, "Starbucks Coffee", "1200 E Colorado Blvd");
+    std::ostringstream output;
+    index.write(output);
+    std::string bytes = output.str();
+
+    rtc::TextIndex loaded;
+    std::istringstream truncated(bytes.substr(0, bytes.size() - 3));
+    XCTAssertFalse(loaded.read(truncated));
+    XCTAssertEqual(loaded.size(), (size_t)0);
+
+    std::string badMagic = bytes;
+    badMagic[0] ^= 0xff;
+    std::istringstream badInput(badMagic);
+    XCTAssertFalse(loaded.read(badInput));
+}
+
+
+#pragma mark - Benchmark
+/**
+ * 100,000 places: time to build the index one insert at a time and to load
+ * it from its file, its size, and search latency as each letter of a few
+ * queries is typed.
+ */
+- (void)testSearchPerformance
+{
+    std::vector<std::pair<std::string, std::string> > places(kBenchmarkPlaces);
+    size_t textBytes = 0;
+    for (size_t i = 0; i < kBenchmarkPlaces; ++i) {
+        benchmarkPlace(i, &places[i].first, &places[i].second);
+        textBytes += places[i].first.size() + places[i].second.size();
+    }
+
+    rtc::TextIndex index;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kBenchmarkPlaces; ++i) index.insert(i + 1, places[i].first, places[i].second);
+    double buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::ostringstream output;
+    index.write(output);
+    std::string bytes = output.str();
+    rtc::TextIndex loaded;
+    start = std::chrono::steady_clock::now();
+    std::istringstream input(bytes);
+    XCTAssertTrue(loaded.read(input));
+    double loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // every prefix of each query, as it's typed
+    const char *queries[] = {"golden coffee", "maurice st", "1200 colorado", "pasadena park 5", "sunset"};
+    std::vector<double> latencies;
+    size_t numResults = 0;
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); ++q) {
+        std::string query = queries[q];
+        for (size_t length = 1; length <= query.size(); ++length) {
+            start = std::chrono::steady_clock::now();
+            numResults += loaded.search(query.substr(0, length), kMaxResults).size();
+            latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double p50 = latencies[latencies.size() / 2];
+    double maxLatency = latencies.back();
+
+    NSLog(@"[%@] %lu places, %lu words: built in %.0fms, loaded in %.0fms, %.1fMB on disk (%.1fMB of text); search p50 %.3fms, max %.3fms",
+          NSStringFromSelector(_cmd), (unsigned long)kBenchmarkPlaces, (unsigned long)index.numTerms(), buildTime, loadTime,
+          bytes.size() / 1e6, textBytes / 1e6, p50, maxLatency);
+    XCTAssertGreaterThan(numResults, (size_t)0);
+    XCTAssertLessThan(maxLatency, 5.0);
+
+    rtc::TextIndex *indexPointer = &loaded;
+    [self measureBlock:^{
+        for (size_t length = 1; length <= 13; ++length) {
+            indexPointer->search(std::string("golden coffee").substr(0, length), kMaxResults);
+        }
+    }];
+}
+
+@end
@@ -0,0 +1,458 @@
+//
+//  RTCTilePackTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/30/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include "RTCRouteReplay.h"
+#include "RTCTilePack.h"
+
+// saved places in the benchmark, scattered over a city
+static const size_t kBenchmarkPlaces = 200;
+static const double kBenchmarkCitySize = 8000.0;    // meters
+
+// meters per degree of latitude, near enough for placing test points
+static const double kMetersPerDegree = rtc::kEarthRadius * rtc::kDegreesToRadians;
+
+static const rtc::GeoPoint kCenter(37.3259, -121.9455);
+
+@interface RTCTilePackTests : XCTestCase
+
+@end
+
+@implementation RTCTilePackTests
+
+#pragma mark - Helpers
+/**
+ * Point offset (meters east, meters north) from origin
+ */
+static rtc::GeoPoint offsetPoint(const rtc::GeoPoint &origin, double east, double north)
+{
+    double metersPerDegreeLongitude = kMetersPerDegree * std::cos(origin.latitude * rtc::kDegreesToRadians);
+    return rtc::GeoPoint(origin.latitude + north / kMetersPerDegree,
+                         origin.longitude + east / metersPerDegreeLongitude);
+}
+
+/**
+ * Stand-in for a tile server: the same contents for a tile every time. About
+ * one tile in eight is one of a few blank ones (water, park, empty lot), the
+ * rest are 8-24KB of noise that doesn't compress.
+ */
+static void standInTile(rtc::TileID tile, std::string &contents)
+{
+    std::mt19937_64 generator(tile);
+    uint64_t kind = generator() % 64;
+    if (kind < 8) {
+        contents.assign(600 + 100 * (kind % 3), (char)('a' + kind % 3));
+        return;
+    }
+    contents.assign(8192 + generator() % 16384, '\0');
+    for (size_t i = 0; i + 8 <= contents.size(); i += 8) {
+        uint64_t bits = generator();
+        std::memcpy(&contents[i], &bits, 8);
+    }
+}
+
+/**
+ * Fetch every tile the builder is missing from the stand-in server
+ */
+static size_t fetchMissingTiles(rtc::TilePackBuilder &builder, uint64_t *bytes = NULL)
+{
+    std::vector<rtc::TileID> missing = builder.missingTiles();
+    std::string contents;
+    for (size_t i = 0; i < missing.size(); ++i) {
+        standInTile(missing[i], contents);
+        builder.addTile(missing[i], contents.data(), contents.size());
+        if (bytes) *bytes += contents.size();
+    }
+    return missing.size();
+}
+
+static std::string writePack(const rtc::TilePackBuilder &builder, rtc::TilePackStats *stats = NULL)
+{
+    std::ostringstream output;
+    builder.write(output, stats);
+    return output.str();
+}
+
+/**
+ * Is contents what the stand-in server has for tile?
+ */
+static bool hasStandInContents(const rtc::TilePack &pack, rtc::TileID tile)
+{
+    rtc::TilePack::Tile contents;
+    if (!pack.tile(tile, &contents)) return false;
+    std::string expected;
+    standInTile(tile, expected);
+    return std::string(contents.data, contents.size) == expected;
+}
+
+
+#pragma mark - Tiles
+- (void)testTileIDRoundTrip
+{
+    std::mt19937 generator(1);
+    for (int i = 0; i < 1000; ++i) {
+        unsigned zoom = generator() % (rtc::kMaxTileZoom + 1);
+        uint32_t x = (uint32_t)(generator() % (1u << zoom)), y = (uint32_t)(generator() % (1u << zoom));
+        rtc::TileID tile = rtc::tileID(zoom, x, y);
+        XCTAssertEqual(rtc::tileZoom(tile), zoom);
+        XCTAssertEqual(rtc::tileX(tile), x);
+        XCTAssertEqual(rtc::tileY(tile), y);
+    }
+
+    // zoom levels sort apart, and the four children of a tile sort together
+    XCTAssertLessThan(rtc::tileID(14, 16383, 16383), rtc::tileID(15, 0, 0));
+    rtc::TileID first = rtc::tileID(15, 10, 20), last = rtc::tileID(15, 11, 21);
+    XCTAssertEqual(last - first, (rtc::TileID)3);
+}
+
+- (void)testTileForPoint
+{
+    XCTAssertEqual(rtc::tileForPoint(rtc::GeoPoint(0, 0), 0), rtc::tileID(0, 0, 0));
+    XCTAssertEqual(rtc::tileForPoint(rtc::GeoPoint(0, 0), 1), rtc::tileID(1, 1, 1));
+    XCTAssertEqual(rtc::tileForPoint(rtc::GeoPoint(51.5074, -0.1278), 10), rtc::tileID(10, 511, 340));
+    XCTAssertEqual(rtc::tileForPoint(kCenter, 15), rtc::tileID(15, 5284, 12717));
+
+    // past the edges of the map
+    XCTAssertEqual(rtc::tileForPoint(rtc::GeoPoint(89.9, 179.9), 2), rtc::tileID(2, 3, 0));
+    XCTAssertEqual(rtc::tileForPoint(rtc::GeoPoint(-89.9, -180.0), 2), rtc::tileID(2, 0, 3));
+}
+
+- (void)testTilesAroundCoverRadius
+{
+    std::vector<rtc::TileID> tiles;
+    rtc::tilesAround(kCenter, 400.0, 15, 17, tiles);
+    XCTAssertTrue(std::is_sorted(tiles.begin(), tiles.end()));
+    XCTAssertTrue(std::adjacent_find(tiles.begin(), tiles.end()) == tiles.end());
+
+    std::mt19937 generator(2);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (int i = 0; i < 1000; ++i) {
+        double angle = 2.0 * M_PI * unit(generator), distance = 399.0 * std::sqrt(unit(generator));
+        rtc::GeoPoint point = offsetPoint(kCenter, distance * std::cos(angle), distance * std::sin(angle));
+        for (unsigned zoom = 15; zoom <= 17; ++zoom) {
+            XCTAssertTrue(std::binary_search(tiles.begin(), tiles.end(), rtc::tileForPoint(point, zoom)));
+        }
+    }
+
+    // a circle, not its bounding box: the corners of the box aren't needed
+    std::vector<rtc::TileID> circle;
+    rtc::tilesAround(kCenter, 1000.0, 18, 18, circle);
+    rtc::TileID northWest = rtc::tileForPoint(offsetPoint(kCenter, -1000.0, 1000.0), 18);
+    rtc::TileID southEast = rtc::tileForPoint(offsetPoint(kCenter, 1000.0, -1000.0), 18);
+    size_t box = (rtc::tileX(southEast) - rtc::tileX(northWest) + 1) * (rtc::tileY(southEast) - rtc::tileY(northWest) + 1);
+    XCTAssertLessThan(circle.size(), box * 9 / 10);
+    XCTAssertFalse(std::binary_search(circle.begin(), circle.end(), northWest));
+}
+
+- (void)testTilesAroundWrapAntimeridian
+{
+    std::vector<rtc::TileID> tiles;
+    rtc::tilesAround(rtc::GeoPoint(-16.5, 179.999), 400.0, 10, 10, tiles);
+    XCTAssertTrue(std::binary_search(tiles.begin(), tiles.end(), rtc::tileForPoint(rtc::GeoPoint(-16.5, -179.999), 10)));
+    XCTAssertTrue(std::binary_search(tiles.begin(), tiles.end(), rtc::tileForPoint(rtc::GeoPoint(-16.5, 179.999), 10)));
+}
+
+- (void)testTilesAlongCoverRoute
+{
+    std::vector<rtc::GeoPoint> route;
+    route.push_back(kCenter);
+    route.push_back(offsetPoint(kCenter, 1500.0, 0.0));
+    route.push_back(offsetPoint(kCenter, 1500.0, 1200.0));
+
+    std::vector<rtc::TileID> tiles;
+    rtc::tilesAlong(route, 100.0, 17, 17, tiles);
+    for (double d = 0; d <= 2700.0; d += 10.0) {
+        rtc::GeoPoint onRoute = (d <= 1500.0) ? offsetPoint(kCenter, d, 0.0)
+                                              : offsetPoint(kCenter, 1500.0, d - 1500.0);
+        // either side of the route, a little inside the corridor
+        rtc::GeoPoint left = (d <= 1500.0) ? offsetPoint(onRoute, 0.0, 80.0) : offsetPoint(onRoute, -80.0, 0.0);
+        rtc::GeoPoint right = (d <= 1500.0) ? offsetPoint(onRoute, 0.0, -80.0) : offsetPoint(onRoute, 80.0, 0.0);
+        XCTAssertTrue(std::binary_search(tiles.begin(), tiles.end(), rtc::tileForPoint(onRoute, 17)));
+        XCTAssertTrue(std::binary_search(tiles.begin(), tiles.end(), rtc::tileForPoint(left, 17)));
+        XCTAssertTrue(std::binary_search(tiles.begin(), tiles.end(), rtc::tileForPoint(right, 17)));
+    }
+
+    // nowhere near the far corner of the L
+    rtc::TileID corner = rtc::tileForPoint(offsetPoint(kCenter, 0.0, 1200.0), 17);
+    XCTAssertFalse(std::binary_search(tiles.begin(), tiles.end(), corner));
+}
+
+
+#pragma mark - Pack
+- (void)testPackRoundTrip
+{
+    rtc::TilePackPolicy policy;
+    rtc::TilePackBuilder builder;
+    std::vector<rtc::TileID> tiles = rtc::neighbourhoodTiles(kCenter, std::vector<rtc::GeoPoint>(), policy);
+    builder.setRegion("home", tiles, 1000.0);
+    XCTAssertEqual(builder.missingTiles().size(), tiles.size());
+    fetchMissingTiles(builder);
+    XCTAssertTrue(builder.missingTiles().empty());
+
+    rtc::TilePackStats stats;
+    std::string file = writePack(builder, &stats);
+    XCTAssertEqual(stats.byteSize, (uint64_t)file.size());
+    XCTAssertEqual(builder.byteSize(), (uint64_t)file.size());
+    XCTAssertEqual(stats.numTiles, tiles.size());
+
+    rtc::TilePack pack;
+    XCTAssertTrue(pack.attach(file.data(), file.size()));
+    XCTAssertEqual(pack.numTiles(), tiles.size());
+    for (size_t i = 0; i < tiles.size(); ++i) XCTAssertTrue(hasStandInContents(pack, tiles[i]));
+    XCTAssertFalse(pack.contains(rtc::tileForPoint(offsetPoint(kCenter, 5000.0, 0.0), 16)));
+
+    XCTAssertEqual(pack.numRegions(), (size_t)1);
+    XCTAssertTrue(pack.regionName(0) == "home");
+    XCTAssertEqual(pack.regionLastUsed(0), 1000.0);
+    XCTAssertTrue(pack.regionTiles(0) == tiles);
+
+    std::istringstream input(file);
+    rtc::TilePack readPack;
+    XCTAssertTrue(readPack.read(input));
+    XCTAssertEqual(readPack.numTiles(), tiles.size());
+    XCTAssertTrue(hasStandInContents(readPack, tiles.back()));
+}
+
+- (void)testDuplicateTilesShareContents
+{
+    std::vector<rtc::TileID> tiles;
+    rtc::tilesAround(kCenter, 1000.0, 17, 17, tiles);
+    rtc::TilePackBuilder builder;
+    builder.setRegion("lake", tiles, 0);
+    std::string water(2000, 'w');
+    for (size_t i = 0; i < tiles.size(); ++i) builder.addTile(tiles[i], water.data(), water.size());
+    XCTAssertEqual(builder.numBlobs(), (size_t)1);
+
+    std::string file = writePack(builder);
+    XCTAssertLessThan(file.size(), tiles.size() * 64 + water.size());
+    rtc::TilePack pack;
+    XCTAssertTrue(pack.attach(file.data(), file.size()));
+    rtc::TilePack::Tile first, last;
+    XCTAssertTrue(pack.tile(tiles.front(), &first));
+    XCTAssertTrue(pack.tile(tiles.back(), &last));
+    XCTAssertEqual(first.data, last.data);
+
+    // replacing a shared tile's contents leaves the others alone
+    std::string boat(2000, 'b');
+    builder.addTile(tiles[0], boat.data(), boat.size());
+    XCTAssertEqual(builder.numBlobs(), (size_t)2);
+    file = writePack(builder);
+    XCTAssertTrue(pack.attach(file.data(), file.size()));
+    XCTAssertTrue(pack.tile(tiles[0], &first));
+    XCTAssertTrue(pack.tile(tiles[1], &last));
+    XCTAssertTrue(std::string(first.data, first.size) == boat);
+    XCTAssertTrue(std::string(last.data, last.size) == water);
+}
+
+- (void)testRebuildKeepsOldTiles
+{
+    rtc::TilePackPolicy policy;
+    rtc::TilePackBuilder first;
+    std::vector<rtc::TileID> homeTiles = rtc::neighbourhoodTiles(kCenter, std::vector<rtc::GeoPoint>(), policy);
+    first.setRegion("home", homeTiles, 1.0);
+    fetchMissingTiles(first);
+    std::string oldFile = writePack(first);
+    rtc::TilePack oldPack;
+    XCTAssertTrue(oldPack.attach(oldFile.data(), oldFile.size()));
+
+    // a place next door shares some tiles, which aren't fetched again
+    rtc::TilePackBuilder second(oldPack);
+    XCTAssertTrue(second.hasRegion("home"));
+    XCTAssertTrue(second.missingTiles().empty());
+    std::vector<rtc::TileID> workTiles = rtc::neighbourhoodTiles(offsetPoint(kCenter, 500.0, 0.0),
+                                                                 std::vector<rtc::GeoPoint>(), policy);
+    second.setRegion("work", workTiles, 2.0);
+    size_t numFetched = fetchMissingTiles(second);
+    XCTAssertLessThan(numFetched, workTiles.size());
+
+    std::string newFile = writePack(second);
+    rtc::TilePack newPack;
+    XCTAssertTrue(newPack.attach(newFile.data(), newFile.size()));
+    XCTAssertEqual(newPack.numRegions(), (size_t)2);
+    for (size_t i = 0; i < homeTiles.size(); ++i) XCTAssertTrue(hasStandInContents(newPack, homeTiles[i]));
+    for (size_t i = 0; i < workTiles.size(); ++i) XCTAssertTrue(hasStandInContents(newPack, workTiles[i]));
+}
+
+- (void)testEvictsLeastRecentlyUsed
+{
+    rtc::TilePackPolicy policy;
+    rtc::TilePackBuilder builder;
+    const char *names[] = {"old", "middle", "new"};
+    std::vector<rtc::TileID> tiles[3];
+    for (int i = 0; i < 3; ++i) {
+        tiles[i] = rtc::neighbourhoodTiles(offsetPoint(kCenter, 3000.0 * i, 0.0), std::vector<rtc::GeoPoint>(), policy);
+        builder.setRegion(names[i], tiles[i], 100.0 * (i + 1));
+    }
+    fetchMissingTiles(builder);
+    uint64_t fullSize = builder.byteSize();
+
+    // used again, "old" is now the newest
+    builder.setRegion("old", tiles[0], 400.0);
+
+    // room for about two of the three
+    XCTAssertEqual(builder.evict(fullSize * 3 / 4), (size_t)1);
+    XCTAssertFalse(builder.hasRegion("middle"));
+    XCTAssertTrue(builder.hasRegion("old"));
+    XCTAssertTrue(builder.hasRegion("new"));
+    XCTAssertLessThanOrEqual(builder.byteSize(), fullSize * 3 / 4);
+    for (size_t i = 0; i < tiles[1].size(); ++i) XCTAssertFalse(builder.hasTile(tiles[1][i]));
+
+    // the newest region stays even if it alone is too big
+    XCTAssertEqual(builder.evict(0), (size_t)1);
+    XCTAssertTrue(builder.hasRegion("old"));
+    XCTAssertEqual(builder.numTiles(), tiles[0].size());
+    XCTAssertEqual(builder.byteSize(), (uint64_t)writePack(builder).size());
+}
+
+- (void)testSharedTilesOutliveOneRegion
+{
+    rtc::TilePackPolicy policy;
+    rtc::TilePackBuilder builder;
+    std::vector<rtc::TileID> here = rtc::neighbourhoodTiles(kCenter, std::vector<rtc::GeoPoint>(), policy);
+    std::vector<rtc::TileID> nextDoor = rtc::neighbourhoodTiles(offsetPoint(kCenter, 50.0, 0.0),
+                                                                std::vector<rtc::GeoPoint>(), policy);
+    builder.setRegion("here", here, 1.0);
+    builder.setRegion("next door", nextDoor, 2.0);
+    fetchMissingTiles(builder);
+
+    builder.removeRegion("here");
+    for (size_t i = 0; i < nextDoor.size(); ++i) XCTAssertTrue(builder.hasTile(nextDoor[i]));
+    XCTAssertEqual(builder.numTiles(), nextDoor.size());
+}
+
+- (void)testRejectsCorruptPack
+{
+    rtc::TilePackBuilder builder;
+    std::vector<rtc::TileID> tiles = rtc::neighbourhoodTiles(kCenter, std::vector<rtc::GeoPoint>(), rtc::TilePackPolicy());
+    builder.setRegion("home", tiles, 0);
+    fetchMissingTiles(builder);
+    std::string file = writePack(builder);
+
+    rtc::TilePack pack;
+    XCTAssertFalse(pack.attach(file.data(), file.size() - 8));
+    XCTAssertFalse(pack.attach(file.data(), 16));
+    std::string badMagic = file;
+    badMagic[0] ^= 0xff;
+    XCTAssertFalse(pack.attach(badMagic.data(), badMagic.size()));
+    XCTAssertTrue(pack.empty());
+
+    std::istringstream empty("");
+    XCTAssertFalse(pack.read(empty));
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Prefetch the neighbourhoods of saved places across a city, each with a
+ * route to it, from the stand-in tile server. Then look tiles up, and evict
+ * down to half the size.
+ */
+- (void)testPackPerformance
+{
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    rtc::TilePackPolicy policy;
+    rtc::GridDirectionsProvider provider;
+
+    // prefetch one place at a time, as the app does, starting from the last
+    //   pack each time
+    std::string file;
+    rtc::TilePack pack;
+    size_t numWanted = 0, numFetched = 0;
+    uint64_t fetchedBytes = 0, writtenBytes = 0;
+    double fetchTime = 0, writeTime = 0;
+    for (size_t p = 0; p < kBenchmarkPlaces; ++p) {
+        rtc::GeoPoint place = offsetPoint(kCenter, kBenchmarkCitySize * (unit(generator) - 0.5),
+                                          kBenchmarkCitySize * (unit(generator) - 0.5));
+        rtc::GeoPoint origin = offsetPoint(place, 2000.0 * (unit(generator) - 0.5), 2000.0 * (unit(generator) - 0.5));
+        rtc::Route route;
+        provider.walkingRoute(origin, place, route);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        rtc::TilePackBuilder builder(pack);
+        std::ostringstream name;
+        name << "place " << p;
+        std::vector<rtc::TileID> tiles = rtc::neighbourhoodTiles(place, route.polyline, policy);
+        builder.setRegion(name.str(), tiles, (double)p);
+        numFetched += fetchMissingTiles(builder, &fetchedBytes);
+        std::chrono::steady_clock::time_point fetched = std::chrono::steady_clock::now();
+        fetchTime += std::chrono::duration<double>(fetched - start).count();
+
+        std::string newFile = writePack(builder);
+        file.swap(newFile);
+        XCTAssertTrue(pack.attach(file.data(), file.size()));
+        writeTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - fetched).count();
+        writtenBytes += file.size();
+        numWanted += tiles.size();
+    }
+    NSLog(@"[%@] %lu places: %.0f tiles each, %lu tiles in pack (%lu distinct), %.2fMB, %.0fKB per place",
+          NSStringFromSelector(_cmd), (unsigned long)kBenchmarkPlaces, (double)numWanted / kBenchmarkPlaces,
+          (unsigned long)pack.numTiles(), (unsigned long)pack.numBlobs(), file.size() / 1048576.0,
+          file.size() / 1024.0 / kBenchmarkPlaces);
+    NSLog(@"[%@] prefetch: %lu tiles fetched at %.0f tiles/s (%.0fMB/s) hashed and added; pack rewritten at %.0fMB/s, %.1fms per place",
+          NSStringFromSelector(_cmd), (unsigned long)numFetched, numFetched / fetchTime,
+          fetchedBytes / 1048576.0 / fetchTime, writtenBytes / 1048576.0 / writeTime,
+          1000.0 * writeTime / kBenchmarkPlaces);
+    XCTAssertLessThan(pack.numBlobs(), pack.numTiles());
+    XCTAssertEqual(pack.numRegions(), kBenchmarkPlaces);
+
+    // look up tiles the map would ask for: mostly in the pack, some not
+    std::vector<rtc::TileID> queries;
+    for (int i = 0; i < 100000; ++i) {
+        queries.push_back((unit(generator) < 0.8) ? pack.tileAt((size_t)(unit(generator) * pack.numTiles()))
+                                                  : rtc::tileForPoint(offsetPoint(kCenter, 20000.0 * unit(generator), 0), 16));
+    }
+    std::vector<double> latencies;
+    size_t numFound = 0;
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        rtc::TilePack::Tile contents;
+        if (pack.tile(queries[i], &contents)) {
+            ++numFound;
+            checksum += (unsigned char)contents.data[0];
+        }
+        latencies.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    }
+    double meanLatency = 0;
+    for (size_t i = 0; i < latencies.size(); ++i) meanLatency += latencies[i];
+    meanLatency /= latencies.size();
+    std::sort(latencies.begin(), latencies.end());
+    NSLog(@"[%@] lookup: mean %.0fns, p99 %.0fns over %lu lookups (%lu hits, checksum %llu)",
+          NSStringFromSelector(_cmd), meanLatency, latencies[latencies.size() * 99 / 100],
+          (unsigned long)queries.size(), (unsigned long)numFound, (unsigned long long)checksum);
+    XCTAssertGreaterThan(numFound, queries.size() / 2);
+
+    // half the budget: the oldest places go
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    rtc::TilePackBuilder builder(pack);
+    size_t numEvicted = builder.evict(file.size() / 2);
+    std::string evictedFile = writePack(builder);
+    double evictTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    NSLog(@"[%@] evict to %.2fMB: %lu places dropped in %.1fms",
+          NSStringFromSelector(_cmd), evictedFile.size() / 1048576.0, (unsigned long)numEvicted, evictTime);
+    XCTAssertLessThanOrEqual(evictedFile.size(), file.size() / 2);
+    XCTAssertTrue(builder.hasRegion("place 199"));
+    XCTAssertFalse(builder.hasRegion("place 0"));
+
+    rtc::TilePack *packPointer = &pack;
+    std::vector<rtc::TileID> *queriesPointer = &queries;
+    [self measureBlock:^{
+        size_t found = 0;
+        for (size_t i = 0; i < queriesPointer->size(); ++i) found += packPointer->contains((*queriesPointer)[i]);
+        XCTAssertGreaterThan(found, (size_t)0);
+    }];
+}
+
+@end
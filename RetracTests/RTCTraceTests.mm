@@ -0,0 +1,268 @@
+//
+//  RTCTraceTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/25/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include "RTCTrace.h"
+
+// calls timed by the benchmark
+static const size_t kBenchmarkCalls = 1000000;
+
+@interface RTCTraceTests : XCTestCase
+
+@end
+
+@implementation RTCTraceTests
+
+#pragma mark - Helpers
+static const rtc::TraceMetric *metricNamed(const std::vector<rtc::TraceMetric> &metrics, const char *name)
+{
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        if (metrics[i].name == name) return &metrics[i];
+    }
+    return NULL;
+}
+
+static size_t occurrences(const std::string &text, const std::string &pattern)
+{
+    size_t count = 0;
+    for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) ++count;
+    return count;
+}
+
+
+#pragma mark - Disabled
+- (void)testDisabledRecordsNothing
+{
+    rtc::ManualClock clock(10.0);
+    rtc::Tracer tracer(clock);
+    XCTAssertFalse(tracer.enabled());
+
+    rtc::Tracer::SpanID span = tracer.beginSpan("document.open");
+    XCTAssertEqual(span, rtc::Tracer::kNoSpan);
+    clock.advance(1.0);
+    tracer.endSpan(span);
+    tracer.addCounter("location.cacheHits");
+    tracer.recordValue("location.accuracy", 65.0);
+    { rtc::TraceScope scope(tracer, "index.rebuild"); }
+
+    XCTAssertEqual(tracer.numEvents(), (size_t)0);
+    XCTAssertTrue(tracer.summary().empty());
+}
+
+- (void)testSpanBegunWhileEnabledEndsAfterDisabling
+{
+    rtc::ManualClock clock;
+    rtc::Tracer tracer(clock);
+    tracer.setEnabled(true);
+
+    rtc::Tracer::SpanID span = tracer.beginSpan("geocode.lookup");
+    tracer.setEnabled(false);
+    clock.advance(0.5);
+    tracer.endSpan(span);
+
+    std::vector<rtc::TraceMetric> metrics = tracer.summary();
+    XCTAssertEqual(metrics.size(), (size_t)1);
+    XCTAssertEqualWithAccuracy(metrics[0].max, 0.5, 1e-9);
+}
+
+
+#pragma mark - Spans
+- (void)testSpansEndInAnyOrder
+{
+    rtc::ManualClock clock;
+    rtc::Tracer tracer(clock);
+    tracer.setEnabled(true);
+
+    // two lookups overlapping, the first finishing last
+    rtc::Tracer::SpanID first = tracer.beginSpan("directions.mapkit");
+    clock.advance(1.0);
+    rtc::Tracer::SpanID second = tracer.beginSpan("directions.mapkit");
+    clock.advance(2.0);
+    tracer.endSpan(second);
+    clock.advance(1.0);
+    tracer.endSpan(first);
+
+    const rtc::TraceMetric *metric = metricNamed(tracer.summary(), "directions.mapkit");
+    XCTAssertTrue(metric != NULL);
+    if (!metric) return;
+    XCTAssertEqual(metric->kind, rtc::TraceMetric::KindSpan);
+    XCTAssertEqual(metric->count, 2u);
+    XCTAssertEqualWithAccuracy(metric->mean, 3.0, 1e-9);
+    XCTAssertEqualWithAccuracy(metric->max, 4.0, 1e-9);
+
+    // ending twice doesn't count twice
+    tracer.endSpan(first);
+    XCTAssertEqual(tracer.numEvents(), (size_t)2);
+}
+
+- (void)testScopeSpansItsLifetime
+{
+    rtc::ManualClock clock;
+    rtc::Tracer tracer(clock);
+    tracer.setEnabled(true);
+
+    {
+        rtc::TraceScope scope(tracer, "index.rebuild");
+        clock.advance(0.25);
+    }
+
+    const rtc::TraceMetric *metric = metricNamed(tracer.summary(), "index.rebuild");
+    XCTAssertTrue(metric && (metric->count == 1));
+    if (metric) XCTAssertEqualWithAccuracy(metric->max, 0.25, 1e-9);
+}
+
+- (void)testSpanEndsOnAnotherThread
+{
+    rtc::ManualClock clock;
+    rtc::Tracer tracer(clock);
+    tracer.setEnabled(true);
+
+    rtc::Tracer::SpanID span = tracer.beginSpan("document.open");
+    clock.advance(0.1);
+    std::thread completion([&tracer, span]() { tracer.endSpan(span); });
+    completion.join();
+
+    XCTAssertEqual(tracer.numEvents(), (size_t)1);
+}
+
+
+#pragma mark - Counters and Histograms
+- (void)testCountersAddUp
+{
+    rtc::ManualClock clock;
+    rtc::Tracer tracer(clock);
+    tracer.setEnabled(true);
+
+    tracer.addCounter("location.cacheHits");
+    tracer.addCounter("location.cacheHits");
+    tracer.addCounter("location.cacheHits", 3.0);
+
+    const rtc::TraceMetric *metric = metricNamed(tracer.summary(), "location.cacheHits");
+    XCTAssertTrue(metric != NULL);
+    if (!metric) return;
+    XCTAssertEqual(metric->kind, rtc::TraceMetric::KindCounter);
+    XCTAssertEqual(metric->count, 3u);
+    XCTAssertEqualWithAccuracy(metric->total, 5.0, 1e-9);
+}
+
+- (void)testHistogramPercentiles
+{
+    rtc::ManualClock clock;
+    rtc::Tracer tracer(clock);
+    tracer.setEnabled(true);
+
+    for (int value = 1; value <= 101; ++value) tracer.recordValue("location.accuracy", value);
+
+    const rtc::TraceMetric *metric = metricNamed(tracer.summary(), "location.accuracy");
+    XCTAssertTrue(metric != NULL);
+    if (!metric) return;
+    XCTAssertEqual(metric->kind, rtc::TraceMetric::KindHistogram);
+    XCTAssertEqual(metric->count, 101u);
+    XCTAssertEqualWithAccuracy(metric->mean, 51.0, 1e-9);
+    XCTAssertEqualWithAccuracy(metric->p50, 51.0, 1e-9);
+    XCTAssertEqualWithAccuracy(metric->p90, 91.0, 1e-9);
+    XCTAssertEqualWithAccuracy(metric->p99, 100.0, 1e-9);
+    XCTAssertEqualWithAccuracy(metric->max, 101.0, 1e-9);
+}
+
+- (void)testEventsPastTheLimitAreDropped
+{
+    rtc::ManualClock clock;
+    rtc::Tracer tracer(clock, 10);
+    tracer.setEnabled(true);
+
+    for (int i = 0; i < 15; ++i) tracer.recordValue("location.accuracy", i);
+    XCTAssertEqual(tracer.numEvents(), (size_t)10);
+    XCTAssertEqual(tracer.numDropped(), (size_t)5);
+
+    tracer.clear();
+    XCTAssertEqual(tracer.numEvents(), (size_t)0);
+    XCTAssertEqual(tracer.numDropped(), (size_t)0);
+}
+
+
+#pragma mark - Export
+- (void)testChromeTrace
+{
+    rtc::ManualClock clock(1000.0);
+    rtc::Tracer tracer(clock);
+    tracer.setEnabled(true);
+
+    rtc::Tracer::SpanID span = tracer.beginSpan("document.open");
+    clock.advance(0.002);
+    tracer.endSpan(span);
+    tracer.addCounter("geocode.lookups");
+    tracer.recordValue("location.accuracy", 65.0);
+    tracer.recordValue("odd \"name\"", 1.0);
+
+    std::ostringstream out;
+    tracer.writeChromeTrace(out);
+    std::string json = out.str();
+
+    // times are microseconds from when the tracer started
+    XCTAssertEqual(json.find("{\"traceEvents\":["), (size_t)0);
+    XCTAssertNotEqual(json.find("\"name\":\"document.open\",\"cat\":\"retrac\",\"pid\":1,\"tid\":1,\"ts\":0,\"ph\":\"X\",\"dur\":2000}"),
+                      std::string::npos);
+    XCTAssertNotEqual(json.find("\"ph\":\"C\",\"args\":{\"value\":1}"), std::string::npos);
+    XCTAssertNotEqual(json.find("\"ph\":\"i\",\"s\":\"t\",\"args\":{\"value\":65}"), std::string::npos);
+    XCTAssertNotEqual(json.find("\"name\":\"odd \\\"name\\\"\""), std::string::npos);
+    XCTAssertEqual(occurrences(json, "\"name\":"), (size_t)4);
+    XCTAssertNotEqual(json.find("\"droppedEvents\":0}}"), std::string::npos);
+}
+
+- (void)testSummaryTable
+{
+    rtc::ManualClock clock;
+    rtc::Tracer tracer(clock);
+    tracer.setEnabled(true);
+
+    rtc::Tracer::SpanID span = tracer.beginSpan("directions.route");
+    clock.advance(0.125);
+    tracer.endSpan(span);
+    tracer.addCounter("directions.cacheHits", 2.0);
+
+    std::ostringstream out;
+    tracer.writeSummary(out);
+    std::string table = out.str();
+    XCTAssertNotEqual(table.find("directions.route"), std::string::npos);
+    XCTAssertNotEqual(table.find("125.000 ms"), std::string::npos);
+    XCTAssertNotEqual(table.find("total 2"), std::string::npos);
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Cost of a span while tracing is off, which is what every instrumented call
+ * site pays in a normal run, and while it's on.
+ */
+- (void)testSpanOverheadPerformance
+{
+    rtc::Tracer tracer(rtc::SteadyClock::sharedClock(), kBenchmarkCalls);
+    rtc::Tracer *tracerPointer = &tracer;
+
+    double nanoseconds[2];
+    for (int enabled = 0; enabled < 2; ++enabled) {
+        tracer.setEnabled(enabled != 0);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < kBenchmarkCalls; ++i) tracer.endSpan(tracer.beginSpan("benchmark.span"));
+        nanoseconds[enabled] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / kBenchmarkCalls;
+        NSLog(@"[%@] tracing %@: %.1fns per span", NSStringFromSelector(_cmd), enabled ? @"on" : @"off", nanoseconds[enabled]);
+    }
+    XCTAssertEqual(tracer.numEvents(), kBenchmarkCalls);
+    XCTAssertLessThan(nanoseconds[0], nanoseconds[1]);
+
+    tracer.setEnabled(false);
+    [self measureBlock:^{
+        for (size_t i = 0; i < kBenchmarkCalls; ++i) tracerPointer->endSpan(tracerPointer->beginSpan("benchmark.span"));
+    }];
+}
+
+@end
@@ -0,0 +1,249 @@
+//
+//  RTCTrailTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/13/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include "RTCTrail.h"
+
+// number of synthetic walks in the benchmark, and how long each one is
+static const NSUInteger kNumBenchmarkWalks = 20;
+static const double kBenchmarkWalkHours = 3.0;
+
+// meters per degree of latitude, near enough for building test walks
+static const double kMetersPerDegree = rtc::kEarthRadius * rtc::kDegreesToRadians;
+
+@interface RTCTrailTests : XCTestCase
+
+@end
+
+@implementation RTCTrailTests
+
+#pragma mark - Helpers
+/**
+ * A walk at about 1.4m/s with one fix a second, wandering heading, the odd
+ * sharp turn and a pause now and then. Fixes carry GPS-like noise.
+ */
+static std::vector<rtc::LocationFix> syntheticWalk(std::mt19937 &generator, double hours)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> noise(0.0, 3.0);
+    std::vector<rtc::LocationFix> fixes;
+
+    double latitude = 37.3259, longitude = -121.9455;
+    double heading = 2.0 * M_PI * unit(generator);
+    double metersPerDegreeLongitude = kMetersPerDegree * std::cos(latitude * rtc::kDegreesToRadians);
+    size_t numFixes = (size_t)(hours * 3600.0);
+    size_t pausedUntil = 0;
+
+    for (size_t t = 0; t < numFixes; ++t) {
+        if (t >= pausedUntil) {
+            if (unit(generator) < 0.002) pausedUntil = t + 30 + (size_t)(120 * unit(generator));
+            heading += 0.05 * (unit(generator) - 0.5);
+            if (unit(generator) < 0.005) heading += (unit(generator) < 0.5 ? -1.0 : 1.0) * M_PI_2;
+
+            double speed = 1.2 + 0.4 * unit(generator);
+            latitude += speed * std::cos(heading) / kMetersPerDegree;
+            longitude += speed * std::sin(heading) / metersPerDegreeLongitude;
+        }
+
+        double accuracy = (unit(generator) < 0.02) ? 80.0 : 5.0 + 10.0 * unit(generator);
+        fixes.push_back(rtc::LocationFix(t, latitude + noise(generator) / kMetersPerDegree,
+                                         longitude + noise(generator) / metersPerDegreeLongitude, accuracy));
+    }
+    return fixes;
+}
+
+/**
+ * Distance (meters) from point to the nearest segment of trail
+ */
+static double distanceToTrail(const rtc::GeoPoint &point, const rtc::Trail &trail)
+{
+    double metersPerDegreeLongitude = kMetersPerDegree * std::cos(point.latitude * rtc::kDegreesToRadians);
+    double best = HUGE_VAL;
+    for (size_t i = 0; i + 1 < trail.size(); ++i) {
+        double ax = (trail[i].coordinate.longitude - point.longitude) * metersPerDegreeLongitude;
+        double ay = (trail[i].coordinate.latitude - point.latitude) * kMetersPerDegree;
+        double bx = (trail[i + 1].coordinate.longitude - point.longitude) * metersPerDegreeLongitude;
+        double by = (trail[i + 1].coordinate.latitude - point.latitude) * kMetersPerDegree;
+        double dx = bx - ax, dy = by - ay;
+        double lengthSquared = dx * dx + dy * dy;
+        double t = (lengthSquared > 0) ? std::max(0.0, std::min(1.0, -(ax * dx + ay * dy) / lengthSquared)) : 0.0;
+        best = std::min(best, std::hypot(ax + t * dx, ay + t * dy));
+    }
+    return best;
+}
+
+
+#pragma mark - Simplification
+- (void)testStraightLineCollapses
+{
+    rtc::TrailSimplifier simplifier;
+    rtc::Trail trail;
+    for (int t = 0; t < 50; ++t) {
+        simplifier.addFix(rtc::LocationFix(t, 37.0 + t * 10.0 / kMetersPerDegree, -121.0, 5.0), trail);
+    }
+    simplifier.finish(trail);
+
+    XCTAssertEqual(trail.size(), (size_t)2);
+    XCTAssertEqual(trail.front().timestamp, 0.0);
+    XCTAssertEqual(trail.back().timestamp, 49.0);
+}
+
+- (void)testCornerIsKept
+{
+    rtc::TrailSimplifier simplifier;
+    rtc::Trail trail;
+    for (int t = 0; t <= 20; ++t) {
+        // 200m north then 200m east
+        double north = std::min(t, 10) * 20.0;
+        double east = std::max(t - 10, 0) * 20.0;
+        simplifier.addFix(rtc::LocationFix(t, 37.0 + north / kMetersPerDegree, -121.0 + east / kMetersPerDegree, 5.0), trail);
+    }
+    simplifier.finish(trail);
+
+    XCTAssertEqual(trail.size(), (size_t)3);
+    XCTAssertEqual(trail[1].timestamp, 10.0);
+}
+
+- (void)testFilterDropsBadFixes
+{
+    rtc::TrailSimplifier simplifier;
+    rtc::Trail trail;
+    XCTAssertTrue(simplifier.addFix(rtc::LocationFix(0, 37.0, -121.0, 5.0), trail));
+    XCTAssertFalse(simplifier.addFix(rtc::LocationFix(1, 37.001, -121.0, -1.0), trail));     // invalid
+    XCTAssertFalse(simplifier.addFix(rtc::LocationFix(2, 37.001, -121.0, 200.0), trail));    // inaccurate
+    XCTAssertFalse(simplifier.addFix(rtc::LocationFix(3, 37.0 + 1.0 / kMetersPerDegree, -121.0, 5.0), trail)); // jitter
+    XCTAssertFalse(simplifier.addFix(rtc::LocationFix(0, 37.001, -121.0, 5.0), trail));      // out of order
+    XCTAssertTrue(simplifier.addFix(rtc::LocationFix(4, 37.001, -121.0, 5.0), trail));
+
+    XCTAssertEqual(simplifier.numFixesReceived(), (size_t)6);
+    XCTAssertEqual(simplifier.numFixesKept(), (size_t)2);
+
+    rtc::TrailPoint tail;
+    XCTAssertTrue(simplifier.pendingTail(&tail));
+    XCTAssertEqual(tail.timestamp, 4.0);
+}
+
+- (void)testKeptFixesStayWithinTolerance
+{
+    std::mt19937 generator(7);
+    std::vector<rtc::LocationFix> fixes = syntheticWalk(generator, 0.5);
+
+    rtc::TrailPolicy policy;
+    rtc::TrailSimplifier simplifier(policy);
+    rtc::Trail trail, kept;
+    for (size_t i = 0; i < fixes.size(); ++i) {
+        if (simplifier.addFix(fixes[i], trail)) {
+            kept.push_back(rtc::TrailPoint(fixes[i].timestamp, rtc::GeoPoint(fixes[i].latitude, fixes[i].longitude), 0));
+        }
+    }
+    simplifier.finish(trail);
+
+    XCTAssertLessThan(trail.size(), kept.size() / 4);
+    for (size_t i = 0; i < kept.size(); ++i) {
+        XCTAssertLessThanOrEqual(distanceToTrail(kept[i].coordinate, trail), policy.tolerance + 0.5, @"fix %zu", i);
+    }
+}
+
+
+#pragma mark - Storage
+- (void)testTrailFileRoundTrip
+{
+    rtc::Trail trail;
+    trail.push_back(rtc::TrailPoint(1000.0, rtc::GeoPoint(37.3259123, -121.9455987), 7.3));
+    trail.push_back(rtc::TrailPoint(1012.25, rtc::GeoPoint(-33.8688, 151.2093), 12.0));
+
+    std::stringstream file;
+    rtc::writeTrailHeader(file, 1000.0);
+    rtc::appendTrailPoints(file, 1000.0, rtc::Trail(trail.begin(), trail.begin() + 1));
+    rtc::appendTrailPoints(file, 1000.0, rtc::Trail(trail.begin() + 1, trail.end()));
+    XCTAssertEqual(file.str().size(), rtc::kTrailFileHeaderSize + 2 * rtc::kTrailFileRecordSize);
+
+    // a torn append at the end is ignored
+    file.write("\x01\x02\x03", 3);
+
+    rtc::Trail loaded;
+    double startTime = 0;
+    XCTAssertTrue(rtc::readTrail(file, loaded, &startTime));
+    XCTAssertEqual(startTime, 1000.0);
+    XCTAssertEqual(loaded.size(), trail.size());
+    for (size_t i = 0; i < std::min(loaded.size(), trail.size()); ++i) {
+        XCTAssertEqualWithAccuracy(loaded[i].timestamp, trail[i].timestamp, 1e-3);
+        XCTAssertEqualWithAccuracy(loaded[i].coordinate.latitude, trail[i].coordinate.latitude, 1e-7);
+        XCTAssertEqualWithAccuracy(loaded[i].coordinate.longitude, trail[i].coordinate.longitude, 1e-7);
+        XCTAssertEqualWithAccuracy(loaded[i].horizontalAccuracy, trail[i].horizontalAccuracy, 0.1);
+    }
+
+    std::istringstream garbage("not a trail file");
+    XCTAssertFalse(rtc::readTrail(garbage, loaded));
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Record a batch of multi-hour synthetic walks and log ingest rate and the
+ * storage cost per kilometer walked.
+ */
+- (void)testRecordSyntheticWalksPerformance
+{
+    std::mt19937 generator(2014);
+    std::vector<std::vector<rtc::LocationFix> > walks;
+    for (NSUInteger i = 0; i < kNumBenchmarkWalks; ++i) walks.push_back(syntheticWalk(generator, kBenchmarkWalkHours));
+
+    size_t numFixes = 0, numPoints = 0, numBytes = 0;
+    double meters = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t w = 0; w < walks.size(); ++w) {
+        rtc::TrailSimplifier simplifier;
+        rtc::Trail trail;
+        std::ostringstream file;
+        rtc::writeTrailHeader(file, 0);
+
+        rtc::Trail committed;
+        for (size_t i = 0; i < walks[w].size(); ++i) {
+            committed.clear();
+            simplifier.addFix(walks[w][i], committed);
+            rtc::appendTrailPoints(file, 0, committed);
+            trail.insert(trail.end(), committed.begin(), committed.end());
+        }
+        committed.clear();
+        simplifier.finish(committed);
+        rtc::appendTrailPoints(file, 0, committed);
+        trail.insert(trail.end(), committed.begin(), committed.end());
+
+        numFixes += walks[w].size();
+        numPoints += trail.size();
+        numBytes += file.str().size();
+        meters += rtc::trailLength(trail);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double bytesPerKilometer = numBytes / (meters / 1000.0);
+    NSLog(@"[%@] %lu walks of %.0fh: %.2e fixes/s, %zu fixes -> %zu points, %.1f km, %.0f bytes/km",
+          NSStringFromSelector(_cmd), (unsigned long)kNumBenchmarkWalks, kBenchmarkWalkHours,
+          numFixes / seconds, numFixes, numPoints, meters / 1000.0, bytesPerKilometer);
+
+    const std::vector<rtc::LocationFix> *walk = &walks[0];
+    [self measureBlock:^{
+        rtc::TrailSimplifier simplifier;
+        rtc::Trail trail;
+        for (size_t i = 0; i < walk->size(); ++i) simplifier.addFix((*walk)[i], trail);
+        simplifier.finish(trail);
+    }];
+
+    // storing every fix would be ~16 bytes a meter walked
+    XCTAssertLessThan(bytesPerKilometer, 2000.0);
+    XCTAssertLessThan(numPoints, numFixes / 10);
+}
+
+@end
@@ -0,0 +1,319 @@
+//
+//  RTCWalkRouterTests.mm
+//  RetracTests
+//
+//  Created by Nnoduka Eruchalu on 8/15/14.
+//  Copyright (c) 2014 Nnoduka Eruchalu. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include "RTCWalkRouter.h"
+
+// the benchmark city is a grid of this many intersections a side, this far
+// apart, with some blocks closed and some footpaths cutting across
+static const NSUInteger kBenchmarkGridSize = 500;
+static const double kBenchmarkBlockSize = 40.0;
+static const double kBenchmarkClosedFraction = 0.1;
+static const double kBenchmarkFootpathFraction = 0.05;
+
+// number of timed queries, and the longest walk asked for
+static const NSUInteger kNumBenchmarkQueries = 200;
+static const double kBenchmarkMaxWalk = 3000.0;
+
+// meters per degree of latitude, near enough for building test graphs
+static const double kMetersPerDegree = rtc::kEarthRadius * rtc::kDegreesToRadians;
+
+/**
+ * A few streets around a parking garage:
+ *
+ *      4 ------- 5         4-5 is a private driveway
+ *      |         |         2-4 is an unnamed footway
+ *      |         |         3-5 is a motorway
+ *  1 - 2 ------- 3         1-2-3 is Main Street
+ */
+static const char *const kSampleOSM =
+    "<?xml version='1.0' encoding='UTF-8'?>\n"
+    "<osm version=\"0.6\" generator=\"test\">\n"
+    "  <!-- walking graph test -> not real data -->\n"
+    "  <node id=\"1\" lat=\"37.3200000\" lon=\"-121.9500000\"/>\n"
+    "  <node id=\"2\" lat=\"37.3200000\" lon=\"-121.9488700\"/>\n"
+    "  <node id=\"3\" lat=\"37.3200000\" lon=\"-121.9466100\"/>\n"
+    "  <node id=\"4\" lat=\"37.3209000\" lon=\"-121.9488700\"><tag k=\"barrier\" v=\"gate\"/></node>\n"
+    "  <node id=\"5\" lat=\"37.3209000\" lon=\"-121.9466100\"/>\n"
+    "  <way id=\"10\"><nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/>"
+    "<tag k=\"highway\" v=\"residential\"/><tag k=\"name\" v=\"Main &amp; Street\"/></way>\n"
+    "  <way id=\"11\"><nd ref=\"2\"/><nd ref=\"4\"/><tag k=\"highway\" v=\"footway\"/></way>\n"
+    "  <way id=\"12\"><nd ref=\"3\"/><nd ref=\"5\"/><tag k=\"highway\" v=\"motorway\"/></way>\n"
+    "  <way id=\"13\"><nd ref=\"4\"/><nd ref=\"5\"/><tag k=\"highway\" v=\"service\"/>"
+    "<tag k=\"access\" v=\"private\"/></way>\n"
+    "</osm>\n";
+
+@interface RTCWalkRouterTests : XCTestCase
+
+@end
+
+@implementation RTCWalkRouterTests
+
+#pragma mark - Helpers
+/**
+ * Point offset (meters north, meters east) from an origin
+ */
+static rtc::GeoPoint offsetPoint(const rtc::GeoPoint &origin, double north, double east)
+{
+    double metersPerDegreeLongitude = kMetersPerDegree * std::cos(origin.latitude * rtc::kDegreesToRadians);
+    return rtc::GeoPoint(origin.latitude + north / kMetersPerDegree,
+                         origin.longitude + east / metersPerDegreeLongitude);
+}
+
+static bool loadSampleGraph(rtc::WalkGraph &graph, rtc::OSMImportStats *stats)
+{
+    std::istringstream osm(kSampleOSM);
+    rtc::WalkGraphBuilder builder;
+    if (!rtc::importOSM(osm, builder, stats)) return false;
+
+    std::stringstream file;
+    return builder.write(file) && graph.read(file);
+}
+
+/**
+ * Grid city with numbered streets and avenues
+ */
+static void buildSyntheticCity(std::mt19937 &generator, const rtc::GeoPoint &southWest, std::ostream &output)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    rtc::WalkGraphBuilder builder;
+    int64_t size = (int64_t)kBenchmarkGridSize;
+
+    for (int64_t row = 0; row < size; ++row) {
+        for (int64_t column = 0; column < size; ++column) {
+            builder.addNode(row * size + column,
+                            offsetPoint(southWest, row * kBenchmarkBlockSize, column * kBenchmarkBlockSize));
+        }
+    }
+
+    for (int64_t row = 0; row < size; ++row) {
+        for (int64_t column = 0; column < size; ++column) {
+            int64_t node = row * size + column;
+            std::ostringstream street, avenue;
+            street << (row + 1) << " Street";
+            avenue << (column + 1) << " Avenue";
+
+            if ((column + 1 < size) && (unit(generator) >= kBenchmarkClosedFraction)) {
+                builder.addWay(std::vector<int64_t>{node, node + 1}, street.str());
+            }
+            if ((row + 1 < size) && (unit(generator) >= kBenchmarkClosedFraction)) {
+                builder.addWay(std::vector<int64_t>{node, node + size}, avenue.str());
+            }
+            if ((row + 1 < size) && (column + 1 < size) && (unit(generator) < kBenchmarkFootpathFraction)) {
+                builder.addWay(std::vector<int64_t>{node, node + size + 1}, "the footpath");
+            }
+        }
+    }
+    builder.write(output);
+}
+
+
+#pragma mark - Import
+- (void)testImportKeepsWalkableWays
+{
+    rtc::WalkGraph graph;
+    rtc::OSMImportStats stats;
+    XCTAssertTrue(loadSampleGraph(graph, &stats));
+
+    XCTAssertEqual(stats.numNodes, (size_t)5);
+    XCTAssertEqual(stats.numWays, (size_t)4);
+    XCTAssertEqual(stats.numWalkableWays, (size_t)2);
+    XCTAssertEqual(graph.numNodes(), (size_t)4);
+    XCTAssertEqual(graph.numEdges(), (size_t)6);   // 3 segments, both ways
+
+    rtc::WalkGraph::NodeID node;
+    double distance;
+    XCTAssertTrue(graph.nearestNode(rtc::GeoPoint(37.32091, -121.94887), 50.0, &node, &distance));
+    XCTAssertEqualWithAccuracy(graph.coordinate(node).latitude, 37.3209, 1e-7);
+    XCTAssertLessThan(distance, 2.0);
+
+    // node 5 only has excluded ways
+    XCTAssertFalse(graph.nearestNode(rtc::GeoPoint(37.3209, -121.94661), 50.0, &node));
+
+    std::istringstream notOSM("<html><body>hello</body></html>");
+    rtc::WalkGraphBuilder builder;
+    std::string error;
+    XCTAssertFalse(rtc::importOSM(notOSM, builder, 0, &error));
+    XCTAssertFalse(error.empty());
+}
+
+- (void)testGraphFileAttach
+{
+    std::istringstream osm(kSampleOSM);
+    rtc::WalkGraphBuilder builder;
+    XCTAssertTrue(rtc::importOSM(osm, builder));
+
+    std::ostringstream file;
+    XCTAssertTrue(builder.write(file));
+    std::string bytes = file.str();
+    XCTAssertEqual(bytes.size() % 4, (size_t)0);
+
+    // attached, not copied
+    rtc::WalkGraph graph;
+    XCTAssertTrue(graph.attach(bytes.data(), bytes.size()));
+    XCTAssertEqual(graph.numEdges(), (size_t)6);
+    XCTAssertEqual(graph.byteSize(), bytes.size());
+
+    rtc::WalkGraph truncated;
+    XCTAssertFalse(truncated.attach(bytes.data(), bytes.size() - 4));
+    XCTAssertTrue(truncated.empty());
+
+    std::istringstream garbage("not a walking graph, not even close to one");
+    XCTAssertFalse(truncated.read(garbage));
+}
+
+
+#pragma mark - Routing
+- (void)testRouteFollowsStreets
+{
+    rtc::WalkGraph graph;
+    XCTAssertTrue(loadSampleGraph(graph, 0));
+    rtc::WalkRouter router(graph);
+
+    // from just past node 1 to the gate at node 4
+    rtc::GeoPoint origin(37.3199, -121.9500);
+    rtc::GeoPoint destination(37.3209, -121.94887);
+    rtc::Route route;
+    XCTAssertTrue(router.route(origin, destination, route));
+
+    XCTAssertEqual(route.steps.size(), (size_t)3);
+    if (route.steps.size() == 3) {
+        XCTAssertEqual(route.steps[0].instructions, std::string("Head north on Main & Street"));
+        XCTAssertEqual(route.steps[1].instructions, std::string("Turn left onto the footpath"));
+        XCTAssertEqual(route.steps[2].instructions, std::string("Arrive at the destination"));
+        XCTAssertEqual(route.steps[0].firstPoint, (uint32_t)0);
+        XCTAssertEqual(route.steps[1].firstPoint, (uint32_t)2);
+        XCTAssertEqualWithAccuracy(route.steps[0].distance, 11.1 + 100.0, 1.0);
+        XCTAssertEqualWithAccuracy(route.steps[1].distance, 100.0, 1.0);
+    }
+    XCTAssertEqualWithAccuracy(route.distance, 211.1, 1.5);
+    XCTAssertEqualWithAccuracy(route.expectedTravelTime, route.distance / router.policy().walkingSpeed, 1e-9);
+    XCTAssertEqual(route.polyline.size(), (size_t)4);
+}
+
+- (void)testNoRouteOffGraph
+{
+    rtc::WalkGraph graph;
+    XCTAssertTrue(loadSampleGraph(graph, 0));
+    rtc::WalkRouter router(graph);
+
+    rtc::Route route;
+    XCTAssertFalse(router.route(rtc::GeoPoint(37.3200, -121.9500), rtc::GeoPoint(37.40, -121.95), route));
+    XCTAssertFalse(router.route(rtc::GeoPoint(37.40, -121.95), rtc::GeoPoint(37.3200, -121.9500), route));
+}
+
+- (void)testRouteIsShortest
+{
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    // a small city, checked against the grid distance where no blocks are closed
+    rtc::GeoPoint southWest(37.30, -121.97);
+    rtc::WalkGraphBuilder builder;
+    for (int64_t row = 0; row < 20; ++row) {
+        for (int64_t column = 0; column < 20; ++column) {
+            builder.addNode(row * 20 + column, offsetPoint(southWest, row * 50.0, column * 50.0));
+            if (column > 0) builder.addWay(std::vector<int64_t>{row * 20 + column - 1, row * 20 + column}, "Street");
+            if (row > 0) builder.addWay(std::vector<int64_t>{(row - 1) * 20 + column, row * 20 + column}, "Avenue");
+        }
+    }
+    std::stringstream file;
+    builder.write(file);
+    rtc::WalkGraph graph;
+    XCTAssertTrue(graph.read(file));
+    rtc::WalkRouter router(graph);
+
+    for (int i = 0; i < 50; ++i) {
+        int rows[] = {(int)(20 * unit(generator)), (int)(20 * unit(generator))};
+        int columns[] = {(int)(20 * unit(generator)), (int)(20 * unit(generator))};
+        rtc::Route route;
+        XCTAssertTrue(router.route(offsetPoint(southWest, rows[0] * 50.0, columns[0] * 50.0),
+                                   offsetPoint(southWest, rows[1] * 50.0, columns[1] * 50.0), route));
+        double manhattan = 50.0 * (std::abs(rows[0] - rows[1]) + std::abs(columns[0] - columns[1]));
+        XCTAssertEqualWithAccuracy(route.distance, manhattan, 0.01 * manhattan + 0.5);
+    }
+}
+
+
+#pragma mark - Benchmark
+/**
+ * Build a city-sized graph and log its size, load time and route query
+ * latency.
+ */
+- (void)testCityRoutingPerformance
+{
+    std::mt19937 generator(2014);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    rtc::GeoPoint southWest(37.25, -122.05);
+    double citySize = (kBenchmarkGridSize - 1) * kBenchmarkBlockSize;
+
+    auto buildStart = std::chrono::steady_clock::now();
+    std::ostringstream file;
+    buildSyntheticCity(generator, southWest, file);
+    std::string bytes = file.str();
+    auto buildEnd = std::chrono::steady_clock::now();
+
+    rtc::WalkGraph graph;
+    XCTAssertTrue(graph.attach(bytes.data(), bytes.size()));
+    rtc::WalkRouter router(graph);
+    auto loadEnd = std::chrono::steady_clock::now();
+
+    std::vector<std::pair<rtc::GeoPoint, rtc::GeoPoint> > queries;
+    for (NSUInteger i = 0; i < kNumBenchmarkQueries; ++i) {
+        double north = citySize * unit(generator), east = citySize * unit(generator);
+        double walk = kBenchmarkMaxWalk * unit(generator), heading = 2.0 * M_PI * unit(generator);
+        double toNorth = std::max(0.0, std::min(citySize, north + walk * std::cos(heading)));
+        double toEast = std::max(0.0, std::min(citySize, east + walk * std::sin(heading)));
+        queries.push_back(std::make_pair(offsetPoint(southWest, north, east), offsetPoint(southWest, toNorth, toEast)));
+    }
+
+    std::vector<double> latencies;
+    size_t numRouted = 0, settled = 0;
+    double meters = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        rtc::Route route;
+        auto start = std::chrono::steady_clock::now();
+        bool routed = router.route(queries[i].first, queries[i].second, route);
+        auto end = std::chrono::steady_clock::now();
+
+        latencies.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        settled += router.lastQuerySettled();
+        if (routed) {
+            ++numRouted;
+            meters += route.distance;
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double meanLatency = 0;
+    for (size_t i = 0; i < latencies.size(); ++i) meanLatency += latencies[i] / latencies.size();
+
+    NSLog(@"[%@] %zu nodes, %zu edges, %.1f MB: built in %.2fs, attached in %.1fms; "
+          "%zu/%zu routed, mean %.0fm, %.0f nodes settled, latency mean %.2fms p50 %.2fms p90 %.2fms max %.2fms",
+          NSStringFromSelector(_cmd), graph.numNodes(), graph.numEdges(), bytes.size() / 1e6,
+          std::chrono::duration<double>(buildEnd - buildStart).count(),
+          std::chrono::duration<double, std::milli>(loadEnd - buildEnd).count(),
+          numRouted, queries.size(), meters / std::max((size_t)1, numRouted), (double)settled / queries.size(),
+          meanLatency, latencies[latencies.size() / 2], latencies[latencies.size() * 9 / 10], latencies.back());
+
+    const std::vector<std::pair<rtc::GeoPoint, rtc::GeoPoint> > *timed = &queries;
+    rtc::WalkRouter *timedRouter = &router;
+    [self measureBlock:^{
+        rtc::Route route;
+        for (size_t i = 0; i < 20; ++i) timedRouter->route((*timed)[i].first, (*timed)[i].second, route);
+    }];
+
+    XCTAssertGreaterThan(numRouted, queries.size() * 9 / 10);
+    XCTAssertLessThan(latencies[latencies.size() * 9 / 10], 50.0);
+}
+
+@end